@@ -46,7 +46,7 @@
 #define LLPC_INTERFACE_MAJOR_VERSION 40
 
 /// LLPC minor interface version.
-#define LLPC_INTERFACE_MINOR_VERSION 3
+#define LLPC_INTERFACE_MINOR_VERSION 20
 
 #ifndef LLPC_CLIENT_INTERFACE_MAJOR_VERSION
 #if VFX_INSIDE_SPVGEN
@@ -74,6 +74,23 @@
 //* %Version History
 //* | %Version | Change Description                                                                                    |
 //* | -------- | ----------------------------------------------------------------------------------------------------- |
+//* |    40.20 | Added InlineBuffer to ResourceMappingNodeType for buffer data held directly in user data              |
+//* |    40.19 | Added BuildGraphicsPipelinePart and LinkGraphicsPipelineParts to ICompiler for pipeline libraries    |
+//* |    40.18 | Added DescriptorFormatHint and formatHintCount/pFormatHints to PipelineShaderInfo                     |
+//* |    40.17 | Added compileBudgetExceeded to PipelineBuildStats                                                     |
+//* |    40.16 | Added PassBuildStats and GetPassStats to ICompiler                                                    |
+//* |    40.15 | Added lessUnrolled to PipelineBuildStats                                                              |
+//* |    40.14 | Added workgroupSwizzle to PipelineShaderOptions to remap compute threads into 2D tiles              |
+//* |    40.13 | Added shaderCacheMaxWaiters and priorityBoosts to CompilerCacheStats                                  |
+//* |    40.12 | Added BuildGraphicsPipelineAsync, BuildComputePipelineAsync and job functions to ICompiler            |
+//* |    40.11 | Added ppBinHandle to pipeline build outputs and ReleasePipelineBinary to ICompiler                    |
+//* |    40.10 | Added transcendentalPrecision to PipelineShaderOptions to select a fast-math lowering tier            |
+//* |     40.9 | Added enableAutoCulling to NggState to let the compiler choose the NGG cullers                        |
+//* |     40.8 | Added fastCompile to PipelineOptions to select a lightweight optimization tier                        |
+//* |     40.7 | Added BuildGraphicsPipelineTiered to ICompiler for two-tier graphics pipeline builds                  |
+//* |     40.6 | Added pStats to GraphicsPipelineBuildOut and ComputePipelineBuildOut to return compile statistics     |
+//* |     40.5 | Added userDataNodesHash to PipelineShaderInfo and GetResourceMappingHash to IPipelineDumper           |
+//* |     40.4 | Added BuildGraphicsPipelines to ICompiler to build a batch of graphics pipelines                      |
 //* |     40.3 | Added ICache interface                                                                                |
 //* |     40.2 | Added extendedRobustness in PipelineOptions to support VK_EXT_robustness2                             |
 //* |     40.1 | Added disableLoopUnroll to PipelineShaderOptions                                                      |
@@ -201,6 +218,9 @@ enum class ResourceMappingNodeType : unsigned {
 #elif LLPC_CLIENT_INTERFACE_MAJOR_VERSION >= 29
 #endif
   DescriptorYCbCrSampler, ///< Generic descriptor: YCbCr sampler
+  InlineBuffer,           ///< Inline buffer, with descriptor set and binding: the buffer's data is held directly in
+                          ///  the table. In the root table, constant-offset loads from it can be passed to the shader
+                          ///  in user data SGPRs, like push constants
   Count,                  ///< Count of resource mapping node types.
 };
 
@@ -241,6 +261,20 @@ struct DescriptorRangeValue {
   const unsigned *pValue;       ///< Static SRDs
 };
 
+/// Enumerates what is known at compile time about the data format of the images bound to a descriptor binding.
+enum class ImageFormatHint : unsigned {
+  Unknown = 0,  ///< Nothing known; the format is checked at runtime where it matters
+  Channel32,    ///< Every image bound has 32-bit channels (32, 32_32 or 32_32_32_32 data format)
+  NonChannel32, ///< No image bound has 32-bit channels
+};
+
+/// Represents compile-time format knowledge for one image descriptor binding.
+struct DescriptorFormatHint {
+  unsigned set;         ///< ID of descriptor set
+  unsigned binding;     ///< ID of descriptor binding
+  ImageFormatHint hint; ///< What is known about the data format of images bound here
+};
+
 /// Represents graphics IP version info. See https://llvm.org/docs/AMDGPUUsage.html#processors for more
 /// details.
 struct GfxIpVersion {
@@ -290,6 +324,9 @@ struct PipelineOptions {
   unsigned shadowDescriptorTablePtrHigh;                 ///< Sets high part of VA ptr for shadow descriptor table.
   ExtendedRobustness extendedRobustness;                 ///< ExtendedRobustness is intended to correspond to the
                                                          ///  features of VK_EXT_robustness2.
+  bool fastCompile;                                      ///< If set, the pipeline is compiled with only a few
+                                                         ///  lightweight optimizations and a lower codegen
+                                                         ///  optimization level, e.g. for a first-use compile.
 };
 
 /// Prototype of allocator for output data buffer, used in shader-specific operations.
@@ -384,6 +421,21 @@ enum class WaveBreakSize : unsigned {
   DrawTime = 0xF, ///< Choose wave break size per draw
 };
 
+/// Enumerates the accuracy tiers for the expansion of transcendental operations (atan, asin, sinh, pow, ...).
+enum class TranscendentalPrecision : unsigned {
+  Accurate = 0, ///< Full-length polynomial sequences
+  Relaxed = 1,  ///< Lower-degree minimax polynomials, absolute error below 2e-4
+  Fast = 2,     ///< Relaxed, plus sequences built directly on the hardware exp/log/rcp instructions
+};
+
+/// Enumerates the ways compute shader threads may be swizzled into 2D tiles of the workgroup.
+enum class WorkgroupSwizzle : unsigned {
+  Default = 0, ///< Swizzle only as selected by PipelineOptions::reconfigWorkgroupLayout
+  Auto = 1,    ///< Swizzle 2D workgroups of at least 8x8 threads that access images
+  Enable = 2,  ///< Swizzle whenever the workgroup size allows it
+  Disable = 3, ///< Never swizzle, even if PipelineOptions::reconfigWorkgroupLayout is set
+};
+
 /// Enumerates various sizing options of sub-group size for NGG primitive shader.
 enum class NggSubgroupSizingType : unsigned {
   Auto,             ///< Sub-group size is allocated as optimally determined
@@ -432,6 +484,9 @@ struct NggState {
                              ///  sub-group
 
   unsigned vertsPerSubgroup; ///< Preferred number of vertices consumed by a primitive shader sub-group
+
+  bool enableAutoCulling; ///< Let the compiler choose the cullers above from the cost of the vertex-processing stage,
+                          ///  instead of using the enable flags
 };
 
 #if LLPC_CLIENT_INTERFACE_MAJOR_VERSION >= 36
@@ -508,6 +563,12 @@ struct PipelineShaderOptions {
 
   /// Forcibly disable loop unrolling - overrides any explicit unroll directives
   bool disableLoopUnroll;
+
+  /// Accuracy tier for transcendental operations; anything but Accurate trades a few ulp for shorter sequences
+  TranscendentalPrecision transcendentalPrecision;
+
+  /// Remapping of compute shader threads to LocalInvocationId, so that the threads of a wave cover a 2D tile
+  WorkgroupSwizzle workgroupSwizzle;
 };
 
 /// Represents YCbCr sampler meta data in resource descriptor
@@ -590,6 +651,14 @@ struct PipelineShaderInfo {
   /// user data registers for internal use, so some user data may spill to internal GPU memory managed by Compiler.
   const ResourceMappingNode *pUserDataNodes;
   PipelineShaderOptions options; ///< Per shader stage tuning/debugging options
+
+  /// Hash of pUserDataNodes returned by IPipelineDumper::GetResourceMappingHash, or 0 if not known. A client that
+  /// shares one descriptor layout across many pipelines can compute this once per layout, so that pipeline hashing
+  /// does not walk the user data nodes again for every pipeline.
+  uint64_t userDataNodesHash;
+
+  unsigned formatHintCount;                 ///< Count of image descriptor format hints
+  const DescriptorFormatHint *pFormatHints; ///< An array of image descriptor format hints
 };
 
 /// Represents color target info
@@ -734,6 +803,14 @@ public:
   /// @returns Hash code associated this graphics pipeline.
   static uint64_t VKAPI_CALL GetPipelineHash(const GraphicsPipelineBuildInfo *pPipelineInfo);
 
+  /// Calculates the hash code of a resource mapping, for use as PipelineShaderInfo::userDataNodesHash.
+  ///
+  /// @param [in]  pUserDataNodes  Root-level user data nodes of the resource mapping
+  /// @param [in]  nodeCount       Count of user data nodes
+  ///
+  /// @returns Hash code associated this resource mapping.
+  static uint64_t VKAPI_CALL GetResourceMappingHash(const ResourceMappingNode *pUserDataNodes, unsigned nodeCount);
+
   /// Calculates compute pipeline hash code.
   ///
   /// @param [in]  pPipelineInfo  Info to build this compute pipeline
@@ -267,7 +267,7 @@ Value *ArithBuilder::CreateFMod(Value *dividend, Value *divisor, const Twine &in
 // @param c : The value to add to the product of A and B
 // @param instName : Name to give instruction(s)
 Value *ArithBuilder::CreateFma(Value *a, Value *b, Value *c, const Twine &instName) {
-  if (getPipelineState()->getTargetInfo().getGfxIpVersion().major <= 8) {
+  if (getGfxIpVersion().major <= 8) {
     // Pre-GFX9 version: Use fmuladd.
     return CreateIntrinsic(Intrinsic::fmuladd, a->getType(), {a, b, c}, nullptr, instName);
   }
@@ -302,6 +302,16 @@ Value *ArithBuilder::CreateASin(Value *x, const Twine &instName) {
     x = CreateFPExt(x, extTy);
   }
 
+  if (getTranscendentalPrecision() != TranscendentalPrecision::Accurate) {
+    // Use the same short polynomial as acos rather than going through atan2.
+    // p0 = 0.08132463, p1 = -0.02363318
+    auto coefP0 = getFpConstant(x->getType(), APFloat(APFloat::IEEEdouble(), APInt(64, 0x3FB4D1B0E0000000)));
+    auto coefP1 = getFpConstant(x->getType(), APFloat(APFloat::IEEEdouble(), APInt(64, 0xBF98334BE0000000)));
+    Value *result = CreateFPTrunc(aSinACosCommon(x, coefP0, coefP1), origTy);
+    result->setName(instName);
+    return result;
+  }
+
   // atan2(x, y), y = sqrt(1 - x * x)
   Value *y = CreateFMul(x, x);
   Value *one = ConstantFP::get(x->getType(), 1.0);
@@ -380,6 +390,13 @@ Value *ArithBuilder::CreateATan(Value *yOverX, const Twine &instName) {
   Value *max = CreateBinaryIntrinsic(Intrinsic::maxnum, absX, one);
   Value *min = CreateBinaryIntrinsic(Intrinsic::minnum, absX, one);
   Value *boundedX = CreateFMul(min, CreateFDiv(one, max));
+  if (getTranscendentalPrecision() != TranscendentalPrecision::Accurate) {
+    // atan(x) = PI/2 - atan(1/x) for |x| > 1
+    Value *result = aTanBoundedRelaxed(boundedX);
+    result = CreateSelect(CreateFCmpOGT(absX, one), CreateFSub(getPiByTwo(yOverX->getType()), result), result);
+    return CreateBinaryIntrinsic(Intrinsic::copysign, result, yOverX, nullptr, instName);
+  }
+
   Value *square = CreateFMul(boundedX, boundedX);
   Value *cube = CreateFMul(square, boundedX);
   Value *pow5 = CreateFMul(cube, square);
@@ -448,6 +465,23 @@ Value *ArithBuilder::CreateATan2(Value *y, Value *x, const Twine &instName) {
 
   Value *absX = CreateUnaryIntrinsic(Intrinsic::fabs, x);
   Value *absY = CreateUnaryIntrinsic(Intrinsic::fabs, y);
+
+  if (getTranscendentalPrecision() != TranscendentalPrecision::Accurate) {
+    // t = min(|x|, |y|) / max(|x|, |y|), r = atan(t)
+    // r = (|y| > |x|) ? PI/2 - r : r
+    // r = (x < 0.0) ? PI - r : r
+    // atan(y, x) = copysign(r, y)
+    Value *maxAbs = CreateBinaryIntrinsic(Intrinsic::maxnum, absX, absY);
+    Value *minAbs = CreateBinaryIntrinsic(Intrinsic::minnum, absX, absY);
+    Value *ratio = CreateFMul(minAbs, rcpFast(maxAbs));
+    // Equal magnitudes (including both zero or both infinite) would otherwise give NaN.
+    ratio = CreateSelect(CreateFCmpOEQ(absX, absY), one, ratio);
+    Value *result = aTanBoundedRelaxed(ratio);
+    result = CreateSelect(CreateFCmpOGT(absY, absX), CreateFSub(getPiByTwo(y->getType()), result), result);
+    result = CreateSelect(CreateFCmpOLT(x, zero), CreateFSub(getPi(y->getType()), result), result);
+    return CreateBinaryIntrinsic(Intrinsic::copysign, result, y, nullptr, instName);
+  }
+
   Value *signY = CreateFSign(y);
   Value *p0 = CreateFMul(signY, getPiByTwo(signY->getType()));
   Value *p1 = CreateFMul(signY, getPi(signY->getType()));
@@ -481,6 +515,11 @@ Value *ArithBuilder::CreateSinh(Value *x, const Twine &instName) {
   Constant *zero = Constant::getNullValue(x->getType());
   Constant *half = ConstantFP::get(x->getType(), 0.5);
   Value *divLog2 = CreateFMul(x, getRecipLog2(x->getType()));
+  if (getTranscendentalPrecision() == TranscendentalPrecision::Fast) {
+    // e^(-x) = 1 / e^x, trading a second exp for a rcp.
+    Value *exp = CreateUnaryIntrinsic(Intrinsic::exp2, divLog2);
+    return CreateFMul(CreateFSub(exp, rcpFast(exp)), half, instName);
+  }
   Value *negDivLog2 = CreateFSub(zero, divLog2);
   Value *exp = CreateUnaryIntrinsic(Intrinsic::exp2, divLog2);
   Value *expNeg = CreateUnaryIntrinsic(Intrinsic::exp2, negDivLog2);
@@ -499,6 +538,11 @@ Value *ArithBuilder::CreateCosh(Value *x, const Twine &instName) {
   // 1/log(2) = 1.442695
   // e^x = 2^(x*(1/log(2))) = 2^(x*1.442695))
   Value *divLog2 = CreateFMul(x, getRecipLog2(x->getType()));
+  if (getTranscendentalPrecision() == TranscendentalPrecision::Fast) {
+    // e^(-x) = 1 / e^x, trading a second exp for a rcp.
+    Value *exp = CreateUnaryIntrinsic(Intrinsic::exp2, divLog2);
+    return CreateFMul(CreateFAdd(exp, rcpFast(exp)), ConstantFP::get(x->getType(), 0.5), instName);
+  }
   Value *negDivLog2 = CreateFSub(ConstantFP::get(x->getType(), 0.0), divLog2);
   Value *exp = CreateUnaryIntrinsic(Intrinsic::exp2, divLog2);
   Value *expNeg = CreateUnaryIntrinsic(Intrinsic::exp2, negDivLog2);
@@ -517,6 +561,13 @@ Value *ArithBuilder::CreateTanh(Value *x, const Twine &instName) {
   // 1/log(2) = 1.442695
   // e^x = 2^(x*(1/log(2))) = 2^(x*1.442695))
   Value *divLog2 = CreateFMul(x, getRecipLog2(x->getType()));
+  if (getTranscendentalPrecision() == TranscendentalPrecision::Fast) {
+    // tanh(x) = 1 - 2 / (e^(2x) + 1), which also saturates cleanly to +/-1 for large |x|.
+    Constant *one = ConstantFP::get(x->getType(), 1.0);
+    Value *exp = CreateUnaryIntrinsic(Intrinsic::exp2, CreateFAdd(divLog2, divLog2));
+    Value *result = CreateFMul(ConstantFP::get(x->getType(), 2.0), rcpFast(CreateFAdd(exp, one)));
+    return CreateFSub(one, result, instName);
+  }
   Value *negDivLog2 = CreateFSub(ConstantFP::get(x->getType(), 0.0), divLog2);
   Value *exp = CreateUnaryIntrinsic(Intrinsic::exp2, divLog2);
   Value *expNeg = CreateUnaryIntrinsic(Intrinsic::exp2, negDivLog2);
@@ -594,8 +645,10 @@ Value *ArithBuilder::CreatePower(Value *x, Value *y, const Twine &instName) {
   if (x == ConstantFP::get(x->getType(), 2.0))
     return CreateUnaryIntrinsic(Intrinsic::exp2, y, nullptr, instName);
 
-  // llvm.pow only works with (vector of) float.
-  if (x->getType()->getScalarType()->isFloatTy())
+  // llvm.pow only works with (vector of) float. The fast tier skips it and its special-case handling in favor of the
+  // plain exp2/log2 sequence below.
+  if (x->getType()->getScalarType()->isFloatTy() &&
+      getTranscendentalPrecision() != TranscendentalPrecision::Fast)
     return CreateBinaryIntrinsic(Intrinsic::pow, x, y, nullptr, instName);
 
   // pow(x, y) = exp2(y * log2(x))
@@ -950,8 +1003,7 @@ Value *ArithBuilder::CreateFClamp(Value *x, Value *minVal, Value *maxVal, const
   // But we can only do this if we do not need NaN preservation.
   Value *result = nullptr;
   if (getFastMathFlags().noNaNs() && (x->getType()->getScalarType()->isFloatTy() ||
-                                      (getPipelineState()->getTargetInfo().getGfxIpVersion().major >= 9 &&
-                                       x->getType()->getScalarType()->isHalfTy()))) {
+                                      (getGfxIpVersion().major >= 9 && x->getType()->getScalarType()->isHalfTy()))) {
     result = scalarize(x, minVal, maxVal, [this](Value *x, Value *minVal, Value *maxVal) {
       return CreateIntrinsic(Intrinsic::amdgcn_fmed3, x->getType(), {x, minVal, maxVal});
     });
@@ -967,7 +1019,7 @@ Value *ArithBuilder::CreateFClamp(Value *x, Value *minVal, Value *maxVal, const
 
   // Before GFX9, fmed/fmin/fmax do not honor the hardware FP mode wanting flush denorms. So we need to
   // canonicalize the result here.
-  if (getPipelineState()->getTargetInfo().getGfxIpVersion().major < 9)
+  if (getGfxIpVersion().major < 9)
     result = canonicalize(result);
 
   result->setName(instName);
@@ -989,7 +1041,7 @@ Value *ArithBuilder::CreateFMin(Value *value1, Value *value2, const Twine &instN
 
   // Before GFX9, fmed/fmin/fmax do not honor the hardware FP mode wanting flush denorms. So we need to
   // canonicalize the result here.
-  if (getPipelineState()->getTargetInfo().getGfxIpVersion().major < 9)
+  if (getGfxIpVersion().major < 9)
     result = canonicalize(result);
 
   result->setName(instName);
@@ -1011,7 +1063,7 @@ Value *ArithBuilder::CreateFMax(Value *value1, Value *value2, const Twine &instN
 
   // Before GFX9, fmed/fmin/fmax do not honor the hardware FP mode wanting flush denorms. So we need to
   // canonicalize the result here.
-  if (getPipelineState()->getTargetInfo().getGfxIpVersion().major < 9)
+  if (getGfxIpVersion().major < 9)
     result = canonicalize(result);
 
   result->setName(instName);
@@ -1036,7 +1088,7 @@ Value *ArithBuilder::CreateFMin3(Value *value1, Value *value2, Value *value3, co
 
   // Before GFX9, fmed/fmin/fmax do not honor the hardware FP mode wanting flush denorms. So we need to
   // canonicalize the result here.
-  if (getPipelineState()->getTargetInfo().getGfxIpVersion().major < 9)
+  if (getGfxIpVersion().major < 9)
     result = canonicalize(result);
 
   result->setName(instName);
@@ -1061,7 +1113,7 @@ Value *ArithBuilder::CreateFMax3(Value *value1, Value *value2, Value *value3, co
 
   // Before GFX9, fmed/fmin/fmax do not honor the hardware FP mode wanting flush denorms. So we need to
   // canonicalize the result here.
-  if (getPipelineState()->getTargetInfo().getGfxIpVersion().major < 9)
+  if (getGfxIpVersion().major < 9)
     result = canonicalize(result);
 
   result->setName(instName);
@@ -1082,7 +1134,7 @@ Value *ArithBuilder::CreateFMid3(Value *value1, Value *value2, Value *value3, co
   // But we can only do this if we do not need NaN preservation.
   Value *result = nullptr;
   if (getFastMathFlags().noNaNs() && (value1->getType()->getScalarType()->isFloatTy() ||
-                                      (getPipelineState()->getTargetInfo().getGfxIpVersion().major >= 9 &&
+                                      (getGfxIpVersion().major >= 9 &&
                                        value1->getType()->getScalarType()->isHalfTy()))) {
     result = scalarize(value1, value2, value3, [this](Value *value1, Value *value2, Value *value3) {
       return CreateIntrinsic(Intrinsic::amdgcn_fmed3, value1->getType(), {value1, value2, value3});
@@ -1102,7 +1154,7 @@ Value *ArithBuilder::CreateFMid3(Value *value1, Value *value2, Value *value3, co
 
   // Before GFX9, fmed/fmin/fmax do not honor the hardware FP mode wanting flush denorms. So we need to
   // canonicalize the result here.
-  if (getPipelineState()->getTargetInfo().getGfxIpVersion().major < 9)
+  if (getGfxIpVersion().major < 9)
     result = canonicalize(result);
 
   result->setName(instName);
@@ -1126,6 +1178,49 @@ Value *ArithBuilder::fDivFast(Value *numerator, Value *denominator) {
   });
 }
 
+// =====================================================================================================================
+// Generate a hardware reciprocal (v_rcp), scalarizing if necessary. The result is not correctly rounded.
+//
+// @param x : Input value X
+Value *ArithBuilder::rcpFast(Value *x) {
+  return scalarize(x, [this](Value *x) -> Value * { return CreateUnaryIntrinsic(Intrinsic::amdgcn_rcp, x); });
+}
+
+// =====================================================================================================================
+// Get the transcendental accuracy tier selected for the current shader stage. Accurate if there is no shader stage.
+TranscendentalPrecision ArithBuilder::getTranscendentalPrecision() {
+  if (m_shaderStage == ShaderStageInvalid)
+    return TranscendentalPrecision::Accurate;
+  return getPipelineState()->getShaderOptions(m_shaderStage).transcendentalPrecision;
+}
+
+// =====================================================================================================================
+// Relaxed-tier atan of a value already bounded to [-1, 1], using a degree-9 minimax polynomial (Abramowitz and
+// Stegun 4.4.49) evaluated with FMAs. Absolute error is below 1.2e-5.
+//
+// @param boundedX : Input value X, |X| <= 1
+Value *ArithBuilder::aTanBoundedRelaxed(Value *boundedX) {
+  // atan(x) = x * (c1 + x^2 * (c3 + x^2 * (c5 + x^2 * (c7 + x^2 * c9))))
+  Type *ty = boundedX->getType();
+  // c1 = 0.99986601
+  auto coef1 = getFpConstant(ty, APFloat(APFloat::IEEEdouble(), APInt(64, 0x3FEFFEE700000000)));
+  // c3 = -0.33029950
+  auto coef3 = getFpConstant(ty, APFloat(APFloat::IEEEdouble(), APInt(64, 0xBFD523A080000000)));
+  // c5 = 0.18014100
+  auto coef5 = getFpConstant(ty, APFloat(APFloat::IEEEdouble(), APInt(64, 0x3FC70EDC40000000)));
+  // c7 = -0.08513300
+  auto coef7 = getFpConstant(ty, APFloat(APFloat::IEEEdouble(), APInt(64, 0xBFB5CB46C0000000)));
+  // c9 = 0.02083510
+  auto coef9 = getFpConstant(ty, APFloat(APFloat::IEEEdouble(), APInt(64, 0x3F9555CBE0000000)));
+
+  Value *square = CreateFMul(boundedX, boundedX);
+  Value *result = CreateFma(square, coef9, coef7);
+  result = CreateFma(square, result, coef5);
+  result = CreateFma(square, result, coef3);
+  result = CreateFma(square, result, coef1);
+  return CreateFMul(boundedX, result);
+}
+
 // =====================================================================================================================
 // Create "isInfinite" operation: return true if the supplied FP (or vector) value is infinity
 //
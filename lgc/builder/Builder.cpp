@@ -68,12 +68,26 @@ Builder::Builder(LgcContext *builderContext)
     : BuilderBase(builderContext->getContext()), m_builderContext(builderContext) {
 }
 
+// =====================================================================================================================
+// Re-target the Builder to another pipeline, or to none. A subclass overrides this to re-target its own state, and
+// calls this to clear the IRBuilder state left by the previous compile.
+//
+// @param pipeline : Pipeline object for pipeline compile, nullptr for shader compile or for a released Builder
+void Builder::setPipeline(Pipeline *pipeline) {
+  ClearInsertionPoint();
+  SetCurrentDebugLocation(DebugLoc());
+  clearFastMathFlags();
+  m_shaderStage = ShaderStageInvalid;
+}
+
 // =====================================================================================================================
 // Set the common shader mode for the current shader, containing hardware FP round and denorm modes.
 //
 // @param commonShaderMode : FP round and denorm modes
 void Builder::setCommonShaderMode(const CommonShaderMode &commonShaderMode) {
   getShaderModes()->setCommonShaderMode(m_shaderStage, commonShaderMode);
+  if (ShaderModes *stageShaderModes = getStageShaderModes())
+    stageShaderModes->setCommonShaderMode(m_shaderStage, commonShaderMode);
 }
 
 // =====================================================================================================================
@@ -88,6 +102,8 @@ const CommonShaderMode &Builder::getCommonShaderMode() {
 // @param tessellationMode : Tessellation mode
 void Builder::setTessellationMode(const TessellationMode &tessellationMode) {
   getShaderModes()->setTessellationMode(tessellationMode);
+  if (ShaderModes *stageShaderModes = getStageShaderModes())
+    stageShaderModes->setTessellationMode(tessellationMode);
 }
 
 // =====================================================================================================================
@@ -96,6 +112,8 @@ void Builder::setTessellationMode(const TessellationMode &tessellationMode) {
 // @param geometryShaderMode : Geometry shader mode
 void Builder::setGeometryShaderMode(const GeometryShaderMode &geometryShaderMode) {
   getShaderModes()->setGeometryShaderMode(geometryShaderMode);
+  if (ShaderModes *stageShaderModes = getStageShaderModes())
+    stageShaderModes->setGeometryShaderMode(geometryShaderMode);
 }
 
 // =====================================================================================================================
@@ -104,6 +122,8 @@ void Builder::setGeometryShaderMode(const GeometryShaderMode &geometryShaderMode
 // @param fragmentShaderMode : Fragment shader mode
 void Builder::setFragmentShaderMode(const FragmentShaderMode &fragmentShaderMode) {
   getShaderModes()->setFragmentShaderMode(fragmentShaderMode);
+  if (ShaderModes *stageShaderModes = getStageShaderModes())
+    stageShaderModes->setFragmentShaderMode(fragmentShaderMode);
 }
 
 // =====================================================================================================================
@@ -112,6 +132,8 @@ void Builder::setFragmentShaderMode(const FragmentShaderMode &fragmentShaderMode
 // @param computeShaderMode : Compute shader mode
 void Builder::setComputeShaderMode(const ComputeShaderMode &computeShaderMode) {
   getShaderModes()->setComputeShaderMode(computeShaderMode);
+  if (ShaderModes *stageShaderModes = getStageShaderModes())
+    stageShaderModes->setComputeShaderMode(computeShaderMode);
 }
 
 // =====================================================================================================================
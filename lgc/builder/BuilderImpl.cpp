@@ -29,6 +29,7 @@
  ***********************************************************************************************************************
  */
 #include "BuilderImpl.h"
+#include "lgc/LgcContext.h"
 #include "lgc/state/PipelineState.h"
 #include "lgc/state/TargetInfo.h"
 #include "llvm/IR/IntrinsicsAMDGPU.h"
@@ -48,6 +49,25 @@ BuilderImpl::BuilderImpl(LgcContext *builderContext, Pipeline *pipeline)
   m_pipelineState->setNoReplayer();
 }
 
+// =====================================================================================================================
+// Re-target the BuilderImpl to another pipeline. A released BuilderImpl is re-targeted to no pipeline until it is
+// reused.
+//
+// @param pipeline : Pipeline object, or nullptr for a released BuilderImpl
+void BuilderImpl::setPipeline(Pipeline *pipeline) {
+  Builder::setPipeline(pipeline);
+  m_pipelineState = reinterpret_cast<PipelineState *>(pipeline);
+  if (m_pipelineState)
+    m_pipelineState->setNoReplayer();
+}
+
+// =====================================================================================================================
+//
+// @param builderContext : LgcContext
+BuilderImplBase::BuilderImplBase(LgcContext *builderContext)
+    : Builder(builderContext), m_gfxIp(builderContext->getTargetInfo().getGfxIpVersion()) {
+}
+
 // =====================================================================================================================
 // Get the ShaderModes object.
 ShaderModes *BuilderImplBase::getShaderModes() {
@@ -78,19 +98,19 @@ Value *BuilderImplBase::CreateDotProduct(Value *const vector1, Value *const vect
 // =====================================================================================================================
 // Get whether the context we are building in supports DPP operations.
 bool BuilderImplBase::supportDpp() const {
-  return getPipelineState()->getTargetInfo().getGfxIpVersion().major >= 8;
+  return getGfxIpVersion().major >= 8;
 }
 
 // =====================================================================================================================
 // Get whether the context we are building in supports DPP ROW_XMASK operations.
 bool BuilderImplBase::supportDppRowXmask() const {
-  return getPipelineState()->getTargetInfo().getGfxIpVersion().major >= 10;
+  return getGfxIpVersion().major >= 10;
 }
 
 // =====================================================================================================================
 // Get whether the context we are building in support the bpermute operation.
 bool BuilderImplBase::supportBPermute() const {
-  auto gfxIp = getPipelineState()->getTargetInfo().getGfxIpVersion().major;
+  auto gfxIp = getGfxIpVersion().major;
   auto supportBPermute = gfxIp == 8 || gfxIp == 9;
   auto waveSize = getPipelineState()->getShaderWaveSize(getShaderStage(GetInsertBlock()->getParent()));
   supportBPermute = supportBPermute || (gfxIp == 10 && waveSize == 32);
@@ -100,7 +120,36 @@ bool BuilderImplBase::supportBPermute() const {
 // =====================================================================================================================
 // Get whether the context we are building in supports permute lane DPP operations.
 bool BuilderImplBase::supportPermLaneDpp() const {
-  return getPipelineState()->getTargetInfo().getGfxIpVersion().major >= 10;
+  return getGfxIpVersion().major >= 10;
+}
+
+// =====================================================================================================================
+// Attach a compile-time image format hint to an image descriptor or descriptor pointer value. This does nothing
+// if the hint is unknown or the value is not an instruction.
+//
+// @param value : Image descriptor, or descriptor pointer struct
+// @param hint : What is known about the image data format
+void BuilderImplBase::setImageFormatHint(Value *value, ImageFormatHint hint) {
+  auto inst = dyn_cast<Instruction>(value);
+  if (!inst || hint == ImageFormatHint::Unknown)
+    return;
+  Metadata *hintMeta = ConstantAsMetadata::get(getInt32(static_cast<unsigned>(hint)));
+  inst->setMetadata(getContext().getMDKindID(lgcName::ImageFormatHintMetadata), MDNode::get(getContext(), hintMeta));
+}
+
+// =====================================================================================================================
+// Get the compile-time image format hint attached to an image descriptor or descriptor pointer value, or
+// ImageFormatHint::Unknown if there is none.
+//
+// @param value : Image descriptor, or descriptor pointer struct
+ImageFormatHint BuilderImplBase::getImageFormatHint(Value *value) const {
+  auto inst = dyn_cast<Instruction>(value);
+  if (!inst)
+    return ImageFormatHint::Unknown;
+  MDNode *hintMeta = inst->getMetadata(getContext().getMDKindID(lgcName::ImageFormatHintMetadata));
+  if (!hintMeta)
+    return ImageFormatHint::Unknown;
+  return static_cast<ImageFormatHint>(mdconst::extract<ConstantInt>(hintMeta->getOperand(0))->getZExtValue());
 }
 
 // =====================================================================================================================
@@ -161,6 +210,16 @@ Instruction *BuilderImplBase::createWaterfallLoop(Instruction *nonUniformInst, A
                                                   const Twine &instName) {
   assert(operandIdxs.empty() == false);
 
+  // A constant descriptor (such as a folded immutable sampler) is uniform, so it does not need a waterfall loop.
+  SmallVector<unsigned, 2> nonConstantOperandIdxs;
+  for (unsigned operandIdx : operandIdxs) {
+    if (!isa<Constant>(nonUniformInst->getOperand(operandIdx)))
+      nonConstantOperandIdxs.push_back(operandIdx);
+  }
+  if (nonConstantOperandIdxs.empty())
+    return nonUniformInst;
+  operandIdxs = nonConstantOperandIdxs;
+
   // For each non-uniform input, try and trace back through a descriptor load to find the non-uniform index
   // used in it. If that fails, we just use the operand value as the index.
   SmallVector<Value *, 2> nonUniformIndices;
@@ -32,6 +32,7 @@
 
 #include "lgc/Builder.h"
 #include "lgc/state/PipelineState.h"
+#include "lgc/state/TargetInfo.h"
 
 namespace lgc {
 
@@ -39,7 +40,7 @@ namespace lgc {
 // Builder implementation base class
 class BuilderImplBase : public Builder {
 public:
-  BuilderImplBase(LgcContext *builderContext) : Builder(builderContext) {}
+  BuilderImplBase(LgcContext *builderContext);
 
   // Create scalar from dot product of vector
   llvm::Value *CreateDotProduct(llvm::Value *const vector1, llvm::Value *const vector2,
@@ -52,6 +53,9 @@ protected:
   // Get the PipelineState object.
   PipelineState *getPipelineState() const { return m_pipelineState; }
 
+  // Get the GFX IP version of the target, which is fixed for the LgcContext so is looked up only once.
+  GfxIpVersion getGfxIpVersion() const { return m_gfxIp; }
+
   // Get whether the context we are building in supports DPP operations.
   bool supportDpp() const;
 
@@ -67,6 +71,10 @@ protected:
   // Create an "if..endif" or "if..else..endif" structure.
   llvm::BranchInst *createIf(llvm::Value *condition, bool wantElse, const llvm::Twine &instName);
 
+  // Attach a compile-time image format hint to an image descriptor (or descriptor pointer) value, and read it back.
+  void setImageFormatHint(llvm::Value *value, ImageFormatHint hint);
+  ImageFormatHint getImageFormatHint(llvm::Value *value) const;
+
   // Create a waterfall loop containing the specified instruction.
   llvm::Instruction *createWaterfallLoop(llvm::Instruction *nonUniformInst, llvm::ArrayRef<unsigned> operandIdxs,
                                          const llvm::Twine &instName = "");
@@ -91,6 +99,8 @@ private:
   BuilderImplBase() = delete;
   BuilderImplBase(const BuilderImplBase &) = delete;
   BuilderImplBase &operator=(const BuilderImplBase &) = delete;
+
+  GfxIpVersion m_gfxIp; // GFX IP version of the target
 };
 
 // =====================================================================================================================
@@ -205,6 +215,15 @@ private:
   // Generate FP division, using fast fdiv for float to bypass optimization.
   llvm::Value *fDivFast(llvm::Value *numerator, llvm::Value *denominator);
 
+  // Generate a hardware reciprocal, scalarizing if necessary.
+  llvm::Value *rcpFast(llvm::Value *x);
+
+  // Get the transcendental accuracy tier selected for the current shader stage.
+  TranscendentalPrecision getTranscendentalPrecision();
+
+  // Relaxed-tier atan of a value already bounded to [-1, 1].
+  llvm::Value *aTanBoundedRelaxed(llvm::Value *boundedX);
+
   // Helper method to create call to llvm.amdgcn.class, scalarizing if necessary. This is not exposed outside of
   // ArithBuilder.
   llvm::Value *createCallAmdgcnClass(llvm::Value *value, unsigned flags, const llvm::Twine &instName = "");
@@ -573,6 +592,12 @@ private:
   // Get submatrix by deleting specified row and column
   void getSubmatrix(llvm::ArrayRef<llvm::Value *> matrix, llvm::MutableArrayRef<llvm::Value *> submatrix,
                     unsigned order, unsigned rowToDelete, unsigned columnToDelete);
+
+  // Get the matrix that the given matrix is a CreateTransposeMatrix expansion of, or nullptr.
+  llvm::Value *getTransposeSource(llvm::Value *matrix);
+
+  // Create a multiply-add, fused only when contraction is allowed.
+  llvm::Value *createFMulAdd(llvm::Value *a, llvm::Value *b, llvm::Value *c);
 };
 
 // =====================================================================================================================
@@ -850,12 +875,18 @@ private:
   llvm::Value *createDsSwizzle(llvm::Value *const value, uint16_t dsPattern);
   llvm::Value *createWwm(llvm::Value *const value);
   llvm::Value *createSetInactive(llvm::Value *const active, llvm::Value *const inactive);
+  llvm::Value *createClusterStep(llvm::Value *const clusterSize, unsigned stepClusterSize, bool exactMatch,
+                                llvm::Value *const result, llvm::function_ref<llvm::Value *()> createStep);
+  llvm::Value *createScanAcrossRows(GroupArithOp groupArithOp, llvm::Value *result, llvm::Value *const identity,
+                                    llvm::Value *const clusterSize, const llvm::Twine &instName);
   llvm::Value *createThreadMask();
   llvm::Value *createThreadMaskedSelect(llvm::Value *const threadMask, uint64_t andMask, llvm::Value *const value1,
                                         llvm::Value *const value2);
   uint16_t getDsSwizzleBitMode(uint8_t xorMask, uint8_t orMask, uint8_t andMask);
   uint16_t getDsSwizzleQuadMode(uint8_t lane0, uint8_t lane1, uint8_t lane2, uint8_t lane3);
+  DppCtrl getDppQuadPerm(uint8_t lane0, uint8_t lane1, uint8_t lane2, uint8_t lane3);
   llvm::Value *createGroupBallot(llvm::Value *const value);
+  bool isKnownUniform(llvm::Value *const value) const;
 };
 
 // =====================================================================================================================
@@ -873,6 +904,9 @@ public:
   BuilderImpl(LgcContext *builderContext, Pipeline *pipeline);
   ~BuilderImpl() {}
 
+  // Re-target the BuilderImpl to another pipeline.
+  void setPipeline(Pipeline *pipeline) override final;
+
   BuilderImpl() = delete;
   BuilderImpl(const BuilderImpl &) = delete;
   BuilderImpl &operator=(const BuilderImpl &) = delete;
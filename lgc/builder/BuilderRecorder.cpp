@@ -34,6 +34,7 @@
 #include "lgc/state/PipelineState.h"
 #include "lgc/state/ShaderModes.h"
 #include "lgc/util/Internal.h"
+#include "llvm/ADT/StringMap.h"
 
 #define DEBUG_TYPE "lgc-builder-recorder"
 
@@ -318,13 +319,27 @@ BuilderRecorder::BuilderRecorder(LgcContext *builderContext, Pipeline *pipeline,
 }
 
 // =====================================================================================================================
-// Record shader modes into IR metadata if this is a shader compile (no PipelineState).
-// For a pipeline compile with BuilderRecorder, they get recorded by PipelineState.
+// Re-target the BuilderRecorder to another pipeline, or to a shader compile, which gets its own new ShaderModes.
+//
+// @param pipeline : PipelineState, or nullptr for shader compile
+void BuilderRecorder::setPipeline(Pipeline *pipeline) {
+  Builder::setPipeline(pipeline);
+  m_pipelineState = reinterpret_cast<PipelineState *>(pipeline);
+  m_shaderModes.reset();
+}
+
+// =====================================================================================================================
+// Record shader modes into IR metadata. For a shader compile (no PipelineState), these are all the modes. For a
+// pipeline compile, they are the modes set for the current shader, which are in the PipelineState too; recording them
+// lets the shader's IR be linked into a pipeline without this PipelineState, as it is when the shader is lowered on
+// another thread or comes from the cache of lowered shaders. The next shader then collects its own modes.
 //
 // @param [in/out] module : Module to record into
 void BuilderRecorder::recordShaderModes(Module *module) {
-  if (!m_pipelineState && m_shaderModes)
+  if (m_shaderModes)
     m_shaderModes->record(module);
+  if (m_pipelineState)
+    m_shaderModes.reset();
 }
 
 // =====================================================================================================================
@@ -338,6 +353,17 @@ ShaderModes *BuilderRecorder::getShaderModes() {
   return &*m_shaderModes;
 }
 
+// =====================================================================================================================
+// Get the ShaderModes object that collects the modes of the current shader in a pipeline compile. A shader compile
+// has only its own ShaderModes object, returned by getShaderModes.
+ShaderModes *BuilderRecorder::getStageShaderModes() {
+  if (!m_pipelineState)
+    return nullptr;
+  if (!m_shaderModes)
+    m_shaderModes.reset(new ShaderModes());
+  return &*m_shaderModes;
+}
+
 // =====================================================================================================================
 // Create scalar from dot product of vector
 //
@@ -1998,13 +2024,31 @@ Instruction *BuilderRecorder::record(BuilderRecorder::Opcode opcode, Type *resul
 
 // =====================================================================================================================
 // Get the recorded call opcode from the function name. Asserts if not found.
-// This does not have to be particularly efficient, as it is only used with the lgc command-line utility.
+// A call name is followed by "." and the mangled return type, if any. So the name is looked up in a map of call names
+// at each "." from the end, which finds the longest call name that the name starts with. This is used with the lgc
+// command-line utility and -emit-lgc input, where the declarations have no opcode metadata.
 //
 // @param name : Name of function declaration
 // @return : Opcode
 BuilderRecorder::Opcode BuilderRecorder::getOpcodeFromName(StringRef name) {
   assert(name.startswith(BuilderCallPrefix));
   name = name.drop_front(strlen(BuilderCallPrefix));
+
+  static const StringMap<unsigned> OpcodeMap = [] {
+    StringMap<unsigned> opcodeMap;
+    for (unsigned opcode = 0; opcode != Opcode::Count; ++opcode)
+      opcodeMap[getCallName(static_cast<Opcode>(opcode))] = opcode;
+    return opcodeMap;
+  }();
+
+  for (size_t length = name.size(); length != 0 && length != StringRef::npos; length = name.rfind('.', length)) {
+    auto it = OpcodeMap.find(name.take_front(length));
+    if (it != OpcodeMap.end())
+      return static_cast<Opcode>(it->second);
+  }
+
+  // The name does not have a call name followed by "." or the end, so fall back to finding the longest call name
+  // that it starts with.
   unsigned bestOpcode = 0;
   unsigned bestLength = 0;
   for (unsigned opcode = 0; opcode != Opcode::Count; ++opcode) {
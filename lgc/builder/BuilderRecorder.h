@@ -231,6 +231,9 @@ public:
   BuilderRecorder(const BuilderRecorder &) = delete;
   BuilderRecorder &operator=(const BuilderRecorder &) = delete;
 
+  // Re-target the BuilderRecorder to another pipeline, or to a shader compile.
+  void setPipeline(Pipeline *pipeline) override final;
+
   // Record shader modes into IR metadata if this is a shader compile (no PipelineState).
   void recordShaderModes(llvm::Module *module) override final;
 
@@ -548,13 +551,17 @@ protected:
   // Get the ShaderModes object.
   ShaderModes *getShaderModes() override final;
 
+  // Get the ShaderModes object for the modes of the current shader.
+  ShaderModes *getStageShaderModes() override final;
+
 private:
   // Record one Builder call
   llvm::Instruction *record(Opcode opcode, llvm::Type *returnTy, llvm::ArrayRef<llvm::Value *> args,
                             const llvm::Twine &instName);
 
   PipelineState *m_pipelineState;             // PipelineState; nullptr for shader compile
-  std::unique_ptr<ShaderModes> m_shaderModes; // ShaderModes for a shader compile
+  std::unique_ptr<ShaderModes> m_shaderModes; // ShaderModes for a shader compile, or of the current shader for a
+                                              //  pipeline compile
   bool m_omitOpcodes;                         // Omit opcodes on lgc.create.* function declarations
 };
 
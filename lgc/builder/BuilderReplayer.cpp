@@ -32,6 +32,7 @@
 #include "lgc/LgcContext.h"
 #include "lgc/state/PipelineState.h"
 #include "lgc/util/Internal.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/Support/Debug.h"
 
 #define DEBUG_TYPE "lgc-builder-replayer"
@@ -66,7 +67,7 @@ private:
 
   std::unique_ptr<Builder> m_builder;                 // The LLPC builder that the builder
                                                       //  calls are being replayed on.
-  std::map<Function *, ShaderStage> m_shaderStageMap; // Map function -> shader stage
+  DenseMap<Function *, ShaderStage> m_shaderStageMap; // Map function -> shader stage
   Function *m_enclosingFunc = nullptr;                // Last function written with current
                                                       //  shader stage
 };
@@ -98,14 +99,18 @@ BuilderReplayer::BuilderReplayer(Pipeline *pipeline)
 bool BuilderReplayer::runOnModule(Module &module) {
   LLVM_DEBUG(dbgs() << "Running the pass of replaying LLPC builder calls\n");
 
-  // Set up the pipeline state from the specified linked IR module.
+  // Get the pipeline state. PipelineStateWrapper has either been given it directly by the compile, or has read it
+  // from IR metadata in the specified linked IR module.
   PipelineState *pipelineState = getAnalysis<PipelineStateWrapper>().getPipelineState(&module);
-  pipelineState->readState(&module);
 
   // Create the BuilderImpl to replay into, passing it the PipelineState
   LgcContext *builderContext = pipelineState->getLgcContext();
   m_builder.reset(builderContext->createBuilder(pipelineState, /*useBuilderRecorder=*/false));
 
+  // Forget functions from any previous run, as this pass may be in a cached pass manager that gets reused.
+  m_shaderStageMap.clear();
+  m_enclosingFunc = nullptr;
+
   SmallVector<Function *, 8> funcsToRemove;
 
   for (auto &func : module) {
@@ -145,6 +150,7 @@ bool BuilderReplayer::runOnModule(Module &module) {
   for (Function *const func : funcsToRemove)
     func->eraseFromParent();
 
+  builderContext->releaseBuilder(m_builder.release());
   return true;
 }
 
@@ -35,6 +35,7 @@
 #include "lgc/state/PipelineState.h"
 #include "lgc/state/TargetInfo.h"
 #include "lgc/util/Internal.h"
+#include "llvm/Analysis/ConstantFolding.h"
 #include "llvm/IR/IntrinsicsAMDGPU.h"
 
 #define DEBUG_TYPE "lgc-builder-impl-desc"
@@ -80,6 +81,20 @@ Value *DescBuilder::CreateLoadBufferDesc(unsigned descSet, unsigned binding, Val
       return UndefValue::get(getBufferDescTy(pointeeTy));
     }
 
+    if (node == topNode && node->type == ResourceNodeType::InlineBuffer) {
+      // Handle an inline buffer in the root table specially. Its data is in the root user data, so this
+      // lgc.root.inline.buffer call is lowered in PatchEntryPointMutate, which might be able to "unspill"
+      // constant-offset loads from it to directly use shader entry SGPRs, as for push constants. Otherwise it
+      // fills in the address of the buffer's data in the spill table to the descriptor passed here.
+      Value *descTemplate = buildBufferCompactDesc(Constant::getNullValue(FixedVectorType::get(getInt32Ty(), 2)));
+      Value *bufferPtr = CreateNamedCall(lgcName::RootInlineBuffer,
+                                         getInt8Ty()->getPointerTo(ADDR_SPACE_BUFFER_FAT_POINTER),
+                                         {getInt32(node->offsetInDwords), descTemplate}, Attribute::ReadNone);
+      if (!instName.isTriviallyEmpty())
+        bufferPtr->setName(instName);
+      return CreateBitCast(bufferPtr, getBufferDescTy(pointeeTy));
+    }
+
     if (node == topNode && isa<Constant>(descIndex)) {
       // Handle a descriptor in the root table (a "dynamic descriptor") specially, as long as it is not variably
       // indexed. This lgc.root.descriptor call is by default lowered in PatchEntryPointMutate into a load from the
@@ -148,8 +163,13 @@ Value *DescBuilder::CreateIndexDescPtr(Value *descPtrStruct, Value *index, bool
   if (index == getInt32(0))
     return descPtrStruct;
 
-  index = scalarizeIfUniform(index, isNonUniform);
+  // A zero stride means that all array elements are the same (an array of identical immutable samplers), so the
+  // index does not matter. Not indexing keeps the pointer constant, so the descriptor can be folded.
   Value *stride = CreateExtractValue(descPtrStruct, 1);
+  if (stride == getInt32(0))
+    return descPtrStruct;
+
+  index = scalarizeIfUniform(index, isNonUniform);
   Value *descPtr = CreateExtractValue(descPtrStruct, 0);
 
   Value *bytePtr = CreateBitCast(descPtr, getInt8Ty()->getPointerTo(ADDR_SPACE_CONST));
@@ -157,9 +177,11 @@ Value *DescBuilder::CreateIndexDescPtr(Value *descPtrStruct, Value *index, bool
   bytePtr = CreateGEP(getInt8Ty(), bytePtr, index, instName);
   descPtr = CreateBitCast(bytePtr, descPtr->getType());
 
+  ImageFormatHint formatHint = getImageFormatHint(descPtrStruct);
   descPtrStruct =
       CreateInsertValue(UndefValue::get(StructType::get(getContext(), {descPtr->getType(), getInt32Ty()})), descPtr, 0);
   descPtrStruct = CreateInsertValue(descPtrStruct, stride, 1);
+  setImageFormatHint(descPtrStruct, formatHint);
 
   return descPtrStruct;
 }
@@ -176,7 +198,26 @@ Value *DescBuilder::CreateLoadDescFromPtr(Value *descPtrStruct, const Twine &ins
   getPipelineState()->getShaderResourceUsage(m_shaderStage)->useImages = true;
 
   Value *descPtr = CreateExtractValue(descPtrStruct, 0);
-  return CreateLoad(descPtr->getType()->getPointerElementType(), descPtr, instName);
+  Type *descTy = descPtr->getType()->getPointerElementType();
+
+  // An immutable sampler at a known address is folded to its constant value here, rather than by later
+  // optimizations, so that the image operation code sees a constant sampler (e.g. to skip a waterfall loop).
+  // A converting sampler is not folded, as ImageBuilder looks for the load from its global variable to find the
+  // YCbCr conversion parameters.
+  if (auto constDescPtr = dyn_cast<Constant>(descPtr)) {
+    auto global = dyn_cast<GlobalVariable>(constDescPtr->stripPointerCasts());
+    if (global && global->isConstant() && global->hasDefinitiveInitializer() &&
+        global->getName().startswith(lgcName::ImmutableSamplerGlobal)) {
+      const DataLayout &dataLayout = GetInsertBlock()->getModule()->getDataLayout();
+      if (Constant *desc = ConstantFoldLoadFromConstPtr(constDescPtr, descTy, dataLayout))
+        return desc;
+    }
+  }
+
+  // Pass any image format hint on from the descriptor pointer to the descriptor, for ImageBuilder to see.
+  Value *desc = CreateLoad(descTy, descPtr, instName);
+  setImageFormatHint(desc, getImageFormatHint(descPtrStruct));
+  return desc;
 }
 
 // =====================================================================================================================
@@ -221,8 +262,12 @@ Value *DescBuilder::CreateGetImageDescPtr(unsigned descSet, unsigned binding, co
     }
   }
 
-  // Get the descriptor pointer and stride as a struct.
-  return getDescPtrAndStride(ResourceNodeType::DescriptorResource, descSet, binding, topNode, node, /*shadow=*/false);
+  // Get the descriptor pointer and stride as a struct, tagged with any compile-time format knowledge of the binding.
+  Value *descPtrStruct =
+      getDescPtrAndStride(ResourceNodeType::DescriptorResource, descSet, binding, topNode, node, /*shadow=*/false);
+  if (node)
+    setImageFormatHint(descPtrStruct, node->formatHint);
+  return descPtrStruct;
 }
 
 // =====================================================================================================================
@@ -376,6 +421,14 @@ Value *DescBuilder::getDescPtrAndStride(ResourceNodeType resType, unsigned descS
       stride = getInt32(DescriptorSizeSamplerYCbCr);
     }
 
+    // If all the immutable samplers in the array are the same, index them with a zero stride, so that even a
+    // variably-indexed one is known at compile time.
+    auto immutableArray = dyn_cast<ConstantArray>(node->immutableValue);
+    if (immutableArray && immutableArray->getNumOperands() > 1 &&
+        all_of(immutableArray->operands(),
+               [immutableArray](const Use &elem) { return elem.get() == immutableArray->getOperand(0); }))
+      stride = getInt32(0);
+
     std::string globalName = (startGlobalName + Twine(node->set) + "_" + Twine(node->binding)).str();
     Module *module = GetInsertPoint()->getModule();
     descPtr = module->getGlobalVariable(globalName, /*AllowInternal=*/true);
@@ -412,9 +465,10 @@ Value *DescBuilder::getDescPtr(ResourceNodeType resType, unsigned descSet, unsig
   Value *descPtr = nullptr;
 
   // Get the descriptor table pointer.
-  // TODO Shader compilation: If we do not have user data layout info (topNode and node are nullptr), then
-  // we do not know at compile time whether a DescriptorBuffer is in the root table or the table for its
-  // descriptor set, so we need to generate a select between the two, where the condition is a reloc.
+  // Shader compilation: If we do not have user data layout info (topNode and node are nullptr), then we do not
+  // know at compile time whether a descriptor is in the root table or the table for its descriptor set. The
+  // descriptor set pointer is used either way; for a set whose descriptors are in the root table, the link makes
+  // that pointer the spill table, and the offset reloc gives the offset of the descriptor in the spill table.
   if (node && node == topNode) {
     // The descriptor is in the top-level table. (This can only happen for a DescriptorBuffer.) Contrary
     // to what used to happen, we just load from the spill table, so we can get a pointer to the descriptor.
@@ -483,7 +537,7 @@ Value *DescBuilder::scalarizeIfUniform(Value *value, bool isNonUniform) {
   assert(value->getType()->isIntegerTy(32));
   if (!isNonUniform && !isa<Constant>(value)) {
     // NOTE: GFX6 encounters GPU hang with this optimization enabled. So we should skip it.
-    if (getPipelineState()->getTargetInfo().getGfxIpVersion().major > 6)
+    if (getGfxIpVersion().major > 6)
       value = CreateIntrinsic(Intrinsic::amdgcn_readfirstlane, {}, value);
   }
   return value;
@@ -518,7 +572,7 @@ Value *DescBuilder::buildInlineBufferDesc(Value *descPtr) {
 //
 // @param desc : The buffer descriptor base to build for the buffer compact descriptor
 Value *DescBuilder::buildBufferCompactDesc(Value *desc) {
-  const GfxIpVersion gfxIp = m_pipelineState->getTargetInfo().getGfxIpVersion();
+  const GfxIpVersion gfxIp = getGfxIpVersion();
 
   // Extract compact buffer descriptor
   Value *descElem0 = CreateExtractElement(desc, uint64_t(0));
@@ -472,7 +472,7 @@ Value *ImageBuilder::CreateImageLoad(Type *resultTy, unsigned dim, unsigned flag
     CoherentFlag coherent = {};
     if (flags & (ImageFlagCoherent | ImageFlagVolatile)) {
       coherent.bits.glc = true;
-      if (m_pipelineState->getTargetInfo().getGfxIpVersion().major >= 10)
+      if (getGfxIpVersion().major >= 10)
         coherent.bits.dlc = true;
     }
     args.push_back(getInt32(coherent.u32All));
@@ -806,7 +806,7 @@ Value *ImageBuilder::CreateImageSampleConvertYCbCr(Type *resultTy, unsigned dim,
 
   YCbCrSampleInfo sampleInfoLuma = {resultTy, dim, flags, imageDesc, samplerDescLuma, address, instName.str(), true};
 
-  GfxIpVersion gfxIp = getPipelineState()->getTargetInfo().getGfxIpVersion();
+  GfxIpVersion gfxIp = getGfxIpVersion();
 
   // Init YCbCrConverterer
   YCbCrConverter YCbCrConverter(this, yCbCrMetaData, &sampleInfoLuma, &gfxIp);
@@ -911,17 +911,57 @@ Value *ImageBuilder::CreateImageGather(Type *resultTy, unsigned dim, unsigned fl
 // =====================================================================================================================
 // Implement pre-GFX9 integer gather workaround to patch descriptor or coordinate, depending on format in descriptor
 // Returns nullptr for GFX9+, or a bool value that is true if the descriptor was patched or false if the
-// coordinate was modified.
+// coordinate was modified. If the descriptor carries a compile-time format hint, only the one patch needed is
+// applied, and the returned bool value is a constant.
 //
 // @param dim : Image dimension
 // @param [in/out] imageDesc : Image descriptor
 // @param [in/out] coord : Coordinate
 Value *ImageBuilder::preprocessIntegerImageGather(unsigned dim, Value *&imageDesc, Value *&coord) {
-  if (getPipelineState()->getTargetInfo().getGfxIpVersion().major >= 9) {
+  if (getGfxIpVersion().major >= 9) {
     // GFX9+: Workaround not needed.
     return nullptr;
   }
 
+  // Patch the descriptor: change NUM_FORMAT from SINT to SSCALE.
+  auto patchDesc = [this](Value *imageDesc) {
+    Value *descDword1 = CreateExtractElement(imageDesc, 1);
+    descDword1 = CreateSub(descDword1, getInt32(0x08000000));
+    return CreateInsertElement(imageDesc, descDword1, 1);
+  };
+
+  // Patch the coordinates: add (-0.5/width, -0.5/height) to the x,y coordinates.
+  auto patchCoord = [this, dim](Value *imageDesc, Value *coord) {
+    Value *zero = getInt32(0);
+    unsigned resInfoDim = dim == DimCubeArray ? DimCube : dim;
+    Value *resInfo = CreateIntrinsic(ImageGetResInfoIntrinsicTable[resInfoDim],
+                                     {FixedVectorType::get(getFloatTy(), 4), getInt32Ty()},
+                                     {getInt32(15), zero, imageDesc, zero, zero});
+    resInfo = CreateBitCast(resInfo, FixedVectorType::get(getInt32Ty(), 4));
+
+    Value *widthHeight = CreateShuffleVector(resInfo, resInfo, ArrayRef<int>{0, 1});
+    widthHeight = CreateSIToFP(widthHeight, FixedVectorType::get(getFloatTy(), 2));
+    Value *valueToAdd = CreateFDiv(ConstantFP::get(widthHeight->getType(), -0.5), widthHeight);
+    unsigned coordCount = cast<VectorType>(coord->getType())->getNumElements();
+    if (coordCount > 2) {
+      valueToAdd = CreateShuffleVector(valueToAdd, Constant::getNullValue(valueToAdd->getType()),
+                                       ArrayRef<int>({0, 1, 2, 3}).slice(0, coordCount));
+    }
+    return CreateFAdd(coord, valueToAdd);
+  };
+
+  // If the format is known at compile time, there is no need for the runtime check.
+  switch (getImageFormatHint(imageDesc)) {
+  case ImageFormatHint::NonChannel32:
+    imageDesc = patchDesc(imageDesc);
+    return getTrue();
+  case ImageFormatHint::Channel32:
+    coord = patchCoord(imageDesc, coord);
+    return getFalse();
+  default:
+    break;
+  }
+
   // Check whether the descriptor needs patching. It does if it does not have format 32, 32_32 or 32_32_32_32.
   Value *descDword1 = CreateExtractElement(imageDesc, 1);
   Value *dataFormat = CreateIntrinsic(Intrinsic::amdgcn_ubfe, getInt32Ty(), {descDword1, getInt32(20), getInt32(6)});
@@ -936,29 +976,12 @@ Value *ImageBuilder::preprocessIntegerImageGather(unsigned dim, Value *&imageDes
   InsertPoint savedInsertPoint = saveIP();
   BranchInst *branch = createIf(needDescPatch, true, "before.int.gather");
 
-  // Inside the "then": patch the descriptor: change NUM_FORMAT from SINT to SSCALE.
-  Value *descDword1A = CreateExtractElement(imageDesc, 1);
-  descDword1A = CreateSub(descDword1A, getInt32(0x08000000));
-  Value *patchedImageDesc = CreateInsertElement(imageDesc, descDword1A, 1);
+  // Inside the "then": patch the descriptor.
+  Value *patchedImageDesc = patchDesc(imageDesc);
 
-  // On to the "else": patch the coordinates: add (-0.5/width, -0.5/height) to the x,y coordinates.
+  // On to the "else": patch the coordinates.
   SetInsertPoint(branch->getSuccessor(1)->getTerminator());
-  Value *zero = getInt32(0);
-  dim = dim == DimCubeArray ? DimCube : dim;
-  Value *resInfo =
-      CreateIntrinsic(ImageGetResInfoIntrinsicTable[dim], {FixedVectorType::get(getFloatTy(), 4), getInt32Ty()},
-                      {getInt32(15), zero, imageDesc, zero, zero});
-  resInfo = CreateBitCast(resInfo, FixedVectorType::get(getInt32Ty(), 4));
-
-  Value *widthHeight = CreateShuffleVector(resInfo, resInfo, ArrayRef<int>{0, 1});
-  widthHeight = CreateSIToFP(widthHeight, FixedVectorType::get(getFloatTy(), 2));
-  Value *valueToAdd = CreateFDiv(ConstantFP::get(widthHeight->getType(), -0.5), widthHeight);
-  unsigned coordCount = cast<VectorType>(coord->getType())->getNumElements();
-  if (coordCount > 2) {
-    valueToAdd = CreateShuffleVector(valueToAdd, Constant::getNullValue(valueToAdd->getType()),
-                                     ArrayRef<int>({0, 1, 2, 3}).slice(0, coordCount));
-  }
-  Value *patchedCoord = CreateFAdd(coord, valueToAdd);
+  Value *patchedCoord = patchCoord(imageDesc, coord);
 
   // Restore insert point to after the if..else..endif, and add the phi nodes.
   restoreIP(savedInsertPoint);
@@ -986,11 +1009,19 @@ Value *ImageBuilder::preprocessIntegerImageGather(unsigned dim, Value *&imageDes
 // @param result : Returned texel value, or struct containing texel and TFE
 Value *ImageBuilder::postprocessIntegerImageGather(Value *needDescPatch, unsigned flags, Value *imageDesc,
                                                    Type *texelTy, Value *result) {
+  // If whether the descriptor was patched is known at compile time, the result is either used as is or
+  // converted unconditionally.
+  auto constNeedDescPatch = dyn_cast<ConstantInt>(needDescPatch);
+  if (constNeedDescPatch && constNeedDescPatch->isZero())
+    return result;
+
   // Post-processing of result for integer return type.
   // Create the if..endif, where the condition is whether the descriptor was patched. If it was,
   // then we need to convert the texel from float to i32.
   InsertPoint savedInsertPoint = saveIP();
-  BranchInst *branch = createIf(needDescPatch, false, "after.int.gather");
+  BranchInst *branch = nullptr;
+  if (!constNeedDescPatch)
+    branch = createIf(needDescPatch, false, "after.int.gather");
 
   // Process the returned texel.
   Value *texel = result;
@@ -1007,6 +1038,9 @@ Value *ImageBuilder::postprocessIntegerImageGather(Value *needDescPatch, unsigne
   if (tfe)
     patchedResult = CreateInsertValue(result, patchedResult, 0);
 
+  if (constNeedDescPatch)
+    return patchedResult;
+
   patchedResult = CreateSelect(needDescPatch, patchedResult, result);
 
   // Restore insert point to after the if..endif, and add the phi node.
@@ -1137,7 +1171,7 @@ Value *ImageBuilder::CreateImageSampleGather(Type *resultTy, unsigned dim, unsig
   CoherentFlag coherent = {};
   if (flags & (ImageFlagCoherent | ImageFlagVolatile)) {
     coherent.bits.glc = true;
-    if (m_pipelineState->getTargetInfo().getGfxIpVersion().major >= 10)
+    if (getGfxIpVersion().major >= 10)
       coherent.bits.dlc = true;
   }
   args.push_back(getInt32(coherent.u32All));
@@ -1347,7 +1381,7 @@ Value *ImageBuilder::CreateImageQuerySize(unsigned dim, unsigned flags, Value *i
     // Extract NUM_RECORDS (SQ_BUF_RSRC_WORD2)
     Value *numRecords = CreateExtractElement(imageDesc, 2);
 
-    if (getPipelineState()->getTargetInfo().getGfxIpVersion().major == 8) {
+    if (getGfxIpVersion().major == 8) {
       // GFX8 only: extract STRIDE (SQ_BUF_RSRC_WORD1 [29:16]) and divide into NUM_RECORDS.
       Value *stride = CreateIntrinsic(Intrinsic::amdgcn_ubfe, getInt32Ty(),
                                       {CreateExtractElement(imageDesc, 1), getInt32(16), getInt32(14)});
@@ -1769,7 +1803,7 @@ void ImageBuilder::combineCubeArrayFaceAndSlice(Value *coord, SmallVectorImpl<Va
 // @param desc : Descriptor before patching
 // @param dim : Image dimensions
 Value *ImageBuilder::patchCubeDescriptor(Value *desc, unsigned dim) {
-  if ((dim != DimCube && dim != DimCubeArray) || getPipelineState()->getTargetInfo().getGfxIpVersion().major >= 9)
+  if ((dim != DimCube && dim != DimCubeArray) || getGfxIpVersion().major >= 9)
     return desc;
 
   // Extract the depth.
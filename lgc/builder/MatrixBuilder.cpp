@@ -43,6 +43,10 @@ using namespace llvm;
 Value *MatrixBuilder::CreateTransposeMatrix(Value *const matrix, const Twine &instName) {
   assert(matrix);
 
+  // The transpose of a transpose is the original matrix.
+  if (Value *source = getTransposeSource(matrix))
+    return source;
+
   Type *const matrixType = matrix->getType();
   assert(matrixType->isArrayTy());
 
@@ -114,15 +118,28 @@ Value *MatrixBuilder::CreateMatrixTimesScalar(Value *const matrix, Value *const
 // @param matrix : The column major matrix, n x <n x float>
 // @param instName : Name to give instruction(s)
 Value *MatrixBuilder::CreateVectorTimesMatrix(Value *const vector, Value *const matrix, const Twine &instName) {
+  // v * transpose(M) = M * v
+  if (Value *source = getTransposeSource(matrix))
+    return CreateMatrixTimesVector(source, vector, instName);
+
   Type *const matrixTy = matrix->getType();
   Type *const compTy = cast<VectorType>(cast<ArrayType>(matrixTy)->getElementType())->getElementType();
   const unsigned columnCount = matrixTy->getArrayNumElements();
+  const unsigned rowCount = cast<VectorType>(vector->getType())->getNumElements();
   Type *const resultTy = FixedVectorType::get(compTy, columnCount);
   Value *result = UndefValue::get(resultTy);
 
+  SmallVector<Value *, 4> vectorComps;
+  for (unsigned row = 0; row < rowCount; ++row)
+    vectorComps.push_back(CreateExtractElement(vector, row));
+
   for (unsigned column = 0; column < columnCount; column++) {
+    // Dot product of the vector with this column, as a multiply-add chain.
     auto columnVector = CreateExtractValue(matrix, column);
-    result = CreateInsertElement(result, CreateDotProduct(columnVector, vector), column);
+    Value *dot = CreateFMul(CreateExtractElement(columnVector, uint64_t(0)), vectorComps[0]);
+    for (unsigned row = 1; row < rowCount; ++row)
+      dot = createFMulAdd(CreateExtractElement(columnVector, row), vectorComps[row], dot);
+    result = CreateInsertElement(result, dot, column);
   }
 
   result->setName(instName);
@@ -136,18 +153,22 @@ Value *MatrixBuilder::CreateVectorTimesMatrix(Value *const vector, Value *const
 // @param vector : The vector
 // @param instName : Name to give instruction(s)
 Value *MatrixBuilder::CreateMatrixTimesVector(Value *const matrix, Value *const vector, const Twine &instName) {
+  // transpose(M) * v = v * M
+  if (Value *source = getTransposeSource(matrix))
+    return CreateVectorTimesMatrix(vector, source, instName);
+
   Type *const columnTy = matrix->getType()->getArrayElementType();
   const unsigned rowCount = cast<VectorType>(columnTy)->getNumElements();
   Value *result = nullptr;
 
   for (unsigned i = 0; i < matrix->getType()->getArrayNumElements(); ++i) {
     SmallVector<int, 4> shuffleMask(rowCount, i);
-    auto partialResult = CreateShuffleVector(vector, vector, shuffleMask);
-    partialResult = CreateFMul(CreateExtractValue(matrix, i), partialResult);
+    auto smearComp = CreateShuffleVector(vector, vector, shuffleMask);
+    auto column = CreateExtractValue(matrix, i);
     if (result)
-      result = CreateFAdd(result, partialResult);
+      result = createFMulAdd(column, smearComp, result);
     else
-      result = partialResult;
+      result = CreateFMul(column, smearComp);
   }
 
   result->setName(instName);
@@ -166,8 +187,29 @@ Value *MatrixBuilder::CreateMatrixTimesMatrix(Value *const matrix1, Value *const
   Type *const resultTy = ArrayType::get(mat1ColumnType, mat2ColCount);
   Value *result = UndefValue::get(resultTy);
 
+  Value *const source1 = getTransposeSource(matrix1);
+  Value *const source2 = source1 ? nullptr : getTransposeSource(matrix2);
+
   for (unsigned i = 0; i < mat2ColCount; ++i) {
-    Value *newColumnVector = CreateMatrixTimesVector(matrix1, CreateExtractValue(matrix2, i));
+    Value *newColumnVector = nullptr;
+    if (source1) {
+      // Column i of transpose(S) * M2 is M2[i] * S.
+      newColumnVector = CreateVectorTimesMatrix(CreateExtractValue(matrix2, i), source1);
+    } else if (source2) {
+      // Column i of M1 * transpose(T) is the sum over k of M1[k] * T[k][i], reading T's elements in place.
+      const unsigned rowCount = cast<VectorType>(mat1ColumnType)->getNumElements();
+      for (unsigned k = 0; k < matrix1->getType()->getArrayNumElements(); ++k) {
+        Value *element = CreateExtractElement(CreateExtractValue(source2, k), i);
+        Value *smearElement = CreateVectorSplat(rowCount, element);
+        Value *column = CreateExtractValue(matrix1, k);
+        if (newColumnVector)
+          newColumnVector = createFMulAdd(column, smearElement, newColumnVector);
+        else
+          newColumnVector = CreateFMul(column, smearElement);
+      }
+    } else {
+      newColumnVector = CreateMatrixTimesVector(matrix1, CreateExtractValue(matrix2, i));
+    }
     result = CreateInsertValue(result, newColumnVector, i);
   }
 
@@ -175,6 +217,73 @@ Value *MatrixBuilder::CreateMatrixTimesMatrix(Value *const matrix1, Value *const
   return result;
 }
 
+// =====================================================================================================================
+// If the given matrix is exactly the expansion that CreateTransposeMatrix generates (as happens for row-major matrices
+// loaded from memory), return the matrix it transposes, so that callers can fold the transpose into the opposite
+// multiply form and leave the expansion dead. Otherwise return nullptr.
+//
+// @param matrix : Matrix to examine
+Value *MatrixBuilder::getTransposeSource(Value *matrix) {
+  auto matrixTy = dyn_cast<ArrayType>(matrix->getType());
+  if (!matrixTy || !isa<FixedVectorType>(matrixTy->getElementType()))
+    return nullptr;
+  const unsigned rowCount = matrixTy->getNumElements();
+  const unsigned columnCount = cast<FixedVectorType>(matrixTy->getElementType())->getNumElements();
+
+  // Walk the insertvalue chain backwards. Each inserted vector is one row of the source matrix, built by an
+  // insertelement chain of extractelement(extractvalue(source, column), row).
+  Value *source = nullptr;
+  Value *value = matrix;
+  for (unsigned row = rowCount; row-- != 0;) {
+    auto insertValue = dyn_cast<InsertValueInst>(value);
+    if (!insertValue || insertValue->getNumIndices() != 1 || insertValue->getIndices()[0] != row)
+      return nullptr;
+
+    Value *rowVector = insertValue->getInsertedValueOperand();
+    for (unsigned column = columnCount; column-- != 0;) {
+      auto insertElement = dyn_cast<InsertElementInst>(rowVector);
+      if (!insertElement)
+        return nullptr;
+      auto insertIndex = dyn_cast<ConstantInt>(insertElement->getOperand(2));
+      if (!insertIndex || insertIndex->getZExtValue() != column)
+        return nullptr;
+      auto extractElement = dyn_cast<ExtractElementInst>(insertElement->getOperand(1));
+      if (!extractElement)
+        return nullptr;
+      auto extractIndex = dyn_cast<ConstantInt>(extractElement->getIndexOperand());
+      if (!extractIndex || extractIndex->getZExtValue() != row)
+        return nullptr;
+      auto extractValue = dyn_cast<ExtractValueInst>(extractElement->getVectorOperand());
+      if (!extractValue || extractValue->getNumIndices() != 1 || extractValue->getIndices()[0] != column)
+        return nullptr;
+      if (!source)
+        source = extractValue->getAggregateOperand();
+      else if (extractValue->getAggregateOperand() != source)
+        return nullptr;
+      rowVector = insertElement->getOperand(0);
+    }
+    if (!isa<UndefValue>(rowVector))
+      return nullptr;
+    value = insertValue->getAggregateOperand();
+  }
+  if (!isa<UndefValue>(value))
+    return nullptr;
+  return source;
+}
+
+// =====================================================================================================================
+// Create a multiply-add on scalars or vectors, as llvm.fmuladd when contraction is allowed so that the backend forms
+// FMA/MAD chains, or as a separate multiply and add otherwise (e.g. for NoContraction).
+//
+// @param a : Multiplicand
+// @param b : Multiplier
+// @param c : Addend
+Value *MatrixBuilder::createFMulAdd(Value *a, Value *b, Value *c) {
+  if (getFastMathFlags().allowContract())
+    return CreateIntrinsic(Intrinsic::fmuladd, a->getType(), {a, b, c});
+  return CreateFAdd(CreateFMul(a, b), c);
+}
+
 // =====================================================================================================================
 // Create matrix from outer product of vector
 //
@@ -32,6 +32,7 @@
 #include "lgc/state/PipelineState.h"
 #include "lgc/util/Internal.h"
 #include "llvm/IR/InlineAsm.h"
+#include "llvm/IR/IntrinsicInst.h"
 #include "llvm/IR/Intrinsics.h"
 #include "llvm/IR/IntrinsicsAMDGPU.h"
 
@@ -291,6 +292,11 @@ Value *SubgroupBuilder::CreateSubgroupBallotFindMsb(Value *const value, const Tw
 // @param index : The index to shuffle from.
 // @param instName : Name to give final instruction.
 Value *SubgroupBuilder::CreateSubgroupShuffle(Value *const value, Value *const index, const Twine &instName) {
+  // A uniform index reads the same lane for every invocation, which is a broadcast (s_readlane) rather than a
+  // ds_bpermute or a waterfall loop.
+  if (isKnownUniform(index))
+    return CreateSubgroupBroadcast(value, index, instName);
+
   if (supportBPermute()) {
     auto mapFunc = [](Builder &builder, ArrayRef<Value *> mappedArgs, ArrayRef<Value *> passthroughArgs) -> Value * {
       return builder.CreateIntrinsic(Intrinsic::amdgcn_ds_bpermute, {}, {passthroughArgs[0], mappedArgs[0]});
@@ -324,8 +330,8 @@ Value *SubgroupBuilder::CreateSubgroupShuffleXor(Value *const value, Value *cons
   // issue dpp_mov for some simple quad/row shuffle cases;
   // then issue ds_permlane_x16 if supported or ds_swizzle, if maskValue < 32
   // default to call SubgroupShuffle, which may issue waterfallloops to handle complex cases.
-  if (cast<ConstantInt>(mask)) {
-    maskValue = cast<ConstantInt>(mask)->getZExtValue();
+  if (auto constMask = dyn_cast<ConstantInt>(mask)) {
+    maskValue = constMask->getZExtValue();
 
     if (maskValue < 32) {
       canOptimize = true;
@@ -421,6 +427,15 @@ Value *SubgroupBuilder::CreateSubgroupShuffleXor(Value *const value, Value *cons
 // @param delta : The delta to shuffle from.
 // @param instName : Name to give final instruction.
 Value *SubgroupBuilder::CreateSubgroupShuffleUp(Value *const value, Value *const delta, const Twine &instName) {
+  if (auto constDelta = dyn_cast<ConstantInt>(delta)) {
+    if (constDelta->isZero())
+      return value;
+    // NOTE: Wave shift right is only available before GFX10. The lane it shifts in from outside the wave reads from
+    // an invocation that does not exist, whose result is undefined anyway.
+    if (constDelta->isOne() && supportDpp() && !supportPermLaneDpp())
+      return createDppMov(value, DppCtrl::DppWfSr1, 0xF, 0xF, true);
+  }
+
   Value *index = CreateSubgroupMbcnt(getInt64(UINT64_MAX), "");
   index = CreateSub(index, delta);
   return CreateSubgroupShuffle(value, index, instName);
@@ -433,6 +448,14 @@ Value *SubgroupBuilder::CreateSubgroupShuffleUp(Value *const value, Value *const
 // @param delta : The delta to shuffle from.
 // @param instName : Name to give final instruction.
 Value *SubgroupBuilder::CreateSubgroupShuffleDown(Value *const value, Value *const delta, const Twine &instName) {
+  if (auto constDelta = dyn_cast<ConstantInt>(delta)) {
+    if (constDelta->isZero())
+      return value;
+    // NOTE: Wave shift left is only available before GFX10, see CreateSubgroupShuffleUp().
+    if (constDelta->isOne() && supportDpp() && !supportPermLaneDpp())
+      return createDppMov(value, DppCtrl::DppWfSl1, 0xF, 0xF, true);
+  }
+
   Value *index = CreateSubgroupMbcnt(getInt64(UINT64_MAX), "");
   index = CreateAdd(index, delta);
   return CreateSubgroupShuffle(value, index, instName);
@@ -454,77 +477,68 @@ Value *SubgroupBuilder::CreateSubgroupClusteredReduction(GroupArithOp groupArith
 
     // Perform The group arithmetic operation between adjacent lanes in the subgroup, with all masks and rows enabled
     // (0xF).
-    result = CreateSelect(
-        CreateICmpUGE(clusterSize, getInt32(2)),
-        createGroupArithmeticOperation(groupArithOp, result,
-                                       createDppUpdate(identity, result, DppCtrl::DppQuadPerm1032, 0xF, 0xF, 0)),
-        result);
+    result = createClusterStep(clusterSize, 2, false, result, [&] {
+      return createGroupArithmeticOperation(groupArithOp, result,
+                                            createDppUpdate(identity, result, DppCtrl::DppQuadPerm1032, 0xF, 0xF, 0));
+    });
 
     // Perform The group arithmetic operation between N <-> N+2 lanes in the subgroup, with all masks and rows enabled
     // (0xF).
-    result = CreateSelect(
-        CreateICmpUGE(clusterSize, getInt32(4)),
-        createGroupArithmeticOperation(groupArithOp, result,
-                                       createDppUpdate(identity, result, DppCtrl::DppQuadPerm2301, 0xF, 0xF, 0)),
-        result);
+    result = createClusterStep(clusterSize, 4, false, result, [&] {
+      return createGroupArithmeticOperation(groupArithOp, result,
+                                            createDppUpdate(identity, result, DppCtrl::DppQuadPerm2301, 0xF, 0xF, 0));
+    });
 
     // Use a row half mirror to make all values in a cluster of 8 the same, with all masks and rows enabled (0xF).
-    result = CreateSelect(
-        CreateICmpUGE(clusterSize, getInt32(8)),
-        createGroupArithmeticOperation(groupArithOp, result,
-                                       createDppUpdate(identity, result, DppCtrl::DppRowHalfMirror, 0xF, 0xF, 0)),
-        result);
+    result = createClusterStep(clusterSize, 8, false, result, [&] {
+      return createGroupArithmeticOperation(groupArithOp, result,
+                                            createDppUpdate(identity, result, DppCtrl::DppRowHalfMirror, 0xF, 0xF, 0));
+    });
 
     // Use a row mirror to make all values in a cluster of 16 the same, with all masks and rows enabled (0xF).
-    result =
-        CreateSelect(CreateICmpUGE(clusterSize, getInt32(16)),
-                     createGroupArithmeticOperation(
-                         groupArithOp, result, createDppUpdate(identity, result, DppCtrl::DppRowMirror, 0xF, 0xF, 0)),
-                     result);
+    result = createClusterStep(clusterSize, 16, false, result, [&] {
+      return createGroupArithmeticOperation(groupArithOp, result,
+                                            createDppUpdate(identity, result, DppCtrl::DppRowMirror, 0xF, 0xF, 0));
+    });
 
     if (supportPermLaneDpp()) {
       // Use a permute lane to cross rows (row 1 <-> row 0, row 3 <-> row 2).
-      result = CreateSelect(
-          CreateICmpUGE(clusterSize, getInt32(32)),
-          createGroupArithmeticOperation(groupArithOp, result,
-                                         createPermLaneX16(result, result, UINT32_MAX, UINT32_MAX, true, false)),
-          result);
-
-      Value *const broadcast31 = CreateSubgroupBroadcast(result, getInt32(31), instName);
-      Value *const broadcast63 = CreateSubgroupBroadcast(result, getInt32(63), instName);
+      result = createClusterStep(clusterSize, 32, false, result, [&] {
+        return createGroupArithmeticOperation(groupArithOp, result,
+                                              createPermLaneX16(result, result, UINT32_MAX, UINT32_MAX, true, false));
+      });
 
       // Combine broadcast from the 31st and 63rd for the final result.
-      result = CreateSelect(CreateICmpEQ(clusterSize, getInt32(64)),
-                            createGroupArithmeticOperation(groupArithOp, broadcast31, broadcast63), result);
+      result = createClusterStep(clusterSize, 64, true, result, [&] {
+        Value *const broadcast31 = CreateSubgroupBroadcast(result, getInt32(31), instName);
+        Value *const broadcast63 = CreateSubgroupBroadcast(result, getInt32(63), instName);
+        return createGroupArithmeticOperation(groupArithOp, broadcast31, broadcast63);
+      });
     } else {
       // Use a row broadcast to move the 15th element in each cluster of 16 to the next cluster. The row mask is
       // set to 0xa (0b1010) so that only the 2nd and 4th clusters of 16 perform the calculation.
-      result = CreateSelect(
-          CreateICmpUGE(clusterSize, getInt32(32)),
-          createGroupArithmeticOperation(groupArithOp, result,
-                                         createDppUpdate(identity, result, DppCtrl::DppRowBcast15, 0xA, 0xF, 0)),
-          result);
+      result = createClusterStep(clusterSize, 32, false, result, [&] {
+        return createGroupArithmeticOperation(groupArithOp, result,
+                                              createDppUpdate(identity, result, DppCtrl::DppRowBcast15, 0xA, 0xF, 0));
+      });
 
       // Use a row broadcast to move the 31st element from the lower cluster of 32 to the upper cluster. The row
-      // mask is set to 0x8 (0b1000) so that only the upper cluster of 32 perform the calculation.
-      result = CreateSelect(
-          CreateICmpEQ(clusterSize, getInt32(64)),
-          createGroupArithmeticOperation(groupArithOp, result,
-                                         createDppUpdate(identity, result, DppCtrl::DppRowBcast31, 0x8, 0xF, 0)),
-          result);
-
-      Value *const broadcast31 = CreateSubgroupBroadcast(result, getInt32(31), instName);
-      Value *const broadcast63 = CreateSubgroupBroadcast(result, getInt32(63), instName);
-
-      // If the cluster size is 64 we always read the value from the last invocation in the subgroup.
-      result = CreateSelect(CreateICmpEQ(clusterSize, getInt32(64)), broadcast63, result);
-
-      Value *const laneIdLessThan32 = CreateICmpULT(CreateSubgroupMbcnt(getInt64(UINT64_MAX), ""), getInt32(32));
+      // mask is set to 0x8 (0b1000) so that only the upper cluster of 32 perform the calculation. If the cluster size
+      // is 64 we then always read the value from the last invocation in the subgroup.
+      result = createClusterStep(clusterSize, 64, true, result, [&] {
+        Value *const bcast31 = createGroupArithmeticOperation(
+            groupArithOp, result, createDppUpdate(identity, result, DppCtrl::DppRowBcast31, 0x8, 0xF, 0));
+        return CreateSubgroupBroadcast(bcast31, getInt32(63), instName);
+      });
 
       // If the cluster size is 32 we need to check where our invocation is in the subgroup, and conditionally use
       // invocation 31 or 63's value.
-      result = CreateSelect(CreateICmpEQ(clusterSize, getInt32(32)),
-                            CreateSelect(laneIdLessThan32, broadcast31, broadcast63), result);
+      result = createClusterStep(clusterSize, 32, true, result, [&] {
+        Value *const broadcast31 = CreateSubgroupBroadcast(result, getInt32(31), instName);
+        Value *const broadcast63 = CreateSubgroupBroadcast(result, getInt32(63), instName);
+        Value *const laneIdLessThan32 = CreateICmpULT(CreateSubgroupMbcnt(getInt64(UINT64_MAX), ""), getInt32(32));
+        return CreateSelect(laneIdLessThan32, broadcast31, broadcast63);
+      });
     }
 
     // Finish the WWM section by calling the intrinsic.
@@ -603,75 +617,38 @@ Value *SubgroupBuilder::CreateSubgroupClusteredInclusive(GroupArithOp groupArith
     Value *const setInactive = createSetInactive(value, identity);
 
     // The DPP operation has all rows active and all banks in the rows active (0xF).
-    Value *result = CreateSelect(
-        CreateICmpUGE(clusterSize, getInt32(2)),
-        createGroupArithmeticOperation(groupArithOp, setInactive,
-                                       createDppUpdate(identity, setInactive, DppCtrl::DppRowSr1, 0xF, 0xF, 0)),
-        setInactive);
+    Value *result = createClusterStep(clusterSize, 2, false, setInactive, [&] {
+      return createGroupArithmeticOperation(groupArithOp, setInactive,
+                                            createDppUpdate(identity, setInactive, DppCtrl::DppRowSr1, 0xF, 0xF, 0));
+    });
 
     // The DPP operation has all rows active and all banks in the rows active (0xF).
-    result =
-        CreateSelect(CreateICmpUGE(clusterSize, getInt32(4)),
-                     createGroupArithmeticOperation(
-                         groupArithOp, result, createDppUpdate(identity, setInactive, DppCtrl::DppRowSr2, 0xF, 0xF, 0)),
-                     result);
+    result = createClusterStep(clusterSize, 4, false, result, [&] {
+      return createGroupArithmeticOperation(groupArithOp, result,
+                                            createDppUpdate(identity, setInactive, DppCtrl::DppRowSr2, 0xF, 0xF, 0));
+    });
 
     // The DPP operation has all rows active and all banks in the rows active (0xF).
-    result =
-        CreateSelect(CreateICmpUGE(clusterSize, getInt32(4)),
-                     createGroupArithmeticOperation(
-                         groupArithOp, result, createDppUpdate(identity, setInactive, DppCtrl::DppRowSr3, 0xF, 0xF, 0)),
-                     result);
+    result = createClusterStep(clusterSize, 4, false, result, [&] {
+      return createGroupArithmeticOperation(groupArithOp, result,
+                                            createDppUpdate(identity, setInactive, DppCtrl::DppRowSr3, 0xF, 0xF, 0));
+    });
 
     // The DPP operation has all rows active (0xF) and the top 3 banks active (0xe, 0b1110) to make sure that in
     // each cluster of 16, only the top 12 lanes perform the operation.
-    result = CreateSelect(CreateICmpUGE(clusterSize, getInt32(8)),
-                          createGroupArithmeticOperation(
-                              groupArithOp, result, createDppUpdate(identity, result, DppCtrl::DppRowSr4, 0xF, 0xE, 0)),
-                          result);
+    result = createClusterStep(clusterSize, 8, false, result, [&] {
+      return createGroupArithmeticOperation(groupArithOp, result,
+                                            createDppUpdate(identity, result, DppCtrl::DppRowSr4, 0xF, 0xE, 0));
+    });
 
     // The DPP operation has all rows active (0xF) and the top 2 banks active (0xc, 0b1100) to make sure that in
     // each cluster of 16, only the top 8 lanes perform the operation.
-    result = CreateSelect(CreateICmpUGE(clusterSize, getInt32(16)),
-                          createGroupArithmeticOperation(
-                              groupArithOp, result, createDppUpdate(identity, result, DppCtrl::DppRowSr8, 0xF, 0xC, 0)),
-                          result);
-
-    if (supportPermLaneDpp()) {
-      Value *const threadMask = createThreadMask();
-
-      Value *const maskedPermLane =
-          createThreadMaskedSelect(threadMask, 0xFFFF0000FFFF0000,
-                                   createPermLaneX16(result, result, UINT32_MAX, UINT32_MAX, true, false), identity);
-
-      // Use a permute lane to cross rows (row 1 <-> row 0, row 3 <-> row 2).
-      result = CreateSelect(CreateICmpUGE(clusterSize, getInt32(32)),
-                            createGroupArithmeticOperation(groupArithOp, result, maskedPermLane), result);
-
-      Value *const broadcast31 = CreateSubgroupBroadcast(result, getInt32(31), instName);
-
-      Value *const maskedBroadcast = createThreadMaskedSelect(threadMask, 0xFFFFFFFF00000000, broadcast31, identity);
+    result = createClusterStep(clusterSize, 16, false, result, [&] {
+      return createGroupArithmeticOperation(groupArithOp, result,
+                                            createDppUpdate(identity, result, DppCtrl::DppRowSr8, 0xF, 0xC, 0));
+    });
 
-      // Combine broadcast of 31 with the top two rows only.
-      result = CreateSelect(CreateICmpEQ(clusterSize, getInt32(64)),
-                            createGroupArithmeticOperation(groupArithOp, result, maskedBroadcast), result);
-    } else {
-      // The DPP operation has a row mask of 0xa (0b1010) so only the 2nd and 4th clusters of 16 perform the
-      // operation.
-      result = CreateSelect(
-          CreateICmpUGE(clusterSize, getInt32(32)),
-          createGroupArithmeticOperation(groupArithOp, result,
-                                         createDppUpdate(identity, result, DppCtrl::DppRowBcast15, 0xA, 0xF, 0)),
-          result);
-
-      // The DPP operation has a row mask of 0xc (0b1100) so only the 3rd and 4th clusters of 16 perform the
-      // operation.
-      result = CreateSelect(
-          CreateICmpEQ(clusterSize, getInt32(64)),
-          createGroupArithmeticOperation(groupArithOp, result,
-                                         createDppUpdate(identity, result, DppCtrl::DppRowBcast31, 0xC, 0xF, 0)),
-          result);
-    }
+    result = createScanAcrossRows(groupArithOp, result, identity, clusterSize, instName);
 
     // Finish the WWM section by calling the intrinsic.
     return createWwm(result);
@@ -780,75 +757,38 @@ Value *SubgroupBuilder::CreateSubgroupClusteredExclusive(GroupArithOp groupArith
     }
 
     // The DPP operation has all rows active and all banks in the rows active (0xF).
-    Value *result = CreateSelect(
-        CreateICmpUGE(clusterSize, getInt32(2)),
-        createGroupArithmeticOperation(groupArithOp, shiftRight,
-                                       createDppUpdate(identity, shiftRight, DppCtrl::DppRowSr1, 0xF, 0xF, 0)),
-        shiftRight);
+    Value *result = createClusterStep(clusterSize, 2, false, shiftRight, [&] {
+      return createGroupArithmeticOperation(groupArithOp, shiftRight,
+                                            createDppUpdate(identity, shiftRight, DppCtrl::DppRowSr1, 0xF, 0xF, 0));
+    });
 
     // The DPP operation has all rows active and all banks in the rows active (0xF).
-    result =
-        CreateSelect(CreateICmpUGE(clusterSize, getInt32(4)),
-                     createGroupArithmeticOperation(
-                         groupArithOp, result, createDppUpdate(identity, shiftRight, DppCtrl::DppRowSr2, 0xF, 0xF, 0)),
-                     result);
+    result = createClusterStep(clusterSize, 4, false, result, [&] {
+      return createGroupArithmeticOperation(groupArithOp, result,
+                                            createDppUpdate(identity, shiftRight, DppCtrl::DppRowSr2, 0xF, 0xF, 0));
+    });
 
     // The DPP operation has all rows active and all banks in the rows active (0xF).
-    result =
-        CreateSelect(CreateICmpUGE(clusterSize, getInt32(4)),
-                     createGroupArithmeticOperation(
-                         groupArithOp, result, createDppUpdate(identity, shiftRight, DppCtrl::DppRowSr3, 0xF, 0xF, 0)),
-                     result);
+    result = createClusterStep(clusterSize, 4, false, result, [&] {
+      return createGroupArithmeticOperation(groupArithOp, result,
+                                            createDppUpdate(identity, shiftRight, DppCtrl::DppRowSr3, 0xF, 0xF, 0));
+    });
 
     // The DPP operation has all rows active (0xF) and the top 3 banks active (0xe, 0b1110) to make sure that in
     // each cluster of 16, only the top 12 lanes perform the operation.
-    result = CreateSelect(CreateICmpUGE(clusterSize, getInt32(8)),
-                          createGroupArithmeticOperation(
-                              groupArithOp, result, createDppUpdate(identity, result, DppCtrl::DppRowSr4, 0xF, 0xE, 0)),
-                          result);
+    result = createClusterStep(clusterSize, 8, false, result, [&] {
+      return createGroupArithmeticOperation(groupArithOp, result,
+                                            createDppUpdate(identity, result, DppCtrl::DppRowSr4, 0xF, 0xE, 0));
+    });
 
     // The DPP operation has all rows active (0xF) and the top 2 banks active (0xc, 0b1100) to make sure that in
     // each cluster of 16, only the top 8 lanes perform the operation.
-    result = CreateSelect(CreateICmpUGE(clusterSize, getInt32(16)),
-                          createGroupArithmeticOperation(
-                              groupArithOp, result, createDppUpdate(identity, result, DppCtrl::DppRowSr8, 0xF, 0xC, 0)),
-                          result);
-
-    if (supportPermLaneDpp()) {
-      Value *const threadMask = createThreadMask();
+    result = createClusterStep(clusterSize, 16, false, result, [&] {
+      return createGroupArithmeticOperation(groupArithOp, result,
+                                            createDppUpdate(identity, result, DppCtrl::DppRowSr8, 0xF, 0xC, 0));
+    });
 
-      Value *const maskedPermLane =
-          createThreadMaskedSelect(threadMask, 0xFFFF0000FFFF0000,
-                                   createPermLaneX16(result, result, UINT32_MAX, UINT32_MAX, true, false), identity);
-
-      // Use a permute lane to cross rows (row 1 <-> row 0, row 3 <-> row 2).
-      result = CreateSelect(CreateICmpUGE(clusterSize, getInt32(32)),
-                            createGroupArithmeticOperation(groupArithOp, result, maskedPermLane), result);
-
-      Value *const broadcast31 = CreateSubgroupBroadcast(result, getInt32(31), instName);
-
-      Value *const maskedBroadcast = createThreadMaskedSelect(threadMask, 0xFFFFFFFF00000000, broadcast31, identity);
-
-      // Combine broadcast of 31 with the top two rows only.
-      result = CreateSelect(CreateICmpEQ(clusterSize, getInt32(64)),
-                            createGroupArithmeticOperation(groupArithOp, result, maskedBroadcast), result);
-    } else {
-      // The DPP operation has a row mask of 0xa (0b1010) so only the 2nd and 4th clusters of 16 perform the
-      // operation.
-      result = CreateSelect(
-          CreateICmpUGE(clusterSize, getInt32(32)),
-          createGroupArithmeticOperation(groupArithOp, result,
-                                         createDppUpdate(identity, result, DppCtrl::DppRowBcast15, 0xA, 0xF, 0)),
-          result);
-
-      // The DPP operation has a row mask of 0xc (0b1100) so only the 3rd and 4th clusters of 16 perform the
-      // operation.
-      result = CreateSelect(
-          CreateICmpEQ(clusterSize, getInt32(64)),
-          createGroupArithmeticOperation(groupArithOp, result,
-                                         createDppUpdate(identity, result, DppCtrl::DppRowBcast31, 0xC, 0xF, 0)),
-          result);
-    }
+    result = createScanAcrossRows(groupArithOp, result, identity, clusterSize, instName);
 
     // Finish the WWM section by calling the intrinsic.
     return createWwm(result);
@@ -934,6 +874,14 @@ Value *SubgroupBuilder::CreateSubgroupQuadBroadcast(Value *const value, Value *c
 
   const unsigned indexBits = index->getType()->getPrimitiveSizeInBits();
 
+  // A constant index needs just the one quad_perm DPP mov that broadcasts that lane.
+  if (auto constIndex = dyn_cast<ConstantInt>(index)) {
+    if (supportDpp() && constIndex->getZExtValue() < 4) {
+      const unsigned lane = constIndex->getZExtValue();
+      return createDppMov(value, getDppQuadPerm(lane, lane, lane, lane), 0xF, 0xF, false);
+    }
+  }
+
   if (supportDpp()) {
     Value *compare = CreateICmpEQ(index, getIntN(indexBits, 0));
     result = CreateSelect(compare, createDppMov(value, DppCtrl::DppQuadPerm0000, 0xF, 0xF, false), result);
@@ -1012,6 +960,9 @@ Value *SubgroupBuilder::CreateSubgroupSwizzleQuad(Value *const value, Value *con
   uint8_t lane2 = static_cast<uint8_t>(cast<ConstantInt>(constOffset->getAggregateElement(2u))->getZExtValue());
   uint8_t lane3 = static_cast<uint8_t>(cast<ConstantInt>(constOffset->getAggregateElement(3u))->getZExtValue());
 
+  // Prefer a quad_perm DPP mov, which stays in the VALU, over ds_swizzle, which goes through the LDS unit.
+  if (supportDpp())
+    return createDppMov(value, getDppQuadPerm(lane0, lane1, lane2, lane3), 0xF, 0xF, false);
   return createDsSwizzle(value, getDsSwizzleQuadMode(lane0, lane1, lane2, lane3));
 }
 
@@ -1029,6 +980,15 @@ Value *SubgroupBuilder::CreateSubgroupSwizzleMask(Value *const value, Value *con
 
   assert(andMask <= 31 && orMask <= 31 && xorMask <= 31);
 
+  // If the masks keep the quad bits of the lane ID and only move lanes within a quad, the swizzle is a quad
+  // permutation, which is a DPP mov rather than a ds_swizzle.
+  if (supportDpp() && (andMask & 0x1C) == 0x1C && (orMask & 0x1C) == 0 && (xorMask & 0x1C) == 0) {
+    uint8_t lanes[4] = {};
+    for (uint8_t lane = 0; lane < 4; ++lane)
+      lanes[lane] = (((lane & andMask) | orMask) ^ xorMask) & 0x3;
+    return createDppMov(value, getDppQuadPerm(lanes[0], lanes[1], lanes[2], lanes[3]), 0xF, 0xF, false);
+  }
+
   return createDsSwizzle(value, getDsSwizzleBitMode(xorMask, orMask, andMask));
 }
 
@@ -1366,6 +1326,93 @@ uint16_t SubgroupBuilder::getDsSwizzleQuadMode(uint8_t lane0, uint8_t lane1, uin
   return 0x8000 | static_cast<uint16_t>((lane3 << 6) | ((lane2 & 0x3) << 4) | ((lane1 & 0x3) << 2) | ((lane0 & 0x3)));
 }
 
+// =====================================================================================================================
+// Get the DPP control for a quad_perm: each lane of a quad reads the given lane of the same quad.
+//
+// @param lane0 : The lane to read for lane 0 of the quad.
+// @param lane1 : The lane to read for lane 1 of the quad.
+// @param lane2 : The lane to read for lane 2 of the quad.
+// @param lane3 : The lane to read for lane 3 of the quad.
+SubgroupBuilder::DppCtrl SubgroupBuilder::getDppQuadPerm(uint8_t lane0, uint8_t lane1, uint8_t lane2, uint8_t lane3) {
+  return static_cast<DppCtrl>(((lane3 & 0x3) << 6) | ((lane2 & 0x3) << 4) | ((lane1 & 0x3) << 2) | (lane0 & 0x3));
+}
+
+// =====================================================================================================================
+// Create one step of a clustered subgroup operation, which only applies when the cluster size is at least (or exactly)
+// the size that the step handles. The step is not generated at all if it can never apply, that is if it is for a
+// cluster bigger than the subgroup, or if the cluster size is a constant that does not need it. So a full-subgroup
+// operation in wave32 gets no wave64 step, and a constant cluster size gets no dead DPP operations and selects.
+//
+// @param clusterSize : The cluster size.
+// @param stepClusterSize : The cluster size that the step is for.
+// @param exactMatch : Whether the step only applies to that exact cluster size, rather than to that size and above.
+// @param result : The result before the step.
+// @param createStep : Callback that generates the step, returning the result after it.
+Value *SubgroupBuilder::createClusterStep(Value *const clusterSize, unsigned stepClusterSize, bool exactMatch,
+                                          Value *const result, function_ref<Value *()> createStep) {
+  if (stepClusterSize > getShaderSubgroupSize())
+    return result;
+
+  if (auto constClusterSize = dyn_cast<ConstantInt>(clusterSize)) {
+    const uint64_t size = constClusterSize->getZExtValue();
+    const bool applies = exactMatch ? size == stepClusterSize : size >= stepClusterSize;
+    return applies ? createStep() : result;
+  }
+
+  Value *const applies = exactMatch ? CreateICmpEQ(clusterSize, getInt32(stepClusterSize))
+                                    : CreateICmpUGE(clusterSize, getInt32(stepClusterSize));
+  return CreateSelect(applies, createStep(), result);
+}
+
+// =====================================================================================================================
+// Create the steps of a clustered inclusive scan that cross rows of 16 lanes, for cluster sizes 32 and 64. The scan
+// must already have been done within each row.
+//
+// @param groupArithOp : The group arithmetic operation.
+// @param result : The result of the scan within each row.
+// @param identity : The identity value of the group arithmetic operation.
+// @param clusterSize : The cluster size.
+// @param instName : Name to give final instruction.
+Value *SubgroupBuilder::createScanAcrossRows(GroupArithOp groupArithOp, Value *result, Value *const identity,
+                                             Value *const clusterSize, const Twine &instName) {
+  if (supportPermLaneDpp()) {
+    Value *threadMask = nullptr;
+
+    // Use a permute lane to cross rows (row 1 <-> row 0, row 3 <-> row 2).
+    result = createClusterStep(clusterSize, 32, false, result, [&] {
+      threadMask = createThreadMask();
+      Value *const maskedPermLane =
+          createThreadMaskedSelect(threadMask, 0xFFFF0000FFFF0000,
+                                   createPermLaneX16(result, result, UINT32_MAX, UINT32_MAX, true, false), identity);
+      return createGroupArithmeticOperation(groupArithOp, result, maskedPermLane);
+    });
+
+    // Combine broadcast of 31 with the top two rows only.
+    result = createClusterStep(clusterSize, 64, true, result, [&] {
+      if (!threadMask)
+        threadMask = createThreadMask();
+      Value *const broadcast31 = CreateSubgroupBroadcast(result, getInt32(31), instName);
+      Value *const maskedBroadcast = createThreadMaskedSelect(threadMask, 0xFFFFFFFF00000000, broadcast31, identity);
+      return createGroupArithmeticOperation(groupArithOp, result, maskedBroadcast);
+    });
+  } else {
+    // The DPP operation has a row mask of 0xa (0b1010) so only the 2nd and 4th clusters of 16 perform the
+    // operation.
+    result = createClusterStep(clusterSize, 32, false, result, [&] {
+      return createGroupArithmeticOperation(groupArithOp, result,
+                                            createDppUpdate(identity, result, DppCtrl::DppRowBcast15, 0xA, 0xF, 0));
+    });
+
+    // The DPP operation has a row mask of 0xc (0b1100) so only the 3rd and 4th clusters of 16 perform the
+    // operation.
+    result = createClusterStep(clusterSize, 64, true, result, [&] {
+      return createGroupArithmeticOperation(groupArithOp, result,
+                                            createDppUpdate(identity, result, DppCtrl::DppRowBcast31, 0xC, 0xF, 0));
+    });
+  }
+  return result;
+}
+
 // =====================================================================================================================
 // Create a thread mask for the current thread, an integer with a single bit representing the ID of the thread set to 1.
 Value *SubgroupBuilder::createThreadMask() {
@@ -1423,3 +1470,18 @@ Value *SubgroupBuilder::createGroupBallot(Value *const value) {
 
   return result;
 }
+
+// =====================================================================================================================
+// Get whether a value is known to be the same in every invocation of the subgroup. This is conservative: it only
+// recognizes constants and the results of lane reads.
+//
+// @param value : The value to check.
+bool SubgroupBuilder::isKnownUniform(Value *const value) const {
+  if (isa<Constant>(value))
+    return true;
+  if (auto intrinsic = dyn_cast<IntrinsicInst>(value)) {
+    return intrinsic->getIntrinsicID() == Intrinsic::amdgcn_readfirstlane ||
+           intrinsic->getIntrinsicID() == Intrinsic::amdgcn_readlane;
+  }
+  return false;
+}
@@ -760,75 +760,57 @@ Value *YCbCrConverter::convertColor(Type *resultTy, SamplerYCbCrModelConversion
     // inputVec = RangeExpaned(C'_rgba)
     Value *inputVec = m_builder->CreateFClamp(rangeExpand(range, channelBits, subImage), minVec, maxVec);
 
-    Value *row0 = UndefValue::get(FixedVectorType::get(m_builder->getFloatTy(), 3));
-    Value *row1 = UndefValue::get(FixedVectorType::get(m_builder->getFloatTy(), 3));
-    Value *row2 = UndefValue::get(FixedVectorType::get(m_builder->getFloatTy(), 3));
-
+    // The conversion matrices all have the form
+    //
+    //           [r0c0,   1.0f,   0.0f]
+    // convMat = [r1c0,   1.0f,   r1c2]
+    //           [0.0f,   1.0f,   r2c2]
+    //
+    // so instead of full dot products, only the four non-trivial coefficients are applied.
+    float r0c0 = 0.0f;
+    float r1c0 = 0.0f;
+    float r1c2 = 0.0f;
+    float r2c2 = 0.0f;
     if (colorModel == SamplerYCbCrModelConversion::YCbCr601) {
-
       //           [            1.402f,   1.0f,               0.0f]
       // convMat = [-0.419198 / 0.587f,   1.0f, -0.202008 / 0.587f]
       //           [              0.0f,   1.0f,             1.772f]
-      row0 = m_builder->CreateInsertElement(row0, ConstantFP::get(m_builder->getFloatTy(), 1.402f), uint64_t(0));
-      row0 = m_builder->CreateInsertElement(row0, ConstantFP::get(m_builder->getFloatTy(), 1.0f), uint64_t(1));
-      row0 = m_builder->CreateInsertElement(row0, ConstantFP::get(m_builder->getFloatTy(), 0.0f), uint64_t(2));
-
-      float row1Col0 = static_cast<float>(-0.419198 / 0.587);
-      float row1Col2 = static_cast<float>(-0.202008 / 0.587);
-
-      row1 = m_builder->CreateInsertElement(row1, ConstantFP::get(m_builder->getFloatTy(), row1Col0), uint64_t(0));
-      row1 = m_builder->CreateInsertElement(row1, ConstantFP::get(m_builder->getFloatTy(), 1.0f), uint64_t(1));
-      row1 = m_builder->CreateInsertElement(row1, ConstantFP::get(m_builder->getFloatTy(), row1Col2), uint64_t(2));
-
-      row2 = m_builder->CreateInsertElement(row2, ConstantFP::get(m_builder->getFloatTy(), 0.0f), uint64_t(0));
-      row2 = m_builder->CreateInsertElement(row2, ConstantFP::get(m_builder->getFloatTy(), 1.0f), uint64_t(1));
-      row2 = m_builder->CreateInsertElement(row2, ConstantFP::get(m_builder->getFloatTy(), 1.772f), uint64_t(2));
+      r0c0 = 1.402f;
+      r1c0 = static_cast<float>(-0.419198 / 0.587);
+      r1c2 = static_cast<float>(-0.202008 / 0.587);
+      r2c2 = 1.772f;
     } else if (colorModel == SamplerYCbCrModelConversion::YCbCr709) {
-
       //           [              1.5748f,   1.0f,                  0.0f]
       // convMat = [-0.33480248 / 0.7152f,   1.0f, -0.13397432 / 0.7152f]
       //           [                 0.0f,   1.0f,               1.8556f]
-      row0 = m_builder->CreateInsertElement(row0, ConstantFP::get(m_builder->getFloatTy(), 1.5748f), uint64_t(0));
-      row0 = m_builder->CreateInsertElement(row0, ConstantFP::get(m_builder->getFloatTy(), 1.0f), uint64_t(1));
-      row0 = m_builder->CreateInsertElement(row0, ConstantFP::get(m_builder->getFloatTy(), 0.0f), uint64_t(2));
-
-      float row1Col0 = static_cast<float>(-0.33480248 / 0.7152);
-      float row1Col2 = static_cast<float>(-0.13397432 / 0.7152);
-
-      row1 = m_builder->CreateInsertElement(row1, ConstantFP::get(m_builder->getFloatTy(), row1Col0), uint64_t(0));
-      row1 = m_builder->CreateInsertElement(row1, ConstantFP::get(m_builder->getFloatTy(), 1.0f), uint64_t(1));
-      row1 = m_builder->CreateInsertElement(row1, ConstantFP::get(m_builder->getFloatTy(), row1Col2), uint64_t(2));
-
-      row2 = m_builder->CreateInsertElement(row2, ConstantFP::get(m_builder->getFloatTy(), 0.0f), uint64_t(0));
-      row2 = m_builder->CreateInsertElement(row2, ConstantFP::get(m_builder->getFloatTy(), 1.0f), uint64_t(1));
-      row2 = m_builder->CreateInsertElement(row2, ConstantFP::get(m_builder->getFloatTy(), 1.8556f), uint64_t(2));
+      r0c0 = 1.5748f;
+      r1c0 = static_cast<float>(-0.33480248 / 0.7152);
+      r1c2 = static_cast<float>(-0.13397432 / 0.7152);
+      r2c2 = 1.8556f;
     } else {
-
       //           [              1.4746f,   1.0f,                  0.0f]
       // convMat = [-0.38737742 / 0.6780f,   1.0f, -0.11156702 / 0.6780f]
       //           [                 0.0f,   1.0f,               1.8814f]
-      row0 = m_builder->CreateInsertElement(row0, ConstantFP::get(m_builder->getFloatTy(), 1.4746f), uint64_t(0));
-      row0 = m_builder->CreateInsertElement(row0, ConstantFP::get(m_builder->getFloatTy(), 1.0f), uint64_t(1));
-      row0 = m_builder->CreateInsertElement(row0, ConstantFP::get(m_builder->getFloatTy(), 0.0f), uint64_t(2));
-
-      float row1Col0 = static_cast<float>(-0.38737742 / 0.6780);
-      float row1Col2 = static_cast<float>(-0.11156702 / 0.6780);
-
-      row1 = m_builder->CreateInsertElement(row1, ConstantFP::get(m_builder->getFloatTy(), row1Col0), uint64_t(0));
-      row1 = m_builder->CreateInsertElement(row1, ConstantFP::get(m_builder->getFloatTy(), 1.0f), uint64_t(1));
-      row1 = m_builder->CreateInsertElement(row1, ConstantFP::get(m_builder->getFloatTy(), row1Col2), uint64_t(2));
-
-      row2 = m_builder->CreateInsertElement(row2, ConstantFP::get(m_builder->getFloatTy(), 0.0f), uint64_t(0));
-      row2 = m_builder->CreateInsertElement(row2, ConstantFP::get(m_builder->getFloatTy(), 1.0f), uint64_t(1));
-      row2 = m_builder->CreateInsertElement(row2, ConstantFP::get(m_builder->getFloatTy(), 1.8814f), uint64_t(2));
+      r0c0 = 1.4746f;
+      r1c0 = static_cast<float>(-0.38737742 / 0.6780);
+      r1c2 = static_cast<float>(-0.11156702 / 0.6780);
+      r2c2 = 1.8814f;
     }
 
+    Value *inputCr = m_builder->CreateExtractElement(inputVec, m_builder->getInt64(0));
+    Value *inputY = m_builder->CreateExtractElement(inputVec, m_builder->getInt64(1));
+    Value *inputCb = m_builder->CreateExtractElement(inputVec, m_builder->getInt64(2));
+    auto multiplyAdd = [this](float coeff, Value *input, Value *addend) {
+      return m_builder->CreateFAdd(m_builder->CreateFMul(ConstantFP::get(m_builder->getFloatTy(), coeff), input),
+                                   addend);
+    };
+
     // output[R]             [Cr]
     // output[G] = convMat * [ Y]
     // output[B]             [Cb]
-    Value *outputR = m_builder->CreateDotProduct(row0, inputVec);
-    Value *outputG = m_builder->CreateDotProduct(row1, inputVec);
-    Value *outputB = m_builder->CreateDotProduct(row2, inputVec);
+    Value *outputR = multiplyAdd(r0c0, inputCr, inputY);
+    Value *outputG = multiplyAdd(r1c2, inputCb, multiplyAdd(r1c0, inputCr, inputY));
+    Value *outputB = multiplyAdd(r2c2, inputCb, inputY);
     Value *outputA = m_builder->CreateExtractElement(imageOp, m_builder->getInt64(3));
 
     result = m_builder->CreateInsertElement(result, outputR, m_builder->getInt64(0));
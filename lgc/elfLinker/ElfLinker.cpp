@@ -35,6 +35,7 @@
 #include "lgc/state/PalMetadata.h"
 #include "lgc/state/PipelineState.h"
 #include "lgc/state/TargetInfo.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/BinaryFormat/ELF.h"
 #include "llvm/Object/ELFObjectFile.h"
@@ -153,7 +154,7 @@ public:
   PipelineState *getPipelineState() const { return m_pipelineState; }
   ArrayRef<OutputSection> getOutputSections() { return m_outputSections; }
   StringRef getStrings() { return m_strings; }
-  SmallVectorImpl<ELF::Elf64_Sym> &getSymbols() { return m_symbols; }
+  ArrayRef<ELF::Elf64_Sym> getSymbols() { return m_symbols; }
   void setStringTableIndex(unsigned index) { m_ehdr.e_shstrndx = index; }
   StringRef getNotes() { return m_notes; }
 
@@ -163,6 +164,9 @@ public:
   // Find symbol in output ELF
   unsigned findSymbol(unsigned nameIndex);
 
+  // Add symbol to output ELF
+  void addSymbol(const ELF::Elf64_Sym &sym);
+
 private:
   // Get the value of the symbol referenced in a reloc
   uint64_t getRelocValue(object::RelocationRef reloc);
@@ -190,10 +194,11 @@ private:
   ELF::Elf64_Ehdr m_ehdr;                                    // Output ELF header, copied from first input
   SmallVector<OutputSection, 4> m_outputSections;            // Output sections
   SmallVector<ELF::Elf64_Sym, 8> m_symbols;                  // Symbol table
-  StringMap<unsigned> m_symbolMap;                           // Map from name to symbol index
+  DenseMap<unsigned, unsigned> m_symbolMap;                  // Map from name string index to symbol index
   std::string m_strings;                                     // Strings for string table
   StringMap<unsigned> m_stringMap;                           // Map from string to string table index
   std::string m_notes;                                       // Notes to go in .note section
+  StringMap<uint64_t> m_relocValues;                         // Map from reloc symbol name to its resolved value
 };
 
 } // anonymous namespace
@@ -257,6 +262,15 @@ void ElfLinkerImpl::createGlueShaders() {
     m_glueShaders.push_back(
         std::unique_ptr<GlueShader>(GlueShader::createFetchShader(m_pipelineState, fetches, vsEntryRegInfo)));
   }
+
+  // Create a color export shader object if we need one.
+  SmallVector<ColorExportInfo, 8> exports;
+  FsExportInfo fsInfo = {};
+  m_pipelineState->getPalMetadata()->getColorExportInfo(exports, fsInfo);
+  if (!exports.empty()) {
+    m_glueShaders.push_back(
+        std::unique_ptr<GlueShader>(GlueShader::createColorExportShader(m_pipelineState, exports, fsInfo)));
+  }
 }
 
 // =====================================================================================================================
@@ -289,7 +303,7 @@ ArrayRef<StringRef> ElfLinkerImpl::getGlueInfo() {
 // @param glueIndex : Index into the array that was returned by getGlueInfo()
 // @param blob : Blob for the glue code
 void ElfLinkerImpl::addGlue(unsigned glueIndex, StringRef blob) {
-  llvm_unreachable("Not implemented");
+  m_glueShaders[glueIndex]->setElfBlob(blob);
 }
 
 // =====================================================================================================================
@@ -495,11 +509,19 @@ unsigned ElfLinkerImpl::getStringIndex(StringRef string) {
 // @param nameIndex : Index of symbol name in string table
 // @return : Index in symbol table, or 0 if not found
 unsigned ElfLinkerImpl::findSymbol(unsigned nameIndex) {
-  for (auto &sym : getSymbols()) {
-    if (sym.st_name == nameIndex)
-      return &sym - getSymbols().data();
-  }
-  return 0;
+  auto it = m_symbolMap.find(nameIndex);
+  if (it == m_symbolMap.end())
+    return 0;
+  return it->second;
+}
+
+// =====================================================================================================================
+// Add symbol to output ELF
+//
+// @param sym : Symbol to append to the symbol table
+void ElfLinkerImpl::addSymbol(const ELF::Elf64_Sym &sym) {
+  m_symbolMap.insert({sym.st_name, m_symbols.size()});
+  m_symbols.push_back(sym);
 }
 
 // =====================================================================================================================
@@ -507,10 +529,17 @@ unsigned ElfLinkerImpl::findSymbol(unsigned nameIndex) {
 uint64_t ElfLinkerImpl::getRelocValue(object::RelocationRef reloc) {
   StringRef name = cantFail(reloc.getSymbol()->getName());
 
+  // The same descriptor is typically relocated many times, so resolve each distinct name only once.
+  auto cachedValue = m_relocValues.find(name);
+  if (cachedValue != m_relocValues.end())
+    return cachedValue->second;
+
   // Handle the special case relocs from pipeline state
   uint64_t value = 0;
-  if (m_relocHandler.getValue(name, value))
+  if (m_relocHandler.getValue(name, value)) {
+    m_relocValues[name] = value;
     return value;
+  }
 
   // TODO: Handle a reloc to a symbol, so we are then able to generate a shader ELF with its constant pools
   // in a separate .rodata section that gets merged into .text in the linker.
@@ -751,7 +780,7 @@ void OutputSection::addSymbol(const object::ELFSymbolRef &elfSymRef, unsigned in
   newSym.st_size = elfSymRef.getSize();
   if (m_linker->findSymbol(newSym.st_name) != 0)
     report_fatal_error("Duplicate symbol '" + name + "'");
-  m_linker->getSymbols().push_back(newSym);
+  m_linker->addSymbol(newSym);
 }
 
 // =====================================================================================================================
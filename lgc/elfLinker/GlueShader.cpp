@@ -30,12 +30,18 @@
  */
 #include "GlueShader.h"
 #include "lgc/BuilderBase.h"
+#include "lgc/patch/FragColorExport.h"
 #include "lgc/patch/ShaderInputs.h"
 #include "lgc/patch/VertexFetch.h"
+#include "lgc/state/AbiMetadata.h"
+#include "lgc/state/AbiUnlinked.h"
+#include "lgc/state/IntrinsDefs.h"
+#include "lgc/state/PalMetadata.h"
 #include "lgc/state/PassManagerCache.h"
 #include "lgc/state/ShaderStage.h"
 #include "lgc/state/TargetInfo.h"
 #include "lgc/util/AddressExtender.h"
+#include "lgc/util/Internal.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/Function.h"
@@ -54,8 +60,10 @@ void GlueShader::compile(raw_pwrite_stream &outStream) {
   // Generate the glue shader IR module.
   std::unique_ptr<Module> module(generate());
 
-  // Add empty PAL metadata, to ensure that the back-end writes its PAL metadata in MsgPack format.
+  // Add PAL metadata (empty apart from any registers set by the glue shader itself), to ensure that the back-end
+  // writes its PAL metadata in MsgPack format.
   PalMetadata *palMetadata = new PalMetadata(nullptr);
+  updatePalMetadata(*palMetadata);
   palMetadata->record(&*module);
   delete palMetadata;
 
@@ -103,6 +111,46 @@ private:
   std::string m_shaderString;
 };
 
+// =====================================================================================================================
+// A color export shader
+class ColorExportShader : public GlueShader {
+public:
+  ColorExportShader(PipelineState *pipelineState, ArrayRef<ColorExportInfo> exports, const FsExportInfo &fsInfo);
+  ~ColorExportShader() override {}
+
+  // Get the string for this glue shader. This is some encoding or hash of the inputs to the create*Shader function
+  // that the front-end client can use as a cache key to avoid compiling the same glue shader more than once.
+  StringRef getString() override;
+
+  // Get the symbol name of the main shader that this glue shader is prolog or epilog for.
+  StringRef getMainShaderName() override;
+
+  // Get the name of this glue shader.
+  StringRef getName() const override { return "color export shader"; }
+
+protected:
+  // Generate the glue shader to IR module
+  Module *generate() override;
+
+  // Add the glue shader's own register settings to its PAL metadata
+  void updatePalMetadata(PalMetadata &palMetadata) override;
+
+private:
+  Function *createColorExportFunc();
+
+  // The information stored here is all that is needed to generate the color export shader. As with the fetch
+  // shader, the parts of PipelineState that it depends on (the export format and live channels of each output)
+  // are worked out in the constructor, so the front-end can use the information as the key for a cache of glue
+  // shaders.
+  SmallVector<ColorExportInfo, 8> m_exports;
+  FsExportInfo m_fsInfo;
+  SmallVector<ExportFormat, 8> m_expFmts;
+  SmallVector<unsigned, 8> m_channelMasks;
+  SmallVector<unsigned, 8> m_hwColorTargets;
+  // The encoded or hashed (in some way) single string version of the above.
+  std::string m_shaderString;
+};
+
 } // anonymous namespace
 
 // =====================================================================================================================
@@ -112,6 +160,13 @@ GlueShader *GlueShader::createFetchShader(PipelineState *pipelineState, ArrayRef
   return new FetchShader(pipelineState, fetches, vsEntryRegInfo);
 }
 
+// =====================================================================================================================
+// Create a color export shader object
+GlueShader *GlueShader::createColorExportShader(PipelineState *pipelineState, ArrayRef<ColorExportInfo> exports,
+                                                const FsExportInfo &fsInfo) {
+  return new ColorExportShader(pipelineState, exports, fsInfo);
+}
+
 // =====================================================================================================================
 // Constructor. This is where we store all the information needed to generate the fetch shader; other methods
 // do not need to look at PipelineState.
@@ -282,3 +337,186 @@ Function *FetchShader::createFetchFunc() {
 
   return func;
 }
+
+// =====================================================================================================================
+// Constructor. This is where we store all the information needed to generate the color export shader; other
+// methods do not need to look at PipelineState.
+ColorExportShader::ColorExportShader(PipelineState *pipelineState, ArrayRef<ColorExportInfo> exports,
+                                     const FsExportInfo &fsInfo)
+    : GlueShader(pipelineState->getLgcContext()), m_fsInfo(fsInfo) {
+  m_exports.append(exports.begin(), exports.end());
+
+  // An output without a color export format is not exported, and does not take up a hardware color target, the
+  // same as when PatchResourceCollect drops it in a compile that has the formats.
+  const bool dualSourceBlendEnable = pipelineState->getColorExportState().dualSourceBlendEnable;
+  unsigned hwColorTarget = 0;
+  for (const auto &exp : m_exports) {
+    unsigned location = dualSourceBlendEnable && exp.location == 1 ? 0 : exp.location;
+    if (pipelineState->getColorExportFormat(location).dfmt == BufDataFormatInvalid) {
+      m_expFmts.push_back(EXP_FORMAT_ZERO);
+      m_channelMasks.push_back(0);
+      m_hwColorTargets.push_back(InvalidValue);
+      continue;
+    }
+    m_expFmts.push_back(static_cast<ExportFormat>(pipelineState->computeExportFormat(exp.ty, exp.location)));
+    m_channelMasks.push_back(pipelineState->computeExportChannelMask(exp.location));
+    m_hwColorTargets.push_back(hwColorTarget++);
+  }
+}
+
+// =====================================================================================================================
+// Get the string for this color export shader. This is some encoding or hash of the inputs to the
+// createColorExportShader function that the front-end client can use as a cache key to avoid compiling the same glue
+// shader more than once.
+StringRef ColorExportShader::getString() {
+  if (m_shaderString.empty()) {
+    m_shaderString = getName().str();
+    for (unsigned idx = 0; idx != m_exports.size(); ++idx) {
+      const ColorExportInfo &exp = m_exports[idx];
+      unsigned fields[] = {exp.location, exp.isSigned, m_expFmts[idx], m_channelMasks[idx], m_hwColorTargets[idx]};
+      m_shaderString += StringRef(reinterpret_cast<const char *>(fields), sizeof(fields));
+      m_shaderString += getTypeName(exp.ty);
+      m_shaderString += StringRef("\0", 1);
+    }
+    m_shaderString += StringRef(reinterpret_cast<const char *>(&m_fsInfo), sizeof(m_fsInfo));
+  }
+  return m_shaderString;
+}
+
+// =====================================================================================================================
+// Get the symbol name of the main shader that this glue shader is prolog or epilog for
+StringRef ColorExportShader::getMainShaderName() {
+  return getEntryPointName(CallingConv::AMDGPU_PS, /*isFetchlessVs=*/false);
+}
+
+// =====================================================================================================================
+// Generate the IR module for the color export shader
+Module *ColorExportShader::generate() {
+  // Create the function.
+  Function *colorExportFunc = createColorExportFunc();
+  auto ret = cast<ReturnInst>(colorExportFunc->back().getTerminator());
+  BuilderBase builder(ret);
+
+  // Rebuild each output from the float args it was returned in, and export it.
+  std::unique_ptr<FragColorExport> fragColorExport(new FragColorExport(&getContext()));
+  CallInst *lastExport = nullptr;
+  unsigned argIdx = 0;
+  for (unsigned idx = 0; idx != m_exports.size(); ++idx) {
+    const ColorExportInfo &exp = m_exports[idx];
+    Type *compTy = exp.ty->getScalarType();
+    unsigned compCount = exp.ty->isVectorTy() ? cast<FixedVectorType>(exp.ty)->getNumElements() : 1;
+    unsigned firstArgIdx = argIdx;
+    argIdx += compCount;
+    if (m_hwColorTargets[idx] == InvalidValue)
+      continue;
+
+    Value *output = UndefValue::get(exp.ty);
+    for (unsigned compIdx = 0; compIdx != compCount; ++compIdx) {
+      // Leave the channels that can never reach the color target as undef.
+      if ((m_channelMasks[idx] & (1 << compIdx)) == 0)
+        continue;
+      Value *comp = colorExportFunc->getArg(firstArgIdx + compIdx);
+      unsigned bitWidth = compTy->getPrimitiveSizeInBits();
+      if (bitWidth < 32)
+        comp = builder.CreateTrunc(builder.CreateBitCast(comp, builder.getInt32Ty()), builder.getIntNTy(bitWidth));
+      comp = builder.CreateBitCast(comp, compTy);
+      output = compCount == 1 ? comp : builder.CreateInsertElement(output, comp, compIdx);
+    }
+
+    Value *exportInst =
+        fragColorExport->run(output, m_hwColorTargets[idx], ret, m_expFmts[idx], exp.isSigned, m_channelMasks[idx]);
+    if (exportInst)
+      lastExport = cast<CallInst>(exportInst);
+  }
+
+  if (!lastExport) {
+    // Nothing was exported. The wave still needs an export with "done" set: a dummy export to MRT0 if the fragment
+    // shader needs one, otherwise a null export.
+    Value *undef = UndefValue::get(builder.getFloatTy());
+    lastExport = builder.CreateIntrinsic(Intrinsic::amdgcn_exp, builder.getFloatTy(),
+                                         {
+                                             builder.getInt32(m_fsInfo.dummyExport ? EXP_TARGET_MRT_0
+                                                                                   : EXP_TARGET_PS_NULL), // tgt
+                                             builder.getInt32(m_fsInfo.dummyExport ? 0x1 : 0x0),          // en
+                                             m_fsInfo.dummyExport ? ConstantFP::get(builder.getFloatTy(), 0.0)
+                                                                  : undef, // src0
+                                             undef,                        // src1
+                                             undef,                        // src2
+                                             undef,                        // src3
+                                             builder.getFalse(),           // done
+                                             builder.getTrue()             // vm
+                                         });
+  }
+
+  // Set "done" flag
+  if (lastExport->getCalledFunction()->getName() == "llvm.amdgcn.exp.f32")
+    lastExport->setOperand(6, builder.getTrue());
+  else {
+    assert(lastExport->getCalledFunction()->getName() == "llvm.amdgcn.exp.compr.v2f16");
+    lastExport->setOperand(4, builder.getTrue());
+  }
+
+  return colorExportFunc->getParent();
+}
+
+// =====================================================================================================================
+// Create module with function for the color export shader. On return, the function contains only the "ret".
+Function *ColorExportShader::createColorExportFunc() {
+  // Create the module
+  Module *module = new Module("colorExportShader", getContext());
+  TargetMachine *targetMachine = m_lgcContext->getTargetMachine();
+  module->setTargetTriple(targetMachine->getTargetTriple().getTriple());
+  module->setDataLayout(targetMachine->createDataLayout());
+
+  // Get the function type. Its inputs are the components of the color outputs, each a float in a VGPR, in the order
+  // that the fragment shader returns them.
+  SmallVector<Type *, 16> types;
+  for (const auto &exp : m_exports) {
+    unsigned compCount = exp.ty->isVectorTy() ? cast<FixedVectorType>(exp.ty)->getNumElements() : 1;
+    types.append(compCount, Type::getFloatTy(getContext()));
+  }
+  auto funcTy = FunctionType::get(Type::getVoidTy(getContext()), types, false);
+
+  // Create the function. Tell the back-end that every arg is live, so that it does not try to repack them as
+  // PS inputs: they are in the VGPRs where the fragment shader left them.
+  Function *func = Function::Create(funcTy, GlobalValue::ExternalLinkage, ColorExportEntryName, module);
+  func->setCallingConv(CallingConv::AMDGPU_PS);
+  func->addFnAttr("InitialPSInputAddr", "0xffffff");
+
+  if (m_lgcContext->getTargetInfo().getGfxIpVersion().major >= 10) {
+    // Set up wave32 or wave64 to match the fragment shader.
+    func->addFnAttr("target-features", m_fsInfo.wave32 ? "+wavefrontsize32" : "+wavefrontsize64");
+  }
+
+  BasicBlock *block = BasicBlock::Create(func->getContext(), "", func);
+  BuilderBase builder(block);
+  builder.CreateRetVoid();
+
+  return func;
+}
+
+// =====================================================================================================================
+// Add the color export shader's register settings to its PAL metadata. These are the registers that the fragment
+// shader leaves zero when its color exports are done here; the linker ORs them in.
+//
+// @param palMetadata : PAL metadata of the color export shader
+void ColorExportShader::updatePalMetadata(PalMetadata &palMetadata) {
+  unsigned spiShaderColFormat = 0;
+  unsigned cbShaderMask = 0;
+  for (unsigned idx = 0; idx != m_exports.size(); ++idx) {
+    if (m_hwColorTargets[idx] == InvalidValue || m_expFmts[idx] == EXP_FORMAT_ZERO)
+      continue;
+    const ColorExportInfo &exp = m_exports[idx];
+    unsigned compCount = exp.ty->isVectorTy() ? cast<FixedVectorType>(exp.ty)->getNumElements() : 1;
+    spiShaderColFormat |= m_expFmts[idx] << (4 * m_hwColorTargets[idx]);
+    cbShaderMask |= ((1 << compCount) - 1) << (4 * exp.location);
+  }
+
+  // NOTE: Hardware requires that fragment shader always exports "something" (color or depth) to the SX. The dummy
+  // export to MRT0 needs a format, which is masked off by CB_SHADER_MASK.
+  if (spiShaderColFormat == 0 && m_fsInfo.dummyExport)
+    spiShaderColFormat = EXP_FORMAT_32_R;
+
+  palMetadata.setRegister(mmSPI_SHADER_COL_FORMAT, spiShaderColFormat);
+  palMetadata.setRegister(mmCB_SHADER_MASK, cbShaderMask);
+}
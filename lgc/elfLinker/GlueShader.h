@@ -48,19 +48,27 @@ public:
   static GlueShader *createFetchShader(PipelineState *pipelineState, llvm::ArrayRef<VertexFetchInfo> fetches,
                                        const VsEntryRegInfo &vsEntryRegInfo);
 
+  // Create a color export shader
+  static GlueShader *createColorExportShader(PipelineState *pipelineState, llvm::ArrayRef<ColorExportInfo> exports,
+                                             const FsExportInfo &fsInfo);
+
   // Get the string for this glue shader. This is some encoding or hash of the inputs to the create*Shader function
   // that the front-end client can use as a cache key to avoid compiling the same glue shader more than once.
   virtual llvm::StringRef getString() = 0;
 
-  // Get the ELF blob for this glue shader, compiling if not already compiled.
+  // Get the ELF blob for this glue shader, compiling if not already compiled or set.
   llvm::StringRef getElfBlob() {
-    if (m_elfBlob.empty()) {
+    if (m_elfBlobRef.empty()) {
       llvm::raw_svector_ostream outStream(m_elfBlob);
       compile(outStream);
+      m_elfBlobRef = m_elfBlob;
     }
-    return m_elfBlob;
+    return m_elfBlobRef;
   }
 
+  // Set the ELF blob for this glue shader, typically retrieved from a cache. The blob is not copied.
+  void setElfBlob(llvm::StringRef blob) { m_elfBlobRef = blob; }
+
   // Get the symbol name of the main shader that this glue shader is prolog or epilog for
   virtual llvm::StringRef getMainShaderName() = 0;
 
@@ -79,12 +87,16 @@ protected:
   // Generate the IR module for the glue shader
   virtual llvm::Module *generate() = 0;
 
+  // Add the glue shader's own register settings to its PAL metadata
+  virtual void updatePalMetadata(PalMetadata &palMetadata) {}
+
   llvm::LLVMContext &getContext() const { return m_lgcContext->getContext(); }
 
   LgcContext *m_lgcContext;
 
 private:
-  llvm::SmallString<0> m_elfBlob;
+  llvm::SmallString<0> m_elfBlob; // ELF blob compiled by this glue shader
+  llvm::StringRef m_elfBlobRef;   // ELF blob in use: either m_elfBlob or one set by setElfBlob
 };
 
 } // namespace lgc
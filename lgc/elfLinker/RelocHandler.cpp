@@ -90,12 +90,20 @@ bool RelocHandler::getValue(StringRef name, uint64_t &value) {
       }
       const ResourceNode *outerNode = nullptr;
       const ResourceNode *node = nullptr;
-      std::tie(outerNode, node) = getPipelineState()->findResourceNode(type, descSet, binding);
+      std::tie(outerNode, node) = findResourceNode(type, descSet, binding);
       if (!node)
         report_fatal_error("No resource node for " + name);
       if (node->type == ResourceNodeType::DescriptorBufferCompact)
         getPipelineState()->setError("Cannot relocate to compact buffer descriptor");
 
+      if (node == outerNode) {
+        // A root descriptor is found through the spill table, which is only used as the descriptor set pointer for
+        // a set with no descriptor table.
+        if (findResourceNode(ResourceNodeType::DescriptorTableVaPtr, descSet, 0).first)
+          getPipelineState()->setError("Cannot relocate to root descriptor in a set with a descriptor table");
+        getPipelineState()->getPalMetadata()->setUserDataSpillUsage(node->offsetInDwords);
+      }
+
       value = node->offsetInDwords * 4;
       if (type == ResourceNodeType::DescriptorSampler && node->type == ResourceNodeType::DescriptorCombinedTexture)
         value += getPipelineState()->getTargetInfo().getGpuProperty().descriptorSizeResource;
@@ -111,7 +119,7 @@ bool RelocHandler::getValue(StringRef name, uint64_t &value) {
     if (parseDescSetBinding(name.drop_front(strlen(reloc::DescriptorStride)), descSet, binding, typeLetter)) {
       const ResourceNode *outerNode = nullptr;
       const ResourceNode *node = nullptr;
-      std::tie(outerNode, node) = getPipelineState()->findResourceNode(ResourceNodeType::Unknown, descSet, binding);
+      std::tie(outerNode, node) = findResourceNode(ResourceNodeType::Unknown, descSet, binding);
       if (!node)
         report_fatal_error("No resource node for " + name);
       const GpuProperty &gpuProperty = m_pipelineState->getTargetInfo().getGpuProperty();
@@ -132,6 +140,23 @@ bool RelocHandler::getValue(StringRef name, uint64_t &value) {
     }
   }
 
+  if (name.startswith(reloc::DescriptorTableOffset)) {
+    // Offset in bytes of the descriptor table pointer for a set in the spill table.
+    unsigned descSet = 0;
+    if (!name.drop_front(strlen(reloc::DescriptorTableOffset)).getAsInteger(10, descSet)) {
+      const ResourceNode *node = findResourceNode(ResourceNodeType::DescriptorTableVaPtr, descSet, 0).first;
+      if (!node) {
+        getPipelineState()->setError("Cannot relocate to spilled pointer of descriptor set " + Twine(descSet) +
+                                     " with no descriptor table");
+        value = 0;
+        return true;
+      }
+      getPipelineState()->getPalMetadata()->setUserDataSpillUsage(node->offsetInDwords);
+      value = node->offsetInDwords * 4;
+      return true;
+    }
+  }
+
   if (name == reloc::NumSamples) {
     value = m_pipelineState->getRasterizerState().numSamples;
     return true;
@@ -153,3 +178,23 @@ bool RelocHandler::getValue(StringRef name, uint64_t &value) {
 
   return false;
 }
+
+// =====================================================================================================================
+// Find the resource node for a (type, set, binding). Each lookup walks all user data nodes, and a pipeline with many
+// descriptor relocs asks for the same few nodes repeatedly, so remember each result for the rest of the link.
+//
+// @param type : Type of the resource mapping node
+// @param descSet : ID of descriptor set
+// @param binding : ID of descriptor binding
+// @return : {outerNode, node} pair, as returned by PipelineState::findResourceNode
+std::pair<const ResourceNode *, const ResourceNode *> RelocHandler::findResourceNode(ResourceNodeType type,
+                                                                                     unsigned descSet,
+                                                                                     unsigned binding) {
+  auto key = std::make_tuple(static_cast<unsigned>(type), descSet, binding);
+  auto it = m_resourceNodes.find(key);
+  if (it != m_resourceNodes.end())
+    return it->second;
+  auto result = getPipelineState()->findResourceNode(type, descSet, binding);
+  m_resourceNodes[key] = result;
+  return result;
+}
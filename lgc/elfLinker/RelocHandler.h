@@ -31,10 +31,14 @@
 #pragma once
 
 #include "llvm/ADT/StringRef.h"
+#include <map>
+#include <tuple>
 
 namespace lgc {
 
 class PipelineState;
+struct ResourceNode;
+enum class ResourceNodeType : unsigned;
 
 // =====================================================================================================================
 // Class to handle internal relocatable values when ELF linking
@@ -48,7 +52,14 @@ public:
 private:
   PipelineState *getPipelineState() const { return m_pipelineState; }
 
+  // Find the resource node for a (type, set, binding), looking it up in the user data nodes only the first time
+  std::pair<const ResourceNode *, const ResourceNode *> findResourceNode(ResourceNodeType type, unsigned descSet,
+                                                                         unsigned binding);
+
   PipelineState *m_pipelineState;
+  // Resource nodes found so far in this link, keyed by (type, set, binding)
+  std::map<std::tuple<unsigned, unsigned, unsigned>, std::pair<const ResourceNode *, const ResourceNode *>>
+      m_resourceNodes;
 };
 
 } // namespace lgc
@@ -56,7 +56,7 @@ public:
   FragColorExport(llvm::LLVMContext *context);
 
   llvm::Value *run(llvm::Value *output, unsigned int hwColorTarget, llvm::Instruction *insertPos, ExportFormat expFmt,
-                   const bool signedness);
+                   const bool signedness, unsigned channelMask = 0xF);
 
 private:
   FragColorExport() = delete;
@@ -45,19 +45,25 @@ class PassManager;
 } // namespace legacy
 
 void initializeLowerVertexFetchPass(PassRegistry &);
+void initializePatchAlwaysInlinePass(PassRegistry &);
 void initializePatchBufferOpPass(PassRegistry &);
+void initializePatchBufferOpCombinePass(PassRegistry &);
 void initializePatchCheckShaderCachePass(PassRegistry &);
 void initializePatchCopyShaderPass(PassRegistry &);
+void initializePatchDescriptorLoadHoistPass(PassRegistry &);
 void initializePatchEntryPointMutatePass(PassRegistry &);
 void initializePatchInOutImportExportPass(PassRegistry &);
 void initializePatchIntrinsicSimplifyPass(PassRegistry &);
+void initializePatchLdsLayoutPass(PassRegistry &);
 void initializePatchLlvmIrInclusionPass(PassRegistry &);
 void initializePatchLoadScalarizerPass(PassRegistry &);
 void initializePatchNullFragShaderPass(PassRegistry &);
 void initializePatchPeepholeOptPass(PassRegistry &);
 void initializePatchPreparePipelineAbiPass(PassRegistry &);
+void initializePatchRelaxedPrecisionPass(PassRegistry &);
 void initializePatchResourceCollectPass(PassRegistry &);
 void initializePatchSetupTargetFeaturesPass(PassRegistry &);
+void initializePatchWaterfallBatchPass(PassRegistry &);
 
 } // namespace llvm
 
@@ -70,35 +76,47 @@ class PatchCheckShaderCache;
 // @param passRegistry : Pass registry
 inline static void initializePatchPasses(llvm::PassRegistry &passRegistry) {
   initializeLowerVertexFetchPass(passRegistry);
+  initializePatchAlwaysInlinePass(passRegistry);
   initializePatchBufferOpPass(passRegistry);
+  initializePatchBufferOpCombinePass(passRegistry);
   initializePatchCheckShaderCachePass(passRegistry);
   initializePatchCopyShaderPass(passRegistry);
+  initializePatchDescriptorLoadHoistPass(passRegistry);
   initializePatchEntryPointMutatePass(passRegistry);
   initializePatchInOutImportExportPass(passRegistry);
   initializePatchIntrinsicSimplifyPass(passRegistry);
+  initializePatchLdsLayoutPass(passRegistry);
   initializePatchLlvmIrInclusionPass(passRegistry);
   initializePatchLoadScalarizerPass(passRegistry);
   initializePatchNullFragShaderPass(passRegistry);
   initializePatchPeepholeOptPass(passRegistry);
   initializePatchPreparePipelineAbiPass(passRegistry);
+  initializePatchRelaxedPrecisionPass(passRegistry);
   initializePatchResourceCollectPass(passRegistry);
   initializePatchSetupTargetFeaturesPass(passRegistry);
+  initializePatchWaterfallBatchPass(passRegistry);
 }
 
 llvm::ModulePass *createLowerVertexFetch();
+llvm::ModulePass *createPatchAlwaysInline();
 llvm::FunctionPass *createPatchBufferOp();
+llvm::FunctionPass *createPatchBufferOpCombine();
 PatchCheckShaderCache *createPatchCheckShaderCache();
 llvm::ModulePass *createPatchCopyShader();
+llvm::FunctionPass *createPatchDescriptorLoadHoist();
 llvm::ModulePass *createPatchEntryPointMutate();
 llvm::ModulePass *createPatchInOutImportExport();
 llvm::FunctionPass *createPatchIntrinsicSimplify();
+llvm::ModulePass *createPatchLdsLayout();
 llvm::ModulePass *createPatchLlvmIrInclusion();
 llvm::FunctionPass *createPatchLoadScalarizer();
 llvm::ModulePass *createPatchNullFragShader();
 llvm::FunctionPass *createPatchPeepholeOpt();
 llvm::ModulePass *createPatchPreparePipelineAbi(bool onlySetCallingConvs);
+llvm::FunctionPass *createPatchRelaxedPrecision();
 llvm::ModulePass *createPatchResourceCollect();
 llvm::ModulePass *createPatchSetupTargetFeatures();
+llvm::FunctionPass *createPatchWaterfallBatch();
 
 class PipelineState;
 
@@ -126,7 +144,7 @@ protected:
   llvm::Function *m_entryPoint; // Entry-point
 
 private:
-  static void addOptimizationPasses(llvm::legacy::PassManager &passMgr);
+  static void addOptimizationPasses(llvm::legacy::PassManager &passMgr, bool fastCompile);
 
   Patch() = delete;
   Patch(const Patch &) = delete;
@@ -52,6 +52,11 @@ public:
   // Generate code to fetch a vertex value
   virtual llvm::Value *fetchVertex(llvm::Type *inputTy, const VertexInputDescription *description, unsigned location,
                                    unsigned compIdx, BuilderBase &builder) = 0;
+
+  // Generate combined loads for vertex inputs that are contiguous in the same vertex buffer binding, for use by
+  // subsequent fetchVertex calls for those inputs
+  virtual void coalesceVertexFetches(llvm::ArrayRef<const VertexInputDescription *> descriptions,
+                                     BuilderBase &builder) = 0;
 };
 
 } // namespace lgc
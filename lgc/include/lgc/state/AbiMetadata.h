@@ -222,6 +222,10 @@ constexpr unsigned mmSPI_SHADER_PGM_RSRC2_VS = 0x2C4B;
 // Other SPI register numbers in PAL metadata
 constexpr unsigned int mmPA_CL_CLIP_CNTL = 0xA204;
 constexpr unsigned mmVGT_SHADER_STAGES_EN = 0xA2D5;
+constexpr unsigned mmSPI_PS_INPUT_ENA = 0xA1B3;
+constexpr unsigned mmSPI_PS_INPUT_ADDR = 0xA1B4;
+constexpr unsigned mmSPI_SHADER_COL_FORMAT = 0xA1C5;
+constexpr unsigned mmCB_SHADER_MASK = 0xA08F;
 
 // Register bitfield layout.
 
@@ -49,7 +49,8 @@ namespace reloc {
 //     'b' for buffer (including texel buffer), 'x' for unknown.
 //
 // The value of the relocation is the offset in bytes of the requested descriptor in its descriptor set table,
-// or its offset in bytes in the spill table if it is a root descriptor.
+// or its offset in bytes in the spill table if it is a root descriptor. The pointer for a descriptor set with no
+// descriptor table is the spill table, so a root descriptor is only allowed in such a set.
 // It is illegal for the specified descriptor not to exist.
 const static char DescriptorOffset[] = "doff_";
 
@@ -63,6 +64,12 @@ const static char DescriptorOffset[] = "doff_";
 // be part of a combined texture descriptor.)
 const static char DescriptorStride[] = "dstride_";
 
+// Descriptor table offset is "descset_X" where X is the descriptor set number.
+//
+// The value of the relocation is the offset in bytes in the spill table of the pointer to the descriptor table for
+// the set. It is used when the pointer is spilled, and it is an error for the set not to have a descriptor table.
+const static char DescriptorTableOffset[] = "descset_";
+
 // Number of samples is "$numsamples".
 // The value of the relocation is numSamples from the rasterizer state.
 const static char NumSamples[] = "$numsamples";
@@ -96,11 +103,18 @@ static constexpr char FetchlessHsEntryName[] = "_amdgpu_hs_main_fetchless";
 // Name of shader entry-point for LS that is fetchless VS
 static constexpr char FetchlessLsEntryName[] = "_amdgpu_ls_main_fetchless";
 
+// Name of the color export shader. The linker glues it on to the end of a fragment shader whose color exports
+// were left to it; the fragment shader entry-point keeps its name.
+static constexpr char ColorExportEntryName[] = "_amdgpu_ps_color_export";
+
 // =====================================================================================================================
 // Metadata names of extra entries in .pipeline for an unlinked shader/half-pipeline
 namespace PipelineMetadataKey {
 
 static const char VertexInputs[] = ".vertexInputs";
+static const char ColorExports[] = ".colorExports";
+static const char ColorExportDummy[] = ".colorExportDummy";
+static const char ColorExportWave32[] = ".colorExportWave32";
 
 } // namespace PipelineMetadataKey
 
@@ -72,6 +72,9 @@ const static char PushConst[] = "lgc.push.const";
 // Get a descriptor that is in the root user data (as descriptor type indicated by the return type).
 // The arg is the dword offset of the node in the root user data layout.
 const static char RootDescriptor[] = "lgc.root.descriptor";
+// Get a buffer fat pointer to an inline buffer whose data is in the root user data. First arg is the dword offset of
+// the node in the root user data layout; second arg is the buffer descriptor with its address dwords left zero.
+const static char RootInlineBuffer[] = "lgc.root.inline.buffer";
 // Get pointer to a descriptor set table. First arg is the descriptor set number; second arg is the value to use
 // for the high half of the address, or HighAddrPc to use PC.
 const static char DescriptorSet[] = "lgc.descriptor.set";
@@ -90,6 +93,9 @@ const static char LateBufferLength[] = "lgc.late.buffer.desc.length";
 const static char ImmutableSamplerGlobal[] = "lgc.immutable.sampler";
 const static char ImmutableConvertingSamplerGlobal[] = "lgc.immutable.converting.sampler";
 
+// Name of instruction metadata carrying a compile-time ImageFormatHint on an image descriptor and its pointer
+const static char ImageFormatHintMetadata[] = "lgc.image.format.hint";
+
 // Names of entry-points for merged shader
 const static char EsGsEntryPoint[] = "lgc.shader.ESGS.main";
 const static char LsHsEntryPoint[] = "lgc.shader.LSHS.main";
@@ -70,6 +70,22 @@ struct VsEntryRegInfo {
   bool wave32;                // Whether VS is wave32
 };
 
+// =====================================================================================================================
+// Struct with the information for one color export done by the color export shader
+struct ColorExportInfo {
+  unsigned hwColorTarget; // Hardware color target (MRT) exported to
+  unsigned location;      // Original location of the color output
+  bool isSigned;          // Whether an integer output is signed
+  llvm::Type *ty;         // Type of the output
+};
+
+// =====================================================================================================================
+// Struct with information on the fragment shader needed by the color export shader, written by getColorExportInfo
+struct FsExportInfo {
+  bool dummyExport; // Whether a dummy export is needed if no color export has a format
+  bool wave32;      // Whether FS is wave32
+};
+
 // =====================================================================================================================
 // Class for manipulating PAL metadata through LGC
 class PalMetadata {
@@ -122,6 +138,13 @@ public:
   // Get the VS entry register info. Used by the linker to generate the fetch shader.
   void getVsEntryRegInfo(VsEntryRegInfo &regInfo);
 
+  // Store the color exports in PAL metadata for a fragment shader whose color exports are done by a color
+  // export shader.
+  void addColorExportInfo(llvm::ArrayRef<ColorExportInfo> exports, const FsExportInfo &fsInfo);
+
+  // Get the color export information out of PAL metadata. Used by the linker to generate the color export shader.
+  void getColorExportInfo(llvm::SmallVectorImpl<ColorExportInfo> &exports, FsExportInfo &fsInfo);
+
   // Finalize PAL metadata for pipeline.
   // TODO Shader compilation: The idea is that this will be called at the end of a pipeline compilation, or in
   // an ELF link, but not at the end of a shader/half-pipeline compile.
@@ -142,6 +165,7 @@ private:
   llvm::msgpack::MapDocNode m_pipelineNode;   // MsgPack map node for amdpal.pipelines[0]
   llvm::msgpack::MapDocNode m_registers;      // MsgPack map node for amdpal.pipelines[0].registers
   llvm::msgpack::ArrayDocNode m_vertexInputs; // MsgPack map node for amdpal.pipelines[0].vertexInputs
+  llvm::msgpack::ArrayDocNode m_colorExports; // MsgPack map node for amdpal.pipelines[0].colorExports
   // Mapping from ShaderStage to SPI user data register start, allowing for merged shaders and NGG.
   unsigned m_userDataRegMapping[ShaderStageCountInternal] = {};
   llvm::msgpack::DocNode *m_userDataLimit;  // Maximum so far number of user data dwords used
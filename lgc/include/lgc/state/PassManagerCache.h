@@ -31,12 +31,37 @@
 #pragma once
 
 #include "lgc/PassManager.h"
+#include "lgc/Pipeline.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/Support/raw_ostream.h"
 
 namespace lgc {
 
 class LgcContext;
-struct PassManagerInfo;
+class PipelineStateWrapper;
+
+// =====================================================================================================================
+// Information on how to create a pass manager. This is used as the key in the pass manager cache, so it is compared
+// as raw bytes and must be zero-initialized with memset before its fields are set.
+struct PassManagerInfo {
+  bool isGlue;        // Pass manager for glue shader compilation
+  bool emitLgc;       // -emit-lgc: just write the module
+  bool noReplayer;    // No BuilderReplayer pass needed
+  bool isGraphics;    // Graphics pipeline
+  bool nggDisabled;   // NGG disabled by pipeline options
+  bool includeIr;     // Include LLVM IR as a separate section in the ELF binary
+  bool fastCompile;   // Lightweight optimization tier selected by pipeline options
+  unsigned stageMask; // Mask of active shader stages
+  unsigned optLevel;  // Codegen optimization level of the target machine
+};
+
+// =====================================================================================================================
+// A pass manager held in the pass manager cache, together with the per-compile state that its passes refer to.
+struct CachedPassManager {
+  std::unique_ptr<PassManager> passManager;             // The pass manager
+  PipelineStateWrapper *pipelineStateWrapper = nullptr; // Pipeline state wrapper pass in the pass manager
+  Pipeline::CheckShaderCacheFunc checkShaderCacheFunc;  // Shader cache check callback for the current compile
+};
 
 // =====================================================================================================================
 // A raw_pwrite_stream that proxies for another raw_pwrite_stream.
@@ -83,11 +108,17 @@ public:
   // Get pass manager for glue shader compilation
   PassManager &getGlueShaderPassManager(llvm::raw_pwrite_stream &outStream);
 
+  // Get pass manager for whole-pipeline compilation. If there is no cached pass manager for the info yet,
+  // createPasses is called to create one; the stream passed to it must be used for all output of the passes.
+  CachedPassManager &
+  getPipelinePassManager(const PassManagerInfo &info, llvm::raw_pwrite_stream &outStream,
+                         llvm::function_ref<void(CachedPassManager &, llvm::raw_pwrite_stream &)> createPasses);
+
 private:
-  PassManager &getPassManager(const PassManagerInfo &info, llvm::raw_pwrite_stream &outStream);
+  CachedPassManager &getPassManager(const PassManagerInfo &info, llvm::raw_pwrite_stream &outStream);
 
   LgcContext *m_lgcContext;
-  llvm::StringMap<std::unique_ptr<PassManager>> m_cache;
+  llvm::StringMap<CachedPassManager> m_cache;
   raw_proxy_ostream m_proxyStream;
 };
 
@@ -32,8 +32,8 @@
 
 #include "lgc/CommonDefs.h"
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/Pass.h"
-#include <map>
 
 namespace lgc {
 
@@ -56,8 +56,8 @@ private:
   PipelineShaders(const PipelineShaders &) = delete;
   PipelineShaders &operator=(const PipelineShaders &) = delete;
 
-  llvm::Function *m_entryPoints[ShaderStageCountInternal];       // The entry-point for each shader stage.
-  std::map<const llvm::Function *, ShaderStage> m_entryPointMap; // Map from shader entry-point to shader stage.
+  llvm::Function *m_entryPoints[ShaderStageCountInternal];            // The entry-point for each shader stage.
+  llvm::DenseMap<const llvm::Function *, ShaderStage> m_entryPointMap; // Map from shader entry-point to shader stage.
 };
 
 llvm::ModulePass *createPipelineShaders();
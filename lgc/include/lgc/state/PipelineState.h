@@ -39,6 +39,7 @@
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/Pass.h"
+#include "llvm/Support/Allocator.h"
 #include <map>
 
 namespace llvm {
@@ -59,7 +60,9 @@ namespace lgc {
 
 class ElfLinker;
 class PalMetadata;
+class PassManager;
 class PipelineState;
+class PipelineStateWrapper;
 class TargetInfo;
 
 llvm::ModulePass *createPipelineStateClearer();
@@ -130,6 +133,7 @@ public:
 
   // Set the resource mapping nodes for the pipeline
   void setUserDataNodes(llvm::ArrayRef<ResourceNode> nodes) override final;
+  void setUserDataNodes(std::unique_ptr<ResourceNode[]> allocNodes, llvm::ArrayRef<ResourceNode> nodes) override final;
 
   // Set shader stage mask
   void setShaderStageMask(unsigned mask) override final { m_stageMask = mask; }
@@ -163,6 +167,10 @@ public:
                 CheckShaderCacheFunc checkShaderCacheFunc, llvm::ArrayRef<llvm::Timer *> timers,
                 llvm::MemoryBufferRef otherElf) override final;
 
+  // Add the "whole pipeline" passes to a pass manager
+  PipelineStateWrapper *addPasses(PassManager &passMgr, llvm::ArrayRef<llvm::Timer *> timers,
+                                  CheckShaderCacheFunc checkShaderCacheFunc, llvm::raw_pwrite_stream &outStream);
+
   // Create an ELF linker object for linking unlinked half-pipeline ELFs into a pipeline ELF using the pipeline state
   ElfLinker *createElfLinker(llvm::ArrayRef<llvm::MemoryBufferRef> elfs) override final;
 
@@ -176,6 +184,9 @@ public:
   // type. Only the number of elements of the type is significant.
   unsigned computeExportFormat(llvm::Type *outputTy, unsigned location) override final;
 
+  // Compute the mask of channels of the specified color export location whose values can reach the color target.
+  unsigned computeExportChannelMask(unsigned location);
+
   // Set entire pipeline state from metadata in an IR module. This is used by the lgc command-line utility
   // for its link option.
   void setStateFromModule(llvm::Module *module) override final { readState(module); }
@@ -241,6 +252,10 @@ public:
   const ColorExportFormat &getColorExportFormat(unsigned location);
   const ColorExportState &getColorExportState() { return m_colorExportState; }
 
+  // Return whether the fragment shader leaves its color exports to a color export shader glued on in the link.
+  // That is the case for an unlinked compile where the front-end did not supply the color export formats.
+  bool useColorExportShader() const { return m_unlinked && m_colorExportFormats.empty(); }
+
   // Accessors for pipeline state
   unsigned getDeviceIndex() const { return m_deviceIndex; }
   const InputAssemblyState &getInputAssemblyState() const { return m_inputAssemblyState; }
@@ -386,8 +401,10 @@ private:
   void setUserDataNodesTable(llvm::ArrayRef<ResourceNode> nodes, ResourceNode *destTable,
                              ResourceNode *&destInnerTable);
   void recordUserDataNodes(llvm::Module *module);
-  void recordUserDataTable(llvm::ArrayRef<ResourceNode> nodes, llvm::NamedMDNode *userDataMetaNode);
+  void recordUserDataTable(llvm::ArrayRef<ResourceNode> nodes, llvm::NamedMDNode *userDataMetaNode,
+                           llvm::NamedMDNode *&formatHintsMetaNode);
   void readUserDataNodes(llvm::Module *module);
+  void readImageFormatHints(llvm::Module *module);
   llvm::ArrayRef<llvm::MDString *> getResourceTypeNames();
   llvm::MDString *getResourceTypeName(ResourceNodeType type);
   ResourceNodeType getResourceTypeFromName(llvm::MDString *typeName);
@@ -412,6 +429,7 @@ private:
   bool m_noReplayer = false;                            // True if no BuilderReplayer needed
   bool m_emitLgc = false;                               // Whether -emit-lgc is on
   bool m_unlinked = false;                              // Whether generating an unlinked half-pipeline ELF
+  bool m_irLinked = false;                              // Whether irLink was run, so state is held only in memory
   unsigned m_stageMask = 0;                             // Mask of active shader stages
   Options m_options = {};                               // Per-pipeline options
   std::vector<ShaderOptions> m_shaderOptions;           // Per-shader options
@@ -431,8 +449,12 @@ private:
   InputAssemblyState m_inputAssemblyState = {};                                // Input-assembly state
   ViewportState m_viewportState = {};                                          // Viewport state
   RasterizerState m_rasterizerState = {};                                      // Rasterizer state
-  std::unique_ptr<ResourceUsage> m_resourceUsage[ShaderStageCompute + 1] = {}; // Per-shader ResourceUsage
-  std::unique_ptr<InterfaceData> m_interfaceData[ShaderStageCompute + 1] = {}; // Per-shader InterfaceData
+  // Per-shader ResourceUsage and InterfaceData live in arenas of the pipeline, so they take a slab allocation or two
+  // per pipeline rather than one heap allocation each, and all go in one step when the PipelineState does.
+  llvm::SpecificBumpPtrAllocator<ResourceUsage> m_resourceUsageAllocator;      // Arena for per-shader ResourceUsage
+  llvm::SpecificBumpPtrAllocator<InterfaceData> m_interfaceDataAllocator;      // Arena for per-shader InterfaceData
+  ResourceUsage *m_resourceUsage[ShaderStageCompute + 1] = {};                 // Per-shader ResourceUsage
+  InterfaceData *m_interfaceData[ShaderStageCompute + 1] = {};                 // Per-shader InterfaceData
   PalMetadata *m_palMetadata = nullptr;                                        // PAL metadata object
 };
 
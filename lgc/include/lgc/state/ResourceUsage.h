@@ -32,6 +32,7 @@
 
 #include "lgc/state/Defs.h"
 #include "lgc/state/IntrinsDefs.h"
+#include "lgc/util/FlatMap.h"
 #include "lgc/util/Internal.h"
 #include <unordered_map>
 #include <unordered_set>
@@ -121,6 +122,10 @@ enum class WorkgroupLayout : unsigned {
   SexagintiQuads // 8x8
 };
 
+// Map from location (or packed location info, or built-in ID) to mapped location, as used for input/output
+// location mapping. This is kept in ascending key order, which location packing and mapping rely on.
+typedef FlatMap<unsigned, unsigned> InOutLocMap;
+
 // Represents the usage info of shader resources.
 //
 // NOTE: All fields must be initialized in InitShaderResourceUsage().
@@ -314,21 +319,21 @@ struct ResourceUsage {
   // Usage of generic input/output
   struct {
     // Map from shader specified locations to tightly packed locations
-    std::map<unsigned, unsigned> inputLocMap;
-    std::map<unsigned, unsigned> outputLocMap;
+    InOutLocMap inputLocMap;
+    InOutLocMap outputLocMap;
 
     // The original and new InOutLocations for shader cache
-    std::map<unsigned, unsigned> inOutLocMap;
+    InOutLocMap inOutLocMap;
 
-    std::map<unsigned, unsigned> perPatchInputLocMap;
-    std::map<unsigned, unsigned> perPatchOutputLocMap;
+    InOutLocMap perPatchInputLocMap;
+    InOutLocMap perPatchOutputLocMap;
 
     // Map from built-in IDs to specially assigned locations
-    std::map<unsigned, unsigned> builtInInputLocMap;
-    std::map<unsigned, unsigned> builtInOutputLocMap;
+    InOutLocMap builtInInputLocMap;
+    InOutLocMap builtInOutputLocMap;
 
-    std::map<unsigned, unsigned> perPatchBuiltInInputLocMap;
-    std::map<unsigned, unsigned> perPatchBuiltInOutputLocMap;
+    InOutLocMap perPatchBuiltInInputLocMap;
+    InOutLocMap perPatchBuiltInOutputLocMap;
 
     // Transform feedback strides
     unsigned xfbStrides[MaxTransformFeedbackBuffers] = {};
@@ -394,7 +399,7 @@ struct ResourceUsage {
       std::unordered_map<unsigned, std::vector<unsigned>> genericOutByteSizes[MaxGsStreams];
 
       // Map from output location to the transform feedback info
-      std::map<unsigned, unsigned> xfbOutsInfo;
+      InOutLocMap xfbOutsInfo;
 
       // ID of the vertex stream sent to rasterizor
       unsigned rasterStream = 0;
@@ -409,6 +414,7 @@ struct ResourceUsage {
         unsigned inputVertices;      // Number of GS input vertices
         unsigned primAmpFactor;      // GS primitive amplification factor
         bool enableMaxVertOut;       // Whether to allow each GS instance to emit maximum vertices (NGG)
+        bool emitsSinglePrimitive;   // Whether each GS instance emits exactly one complete primitive on stream 0
       } calcFactor = {};
 
       unsigned outLocCount[MaxGsStreams] = {};
@@ -31,6 +31,8 @@
 #pragma once
 
 #include "llvm/IR/IRBuilder.h"
+#include <map>
+#include <tuple>
 
 namespace llvm {
 class Function;
@@ -61,12 +63,23 @@ public:
   // @return : 64-bit pointer value
   llvm::Instruction *extend(llvm::Value *addr32, unsigned highHalf, llvm::Type *ptrTy, llvm::IRBuilder<> &builder);
 
+  // Extend an i32 into a 64-bit pointer, generating the code only once in the function for each combination of
+  // arguments, straight after addr32 is defined, so the result can replace uses anywhere in the function.
+  //
+  // @param addr32 : Address as 32-bit value; must be an argument or an instruction in this function
+  // @param highHalf : Value to use for high half; HighAddrPc to use PC
+  // @param ptrTy : Type to cast pointer to
+  // @return : 64-bit pointer value
+  llvm::Instruction *extendShared(llvm::Value *addr32, unsigned highHalf, llvm::Type *ptrTy);
+
 private:
   // Get PC value as v2i32.
   llvm::Instruction *getPc();
 
   llvm::Function *m_func;
   llvm::Instruction *m_pc = nullptr;
+  // Pointers generated by extendShared, keyed by its arguments
+  std::map<std::tuple<llvm::Value *, unsigned, llvm::Type *>, llvm::Instruction *> m_sharedExtends;
 };
 
 } // namespace lgc
@@ -0,0 +1,108 @@
+/*
+ ***********************************************************************************************************************
+ *
+ *  Copyright (c) 2020 Advanced Micro Devices, Inc. All Rights Reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ **********************************************************************************************************************/
+/**
+ ***********************************************************************************************************************
+ * @file  FlatMap.h
+ * @brief LGC header file: Small ordered map held in a sorted vector
+ ***********************************************************************************************************************
+ */
+#pragma once
+
+#include "llvm/ADT/SmallVector.h"
+#include <algorithm>
+#include <utility>
+
+namespace lgc {
+
+// =====================================================================================================================
+// Ordered map from key to value, held as a sorted vector of pairs with inline storage for a few entries. It
+// provides the subset of the std::map interface used for resource usage location maps, and iterates in
+// ascending key order just like std::map, which the location packing and mapping code relies on.
+//
+// Unlike std::map, inserting or erasing an entry invalidates iterators and references to other entries. The key of
+// an entry must not be modified through an iterator.
+template <typename KeyT, typename ValueT, unsigned InlineCount = 8> class FlatMap {
+public:
+  typedef std::pair<KeyT, ValueT> value_type;
+  typedef typename llvm::SmallVector<value_type, InlineCount>::iterator iterator;
+  typedef typename llvm::SmallVector<value_type, InlineCount>::const_iterator const_iterator;
+
+  iterator begin() { return m_entries.begin(); }
+  iterator end() { return m_entries.end(); }
+  const_iterator begin() const { return m_entries.begin(); }
+  const_iterator end() const { return m_entries.end(); }
+
+  bool empty() const { return m_entries.empty(); }
+  size_t size() const { return m_entries.size(); }
+  void clear() { m_entries.clear(); }
+
+  // Find the first entry whose key is not less than the given key
+  iterator lower_bound(const KeyT &key) {
+    return std::lower_bound(m_entries.begin(), m_entries.end(), key,
+                            [](const value_type &entry, const KeyT &key) { return entry.first < key; });
+  }
+  const_iterator lower_bound(const KeyT &key) const {
+    return std::lower_bound(m_entries.begin(), m_entries.end(), key,
+                            [](const value_type &entry, const KeyT &key) { return entry.first < key; });
+  }
+
+  iterator find(const KeyT &key) {
+    iterator it = lower_bound(key);
+    return it != end() && it->first == key ? it : end();
+  }
+  const_iterator find(const KeyT &key) const {
+    const_iterator it = lower_bound(key);
+    return it != end() && it->first == key ? it : end();
+  }
+
+  size_t count(const KeyT &key) const { return find(key) != end() ? 1 : 0; }
+
+  // Get the value for the given key, inserting a value-initialized entry if it is not present
+  ValueT &operator[](const KeyT &key) {
+    iterator it = lower_bound(key);
+    if (it == end() || it->first != key)
+      it = m_entries.insert(it, value_type(key, ValueT()));
+    return it->second;
+  }
+
+  iterator erase(const_iterator it) { return m_entries.erase(it); }
+  iterator erase(iterator it) { return m_entries.erase(it); }
+
+  size_t erase(const KeyT &key) {
+    iterator it = find(key);
+    if (it == end())
+      return 0;
+    m_entries.erase(it);
+    return 1;
+  }
+
+  bool operator==(const FlatMap &other) const { return m_entries == other.m_entries; }
+  bool operator!=(const FlatMap &other) const { return !(*this == other); }
+
+private:
+  llvm::SmallVector<value_type, InlineCount> m_entries; // Entries in ascending key order
+};
+
+} // namespace lgc
@@ -42,11 +42,14 @@ class BasicBlock;
 class CallInst;
 class Function;
 class Instruction;
+class ModulePass;
 class PassRegistry;
 class Type;
 class Value;
 
+void initializePassCostPassPass(PassRegistry &);
 void initializeStartStopTimerPass(PassRegistry &);
+void initializeTraceEventPassPass(PassRegistry &);
 
 } // namespace llvm
 
@@ -62,9 +65,17 @@ static const unsigned SizeOfVec4 = sizeof(float) * 4;
 //
 // @param passRegistry : Pass registry
 inline static void initializeUtilPasses(llvm::PassRegistry &passRegistry) {
+  initializePassCostPassPass(passRegistry);
   initializeStartStopTimerPass(passRegistry);
+  initializeTraceEventPassPass(passRegistry);
 }
 
+// Create a pass that records a trace event for a module pass, to add before (beginPass is nullptr) or after it
+llvm::ModulePass *createTraceEventPass(llvm::StringRef passName, llvm::ModulePass *beginPass);
+
+// Create a pass that accounts the cost of a pass, to add before (beginPass is nullptr) or after it
+llvm::ModulePass *createPassCostPass(llvm::StringRef passName, llvm::ModulePass *beginPass);
+
 // Emits a LLVM function call (inserted before the specified instruction), builds it automically based on return type
 // and its parameters.
 llvm::CallInst *emitCall(llvm::StringRef funcName, llvm::Type *retTy, llvm::ArrayRef<llvm::Value *> args,
@@ -46,6 +46,10 @@ class Pipeline;
 class ShaderModes;
 struct TessellationMode;
 
+// Name of the metadata that the front-end attaches to a floating point arithmetic instruction whose result only needs
+// relaxed precision (RelaxedPrecision in SPIR-V), so that the middle-end may compute it in 16 bits.
+static const char RelaxedPrecisionMetadataName[] = "lgc.relaxed.precision";
+
 // =====================================================================================================================
 // Class that represents extra information on an input or output.
 // For an FS input, if HasInterpAux(), then CreateReadInput's pVertexIndex is actually an auxiliary value
@@ -141,6 +145,16 @@ public:
   // Get the LgcContext
   LgcContext *getLgcContext() const { return m_builderContext; }
 
+  // Get whether this is a BuilderRecorder rather than a BuilderImpl
+  bool isBuilderRecorder() const { return m_isBuilderRecorder; }
+
+  // Re-target the Builder to another pipeline, or to none, so that the LgcContext can reuse it for another compile.
+  // This also clears the insertion point and the other state left by the previous compile. Only
+  // LgcContext::createBuilder and LgcContext::releaseBuilder call this.
+  //
+  // @param pipeline : Pipeline object for pipeline compile, nullptr for shader compile or for a released Builder
+  virtual void setPipeline(Pipeline *pipeline);
+
   // Set the current shader stage, clamp shader stage to the ShaderStageCompute
   void setShaderStage(ShaderStage stage) { m_shaderStage = stage > ShaderStageCompute ? ShaderStageCompute : stage; }
 
@@ -183,7 +197,9 @@ public:
   // Get the compute shader mode (workgroup size)
   const ComputeShaderMode &getComputeShaderMode();
 
-  // Record shader modes into IR metadata if this is a shader compile (no PipelineState).
+  // Record shader modes into IR metadata: all of them for a shader compile (no PipelineState), or those set for the
+  // current shader for a pipeline compile with BuilderRecorder, so that its IR can be linked without this
+  // PipelineState.
   virtual void recordShaderModes(llvm::Module *module) {}
 
   // -----------------------------------------------------------------------------------------------------------------
@@ -1528,6 +1544,10 @@ protected:
   // compilation, there is no PipelineState, so BuilderRecorder creates its own ShaderModes.
   virtual ShaderModes *getShaderModes() = 0;
 
+  // Get the ShaderModes object that collects the modes set for the current shader only, as well as getShaderModes(),
+  // or nullptr if there is none.
+  virtual ShaderModes *getStageShaderModes() { return nullptr; }
+
   // Get a constant of FP or vector of FP type from the given APFloat, converting APFloat semantics where necessary
   llvm::Constant *getFpConstant(llvm::Type *ty, llvm::APFloat value);
 
@@ -31,6 +31,7 @@
 #pragma once
 
 #include "llvm/ADT/StringRef.h"
+#include <string>
 
 namespace llvm {
 
@@ -98,6 +99,12 @@ public:
   // @param useBuilderRecorder : True to use BuilderRecorder, false to use BuilderImpl
   Builder *createBuilder(Pipeline *pipeline, bool useBuilderRecorder);
 
+  // Give back a Builder created by createBuilder() once its compile is done. The LgcContext keeps one free Builder of
+  // each kind, and a later createBuilder() re-targets it to the new pipeline instead of allocating a new one.
+  //
+  // @param builder : Builder to give back, or nullptr
+  void releaseBuilder(Builder *builder);
+
   // Prepare a pass manager. This manually adds a target-aware TLI pass, so middle-end optimizations do not
   // think that we have library functions.
   //
@@ -131,9 +138,12 @@ private:
   static llvm::raw_ostream *m_llpcOuts;           // nullptr or stream for LLPC_OUTS
   llvm::LLVMContext &m_context;                   // LLVM context
   llvm::TargetMachine *m_targetMachine = nullptr; // Target machine
+  std::string m_targetMachineKey;                 // Key of the target machine in the pool of free target machines
   TargetInfo *m_targetInfo = nullptr;             // Target info
   unsigned m_palAbiVersion = 0xFFFFFFFF;          // PAL pipeline ABI version to compile for
   PassManagerCache *m_passManagerCache = nullptr; // Pass manager cache and creator
+  Builder *m_freeBuilderRecorder = nullptr;       // Free BuilderRecorder for reuse by createBuilder()
+  Builder *m_freeBuilderImpl = nullptr;           // Free BuilderImpl for reuse by createBuilder()
 };
 
 } // namespace lgc
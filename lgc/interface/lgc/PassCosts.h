@@ -0,0 +1,69 @@
+/*
+ ***********************************************************************************************************************
+ *
+ *  Copyright (c) 2020 Advanced Micro Devices, Inc. All Rights Reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ **********************************************************************************************************************/
+/**
+ ***********************************************************************************************************************
+ * @file  PassCosts.h
+ * @brief LLPC header file: contains declaration of class lgc::PassCosts.
+ ***********************************************************************************************************************
+ */
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+
+namespace lgc {
+
+// The accumulated cost of the runs of one pass
+struct PassCost {
+  uint64_t runCount = 0; // Number of times the pass was run
+  double time = 0;       // Total wall time of the runs, in seconds
+  int64_t memUsed = 0;   // Total growth of allocated memory during the runs, in bytes
+};
+
+// Pass costs keyed by pass name
+typedef std::map<std::string, PassCost> PassCostMap;
+
+// =====================================================================================================================
+// Per-pass time and memory accounting, when the -pass-costs option is set. LGC pass managers then bracket each pass
+// with accounting passes, and a run adds its cost to the pass cost map of the running thread, if one is set. As pass
+// managers are cached, whether passes are bracketed is decided when they are added, and is independent of the thread
+// that later runs them.
+class PassCosts {
+public:
+  // Get whether pass costs are being accounted
+  static bool isEnabled();
+
+  // Set the pass cost map that passes run on the current thread add to, or nullptr for none; returns the previous one
+  static PassCostMap *setThreadCostMap(PassCostMap *costMap);
+
+  // Get the pass cost map of the current thread, or nullptr if none
+  static PassCostMap *getThreadCostMap();
+
+  // Add the costs of one map into another
+  static void merge(PassCostMap &dest, const PassCostMap &src);
+};
+
+} // namespace lgc
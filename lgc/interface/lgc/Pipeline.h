@@ -35,6 +35,7 @@
 #include "llvm/IR/Module.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/raw_ostream.h"
+#include <memory>
 
 namespace llvm {
 
@@ -67,6 +68,7 @@ enum NggFlag : unsigned {
   NggFlagEnableSphereCulling = 0x0400,          // Enable frustum culling based on a sphere
   NggFlagEnableSmallPrimFilter = 0x0800,        // Enable trivial sub-sample primitive culling
   NggFlagEnableCullDistanceCulling = 0x1000,    // Enable culling when "cull distance" exports are present
+  NggFlagEnableAutoCulling = 0x2000,            // Choose the cullers from the cost of the vertex-processing stage
 };
 
 // Enumerates various sizing options of sub-group size for NGG primitive shader.
@@ -92,9 +94,29 @@ enum class WaveBreak : unsigned {
   DrawTime = 0xF, ///< Choose wave break size per draw
 };
 
+// Accuracy tier used when expanding transcendental builder operations (atan, asin, sinh, pow, ...).
+enum class TranscendentalPrecision : unsigned {
+  Accurate = 0, ///< Full-length polynomial sequences
+  Relaxed = 1,  ///< Lower-degree minimax polynomials, absolute error below 2e-4
+  Fast = 2,     ///< Relaxed, plus sequences built directly on the hardware exp/log/rcp instructions
+};
+
+// Swizzling of compute shader threads into 2D tiles of the workgroup.
+enum class WorkgroupSwizzle : unsigned {
+  Default = 0, ///< Swizzle only as selected by the reconfigWorkgroupLayout pipeline option
+  Auto = 1,    ///< Swizzle 2D workgroups of at least 8x8 threads that access images
+  Enable = 2,  ///< Swizzle whenever the workgroup size allows it
+  Disable = 3, ///< Never swizzle
+};
+
 // Value for shadowDescriptorTable pipeline option.
 static const unsigned ShadowDescriptorTableDisable = ~0U;
 
+// Prefix of the name given to constant data that a non-fragment shader stage reads, in a full pipeline ELF. The data
+// is at the end of .text after the fragment shader, and is addressed relative to the code that reads it, so a client
+// that replaces the fragment shader in the ELF with one from another pipeline must keep the data in place.
+static const char NonFragmentConstantPrefix[] = "lgc.nonfragment.const.";
+
 // Middle-end per-pipeline options to pass to SetOptions.
 // The front-end should zero-initialize it with "= {}" in case future changes add new fields.
 struct Options {
@@ -117,6 +139,14 @@ struct Options {
   unsigned shadowDescriptorTable;      // High dword of shadow descriptor table address, or
                                        //   ShadowDescriptorTableDisable to disable shadow descriptor tables
   unsigned allowNullDescriptor;        // Allow and give defined behavior for null descriptor
+  unsigned fastCompile;                // If set, run only lightweight optimizations and codegen at a lower
+                                       //   optimization level, trading code quality for compile time
+  unsigned robustBufferAccess;         // If set, each component of a buffer access must be range checked on its
+                                       //   own (VK_EXT_robustness2)
+  unsigned optLevel;                   // Codegen optimization level plus one (CodeGenOpt::Level + 1), or 0 to use
+                                       //   the default level of the target machine
+  unsigned separateStageCache;         // If set, the ELF of a shader stage may be cached on its own and reused in
+                                       //   other pipelines, so no stage may depend on the code of another stage
 };
 
 // Middle-end per-shader options to pass to SetShaderOptions.
@@ -164,6 +194,12 @@ struct ShaderOptions {
 
   /// Default unroll threshold for LLVM.
   unsigned unrollThreshold;
+
+  // Accuracy tier for transcendental operations expanded by the builder.
+  TranscendentalPrecision transcendentalPrecision;
+
+  // Swizzling of compute shader threads into 2D tiles of the workgroup.
+  WorkgroupSwizzle workgroupSwizzle;
 };
 
 // =====================================================================================================================
@@ -190,10 +226,17 @@ enum class ResourceNodeType : unsigned {
                           ///  space for a sampler descriptor (starting with resource descriptor), but the 4-dword
                           ///  sampler descriptor is ignored and overridden with an 8-dword immutable YCbCr converting
                           ///  sampler
-  InlineBuffer,           ///< Inline buffer, with descriptor set and binding
+  InlineBuffer,           ///< Inline buffer, with descriptor set and binding; its data is held directly in the table
   Count,                  ///< Count of resource mapping node types.
 };
 
+// What is known at compile time about the data format of the images bound to a descriptor
+enum class ImageFormatHint : unsigned {
+  Unknown = 0,  // Nothing known; the format is checked at runtime where it matters
+  Channel32,    // Every image bound has 32-bit channels (32, 32_32 or 32_32_32_32 data format)
+  NonChannel32, // No image bound has 32-bit channels
+};
+
 // The representation of a user data resource node
 struct ResourceNode {
   ResourceNode() {}
@@ -208,6 +251,7 @@ struct ResourceNode {
       unsigned set;                   // Descriptor set
       unsigned binding;               // Binding
       llvm::Constant *immutableValue; // Array of vectors of i32 constants for immutable value
+      ImageFormatHint formatHint;     // Compile-time knowledge of the image data format
     };
 
     // Info for DescriptorTableVaPtr
@@ -330,6 +374,7 @@ struct ColorExportFormat {
   unsigned blendEnable;          // Blend will be enabled for this target at draw time
   unsigned blendSrcAlphaToColor; // Whether source alpha is blended to color channels for this target
                                  //  at draw time
+  unsigned channelWriteMask;     // Mask of channels written to this target at draw time (0 means all channels)
 };
 
 // Struct to pass to SetColorExportState
@@ -538,6 +583,13 @@ public:
   // @param nodes : The resource mapping nodes. Only used for the duration of the call; the call copies the nodes.
   virtual void setUserDataNodes(llvm::ArrayRef<ResourceNode> nodes) = 0;
 
+  // Set the resource mapping nodes for the pipeline, as above, but take ownership of the buffer that the front-end
+  // built them in instead of copying them.
+  //
+  // @param allocNodes : Buffer holding the top-level nodes and all their inner tables
+  // @param nodes : The top-level resource mapping nodes, which must be within allocNodes
+  virtual void setUserDataNodes(std::unique_ptr<ResourceNode[]> allocNodes, llvm::ArrayRef<ResourceNode> nodes) = 0;
+
   // Set device index.
   virtual void setDeviceIndex(unsigned deviceIndex) = 0;
 
@@ -0,0 +1,77 @@
+/*
+ ***********************************************************************************************************************
+ *
+ *  Copyright (c) 2020 Advanced Micro Devices, Inc. All Rights Reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ **********************************************************************************************************************/
+/**
+ ***********************************************************************************************************************
+ * @file  TraceEvents.h
+ * @brief LLPC header file: contains declaration of class lgc::TraceEvents.
+ ***********************************************************************************************************************
+ */
+#pragma once
+
+#include "llvm/ADT/StringRef.h"
+#include <cstdint>
+
+namespace lgc {
+
+// =====================================================================================================================
+// Records begin/end events of compiler phases, tagged by thread, when the -trace-events-file option is set. The events
+// are written to that file in Chrome trace event (JSON) format when the process exits, for viewing in chrome://tracing
+// or Perfetto. Recording is thread-safe, and does not take a lock after the first event on each thread.
+class TraceEvents {
+public:
+  // Get whether trace events are being recorded
+  static bool isEnabled();
+
+  // Get the current time in microseconds, as used for trace event timestamps
+  static uint64_t getTime();
+
+  // Record a complete event
+  static void record(llvm::StringRef name, const char *category, uint64_t startTime, uint64_t endTime);
+};
+
+// =====================================================================================================================
+// Records a trace event for the duration of a scope, if trace events are being recorded.
+class TraceScope {
+public:
+  // @param name : Name of the event
+  // @param category : Category of the event
+  TraceScope(const char *name, const char *category)
+      : m_name(name), m_category(category), m_startTime(TraceEvents::isEnabled() ? TraceEvents::getTime() : 0) {}
+
+  ~TraceScope() {
+    if (m_startTime != 0)
+      TraceEvents::record(m_name, m_category, m_startTime, TraceEvents::getTime());
+  }
+
+private:
+  TraceScope(const TraceScope &) = delete;
+  TraceScope &operator=(const TraceScope &) = delete;
+
+  const char *m_name;     // Name of the event
+  const char *m_category; // Category of the event
+  uint64_t m_startTime;   // Start time of the event, or 0 if not recording
+};
+
+} // namespace lgc
@@ -57,8 +57,9 @@ FragColorExport::FragColorExport(LLVMContext *context) : m_context(context) {
 // @param insertPos : Where to insert fragment color export instructions
 // @param expFmt: The format for the given render target
 // @param signedness: If output should be interpreted as a signed integer
+// @param channelMask: Mask of channels (RGBA) whose values can reach the render target
 llvm::Value *FragColorExport::run(llvm::Value *output, unsigned hwColorTarget, llvm::Instruction *insertPos,
-                                  ExportFormat expFmt, const bool signedness) {
+                                  ExportFormat expFmt, const bool signedness, unsigned channelMask) {
   Type *outputTy = output->getType();
   const unsigned bitWidth = outputTy->getScalarSizeInBits();
   auto compTy = outputTy->isVectorTy() ? cast<VectorType>(outputTy)->getElementType() : outputTy;
@@ -277,6 +278,19 @@ llvm::Value *FragColorExport::run(llvm::Value *output, unsigned hwColorTarget, l
 
   Value *exportCall = nullptr;
 
+  // NOTE: Only the full ABGR export formats keep a one-to-one mapping from channels to export sources, so those are
+  // the ones whose enable mask can drop channels that never reach the render target.
+  unsigned exportMask = 0;
+  if (comprExp) {
+    if ((channelMask & 0x3) != 0)
+      exportMask |= 0x3;
+    if (compCount > 2 && (channelMask & 0xC) != 0)
+      exportMask |= 0xC;
+  } else if (expFmt == EXP_FORMAT_32_ABGR)
+    exportMask = ((1 << compCount) - 1) & channelMask;
+  else
+    exportMask = (1 << compCount) - 1;
+
   if (expFmt == EXP_FORMAT_ZERO) {
     // Do nothing
   } else if (comprExp) {
@@ -306,7 +320,7 @@ llvm::Value *FragColorExport::run(llvm::Value *output, unsigned hwColorTarget, l
 
     Value *args[] = {
         ConstantInt::get(Type::getInt32Ty(*m_context), EXP_TARGET_MRT_0 + hwColorTarget), // tgt
-        ConstantInt::get(Type::getInt32Ty(*m_context), compCount > 2 ? 0xF : 0x3),        // en
+        ConstantInt::get(Type::getInt32Ty(*m_context), exportMask),                       // en
         comps[0],                                                                         // src0
         comps[1],                                                                         // src1
         ConstantInt::get(Type::getInt1Ty(*m_context), false),                             // done
@@ -318,7 +332,7 @@ llvm::Value *FragColorExport::run(llvm::Value *output, unsigned hwColorTarget, l
     // 32-bit export
     Value *args[] = {
         ConstantInt::get(Type::getInt32Ty(*m_context), EXP_TARGET_MRT_0 + hwColorTarget), // tgt
-        ConstantInt::get(Type::getInt32Ty(*m_context), (1 << compCount) - 1),             // en
+        ConstantInt::get(Type::getInt32Ty(*m_context), exportMask),                       // en
         comps[0],                                                                         // src0
         comps[1],                                                                         // src1
         comps[2],                                                                         // src2
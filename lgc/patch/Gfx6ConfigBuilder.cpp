@@ -930,7 +930,7 @@ void ConfigBuilder::buildPsRegConfig(ShaderStage shaderStage, T *pConfig) {
     spiShaderColFormat |= (expFmts[i] << (4 * i));
   }
 
-  if (spiShaderColFormat == 0 && depthExpFmt == EXP_FORMAT_ZERO) {
+  if (spiShaderColFormat == 0 && depthExpFmt == EXP_FORMAT_ZERO && resUsage->inOutUsage.fs.dummyExport) {
     // NOTE: Hardware requires that fragment shader always exports "something" (color or depth) to the SX.
     // If both SPI_SHADER_Z_FORMAT and SPI_SHADER_COL_FORMAT are zero, we need to override
     // SPI_SHADER_COL_FORMAT to export one channel to MRT0. This dummy export format will be masked
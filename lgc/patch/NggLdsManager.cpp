@@ -45,6 +45,18 @@
 
 using namespace llvm;
 
+namespace llvm {
+namespace cl {
+
+// -ngg-compact-lds-layout: overlap NGG LDS regions whose lifetimes do not intersect and skip unused regions
+static opt<bool> NggCompactLdsLayout("ngg-compact-lds-layout",
+                                     desc("Overlap NGG LDS regions whose lifetimes do not intersect and skip regions "
+                                          "that are not used"),
+                                     init(false));
+
+} // namespace cl
+} // namespace llvm
+
 namespace lgc {
 
 // =====================================================================================================================
@@ -225,35 +237,36 @@ NggLdsManager::NggLdsManager(Module *module, PipelineState *pipelineState, IRBui
       //                            | Tesscoord X | Tesscoord Y | Patch ID    | Relative patch ID | (TES)
       //                            +-------------+-------------+-------------+-------------------+
       //
-      unsigned ldsRegionStart = 0;
-      for (unsigned region = LdsRegionEsBeginRange; region <= LdsRegionEsEndRange; ++region) {
-        // NOTE: For NGG non pass-through mode, primitive ID region is overlapped with position data.
-        if (region == LdsRegionDistribPrimId)
-          continue;
+      // With the compact layout, vertex count is placed before draw flag and compacted data region starts from
+      // draw flag (see layoutEsRegions()).
+      //
+      layoutEsRegions(m_pipelineState, m_ldsRegionStart, cl::NggCompactLdsLayout);
 
-        // NOTE: If cull distance culling is disabled, skip this region
-        if (region == LdsRegionCullDistance && !nggControl->enableCullDistanceCulling)
+      for (unsigned region = LdsRegionEsBeginRange; region <= LdsRegionEsEndRange; ++region) {
+        if (region == LdsRegionDistribPrimId || m_ldsRegionStart[region] == InvalidValue)
           continue;
 
-        if (hasTs) {
-          // Skip those regions that are for VS only
-          if (region == LdsRegionCompactVertexId || region == LdsRegionCompactInstanceId ||
-              region == LdsRegionCompactPrimId)
-            continue;
-        } else {
-          // Skip those regions that are for TES only
-          if (region == LdsRegionCompactTessCoordX || region == LdsRegionCompactTessCoordY ||
-              region == LdsRegionCompactRelPatchId || region == LdsRegionCompactPatchId)
-            continue;
-        }
-
-        m_ldsRegionStart[region] = ldsRegionStart;
-        ldsRegionStart += LdsRegionSizes[region];
-
         LLPC_OUTS(format("%-40s : offset = 0x%04" PRIX32 ", size = 0x%04" PRIX32, m_ldsRegionNames[region],
                          m_ldsRegionStart[region], LdsRegionSizes[region])
                   << "\n");
       }
+
+      if (cl::NggCompactLdsLayout) {
+        // Report the saving against the default layout where all regions are placed back to back
+        const unsigned defaultLdsSize = layoutEsRegions(m_pipelineState, nullptr, false);
+        const unsigned compactLdsSize = layoutEsRegions(m_pipelineState, nullptr, true);
+        const unsigned ldsSizePerCu = m_pipelineState->getTargetInfo().getGpuProperty().ldsSizePerCu;
+
+        const unsigned otherLdsSize = calcFactor.gsOnChipLdsSize * SizeOfDword - compactLdsSize;
+        const unsigned defaultSubgroupsPerCu = ldsSizePerCu / std::max(1u, otherLdsSize + defaultLdsSize);
+        const unsigned compactSubgroupsPerCu = ldsSizePerCu / std::max(1u, otherLdsSize + compactLdsSize);
+
+        LLPC_OUTS(format("%-40s :                  size = 0x%04" PRIX32, static_cast<const char *>("LDS saved"),
+                         defaultLdsSize - compactLdsSize)
+                  << "\n");
+        LLPC_OUTS("Sub-groups per CU limited by LDS: " << defaultSubgroupsPerCu << " -> " << compactSubgroupsPerCu
+                                                       << "\n");
+      }
     }
   }
 
@@ -293,33 +306,92 @@ unsigned NggLdsManager::calcEsExtraLdsSize(PipelineState *pipelineState) {
     }
 
     esExtraLdsSize = distributePrimId ? LdsRegionSizes[LdsRegionDistribPrimId] : 0;
-  } else {
-    for (unsigned region = LdsRegionEsBeginRange; region <= LdsRegionEsEndRange; ++region) {
-      // NOTE: For NGG non pass-through mode, primitive ID region is overlapped with position data.
-      if (region == LdsRegionDistribPrimId)
-        continue;
+  } else
+    esExtraLdsSize = layoutEsRegions(pipelineState, nullptr, cl::NggCompactLdsLayout);
+
+  return esExtraLdsSize;
+}
 
-      // NOTE: If cull distance culling is disabled, skip this region
-      if (region == LdsRegionCullDistance && !nggControl->enableCullDistanceCulling)
+// =====================================================================================================================
+// Lays out LDS regions for ES-only NGG non pass-through mode, returning the total LDS size of those regions (in bytes).
+//
+// NOTE: The primitive shader runs in phases that are separated by barriers. The draw flag and cull distance regions
+// are last read before the barrier that precedes the writes of compacted data, so with the compact layout, the
+// compacted data region is overlapped with them. The compacted system values that ES does not use are skipped.
+//
+// @param pipelineState : Pipeline state
+// @param [out] regionStart : Start LDS offsets of the regions (in bytes, optional)
+// @param compactLayout : Whether to overlap regions whose lifetimes do not intersect and skip unused regions
+unsigned NggLdsManager::layoutEsRegions(PipelineState *pipelineState, unsigned *regionStart, bool compactLayout) {
+  const auto nggControl = pipelineState->getNggControl();
+  const bool hasTs = pipelineState->hasShaderStage(ShaderStageTessControl) ||
+                     pipelineState->hasShaderStage(ShaderStageTessEval);
+  const auto resUsage = pipelineState->getShaderResourceUsage(hasTs ? ShaderStageTessEval : ShaderStageVertex);
+
+  unsigned ldsRegionStart = 0;
+  unsigned ldsRegionEnd = 0;
+  unsigned drawFlagStart = InvalidValue;
+  for (unsigned region = LdsRegionEsBeginRange; region <= LdsRegionEsEndRange; ++region) {
+    // NOTE: For NGG non pass-through mode, primitive ID region is overlapped with position data.
+    if (region == LdsRegionDistribPrimId)
+      continue;
+
+    // NOTE: If cull distance culling is disabled, skip this region
+    if (region == LdsRegionCullDistance && !nggControl->enableCullDistanceCulling)
+      continue;
+
+    if (hasTs) {
+      // Skip those regions that are for VS only
+      if (region == LdsRegionCompactVertexId || region == LdsRegionCompactInstanceId ||
+          region == LdsRegionCompactPrimId)
         continue;
 
-      if (hasTs) {
-        // Skip those regions that are for VS only
-        if (region == LdsRegionCompactVertexId || region == LdsRegionCompactInstanceId ||
-            region == LdsRegionCompactPrimId)
+      if (compactLayout) {
+        const auto &builtInUsage = resUsage->builtInUsage.tes;
+        if ((region == LdsRegionCompactTessCoordX || region == LdsRegionCompactTessCoordY) && !builtInUsage.tessCoord)
+          continue;
+        if (region == LdsRegionCompactPatchId && !builtInUsage.primitiveId)
           continue;
-      } else {
-        // Skip those regions that are for TES only
-        if (region == LdsRegionCompactTessCoordX || region == LdsRegionCompactTessCoordY ||
-            region == LdsRegionCompactRelPatchId || region == LdsRegionCompactPatchId)
+      }
+    } else {
+      // Skip those regions that are for TES only
+      if (region == LdsRegionCompactTessCoordX || region == LdsRegionCompactTessCoordY ||
+          region == LdsRegionCompactRelPatchId || region == LdsRegionCompactPatchId)
+        continue;
+
+      if (compactLayout) {
+        const auto &builtInUsage = resUsage->builtInUsage.vs;
+        if ((region == LdsRegionCompactVertexId && !builtInUsage.vertexIndex) ||
+            (region == LdsRegionCompactInstanceId && !builtInUsage.instanceIndex) ||
+            (region == LdsRegionCompactPrimId && !builtInUsage.primitiveId))
           continue;
       }
+    }
 
-      esExtraLdsSize += LdsRegionSizes[region];
+    // NOTE: With the compact layout, compacted data starts from where the draw flag region starts, with the vertex
+    // count region moved before the draw flag region since it is still read after the draw flag is dead.
+    if (compactLayout) {
+      if (region == LdsRegionDrawFlag) {
+        if (regionStart)
+          regionStart[LdsRegionVertCountInWaves] = ldsRegionStart;
+        ldsRegionStart += LdsRegionSizes[LdsRegionVertCountInWaves];
+        drawFlagStart = ldsRegionStart;
+      } else if (region == LdsRegionVertCountInWaves)
+        continue;
+      else if (region == LdsRegionCompactBeginRange) {
+        // Overlap compacted data with the draw flag and cull distance regions
+        assert(drawFlagStart != InvalidValue);
+        ldsRegionStart = drawFlagStart;
+      }
     }
+
+    if (regionStart)
+      regionStart[region] = ldsRegionStart;
+    ldsRegionStart += LdsRegionSizes[region];
+    ldsRegionEnd = std::max(ldsRegionEnd, ldsRegionStart);
   }
 
-  return esExtraLdsSize;
+  return ldsRegionEnd;
 }
 
 // =====================================================================================================================
@@ -114,6 +114,8 @@ private:
   NggLdsManager(const NggLdsManager &) = delete;
   NggLdsManager &operator=(const NggLdsManager &) = delete;
 
+  static unsigned layoutEsRegions(PipelineState *pipelineState, unsigned *regionStart, bool compactLayout);
+
   static const unsigned LdsRegionSizes[LdsRegionCount]; // LDS sizes for all LDS region types (in bytes)
   static const char *m_ldsRegionNames[LdsRegionCount];  // Name strings for all LDS region types
 
@@ -50,6 +50,18 @@
 
 using namespace llvm;
 
+namespace llvm {
+namespace cl {
+
+// -ngg-single-wave-compaction: compute compaction offsets without LDS when the sub-group fits in a single wave
+static opt<bool> NggSingleWaveCompaction("ngg-single-wave-compaction",
+                                         desc("Compute NGG vertex compaction offsets without LDS when the sub-group "
+                                              "fits in a single wave"),
+                                         init(false));
+
+} // namespace cl
+} // namespace llvm
+
 namespace lgc {
 
 // =====================================================================================================================
@@ -908,6 +920,7 @@ void NggPrimShader::constructPrimShaderWithoutGs(Module *module) {
     auto accThreadCountBlock = createBlock(entryPoint, ".accThreadCount");
     auto endAccThreadCountBlock = createBlock(entryPoint, ".endAccThreadCount");
 
+    auto syncThreadCountBlock = createBlock(entryPoint, ".syncThreadCount");
     auto readThreadCountBlock = createBlock(entryPoint, ".readThreadCount");
     auto writeCompactDataBlock = createBlock(entryPoint, ".writeCompactData");
     auto endReadThreadCountBlock = createBlock(entryPoint, ".endReadThreadCount");
@@ -1093,7 +1106,8 @@ void NggPrimShader::constructPrimShaderWithoutGs(Module *module) {
       separateExp = !resUsage->resourceWrite; // No resource writing
 
       // NOTE: For vertex compaction, we have to run ES for twice (get vertex position data and
-      // get other exported data).
+      // get other exported data). The first run only returns the data required by culling, so everything else
+      // computed by ES is dead here and attribute computation is deferred to the surviving vertices.
       const auto entryName = separateExp ? lgcName::NggEsEntryVariantPos : lgcName::NggEsEntryVariant;
 
       runEsOrEsVariant(module, entryName, entryPoint->arg_begin(), false, &expDataSet, writePosDataBlock);
@@ -1116,38 +1130,25 @@ void NggPrimShader::constructPrimShaderWithoutGs(Module *module) {
 
       // Write cull distance sign mask to LDS
       if (m_nggControl->enableCullDistanceCulling) {
-        unsigned clipCullPos = EXP_TARGET_POS_1;
+        const unsigned clipCullPos = getClipCullDistanceExpTarget();
         std::vector<Value *> clipCullDistance;
         std::vector<Value *> cullDistance;
 
-        bool usePointSize = false;
-        bool useLayer = false;
-        bool useViewportIndex = false;
         unsigned clipDistanceCount = 0;
         unsigned cullDistanceCount = 0;
 
         if (hasTs) {
           const auto &builtInUsage = resUsage->builtInUsage.tes;
 
-          usePointSize = builtInUsage.pointSize;
-          useLayer = builtInUsage.layer;
-          useViewportIndex = builtInUsage.viewportIndex;
           clipDistanceCount = builtInUsage.clipDistance;
           cullDistanceCount = builtInUsage.cullDistance;
         } else {
           const auto &builtInUsage = resUsage->builtInUsage.vs;
 
-          usePointSize = builtInUsage.pointSize;
-          useLayer = builtInUsage.layer;
-          useViewportIndex = builtInUsage.viewportIndex;
           clipDistanceCount = builtInUsage.clipDistance;
           cullDistanceCount = builtInUsage.cullDistance;
         }
 
-        // NOTE: When gl_PointSize, gl_Layer, or gl_ViewportIndex is used, gl_ClipDistance[] or
-        // gl_CullDistance[] should start from pos2.
-        clipCullPos = (usePointSize || useLayer || useViewportIndex) ? EXP_TARGET_POS_2 : EXP_TARGET_POS_1;
-
         // Collect clip/cull distance from exported value
         for (const auto &expData : expDataSet) {
           if (expData.target == clipCullPos || expData.target == clipCullPos + 1) {
@@ -1291,6 +1292,7 @@ void NggPrimShader::constructPrimShaderWithoutGs(Module *module) {
 
     // Construct ".endWriteDrawFlag" block
     Value *drawCount = nullptr;
+    Value *singleWave = nullptr;
     {
       m_builder->SetInsertPoint(endWriteDrawFlagBlock);
 
@@ -1308,9 +1310,21 @@ void NggPrimShader::constructPrimShaderWithoutGs(Module *module) {
       drawCount = m_builder->CreateIntrinsic(Intrinsic::ctpop, m_builder->getInt64Ty(), drawMask);
       drawCount = m_builder->CreateTrunc(drawCount, m_builder->getInt32Ty());
 
+      // NOTE: When the whole sub-group fits in a single wave, the vertex count of this wave is already the vertex
+      // count of the sub-group and no wave precedes it. In this case, we skip accumulating per-wave vertex counts
+      // through LDS along with the barrier that guards it. The condition is uniform in the sub-group.
+      if (cl::NggSingleWaveCompaction) {
+        auto waveSizeVal = m_builder->getInt32(waveSize);
+        auto vertInSingleWave = m_builder->CreateICmpULE(m_nggFactor.vertCountInSubgroup, waveSizeVal);
+        auto primInSingleWave = m_builder->CreateICmpULE(m_nggFactor.primCountInSubgroup, waveSizeVal);
+        singleWave = m_builder->CreateAnd(vertInSingleWave, primInSingleWave);
+      } else
+        singleWave = m_builder->getFalse();
+
       auto threadIdUpbound =
           m_builder->CreateSub(m_builder->getInt32(waveCountInSubgroup), m_nggFactor.waveIdInSubgroup);
-      auto threadValid = m_builder->CreateICmpULT(m_nggFactor.threadIdInWave, threadIdUpbound);
+      Value *threadValid = m_builder->CreateICmpULT(m_nggFactor.threadIdInWave, threadIdUpbound);
+      threadValid = m_builder->CreateAnd(threadValid, m_builder->CreateNot(singleWave));
 
       m_builder->CreateCondBr(threadValid, accThreadCountBlock, endAccThreadCountBlock);
     }
@@ -1335,7 +1349,29 @@ void NggPrimShader::constructPrimShaderWithoutGs(Module *module) {
     {
       m_builder->SetInsertPoint(endAccThreadCountBlock);
 
+      m_builder->CreateCondBr(singleWave, readThreadCountBlock, syncThreadCountBlock);
+    }
+
+    // Construct ".syncThreadCount" block
+    Value *vertCountInWavesFromLds = nullptr;
+    Value *vertCountInPrevWavesFromLds = nullptr;
+    {
+      m_builder->SetInsertPoint(syncThreadCountBlock);
+
       m_builder->CreateIntrinsic(Intrinsic::amdgcn_s_barrier, {}, {});
+
+      unsigned regionStart = m_ldsManager->getLdsRegionStart(LdsRegionVertCountInWaves);
+
+      // The dword following dwords for all waves stores the vertex count of the entire sub-group
+      Value *ldsOffset = m_builder->getInt32(regionStart + waveCountInSubgroup * SizeOfDword);
+      vertCountInWavesFromLds = m_ldsManager->readValueFromLds(m_builder->getInt32Ty(), ldsOffset);
+
+      // Get vertex count for all waves prior to this wave
+      ldsOffset = m_builder->CreateShl(m_nggFactor.waveIdInSubgroup, 2);
+      ldsOffset = m_builder->CreateAdd(m_builder->getInt32(regionStart), ldsOffset);
+
+      vertCountInPrevWavesFromLds = m_ldsManager->readValueFromLds(m_builder->getInt32Ty(), ldsOffset);
+
       m_builder->CreateBr(readThreadCountBlock);
     }
 
@@ -1346,21 +1382,19 @@ void NggPrimShader::constructPrimShaderWithoutGs(Module *module) {
     {
       m_builder->SetInsertPoint(readThreadCountBlock);
 
-      unsigned regionStart = m_ldsManager->getLdsRegionStart(LdsRegionVertCountInWaves);
+      PHINode *vertCountInWavesPhi = m_builder->CreatePHI(m_builder->getInt32Ty(), 2);
+      vertCountInWavesPhi->addIncoming(drawCount, endAccThreadCountBlock);
+      vertCountInWavesPhi->addIncoming(vertCountInWavesFromLds, syncThreadCountBlock);
 
-      // The dword following dwords for all waves stores the vertex count of the entire sub-group
-      Value *ldsOffset = m_builder->getInt32(regionStart + waveCountInSubgroup * SizeOfDword);
-      vertCountInWaves = m_ldsManager->readValueFromLds(m_builder->getInt32Ty(), ldsOffset);
+      PHINode *vertCountInPrevWavesPhi = m_builder->CreatePHI(m_builder->getInt32Ty(), 2);
+      vertCountInPrevWavesPhi->addIncoming(m_builder->getInt32(0), endAccThreadCountBlock);
+      vertCountInPrevWavesPhi->addIncoming(vertCountInPrevWavesFromLds, syncThreadCountBlock);
 
       // NOTE: We promote vertex count in waves to SGPR since it is treated as an uniform value.
-      vertCountInWaves = m_builder->CreateIntrinsic(Intrinsic::amdgcn_readfirstlane, {}, vertCountInWaves);
+      vertCountInWaves = m_builder->CreateIntrinsic(Intrinsic::amdgcn_readfirstlane, {}, vertCountInWavesPhi);
       threadCountInWaves = vertCountInWaves;
 
-      // Get vertex count for all waves prior to this wave
-      ldsOffset = m_builder->CreateShl(m_nggFactor.waveIdInSubgroup, 2);
-      ldsOffset = m_builder->CreateAdd(m_builder->getInt32(regionStart), ldsOffset);
-
-      vertCountInPrevWaves = m_ldsManager->readValueFromLds(m_builder->getInt32Ty(), ldsOffset);
+      vertCountInPrevWaves = vertCountInPrevWavesPhi;
 
       auto vertValid = m_builder->CreateICmpULT(m_nggFactor.threadIdInWave, m_nggFactor.vertCountInWave);
 
@@ -1642,6 +1676,15 @@ void NggPrimShader::constructPrimShaderWithGs(Module *module) {
   const unsigned waveCountInSubgroup = Gfx9::NggMaxThreadsPerSubgroup / waveSize;
   const bool cullingMode = !m_nggControl->passthroughMode;
 
+  // NOTE: If each GS instance always emits exactly one complete primitive (and nothing is culled), every output vertex
+  // is drawn and output vertices are already dense: GS output vertex count equals the amplified primitive count and
+  // the compacted vertex ID is the thread ID. Checking draw flags, accumulating output vertex counts and compacting
+  // output vertex IDs (along with their barriers) are then skipped. GS output still goes through the GS-VS ring in LDS
+  // since one GS thread's vertices are exported by different threads.
+  const bool fixedOutput =
+      !cullingMode &&
+      m_pipelineState->getShaderResourceUsage(ShaderStageGeometry)->inOutUsage.gs.calcFactor.emitsSinglePrimitive;
+
   auto entryPoint = module->getFunction(lgcName::NggPrimShaderEntryPoint);
 
   auto arg = entryPoint->arg_begin();
@@ -1671,13 +1714,14 @@ void NggPrimShader::constructPrimShaderWithGs(Module *module) {
   //
   //   if (threadIdInSubgroup < primCountInSubgroup)
   //     Initialize primitive connectivity data (0x80000000)
-  //   if (threadIdInSubgroup < waveCount + 1)
+  //   if (!fixedOutput && threadIdInSubgroup < waveCount + 1)
   //     Initialize per-wave and per-subgroup count of output vertices
   //   Barrier
   //
   //   if (threadIdInWave < primCountInWave)
   //     Run GS
-  //   Barrier
+  //   if (!fixedOutput)
+  //     Barrier
   //
   //   if (culling && valid primitive & threadIdInSubgroup < primCountInSubgroup) {
   //     Do culling (run culling algorithms)
@@ -1686,16 +1730,19 @@ void NggPrimShader::constructPrimShaderWithGs(Module *module) {
   //   }
   //   Barrier
   //
-  //   if (threadIdInSubgroup < vertCountInSubgroup)
-  //     Check draw flags of output vertices and compute draw mask
+  //   if (!fixedOutput) {
+  //     if (threadIdInSubgroup < vertCountInSubgroup)
+  //       Check draw flags of output vertices and compute draw mask
   //
-  //   if (threadIdInWave < waveCount - waveId)
-  //     Accumulate per-wave and per-subgroup count of output vertices
-  //   Barrier
-  //   Update vertCountInSubgroup
+  //     if (threadIdInWave < waveCount - waveId)
+  //       Accumulate per-wave and per-subgroup count of output vertices
+  //     Barrier
+  //     Update vertCountInSubgroup
   //
-  //   if (vertex compacted && vertex drawed)
-  //     Compact vertex thread ID (map: compacted -> uncompacted)
+  //     if (vertex compacted && vertex drawed)
+  //       Compact vertex thread ID (map: compacted -> uncompacted)
+  //   } else
+  //     vertCountInSubgroup = primCountInSubgroup
   //
   //   if (waveId == 0)
   //     GS allocation request (GS_ALLOC_REQ)
@@ -1718,7 +1765,10 @@ void NggPrimShader::constructPrimShaderWithGs(Module *module) {
   auto initOutPrimDataBlock = createBlock(entryPoint, ".initOutPrimData");
   auto endInitOutPrimDataBlock = createBlock(entryPoint, ".endInitOutPrimData");
 
-  auto initOutVertCountBlock = createBlock(entryPoint, ".initOutVertCount");
+  // Create blocks of output vertex counting and compaction only if the output is not fixed
+  BasicBlock *initOutVertCountBlock = nullptr;
+  if (!fixedOutput)
+    initOutVertCountBlock = createBlock(entryPoint, ".initOutVertCount");
   auto endInitOutVertCountBlock = createBlock(entryPoint, ".endInitOutVertCount");
 
   auto beginGsBlock = createBlock(entryPoint, ".beginGs");
@@ -1734,13 +1784,20 @@ void NggPrimShader::constructPrimShaderWithGs(Module *module) {
     endCullingBlock = createBlock(entryPoint, ".endCulling");
   }
 
-  auto checkOutVertDrawFlagBlock = createBlock(entryPoint, ".checkOutVertDrawFlag");
-  auto endCheckOutVertDrawFlagBlock = createBlock(entryPoint, ".endCheckOutVertDrawFlag");
+  BasicBlock *checkOutVertDrawFlagBlock = nullptr;
+  BasicBlock *endCheckOutVertDrawFlagBlock = nullptr;
+  BasicBlock *accumOutVertCountBlock = nullptr;
+  BasicBlock *endAccumOutVertCountBlock = nullptr;
+  BasicBlock *compactOutVertIdBlock = nullptr;
+  if (!fixedOutput) {
+    checkOutVertDrawFlagBlock = createBlock(entryPoint, ".checkOutVertDrawFlag");
+    endCheckOutVertDrawFlagBlock = createBlock(entryPoint, ".endCheckOutVertDrawFlag");
 
-  auto accumOutVertCountBlock = createBlock(entryPoint, ".accumOutVertCount");
-  auto endAccumOutVertCountBlock = createBlock(entryPoint, ".endAccumOutVertCount");
+    accumOutVertCountBlock = createBlock(entryPoint, ".accumOutVertCount");
+    endAccumOutVertCountBlock = createBlock(entryPoint, ".endAccumOutVertCount");
 
-  auto compactOutVertIdBlock = createBlock(entryPoint, ".compactOutVertId");
+    compactOutVertIdBlock = createBlock(entryPoint, ".compactOutVertId");
+  }
   auto endCompactOutVertIdBlock = createBlock(entryPoint, ".endCompactOutVertId");
 
   auto allocReqBlock = createBlock(entryPoint, ".allocReq");
@@ -1801,13 +1858,17 @@ void NggPrimShader::constructPrimShaderWithGs(Module *module) {
   {
     m_builder->SetInsertPoint(endInitOutPrimDataBlock);
 
-    auto waveValid =
-        m_builder->CreateICmpULT(m_nggFactor.threadIdInSubgroup, m_builder->getInt32(waveCountInSubgroup + 1));
-    m_builder->CreateCondBr(waveValid, initOutVertCountBlock, endInitOutVertCountBlock);
+    if (fixedOutput) {
+      m_builder->CreateBr(endInitOutVertCountBlock);
+    } else {
+      auto waveValid =
+          m_builder->CreateICmpULT(m_nggFactor.threadIdInSubgroup, m_builder->getInt32(waveCountInSubgroup + 1));
+      m_builder->CreateCondBr(waveValid, initOutVertCountBlock, endInitOutVertCountBlock);
+    }
   }
 
   // Construct ".initOutVertCount" block
-  {
+  if (!fixedOutput) {
     m_builder->SetInsertPoint(initOutVertCountBlock);
 
     writePerThreadDataToLds(m_builder->getInt32(0), m_nggFactor.threadIdInSubgroup, LdsRegionOutVertCountInWaves);
@@ -1839,9 +1900,13 @@ void NggPrimShader::constructPrimShaderWithGs(Module *module) {
   {
     m_builder->SetInsertPoint(endGsBlock);
 
-    m_builder->CreateIntrinsic(Intrinsic::amdgcn_s_barrier, {}, {});
+    // NOTE: For fixed output, GS output is made visible by the barrier following GS allocation request.
+    if (!fixedOutput)
+      m_builder->CreateIntrinsic(Intrinsic::amdgcn_s_barrier, {}, {});
 
-    if (cullingMode) {
+    if (fixedOutput) {
+      m_builder->CreateBr(endCompactOutVertIdBlock);
+    } else if (cullingMode) {
       // Do culling
       primData =
           readPerThreadDataFromLds(m_builder->getInt32Ty(), m_nggFactor.threadIdInSubgroup, LdsRegionOutPrimData);
@@ -1902,7 +1967,7 @@ void NggPrimShader::constructPrimShaderWithGs(Module *module) {
 
   // Construct ".checkOutVertDrawFlag"
   Value *drawFlag = nullptr;
-  {
+  if (!fixedOutput) {
     m_builder->SetInsertPoint(checkOutVertDrawFlagBlock);
 
     const unsigned outVertsPerPrim = getOutputVerticesPerPrimitive();
@@ -1941,7 +2006,7 @@ void NggPrimShader::constructPrimShaderWithGs(Module *module) {
   // Construct ".endCheckOutVertDrawFlag"
   Value *drawMask = nullptr;
   Value *outVertCountInWave = nullptr;
-  {
+  if (!fixedOutput) {
     m_builder->SetInsertPoint(endCheckOutVertDrawFlagBlock);
 
     auto drawFlagPhi = m_builder->CreatePHI(m_builder->getInt1Ty(), 2);
@@ -1961,7 +2026,7 @@ void NggPrimShader::constructPrimShaderWithGs(Module *module) {
   }
 
   // Construct ".accumOutVertCount" block
-  {
+  if (!fixedOutput) {
     m_builder->SetInsertPoint(accumOutVertCountBlock);
 
     auto ldsOffset = m_builder->CreateAdd(m_nggFactor.waveIdInSubgroup, m_nggFactor.threadIdInWave);
@@ -1979,7 +2044,7 @@ void NggPrimShader::constructPrimShaderWithGs(Module *module) {
   // Construct ".endAccumOutVertCount" block
   Value *vertCompacted = nullptr;
   Value *vertCountInPrevWaves = nullptr;
-  {
+  if (!fixedOutput) {
     m_builder->SetInsertPoint(endAccumOutVertCountBlock);
 
     m_builder->CreateIntrinsic(Intrinsic::amdgcn_s_barrier, {}, {});
@@ -2005,7 +2070,7 @@ void NggPrimShader::constructPrimShaderWithGs(Module *module) {
 
   // Construct ".compactOutVertId" block
   Value *compactVertexId = nullptr;
-  {
+  if (!fixedOutput) {
     m_builder->SetInsertPoint(compactOutVertIdBlock);
 
     auto drawMaskVec = m_builder->CreateBitCast(drawMask, FixedVectorType::get(Type::getInt32Ty(*m_context), 2));
@@ -2029,10 +2094,17 @@ void NggPrimShader::constructPrimShaderWithGs(Module *module) {
   {
     m_builder->SetInsertPoint(endCompactOutVertIdBlock);
 
-    auto compactVertexIdPhi = m_builder->CreatePHI(m_builder->getInt32Ty(), 2);
-    compactVertexIdPhi->addIncoming(compactVertexId, compactOutVertIdBlock);
-    compactVertexIdPhi->addIncoming(m_nggFactor.threadIdInSubgroup, endAccumOutVertCountBlock);
-    compactVertexId = compactVertexIdPhi;
+    if (fixedOutput) {
+      // Output vertices are not compacted, and there is one per amplified primitive
+      vertCompacted = m_builder->getFalse();
+      compactVertexId = m_nggFactor.threadIdInSubgroup;
+      m_nggFactor.vertCountInSubgroup = m_nggFactor.primCountInSubgroup;
+    } else {
+      auto compactVertexIdPhi = m_builder->CreatePHI(m_builder->getInt32Ty(), 2);
+      compactVertexIdPhi->addIncoming(compactVertexId, compactOutVertIdBlock);
+      compactVertexIdPhi->addIncoming(m_nggFactor.threadIdInSubgroup, endAccumOutVertCountBlock);
+      compactVertexId = compactVertexIdPhi;
+    }
 
     auto firstWaveInSubgroup = m_builder->CreateICmpEQ(m_nggFactor.waveIdInSubgroup, m_builder->getInt32(0));
     m_builder->CreateCondBr(firstWaveInSubgroup, allocReqBlock, endAllocReqBlock);
@@ -2711,7 +2783,7 @@ void NggPrimShader::runEsOrEsVariant(Module *module, StringRef entryName, Argume
 // are both removed. Instead, the exported values are returned via either a new entry-point (combined) or two new
 // entry-points (separate). Return types is something like this:
 //   .variant:       [ POS0: <4 x float>, POS1: <4 x float>, ..., PARAM0: <4 x float>, PARAM1: <4 x float>, ... ]
-//   .variant.pos:   [ POS0: <4 x float>, POS1: <4 x float>, ... ]
+//   .variant.pos:   [ POS0: <4 x float>, (clip/cull distances) ... ]
 //   .variant.param: [ PARAM0: <4 x float>, PARAM1: <4 x float>, ... ]
 //
 // @param module : LLVM module
@@ -2728,6 +2800,17 @@ Function *NggPrimShader::mutateEsToVariant(Module *module, StringRef entryName,
   const bool doPosExp = (entryName == lgcName::NggEsEntryVariantPos);
   const bool doParamExp = (entryName == lgcName::NggEsEntryVariantParam);
 
+  // NOTE: The position variant is run before culling and vertex compaction. Only keep the exports that culling
+  // consumes (vertex position and clip/cull distances), so the computation of the remaining outputs becomes dead in
+  // this variant and is only done for the vertices that survive culling.
+  const bool needClipCull = m_nggControl->enableCullDistanceCulling;
+  const unsigned clipCullPos = needClipCull ? getClipCullDistanceExpTarget() : EXP_TARGET_POS_0;
+  auto isPosSliceExport = [=](unsigned expTarget) {
+    if (expTarget == EXP_TARGET_POS_0)
+      return true;
+    return needClipCull && (expTarget == clipCullPos || expTarget == clipCullPos + 1);
+  };
+
   // Calculate export count
   unsigned expCount = 0;
 
@@ -2747,7 +2830,9 @@ Function *NggPrimShader::mutateEsToVariant(Module *module, StringRef entryName,
         bool expPos = (expTarget >= EXP_TARGET_POS_0 && expTarget <= EXP_TARGET_POS_4);
         bool expParam = (expTarget >= EXP_TARGET_PARAM_0 && expTarget <= EXP_TARGET_PARAM_31);
 
-        if ((doExp && (expPos || expParam)) || (doPosExp && expPos) || (doParamExp && expParam))
+        bool expPosSlice = isPosSliceExport(expTarget);
+
+        if ((doExp && (expPos || expParam)) || (doPosExp && expPosSlice) || (doParamExp && expParam))
           ++expCount;
       }
     }
@@ -2816,7 +2901,9 @@ Function *NggPrimShader::mutateEsToVariant(Module *module, StringRef entryName,
         bool expPos = (expTarget >= EXP_TARGET_POS_0 && expTarget <= EXP_TARGET_POS_4);
         bool expParam = (expTarget >= EXP_TARGET_PARAM_0 && expTarget <= EXP_TARGET_PARAM_31);
 
-        if ((doExp && (expPos || expParam)) || (doPosExp && expPos) || (doParamExp && expParam)) {
+        bool expPosSlice = isPosSliceExport(expTarget);
+
+        if ((doExp && (expPos || expParam)) || (doPosExp && expPosSlice) || (doParamExp && expParam)) {
           uint8_t channelMask = cast<ConstantInt>(call->getArgOperand(1))->getZExtValue();
 
           Value *expValues[4] = {};
@@ -2876,6 +2963,35 @@ Function *NggPrimShader::mutateEsToVariant(Module *module, StringRef entryName,
   return esEntryVariant;
 }
 
+// =====================================================================================================================
+// Gets the export target of the first position export that holds clip/cull distances of ES.
+unsigned NggPrimShader::getClipCullDistanceExpTarget() {
+  const bool hasTs = (m_hasTcs || m_hasTes);
+  const auto resUsage = m_pipelineState->getShaderResourceUsage(hasTs ? ShaderStageTessEval : ShaderStageVertex);
+
+  bool usePointSize = false;
+  bool useLayer = false;
+  bool useViewportIndex = false;
+
+  if (hasTs) {
+    const auto &builtInUsage = resUsage->builtInUsage.tes;
+
+    usePointSize = builtInUsage.pointSize;
+    useLayer = builtInUsage.layer;
+    useViewportIndex = builtInUsage.viewportIndex;
+  } else {
+    const auto &builtInUsage = resUsage->builtInUsage.vs;
+
+    usePointSize = builtInUsage.pointSize;
+    useLayer = builtInUsage.layer;
+    useViewportIndex = builtInUsage.viewportIndex;
+  }
+
+  // NOTE: When gl_PointSize, gl_Layer, or gl_ViewportIndex is used, gl_ClipDistance[] or
+  // gl_CullDistance[] should start from pos2.
+  return (usePointSize || useLayer || useViewportIndex) ? EXP_TARGET_POS_2 : EXP_TARGET_POS_1;
+}
+
 // =====================================================================================================================
 // Runs GS.
 //
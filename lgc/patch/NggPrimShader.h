@@ -131,6 +131,7 @@ private:
                         bool sysValueFromLds, std::vector<ExpData> *expDataSet, llvm::BasicBlock *insertAtEnd);
 
   llvm::Function *mutateEsToVariant(llvm::Module *module, llvm::StringRef entryName, std::vector<ExpData> &expDataSet);
+  unsigned getClipCullDistanceExpTarget();
 
   void runGs(llvm::Module *module, llvm::Argument *sysValueStart);
 
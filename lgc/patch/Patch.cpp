@@ -51,7 +51,6 @@
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Transforms/AggressiveInstCombine/AggressiveInstCombine.h"
 #include "llvm/Transforms/IPO.h"
-#include "llvm/Transforms/IPO/AlwaysInliner.h"
 #include "llvm/Transforms/IPO/ForceFunctionAttrs.h"
 #include "llvm/Transforms/IPO/PassManagerBuilder.h"
 #include "llvm/Transforms/InstCombine/InstCombine.h"
@@ -60,6 +59,7 @@
 #include "llvm/Transforms/Scalar/InstSimplifyPass.h"
 #include "llvm/Transforms/Scalar/Scalarizer.h"
 #include "llvm/Transforms/Utils.h"
+#include "llvm/Transforms/Vectorize.h"
 
 #define DEBUG_TYPE "lgc-patch"
 
@@ -76,6 +76,12 @@ opt<bool> DisablePatchOpt("disable-patch-opt", desc("Disable optimization for LL
 opt<bool> UseLlvmOpt("use-llvm-opt",
                      desc("Use LLVM's standard optimization set instead of the curated optimization set"), init(false));
 
+// -relaxed-precision-to-f16: Compute relaxed precision float arithmetic in 16 bits, using packed math (GFX9+)
+opt<bool> RelaxedPrecisionToF16("relaxed-precision-to-f16",
+                                desc("Compute relaxed precision float arithmetic in 16 bits, "
+                                     "using packed math (GFX9+)"),
+                                init(false));
+
 } // namespace cl
 
 } // namespace llvm
@@ -120,19 +126,20 @@ void Patch::addPasses(PipelineState *pipelineState, legacy::PassManager &passMgr
   // Lower vertex fetch operations.
   passMgr.add(createLowerVertexFetch());
 
+  // Pack compute shader workgroup variables (should be done before entry-point mutation works out occupancy from them)
+  passMgr.add(createPatchLdsLayout());
+
   // Patch entry-point mutation (should be done before external library link)
   passMgr.add(createPatchEntryPointMutate());
 
   // Function inlining and remove dead functions after it
-  passMgr.add(createAlwaysInlinerLegacyPass());
-  passMgr.add(createGlobalDCEPass());
+  passMgr.add(createPatchAlwaysInline());
 
   // Patch input import and output export operations
   passMgr.add(createPatchInOutImportExport());
 
   // Prior to general optimization, do function inlining and dead function removal once again
-  passMgr.add(createAlwaysInlinerLegacyPass());
-  passMgr.add(createGlobalDCEPass());
+  passMgr.add(createPatchAlwaysInline());
 
   // Check shader cache
   auto checkShaderCachePass = createPatchCheckShaderCache();
@@ -153,8 +160,25 @@ void Patch::addPasses(PipelineState *pipelineState, legacy::PassManager &passMgr
   // Need to run a first promote mem 2 reg to remove alloca's whose only args are lifetimes
   passMgr.add(createPromoteMemoryToRegisterPass());
 
-  if (!cl::DisablePatchOpt)
-    addOptimizationPasses(passMgr);
+  // Hoist invariant descriptor loads out of control flow, so the optimizations see them only once
+  passMgr.add(createPatchDescriptorLoadHoist());
+
+  // Compute relaxed precision arithmetic in 16 bits, before the optimizations fold the conversions between operations
+  // and the scalarizer drops the metadata marking relaxed precision vector operations
+  bool relaxedPrecisionToF16 =
+      cl::RelaxedPrecisionToF16 && pipelineState->getTargetInfo().getGfxIpVersion().major >= 9;
+  if (relaxedPrecisionToF16)
+    passMgr.add(createPatchRelaxedPrecision());
+
+  if (!cl::DisablePatchOpt) {
+    addOptimizationPasses(passMgr, pipelineState->getOptions().fastCompile);
+
+    // Pack pairs of the half operations into v2f16 operations, for packed math
+    if (relaxedPrecisionToF16) {
+      passMgr.add(createSLPVectorizerPass());
+      passMgr.add(createInstructionCombiningPass(2));
+    }
+  }
 
   // Stop timer for optimization passes and restart timer for patching passes.
   if (patchTimer) {
@@ -164,8 +188,12 @@ void Patch::addPasses(PipelineState *pipelineState, legacy::PassManager &passMgr
 
   // Patch buffer operations (must be after optimizations)
   passMgr.add(createPatchBufferOp());
+  passMgr.add(createPatchBufferOpCombine());
   passMgr.add(createInstructionCombiningPass(2));
 
+  // Merge waterfall loops that use the same non-uniform index (must be after optimizations)
+  passMgr.add(createPatchWaterfallBatch());
+
   // Fully prepare the pipeline ABI (must be after optimizations)
   passMgr.add(createPatchPreparePipelineAbi(/* onlySetCallingConvs = */ false));
 
@@ -178,8 +206,7 @@ void Patch::addPasses(PipelineState *pipelineState, legacy::PassManager &passMgr
     }
 
     // Extra optimizations after NGG primitive shader creation
-    passMgr.add(createAlwaysInlinerLegacyPass());
-    passMgr.add(createGlobalDCEPass());
+    passMgr.add(createPatchAlwaysInline());
     passMgr.add(createPromoteMemoryToRegisterPass());
     passMgr.add(createAggressiveDCEPass());
     passMgr.add(createInstructionCombiningPass());
@@ -218,7 +245,17 @@ void Patch::addPasses(PipelineState *pipelineState, legacy::PassManager &passMgr
 // Add optimization passes to pass manager
 //
 // @param [in/out] passMgr : Pass manager to add passes to
-void Patch::addOptimizationPasses(legacy::PassManager &passMgr) {
+// @param fastCompile : Whether to add only the lightweight optimizations of the fast compile tier
+void Patch::addOptimizationPasses(legacy::PassManager &passMgr, bool fastCompile) {
+  if (fastCompile) {
+    // Fast compile tier: just clean up what the front-end and patching generated, and leave loops alone.
+    passMgr.add(createPromoteMemoryToRegisterPass());
+    passMgr.add(createInstructionCombiningPass(2));
+    passMgr.add(createPatchPeepholeOpt());
+    passMgr.add(createCFGSimplificationPass());
+    return;
+  }
+
   // Set up standard optimization passes.
   if (!cl::UseLlvmOpt) {
     unsigned optLevel = 3;
@@ -0,0 +1,183 @@
+/*
+ ***********************************************************************************************************************
+ *
+ *  Copyright (c) 2020 Advanced Micro Devices, Inc. All Rights Reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ **********************************************************************************************************************/
+/**
+ ***********************************************************************************************************************
+ * @file  PatchAlwaysInline.cpp
+ * @brief LLPC source file: contains declaration and implementation of class lgc::PatchAlwaysInline.
+ ***********************************************************************************************************************
+ */
+#include "lgc/patch/Patch.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+
+#define DEBUG_TYPE "lgc-patch-always-inline"
+
+using namespace lgc;
+using namespace llvm;
+
+namespace lgc {
+
+// =====================================================================================================================
+// Pass to inline the functions that the patch passes marked always-inline, and to remove the functions and global
+// variables that are left without users.
+//
+// This does the same job as running the LLVM always-inliner followed by GlobalDCE, but only visits the call sites of
+// the always-inline functions and the bodies of the values being removed, instead of building a call graph for, and
+// scanning every instruction of, the whole pipeline module.
+class PatchAlwaysInline : public Patch {
+public:
+  static char ID;
+  PatchAlwaysInline() : Patch(ID) {}
+
+  bool runOnModule(Module &module) override;
+
+private:
+  bool inlineFunctions(Module &module);
+  bool removeDeadGlobals(Module &module);
+
+  PatchAlwaysInline(const PatchAlwaysInline &) = delete;
+  PatchAlwaysInline &operator=(const PatchAlwaysInline &) = delete;
+};
+
+char PatchAlwaysInline::ID = 0;
+
+} // namespace lgc
+
+// =====================================================================================================================
+// Create the pass that inlines always-inline functions and removes dead globals.
+ModulePass *lgc::createPatchAlwaysInline() {
+  return new PatchAlwaysInline();
+}
+
+// =====================================================================================================================
+// Run the pass on the specified LLVM module.
+//
+// @param [in,out] module : LLVM module to be run on
+bool PatchAlwaysInline::runOnModule(Module &module) {
+  LLVM_DEBUG(dbgs() << "Run the pass Patch-Always-Inline\n");
+
+  Patch::init(&module);
+
+  bool changed = inlineFunctions(module);
+  changed |= removeDeadGlobals(module);
+  return changed;
+}
+
+// =====================================================================================================================
+// Inline all call sites of the always-inline functions defined in the module.
+//
+// @param [in,out] module : LLVM module to be run on
+bool PatchAlwaysInline::inlineFunctions(Module &module) {
+  SmallVector<Function *, 8> inlineFuncs;
+  for (Function &func : module) {
+    if (!func.isDeclaration() && func.hasFnAttribute(Attribute::AlwaysInline))
+      inlineFuncs.push_back(&func);
+  }
+
+  // Inlining one function can copy calls to another always-inline function into its caller (e.g. an NGG culling
+  // routine called from an ES entry-point), so repeat until no call site is left. Shaders cannot recurse, so this
+  // terminates.
+  bool changed = false;
+  bool inlined = !inlineFuncs.empty();
+  while (inlined) {
+    inlined = false;
+    for (Function *func : inlineFuncs) {
+      SmallVector<CallInst *, 4> calls;
+      for (User *user : func->users()) {
+        auto call = dyn_cast<CallInst>(user);
+        if (call && call->getCalledFunction() == func && call->getFunction() != func)
+          calls.push_back(call);
+      }
+      for (CallInst *call : calls) {
+        InlineFunctionInfo inlineInfo;
+        if (InlineFunction(*call, inlineInfo).isSuccess())
+          inlined = true;
+      }
+    }
+    changed |= inlined;
+  }
+  return changed;
+}
+
+// =====================================================================================================================
+// Collect the global values referenced by the operands of the given user, looking through constant expressions.
+//
+// @param user : Instruction or constant whose operands are scanned
+// @param [in,out] globals : Set to add the referenced global values to
+static void collectReferencedGlobals(User *user, SmallSetVector<GlobalValue *, 16> &globals) {
+  for (Value *operand : user->operands()) {
+    if (auto global = dyn_cast<GlobalValue>(operand))
+      globals.insert(global);
+    else if (auto constExpr = dyn_cast<ConstantExpr>(operand))
+      collectReferencedGlobals(constExpr, globals);
+    else if (auto aggregate = dyn_cast<ConstantAggregate>(operand))
+      collectReferencedGlobals(aggregate, globals);
+  }
+}
+
+// =====================================================================================================================
+// Remove functions and global variables that have no users: unused declarations, and definitions with local linkage.
+// When a definition is removed, the globals it referenced are checked again, so a chain of dead functions goes in one
+// pass.
+//
+// @param [in,out] module : LLVM module to be run on
+bool PatchAlwaysInline::removeDeadGlobals(Module &module) {
+  SmallSetVector<GlobalValue *, 16> worklist;
+  for (Function &func : module)
+    worklist.insert(&func);
+  for (GlobalVariable &global : module.globals())
+    worklist.insert(&global);
+
+  bool changed = false;
+  while (!worklist.empty()) {
+    GlobalValue *global = worklist.pop_back_val();
+    global->removeDeadConstantUsers();
+    if (!global->use_empty() || (!global->isDeclaration() && !global->hasLocalLinkage()))
+      continue;
+
+    if (auto func = dyn_cast<Function>(global)) {
+      for (BasicBlock &block : *func) {
+        for (Instruction &inst : block)
+          collectReferencedGlobals(&inst, worklist);
+      }
+    } else if (auto var = dyn_cast<GlobalVariable>(global)) {
+      if (var->hasInitializer())
+        collectReferencedGlobals(var, worklist);
+    }
+    worklist.remove(global);
+
+    LLVM_DEBUG(dbgs() << "Erase " << global->getName() << "\n");
+    global->eraseFromParent();
+    changed = true;
+  }
+  return changed;
+}
+
+// =====================================================================================================================
+// Initializes the pass
+INITIALIZE_PASS(PatchAlwaysInline, DEBUG_TYPE, "Patch LLVM for always-inline function inlining", false, false)
@@ -41,6 +41,7 @@
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/IntrinsicsAMDGPU.h"
 #include "llvm/InitializePasses.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Transforms/Utils/BasicBlockUtils.h"
@@ -50,6 +51,18 @@
 using namespace llvm;
 using namespace lgc;
 
+namespace llvm {
+
+namespace cl {
+// -scalarize-unwritten-buffer-loads: Use scalar loads for uniform buffer loads when no shader writes buffer memory.
+static opt<bool> ScalarizeUnwrittenBufferLoads("scalarize-unwritten-buffer-loads",
+                                               desc("Use scalar loads for uniform buffer loads when no shader in the "
+                                                    "pipeline writes buffer memory"),
+                                               init(false));
+} // namespace cl
+
+} // namespace llvm
+
 namespace lgc {
 
 // =====================================================================================================================
@@ -98,6 +111,7 @@ bool PatchBufferOp::runOnFunction(Function &function) {
     return false;
 
   m_divergenceAnalysis = &getAnalysis<LegacyDivergenceAnalysis>();
+  m_noBufferWrites = cl::ScalarizeUnwrittenBufferLoads && !mayWriteBufferMemory(*function.getParent());
 
   // To replace the fat pointer uses correctly we need to walk the basic blocks strictly in domination order to avoid
   // visiting a use of a fat pointer before it was actually defined.
@@ -1286,6 +1300,43 @@ bool PatchBufferOp::removeUsersForInvariantStarts(Value *const value) {
   return modified;
 }
 
+// =====================================================================================================================
+// Check whether any shader in the module may write memory that a buffer load could read. Writes to private and local
+// memory, and calls that only access memory inaccessible to the shader (such as exports), do not count. Ring writes
+// for geometry and tessellation do count, so this is conservative there.
+//
+// @param module : The module to check
+bool PatchBufferOp::mayWriteBufferMemory(const Module &module) {
+  for (const Function &func : module) {
+    for (const BasicBlock &block : func) {
+      for (const Instruction &inst : block) {
+        if (!inst.mayWriteToMemory() || isa<FenceInst>(inst))
+          continue;
+
+        unsigned addrSpace = ADDR_SPACE_GLOBAL;
+        if (auto store = dyn_cast<StoreInst>(&inst))
+          addrSpace = store->getPointerAddressSpace();
+        else if (auto atomicRmw = dyn_cast<AtomicRMWInst>(&inst))
+          addrSpace = atomicRmw->getPointerAddressSpace();
+        else if (auto atomicCmpXchg = dyn_cast<AtomicCmpXchgInst>(&inst))
+          addrSpace = atomicCmpXchg->getPointerAddressSpace();
+        else if (auto call = dyn_cast<CallInst>(&inst)) {
+          if (call->onlyAccessesInaccessibleMemory())
+            continue;
+          if (auto intrinsic = dyn_cast<IntrinsicInst>(call)) {
+            if (intrinsic->isLifetimeStartOrEnd() || intrinsic->getIntrinsicID() == Intrinsic::invariant_start)
+              continue;
+          }
+        }
+
+        if (addrSpace != ADDR_SPACE_PRIVATE && addrSpace != ADDR_SPACE_LOCAL)
+          return true;
+      }
+    }
+  }
+  return false;
+}
+
 // =====================================================================================================================
 // Replace a fat pointer load or store with the required intrinsics.
 //
@@ -1330,6 +1381,12 @@ Value *PatchBufferOp::replaceLoadStore(Instruction &inst) {
   if (isLoad) {
     isInvariant = m_invariantSet.count(m_replacementMap[pointer].first) > 0 ||
                   loadInst->getMetadata(LLVMContext::MD_invariant_load);
+
+    // If nothing in the pipeline writes buffer memory, a plain load at a uniform address is as good as invariant, so
+    // it can use a scalar load.
+    if (m_noBufferWrites && !loadInst->isVolatile() && ordering == AtomicOrdering::NotAtomic &&
+        !m_divergenceAnalysis->isDivergent(pointerOperand))
+      isInvariant = true;
   }
 
   const bool isSlc = inst.getMetadata(LLVMContext::MD_nontemporal);
@@ -1343,7 +1400,9 @@ Value *PatchBufferOp::replaceLoadStore(Instruction &inst) {
   if (m_divergenceSet.count(bufferDesc) > 0) {
     Value *const baseAddr = getBaseAddressFromBufferDesc(bufferDesc);
 
-    // The 2nd element in the buffer descriptor is the byte bound, we do this to support robust buffer access.
+    // The 2nd element in the buffer descriptor is the byte bound, we do this to support robust buffer access. This
+    // is the only place we need an explicit compare: a global access does not get the hardware range checking that a
+    // buffer access gets from the descriptor's num_records.
     Value *const bound = m_builder->CreateExtractElement(bufferDesc, 2);
     Value *const inBound = m_builder->CreateICmpULT(baseIndex, bound);
     Value *const newBaseIndex = m_builder->CreateSelect(inBound, baseIndex, m_builder->getInt32(0));
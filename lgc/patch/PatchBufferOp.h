@@ -82,6 +82,7 @@ private:
   llvm::PointerType *getRemappedType(llvm::Type *const type) const;
   bool removeUsersForInvariantStarts(llvm::Value *const value);
   llvm::Value *replaceLoadStore(llvm::Instruction &loadInst);
+  static bool mayWriteBufferMemory(const llvm::Module &module);
   llvm::Value *replaceICmp(llvm::ICmpInst *const iCmpInst);
   llvm::Instruction *makeLoop(llvm::Value *const loopStart, llvm::Value *const loopEnd, llvm::Value *const loopStride,
                               llvm::Instruction *const insertPos);
@@ -97,6 +98,8 @@ private:
   std::unique_ptr<llvm::IRBuilder<>> m_builder;                // The IRBuilder.
   llvm::LLVMContext *m_context;                                // The LLVM context.
   PipelineState *m_pipelineState;                              // The pipeline state
+  bool m_noBufferWrites;                                       // Whether no shader in the module writes memory that
+                                                               //   a buffer could read
 
   static constexpr unsigned MinMemOpLoopBytes = 256;
 };
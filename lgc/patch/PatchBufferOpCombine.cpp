@@ -0,0 +1,385 @@
+/*
+ ***********************************************************************************************************************
+ *
+ *  Copyright (c) 2020 Advanced Micro Devices, Inc. All Rights Reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ **********************************************************************************************************************/
+/**
+ ***********************************************************************************************************************
+ * @file  PatchBufferOpCombine.cpp
+ * @brief LLPC source file: contains implementation of class lgc::PatchBufferOpCombine.
+ ***********************************************************************************************************************
+ */
+#include "PatchBufferOpCombine.h"
+#include "lgc/state/PipelineShaders.h"
+#include "lgc/state/PipelineState.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicsAMDGPU.h"
+#include "llvm/InitializePasses.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+
+#define DEBUG_TYPE "lgc-patch-buffer-op-combine"
+
+using namespace lgc;
+using namespace llvm;
+
+namespace llvm {
+
+namespace cl {
+// -combine-buffer-ops: Combine adjacent raw buffer loads and stores into dwordx2 and dwordx4 accesses.
+static opt<bool> CombineBufferOps(
+    "combine-buffer-ops", desc("Combine adjacent raw buffer loads and stores into dwordx2 and dwordx4 accesses"),
+    init(false));
+} // namespace cl
+
+} // namespace llvm
+
+namespace lgc {
+
+// =====================================================================================================================
+// Define static members (no initializer needed as LLVM only cares about the address of ID, never its value).
+char PatchBufferOpCombine::ID;
+
+// =====================================================================================================================
+// Pass creator, creates the pass of LLVM patching operations for combining buffer loads and stores.
+FunctionPass *createPatchBufferOpCombine() {
+  return new PatchBufferOpCombine();
+}
+
+// =====================================================================================================================
+PatchBufferOpCombine::PatchBufferOpCombine() : FunctionPass(ID) {
+}
+
+// =====================================================================================================================
+// Get the analysis usage of this pass.
+//
+// @param [out] analysisUsage : The analysis usage.
+void PatchBufferOpCombine::getAnalysisUsage(AnalysisUsage &analysisUsage) const {
+  analysisUsage.addRequired<PipelineStateWrapper>();
+  analysisUsage.addRequired<PipelineShaders>();
+  analysisUsage.addPreserved<PipelineShaders>();
+  analysisUsage.setPreservesCFG();
+}
+
+// =====================================================================================================================
+// Executes this LLVM pass on the specified LLVM function.
+//
+// Within each basic block, a window of loads is kept until an instruction that may write memory, and a window of
+// stores to the same buffer is kept until any other instruction that may access memory. The accesses in a window can
+// then be reordered among themselves, so runs of them at contiguous offsets are combined.
+//
+// @param [in,out] function : Function that will run this optimization.
+bool PatchBufferOpCombine::runOnFunction(Function &function) {
+  if (!cl::CombineBufferOps)
+    return false;
+
+  LLVM_DEBUG(dbgs() << "Run the pass Patch-Buffer-Op-Combine\n");
+
+  auto pipelineState = getAnalysis<PipelineStateWrapper>().getPipelineState(function.getParent());
+  auto pipelineShaders = &getAnalysis<PipelineShaders>();
+  if (pipelineShaders->getShaderStage(&function) == ShaderStageInvalid)
+    return false;
+
+  // With robust buffer access, each component of an access must be range checked on its own. From GFX9, the
+  // descriptor's num_records check on a raw buffer access is applied to each dword of a multi-dword access, so an
+  // in-bounds dword next to an out-of-bounds one is still loaded and stored correctly. Before GFX9 a combined access is
+  // range checked as a whole, so combining must be skipped there. The offset of a combined access is the offset of
+  // its first original access, so combining never introduces an offset that wraps around.
+  if (pipelineState->getOptions().robustBufferAccess && pipelineState->getTargetInfo().getGfxIpVersion().major < 9)
+    return false;
+
+  m_builder.reset(new IRBuilder<>(function.getContext()));
+
+  bool changed = false;
+  for (BasicBlock &block : function) {
+    SmallVector<BufferAccess, 8> loads;
+    SmallVector<BufferAccess, 8> stores;
+    auto flush = [&](SmallVectorImpl<BufferAccess> &accesses) {
+      if (accesses.size() > 1)
+        changed |= combineAccesses(accesses);
+      accesses.clear();
+    };
+
+    unsigned order = 0;
+    for (auto it = block.begin(), itEnd = block.end(); it != itEnd;) {
+      Instruction *inst = &*it++;
+      BufferAccess access = {};
+      auto call = dyn_cast<CallInst>(inst);
+      if (call && getBufferAccess(call, access)) {
+        access.order = order++;
+        if (access.isLoad) {
+          flush(stores);
+          loads.push_back(access);
+        } else {
+          flush(loads);
+          // Only stores to the same buffer that do not overlap can be reordered.
+          for (const BufferAccess &store : stores) {
+            if (!isSameBuffer(store, access) ||
+                (access.offset < store.offset + store.dwordCount * 4 &&
+                 store.offset < access.offset + access.dwordCount * 4)) {
+              flush(stores);
+              break;
+            }
+          }
+          stores.push_back(access);
+        }
+        continue;
+      }
+
+      if (inst->mayWriteToMemory()) {
+        flush(loads);
+        flush(stores);
+      } else if (inst->mayReadFromMemory()) {
+        flush(stores);
+      }
+    }
+    flush(loads);
+    flush(stores);
+  }
+
+  return changed;
+}
+
+// =====================================================================================================================
+// Check whether a call is a raw buffer load or store of dword components that could be combined, and get its
+// description.
+//
+// @param call : The call to check
+// @param [out] access : The description of the access
+bool PatchBufferOpCombine::getBufferAccess(CallInst *call, BufferAccess &access) const {
+  Function *callee = call->getCalledFunction();
+  if (!callee)
+    return false;
+
+  Type *type = nullptr;
+  Value *offset = nullptr;
+  if (callee->getIntrinsicID() == Intrinsic::amdgcn_raw_buffer_load) {
+    access.isLoad = true;
+    type = call->getType();
+    offset = call->getArgOperand(1);
+  } else if (callee->getIntrinsicID() == Intrinsic::amdgcn_raw_buffer_store) {
+    access.isLoad = false;
+    type = call->getArgOperand(0)->getType();
+    offset = call->getArgOperand(2);
+  } else
+    return false;
+
+  access.dwordCount = 1;
+  if (auto vecTy = dyn_cast<FixedVectorType>(type)) {
+    access.dwordCount = vecTy->getNumElements();
+    type = vecTy->getElementType();
+  }
+  if ((!type->isIntegerTy(32) && !type->isFloatTy()) || access.dwordCount >= 4)
+    return false;
+
+  // Split the offset into a non-constant base and a constant part.
+  access.call = call;
+  access.base = offset;
+  access.offset = 0;
+  if (auto constOffset = dyn_cast<ConstantInt>(offset)) {
+    access.base = nullptr;
+    access.offset = constOffset->getZExtValue();
+  } else if (auto binaryOp = dyn_cast<BinaryOperator>(offset)) {
+    if (binaryOp->getOpcode() == Instruction::Add) {
+      if (auto constOffset = dyn_cast<ConstantInt>(binaryOp->getOperand(1))) {
+        access.base = binaryOp->getOperand(0);
+        access.offset = constOffset->getZExtValue();
+      }
+    }
+  }
+  return true;
+}
+
+// =====================================================================================================================
+// Check whether two accesses of the same kind use the same descriptor, offset base, soffset and cache policy.
+//
+// @param lhs : First access
+// @param rhs : Second access
+bool PatchBufferOpCombine::isSameBuffer(const BufferAccess &lhs, const BufferAccess &rhs) const {
+  assert(lhs.isLoad == rhs.isLoad);
+  if (lhs.base != rhs.base)
+    return false;
+  // Compare the descriptor, soffset and cache policy operands.
+  unsigned firstArg = lhs.isLoad ? 0 : 1;
+  return lhs.call->getArgOperand(firstArg) == rhs.call->getArgOperand(firstArg) &&
+         lhs.call->getArgOperand(firstArg + 2) == rhs.call->getArgOperand(firstArg + 2) &&
+         lhs.call->getArgOperand(firstArg + 3) == rhs.call->getArgOperand(firstArg + 3);
+}
+
+// =====================================================================================================================
+// Combine runs of accesses to contiguous dwords of the same buffer in a window of loads or stores.
+//
+// @param accesses : The window of loads or stores, which may be reordered among themselves
+bool PatchBufferOpCombine::combineAccesses(ArrayRef<BufferAccess> accesses) {
+  bool changed = false;
+  SmallVector<bool, 8> grouped(accesses.size(), false);
+  for (unsigned i = 0; i != accesses.size(); ++i) {
+    if (grouped[i])
+      continue;
+
+    // Gather the accesses to the same buffer, and sort them by offset.
+    SmallVector<BufferAccess, 8> group;
+    for (unsigned j = i; j != accesses.size(); ++j) {
+      if (!grouped[j] && isSameBuffer(accesses[i], accesses[j])) {
+        group.push_back(accesses[j]);
+        grouped[j] = true;
+      }
+    }
+    std::stable_sort(group.begin(), group.end(),
+                     [](const BufferAccess &lhs, const BufferAccess &rhs) { return lhs.offset < rhs.offset; });
+
+    // Combine the longest run from each access that adds up to two or four dwords. Three dwords are not combined, as
+    // that access size is not available on all targets.
+    for (unsigned start = 0; start < group.size();) {
+      unsigned dwordCount = group[start].dwordCount;
+      unsigned end = start + 1;
+      for (unsigned next = start + 1; next != group.size(); ++next) {
+        if (group[next].offset != group[start].offset + dwordCount * 4)
+          break;
+        dwordCount += group[next].dwordCount;
+        if (dwordCount > 4)
+          break;
+        if (dwordCount == 2 || dwordCount == 4)
+          end = next + 1;
+      }
+
+      if (end - start < 2) {
+        ++start;
+        continue;
+      }
+
+      ArrayRef<BufferAccess> run = makeArrayRef(group).slice(start, end - start);
+      if (run.front().isLoad)
+        combineLoads(run);
+      else
+        combineStores(run);
+      changed = true;
+      start = end;
+    }
+  }
+  return changed;
+}
+
+// =====================================================================================================================
+// Get the offset operand for a combined access starting at the given access, at the builder's insert point.
+//
+// @param access : The access with the lowest offset in the combined access
+Value *PatchBufferOpCombine::getCombinedOffset(const BufferAccess &access) {
+  if (!access.base)
+    return m_builder->getInt32(access.offset);
+  if (access.offset == 0)
+    return access.base;
+  return m_builder->CreateAdd(access.base, m_builder->getInt32(access.offset));
+}
+
+// =====================================================================================================================
+// Replace a run of loads at contiguous offsets with one load, inserted before the first of them in the block.
+//
+// @param loads : The loads, sorted by offset
+void PatchBufferOpCombine::combineLoads(ArrayRef<BufferAccess> loads) {
+  const BufferAccess *firstLoad = &loads.front();
+  unsigned dwordCount = 0;
+  for (const BufferAccess &load : loads) {
+    if (load.order < firstLoad->order)
+      firstLoad = &load;
+    dwordCount += load.dwordCount;
+  }
+
+  CallInst *insertPos = firstLoad->call;
+  m_builder->SetInsertPoint(insertPos);
+  Type *combinedTy = FixedVectorType::get(m_builder->getInt32Ty(), dwordCount);
+  Value *combinedLoad = m_builder->CreateIntrinsic(Intrinsic::amdgcn_raw_buffer_load, combinedTy,
+                                                   {insertPos->getArgOperand(0), getCombinedOffset(loads.front()),
+                                                    insertPos->getArgOperand(2), insertPos->getArgOperand(3)});
+
+  // Split the combined load, then replace the original loads. They are erased only at the end, as the builder inserts
+  // before one of them.
+  SmallVector<Value *, 4> parts;
+  unsigned dwordIdx = 0;
+  for (const BufferAccess &load : loads) {
+    Value *part = nullptr;
+    if (load.dwordCount == 1)
+      part = m_builder->CreateExtractElement(combinedLoad, dwordIdx);
+    else {
+      SmallVector<int, 4> indices;
+      for (unsigned i = 0; i != load.dwordCount; ++i)
+        indices.push_back(dwordIdx + i);
+      part = m_builder->CreateShuffleVector(combinedLoad, combinedLoad, indices);
+    }
+    parts.push_back(m_builder->CreateBitCast(part, load.call->getType()));
+    dwordIdx += load.dwordCount;
+  }
+
+  for (unsigned i = 0; i != loads.size(); ++i) {
+    loads[i].call->replaceAllUsesWith(parts[i]);
+    loads[i].call->eraseFromParent();
+  }
+}
+
+// =====================================================================================================================
+// Replace a run of stores at contiguous offsets with one store, inserted before the last of them in the block.
+//
+// @param stores : The stores, sorted by offset
+void PatchBufferOpCombine::combineStores(ArrayRef<BufferAccess> stores) {
+  const BufferAccess *lastStore = &stores.front();
+  unsigned dwordCount = 0;
+  for (const BufferAccess &store : stores) {
+    if (store.order > lastStore->order)
+      lastStore = &store;
+    dwordCount += store.dwordCount;
+  }
+
+  CallInst *insertPos = lastStore->call;
+  m_builder->SetInsertPoint(insertPos);
+  Type *combinedTy = FixedVectorType::get(m_builder->getInt32Ty(), dwordCount);
+  Value *combinedValue = UndefValue::get(combinedTy);
+  unsigned dwordIdx = 0;
+  for (const BufferAccess &store : stores) {
+    Value *storeValue = store.call->getArgOperand(0);
+    if (store.dwordCount == 1) {
+      storeValue = m_builder->CreateBitCast(storeValue, m_builder->getInt32Ty());
+      combinedValue = m_builder->CreateInsertElement(combinedValue, storeValue, dwordIdx++);
+      continue;
+    }
+    storeValue = m_builder->CreateBitCast(storeValue, FixedVectorType::get(m_builder->getInt32Ty(), store.dwordCount));
+    for (unsigned i = 0; i != store.dwordCount; ++i) {
+      Value *elem = m_builder->CreateExtractElement(storeValue, i);
+      combinedValue = m_builder->CreateInsertElement(combinedValue, elem, dwordIdx++);
+    }
+  }
+
+  m_builder->CreateIntrinsic(Intrinsic::amdgcn_raw_buffer_store, combinedTy,
+                             {combinedValue, insertPos->getArgOperand(1), getCombinedOffset(stores.front()),
+                              insertPos->getArgOperand(3), insertPos->getArgOperand(4)});
+
+  for (const BufferAccess &store : stores)
+    store.call->eraseFromParent();
+}
+
+} // namespace lgc
+
+// =====================================================================================================================
+// Initializes the pass of LLVM patching operations for combining buffer loads and stores.
+INITIALIZE_PASS(PatchBufferOpCombine, DEBUG_TYPE, "Patch LLVM for combining buffer loads and stores", false, false)
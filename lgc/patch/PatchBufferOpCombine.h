@@ -0,0 +1,76 @@
+/*
+ ***********************************************************************************************************************
+ *
+ *  Copyright (c) 2020 Advanced Micro Devices, Inc. All Rights Reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ **********************************************************************************************************************/
+/**
+ ***********************************************************************************************************************
+ * @file  PatchBufferOpCombine.h
+ * @brief LLPC header file: contains declaration of class lgc::PatchBufferOpCombine.
+ ***********************************************************************************************************************
+ */
+#pragma once
+
+#include "lgc/patch/Patch.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/IR/IRBuilder.h"
+#include <memory>
+
+namespace lgc {
+
+// =====================================================================================================================
+// Represents the pass of LLVM patching operations for combining adjacent raw buffer loads and stores, as generated by
+// PatchBufferOp, into dwordx2 and dwordx4 accesses.
+class PatchBufferOpCombine final : public llvm::FunctionPass {
+public:
+  PatchBufferOpCombine();
+
+  void getAnalysisUsage(llvm::AnalysisUsage &analysisUsage) const override;
+  bool runOnFunction(llvm::Function &function) override;
+
+  static char ID; // ID of this pass
+
+private:
+  PatchBufferOpCombine(const PatchBufferOpCombine &) = delete;
+  PatchBufferOpCombine &operator=(const PatchBufferOpCombine &) = delete;
+
+  // A raw buffer load or store that is a candidate for combining
+  struct BufferAccess {
+    llvm::CallInst *call; // The raw buffer load or store intrinsic call
+    bool isLoad;          // Whether it is a load
+    llvm::Value *base;    // Non-constant part of the offset, or null if the offset is constant
+    unsigned offset;      // Constant part of the offset, in bytes
+    unsigned dwordCount;  // Size of the access, in dwords
+    unsigned order;       // Position of the access in its basic block
+  };
+
+  bool getBufferAccess(llvm::CallInst *call, BufferAccess &access) const;
+  bool isSameBuffer(const BufferAccess &lhs, const BufferAccess &rhs) const;
+  bool combineAccesses(llvm::ArrayRef<BufferAccess> accesses);
+  llvm::Value *getCombinedOffset(const BufferAccess &access);
+  void combineLoads(llvm::ArrayRef<BufferAccess> loads);
+  void combineStores(llvm::ArrayRef<BufferAccess> stores);
+
+  std::unique_ptr<llvm::IRBuilder<>> m_builder; // The IRBuilder
+};
+
+} // namespace lgc
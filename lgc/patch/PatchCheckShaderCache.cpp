@@ -54,17 +54,31 @@ PatchCheckShaderCache *createPatchCheckShaderCache() {
 namespace {
 
 // =====================================================================================================================
-// Stream each map key and value for later inclusion in a hash
-template <class MapType>
+// Append a location map to the dense interface layout of a shader stage, as its entry count followed by its keys and
+// values. The maps are kept in ascending key order, so the layout is the same for the same maps.
 //
-// @param map : Map to stream
-// @param [in/out] stream : Stream to output map entries to
-static void streamMapEntries(MapType &map, raw_ostream &stream) {
-  size_t mapCount = map.size();
-  stream << StringRef(reinterpret_cast<const char *>(&mapCount), sizeof(mapCount));
-  for (auto mapIt : map) {
-    stream << StringRef(reinterpret_cast<const char *>(&mapIt.first), sizeof(mapIt.first));
-    stream << StringRef(reinterpret_cast<const char *>(&mapIt.second), sizeof(mapIt.second));
+// @param map : Map to append
+// @param [in/out] layout : Interface layout of the shader stage
+static void appendMapEntries(const InOutLocMap &map, SmallVectorImpl<unsigned> &layout) {
+  layout.push_back(map.size());
+  for (const auto &entry : map) {
+    layout.push_back(entry.first);
+    layout.push_back(entry.second);
+  }
+}
+
+// =====================================================================================================================
+// Append an unordered map to the dense interface layout of a shader stage, in ascending key order.
+//
+// @param map : Map to append
+// @param [in/out] layout : Interface layout of the shader stage
+static void appendMapEntries(const std::unordered_map<unsigned, unsigned> &map, SmallVectorImpl<unsigned> &layout) {
+  SmallVector<std::pair<unsigned, unsigned>, 8> entries(map.begin(), map.end());
+  llvm::sort(entries);
+  layout.push_back(entries.size());
+  for (const auto &entry : entries) {
+    layout.push_back(entry.first);
+    layout.push_back(entry.second);
   }
 }
 
@@ -88,61 +102,38 @@ bool PatchCheckShaderCache::runOnModule(Module &module) {
 
   Patch::init(&module);
 
-  // NOTE: Global constant are added to the end of pipeline binary. we can't merge ELF binaries if global constant
-  // is used in non-fragment shader stages.
-  for (auto &global : module.globals()) {
-    if (auto globalVar = dyn_cast<GlobalVariable>(&global)) {
-      if (globalVar->isConstant()) {
-        SmallVector<const Value *, 4> vals;
-        vals.push_back(globalVar);
-        for (unsigned i = 0; i != vals.size(); ++i) {
-          for (auto user : vals[i]->users()) {
-            if (isa<Constant>(user)) {
-              vals.push_back(user);
-              continue;
-            }
-            if (getShaderStage(cast<Instruction>(user)->getFunction()) != ShaderStageFragment)
-              return false;
-          }
-        }
-      }
-    }
-  }
-
-  std::string inOutUsageStreams[ShaderStageGfxCount];
+  SmallVector<unsigned, 32> interfaceLayouts[ShaderStageGfxCount];
   ArrayRef<uint8_t> inOutUsageValues[ShaderStageGfxCount];
   PipelineState *pipelineState = getAnalysis<PipelineStateWrapper>().getPipelineState(&module);
   auto stageMask = pipelineState->getShaderStageMask();
 
-  // Build input/output layout hash per shader stage
+  // Build the input/output interface layout per shader stage, as a dense array that the callback hashes directly.
   for (auto stage = ShaderStageVertex; stage < ShaderStageGfxCount; stage = static_cast<ShaderStage>(stage + 1)) {
     if ((stageMask & shaderStageToMask(stage)) == 0)
       continue;
 
     auto resUsage = pipelineState->getShaderResourceUsage(stage);
-    raw_string_ostream stream(inOutUsageStreams[stage]);
+    auto &layout = interfaceLayouts[stage];
 
     // Update input/output usage
-    streamMapEntries(resUsage->inOutUsage.inputLocMap, stream);
-    streamMapEntries(resUsage->inOutUsage.outputLocMap, stream);
-    streamMapEntries(resUsage->inOutUsage.inOutLocMap, stream);
-    streamMapEntries(resUsage->inOutUsage.perPatchInputLocMap, stream);
-    streamMapEntries(resUsage->inOutUsage.perPatchOutputLocMap, stream);
-    streamMapEntries(resUsage->inOutUsage.builtInInputLocMap, stream);
-    streamMapEntries(resUsage->inOutUsage.builtInOutputLocMap, stream);
-    streamMapEntries(resUsage->inOutUsage.perPatchBuiltInInputLocMap, stream);
-    streamMapEntries(resUsage->inOutUsage.perPatchBuiltInOutputLocMap, stream);
+    appendMapEntries(resUsage->inOutUsage.inputLocMap, layout);
+    appendMapEntries(resUsage->inOutUsage.outputLocMap, layout);
+    appendMapEntries(resUsage->inOutUsage.inOutLocMap, layout);
+    appendMapEntries(resUsage->inOutUsage.perPatchInputLocMap, layout);
+    appendMapEntries(resUsage->inOutUsage.perPatchOutputLocMap, layout);
+    appendMapEntries(resUsage->inOutUsage.builtInInputLocMap, layout);
+    appendMapEntries(resUsage->inOutUsage.builtInOutputLocMap, layout);
+    appendMapEntries(resUsage->inOutUsage.perPatchBuiltInInputLocMap, layout);
+    appendMapEntries(resUsage->inOutUsage.perPatchBuiltInOutputLocMap, layout);
 
     if (stage == ShaderStageGeometry) {
       // NOTE: For geometry shader, copy shader will use this special map info (from built-in outputs to
       // locations of generic outputs). We have to add it to shader hash calculation.
-      streamMapEntries(resUsage->inOutUsage.gs.builtInOutLocs, stream);
+      appendMapEntries(resUsage->inOutUsage.gs.builtInOutLocs, layout);
     }
 
-    // Store the result of the hash for this shader stage.
-    stream.flush();
-    inOutUsageValues[stage] = ArrayRef<uint8_t>(reinterpret_cast<const uint8_t *>(inOutUsageStreams[stage].data()),
-                                                inOutUsageStreams[stage].size());
+    inOutUsageValues[stage] =
+        ArrayRef<uint8_t>(reinterpret_cast<const uint8_t *>(layout.data()), layout.size() * sizeof(unsigned));
   }
 
   // Ask callback function if it wants to remove any shader stages.
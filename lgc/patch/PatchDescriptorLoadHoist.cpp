@@ -0,0 +1,228 @@
+/*
+ ***********************************************************************************************************************
+ *
+ *  Copyright (c) 2020 Advanced Micro Devices, Inc. All Rights Reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ **********************************************************************************************************************/
+/**
+ ***********************************************************************************************************************
+ * @file  PatchDescriptorLoadHoist.cpp
+ * @brief LLPC source file: contains implementation of class lgc::PatchDescriptorLoadHoist.
+ ***********************************************************************************************************************
+ */
+#include "PatchDescriptorLoadHoist.h"
+#include "lgc/state/IntrinsDefs.h"
+#include "lgc/state/PipelineShaders.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/InitializePasses.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+
+#define DEBUG_TYPE "lgc-patch-descriptor-load-hoist"
+
+using namespace lgc;
+using namespace llvm;
+
+namespace llvm {
+
+namespace cl {
+// -hoist-descriptor-loads: Hoist invariant descriptor loads to the shader entry block and remove duplicated ones.
+static opt<bool> HoistDescriptorLoads("hoist-descriptor-loads",
+                                      desc("Hoist invariant descriptor loads to the shader entry block and remove "
+                                           "duplicated ones"),
+                                      init(false));
+} // namespace cl
+
+} // namespace llvm
+
+namespace lgc {
+
+// =====================================================================================================================
+// Define static members (no initializer needed as LLVM only cares about the address of ID, never its value).
+char PatchDescriptorLoadHoist::ID;
+
+// =====================================================================================================================
+// Pass creator, creates the pass of LLVM patching operations for hoisting descriptor loads.
+FunctionPass *createPatchDescriptorLoadHoist() {
+  return new PatchDescriptorLoadHoist();
+}
+
+// =====================================================================================================================
+PatchDescriptorLoadHoist::PatchDescriptorLoadHoist() : FunctionPass(ID) {
+}
+
+// =====================================================================================================================
+// Get the analysis usage of this pass.
+//
+// @param [out] analysisUsage : The analysis usage.
+void PatchDescriptorLoadHoist::getAnalysisUsage(AnalysisUsage &analysisUsage) const {
+  analysisUsage.addRequired<PipelineShaders>();
+  analysisUsage.addPreserved<PipelineShaders>();
+  analysisUsage.setPreservesCFG();
+}
+
+// =====================================================================================================================
+// Executes this LLVM pass on the specified LLVM function.
+//
+// Descriptors are loaded from constant memory through pointers that are built from user data SGPRs, so a descriptor
+// load whose address does not depend on anything computed in the shader body can be moved to the entry block. Once
+// there, identical address computations and loads are merged, which removes the redundant SMEM loads that would
+// otherwise be emitted at every use site.
+//
+// @param [in,out] function : Function that will run this optimization.
+bool PatchDescriptorLoadHoist::runOnFunction(Function &function) {
+  if (!cl::HoistDescriptorLoads || function.isDeclaration())
+    return false;
+
+  auto pipelineShaders = &getAnalysis<PipelineShaders>();
+  if (pipelineShaders->getShaderStage(&function) == ShaderStageInvalid)
+    return false;
+
+  LLVM_DEBUG(dbgs() << "Run the pass Patch-Descriptor-Load-Hoist\n");
+
+  m_entryBlock = &function.getEntryBlock();
+  m_invariantCache.clear();
+  m_hoisted.clear();
+
+  // Collect the candidate loads in reverse post order, so operands are hoisted before their users.
+  SmallVector<LoadInst *, 16> loads;
+  ReversePostOrderTraversal<Function *> rpot(&function);
+  for (BasicBlock *block : rpot) {
+    for (Instruction &inst : *block) {
+      auto load = dyn_cast<LoadInst>(&inst);
+      if (!load || load->isVolatile() || !load->isUnordered())
+        continue;
+      const unsigned addrSpace = load->getPointerAddressSpace();
+      if (addrSpace == ADDR_SPACE_CONST || addrSpace == ADDR_SPACE_CONST_32BIT)
+        loads.push_back(load);
+    }
+  }
+
+  // Invariant instructions already in the entry block can be merged with identical ones hoisted later.
+  for (Instruction &inst : *m_entryBlock) {
+    if (!inst.isTerminator() && isInvariant(&inst))
+      m_hoisted.push_back(&inst);
+  }
+
+  bool changed = false;
+  for (LoadInst *load : loads) {
+    if (load->getParent() == m_entryBlock || !isInvariant(load))
+      continue;
+    hoist(load);
+    changed = true;
+  }
+
+  return changed;
+}
+
+// =====================================================================================================================
+// Check whether a value can be computed in the entry block: it only depends on constants, inreg (uniform) arguments,
+// and side-effect-free operations, including loads from constant memory such as descriptor tables.
+//
+// NOTE: Convergent operations such as readfirstlane (used by scalarizeIfUniform) and anything depending on VGPR
+// arguments are not invariant. This keeps non-uniform descriptor indexing, and the waterfall loops around it, intact.
+//
+// @param value : The value to check
+bool PatchDescriptorLoadHoist::isInvariant(Value *value) {
+  // NOTE: Loads from constant global data are not descriptor loads, and their address might only be valid where the
+  // load originally was.
+  if (isa<GlobalValue>(value))
+    return false;
+  if (isa<Constant>(value))
+    return true;
+  if (auto arg = dyn_cast<Argument>(value))
+    return arg->hasAttribute(Attribute::InReg);
+
+  auto inst = dyn_cast<Instruction>(value);
+  if (!inst || isa<PHINode>(inst))
+    return false;
+
+  auto it = m_invariantCache.find(inst);
+  if (it != m_invariantCache.end())
+    return it->second;
+
+  // Guard against cycles through the operands
+  m_invariantCache[inst] = false;
+
+  bool invariant = false;
+  if (auto load = dyn_cast<LoadInst>(inst)) {
+    const unsigned addrSpace = load->getPointerAddressSpace();
+    invariant = !load->isVolatile() && load->isUnordered() &&
+                (addrSpace == ADDR_SPACE_CONST || addrSpace == ADDR_SPACE_CONST_32BIT);
+  } else if (auto call = dyn_cast<CallInst>(inst))
+    invariant = !call->isConvergent() && isSafeToSpeculativelyExecute(call);
+  else
+    invariant = isSafeToSpeculativelyExecute(inst);
+
+  for (unsigned i = 0; invariant && i != inst->getNumOperands(); ++i) {
+    Value *operand = inst->getOperand(i);
+    if (!isa<BasicBlock>(operand) && !isa<Function>(operand))
+      invariant = isInvariant(operand);
+  }
+
+  m_invariantCache[inst] = invariant;
+  return invariant;
+}
+
+// =====================================================================================================================
+// Move an invariant instruction, and the invariant instructions it depends on, to the end of the entry block. An
+// instruction that turns out to be identical to one already there is replaced by it.
+//
+// @param inst : The instruction to hoist
+void PatchDescriptorLoadHoist::hoist(Instruction *inst) {
+  if (inst->getParent() == m_entryBlock)
+    return;
+
+  for (Value *operand : inst->operands()) {
+    if (auto operandInst = dyn_cast<Instruction>(operand))
+      hoist(operandInst);
+  }
+
+  // Operands may have been replaced while being hoisted, so look for an identical instruction afterwards.
+  if (Instruction *identical = findIdentical(inst)) {
+    inst->replaceAllUsesWith(identical);
+    inst->eraseFromParent();
+    return;
+  }
+
+  inst->moveBefore(m_entryBlock->getTerminator());
+  m_hoisted.push_back(inst);
+}
+
+// =====================================================================================================================
+// Find an invariant instruction in the entry block that is identical to the given one.
+//
+// @param inst : The instruction to look up
+Instruction *PatchDescriptorLoadHoist::findIdentical(Instruction *inst) {
+  for (Instruction *candidate : m_hoisted) {
+    if (candidate != inst && candidate->isIdenticalTo(inst))
+      return candidate;
+  }
+  return nullptr;
+}
+
+} // namespace lgc
+
+// =====================================================================================================================
+// Initializes the pass of LLVM patching operations for hoisting descriptor loads.
+INITIALIZE_PASS(PatchDescriptorLoadHoist, DEBUG_TYPE, "Patch LLVM for hoisting descriptor loads", false, false)
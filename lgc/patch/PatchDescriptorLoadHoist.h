@@ -0,0 +1,64 @@
+/*
+ ***********************************************************************************************************************
+ *
+ *  Copyright (c) 2020 Advanced Micro Devices, Inc. All Rights Reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ **********************************************************************************************************************/
+/**
+ ***********************************************************************************************************************
+ * @file  PatchDescriptorLoadHoist.h
+ * @brief LLPC header file: contains declaration of class lgc::PatchDescriptorLoadHoist.
+ ***********************************************************************************************************************
+ */
+#pragma once
+
+#include "lgc/patch/Patch.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+
+namespace lgc {
+
+// =====================================================================================================================
+// Represents the pass of LLVM patching operations for hoisting invariant descriptor loads to the entry block of a
+// shader and removing duplicated ones.
+class PatchDescriptorLoadHoist final : public llvm::FunctionPass {
+public:
+  PatchDescriptorLoadHoist();
+
+  void getAnalysisUsage(llvm::AnalysisUsage &analysisUsage) const override;
+  bool runOnFunction(llvm::Function &function) override;
+
+  static char ID; // ID of this pass
+
+private:
+  PatchDescriptorLoadHoist(const PatchDescriptorLoadHoist &) = delete;
+  PatchDescriptorLoadHoist &operator=(const PatchDescriptorLoadHoist &) = delete;
+
+  bool isInvariant(llvm::Value *value);
+  void hoist(llvm::Instruction *inst);
+  llvm::Instruction *findIdentical(llvm::Instruction *inst);
+
+  llvm::BasicBlock *m_entryBlock = nullptr;               // Entry block of the function being processed
+  llvm::DenseMap<llvm::Value *, bool> m_invariantCache;   // Cache of invariance results
+  llvm::SmallVector<llvm::Instruction *, 32> m_hoisted;   // Invariant instructions in the entry block
+};
+
+} // namespace lgc
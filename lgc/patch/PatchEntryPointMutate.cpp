@@ -41,10 +41,16 @@
 #include "lgc/state/PipelineState.h"
 #include "lgc/state/TargetInfo.h"
 #include "lgc/util/AddressExtender.h"
+#include "lgc/util/Debug.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/MapVector.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/Dominators.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/InstVisitor.h"
 #include "llvm/IR/IntrinsicsAMDGPU.h"
+#include "llvm/Support/Allocator.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/MathExtras.h"
@@ -63,6 +69,18 @@ namespace cl {
 // GS on-chip behavior. In the future, if PAL allows hardcoded ES-GS LDS size, this option could be deprecated.
 opt<bool> InRegEsGsLdsSize("inreg-esgs-lds-size", desc("For GS on-chip, add esGsLdsSize in user data"), init(true));
 
+// -weighted-user-data-spill: when user data nodes do not all fit in SGPRs, keep the most frequently used ones
+static opt<bool> WeightedUserDataSpill("weighted-user-data-spill",
+                                       desc("When spilling user data in graphics shaders, keep the nodes with the "
+                                            "highest loop-depth weighted use count in SGPRs"),
+                                       init(false));
+
+// -target-occupancy: request the occupancy that the LDS usage of a shader allows, so that register usage does not
+// lower it further
+static opt<bool> TargetOccupancy("target-occupancy",
+                                 desc("Compile shaders that use LDS for the waves per EU allowed by their LDS usage"),
+                                 init(false));
+
 } // namespace cl
 } // namespace llvm
 
@@ -112,10 +130,21 @@ private:
   // User data usage for one user data node
   struct UserDataNodeUsage {
     unsigned entryArgIdx = 0;
-    unsigned dwordSize = 0; // Only used in pushConstOffsets
+    unsigned dwordSize = 0; // Only used in pushConstOffsets and RootInlineBufferUsage::offsets
     SmallVector<Instruction *, 4> users;
   };
 
+  // User data usage for one inline buffer in the root table. This is handled in the same way as the push constant.
+  struct RootInlineBufferUsage {
+    // List of lgc.root.inline.buffer calls. There is no direct attempt to unspill these; instead we attempt to
+    // unspill the offsets loads.
+    UserDataNodeUsage calls;
+    // True means that we did not succeed in putting all loads into offsets, so the buffer pointer must be kept.
+    bool spill = false;
+    // Per-dword-offset lists of loads from the inline buffer. We attempt to unspill these.
+    SmallVector<UserDataNodeUsage, 8> offsets;
+  };
+
   // Per-merged-shader-stage gathered user data usage information.
   struct UserDataUsage {
     // Check if special user data value is used by lgc.special.user.data call generated before PatchEntryPointMutate
@@ -134,8 +163,13 @@ private:
     bool pushConstSpill = false;
     // Per-push-const-offset lists of loads from push const. We attempt to unspill these.
     SmallVector<UserDataNodeUsage, 8> pushConstOffsets;
+    // Bit offset within its dword of each load in pushConstOffsets or a root inline buffer's offsets that is smaller
+    // than a dword. Such a load is unspilled as a part of the dword that contains it.
+    DenseMap<Instruction *, unsigned> subDwordShifts;
     // Per-user-data-offset lists of lgc.root.descriptor calls
     SmallVector<UserDataNodeUsage, 8> rootDescriptors;
+    // Usage of each inline buffer in the root table, keyed by the user data offset of its node
+    MapVector<unsigned, RootInlineBufferUsage> rootInlineBuffers;
     // Per-descriptor-set lists of lgc.descriptor.set calls
     SmallVector<UserDataNodeUsage, 8> descriptorSets;
     // Per-UserDataMapping lists of lgc.special.user.data calls
@@ -148,9 +182,13 @@ private:
 
   // Gather user data usage in all shaders.
   void gatherUserDataUsage(Module *module);
+  void gatherConstantLoads(Instruction *ptr, SmallVectorImpl<UserDataNodeUsage> &offsets, bool &spill,
+                           DenseMap<Instruction *, unsigned> &subDwordShifts, const DataLayout &dataLayout);
 
   // Fix up user data uses.
   void fixupUserDataUses(Module &module);
+  void replaceConstantLoads(Function &func, UserDataNodeUsage &offsetUsage, Argument *arg,
+                            const DenseMap<Instruction *, unsigned> &subDwordShifts, IRBuilder<> &builder);
 
   void processShader(ShaderInputs *shaderInputs);
 
@@ -161,10 +199,19 @@ private:
   void addUserDataArgs(SmallVectorImpl<UserDataArg> &userDataArgs, IRBuilder<> &builder);
   unsigned addUserDataArg(SmallVectorImpl<UserDataArg> &userDataArgs, unsigned userDataValue, unsigned sizeInDwords,
                           unsigned *argIndex, bool useFixedLayout, unsigned userDataSize, IRBuilder<> &builder);
+  unsigned addConstantLoadArgs(SmallVectorImpl<UserDataArg> &userDataArgs, SmallVectorImpl<UserDataNodeUsage> &offsets,
+                               unsigned userDataValue, unsigned sizeInDwords, bool &spill, bool useFixedLayout,
+                               unsigned userDataSize, IRBuilder<> &builder);
 
   void determineUnspilledUserDataArgs(ArrayRef<UserDataArg> userDataArgs, ArrayRef<UserDataArg> specialUserDataArgs,
                                       IRBuilder<> &builder, SmallVectorImpl<UserDataArg> &unspilledArgs);
 
+  void selectWeightedUnspilledUserDataArgs(ArrayRef<UserDataArg> userDataArgs, unsigned userDataEnd,
+                                           SmallVectorImpl<UserDataArg> &unspilledArgs);
+  uint64_t getUserDataArgWeight(const UserDataArg &userDataArg);
+  unsigned getLoopDepth(Instruction *inst);
+  unsigned getTargetWavesPerEu();
+
   uint64_t pushFixedShaderArgTys(SmallVectorImpl<Type *> &argTys) const;
 
   // Get UserDataUsage struct for the merged shader stage that contains the given shader stage
@@ -177,7 +224,10 @@ private:
   bool m_hasGs;                             // Whether the pipeline has geometry shader
   PipelineState *m_pipelineState = nullptr; // Pipeline state from PipelineStateWrapper pass
   // Per-HW-shader-stage gathered user data usage information.
-  SmallVector<std::unique_ptr<UserDataUsage>, ShaderStageCount> m_userDataUsage;
+  SpecificBumpPtrAllocator<UserDataUsage> m_userDataUsageAllocator; // Arena for UserDataUsage structs
+  SmallVector<UserDataUsage *, ShaderStageCount> m_userDataUsage;
+  // Per-function loop info, used to weight user data uses
+  DenseMap<Function *, std::unique_ptr<LoopInfo>> m_loopInfos;
 };
 
 } // anonymous namespace
@@ -231,6 +281,7 @@ bool PatchEntryPointMutate::runOnModule(Module &module) {
   // Fix up user data uses to use entry args.
   fixupUserDataUses(*m_module);
   m_userDataUsage.clear();
+  m_userDataUsageAllocator.DestroyAll();
 
   // Fix up shader input uses to use entry args.
   shaderInputs.fixupUses(*m_module, m_pipelineState);
@@ -243,9 +294,9 @@ bool PatchEntryPointMutate::runOnModule(Module &module) {
 //
 // @param module : IR module
 void PatchEntryPointMutate::gatherUserDataUsage(Module *module) {
-  // Find lgc.spill.table, lgc.push.constants, lgc.root.descriptor, lgc.descriptor.set functions, and from
-  // there all calls to them. Add each call to the applicable list in the UserDataUsage struct for the
-  // (merged) shader stage.
+  // Find lgc.spill.table, lgc.push.constants, lgc.root.inline.buffer, lgc.root.descriptor, lgc.descriptor.set
+  // functions, and from there all calls to them. Add each call to the applicable list in the UserDataUsage struct
+  // for the (merged) shader stage.
   // Find lgc.special.user.data functions, and from there all calls to them. Add each call to the applicable
   // list in the UserDataUsage struct for the (merged) shader stage.
   // Also find lgc.input.import.generic calls in VS, indicating that the vertex buffer table is needed.
@@ -266,64 +317,34 @@ void PatchEntryPointMutate::gatherUserDataUsage(Module *module) {
 
     if (func.getName().startswith(lgcName::PushConst)) {
       for (User *user : func.users()) {
-        // For this call to lgc.push.const, attempt to find all loads with a constant dword-aligned offset and
-        // push into userDataUsage->pushConstOffsets. If we fail, set userDataUsage->pushConstSpill to indicate that
-        // we need to keep the pointer to the push const, derived as an offset into the spill table.
+        // For this call to lgc.push.const, attempt to find all loads with a constant dword-aligned offset, or smaller
+        // than a dword and within one dword, and push into userDataUsage->pushConstOffsets. If we fail, set
+        // userDataUsage->pushConstSpill to indicate that we need to keep the pointer to the push const, derived as an
+        // offset into the spill table.
         CallInst *call = cast<CallInst>(user);
         ShaderStage stage = getShaderStage(call->getFunction());
         assert(stage != ShaderStageCopyShader);
         auto userDataUsage = getUserDataUsage(stage);
         userDataUsage->pushConst.users.push_back(call);
-        SmallVector<std::pair<Instruction *, unsigned>, 4> users;
-        users.push_back({call, 0});
-        for (unsigned i = 0; i != users.size(); ++i) {
-          Instruction *inst = users[i].first;
-          for (User *user : inst->users()) {
-            unsigned dwordOffset = users[i].second;
-            if (auto bitcast = dyn_cast<BitCastInst>(user)) {
-              // See through a bitcast.
-              users.push_back({bitcast, dwordOffset});
-              continue;
-            }
-            if (isa<LoadInst>(user) && !user->getType()->isAggregateType()) {
-              unsigned bitSize = user->getType()->getPrimitiveSizeInBits();
-              if (bitSize % 32 == 0) {
-                // This is a scalar or vector load with dword-aligned size. We can attempt to unspill it, but, for
-                // a particular dword offset, we only attempt to unspill ones with the same (minimum) size.
-                unsigned dwordSize = bitSize / 32;
-                userDataUsage->pushConstOffsets.resize(
-                    std::max(unsigned(userDataUsage->pushConstOffsets.size()), dwordOffset + 1));
-                auto &pushConstOffset = userDataUsage->pushConstOffsets[dwordOffset];
-                if (pushConstOffset.dwordSize == 0 || pushConstOffset.dwordSize >= dwordSize) {
-                  if (pushConstOffset.dwordSize != 0 && pushConstOffset.dwordSize != dwordSize) {
-                    // This load type is smaller than previously seen ones at this offset. Forget the earlier
-                    // ones (and mark that some uses of the push const pointer remain).
-                    userDataUsage->pushConstSpill = true;
-                    pushConstOffset.users.clear();
-                  }
-                  // Remember this load for possible unspilling.
-                  pushConstOffset.dwordSize = dwordSize;
-                  userDataUsage->pushConstOffsets[dwordOffset].users.push_back(cast<Instruction>(user));
-                  continue;
-                }
-              }
-            } else if (auto gep = dyn_cast<GetElementPtrInst>(user)) {
-              // For a gep, calculate the new constant offset.
-              APInt gepOffset(64, 0);
-              if (gep->accumulateConstantOffset(module->getDataLayout(), gepOffset)) {
-                unsigned gepByteOffset = gepOffset.getZExtValue();
-                if (gepByteOffset % 4 == 0) {
-                  // We still have a constant offset that is 4-aligned. Push it so we look at its users.
-                  dwordOffset += gepByteOffset / 4;
-                  users.push_back({gep, dwordOffset});
-                  continue;
-                }
-              }
-            }
-            // We have found some user we can't handle. Mark that we need to keep the push const pointer.
-            userDataUsage->pushConstSpill = true;
-          }
-        }
+        gatherConstantLoads(call, userDataUsage->pushConstOffsets, userDataUsage->pushConstSpill,
+                            userDataUsage->subDwordShifts, module->getDataLayout());
+      }
+      continue;
+    }
+
+    if (func.getName().startswith(lgcName::RootInlineBuffer)) {
+      for (User *user : func.users()) {
+        // For this call to lgc.root.inline.buffer, attempt to find all loads through the buffer pointer that we
+        // could unspill, in the same way as for lgc.push.const above.
+        CallInst *call = cast<CallInst>(user);
+        unsigned dwordOffset = cast<ConstantInt>(call->getArgOperand(0))->getZExtValue();
+        ShaderStage stage = getShaderStage(call->getFunction());
+        assert(stage != ShaderStageCopyShader);
+        auto userDataUsage = getUserDataUsage(stage);
+        auto &rootInlineBuffer = userDataUsage->rootInlineBuffers[dwordOffset];
+        rootInlineBuffer.calls.users.push_back(call);
+        gatherConstantLoads(call, rootInlineBuffer.offsets, rootInlineBuffer.spill, userDataUsage->subDwordShifts,
+                            module->getDataLayout());
       }
       continue;
     }
@@ -373,6 +394,83 @@ void PatchEntryPointMutate::gatherUserDataUsage(Module *module) {
   }
 }
 
+// =====================================================================================================================
+// Gather the loads through a pointer to a block of constants in the root user data (the push constant or a root
+// inline buffer). Attempt to find all loads with a constant dword-aligned offset, or smaller than a dword and within
+// one dword, and push into offsets. If we fail, set spill to indicate that we need to keep the pointer, derived as an
+// offset into the spill table.
+//
+// @param ptr : Call that returns the pointer to the block
+// @param [in/out] offsets : Per-dword-offset lists of loads from the block
+// @param [in/out] spill : Set if some use of the pointer cannot be unspilled
+// @param [in/out] subDwordShifts : Bit offset within its dword of each load that is smaller than a dword
+// @param dataLayout : Data layout of the module
+void PatchEntryPointMutate::gatherConstantLoads(Instruction *ptr, SmallVectorImpl<UserDataNodeUsage> &offsets,
+                                                bool &spill, DenseMap<Instruction *, unsigned> &subDwordShifts,
+                                                const DataLayout &dataLayout) {
+  SmallVector<std::pair<Instruction *, unsigned>, 4> users;
+  users.push_back({ptr, 0});
+  for (unsigned i = 0; i != users.size(); ++i) {
+    Instruction *inst = users[i].first;
+    for (User *user : inst->users()) {
+      unsigned byteOffset = users[i].second;
+      unsigned dwordOffset = byteOffset / 4;
+      if (auto bitcast = dyn_cast<BitCastInst>(user)) {
+        // See through a bitcast.
+        users.push_back({bitcast, byteOffset});
+        continue;
+      }
+      if (isa<LoadInst>(user) && !user->getType()->isAggregateType()) {
+        unsigned bitSize = user->getType()->getPrimitiveSizeInBits();
+        if (bitSize != 0 && bitSize < 32 && bitSize % 8 == 0 && byteOffset % 4 + bitSize / 8 <= 4) {
+          // This is a load of 8 or 16 bits within one dword. Treat it as a use of that dword, and remember
+          // where in the dword it is.
+          offsets.resize(std::max(unsigned(offsets.size()), dwordOffset + 1));
+          auto &offsetUsage = offsets[dwordOffset];
+          if (offsetUsage.dwordSize != 0 && offsetUsage.dwordSize != 1) {
+            // Forget the bigger loads seen at this offset, as for a smaller whole-dword load below.
+            spill = true;
+            offsetUsage.users.clear();
+          }
+          offsetUsage.dwordSize = 1;
+          offsetUsage.users.push_back(cast<Instruction>(user));
+          subDwordShifts[cast<Instruction>(user)] = byteOffset % 4 * 8;
+          continue;
+        }
+        if (bitSize % 32 == 0 && byteOffset % 4 == 0) {
+          // This is a scalar or vector load with dword-aligned size. We can attempt to unspill it, but, for
+          // a particular dword offset, we only attempt to unspill ones with the same (minimum) size.
+          unsigned dwordSize = bitSize / 32;
+          offsets.resize(std::max(unsigned(offsets.size()), dwordOffset + 1));
+          auto &offsetUsage = offsets[dwordOffset];
+          if (offsetUsage.dwordSize == 0 || offsetUsage.dwordSize >= dwordSize) {
+            if (offsetUsage.dwordSize != 0 && offsetUsage.dwordSize != dwordSize) {
+              // This load type is smaller than previously seen ones at this offset. Forget the earlier
+              // ones (and mark that some uses of the pointer remain).
+              spill = true;
+              offsetUsage.users.clear();
+            }
+            // Remember this load for possible unspilling.
+            offsetUsage.dwordSize = dwordSize;
+            offsetUsage.users.push_back(cast<Instruction>(user));
+            continue;
+          }
+        }
+      } else if (auto gep = dyn_cast<GetElementPtrInst>(user)) {
+        // For a gep, calculate the new constant offset.
+        APInt gepOffset(64, 0);
+        if (gep->accumulateConstantOffset(dataLayout, gepOffset) && !gepOffset.isNegative()) {
+          // We still have a constant offset. Push it so we look at its users.
+          users.push_back({gep, byteOffset + unsigned(gepOffset.getZExtValue())});
+          continue;
+        }
+      }
+      // We have found some user we can't handle. Mark that we need to keep the pointer.
+      spill = true;
+    }
+  }
+}
+
 // =====================================================================================================================
 // Fix up user data uses in all shaders: For unspilled ones, use the entry arg directly; for spilled ones,
 // insert a load from the spill table, shared for the function.
@@ -424,15 +522,7 @@ void PatchEntryPointMutate::fixupUserDataUses(Module &module) {
           // bitcast. (We know that all loads are non-aggregates of the same size, so we can bitcast.)
           Argument *arg = func.getArg(pushConstOffset.entryArgIdx);
           arg->setName("pushConst_" + Twine(dwordOffset));
-          for (Instruction *&load : pushConstOffset.users) {
-            if (load && load->getFunction() == &func) {
-              builder.SetInsertPoint(load);
-              Value *replacement = builder.CreateBitCast(arg, load->getType());
-              load->replaceAllUsesWith(replacement);
-              load->eraseFromParent();
-              load = nullptr;
-            }
-          }
+          replaceConstantLoads(func, pushConstOffset, arg, userDataUsage->subDwordShifts, builder);
         } else {
           // This offset into the push constant is spilled. All we need to do is ensure that the push constant
           // pointer (derived as an offset into the spill table) remains.
@@ -480,6 +570,57 @@ void PatchEntryPointMutate::fixupUserDataUses(Module &module) {
       }
     }
 
+    // Inline buffers in the root table. These are handled in the same way as the push constant, except that a
+    // remaining use of the buffer pointer needs a buffer descriptor for the buffer's data in the spill table.
+    for (auto &it : userDataUsage->rootInlineBuffers) {
+      unsigned nodeOffset = it.first;
+      RootInlineBufferUsage &rootInlineBuffer = it.second;
+      for (unsigned dwordOffset = 0; dwordOffset != rootInlineBuffer.offsets.size(); ++dwordOffset) {
+        UserDataNodeUsage &offsetUsage = rootInlineBuffer.offsets[dwordOffset];
+        if (offsetUsage.users.empty())
+          continue;
+        if (offsetUsage.entryArgIdx) {
+          // This offset into the inline buffer is unspilled. Replace the loads with the entry arg.
+          Argument *arg = func.getArg(offsetUsage.entryArgIdx);
+          arg->setName("inlineBuffer" + Twine(nodeOffset) + "_" + Twine(dwordOffset));
+          replaceConstantLoads(func, offsetUsage, arg, userDataUsage->subDwordShifts, builder);
+        } else {
+          // This offset into the inline buffer is spilled, so the buffer pointer must remain.
+          rootInlineBuffer.spill = true;
+        }
+      }
+
+      Value *bufferPtr = nullptr;
+      for (Instruction *&call : rootInlineBuffer.calls.users) {
+        if (!call || call->getFunction() != &func)
+          continue;
+        if (!rootInlineBuffer.spill) {
+          // No use of the buffer pointer remains. Just replace with undef.
+          bufferPtr = UndefValue::get(call->getType());
+        } else if (!bufferPtr) {
+          // This is the first use we have seen in this function. Fill the address of the buffer's data in the spill
+          // table into the descriptor passed to the call, and make the buffer pointer from that, straight after the
+          // code at the start of the function that extends the spill table pointer.
+          builder.SetInsertPoint(spillTable->getNextNode());
+          m_pipelineState->getPalMetadata()->setUserDataSpillUsage(nodeOffset);
+          Value *addr = builder.CreateGEP(builder.getInt8Ty(), spillTable, builder.getInt32(nodeOffset * 4));
+          addr = builder.CreatePtrToInt(addr, builder.getInt64Ty());
+          addr = builder.CreateBitCast(addr, FixedVectorType::get(builder.getInt32Ty(), 2));
+          SqBufRsrcWord1 sqBufRsrcWord1 = {};
+          sqBufRsrcWord1.bits.baseAddressHi = UINT16_MAX;
+          Value *desc = call->getArgOperand(1);
+          desc = builder.CreateInsertElement(desc, builder.CreateExtractElement(addr, uint64_t(0)), uint64_t(0));
+          Value *addrHi = builder.CreateAnd(builder.CreateExtractElement(addr, 1), sqBufRsrcWord1.u32All);
+          desc = builder.CreateInsertElement(desc, addrHi, 1);
+          bufferPtr = builder.CreateNamedCall(lgcName::LateLaunderFatPointer, call->getType(), desc,
+                                              Attribute::ReadNone, "inlineBuffer" + Twine(nodeOffset));
+        }
+        call->replaceAllUsesWith(bufferPtr);
+        call->eraseFromParent();
+        call = nullptr;
+      }
+    }
+
     // Root descriptors ("dynamic descriptors").
     for (unsigned dwordOffset = 0; dwordOffset != userDataUsage->rootDescriptors.size(); ++dwordOffset) {
       auto &rootDescriptor = userDataUsage->rootDescriptors[dwordOffset];
@@ -546,7 +687,7 @@ void PatchEntryPointMutate::fixupUserDataUses(Module &module) {
               } else {
                 // Shader compilation. Use a reloc.
                 assert(m_pipelineState->isUnlinked());
-                offset = builder.CreateRelocationConstant("descset_" + Twine(descSetIdx));
+                offset = builder.CreateRelocationConstant(reloc::DescriptorTableOffset + Twine(descSetIdx));
               }
               Value *addr = builder.CreateGEP(builder.getInt8Ty(), spillTable, offset);
               addr = builder.CreateBitCast(addr, builder.getInt32Ty()->getPointerTo(ADDR_SPACE_CONST));
@@ -557,10 +698,9 @@ void PatchEntryPointMutate::fixupUserDataUses(Module &module) {
           descSetVal->setName("descSet" + Twine(descSetIdx));
 
           // Now we want to extend the loaded 32-bit value to a 64-bit pointer, using either PC or the provided
-          // high half.
-          builder.SetInsertPoint(call);
+          // high half. All uses in the function share one extension, at the start of the function.
           unsigned highHalf = cast<ConstantInt>(call->getArgOperand(1))->getZExtValue();
-          descSetVal = addressExtender.extend(descSetVal, highHalf, call->getType(), builder);
+          descSetVal = addressExtender.extendShared(descSetVal, highHalf, call->getType());
           // Replace uses of the call and erase it.
           call->replaceAllUsesWith(descSetVal);
           call->eraseFromParent();
@@ -590,10 +730,9 @@ void PatchEntryPointMutate::fixupUserDataUses(Module &module) {
             if (call->getNumArgOperands() >= 2) {
               // There is a second operand, used by ShaderInputs::getSpecialUserDataAsPoint to indicate that we
               // need to extend the loaded 32-bit value to a 64-bit pointer, using either PC or the provided
-              // high half.
-              builder.SetInsertPoint(call);
+              // high half. All uses in the function share one extension, at the start of the function.
               unsigned highHalf = cast<ConstantInt>(call->getArgOperand(1))->getZExtValue();
-              replacementVal = addressExtender.extend(replacementVal, highHalf, call->getType(), builder);
+              replacementVal = addressExtender.extendShared(replacementVal, highHalf, call->getType());
             }
             inst->replaceAllUsesWith(replacementVal);
             inst->eraseFromParent();
@@ -605,6 +744,40 @@ void PatchEntryPointMutate::fixupUserDataUses(Module &module) {
   }
 }
 
+// =====================================================================================================================
+// Replace the loads from one dword offset of a block of constants in the root user data with the unspilled entry arg
+// for that offset. We know that all loads are non-aggregates of the same size, except for ones smaller than a dword,
+// so we can bitcast.
+//
+// @param func : Function to replace loads in
+// @param [in/out] offsetUsage : Usage of the dword offset, whose loads in func are erased and cleared
+// @param arg : Entry arg for the dword offset
+// @param subDwordShifts : Bit offset within its dword of each load that is smaller than a dword
+// @param builder : IRBuilder to use for the replacement code
+void PatchEntryPointMutate::replaceConstantLoads(Function &func, UserDataNodeUsage &offsetUsage, Argument *arg,
+                                                 const DenseMap<Instruction *, unsigned> &subDwordShifts,
+                                                 IRBuilder<> &builder) {
+  for (Instruction *&load : offsetUsage.users) {
+    if (load && load->getFunction() == &func) {
+      builder.SetInsertPoint(load);
+      Value *replacement = nullptr;
+      auto subDwordShift = subDwordShifts.find(load);
+      if (subDwordShift != subDwordShifts.end()) {
+        // A load smaller than a dword: extract its bits from the dword.
+        unsigned bitSize = load->getType()->getPrimitiveSizeInBits();
+        replacement = builder.CreateBitCast(arg, builder.getInt32Ty());
+        replacement = builder.CreateLShr(replacement, subDwordShift->second);
+        replacement = builder.CreateTrunc(replacement, builder.getIntNTy(bitSize));
+        replacement = builder.CreateBitCast(replacement, load->getType());
+      } else
+        replacement = builder.CreateBitCast(arg, load->getType());
+      load->replaceAllUsesWith(replacement);
+      load->eraseFromParent();
+      load = nullptr;
+    }
+  }
+}
+
 // =====================================================================================================================
 // Process a single shader
 //
@@ -674,6 +847,15 @@ void PatchEntryPointMutate::processShader(ShaderInputs *shaderInputs) {
   if (shaderOptions->maxThreadGroupsPerComputeUnit != 0) {
     std::string wavesPerEu = std::string("0,") + std::to_string(shaderOptions->maxThreadGroupsPerComputeUnit);
     builder.addAttribute("amdgpu-waves-per-eu", wavesPerEu);
+  } else if (cl::TargetOccupancy) {
+    // Ask for exactly the occupancy that LDS allows: fewer waves would waste LDS capacity, and more waves cannot
+    // launch anyway, so the register budget can be as large as that occupancy permits.
+    if (unsigned targetWavesPerEu = getTargetWavesPerEu()) {
+      std::string wavesPerEu = std::to_string(targetWavesPerEu) + "," + std::to_string(targetWavesPerEu);
+      builder.addAttribute("amdgpu-waves-per-eu", wavesPerEu);
+      LLPC_OUTS("Target occupancy (" << getShaderStageAbbreviation(m_shaderStage) << "): " << targetWavesPerEu
+                                     << " waves per EU\n");
+    }
   }
 
   if (shaderOptions->unrollThreshold != 0)
@@ -696,6 +878,55 @@ void PatchEntryPointMutate::processShader(ShaderInputs *shaderInputs) {
   origEntryPoint->eraseFromParent();
 }
 
+// =====================================================================================================================
+// Get the number of waves per EU that the LDS usage of the current shader allows, or 0 if the shader does not use LDS
+// (or its usage is not known here), in which case occupancy is left to the backend.
+//
+// The LDS usage is the workgroup variables of a compute shader, or the on-chip ES-GS/NGG LDS of the subgroup for the
+// shaders that make up a GFX9+ merged GS or NGG primitive shader.
+unsigned PatchEntryPointMutate::getTargetWavesPerEu() {
+  const auto &gpuProperty = m_pipelineState->getTargetInfo().getGpuProperty();
+  const unsigned gfxIpMajor = m_pipelineState->getTargetInfo().getGfxIpVersion().major;
+  const unsigned waveSize = m_pipelineState->getShaderWaveSize(m_shaderStage);
+
+  unsigned ldsSize = 0;
+  unsigned threadsPerGroup = 0;
+  if (m_shaderStage == ShaderStageCompute) {
+    const DataLayout &dataLayout = m_module->getDataLayout();
+    for (GlobalVariable &global : m_module->globals()) {
+      if (global.getType()->getPointerAddressSpace() == ADDR_SPACE_LOCAL && !global.user_empty())
+        ldsSize += dataLayout.getTypeAllocSize(global.getValueType());
+    }
+
+    const auto &mode = m_pipelineState->getShaderModes()->getComputeShaderMode();
+    threadsPerGroup =
+        std::max(mode.workgroupSizeX, 1U) * std::max(mode.workgroupSizeY, 1U) * std::max(mode.workgroupSizeZ, 1U);
+  } else if (gfxIpMajor >= 9) {
+    const bool hasGs = m_pipelineState->hasShaderStage(ShaderStageGeometry);
+    const bool enableNgg = m_pipelineState->getNggControl()->enableNgg;
+    const ShaderStage esStage =
+        m_pipelineState->hasShaderStage(ShaderStageTessEval) ? ShaderStageTessEval : ShaderStageVertex;
+    if (m_shaderStage == ShaderStageGeometry || ((hasGs || enableNgg) && m_shaderStage == esStage)) {
+      const auto &calcFactor = m_pipelineState->getShaderResourceUsage(ShaderStageGeometry)->inOutUsage.gs.calcFactor;
+      ldsSize = calcFactor.gsOnChipLdsSize * 4;
+      threadsPerGroup = std::max(calcFactor.esVertsPerSubgroup, calcFactor.gsPrimsPerSubgroup);
+    }
+  }
+
+  if (ldsSize == 0 || threadsPerGroup == 0)
+    return 0;
+
+  // NOTE: GFX10 has two SIMD32s per CU, each running up to 20 wave32s or 10 wave64s. Earlier hardware has four SIMDs
+  // per CU, each running up to 10 waves.
+  const unsigned simdsPerCu = gfxIpMajor >= 10 ? 2 : 4;
+  const unsigned maxWavesPerEu = gfxIpMajor >= 10 && waveSize == 32 ? 20 : 10;
+
+  const unsigned groupsPerCu = std::max(gpuProperty.ldsSizePerCu / ldsSize, 1U);
+  const unsigned wavesPerGroup = alignTo(threadsPerGroup, waveSize) / waveSize;
+  const unsigned wavesPerEu = alignTo(groupsPerCu * wavesPerGroup, simdsPerCu) / simdsPerCu;
+  return std::min(wavesPerEu, maxWavesPerEu);
+}
+
 // =====================================================================================================================
 // Generates the type for the new entry-point based on already-collected info.
 // This is what decides what SGPRs and VGPRs are passed to the shader at wave dispatch:
@@ -1066,41 +1297,41 @@ void PatchEntryPointMutate::addUserDataArgs(SmallVectorImpl<UserDataArg> &userDa
       }
 
       // We add a potential unspilled arg for each separate dword offset of the push const at which there is a load.
-      // We already know that loads we have on our pushConstOffsets lists are at dword-aligned offset and dword-aligned
-      // size. We need to ensure that all loads are the same size, by removing ones that are bigger than the
-      // minimum size.
-      for (unsigned dwordOffset = 0,
-                    dwordEndOffset = std::min(unsigned(userDataUsage->pushConstOffsets.size()), node.sizeInDwords);
-           dwordOffset != dwordEndOffset; ++dwordOffset) {
-        UserDataNodeUsage &pushConstOffset = userDataUsage->pushConstOffsets[dwordOffset];
-        if (pushConstOffset.users.empty())
-          continue;
+      userDataSize = addConstantLoadArgs(userDataArgs, userDataUsage->pushConstOffsets, node.offsetInDwords,
+                                         node.sizeInDwords, userDataUsage->pushConstSpill, useFixedLayout,
+                                         userDataSize, builder);
 
-        // Check that the load size does not overlap with the next used offset in the push constant.
-        bool haveOverlap = false;
-        unsigned endOffset =
-            std::min(dwordOffset + pushConstOffset.dwordSize, unsigned(userDataUsage->pushConstOffsets.size()));
-        for (unsigned followingOffset = dwordOffset + 1; followingOffset != endOffset; ++followingOffset) {
-          if (!userDataUsage->pushConstOffsets[followingOffset].users.empty()) {
-            haveOverlap = true;
-            break;
-          }
-        }
-        if (haveOverlap) {
-          userDataUsage->pushConstSpill = true;
-          continue;
-        }
+      // Ensure we mark the push constant's part of the spill table as used.
+      if (userDataUsage->pushConstSpill)
+        userDataUsage->spillUsage = std::min(userDataUsage->spillUsage, node.offsetInDwords);
 
-        // Add the arg (part of the push const) that we can potentially unspill.
-        userDataSize = addUserDataArg(userDataArgs, node.offsetInDwords + dwordOffset, pushConstOffset.dwordSize,
-                                      &pushConstOffset.entryArgIdx, useFixedLayout, userDataSize, builder);
+      break;
+
+    case ResourceNodeType::InlineBuffer: {
+      // An inline buffer in the root table. This is handled in the same way as the push constant.
+      auto rootInlineBuffer = userDataUsage->rootInlineBuffers.find(node.offsetInDwords);
+      if (rootInlineBuffer == userDataUsage->rootInlineBuffers.end())
+        break;
+      RootInlineBufferUsage &usage = rootInlineBuffer->second;
+      if (useFixedLayout && (usage.offsets.size() != 1 || usage.offsets[0].dwordSize != node.sizeInDwords)) {
+        // Add an arg entry with "mustSpill". In CS fixed layout, that causes later entries to be spilled too.
+        userDataSize = addUserDataArg(userDataArgs, node.offsetInDwords, node.sizeInDwords, nullptr, useFixedLayout,
+                                      userDataSize, builder);
+        userDataArgs.back().mustSpill = true;
+        usage.spill = true;
+        break;
       }
 
-      // Ensure we mark the push constant's part of the spill table as used.
-      if (userDataUsage->pushConstSpill)
+      // We add a potential unspilled arg for each separate dword offset of the inline buffer at which there is a load.
+      userDataSize = addConstantLoadArgs(userDataArgs, usage.offsets, node.offsetInDwords, node.sizeInDwords,
+                                         usage.spill, useFixedLayout, userDataSize, builder);
+
+      // Ensure we mark the inline buffer's part of the spill table as used.
+      if (usage.spill)
         userDataUsage->spillUsage = std::min(userDataUsage->spillUsage, node.offsetInDwords);
 
       break;
+    }
 
     default:
       // Descriptor in the root table. If it is an array of descriptors, there could be multiple entries in
@@ -1168,6 +1399,54 @@ unsigned PatchEntryPointMutate::addUserDataArg(SmallVectorImpl<UserDataArg> &use
   return userDataSize;
 }
 
+// =====================================================================================================================
+// Add a UserDataArg for each separate dword offset of a block of constants in the root user data (the push constant
+// or a root inline buffer) at which there is a load that we can potentially unspill.
+//
+// We already know that loads we have on the offsets lists are at dword-aligned offset and dword-aligned size, and
+// that all loads at one offset are the same size. We need to ensure that a load does not overlap the next used
+// offset; if it does, its loads are left spilled.
+//
+// @param userDataArgs : Vector to add args to
+// @param offsets : Per-dword-offset lists of loads from the block
+// @param userDataValue : PAL metadata user data value for the start of the block
+// @param sizeInDwords : Size of the block in dwords
+// @param [in/out] spill : Set if some loads from the block are left spilled
+// @param useFixedLayout : True to insert padding before if required
+// @param userDataSize : Size so far of user data in dwords
+// @param builder : IRBuilder (just for getting types)
+// @return : Updated size so far of user data in dwords
+unsigned PatchEntryPointMutate::addConstantLoadArgs(SmallVectorImpl<UserDataArg> &userDataArgs,
+                                                    SmallVectorImpl<UserDataNodeUsage> &offsets,
+                                                    unsigned userDataValue, unsigned sizeInDwords, bool &spill,
+                                                    bool useFixedLayout, unsigned userDataSize, IRBuilder<> &builder) {
+  for (unsigned dwordOffset = 0, dwordEndOffset = std::min(unsigned(offsets.size()), sizeInDwords);
+       dwordOffset != dwordEndOffset; ++dwordOffset) {
+    UserDataNodeUsage &offsetUsage = offsets[dwordOffset];
+    if (offsetUsage.users.empty())
+      continue;
+
+    // Check that the load size does not overlap with the next used offset in the block.
+    bool haveOverlap = false;
+    unsigned endOffset = std::min(dwordOffset + offsetUsage.dwordSize, unsigned(offsets.size()));
+    for (unsigned followingOffset = dwordOffset + 1; followingOffset != endOffset; ++followingOffset) {
+      if (!offsets[followingOffset].users.empty()) {
+        haveOverlap = true;
+        break;
+      }
+    }
+    if (haveOverlap) {
+      spill = true;
+      continue;
+    }
+
+    // Add the arg (part of the block) that we can potentially unspill.
+    userDataSize = addUserDataArg(userDataArgs, userDataValue + dwordOffset, offsetUsage.dwordSize,
+                                  &offsetUsage.entryArgIdx, useFixedLayout, userDataSize, builder);
+  }
+  return userDataSize;
+}
+
 // =====================================================================================================================
 // Determine which user data args are going to be "unspilled" (passed in shader entry SGPRs rather than loaded
 // from spill table)
@@ -1186,11 +1465,13 @@ void PatchEntryPointMutate::determineUnspilledUserDataArgs(ArrayRef<UserDataArg>
   SmallVector<UserDataArg, 1> spillTableArg;
 
   auto userDataUsage = getUserDataUsage(m_shaderStage);
-  if (!userDataUsage->spillTable.users.empty() || userDataUsage->pushConstSpill ||
+  bool rootInlineBufferSpill = any_of(userDataUsage->rootInlineBuffers,
+                                      [](const auto &rootInlineBuffer) { return rootInlineBuffer.second.spill; });
+  if (!userDataUsage->spillTable.users.empty() || userDataUsage->pushConstSpill || rootInlineBufferSpill ||
       userDataUsage->spillUsage != UINT_MAX) {
-    // Spill table is already in use by code added in DescBuilder, or by uses of the push const pointer not
-    // all being of the form that can be unspilled, or by push const uses or descriptor array entries not even
-    // being considered for unspilling in CS fixed layout.
+    // Spill table is already in use by code added in DescBuilder, or by uses of the push const or root inline
+    // buffer pointer not all being of the form that can be unspilled, or by push const uses or descriptor array
+    // entries not even being considered for unspilling in CS fixed layout.
     spillTableArg.push_back(
         UserDataArg(builder.getInt32Ty(), UserDataMapping::SpillTable, &userDataUsage->spillTable.entryArgIdx));
 
@@ -1242,6 +1523,27 @@ void PatchEntryPointMutate::determineUnspilledUserDataArgs(ArrayRef<UserDataArg>
   bool useFixedLayout = m_shaderStage == ShaderStageCompute;
   unsigned userDataIdx = 0;
 
+  if (cl::WeightedUserDataSpill && !useFixedLayout) {
+    // Check whether all nodes fit in SGPRs, in which case the in-order allocation below keeps all of them.
+    unsigned userDataSize = 0;
+    bool needSpill = false;
+    for (const UserDataArg &userDataArg : userDataArgs) {
+      userDataSize += userDataArg.argDwordSize;
+      needSpill |= userDataArg.mustSpill;
+    }
+    needSpill |= userDataSize > userDataEnd;
+
+    if (needSpill) {
+      if (spillTableArg.empty()) {
+        spillTableArg.push_back(
+            UserDataArg(builder.getInt32Ty(), UserDataMapping::SpillTable, &userDataUsage->spillTable.entryArgIdx));
+        --userDataEnd;
+      }
+      selectWeightedUnspilledUserDataArgs(userDataArgs, userDataEnd, unspilledArgs);
+      userDataArgs = {};
+    }
+  }
+
   for (const UserDataArg &userDataArg : userDataArgs) {
     unsigned afterUserDataIdx = userDataIdx + userDataArg.argDwordSize;
     if (userDataArg.mustSpill || afterUserDataIdx > userDataEnd) {
@@ -1320,6 +1622,100 @@ void PatchEntryPointMutate::determineUnspilledUserDataArgs(ArrayRef<UserDataArg>
   }
 }
 
+// =====================================================================================================================
+// Select the user data args to keep in SGPRs for a graphics shader that has to spill some of them, by weighted use
+// count per dword rather than by order. The selected args keep their original relative order.
+//
+// @param userDataArgs : The candidate user data args
+// @param userDataEnd : Number of SGPRs available for the user data args
+// @param [out] unspilledArgs : Output vector of user data args to keep in SGPRs
+void PatchEntryPointMutate::selectWeightedUnspilledUserDataArgs(ArrayRef<UserDataArg> userDataArgs,
+                                                                unsigned userDataEnd,
+                                                                SmallVectorImpl<UserDataArg> &unspilledArgs) {
+  auto userDataUsage = getUserDataUsage(m_shaderStage);
+
+  SmallVector<uint64_t, 16> weights;
+  SmallVector<unsigned, 16> order;
+  for (unsigned idx = 0; idx != userDataArgs.size(); ++idx) {
+    weights.push_back(getUserDataArgWeight(userDataArgs[idx]));
+    order.push_back(idx);
+  }
+
+  // Sort by weight per dword, highest first. Ties keep the original order.
+  std::stable_sort(order.begin(), order.end(), [&](unsigned lhs, unsigned rhs) {
+    return weights[lhs] * userDataArgs[rhs].argDwordSize > weights[rhs] * userDataArgs[lhs].argDwordSize;
+  });
+
+  SmallVector<bool, 16> keep(userDataArgs.size(), false);
+  unsigned userDataIdx = 0;
+  for (unsigned idx : order) {
+    const UserDataArg &userDataArg = userDataArgs[idx];
+    if (userDataArg.mustSpill || userDataArg.isPadding || userDataIdx + userDataArg.argDwordSize > userDataEnd)
+      continue;
+    userDataIdx += userDataArg.argDwordSize;
+    keep[idx] = true;
+  }
+
+  for (unsigned idx = 0; idx != userDataArgs.size(); ++idx) {
+    if (keep[idx])
+      unspilledArgs.push_back(userDataArgs[idx]);
+    else {
+      // Ensure that spillUsage includes this offset.
+      userDataUsage->spillUsage = std::min(userDataUsage->spillUsage, userDataArgs[idx].userDataValue);
+    }
+  }
+
+  // Loop info is only valid until the entry-points are mutated
+  m_loopInfos.clear();
+}
+
+// =====================================================================================================================
+// Get the weight of a user data arg, which is the number of its uses with each use weighted by its loop depth
+//
+// @param userDataArg : The user data arg
+uint64_t PatchEntryPointMutate::getUserDataArgWeight(const UserDataArg &userDataArg) {
+  if (!userDataArg.argIndex)
+    return 0;
+
+  // Find the user data node usage that the arg is allocated for
+  auto userDataUsage = getUserDataUsage(m_shaderStage);
+  const UserDataNodeUsage *nodeUsage = nullptr;
+  SmallVector<ArrayRef<UserDataNodeUsage>, 4> nodeUsageLists = {userDataUsage->descriptorSets,
+                                                                userDataUsage->pushConstOffsets,
+                                                                userDataUsage->rootDescriptors};
+  for (auto &rootInlineBuffer : userDataUsage->rootInlineBuffers)
+    nodeUsageLists.push_back(rootInlineBuffer.second.offsets);
+  for (ArrayRef<UserDataNodeUsage> nodeUsages : nodeUsageLists) {
+    for (const UserDataNodeUsage &candidate : nodeUsages) {
+      if (&candidate.entryArgIdx == userDataArg.argIndex)
+        nodeUsage = &candidate;
+    }
+  }
+  if (!nodeUsage)
+    return 0;
+
+  // Each use counts 8x per level of loop nesting, as a rough estimate of trip counts.
+  static const unsigned MaxLoopDepth = 6;
+  uint64_t weight = 0;
+  for (Instruction *user : nodeUsage->users)
+    weight += uint64_t(1) << (3 * std::min(getLoopDepth(user), MaxLoopDepth));
+  return weight;
+}
+
+// =====================================================================================================================
+// Get the loop depth of an instruction, computing loop info for its function on first use
+//
+// @param inst : The instruction
+unsigned PatchEntryPointMutate::getLoopDepth(Instruction *inst) {
+  Function *func = inst->getFunction();
+  auto &loopInfo = m_loopInfos[func];
+  if (!loopInfo) {
+    DominatorTree dominatorTree(*func);
+    loopInfo = std::make_unique<LoopInfo>(dominatorTree);
+  }
+  return loopInfo->getLoopDepth(inst->getParent());
+}
+
 // =====================================================================================================================
 // Get UserDataUsage struct for the merged shader stage that contains the given shader stage
 //
@@ -1328,8 +1724,8 @@ PatchEntryPointMutate::UserDataUsage *PatchEntryPointMutate::getUserDataUsage(Sh
   stage = getMergedShaderStage(stage);
   m_userDataUsage.resize(std::max(m_userDataUsage.size(), static_cast<size_t>(stage) + 1));
   if (!m_userDataUsage[stage])
-    m_userDataUsage[stage] = std::make_unique<UserDataUsage>();
-  return &*m_userDataUsage[stage];
+    m_userDataUsage[stage] = new (m_userDataUsageAllocator.Allocate()) UserDataUsage();
+  return m_userDataUsage[stage];
 }
 
 // =====================================================================================================================
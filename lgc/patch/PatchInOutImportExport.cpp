@@ -34,12 +34,18 @@
 #include "lgc/LgcContext.h"
 #include "lgc/patch/FragColorExport.h"
 #include "lgc/state/AbiUnlinked.h"
+#include "lgc/state/PalMetadata.h"
 #include "lgc/state/PipelineShaders.h"
 #include "lgc/util/Debug.h"
+#include "llvm/ADT/MapVector.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/PostDominators.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/IntrinsicsAMDGPU.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
 #include "llvm/Support/raw_ostream.h"
+#include <map>
 #include <unordered_set>
 
 #define DEBUG_TYPE "lgc-patch-in-out-import-export"
@@ -47,8 +53,29 @@
 using namespace llvm;
 using namespace lgc;
 
+namespace llvm {
+namespace cl {
+
+// -tess-occupancy-patch-count: choose the HS patch count per thread group that maximizes patches resident per CU
+static opt<bool> TessOccupancyPatchCount("tess-occupancy-patch-count",
+                                         desc("Choose the HS patch count per thread group that maximizes the number "
+                                              "of patches resident per CU given the LDS footprint of a patch"),
+                                         init(false));
+
+// -tcs-skip-culled-patch-outputs: skip the off-chip output stores of TCS for patches culled by their outer factors
+static opt<bool> TcsSkipCulledPatchOutputs("tcs-skip-culled-patch-outputs",
+                                           desc("Skip the off-chip output stores of a TCS for a patch that its outer "
+                                                "tessellation factors cull, storing only the tessellation factors"),
+                                           init(true));
+
+} // namespace cl
+} // namespace llvm
+
 namespace lgc {
 
+// Maximum number of dwords combined into one on-chip LDS load or store (ds_read_b128/ds_write_b128)
+static const unsigned MaxLdsCombineDwords = 4;
+
 // =====================================================================================================================
 // Initializes static members.
 char PatchInOutImportExport::ID = 0;
@@ -84,6 +111,15 @@ void PatchInOutImportExport::initPerShader() {
   m_viewportIndex = nullptr;
   m_layer = nullptr;
   m_threadId = nullptr;
+  m_streamOutVertexCount = nullptr;
+  m_streamOutWriteIndex = nullptr;
+  for (auto &streamOutOffset : m_streamOutOffsets)
+    streamOutOffset = nullptr;
+  m_fsInterpInsertPos = nullptr;
+  m_tcsPatchCulled = nullptr;
+  m_tcsCullUnsafe = false;
+  m_fsInterpValues.clear();
+  m_adjustedCentroidIjs.clear();
 }
 
 // =====================================================================================================================
@@ -122,6 +158,15 @@ bool PatchInOutImportExport::runOnModule(Module &module) {
       // Now process the call and return instructions.
       visit(*m_entryPoint);
 
+      // Store transform feedback outputs, which are delayed to combine them
+      storeXfbOutputDwords();
+
+      if (m_shaderStage == ShaderStageFragment) {
+        returnFsColorExports();
+        addFsDemoteEarlyExits();
+      } else if (m_shaderStage == ShaderStageTessControl && cl::TcsSkipCulledPatchOutputs)
+        skipCulledPatchOutputStores();
+
       delete m_fragColorExport;
       m_fragColorExport = nullptr;
     }
@@ -146,12 +191,137 @@ bool PatchInOutImportExport::runOnModule(Module &module) {
   return true;
 }
 
+// =====================================================================================================================
+// Change the fragment shader entry-point to return the color outputs gathered for the color export shader, if any.
+//
+// The outputs are returned as floats in consecutive VGPRs. An AMDGPU_PS function with a non-void return does not end
+// the program, so the fragment shader falls through into the color export shader that the linker glues on after it,
+// which takes the values as its args.
+void PatchInOutImportExport::returnFsColorExports() {
+  if (m_colorExportReturns.empty())
+    return;
+
+  Function *newEntryPoint = addFunctionArgs(m_entryPoint, m_colorExportReturns.front().second->getType(), {});
+  for (auto &colorExportReturn : m_colorExportReturns) {
+    ReturnInst::Create(*m_context, colorExportReturn.second, colorExportReturn.first);
+    colorExportReturn.first->eraseFromParent();
+  }
+  m_colorExportReturns.clear();
+
+  m_entryPoint->eraseFromParent();
+  m_entryPoint = newEntryPoint;
+}
+
+// =====================================================================================================================
+// Add wave-level early exits after the demote-to-helper operations of the fragment shader.
+//
+// A kill clears EXEC, and the backend already ends the wave with a null export once EXEC becomes zero after a
+// top-level kill. A demote leaves the demoted lanes running as helpers for derivatives, so the wave keeps executing
+// up to the exports even when no lane can write anything any more. After each demote that executes with all live
+// lanes active (its block post-dominates the entry block and is not inside a loop), branch uniformly on a ballot of
+// the non-helper lanes to an exit that does the null export. A wave only takes that branch when every lane is a
+// helper, so no derivative that reaches an export is affected.
+void PatchInOutImportExport::addFsDemoteEarlyExits() {
+  // Unlinked fragment shaders return their outputs to the color export shader instead of exporting them.
+  if (m_pipelineState->isUnlinked() || !m_entryPoint->getReturnType()->isVoidTy())
+    return;
+
+  Function *demoteFunc = Intrinsic::getDeclaration(m_module, Intrinsic::amdgcn_wqm_demote);
+  SmallVector<CallInst *, 4> demotes;
+  PostDominatorTree postDomTree(*m_entryPoint);
+  DominatorTree domTree(*m_entryPoint);
+  LoopInfo loopInfo(domTree);
+  for (User *user : demoteFunc->users()) {
+    auto call = dyn_cast<CallInst>(user);
+    if (!call || call->getFunction() != m_entryPoint)
+      continue;
+    BasicBlock *block = call->getParent();
+    if (!postDomTree.dominates(block, &m_entryPoint->getEntryBlock()) || loopInfo.getLoopFor(block))
+      continue;
+    demotes.push_back(call);
+  }
+  if (demotes.empty())
+    return;
+
+  // All early exits share one block that ends the wave.
+  BasicBlock *exitBlock = BasicBlock::Create(*m_context, ".demoteExit", m_entryPoint);
+  IRBuilder<> builder(exitBlock);
+  Value *undef = UndefValue::get(builder.getFloatTy());
+  builder.CreateIntrinsic(Intrinsic::amdgcn_exp, builder.getFloatTy(),
+                          {
+                              builder.getInt32(EXP_TARGET_PS_NULL), // tgt
+                              builder.getInt32(0),                  // en
+                              undef,                                // src0
+                              undef,                                // src1
+                              undef,                                // src2
+                              undef,                                // src3
+                              builder.getTrue(),                    // done
+                              builder.getTrue()                     // vm
+                          });
+  builder.CreateRetVoid();
+
+  const unsigned waveSize = m_pipelineState->getShaderWaveSize(ShaderStageFragment);
+  for (CallInst *demote : demotes) {
+    BasicBlock *block = demote->getParent();
+    BasicBlock *tail = block->splitBasicBlock(demote->getNextNode(), block->getName() + ".demoteCont");
+    block->getTerminator()->eraseFromParent();
+
+    builder.SetInsertPoint(block);
+    Value *isLive = builder.CreateIntrinsic(Intrinsic::amdgcn_wqm_helper, {}, {});
+    Value *liveMask =
+        builder.CreateIntrinsic(Intrinsic::amdgcn_icmp, {builder.getIntNTy(waveSize), builder.getInt32Ty()},
+                                {builder.CreateZExt(isLive, builder.getInt32Ty()), builder.getInt32(0),
+                                 builder.getInt32(CmpInst::ICMP_NE)});
+    Value *allHelpers = builder.CreateICmpEQ(liveMask, ConstantInt::get(liveMask->getType(), 0));
+    builder.CreateCondBr(allHelpers, exitBlock, tail);
+  }
+}
+
+// =====================================================================================================================
+// Skip the off-chip output stores of TCS for a culled patch.
+//
+// The hardware culls a patch if any of its outer tessellation factors is zero or less, or NaN. Then no TES invocation
+// runs for the patch, and nothing reads its outputs from the off-chip LDS buffer. So every off-chip output store that
+// comes after the computation of the outer factors (that is, is dominated by it) is guarded by a branch on the patch
+// not being culled. The factors are still written to the TF buffer, which the hardware needs to see the patch is
+// culled. This is only done when gl_TessLevelOuter is written once as a whole array, and the TCS does not read back
+// its own outputs, which a culled patch would then read without having stored.
+void PatchInOutImportExport::skipCulledPatchOutputStores() {
+  if (!m_tcsPatchCulled || m_tcsCullUnsafe || !m_pipelineState->isTessOffChip())
+    return;
+
+  DominatorTree domTree(*m_entryPoint);
+  Value *offChipLdsDesc = m_pipelineSysValues.get(m_entryPoint)->getOffChipLdsDesc();
+  SmallVector<CallInst *, 8> stores;
+  for (User *user : offChipLdsDesc->users()) {
+    auto call = dyn_cast<CallInst>(user);
+    if (!call || call->getFunction() != m_entryPoint || !call->getCalledFunction() ||
+        !call->getCalledFunction()->getName().startswith("llvm.amdgcn.raw.tbuffer.store."))
+      continue;
+    if (domTree.dominates(m_tcsPatchCulled, call))
+      stores.push_back(call);
+  }
+  if (stores.empty())
+    return;
+
+  IRBuilder<> builder(*m_context);
+  builder.SetInsertPoint(m_tcsPatchCulled->getNextNode());
+  Value *notCulled = builder.CreateNot(m_tcsPatchCulled);
+  for (CallInst *store : stores) {
+    Instruction *thenTerm = SplitBlockAndInsertIfThen(notCulled, store, false);
+    store->moveBefore(thenTerm);
+  }
+}
+
 // =====================================================================================================================
 // Process a single shader
 void PatchInOutImportExport::processShader() {
   if (m_shaderStage == ShaderStageFragment) {
     // Create fragment color export manager
     m_fragColorExport = new FragColorExport(m_context);
+
+    // Interpolation shared by input imports is placed here, before any original instruction of the shader
+    m_fsInterpInsertPos = &*m_entryPoint->front().getFirstInsertionPt();
   }
 
   // Initialize the output value for gl_PrimitiveID
@@ -260,9 +430,16 @@ void PatchInOutImportExport::processShader() {
 
       calcFactor.tessFactorStride = tessFactorStride;
 
+      unsigned hsLdsSize = inPatchTotalSize;
+      if (!m_pipelineState->isTessOffChip())
+        hsLdsSize += outPatchTotalSize + calcFactor.patchConstSize * calcFactor.patchCountPerThreadGroup;
+      (void(hsLdsSize)); // unused
+
       LLPC_OUTS("===============================================================================\n");
       LLPC_OUTS("// LLPC tessellation calculation factor results\n\n");
+      LLPC_OUTS("Tessellation mode: " << (m_pipelineState->isTessOffChip() ? "off-chip" : "on-chip") << "\n");
       LLPC_OUTS("Patch count per thread group: " << calcFactor.patchCountPerThreadGroup << "\n");
+      LLPC_OUTS("HS LDS size per thread group (in dwords): " << hsLdsSize << "\n");
       LLPC_OUTS("\n");
       LLPC_OUTS("Input vertex count: " << inVertexCount << "\n");
       LLPC_OUTS("Input vertex stride: " << calcFactor.inVertexStride << "\n");
@@ -1323,7 +1500,11 @@ void PatchInOutImportExport::visitReturnInst(ReturnInst &retInst) {
       m_lastExport = emitCall("llvm.amdgcn.exp.f32", Type::getVoidTy(*m_context), args, {}, insertPos);
     }
 
-    // Export fragment colors
+    // Export fragment colors. Without color export formats in an unlinked compile, gather them instead, to return
+    // them to the color export shader.
+    const bool useColorExportShader = m_pipelineState->useColorExportShader();
+    SmallVector<ColorExportInfo, MaxColorTargets> colorExports;
+    SmallVector<Value *, 4 * MaxColorTargets> colorExportValues;
     for (unsigned hwColorTarget = 0; hwColorTarget < MaxColorTargets; ++hwColorTarget) {
       auto &expFragColor = m_expFragColors[hwColorTarget];
       if (expFragColor.size() > 0) {
@@ -1338,8 +1519,34 @@ void PatchInOutImportExport::visitReturnInst(ReturnInst &retInst) {
         if (location == InvalidValue)
           continue;
 
+        if (useColorExportShader) {
+          BasicType outputType = resUsage->inOutUsage.fs.outputTypes[location];
+          const bool signedness =
+              (outputType == BasicType::Int8 || outputType == BasicType::Int16 || outputType == BasicType::Int);
+          Type *compTy = expFragColor[0]->getType();
+          colorExports.push_back({hwColorTarget, location, signedness,
+                                  compCount == 1 ? compTy : FixedVectorType::get(compTy, compCount)});
+
+          // Each component is returned as a float in its own VGPR.
+          IRBuilder<> builder(insertPos);
+          for (Value *comp : expFragColor) {
+            unsigned bitWidth = comp->getType()->getPrimitiveSizeInBits();
+            if (bitWidth < 32)
+              comp = builder.CreateZExt(builder.CreateBitCast(comp, builder.getIntNTy(bitWidth)), builder.getInt32Ty());
+            colorExportValues.push_back(builder.CreateBitCast(comp, builder.getFloatTy()));
+          }
+          continue;
+        }
+
         resUsage->inOutUsage.fs.cbShaderMask |= (channelMask << (4 * location));
 
+        // Drop the channels that can never reach the color target, so that their computation becomes dead
+        const unsigned liveChannelMask = m_pipelineState->computeExportChannelMask(location);
+        for (unsigned i = 0; i < compCount; ++i) {
+          if ((liveChannelMask & (1 << i)) == 0)
+            expFragColor[i] = UndefValue::get(expFragColor[i]->getType());
+        }
+
         // Construct exported fragment colors
         if (compCount == 1)
           output = expFragColor[0];
@@ -1369,7 +1576,7 @@ void PatchInOutImportExport::visitReturnInst(ReturnInst &retInst) {
         resUsage->inOutUsage.fs.expFmts[hwColorTarget] = expFmt;
 
         // Do fragment color exporting
-        auto exportInst = m_fragColorExport->run(output, hwColorTarget, insertPos, expFmt, signedness);
+        auto exportInst = m_fragColorExport->run(output, hwColorTarget, insertPos, expFmt, signedness, liveChannelMask);
         if (exportInst)
           m_lastExport = cast<CallInst>(exportInst);
       }
@@ -1381,6 +1588,27 @@ void PatchInOutImportExport::visitReturnInst(ReturnInst &retInst) {
     // NOTE: GFX10 can allow no dummy export when the fragment shader does not have discard operation
     // or ROV (Raster-ordered views)
     resUsage->inOutUsage.fs.dummyExport = (m_gfxIp.major < 10 || resUsage->builtInUsage.fs.discard);
+
+    if (!colorExports.empty()) {
+      // The color export shader does the last export, so leave "done" and any dummy export to it. Record what it
+      // needs in PAL metadata the first time round, and build the return value to replace this "ret" with once the
+      // entry-point returns it.
+      if (m_colorExportReturns.empty()) {
+        FsExportInfo fsInfo = {};
+        fsInfo.dummyExport = !m_lastExport && resUsage->inOutUsage.fs.dummyExport;
+        fsInfo.wave32 = m_pipelineState->getShaderWaveSize(ShaderStageFragment) == 32;
+        m_pipelineState->getPalMetadata()->addColorExportInfo(colorExports, fsInfo);
+      }
+      resUsage->inOutUsage.fs.dummyExport = false;
+      m_lastExport = nullptr;
+
+      SmallVector<Type *, 4 * MaxColorTargets> retTys(colorExportValues.size(), Type::getFloatTy(*m_context));
+      Value *retVal = UndefValue::get(StructType::get(*m_context, retTys));
+      for (unsigned idx = 0; idx != colorExportValues.size(); ++idx)
+        retVal = InsertValueInst::Create(retVal, colorExportValues[idx], idx, "", insertPos);
+      m_colorExportReturns.push_back({&retInst, retVal});
+    }
+
     if (!m_lastExport && resUsage->inOutUsage.fs.dummyExport) {
       Value *args[] = {
           ConstantInt::get(Type::getInt32Ty(*m_context), EXP_TARGET_MRT_0), // tgt
@@ -1535,14 +1763,22 @@ Value *PatchInOutImportExport::patchFsGenericInputImport(Type *inputTy, unsigned
   Value *iCoord = nullptr;
   Value *jCoord = nullptr;
 
+  // NOTE: Unless the interpolation depends on values computed by the shader (explicitly calculated I/J or a dynamic
+  // location offset), it is placed at the start of the entry-point, and each interpolated channel is computed once
+  // and shared by all imports of it.
+  const bool shareInterp = !locOffset && (!auxInterpValue || interpMode == InOutInfo::InterpModeCustom);
+  Instruction *interpInsertPos = shareInterp ? m_fsInterpInsertPos : insertPos;
+  builder.SetInsertPoint(interpInsertPos);
+  Value *ij = nullptr;
+
   // Not "flat" and "custom" interpolation
   if (interpMode != InOutInfo::InterpModeFlat && interpMode != InOutInfo::InterpModeCustom) {
-    auto ij = auxInterpValue;
+    ij = auxInterpValue;
     if (!ij) {
       if (interpMode == InOutInfo::InterpModeSmooth) {
         if (interpLoc == InOutInfo::InterpLocCentroid) {
           ij = adjustCentroidIj(getFunctionArgument(m_entryPoint, entryArgIdxs.perspInterp.centroid),
-                                getFunctionArgument(m_entryPoint, entryArgIdxs.perspInterp.center), insertPos);
+                                getFunctionArgument(m_entryPoint, entryArgIdxs.perspInterp.center));
         } else if (interpLoc == InOutInfo::InterpLocSample)
           ij = getFunctionArgument(m_entryPoint, entryArgIdxs.perspInterp.sample);
         else {
@@ -1553,7 +1789,7 @@ Value *PatchInOutImportExport::patchFsGenericInputImport(Type *inputTy, unsigned
         assert(interpMode == InOutInfo::InterpModeNoPersp);
         if (interpLoc == InOutInfo::InterpLocCentroid) {
           ij = adjustCentroidIj(getFunctionArgument(m_entryPoint, entryArgIdxs.linearInterp.centroid),
-                                getFunctionArgument(m_entryPoint, entryArgIdxs.linearInterp.center), insertPos);
+                                getFunctionArgument(m_entryPoint, entryArgIdxs.linearInterp.center));
         } else if (interpLoc == InOutInfo::InterpLocSample)
           ij = getFunctionArgument(m_entryPoint, entryArgIdxs.linearInterp.sample);
         else {
@@ -1562,8 +1798,6 @@ Value *PatchInOutImportExport::patchFsGenericInputImport(Type *inputTy, unsigned
         }
       }
     }
-    iCoord = ExtractElementInst::Create(ij, ConstantInt::get(Type::getInt32Ty(*m_context), 0), "", insertPos);
-    jCoord = ExtractElementInst::Create(ij, ConstantInt::get(Type::getInt32Ty(*m_context), 1), "", insertPos);
   }
 
   Attribute::AttrKind attribs[] = {Attribute::ReadNone};
@@ -1605,7 +1839,16 @@ Value *PatchInOutImportExport::patchFsGenericInputImport(Type *inputTy, unsigned
       assert((basicTy->isHalfTy() || basicTy->isFloatTy()) && numChannels <= 4);
       (void(basicTy)); // unused
 
-      if (bitWidth == 16) {
+      Value *&sharedValue =
+          m_fsInterpValues[FsInterpKey(ij, InvalidValue, location, i, bitWidth == 16 ? 1 + highHalf : 0)];
+      if (shareInterp && sharedValue)
+        compValue = sharedValue;
+      else if (bitWidth == 16) {
+        if (!iCoord) {
+          iCoord = builder.CreateExtractElement(ij, builder.getInt32(0));
+          jCoord = builder.CreateExtractElement(ij, builder.getInt32(1));
+        }
+
         Value *args1[] = {
             iCoord,                     // i
             builder.getInt32(i),        // attr_chan
@@ -1613,7 +1856,8 @@ Value *PatchInOutImportExport::patchFsGenericInputImport(Type *inputTy, unsigned
             builder.getInt32(highHalf), // high
             primMask                    // m0
         };
-        compValue = emitCall("llvm.amdgcn.interp.p1.f16", Type::getFloatTy(*m_context), args1, attribs, insertPos);
+        compValue =
+            emitCall("llvm.amdgcn.interp.p1.f16", Type::getFloatTy(*m_context), args1, attribs, interpInsertPos);
 
         Value *args2[] = {
             compValue,                  // p1
@@ -1623,15 +1867,21 @@ Value *PatchInOutImportExport::patchFsGenericInputImport(Type *inputTy, unsigned
             builder.getInt32(highHalf), // high
             primMask                    // m0
         };
-        compValue = emitCall("llvm.amdgcn.interp.p2.f16", Type::getHalfTy(*m_context), args2, attribs, insertPos);
+        compValue =
+            emitCall("llvm.amdgcn.interp.p2.f16", Type::getHalfTy(*m_context), args2, attribs, interpInsertPos);
       } else {
+        if (!iCoord) {
+          iCoord = builder.CreateExtractElement(ij, builder.getInt32(0));
+          jCoord = builder.CreateExtractElement(ij, builder.getInt32(1));
+        }
+
         Value *args1[] = {
             iCoord,                                            // i
             ConstantInt::get(Type::getInt32Ty(*m_context), i), // attr_chan
             loc,                                               // attr
             primMask                                           // m0
         };
-        compValue = emitCall("llvm.amdgcn.interp.p1", Type::getFloatTy(*m_context), args1, attribs, insertPos);
+        compValue = emitCall("llvm.amdgcn.interp.p1", Type::getFloatTy(*m_context), args1, attribs, interpInsertPos);
 
         Value *args2[] = {
             compValue,                                         // p1
@@ -1640,8 +1890,10 @@ Value *PatchInOutImportExport::patchFsGenericInputImport(Type *inputTy, unsigned
             loc,                                               // attr
             primMask                                           // m0
         };
-        compValue = emitCall("llvm.amdgcn.interp.p2", Type::getFloatTy(*m_context), args2, attribs, insertPos);
+        compValue = emitCall("llvm.amdgcn.interp.p2", Type::getFloatTy(*m_context), args2, attribs, interpInsertPos);
       }
+      if (shareInterp)
+        sharedValue = compValue;
     } else {
       InterpParam interpParam = INTERP_PARAM_P0;
 
@@ -1666,13 +1918,20 @@ Value *PatchInOutImportExport::patchFsGenericInputImport(Type *inputTy, unsigned
       } else
         assert(interpMode == InOutInfo::InterpModeFlat);
 
-      Value *args[] = {
-          ConstantInt::get(Type::getInt32Ty(*m_context), interpParam),                        // param
-          ConstantInt::get(Type::getInt32Ty(*m_context), i % 4),                              // attr_chan
-          locOffset ? loc : ConstantInt::get(Type::getInt32Ty(*m_context), location + i / 4), // attr
-          primMask                                                                            // m0
-      };
-      compValue = emitCall("llvm.amdgcn.interp.mov", Type::getFloatTy(*m_context), args, attribs, insertPos);
+      Value *&sharedValue = m_fsInterpValues[FsInterpKey(nullptr, interpParam, location + i / 4, i % 4, 0)];
+      if (shareInterp && sharedValue)
+        compValue = sharedValue;
+      else {
+        Value *args[] = {
+            ConstantInt::get(Type::getInt32Ty(*m_context), interpParam),                        // param
+            ConstantInt::get(Type::getInt32Ty(*m_context), i % 4),                              // attr_chan
+            locOffset ? loc : ConstantInt::get(Type::getInt32Ty(*m_context), location + i / 4), // attr
+            primMask                                                                            // m0
+        };
+        compValue = emitCall("llvm.amdgcn.interp.mov", Type::getFloatTy(*m_context), args, attribs, interpInsertPos);
+        if (shareInterp)
+          sharedValue = compValue;
+      }
 
       // Two int8s are also packed like 16-bit in a 32-bit channel in previous export stage
       if (bitWidth == 8 || bitWidth == 16) {
@@ -2456,7 +2715,7 @@ Value *PatchInOutImportExport::patchFsBuiltInInputImport(Type *inputTy, unsigned
   case BuiltInBaryCoordSmoothCentroid: {
     assert(entryArgIdxs.perspInterp.centroid != 0);
     input = adjustCentroidIj(getFunctionArgument(m_entryPoint, entryArgIdxs.perspInterp.centroid),
-                             getFunctionArgument(m_entryPoint, entryArgIdxs.perspInterp.center), insertPos);
+                             getFunctionArgument(m_entryPoint, entryArgIdxs.perspInterp.center));
     break;
   }
   case BuiltInInterpPullMode:
@@ -2481,7 +2740,7 @@ Value *PatchInOutImportExport::patchFsBuiltInInputImport(Type *inputTy, unsigned
   case BuiltInBaryCoordNoPerspCentroid: {
     assert(entryArgIdxs.linearInterp.centroid != 0);
     input = adjustCentroidIj(getFunctionArgument(m_entryPoint, entryArgIdxs.linearInterp.centroid),
-                             getFunctionArgument(m_entryPoint, entryArgIdxs.linearInterp.center), insertPos);
+                             getFunctionArgument(m_entryPoint, entryArgIdxs.linearInterp.center));
     break;
   }
   case BuiltInSamplePosOffset: {
@@ -2518,7 +2777,7 @@ Value *PatchInOutImportExport::getSamplePosOffset(Type *inputTy, Value *sampleId
   Value *sampleValid = builder.CreateICmpUGT(numSamples, sampleId);
   Value *offset = builder.CreateSelect(sampleValid, validOffset, builder.getInt32(0));
   // Load sample position descriptor.
-  Value *desc = m_pipelineSysValues.get(m_entryPoint)->loadDescFromDriverTable(SiDrvTableSamplepos, builder);
+  Value *desc = m_pipelineSysValues.get(m_entryPoint)->getSamplePosDesc();
   // Load the value using the descriptor.
   offset = builder.CreateShl(offset, builder.getInt32(4));
   return builder.CreateIntrinsic(Intrinsic::amdgcn_raw_buffer_load, inputTy,
@@ -2618,13 +2877,20 @@ Value *PatchInOutImportExport::patchCsBuiltInInputImport(Type *inputTy, unsigned
 // @param inputTy : Type of GlobalInvocationId
 // @param insertPos : Insert position
 Value *PatchInOutImportExport::getGlobalInvocationId(Type *inputTy, Instruction *insertPos) {
+  // gl_GlobalInvocationID = gl_WorkGroupID * gl_WorkGroupSize + gl_LocalInvocationID, done per dimension so each
+  // one can be folded for its constant workgroup size.
   IRBuilder<> builder(*m_context);
   builder.SetInsertPoint(insertPos);
-  Value *workgroupSize = patchCsBuiltInInputImport(inputTy, BuiltInWorkgroupSize, insertPos);
+  auto &mode = m_pipelineState->getShaderModes()->getComputeShaderMode();
+  const unsigned workgroupSizes[] = {mode.workgroupSizeX, mode.workgroupSizeY, mode.workgroupSizeZ};
   Value *workgroupId = patchCsBuiltInInputImport(inputTy, BuiltInWorkgroupId, insertPos);
   Value *localInvocationId = patchCsBuiltInInputImport(inputTy, BuiltInLocalInvocationId, insertPos);
-  Value *input = builder.CreateMul(workgroupSize, workgroupId);
-  input = builder.CreateAdd(input, localInvocationId);
+  Value *input = UndefValue::get(inputTy);
+  for (unsigned dim = 0; dim != 3; ++dim) {
+    Value *component = combineWorkgroupIndex(builder.CreateExtractElement(workgroupId, dim), workgroupSizes[dim],
+                                             builder.CreateExtractElement(localInvocationId, dim), builder);
+    input = builder.CreateInsertElement(input, component, dim);
+  }
   return input;
 }
 
@@ -2634,15 +2900,18 @@ Value *PatchInOutImportExport::getGlobalInvocationId(Type *inputTy, Instruction
 // @param inputTy : Type of LocalInvocationIndex
 // @param insertPos : Insert position
 Value *PatchInOutImportExport::getLocalInvocationIndex(Type *inputTy, Instruction *insertPos) {
+  // gl_LocalInvocationIndex = (gl_LocalInvocationID.z * gl_WorkGroupSize.y + gl_LocalInvocationID.y) *
+  //                           gl_WorkGroupSize.x + gl_LocalInvocationID.x
+  // Dimensions of size 1 are dropped, so a 1D workgroup just uses gl_LocalInvocationID.x.
   IRBuilder<> builder(*m_context);
   builder.SetInsertPoint(insertPos);
-  Value *workgroupSize = patchCsBuiltInInputImport(inputTy, BuiltInWorkgroupSize, insertPos);
+  auto &mode = m_pipelineState->getShaderModes()->getComputeShaderMode();
   Value *localInvocationId = patchCsBuiltInInputImport(inputTy, BuiltInLocalInvocationId, insertPos);
-  Value *input = builder.CreateMul(builder.CreateExtractElement(workgroupSize, 1),
-                                   builder.CreateExtractElement(localInvocationId, 2));
-  input = builder.CreateAdd(input, builder.CreateExtractElement(localInvocationId, 1));
-  input = builder.CreateMul(builder.CreateExtractElement(workgroupSize, uint64_t(0)), input);
-  input = builder.CreateAdd(input, builder.CreateExtractElement(localInvocationId, uint64_t(0)));
+  Value *input = builder.CreateExtractElement(localInvocationId, 2);
+  input = combineWorkgroupIndex(input, mode.workgroupSizeY, builder.CreateExtractElement(localInvocationId, 1),
+                                builder);
+  input = combineWorkgroupIndex(input, mode.workgroupSizeX,
+                                builder.CreateExtractElement(localInvocationId, uint64_t(0)), builder);
   return input;
 }
 
@@ -2655,11 +2924,34 @@ Value *PatchInOutImportExport::getSubgroupId(Type *inputTy, Instruction *insertP
   // gl_SubgroupID = gl_LocationInvocationIndex / gl_SubgroupSize
   IRBuilder<> builder(*m_context);
   builder.SetInsertPoint(insertPos);
-  Value *localInvocationIndex = patchCsBuiltInInputImport(inputTy, BuiltInLocalInvocationIndex, insertPos);
   unsigned subgroupSize = m_pipelineState->getShaderWaveSize(m_shaderStage);
+  auto &mode = m_pipelineState->getShaderModes()->getComputeShaderMode();
+  if (mode.workgroupSizeX * mode.workgroupSizeY * mode.workgroupSizeZ <= subgroupSize) {
+    // The whole workgroup is in one subgroup.
+    return builder.getInt32(0);
+  }
+  Value *localInvocationIndex = patchCsBuiltInInputImport(inputTy, BuiltInLocalInvocationIndex, insertPos);
   return builder.CreateLShr(localInvocationIndex, builder.getInt32(Log2_32(subgroupSize)));
 }
 
+// =====================================================================================================================
+// Combine an index in an outer workgroup dimension with an index in an inner dimension of constant size, giving
+// outerIndex * innerSize + innerIndex. As innerIndex is known to be less than innerSize, the multiply and add
+// become a shift and an OR for a power-of-two size, and a dimension of size 1 is dropped entirely.
+//
+// @param outerIndex : Index in the outer dimension
+// @param innerSize : Size of the inner dimension
+// @param innerIndex : Index in the inner dimension, less than innerSize
+// @param builder : IRBuilder to insert instructions with
+Value *PatchInOutImportExport::combineWorkgroupIndex(Value *outerIndex, unsigned innerSize, Value *innerIndex,
+                                                     IRBuilder<> &builder) {
+  if (innerSize == 1)
+    return outerIndex;
+  if (isPowerOf2_32(innerSize))
+    return builder.CreateOr(builder.CreateShl(outerIndex, Log2_32(innerSize)), innerIndex);
+  return builder.CreateAdd(builder.CreateMul(outerIndex, builder.getInt32(innerSize)), innerIndex);
+}
+
 // =====================================================================================================================
 // Patches import calls for built-in outputs of tessellation control shader.
 //
@@ -3063,6 +3355,18 @@ void PatchInOutImportExport::patchTcsBuiltInOutputExport(Value *output, unsigned
         tessFactors.push_back(output);
       }
 
+      // Record whether the patch is culled: any outer factor is zero or less, or NaN.
+      if (!elemIdx && !m_tcsPatchCulled) {
+        Value *culled = nullptr;
+        for (Value *tessFactor : tessFactors) {
+          Value *factorCulled = new FCmpInst(insertPos, FCmpInst::FCMP_ULE, tessFactor,
+                                             ConstantFP::get(tessFactor->getType(), 0.0));
+          culled = culled ? BinaryOperator::CreateOr(culled, factorCulled, "", insertPos) : factorCulled;
+        }
+        m_tcsPatchCulled = cast<Instruction>(culled);
+      } else
+        m_tcsCullUnsafe = true;
+
       Value *tessFactorOffset = calcTessFactorOffset(true, elemIdx, insertPos);
       storeTessFactorToBuffer(tessFactors, tessFactorOffset, insertPos);
 
@@ -3442,11 +3746,6 @@ void PatchInOutImportExport::patchXfbOutputExport(Value *output, unsigned xfbBuf
   assert(m_shaderStage == ShaderStageVertex || m_shaderStage == ShaderStageTessEval ||
          m_shaderStage == ShaderStageCopyShader);
 
-  Value *streamOutBufDesc = m_pipelineSysValues.get(m_entryPoint)->getStreamOutBufDesc(xfbBuffer);
-
-  const auto &xfbStrides = m_pipelineState->getShaderResourceUsage(m_shaderStage)->inOutUsage.xfbStrides;
-  unsigned xfbStride = xfbStrides[xfbBuffer];
-
   auto outputTy = output->getType();
   unsigned compCount = outputTy->isVectorTy() ? cast<VectorType>(outputTy)->getNumElements() : 1;
   unsigned bitWidth = outputTy->getScalarSizeInBits();
@@ -3462,45 +3761,27 @@ void PatchInOutImportExport::patchXfbOutputExport(Value *output, unsigned xfbBuf
   }
   assert(bitWidth == 16 || bitWidth == 32);
 
-  if (compCount == 8) {
-    // vec8 -> vec4 + vec4
-    assert(bitWidth == 32);
-
-    Constant *shuffleMask0123[] = {
-        ConstantInt::get(Type::getInt32Ty(*m_context), 0), ConstantInt::get(Type::getInt32Ty(*m_context), 1),
-        ConstantInt::get(Type::getInt32Ty(*m_context), 2), ConstantInt::get(Type::getInt32Ty(*m_context), 3)};
-    Value *compX4 = new ShuffleVectorInst(output, output, ConstantVector::get(shuffleMask0123), "", insertPos);
-
-    storeValueToStreamOutBuffer(compX4, xfbBuffer, xfbOffset, xfbStride, streamOutBufDesc, insertPos);
-
-    Constant *shuffleMask4567[] = {
-        ConstantInt::get(Type::getInt32Ty(*m_context), 4), ConstantInt::get(Type::getInt32Ty(*m_context), 5),
-        ConstantInt::get(Type::getInt32Ty(*m_context), 6), ConstantInt::get(Type::getInt32Ty(*m_context), 7)};
-    compX4 = new ShuffleVectorInst(output, output, ConstantVector::get(shuffleMask4567), "", insertPos);
-
-    xfbOffset += 4 * (bitWidth / 8);
-    storeValueToStreamOutBuffer(compX4, xfbBuffer, xfbOffset, xfbStride, streamOutBufDesc, insertPos);
-  } else if (compCount == 6) {
-    // vec6 -> vec4 + vec2
-    assert(bitWidth == 32);
-
-    // NOTE: This case is generated by copy shader, which casts 64-bit outputs to float.
-    Constant *shuffleMask0123[] = {
-        ConstantInt::get(Type::getInt32Ty(*m_context), 0), ConstantInt::get(Type::getInt32Ty(*m_context), 1),
-        ConstantInt::get(Type::getInt32Ty(*m_context), 2), ConstantInt::get(Type::getInt32Ty(*m_context), 3)};
-    Value *compX4 = new ShuffleVectorInst(output, output, ConstantVector::get(shuffleMask0123), "", insertPos);
+  if (bitWidth == 32) {
+    // NOTE: 32-bit outputs are split into dwords whose stores are delayed. Dwords of the same vertex that are adjacent
+    // in a transform feedback buffer are then combined into one store, no matter which outputs they come from.
+    for (unsigned i = 0; i < compCount; ++i) {
+      Value *comp = output;
+      if (outputTy->isVectorTy())
+        comp = ExtractElementInst::Create(output, ConstantInt::get(Type::getInt32Ty(*m_context), i), "", insertPos);
+      if (!comp->getType()->isFloatTy())
+        comp = new BitCastInst(comp, Type::getFloatTy(*m_context), "", insertPos);
+      m_xfbOutputDwords.push_back({xfbBuffer, xfbOffset + i * 4, comp, insertPos});
+    }
+    return;
+  }
 
-    storeValueToStreamOutBuffer(compX4, xfbBuffer, xfbOffset, xfbStride, streamOutBufDesc, insertPos);
+  Value *streamOutBufDesc = m_pipelineSysValues.get(m_entryPoint)->getStreamOutBufDesc(xfbBuffer);
 
-    Constant *shuffleMask45[] = {ConstantInt::get(Type::getInt32Ty(*m_context), 4),
-                                 ConstantInt::get(Type::getInt32Ty(*m_context), 5)};
-    Value *compX2 = new ShuffleVectorInst(output, output, ConstantVector::get(shuffleMask45), "", insertPos);
+  const auto &xfbStrides = m_pipelineState->getShaderResourceUsage(m_shaderStage)->inOutUsage.xfbStrides;
+  unsigned xfbStride = xfbStrides[xfbBuffer];
 
-    xfbOffset += 4 * (bitWidth / 8);
-    storeValueToStreamOutBuffer(compX2, xfbBuffer, xfbOffset, xfbStride, streamOutBufDesc, insertPos);
-  } else if (compCount == 3) {
+  if (compCount == 3) {
     // 16vec3 -> 16vec2 + 16scalar
-    // vec3 -> vec2 + scalar
     Constant *shuffleMask01[] = {ConstantInt::get(Type::getInt32Ty(*m_context), 0),
                                  ConstantInt::get(Type::getInt32Ty(*m_context), 1)};
     Value *compX2 = new ShuffleVectorInst(output, output, ConstantVector::get(shuffleMask01), "", insertPos);
@@ -3513,7 +3794,6 @@ void PatchInOutImportExport::patchXfbOutputExport(Value *output, unsigned xfbBuf
     storeValueToStreamOutBuffer(comp, xfbBuffer, xfbOffset, xfbStride, streamOutBufDesc, insertPos);
   } else {
     // 16vec4, 16vec2, 16scalar
-    // vec4, vec2, scalar
     if (outputTy->isVectorTy() && compCount == 1) {
       // NOTE: We translate vec1 to scalar. SPIR-V translated from DX has such usage.
       output = ExtractElementInst::Create(output, ConstantInt::get(Type::getInt32Ty(*m_context), 0), "", insertPos);
@@ -3523,6 +3803,61 @@ void PatchInOutImportExport::patchXfbOutputExport(Value *output, unsigned xfbBuf
   }
 }
 
+// =====================================================================================================================
+// Stores the delayed 32-bit transform feedback outputs to stream-out buffers. Dwords that are adjacent in the same
+// buffer and exported in the same block are combined into one store of up to 4 dwords.
+void PatchInOutImportExport::storeXfbOutputDwords() {
+  if (m_xfbOutputDwords.empty())
+    return;
+
+  // Group the dwords by block and buffer, ordered by offset. Since the exports are visited in order, a later export of
+  // the same dword overrides an earlier one, and the last export of a group is where all of its dwords are available.
+  using XfbDwordGroup = std::pair<std::map<unsigned, Value *>, Instruction *>;
+  MapVector<std::pair<BasicBlock *, unsigned>, XfbDwordGroup> dwordGroups;
+  for (const auto &dword : m_xfbOutputDwords) {
+    auto &dwordGroup = dwordGroups[{dword.insertPos->getParent(), dword.xfbBuffer}];
+    dwordGroup.first[dword.xfbOffset] = dword.value;
+    dwordGroup.second = dword.insertPos;
+  }
+  m_xfbOutputDwords.clear();
+
+  const auto &xfbStrides = m_pipelineState->getShaderResourceUsage(m_shaderStage)->inOutUsage.xfbStrides;
+  for (auto &dwordGroup : dwordGroups) {
+    const unsigned xfbBuffer = dwordGroup.first.second;
+    const auto &dwords = dwordGroup.second.first;
+    Instruction *insertPos = dwordGroup.second.second;
+    Value *streamOutBufDesc = m_pipelineSysValues.get(m_entryPoint)->getStreamOutBufDesc(xfbBuffer);
+
+    for (auto dwordIt = dwords.begin(); dwordIt != dwords.end();) {
+      // Collect up to 4 contiguous dwords
+      const unsigned xfbOffset = dwordIt->first;
+      SmallVector<Value *, 4> storeComps;
+      while (dwordIt != dwords.end() && storeComps.size() < 4 && dwordIt->first == xfbOffset + storeComps.size() * 4) {
+        storeComps.push_back(dwordIt->second);
+        ++dwordIt;
+      }
+
+      // GFX6 does not support 3-component combination
+      if (m_gfxIp.major == 6 && storeComps.size() == 3) {
+        storeComps.pop_back();
+        --dwordIt;
+      }
+
+      Value *storeValue = storeComps[0];
+      if (storeComps.size() > 1) {
+        storeValue = UndefValue::get(FixedVectorType::get(Type::getFloatTy(*m_context), storeComps.size()));
+        for (unsigned i = 0; i < storeComps.size(); ++i) {
+          storeValue = InsertElementInst::Create(storeValue, storeComps[i],
+                                                 ConstantInt::get(Type::getInt32Ty(*m_context), i), "", insertPos);
+        }
+      }
+
+      storeValueToStreamOutBuffer(storeValue, xfbBuffer, xfbOffset, xfbStrides[xfbBuffer], streamOutBufDesc,
+                                  insertPos);
+    }
+  }
+}
+
 // =====================================================================================================================
 // Creates the LLPC intrinsic "llpc.streamoutbuffer.store.f32" to store value to to stream-out buffer.
 //
@@ -3624,6 +3959,12 @@ void PatchInOutImportExport::createStreamOutBufferStoreFunction(Value *storeValu
     callName += bitWidth == 32 ? "v2f32" : "v2f16";
     break;
   }
+  case 3: {
+    assert(bitWidth == 32);
+    formatOprd.bits.dfmt = BUF_DATA_FORMAT_32_32_32;
+    callName += "v3f32";
+    break;
+  }
   case 4: {
     formatOprd.bits.dfmt = bitWidth == 32 ? BUF_DATA_FORMAT_32_32_32_32 : BUF_DATA_FORMAT_16_16_16_16;
     callName += bitWidth == 32 ? "v4f32" : "v4f16";
@@ -3640,6 +3981,8 @@ void PatchInOutImportExport::createStreamOutBufferStoreFunction(Value *storeValu
   if (m_gfxIp.major >= 10) {
     if (compCount == 4)
       format = bitWidth == 32 ? BUF_FORMAT_32_32_32_32_FLOAT : BUF_FORMAT_16_16_16_16_FLOAT;
+    else if (compCount == 3)
+      format = BUF_FORMAT_32_32_32_FLOAT;
     else if (compCount == 2)
       format = bitWidth == 32 ? BUF_FORMAT_32_32_FLOAT : BUF_FORMAT_16_16_FLOAT;
     else if (compCount == 1)
@@ -3846,6 +4189,30 @@ void PatchInOutImportExport::storeValueToStreamOutBuffer(Value *storeValue, unsi
     storeValue = new BitCastInst(storeValue, bitCastTy, "", insertPos);
   }
 
+  initStreamOutVertexInfo();
+  assert(xfbBuffer < MaxTransformFeedbackBuffers);
+  assert(m_streamOutOffsets[xfbBuffer]);
+
+  std::string funcName = lgcName::StreamOutBufferStore;
+  createStreamOutBufferStoreFunction(storeValue, xfbStride, funcName);
+
+  Value *args[] = {storeValue,
+                   streamOutBufDesc,
+                   m_streamOutWriteIndex,
+                   m_threadId,
+                   m_streamOutVertexCount,
+                   ConstantInt::get(Type::getInt32Ty(*m_context), xfbOffset),
+                   m_streamOutOffsets[xfbBuffer]};
+  emitCall(funcName, Type::getVoidTy(*m_context), args, {}, insertPos);
+}
+
+// =====================================================================================================================
+// Computes the stream-out values of this vertex (valid vertex count, write index and buffer offsets) once, at the start
+// of the entry-point, so that all stores to stream-out buffers share them.
+void PatchInOutImportExport::initStreamOutVertexInfo() {
+  if (m_streamOutVertexCount)
+    return;
+
   const auto &entryArgIdxs = m_pipelineState->getShaderInterfaceData(m_shaderStage)->entryArgIdxs;
 
   unsigned streamOffsets[MaxTransformFeedbackBuffers] = {};
@@ -3875,33 +4242,29 @@ void PatchInOutImportExport::storeValueToStreamOutBuffer(Value *storeValue, unsi
     }
   }
 
-  assert(xfbBuffer < MaxTransformFeedbackBuffers);
-  assert(streamOffsets[xfbBuffer] != 0);
-
-  auto streamOffset = getFunctionArgument(m_entryPoint, streamOffsets[xfbBuffer]);
+  // NOTE: Thread ID is calculated at the start of the entry-point. The stream-out values are placed right after it.
+  assert(m_threadId);
+  Instruction *insertPos = cast<Instruction>(m_threadId)->getNextNode();
 
-  streamOffset =
-      BinaryOperator::CreateMul(streamOffset, ConstantInt::get(Type::getInt32Ty(*m_context), 4), "", insertPos);
+  for (unsigned i = 0; i < MaxTransformFeedbackBuffers; ++i) {
+    if (streamOffsets[i] != 0) {
+      m_streamOutOffsets[i] =
+          BinaryOperator::CreateMul(getFunctionArgument(m_entryPoint, streamOffsets[i]),
+                                    ConstantInt::get(Type::getInt32Ty(*m_context), 4), "", insertPos);
+    }
+  }
 
   // vertexCount = streamInfo[22:16]
   Value *ubfeArgs[] = {getFunctionArgument(m_entryPoint, streamInfo),
                        ConstantInt::get(Type::getInt32Ty(*m_context), 16),
                        ConstantInt::get(Type::getInt32Ty(*m_context), 7)};
-  Value *vertexCount = emitCall("llvm.amdgcn.ubfe.i32", Type::getInt32Ty(*m_context), ubfeArgs, {}, &*insertPos);
+  m_streamOutVertexCount = emitCall("llvm.amdgcn.ubfe.i32", Type::getInt32Ty(*m_context), ubfeArgs, {}, insertPos);
 
   // Setup write index for stream-out
-  auto writeIndexVal = getFunctionArgument(m_entryPoint, writeIndex);
+  m_streamOutWriteIndex = getFunctionArgument(m_entryPoint, writeIndex);
 
   if (m_gfxIp.major >= 9)
-    writeIndexVal = BinaryOperator::CreateAdd(writeIndexVal, m_threadId, "", insertPos);
-
-  std::string funcName = lgcName::StreamOutBufferStore;
-  createStreamOutBufferStoreFunction(storeValue, xfbStride, funcName);
-
-  Value *args[] = {storeValue,  streamOutBufDesc, writeIndexVal,
-                   m_threadId,  vertexCount,      ConstantInt::get(Type::getInt32Ty(*m_context), xfbOffset),
-                   streamOffset};
-  emitCall(funcName, Type::getVoidTy(*m_context), args, {}, insertPos);
+    m_streamOutWriteIndex = BinaryOperator::CreateAdd(m_streamOutWriteIndex, m_threadId, "", insertPos);
 }
 
 // =====================================================================================================================
@@ -4359,6 +4722,10 @@ Value *PatchInOutImportExport::readValueFromLds(bool isOutput, Type *readTy, Val
   const bool isTcsOutput = (isOutput && m_shaderStage == ShaderStageTessControl);
   const bool isTesInput = (!isOutput && m_shaderStage == ShaderStageTessEval);
 
+  // A TCS that reads back its outputs may read them for a culled patch, so their stores can not be skipped.
+  if (isTcsOutput)
+    m_tcsCullUnsafe = true;
+
   if (m_pipelineState->isTessOffChip() && (isTcsOutput || isTesInput)) // Read from off-chip LDS buffer
   {
     const auto &offChipLdsBaseArgIdx =
@@ -4394,20 +4761,36 @@ Value *PatchInOutImportExport::readValueFromLds(bool isOutput, Type *readTy, Val
     }
   } else // Read from on-chip LDS
   {
-    for (unsigned i = 0; i < numChannels; ++i) {
+    // NOTE: Contiguous dwords are read with one vector load of up to four dwords, so that the backend can select
+    // ds_read2_b32, ds_read_b64/b96/b128 instead of one ds_read_b32 per component.
+    for (unsigned i = 0, combineCount = 0; i < numChannels; i += combineCount) {
+      combineCount = std::min(numChannels - i, MaxLdsCombineDwords);
+
       Value *idxs[] = {ConstantInt::get(Type::getInt32Ty(*m_context), 0), ldsOffset};
       Value *loadPtr = GetElementPtrInst::Create(nullptr, m_lds, idxs, "", insertPos);
-      auto loadTy = loadPtr->getType()->getPointerElementType();
-      auto loadInst = new LoadInst(loadTy, loadPtr, "", false, m_lds->getAlign().getValue(), insertPos);
-      loadValues[i] = loadInst;
+      Type *loadTy = Type::getInt32Ty(*m_context);
+      if (combineCount > 1) {
+        loadTy = FixedVectorType::get(loadTy, combineCount);
+        loadPtr = new BitCastInst(loadPtr, PointerType::get(loadTy, m_lds->getType()->getPointerAddressSpace()), "",
+                                  insertPos);
+      }
+      Value *loadValue = new LoadInst(loadTy, loadPtr, "", false, m_lds->getAlign().getValue(), insertPos);
 
-      if (bitWidth == 8)
-        loadValues[i] = new TruncInst(loadValues[i], Type::getInt8Ty(*m_context), "", insertPos);
-      else if (bitWidth == 16)
-        loadValues[i] = new TruncInst(loadValues[i], Type::getInt16Ty(*m_context), "", insertPos);
+      for (unsigned j = 0; j < combineCount; ++j) {
+        loadValues[i + j] = loadValue;
+        if (combineCount > 1) {
+          loadValues[i + j] =
+              ExtractElementInst::Create(loadValue, ConstantInt::get(Type::getInt32Ty(*m_context), j), "", insertPos);
+        }
+
+        if (bitWidth == 8)
+          loadValues[i + j] = new TruncInst(loadValues[i + j], Type::getInt8Ty(*m_context), "", insertPos);
+        else if (bitWidth == 16)
+          loadValues[i + j] = new TruncInst(loadValues[i + j], Type::getInt16Ty(*m_context), "", insertPos);
+      }
 
-      ldsOffset =
-          BinaryOperator::CreateAdd(ldsOffset, ConstantInt::get(Type::getInt32Ty(*m_context), 1), "", insertPos);
+      ldsOffset = BinaryOperator::CreateAdd(ldsOffset, ConstantInt::get(Type::getInt32Ty(*m_context), combineCount),
+                                            "", insertPos);
     }
   }
 
@@ -4491,13 +4874,27 @@ void PatchInOutImportExport::writeValueToLds(Value *writeValue, Value *ldsOffset
     }
   } else // Write to on-chip LDS
   {
-    for (unsigned i = 0; i < numChannels; ++i) {
+    // NOTE: Contiguous dwords are written with one vector store of up to four dwords, mirroring readValueFromLds().
+    for (unsigned i = 0, combineCount = 0; i < numChannels; i += combineCount) {
+      combineCount = std::min(numChannels - i, MaxLdsCombineDwords);
+
       Value *idxs[] = {ConstantInt::get(Type::getInt32Ty(*m_context), 0), ldsOffset};
       Value *storePtr = GetElementPtrInst::Create(nullptr, m_lds, idxs, "", insertPos);
-      new StoreInst(storeValues[i], storePtr, false, m_lds->getAlign().getValue(), insertPos);
+      Value *storeValue = storeValues[i];
+      if (combineCount > 1) {
+        auto storeTy = FixedVectorType::get(Type::getInt32Ty(*m_context), combineCount);
+        storePtr = new BitCastInst(storePtr, PointerType::get(storeTy, m_lds->getType()->getPointerAddressSpace()), "",
+                                   insertPos);
+        storeValue = UndefValue::get(storeTy);
+        for (unsigned j = 0; j < combineCount; ++j) {
+          storeValue = InsertElementInst::Create(storeValue, storeValues[i + j],
+                                                 ConstantInt::get(Type::getInt32Ty(*m_context), j), "", insertPos);
+        }
+      }
+      new StoreInst(storeValue, storePtr, false, m_lds->getAlign().getValue(), insertPos);
 
-      ldsOffset =
-          BinaryOperator::CreateAdd(ldsOffset, ConstantInt::get(Type::getInt32Ty(*m_context), 1), "", insertPos);
+      ldsOffset = BinaryOperator::CreateAdd(ldsOffset, ConstantInt::get(Type::getInt32Ty(*m_context), combineCount),
+                                            "", insertPos);
     }
   }
 }
@@ -5037,8 +5434,11 @@ unsigned PatchInOutImportExport::calcPatchCountPerThreadGroup(unsigned inVertexC
   const unsigned outPatchSize = (outVertexCount * outVertexStride);
   const unsigned patchConstSize = patchConstCount * 4;
 
-  // Compute the required LDS size per patch, always include the space for VS vertex out
+  // Compute the required LDS size per patch, always include the space for VS vertex out. In on-chip mode the TCS
+  // output vertices and patch constants live in LDS as well.
   unsigned ldsSizePerPatch = inPatchSize;
+  if (!m_pipelineState->isTessOffChip())
+    ldsSizePerPatch += outPatchSize + patchConstSize;
   unsigned patchCountLimitedByLds =
       (m_pipelineState->getTargetInfo().getGpuProperty().ldsSizePerThreadGroup / ldsSizePerPatch);
 
@@ -5081,6 +5481,11 @@ unsigned PatchInOutImportExport::calcPatchCountPerThreadGroup(unsigned inVertexC
     patchCountPerThreadGroup = std::min(patchCountPerThreadGroup, offChipTfBufferPatchCountLimit);
   }
 
+  if (cl::TessOccupancyPatchCount) {
+    patchCountPerThreadGroup = calcOccupancyPatchCount(patchCountPerThreadGroup, ldsSizePerPatch,
+                                                       std::max(inVertexCount, outVertexCount));
+  }
+
   // Adjust the patches-per-thread-group based on hardware workarounds.
   if (m_pipelineState->getTargetInfo().getGpuWorkarounds().gfx6.miscLoadBalancePerWatt != 0) {
     const unsigned waveSize = m_pipelineState->getTargetInfo().getGpuProperty().waveSize;
@@ -5106,6 +5511,41 @@ unsigned PatchInOutImportExport::calcPatchCountPerThreadGroup(unsigned inVertexC
   return patchCountPerThreadGroup;
 }
 
+// =====================================================================================================================
+// Chooses the patch count per thread group, no larger than the given limit, that maximizes the number of patches
+// resident on a CU. The per-group LDS allocation is rounded up to the hardware granularity, so a slightly smaller
+// group can let one more group fit in the CU's LDS; the wave slots of the CU cap the number of groups as well.
+//
+// @param patchCountLimit : Upper bound of patch count per thread group from the other limits
+// @param ldsSizePerPatch : LDS allocated per patch (in dwords)
+// @param threadCountPerPatch : HS threads per patch
+unsigned PatchInOutImportExport::calcOccupancyPatchCount(unsigned patchCountLimit, unsigned ldsSizePerPatch,
+                                                         unsigned threadCountPerPatch) const {
+  const auto &gpuProperty = m_pipelineState->getTargetInfo().getGpuProperty();
+  const unsigned waveSize = m_pipelineState->getShaderWaveSize(m_shaderStage);
+  const unsigned ldsGranularity = 1U << gpuProperty.ldsSizeDwordGranularityShift;
+  const unsigned ldsSizePerCu = gpuProperty.ldsSizePerCu / 4;
+
+  // NOTE: GFX10 has two SIMD32s per CU, each running up to 20 wave32s or 10 wave64s. Earlier hardware has four SIMDs
+  // per CU, each running up to 10 waves.
+  const unsigned simdsPerCu = m_gfxIp.major >= 10 ? 2 : 4;
+  const unsigned maxWavesPerCu = simdsPerCu * (m_gfxIp.major >= 10 && waveSize == 32 ? 20 : 10);
+
+  unsigned bestPatchCount = patchCountLimit;
+  unsigned bestResidentPatchCount = 0;
+  for (unsigned patchCount = patchCountLimit; patchCount > 0; --patchCount) {
+    const unsigned ldsSize = alignTo(std::max(patchCount * ldsSizePerPatch, 1U), ldsGranularity);
+    const unsigned wavesPerGroup = alignTo(patchCount * threadCountPerPatch, waveSize) / waveSize;
+    const unsigned groupsPerCu = std::max(std::min(ldsSizePerCu / ldsSize, maxWavesPerCu / wavesPerGroup), 1U);
+    // Prefer the larger group on a tie: fewer groups to launch for the same residency.
+    if (groupsPerCu * patchCount > bestResidentPatchCount) {
+      bestResidentPatchCount = groupsPerCu * patchCount;
+      bestPatchCount = patchCount;
+    }
+  }
+  return bestPatchCount;
+}
+
 // =====================================================================================================================
 // Inserts "exp" instruction to export generic output.
 //
@@ -5433,20 +5873,24 @@ void PatchInOutImportExport::addExportInstForBuiltInOutput(Value *output, unsign
 //
 // @param centroidIj : Centroid I/J provided by hardware natively
 // @param centerIj : Center I/J provided by hardware natively
-// @param insertPos : Where to insert this call
-Value *PatchInOutImportExport::adjustCentroidIj(Value *centroidIj, Value *centerIj, Instruction *insertPos) {
+Value *PatchInOutImportExport::adjustCentroidIj(Value *centroidIj, Value *centerIj) {
+  // NOTE: The adjusted I/J only depends on entry-point arguments, so it is computed once at the start of the
+  // entry-point and shared by all its users.
+  Value *&ij = m_adjustedCentroidIjs[centroidIj];
+  if (ij)
+    return ij;
+
   auto &entryArgIdxs = m_pipelineState->getShaderInterfaceData(ShaderStageFragment)->entryArgIdxs.fs;
   auto primMask = getFunctionArgument(m_entryPoint, entryArgIdxs.primMask);
   auto &builtInUsage = m_pipelineState->getShaderResourceUsage(ShaderStageFragment)->builtInUsage.fs;
-  Value *ij = nullptr;
 
   if (builtInUsage.centroid && builtInUsage.center) {
     // NOTE: If both centroid and center are enabled, centroid I/J provided by hardware natively may be invalid. We have
     // to adjust it with center I/J on condition of bc_optimize flag. bc_optimize = pPrimMask[31], when bc_optimize is
     // on, pPrimMask is less than zero
-    auto cond =
-        new ICmpInst(insertPos, ICmpInst::ICMP_SLT, primMask, ConstantInt::get(Type::getInt32Ty(*m_context), 0), "");
-    ij = SelectInst::Create(cond, centerIj, centroidIj, "", insertPos);
+    auto cond = new ICmpInst(m_fsInterpInsertPos, ICmpInst::ICMP_SLT, primMask,
+                             ConstantInt::get(Type::getInt32Ty(*m_context), 0), "");
+    ij = SelectInst::Create(cond, centerIj, centroidIj, "", m_fsInterpInsertPos);
   } else
     ij = centroidIj;
 
@@ -5480,12 +5924,29 @@ WorkgroupLayout PatchInOutImportExport::calculateWorkgroupLayout() {
   if (m_shaderStage == ShaderStageCompute) {
     bool reconfig = false;
 
+    auto &mode = m_pipelineState->getShaderModes()->getComputeShaderMode();
     switch (static_cast<WorkgroupLayout>(resUsage.builtInUsage.cs.workgroupLayout)) {
     case WorkgroupLayout::Unknown:
-      // If no configuration has been specified, apply a reconfigure if the compute shader uses images and the
-      // pipeline option was enabled.
-      if (resUsage.useImages)
-        reconfig = m_pipelineState->getOptions().reconfigWorkgroupLayout;
+      // If no configuration has been specified, the shader option decides.
+      switch (m_pipelineState->getShaderOptions(ShaderStageCompute).workgroupSwizzle) {
+      case WorkgroupSwizzle::Default:
+        // Apply a reconfigure if the compute shader uses images and the pipeline option was enabled.
+        if (resUsage.useImages)
+          reconfig = m_pipelineState->getOptions().reconfigWorkgroupLayout;
+        break;
+      case WorkgroupSwizzle::Auto:
+        // Apply a reconfigure to a 2D workgroup of at least 8x8 threads that uses images, as neighboring threads
+        // then tend to access neighboring texels, and a wave covering a tile rather than a row or two hits in the
+        // texture cache more often.
+        reconfig = resUsage.useImages && mode.workgroupSizeX >= 8 && mode.workgroupSizeY >= 8;
+        break;
+      case WorkgroupSwizzle::Enable:
+        reconfig = true;
+        break;
+      case WorkgroupSwizzle::Disable:
+        reconfig = false;
+        break;
+      }
       break;
     case WorkgroupLayout::Linear:
       // The hardware by default applies the linear rules, so just ban reconfigure and we're done.
@@ -5502,7 +5963,6 @@ WorkgroupLayout PatchInOutImportExport::calculateWorkgroupLayout() {
     }
 
     if (reconfig) {
-      auto &mode = m_pipelineState->getShaderModes()->getComputeShaderMode();
       if ((mode.workgroupSizeX % 2) == 0 && (mode.workgroupSizeY % 2) == 0) {
         if ((mode.workgroupSizeX > 8 && mode.workgroupSizeY >= 8) ||
             (mode.workgroupSizeX >= 8 && mode.workgroupSizeY > 8)) {
@@ -36,8 +36,12 @@
 #include "lgc/state/PipelineShaders.h"
 #include "lgc/state/PipelineState.h"
 #include "lgc/state/TargetInfo.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/InstVisitor.h"
+#include <map>
 #include <set>
+#include <tuple>
 
 namespace lgc {
 
@@ -53,7 +57,7 @@ public:
   void getAnalysisUsage(llvm::AnalysisUsage &analysisUsage) const override {
     analysisUsage.addRequired<PipelineStateWrapper>();
     analysisUsage.addRequired<PipelineShaders>();
-    analysisUsage.addPreserved<PipelineShaders>();
+    // PipelineShaders is not preserved, as the pass may replace the fragment shader entry-point.
   }
 
   bool runOnModule(llvm::Module &module) override;
@@ -70,6 +74,10 @@ private:
 
   void processShader();
 
+  void returnFsColorExports();
+  void addFsDemoteEarlyExits();
+  void skipCulledPatchOutputStores();
+
   llvm::Value *patchTcsGenericInputImport(llvm::Type *inputTy, unsigned location, llvm::Value *locOffset,
                                           llvm::Value *compIdx, llvm::Value *vertexIdx, llvm::Instruction *insertPos);
   llvm::Value *patchTesGenericInputImport(llvm::Type *inputTy, unsigned location, llvm::Value *locOffset,
@@ -109,6 +117,8 @@ private:
   llvm::Value *getGlobalInvocationId(llvm::Type *inputTy, llvm::Instruction *insertPos);
   llvm::Value *getLocalInvocationIndex(llvm::Type *inputTy, llvm::Instruction *insertPos);
   llvm::Value *getSubgroupId(llvm::Type *inputTy, llvm::Instruction *insertPos);
+  llvm::Value *combineWorkgroupIndex(llvm::Value *outerIndex, unsigned innerSize, llvm::Value *innerIndex,
+                                     llvm::IRBuilder<> &builder);
 
   llvm::Value *patchTcsBuiltInOutputImport(llvm::Type *outputTy, unsigned builtInId, llvm::Value *elemIdx,
                                            llvm::Value *vertexIdx, llvm::Instruction *insertPos);
@@ -129,6 +139,8 @@ private:
 
   void storeValueToStreamOutBuffer(llvm::Value *storeValue, unsigned xfbBuffer, unsigned xfbOffset, unsigned xfbStride,
                                    llvm::Value *streamOutBufDesc, llvm::Instruction *insertPos);
+  void storeXfbOutputDwords();
+  void initStreamOutVertexInfo();
 
   void createStreamOutBufferStoreFunction(llvm::Value *storeValue, unsigned xfbStrde, std::string &funcName);
 
@@ -172,6 +184,8 @@ private:
   unsigned calcPatchCountPerThreadGroup(unsigned inVertexCount, unsigned inVertexStride, unsigned outVertexCount,
                                         unsigned outVertexStride, unsigned patchConstCount,
                                         unsigned tessFactorStride) const;
+  unsigned calcOccupancyPatchCount(unsigned patchCountLimit, unsigned ldsSizePerPatch,
+                                   unsigned threadCountPerPatch) const;
 
   llvm::Value *calcLdsOffsetForVsOutput(llvm::Type *outputTy, unsigned location, unsigned compIdx,
                                         llvm::Instruction *insertPos);
@@ -189,7 +203,7 @@ private:
                                      llvm::Instruction *insertPos);
   void addExportInstForBuiltInOutput(llvm::Value *output, unsigned builtInId, llvm::Instruction *insertPos);
 
-  llvm::Value *adjustCentroidIj(llvm::Value *centroidIj, llvm::Value *centerIj, llvm::Instruction *insertPos);
+  llvm::Value *adjustCentroidIj(llvm::Value *centroidIj, llvm::Value *centerIj);
 
   llvm::Value *getSubgroupLocalInvocationId(llvm::Instruction *insertPos);
 
@@ -206,6 +220,15 @@ private:
 
   llvm::CallInst *m_lastExport; // Last "export" intrinsic for which "done" flag is valid
 
+  // FS "ret" instructions, each with the color outputs to return to the color export shader in its place
+  llvm::SmallVector<std::pair<llvm::ReturnInst *, llvm::Value *>, 1> m_colorExportReturns;
+
+  // Whether the TCS patch is culled, as computed from the one whole-array write of gl_TessLevelOuter
+  llvm::Instruction *m_tcsPatchCulled;
+  // Whether the TCS writes gl_TessLevelOuter other than once as a whole array, or reads back its own outputs, so that
+  // its off-chip output stores can not be skipped for culled patches
+  bool m_tcsCullUnsafe;
+
   llvm::Value *m_clipDistance; // Correspond to "out float gl_ClipDistance[]"
   llvm::Value *m_cullDistance; // Correspond to "out float gl_CullDistance[]"
   llvm::Value *m_primitiveId;  // Correspond to "out int gl_PrimitiveID"
@@ -226,6 +249,28 @@ private:
   llvm::GlobalVariable *m_lds; // Global variable to model LDS
   llvm::Value *m_threadId;     // Thread ID
 
+  // Transform feedback output dword, whose store to stream-out buffer is delayed so that it can be combined with
+  // adjacent dwords of the same buffer and vertex
+  struct XfbOutputDword {
+    unsigned xfbBuffer;           // Transform feedback buffer ID
+    unsigned xfbOffset;           // Byte offset of the dword in the vertex
+    llvm::Value *value;           // Dword value (float)
+    llvm::Instruction *insertPos; // Export call of the dword
+  };
+  std::vector<XfbOutputDword> m_xfbOutputDwords; // Transform feedback output dwords to store
+
+  // Key of an interpolated FS input channel: <I/J ("flat" and "custom": null), "interp.mov" parameter ("smooth" and
+  // "noperspective": InvalidValue), attribute location, attribute channel, 16-bit half (32-bit: 0, low: 1, high: 2)>
+  using FsInterpKey = std::tuple<llvm::Value *, unsigned, unsigned, unsigned, unsigned>;
+  std::map<FsInterpKey, llvm::Value *> m_fsInterpValues;             // Interpolated FS input channels to share
+  llvm::DenseMap<llvm::Value *, llvm::Value *> m_adjustedCentroidIjs; // Adjusted centroid I/J, keyed by centroid I/J
+  llvm::Instruction *m_fsInterpInsertPos;                            // Where to place shared FS interpolation
+
+  // Stream-out values of this vertex, shared by all stores to stream-out buffers
+  llvm::Value *m_streamOutVertexCount;                          // Valid vertex count of stream-out
+  llvm::Value *m_streamOutWriteIndex;                           // Write index of this vertex
+  llvm::Value *m_streamOutOffsets[MaxTransformFeedbackBuffers]; // Buffer offsets (in bytes) of stream-out
+
   std::vector<llvm::Value *> m_expFragColors[MaxColorTargets]; // Exported fragment colors
   std::vector<llvm::CallInst *> m_importCalls;                 // List of "call" instructions to import inputs
   std::vector<llvm::CallInst *> m_exportCalls;                 // List of "call" instructions to export outputs
@@ -0,0 +1,333 @@
+/*
+ ***********************************************************************************************************************
+ *
+ *  Copyright (c) 2020 Advanced Micro Devices, Inc. All Rights Reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ **********************************************************************************************************************/
+/**
+ ***********************************************************************************************************************
+ * @file  PatchLdsLayout.cpp
+ * @brief LLPC source file: contains declaration and implementation of class lgc::PatchLdsLayout.
+ ***********************************************************************************************************************
+ */
+#include "lgc/patch/Patch.h"
+#include "lgc/state/IntrinsDefs.h"
+#include "lgc/state/PipelineState.h"
+#include "lgc/state/ShaderStage.h"
+#include "lgc/state/TargetInfo.h"
+#include "lgc/util/Debug.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/CFG.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/IntrinsicsAMDGPU.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/Format.h"
+#include <algorithm>
+
+#define DEBUG_TYPE "lgc-patch-lds-layout"
+
+using namespace lgc;
+using namespace llvm;
+
+// -pack-lds-variables: pack the workgroup variables of a compute shader into one LDS block
+static cl::opt<bool> PackLdsVariables("pack-lds-variables",
+                                      cl::desc("Pack the workgroup variables of a compute shader into one LDS block, "
+                                               "sorted by alignment and size, overlapping variables that are "
+                                               "separated by a barrier"),
+                                      cl::init(false));
+
+namespace lgc {
+
+// =====================================================================================================================
+// Pass to lay out the workgroup (LDS) variables of a compute shader.
+//
+// The backend allocates LDS globals one after the other, in the order it meets them, padding each to its alignment.
+// This pass replaces them with a single global, laid out with the most aligned and largest variables first so there is
+// no padding between them. Two variables share storage when every access to one is finished at a barrier that comes
+// before every access to the other.
+class PatchLdsLayout : public Patch {
+public:
+  static char ID;
+  PatchLdsLayout() : Patch(ID) {}
+
+  void getAnalysisUsage(AnalysisUsage &analysisUsage) const override {
+    analysisUsage.addRequired<PipelineStateWrapper>();
+  }
+
+  bool runOnModule(Module &module) override;
+
+private:
+  // A workgroup variable and where it ends up in the packed block.
+  struct LdsVariable {
+    GlobalVariable *global;
+    unsigned size;
+    unsigned alignment;
+    unsigned offset;
+    bool isAnalyzable;                      // Whether all accesses are known and in the entry-point
+    SmallVector<Instruction *, 8> accesses; // Instructions accessing the variable
+  };
+
+  void collectAccesses(LdsVariable &variable);
+  bool isDeadAfterBarrier(const LdsVariable &deadVariable, const LdsVariable &liveVariable);
+  bool canShare(const LdsVariable &variable1, const LdsVariable &variable2);
+  void report(ArrayRef<LdsVariable> variables, unsigned packedSize);
+
+  PatchLdsLayout(const PatchLdsLayout &) = delete;
+  PatchLdsLayout &operator=(const PatchLdsLayout &) = delete;
+
+  PipelineState *m_pipelineState = nullptr; // Pipeline state
+  std::unique_ptr<DominatorTree> m_domTree; // Dominator tree of the entry-point
+  SmallVector<Instruction *, 8> m_barriers; // Barriers in the entry-point
+};
+
+char PatchLdsLayout::ID = 0;
+
+} // namespace lgc
+
+// =====================================================================================================================
+// Create the pass that lays out the workgroup variables of a compute shader.
+ModulePass *lgc::createPatchLdsLayout() {
+  return new PatchLdsLayout();
+}
+
+// =====================================================================================================================
+// Run the pass on the specified LLVM module.
+//
+// @param [in,out] module : LLVM module to be run on
+bool PatchLdsLayout::runOnModule(Module &module) {
+  LLVM_DEBUG(dbgs() << "Run the pass Patch-Lds-Layout\n");
+
+  if (!PackLdsVariables)
+    return false;
+
+  Patch::init(&module);
+  m_pipelineState = getAnalysis<PipelineStateWrapper>().getPipelineState(&module);
+
+  for (Function &func : module) {
+    if (!func.isDeclaration() && getShaderStage(&func) == ShaderStageCompute) {
+      m_entryPoint = &func;
+      break;
+    }
+  }
+  if (!m_entryPoint)
+    return false;
+
+  const DataLayout &dataLayout = module.getDataLayout();
+  SmallVector<LdsVariable, 8> variables;
+  for (GlobalVariable &global : module.globals()) {
+    if (global.getType()->getPointerAddressSpace() != ADDR_SPACE_LOCAL || global.user_empty())
+      continue;
+    LdsVariable variable = {};
+    variable.global = &global;
+    variable.size = dataLayout.getTypeAllocSize(global.getValueType());
+    variable.alignment = dataLayout.getPreferredAlign(&global).value();
+    variables.push_back(variable);
+  }
+  if (variables.size() < 2)
+    return false;
+
+  m_domTree = std::make_unique<DominatorTree>(*m_entryPoint);
+  m_barriers.clear();
+  for (BasicBlock &block : *m_entryPoint) {
+    for (Instruction &inst : block) {
+      if (auto intrinsic = dyn_cast<IntrinsicInst>(&inst)) {
+        if (intrinsic->getIntrinsicID() == Intrinsic::amdgcn_s_barrier)
+          m_barriers.push_back(intrinsic);
+      }
+    }
+  }
+  for (LdsVariable &variable : variables)
+    collectAccesses(variable);
+
+  // Most aligned first, then largest first, so each variable starts aligned without padding. Keep declaration order
+  // for ties so the layout is deterministic.
+  std::stable_sort(variables.begin(), variables.end(), [](const LdsVariable &lhs, const LdsVariable &rhs) {
+    if (lhs.alignment != rhs.alignment)
+      return lhs.alignment > rhs.alignment;
+    return lhs.size > rhs.size;
+  });
+
+  // Give each variable the lowest aligned offset that does not overlap a variable already placed that it cannot share
+  // storage with.
+  unsigned packedSize = 0;
+  unsigned packedAlignment = 1;
+  for (unsigned idx = 0; idx != variables.size(); ++idx) {
+    LdsVariable &variable = variables[idx];
+    SmallVector<std::pair<unsigned, unsigned>, 8> occupied;
+    for (unsigned otherIdx = 0; otherIdx != idx; ++otherIdx) {
+      const LdsVariable &other = variables[otherIdx];
+      if (!canShare(variable, other))
+        occupied.push_back({other.offset, other.offset + other.size});
+    }
+    llvm::sort(occupied);
+    unsigned offset = 0;
+    for (const auto &range : occupied) {
+      if (offset + variable.size <= range.first)
+        break;
+      offset = std::max(offset, unsigned(alignTo(range.second, variable.alignment)));
+    }
+    variable.offset = offset;
+    packedSize = std::max(packedSize, offset + variable.size);
+    packedAlignment = std::max(packedAlignment, variable.alignment);
+  }
+
+  // Replace the variables with pointers into one packed global.
+  Type *int8Ty = Type::getInt8Ty(*m_context);
+  auto packedTy = ArrayType::get(int8Ty, packedSize);
+  auto packed = new GlobalVariable(module, packedTy, false, GlobalValue::ExternalLinkage, UndefValue::get(packedTy),
+                                   "lds.packed", nullptr, GlobalValue::NotThreadLocal, ADDR_SPACE_LOCAL);
+  packed->setAlignment(MaybeAlign(packedAlignment));
+  Constant *base = ConstantExpr::getBitCast(packed, int8Ty->getPointerTo(ADDR_SPACE_LOCAL));
+  for (const LdsVariable &variable : variables) {
+    Constant *offset = ConstantInt::get(Type::getInt32Ty(*m_context), variable.offset);
+    Constant *pointer = ConstantExpr::getInBoundsGetElementPtr(int8Ty, base, offset);
+    pointer = ConstantExpr::getBitCast(pointer, variable.global->getType());
+    variable.global->replaceAllUsesWith(pointer);
+  }
+
+  report(variables, packedSize);
+
+  for (const LdsVariable &variable : variables)
+    variable.global->eraseFromParent();
+  m_domTree.reset();
+  return true;
+}
+
+// =====================================================================================================================
+// Collect the instructions accessing a workgroup variable, following the pointers derived from it. The variable is
+// left not analyzable if its address escapes, or it is used outside the entry-point.
+//
+// @param [in,out] variable : Workgroup variable
+void PatchLdsLayout::collectAccesses(LdsVariable &variable) {
+  variable.isAnalyzable = true;
+  SmallVector<Value *, 8> pointers;
+  SmallPtrSet<Value *, 16> visited;
+  pointers.push_back(variable.global);
+  while (!pointers.empty()) {
+    Value *pointer = pointers.pop_back_val();
+    for (User *user : pointer->users()) {
+      if (!visited.insert(user).second)
+        continue;
+      if (auto constExpr = dyn_cast<ConstantExpr>(user)) {
+        pointers.push_back(constExpr);
+        continue;
+      }
+      auto inst = dyn_cast<Instruction>(user);
+      if (!inst || inst->getFunction() != m_entryPoint) {
+        variable.isAnalyzable = false;
+        return;
+      }
+      if (isa<GetElementPtrInst>(inst) || isa<BitCastInst>(inst) || isa<PHINode>(inst) || isa<SelectInst>(inst))
+        pointers.push_back(inst);
+      else if (isa<LoadInst>(inst) || isa<AtomicRMWInst>(inst) || isa<AtomicCmpXchgInst>(inst) ||
+               isa<IntrinsicInst>(inst))
+        variable.accesses.push_back(inst);
+      else if (auto storeInst = dyn_cast<StoreInst>(inst)) {
+        if (storeInst->getValueOperand() == pointer) {
+          variable.isAnalyzable = false;
+          return;
+        }
+        variable.accesses.push_back(inst);
+      } else {
+        variable.isAnalyzable = false;
+        return;
+      }
+    }
+  }
+}
+
+// =====================================================================================================================
+// Check whether there is a barrier that comes before every access to one variable, and after which the other variable
+// is never accessed again. All invocations of the workgroup wait at the barrier, so once any of them is past it, all
+// the accesses to the dead variable are finished and its storage can be reused.
+//
+// @param deadVariable : Variable that must not be accessed after the barrier
+// @param liveVariable : Variable that must only be accessed after the barrier
+bool PatchLdsLayout::isDeadAfterBarrier(const LdsVariable &deadVariable, const LdsVariable &liveVariable) {
+  for (Instruction *barrier : m_barriers) {
+    bool isBefore = all_of(liveVariable.accesses, [&](Instruction *access) {
+      return m_domTree->dominates(barrier, access);
+    });
+    if (!isBefore)
+      continue;
+    bool isDead = none_of(deadVariable.accesses, [&](Instruction *access) {
+      return isPotentiallyReachable(barrier, access, nullptr, m_domTree.get());
+    });
+    if (isDead)
+      return true;
+  }
+  return false;
+}
+
+// =====================================================================================================================
+// Check whether two workgroup variables can share storage.
+//
+// @param variable1 : First variable
+// @param variable2 : Second variable
+bool PatchLdsLayout::canShare(const LdsVariable &variable1, const LdsVariable &variable2) {
+  if (!variable1.isAnalyzable || !variable2.isAnalyzable)
+    return false;
+  return isDeadAfterBarrier(variable1, variable2) || isDeadAfterBarrier(variable2, variable1);
+}
+
+// =====================================================================================================================
+// Report the packed layout, and how many workgroups fit in a CU with the LDS it needs.
+//
+// @param variables : Workgroup variables, with their offsets
+// @param packedSize : Size of the packed block in bytes
+void PatchLdsLayout::report(ArrayRef<LdsVariable> variables, unsigned packedSize) {
+  const auto &gpuProperty = m_pipelineState->getTargetInfo().getGpuProperty();
+  const unsigned granularity = sizeof(unsigned) << gpuProperty.ldsSizeDwordGranularityShift;
+
+  // The size without packing is what the backend allocates for the variables in declaration order.
+  unsigned unpackedSize = 0;
+  for (const GlobalVariable &global : m_module->globals()) {
+    for (const LdsVariable &variable : variables) {
+      if (variable.global == &global)
+        unpackedSize = alignTo(unpackedSize, variable.alignment) + variable.size;
+    }
+  }
+
+  LLPC_OUTS("===============================================================================\n");
+  LLPC_OUTS("// LLPC compute shader LDS layout (in bytes)\n\n");
+  for (const LdsVariable &variable : variables) {
+    LLPC_OUTS(format("%-40s : offset = 0x%04" PRIX32 ", size = 0x%04" PRIX32 ", align = %u%s",
+                     variable.global->getName().str().c_str(), variable.offset, variable.size, variable.alignment,
+                     variable.isAnalyzable ? "" : " (not overlappable)")
+              << "\n");
+  }
+
+  auto groupsPerCu = [&](unsigned size) {
+    return gpuProperty.ldsSizePerCu / unsigned(alignTo(std::max(size, 1U), granularity));
+  };
+  LLPC_OUTS("LDS size: " << unpackedSize << " -> " << packedSize << "\n");
+  LLPC_OUTS("Workgroups per CU limited by LDS: " << groupsPerCu(unpackedSize) << " -> " << groupsPerCu(packedSize)
+                                                  << "\n\n");
+}
+
+// =====================================================================================================================
+// Initializes the pass
+INITIALIZE_PASS(PatchLdsLayout, DEBUG_TYPE, "Patch LLVM for compute shader LDS layout", false, false)
@@ -32,6 +32,7 @@
 #include "lgc/patch/Patch.h"
 #include "lgc/state/IntrinsDefs.h"
 #include "lgc/state/PipelineState.h"
+#include "lgc/state/ShaderStage.h"
 #include "lgc/util/Internal.h"
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/IR/Constants.h"
@@ -59,6 +60,8 @@ public:
   bool runOnModule(Module &module) override;
 
 private:
+  bool generateNullFragShader(Module &module, PipelineState *pipelineState);
+
   PatchNullFragShader(const PatchNullFragShader &) = delete;
   PatchNullFragShader &operator=(const PatchNullFragShader &) = delete;
 };
@@ -84,9 +87,18 @@ bool PatchNullFragShader::runOnModule(Module &module) {
 
   PipelineState *pipelineState = getAnalysis<PipelineStateWrapper>().getPipelineState(&module);
 
-  // Do not add a null fragment shader if generating an unlinked half-pipeline ELF.
-  if (pipelineState->isUnlinked())
-    return false;
+  if (pipelineState->isUnlinked()) {
+    // When generating an unlinked half-pipeline ELF, only add a null fragment shader if the front-end asked for a
+    // fragment-only compile without supplying a fragment shader. That ELF stands in for the fragment half when a
+    // depth-only pipeline is linked.
+    if (pipelineState->getShaderStageMask() != shaderStageToMask(ShaderStageFragment))
+      return false;
+    for (const Function &func : module) {
+      if (!func.isDeclaration() && getShaderStage(&func) == ShaderStageFragment)
+        return false;
+    }
+    return generateNullFragShader(module, pipelineState);
+  }
 
   const bool hasCs = pipelineState->hasShaderStage(ShaderStageCompute);
   const bool hasVs = pipelineState->hasShaderStage(ShaderStageVertex);
@@ -99,6 +111,15 @@ bool PatchNullFragShader::runOnModule(Module &module) {
     return false;
   }
 
+  return generateNullFragShader(module, pipelineState);
+}
+
+// =====================================================================================================================
+// Generate the null fragment shader and record its resource usage.
+//
+// @param [in,out] module : LLVM module to add the null fragment shader to
+// @param pipelineState : Pipeline state
+bool PatchNullFragShader::generateNullFragShader(Module &module, PipelineState *pipelineState) {
   // Create the null fragment shader:
   // define void @llpc.shader.FS.null() !spirv.ExecutionModel !5
   // {
@@ -76,6 +76,7 @@ private:
   void addAbiMetadata(Module &module);
 
   void setConstantGlobalSection(Module &module);
+  bool isUsedByNonFragmentStage(const GlobalVariable *global) const;
 
   PipelineState *m_pipelineState;     // Pipeline state
   PipelineShaders *m_pipelineShaders; // API shaders in the pipeline
@@ -349,13 +350,48 @@ void PatchPreparePipelineAbi::addAbiMetadata(Module &module) {
 // name to ".text", as the PAL pipeline ABI requires constant data to be in the same section as the code. For
 // shader/half-pipeline compilation, we leave it as default, which (after an LLVM change) puts the constant data
 // into the .rodata section.
+//
+// For full pipeline compilation of a graphics pipeline with a fragment shader, constant data that a non-fragment
+// shader stage reads is also given a name with NonFragmentConstantPrefix and a symbol in the ELF. The data follows the
+// fragment shader at the end of .text, so this tells the front-end that it must be kept in place when the fragment
+// shader is replaced by one from the shader cache.
 void PatchPreparePipelineAbi::setConstantGlobalSection(Module &module) {
   if (m_pipelineState->isUnlinked())
     return;
+  bool markNonFragmentConstants =
+      m_pipelineState->isGraphics() && m_pipelineState->hasShaderStage(ShaderStageFragment);
   for (GlobalVariable &global : module.globals()) {
-    if (global.getAddressSpace() == ADDR_SPACE_CONST)
-      global.setSection(".text");
+    if (global.getAddressSpace() != ADDR_SPACE_CONST)
+      continue;
+    global.setSection(".text");
+    if (markNonFragmentConstants && isUsedByNonFragmentStage(&global)) {
+      global.setName(Twine(NonFragmentConstantPrefix) + global.getName());
+      if (global.hasPrivateLinkage())
+        global.setLinkage(GlobalValue::InternalLinkage);
+    }
+  }
+}
+
+// =====================================================================================================================
+// Check whether a global variable is read by any shader stage other than the fragment shader. A use in a function
+// that is not known to belong to the fragment shader, such as a merged shader, counts as a non-fragment use.
+//
+// @param global : Global variable
+bool PatchPreparePipelineAbi::isUsedByNonFragmentStage(const GlobalVariable *global) const {
+  SmallVector<const Value *, 4> vals;
+  vals.push_back(global);
+  for (unsigned i = 0; i != vals.size(); ++i) {
+    for (const User *user : vals[i]->users()) {
+      if (isa<Constant>(user)) {
+        vals.push_back(user);
+        continue;
+      }
+      auto inst = dyn_cast<Instruction>(user);
+      if (!inst || getShaderStage(inst->getFunction()) != ShaderStageFragment)
+        return true;
+    }
   }
+  return false;
 }
 
 // =====================================================================================================================
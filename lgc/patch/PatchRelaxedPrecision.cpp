@@ -0,0 +1,304 @@
+/*
+ ***********************************************************************************************************************
+ *
+ *  Copyright (c) 2020 Advanced Micro Devices, Inc. All Rights Reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ **********************************************************************************************************************/
+/**
+ ***********************************************************************************************************************
+ * @file  PatchRelaxedPrecision.cpp
+ * @brief LLPC source file: contains implementation of class lgc::PatchRelaxedPrecision.
+ ***********************************************************************************************************************
+ */
+#include "PatchRelaxedPrecision.h"
+#include "lgc/Builder.h"
+#include "llvm/ADT/EquivalenceClasses.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/InitializePasses.h"
+#include "llvm/Support/Debug.h"
+
+#define DEBUG_TYPE "lgc-patch-relaxed-precision"
+
+using namespace lgc;
+using namespace llvm;
+
+namespace lgc {
+
+// =====================================================================================================================
+// Define static members (no initializer needed as LLVM only cares about the address of ID, never its value).
+char PatchRelaxedPrecision::ID;
+
+// =====================================================================================================================
+// Pass creator, creates the pass of LLVM patching operations for computing relaxed precision arithmetic in 16 bits.
+FunctionPass *createPatchRelaxedPrecision() {
+  return new PatchRelaxedPrecision();
+}
+
+// =====================================================================================================================
+PatchRelaxedPrecision::PatchRelaxedPrecision() : FunctionPass(ID) {
+}
+
+// =====================================================================================================================
+// Get the analysis usage of this pass.
+//
+// @param [out] analysisUsage : The analysis usage.
+void PatchRelaxedPrecision::getAnalysisUsage(AnalysisUsage &analysisUsage) const {
+  analysisUsage.setPreservesCFG();
+}
+
+// =====================================================================================================================
+// Executes this LLVM pass on the specified LLVM function.
+//
+// The front-end marks 32-bit float arithmetic that only needs relaxed precision with metadata. Such operations that
+// feed each other form a chain, and a chain is computed in half precision if it has enough operations to pay for
+// converting its 32-bit inputs and outputs. Converting a constant, or a value that was extended from half, is free.
+// Later passes fold the conversions between demoted operations, and the SLP vectorizer packs pairs of half operations
+// into v2f16 operations, which map to packed math (v_pk_*) on GFX9+.
+//
+// @param [in,out] function : Function that will run this optimization.
+bool PatchRelaxedPrecision::runOnFunction(Function &function) {
+  if (function.isDeclaration())
+    return false;
+
+  LLVM_DEBUG(dbgs() << "Run the pass Patch-Relaxed-Precision\n");
+
+  m_relaxedPrecisionKindId = function.getContext().getMDKindID(RelaxedPrecisionMetadataName);
+
+  // Collect the candidate operations in reverse post order, so that an operation comes after its operands.
+  SmallVector<Instruction *, 64> candidates;
+  EquivalenceClasses<Instruction *> chainClasses;
+  ReversePostOrderTraversal<Function *> rpot(&function);
+  for (BasicBlock *block : rpot) {
+    for (Instruction &inst : *block) {
+      if (isCandidate(&inst)) {
+        candidates.push_back(&inst);
+        chainClasses.insert(&inst);
+      }
+    }
+  }
+  if (candidates.empty())
+    return false;
+
+  // Group the candidate operations into chains connected by def-use edges.
+  for (Instruction *inst : candidates) {
+    for (Value *operand : inst->operands()) {
+      auto operandInst = dyn_cast<Instruction>(operand);
+      if (operandInst && chainClasses.findValue(operandInst) != chainClasses.end())
+        chainClasses.unionSets(inst, operandInst);
+    }
+  }
+
+  // Collect the operations of each chain in that order, so that each one is demoted after its operands.
+  DenseMap<Instruction *, unsigned> chainIndices;
+  SmallVector<SmallVector<Instruction *, 8>, 8> chains;
+  for (Instruction *inst : candidates) {
+    auto inserted = chainIndices.insert({chainClasses.getLeaderValue(inst), chains.size()});
+    if (inserted.second)
+      chains.emplace_back();
+    chains[inserted.first->second].push_back(inst);
+  }
+
+  bool changed = false;
+  m_halfValues.clear();
+  for (const auto &chain : chains) {
+    if (!isProfitable(chain))
+      continue;
+    demoteChain(chain);
+    changed = true;
+  }
+  m_halfValues.clear();
+  return changed;
+}
+
+// =====================================================================================================================
+// Check whether an instruction is 32-bit float arithmetic marked as only needing relaxed precision.
+//
+// @param inst : Instruction to check
+bool PatchRelaxedPrecision::isCandidate(Instruction *inst) const {
+  if (!inst->getType()->getScalarType()->isFloatTy() || !inst->getMetadata(m_relaxedPrecisionKindId))
+    return false;
+
+  switch (inst->getOpcode()) {
+  case Instruction::FAdd:
+  case Instruction::FSub:
+  case Instruction::FMul:
+  case Instruction::FDiv:
+  case Instruction::FNeg:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// =====================================================================================================================
+// Check whether a 32-bit value read by a chain can be used in half precision without a conversion instruction: a
+// constant that fits in the half range, or a value that was extended from half.
+//
+// @param value : Value read by a chain
+bool PatchRelaxedPrecision::isFreeToDemote(Value *value) {
+  if (auto ext = dyn_cast<FPExtInst>(value))
+    return ext->getSrcTy()->getScalarType()->isHalfTy();
+
+  auto constant = dyn_cast<Constant>(value);
+  if (!constant)
+    return false;
+
+  auto fitsInHalf = [](Constant *element) {
+    auto constantFp = dyn_cast_or_null<ConstantFP>(element);
+    if (!constantFp)
+      return isa_and_nonnull<UndefValue>(element);
+    APFloat halfValue = constantFp->getValueAPF();
+    bool losesInfo = false;
+    APFloat::opStatus status = halfValue.convert(APFloat::IEEEhalf(), APFloat::rmNearestTiesToEven, &losesInfo);
+    return (status & APFloat::opOverflow) == 0;
+  };
+
+  auto vectorType = dyn_cast<FixedVectorType>(constant->getType());
+  if (!vectorType)
+    return fitsInHalf(constant);
+  for (unsigned i = 0; i < vectorType->getNumElements(); ++i) {
+    if (!fitsInHalf(constant->getAggregateElement(i)))
+      return false;
+  }
+  return true;
+}
+
+// =====================================================================================================================
+// Check whether computing a chain in half precision is worth the conversions it needs. Packed math runs two half
+// operations in the time of one 32-bit operation, so each conversion has to be paid for by two operations of the
+// chain. A 32-bit input read by several operations is converted once; a result read outside the chain needs an
+// extension, unless it is only truncated to half anyway.
+//
+// @param chain : Operations of the chain
+bool PatchRelaxedPrecision::isProfitable(ArrayRef<Instruction *> chain) {
+  SmallPtrSet<Instruction *, 16> members(chain.begin(), chain.end());
+  SmallPtrSet<Value *, 16> inputs;
+  unsigned conversionCount = 0;
+
+  for (Instruction *inst : chain) {
+    for (Value *operand : inst->operands()) {
+      auto operandInst = dyn_cast<Instruction>(operand);
+      if ((operandInst && members.count(operandInst)) || isFreeToDemote(operand))
+        continue;
+      if (inputs.insert(operand).second)
+        ++conversionCount;
+    }
+
+    for (User *user : inst->users()) {
+      auto userInst = cast<Instruction>(user);
+      if (members.count(userInst))
+        continue;
+      auto trunc = dyn_cast<FPTruncInst>(userInst);
+      if (trunc && trunc->getDestTy()->getScalarType()->isHalfTy())
+        continue;
+      ++conversionCount;
+      break;
+    }
+  }
+
+  return chain.size() >= 2 * conversionCount;
+}
+
+// =====================================================================================================================
+// Rewrite the operations of a chain as half operations. Each result is extended back to 32 bits for its users outside
+// the chain; the extensions only read by the chain are removed again.
+//
+// @param chain : Operations of the chain, each after its operands
+void PatchRelaxedPrecision::demoteChain(ArrayRef<Instruction *> chain) {
+  SmallVector<Instruction *, 16> extensions;
+  for (Instruction *inst : chain) {
+    IRBuilder<> builder(inst);
+    Value *halfValue = nullptr;
+    if (auto unaryOp = dyn_cast<UnaryOperator>(inst))
+      halfValue = builder.CreateUnOp(unaryOp->getOpcode(), getHalfValue(inst->getOperand(0)));
+    else {
+      halfValue = builder.CreateBinOp(cast<BinaryOperator>(inst)->getOpcode(), getHalfValue(inst->getOperand(0)),
+                                      getHalfValue(inst->getOperand(1)));
+    }
+    if (auto halfInst = dyn_cast<Instruction>(halfValue))
+      halfInst->copyIRFlags(inst);
+    halfValue->takeName(inst);
+
+    // Later operations of the chain read the half value through this extension (see getHalfValue).
+    Value *extension = builder.CreateFPExt(halfValue, inst->getType());
+    if (auto extensionInst = dyn_cast<Instruction>(extension))
+      extensions.push_back(extensionInst);
+    inst->replaceAllUsesWith(extension);
+    inst->eraseFromParent();
+  }
+
+  for (Instruction *extension : extensions) {
+    if (extension->use_empty())
+      extension->eraseFromParent();
+  }
+}
+
+// =====================================================================================================================
+// Get the half precision value of a 32-bit value read by a chain. A 32-bit value that is not free to convert is
+// truncated right after its definition, so that the truncation can be shared by every operation that reads it.
+//
+// @param value : 32-bit value
+Value *PatchRelaxedPrecision::getHalfValue(Value *value) {
+  if (auto ext = dyn_cast<FPExtInst>(value)) {
+    if (ext->getSrcTy()->getScalarType()->isHalfTy())
+      return ext->getOperand(0);
+  }
+
+  Type *halfType = getHalfType(value->getType());
+  if (auto constant = dyn_cast<Constant>(value))
+    return ConstantExpr::getFPTrunc(constant, halfType);
+
+  Value *&halfValue = m_halfValues[value];
+  if (!halfValue) {
+    Instruction *insertPos = nullptr;
+    if (auto inst = dyn_cast<Instruction>(value)) {
+      insertPos = isa<PHINode>(inst) ? &*inst->getParent()->getFirstInsertionPt() : inst->getNextNode();
+    } else {
+      BasicBlock &entryBlock = cast<Argument>(value)->getParent()->getEntryBlock();
+      insertPos = &*entryBlock.getFirstInsertionPt();
+    }
+    halfValue = IRBuilder<>(insertPos).CreateFPTrunc(value, halfType);
+  }
+  return halfValue;
+}
+
+// =====================================================================================================================
+// Get the half precision type of the same shape as a 32-bit float scalar or vector type.
+//
+// @param type : 32-bit float type
+Type *PatchRelaxedPrecision::getHalfType(Type *type) {
+  Type *halfType = Type::getHalfTy(type->getContext());
+  if (auto vectorType = dyn_cast<FixedVectorType>(type))
+    return FixedVectorType::get(halfType, vectorType->getNumElements());
+  return halfType;
+}
+
+} // namespace lgc
+
+// =====================================================================================================================
+// Initializes the pass of LLVM patching operations for computing relaxed precision arithmetic in 16 bits.
+INITIALIZE_PASS(PatchRelaxedPrecision, DEBUG_TYPE, "Patch LLVM for relaxed precision arithmetic in 16 bits", false,
+                false)
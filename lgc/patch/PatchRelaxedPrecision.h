@@ -0,0 +1,66 @@
+/*
+ ***********************************************************************************************************************
+ *
+ *  Copyright (c) 2020 Advanced Micro Devices, Inc. All Rights Reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ **********************************************************************************************************************/
+/**
+ ***********************************************************************************************************************
+ * @file  PatchRelaxedPrecision.h
+ * @brief LLPC header file: contains declaration of class lgc::PatchRelaxedPrecision.
+ ***********************************************************************************************************************
+ */
+#pragma once
+
+#include "lgc/patch/Patch.h"
+#include "llvm/ADT/DenseMap.h"
+
+namespace lgc {
+
+// =====================================================================================================================
+// Represents the pass of LLVM patching operations for computing relaxed precision float arithmetic in 16 bits. Chains
+// of 32-bit float operations marked with relaxed precision metadata are rewritten as half operations, with conversions
+// only where a chain reads or produces a 32-bit value.
+class PatchRelaxedPrecision final : public llvm::FunctionPass {
+public:
+  PatchRelaxedPrecision();
+
+  void getAnalysisUsage(llvm::AnalysisUsage &analysisUsage) const override;
+  bool runOnFunction(llvm::Function &function) override;
+
+  static char ID; // ID of this pass
+
+private:
+  PatchRelaxedPrecision(const PatchRelaxedPrecision &) = delete;
+  PatchRelaxedPrecision &operator=(const PatchRelaxedPrecision &) = delete;
+
+  bool isCandidate(llvm::Instruction *inst) const;
+  static bool isFreeToDemote(llvm::Value *value);
+  static bool isProfitable(llvm::ArrayRef<llvm::Instruction *> chain);
+  void demoteChain(llvm::ArrayRef<llvm::Instruction *> chain);
+  llvm::Value *getHalfValue(llvm::Value *value);
+  static llvm::Type *getHalfType(llvm::Type *type);
+
+  unsigned m_relaxedPrecisionKindId = 0;                     // Kind ID of the relaxed precision metadata
+  llvm::DenseMap<llvm::Value *, llvm::Value *> m_halfValues; // Half values of the 32-bit values read by chains
+};
+
+} // namespace lgc
@@ -39,10 +39,16 @@
 #include "lgc/state/PipelineState.h"
 #include "lgc/state/TargetInfo.h"
 #include "lgc/util/Debug.h"
+#include "llvm/ADT/SCCIterator.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/IntrinsicsAMDGPU.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/Local.h"
 #include <algorithm>
+#include <array>
 #include <functional>
 
 #define DEBUG_TYPE "lgc-patch-resource-collect"
@@ -53,6 +59,48 @@ using namespace lgc;
 // -disable-gs-onchip: disable geometry shader on-chip mode
 cl::opt<bool> DisableGsOnChip("disable-gs-onchip", cl::desc("Disable geometry shader on-chip mode"), cl::init(false));
 
+// -ngg-auto-culling-threshold: estimated cost of deferred vertex work from which automatic NGG culling is enabled
+static cl::opt<unsigned> NggAutoCullingThreshold("ngg-auto-culling-threshold",
+                                                 cl::desc("Estimated cost of the vertex work deferred until after "
+                                                          "culling, from which automatic NGG culling is enabled"),
+                                                 cl::init(64));
+
+// -eliminate-dead-outputs: remove generic output exports not read by the next shader stage before usage collection
+static cl::opt<bool> EliminateDeadOutputs("eliminate-dead-outputs",
+                                          cl::desc("Remove generic output exports not read by the next shader stage "
+                                                   "before collecting resource usage"),
+                                          cl::init(false));
+
+// -gs-emit-bound: analyze the vertices emitted along the GS control flow, to size the GS output rings from a proven
+// bound and to detect a GS that always emits exactly one primitive
+static cl::opt<bool> GsEmitBound("gs-emit-bound",
+                                 cl::desc("Size the GS output rings from the maximum number of vertices the GS can "
+                                          "emit along any path, when smaller than the declared max_vertices, and "
+                                          "detect a GS that always emits exactly one primitive"),
+                                 cl::init(true));
+
+// -propagate-const-outputs: substitute constant outputs of the last vertex processing stage into FS inputs
+static cl::opt<bool> PropagateConstOutputs("propagate-const-outputs",
+                                           cl::desc("Substitute generic outputs of the last vertex processing stage "
+                                                    "that are constant into the fragment shader inputs reading them"),
+                                           cl::init(false));
+
+// -ngg-auto-subgroup-sizing: choose the NGG subgroup size of NggSubgroupSizing::Auto from the shape of the pipeline
+static cl::opt<bool> NggAutoSubgroupSizing("ngg-auto-subgroup-sizing",
+                                           cl::desc("Choose the NGG subgroup size for automatic sizing from the "
+                                                    "primitive type, stages, culling and LDS footprint of the "
+                                                    "pipeline, instead of one fixed size"),
+                                           cl::init(true));
+
+// Name of the named metadata that records the inputs and result of automatic NGG culler selection
+static const char NggAutoCullingMetadataName[] = "lgc.ngg.auto.culling";
+
+// Name of the named metadata that records the result of automatic NGG subgroup sizing
+static const char NggAutoSubgroupSizingMetadataName[] = "lgc.ngg.auto.subgroup.sizing";
+
+// Estimated cost of computing and exporting one generic vertex attribute, in instructions
+static const unsigned NggAttribExportCost = 8;
+
 namespace lgc {
 
 // =====================================================================================================================
@@ -86,6 +134,11 @@ bool PatchResourceCollect::runOnModule(Module &module) {
   if (m_pipelineState->isPackInOut())
     scalarizeForInOutPacking(&module);
 
+  // Substitute constant outputs into the FS inputs reading them, before input usage is collected. The cache key of
+  // the FS does not cover the constants, so this is not done if stages are cached separately.
+  if (PropagateConstOutputs && !m_pipelineState->getOptions().separateStageCache)
+    propagateConstantOutputs(&module);
+
   // Process each shader stage, in reverse order.
   for (int shaderStage = ShaderStageCountInternal - 1; shaderStage >= 0; --shaderStage) {
     m_entryPoint = m_pipelineShaders->getEntryPoint(static_cast<ShaderStage>(shaderStage));
@@ -96,6 +149,10 @@ bool PatchResourceCollect::runOnModule(Module &module) {
   }
 
   if (m_pipelineState->isGraphics()) {
+    // Tighten the GS output vertex count before anything derives ring sizes from it
+    if (GsEmitBound && m_pipelineState->hasShaderStage(ShaderStageGeometry))
+      analyzeGsEmits(&module);
+
     // Set NGG control settings
     setNggControl(&module);
 
@@ -178,6 +235,8 @@ void PatchResourceCollect::setNggControl(Module *module) {
   nggControl.enableSphereCulling = (options.nggFlags & NggFlagEnableSphereCulling);
   nggControl.enableSmallPrimFilter = (options.nggFlags & NggFlagEnableSmallPrimFilter);
   nggControl.enableCullDistanceCulling = ((options.nggFlags & NggFlagEnableCullDistanceCulling) && useCullDistance);
+  if (enableNgg && (options.nggFlags & NggFlagEnableAutoCulling))
+    selectNggCullers(module, useCullDistance);
 
   nggControl.backfaceExponent = options.nggBackfaceExponent;
   nggControl.subgroupSizing = options.nggSubgroupSizing;
@@ -314,34 +373,121 @@ bool PatchResourceCollect::canUseNggCulling(Module *module) {
     return false; // No position export
 
   // Find position export call
+  auto callStage = hasGs ? ShaderStageGeometry : (hasTs ? ShaderStageTessEval : ShaderStageVertex);
+  CallInst *posCall = findPositionExport(module, callStage);
+  assert(posCall); // Position export must exist
+
+  // Check position value, disable NGG culling if it is constant
+  auto posValue = posCall->getArgOperand(posCall->getNumArgOperands() - 1); // Last argument is position value
+  if (isa<Constant>(posValue))
+    return false;
+
+  // We can safely enable NGG culling here
+  return true;
+}
+
+// =====================================================================================================================
+// Finds the position export call of the specified shader stage.
+//
+// @param [in/out] module : Module
+// @param shaderStage : Shader stage that exports the position
+// @returns : The position export call, or nullptr if there is none
+CallInst *PatchResourceCollect::findPositionExport(Module *module, ShaderStage shaderStage) {
   std::string posCallName = lgcName::OutputExportBuiltIn;
   posCallName += PipelineState::getBuiltInName(BuiltInPosition);
-  auto callStage = hasGs ? ShaderStageGeometry : (hasTs ? ShaderStageTessEval : ShaderStageVertex);
 
-  CallInst *posCall = nullptr;
   for (Function &func : *module) {
     if (func.getName().startswith(posCallName)) {
       for (User *user : func.users()) {
         auto call = cast<CallInst>(user);
-        if (m_pipelineShaders->getShaderStage(call->getFunction()) == callStage) {
-          posCall = call;
-          break;
-        }
+        if (m_pipelineShaders->getShaderStage(call->getFunction()) == shaderStage)
+          return call;
       }
-
-      if (posCall) // Already find the call
-        break;
     }
   }
-  assert(posCall); // Position export must exist
+  return nullptr;
+}
 
-  // Check position value, disable NGG culling if it is constant
-  auto posValue = posCall->getArgOperand(posCall->getNumArgOperands() - 1); // Last argument is position value
-  if (isa<Constant>(posValue))
-    return false;
+// =====================================================================================================================
+// Chooses the NGG cullers for NggFlagEnableAutoCulling, replacing the cullers selected by the enable flags.
+//
+// Culling pays off when the vertex work deferred until after culling, that is computing and exporting the attributes,
+// is large compared to the culling overhead. A shader that does little besides computing the position, as in a
+// low-vertex-count pass, is left in passthrough mode. The inputs and the result of the decision are recorded in the
+// lgc.ngg.auto.culling named metadata.
+//
+// @param [in/out] module : Module
+// @param useCullDistance : Whether the vertex-processing stage exports cull distances
+void PatchResourceCollect::selectNggCullers(Module *module, bool useCullDistance) {
+  NggControl &nggControl = *m_pipelineState->getNggControl();
+  nggControl.enableBackfaceCulling = false;
+  nggControl.enableFrustumCulling = false;
+  nggControl.enableBoxFilterCulling = false;
+  nggControl.enableSphereCulling = false;
+  nggControl.enableSmallPrimFilter = false;
+  nggControl.enableCullDistanceCulling = false;
+
+  // Only the vertex-processing stage without GS is modelled; with GS, the culling works on the GS output primitives.
+  if (m_pipelineState->hasShaderStage(ShaderStageGeometry))
+    return;
+  const bool hasTs =
+      m_pipelineState->hasShaderStage(ShaderStageTessControl) || m_pipelineState->hasShaderStage(ShaderStageTessEval);
+  ShaderStage shaderStage = hasTs ? ShaderStageTessEval : ShaderStageVertex;
+  CallInst *posCall = findPositionExport(module, shaderStage);
+  if (!posCall)
+    return;
 
-  // We can safely enable NGG culling here
-  return true;
+  // Count the instructions of the stage, and those of them that the position depends on.
+  Function *entryPoint = posCall->getFunction();
+  unsigned totalCost = 0;
+  for (BasicBlock &block : *entryPoint)
+    totalCost += block.size();
+
+  SmallVector<Instruction *, 32> worklist;
+  DenseSet<Instruction *> positionSlice;
+  if (auto posInst = dyn_cast<Instruction>(posCall->getArgOperand(posCall->getNumArgOperands() - 1)))
+    worklist.push_back(posInst);
+  while (!worklist.empty()) {
+    Instruction *inst = worklist.pop_back_val();
+    if (!positionSlice.insert(inst).second)
+      continue;
+    for (Value *operand : inst->operands()) {
+      if (auto operandInst = dyn_cast<Instruction>(operand))
+        worklist.push_back(operandInst);
+    }
+  }
+  const unsigned positionCost = positionSlice.size();
+
+  const unsigned attribCount = m_pipelineState->getShaderResourceUsage(shaderStage)->inOutUsage.outputMapLocCount;
+  const unsigned deferredCost = totalCost - std::min(totalCost, positionCost) + attribCount * NggAttribExportCost;
+
+  if (deferredCost >= NggAutoCullingThreshold) {
+    const auto &rsState = m_pipelineState->getRasterizerState();
+    // The backface culler reads the cull mode at run time, so it is only worth its cost if some face is culled.
+    nggControl.enableBackfaceCulling = rsState.cullMode != CullModeNone;
+    nggControl.enableFrustumCulling = true;
+    // A vertex-processing stage that does a lot of work suggests dense geometry, with many primitives that cover no
+    // sample. The filter is not used with multisampling, where such a primitive may still cover a sample.
+    nggControl.enableSmallPrimFilter = deferredCost >= 2 * NggAutoCullingThreshold && rsState.numSamples <= 1;
+    nggControl.enableCullDistanceCulling = useCullDistance;
+  }
+
+  LLPC_OUTS("NGG auto culling: position cost = " << positionCost << ", deferred cost = " << deferredCost
+                                                 << ", culling " << (nggControl.enableFrustumCulling ? "on" : "off")
+                                                 << "\n");
+
+  IRBuilder<> builder(module->getContext());
+  Metadata *values[] = {
+      ConstantAsMetadata::get(builder.getInt32(positionCost)),
+      ConstantAsMetadata::get(builder.getInt32(deferredCost)),
+      ConstantAsMetadata::get(builder.getInt32(nggControl.enableBackfaceCulling)),
+      ConstantAsMetadata::get(builder.getInt32(nggControl.enableFrustumCulling)),
+      ConstantAsMetadata::get(builder.getInt32(nggControl.enableSmallPrimFilter)),
+      ConstantAsMetadata::get(builder.getInt32(nggControl.enableCullDistanceCulling)),
+  };
+  NamedMDNode *namedMetaNode = module->getOrInsertNamedMetadata(NggAutoCullingMetadataName);
+  namedMetaNode->clearOperands();
+  namedMetaNode->addOperand(MDNode::get(module->getContext(), values));
 }
 
 // =====================================================================================================================
@@ -422,6 +568,244 @@ void PatchResourceCollect::buildNggCullingControlRegister(NggControl &nggControl
   pipelineState.paClVteCntl = paClVteCntl.u32All;
 }
 
+// =====================================================================================================================
+// Analyzes the GS_EMIT and GS_CUT messages along the paths through the GS control flow.
+//
+// The largest number of vertices emitted per stream in one invocation, or one more than the vertices emitted before an
+// output export if that is larger, is a proven bound; when it is smaller than the declared max_vertices, the geometry
+// mode's outputVertices is lowered to it. Everything that sizes or addresses the
+// ES-GS and GS-VS rings, and VGT_GS_MAX_VERT_OUT, reads outputVertices afterwards, so they all see the tighter bound.
+//
+// If in addition every path emits exactly one complete primitive on stream 0 (and any cut comes after its last
+// vertex), that is recorded for the NGG primitive shader, which can then skip output vertex compaction.
+//
+// Nothing is derived if an emit or cut is in a cycle or outside the GS entry-point.
+//
+// @param [in/out] module : LLVM module
+void PatchResourceCollect::analyzeGsEmits(Module *module) {
+  Function *gsEntryPoint = m_pipelineShaders->getEntryPoint(ShaderStageGeometry);
+  Function *sendMsg = module->getFunction(Intrinsic::getName(Intrinsic::amdgcn_s_sendmsg));
+  if (!gsEntryPoint || !sendMsg)
+    return;
+
+  // Find the emits per stream and the cuts in each block.
+  DenseMap<BasicBlock *, std::array<unsigned, MaxGsStreams>> blockEmits;
+  SmallPtrSet<BasicBlock *, 4> cutBlocks;
+  bool emitsOnlyStream0 = true;
+  for (User *user : sendMsg->users()) {
+    auto call = dyn_cast<CallInst>(user);
+    if (!call)
+      return;
+    auto message = dyn_cast<ConstantInt>(call->getArgOperand(0));
+    if (!message)
+      return;
+    const uint64_t messageType = message->getZExtValue() & ~GsEmitCutStreamIdMask;
+    if (messageType != GsEmit && messageType != GsCut)
+      continue;
+    if (call->getFunction() != gsEntryPoint)
+      return;
+    if (messageType == GsCut) {
+      cutBlocks.insert(call->getParent());
+      continue;
+    }
+    const unsigned streamId = (message->getZExtValue() & GsEmitCutStreamIdMask) >> GsEmitCutStreamIdShift;
+    emitsOnlyStream0 &= streamId == 0;
+    ++blockEmits[call->getParent()][streamId];
+  }
+
+  // Walk the SCCs of the CFG in topological order, taking the minimum and maximum emit counts over all incoming
+  // paths. A cycle containing an emit or cut makes the counts unknown.
+  SmallVector<std::vector<BasicBlock *>, 8> sccs;
+  for (auto sccIt = scc_begin(gsEntryPoint); !sccIt.isAtEnd(); ++sccIt) {
+    if (sccIt.hasCycle()) {
+      for (BasicBlock *block : *sccIt) {
+        if (blockEmits.count(block) || cutBlocks.count(block))
+          return;
+      }
+    }
+    sccs.push_back(*sccIt);
+  }
+
+  using EmitCounts = std::array<unsigned, MaxGsStreams>;
+  DenseMap<BasicBlock *, std::pair<EmitCounts, EmitCounts>> emitsAtEntry; // <min, max>
+  DenseMap<BasicBlock *, std::pair<EmitCounts, EmitCounts>> emitsAtExit;  // <min, max>
+  EmitCounts maxEmits = {};
+  EmitCounts minEmitsAtReturn;
+  minEmitsAtReturn.fill(UINT_MAX);
+  for (const auto &scc : reverse(sccs)) {
+    EmitCounts sccMin;
+    sccMin.fill(UINT_MAX);
+    EmitCounts sccMax = {};
+    bool hasExternalPred = false;
+    for (BasicBlock *block : scc) {
+      for (BasicBlock *pred : predecessors(block)) {
+        auto predIt = emitsAtExit.find(pred);
+        if (predIt == emitsAtExit.end())
+          continue; // Within this SCC
+        hasExternalPred = true;
+        for (unsigned i = 0; i < MaxGsStreams; ++i) {
+          sccMin[i] = std::min(sccMin[i], predIt->second.first[i]);
+          sccMax[i] = std::max(sccMax[i], predIt->second.second[i]);
+        }
+      }
+    }
+    if (!hasExternalPred)
+      sccMin.fill(0); // Entry block
+
+    for (BasicBlock *block : scc) {
+      emitsAtEntry[block] = {sccMin, sccMax};
+      auto exitMin = sccMin;
+      auto exitMax = sccMax;
+      auto blockIt = blockEmits.find(block);
+      if (blockIt != blockEmits.end()) {
+        for (unsigned i = 0; i < MaxGsStreams; ++i) {
+          exitMin[i] += blockIt->second[i];
+          exitMax[i] += blockIt->second[i];
+        }
+      }
+      emitsAtExit[block] = {exitMin, exitMax};
+      for (unsigned i = 0; i < MaxGsStreams; ++i)
+        maxEmits[i] = std::max(maxEmits[i], exitMax[i]);
+      if (isa<ReturnInst>(block->getTerminator())) {
+        for (unsigned i = 0; i < MaxGsStreams; ++i)
+          minEmitsAtReturn[i] = std::min(minEmitsAtReturn[i], exitMin[i]);
+      }
+    }
+  }
+
+  // An output export is stored to the GS-VS ring at the slot of the next vertex of its stream, without checking
+  // against outputVertices. An export after the last emit of a path therefore writes one slot past the emitted
+  // vertices, and that slot must be counted too.
+  unsigned exportBound = 0;
+  for (Function &func : *module) {
+    const StringRef name = func.getName();
+    if (!func.isDeclaration() || !(name.startswith(lgcName::OutputExportGeneric) ||
+                                   name.startswith(lgcName::OutputExportBuiltIn) ||
+                                   name.startswith(lgcName::OutputExportXfb)))
+      continue;
+    for (User *user : func.users()) {
+      auto call = dyn_cast<CallInst>(user);
+      if (!call || call->getFunction() != gsEntryPoint)
+        continue;
+      auto entryIt = emitsAtEntry.find(call->getParent());
+      if (entryIt == emitsAtEntry.end())
+        continue; // Unreachable
+      EmitCounts emitsBefore = entryIt->second.second;
+      for (Instruction &inst : *call->getParent()) {
+        if (&inst == call)
+          break;
+        auto emitCall = dyn_cast<CallInst>(&inst);
+        if (!emitCall || emitCall->getCalledFunction() != sendMsg)
+          continue;
+        const uint64_t message = cast<ConstantInt>(emitCall->getArgOperand(0))->getZExtValue();
+        if ((message & ~GsEmitCutStreamIdMask) == GsEmit)
+          ++emitsBefore[(message & GsEmitCutStreamIdMask) >> GsEmitCutStreamIdShift];
+      }
+      exportBound = std::max(exportBound, *std::max_element(emitsBefore.begin(), emitsBefore.end()) + 1);
+    }
+  }
+
+  auto geometryMode = m_pipelineState->getShaderModes()->getGeometryShaderMode();
+  const unsigned emitBound = std::max({1U, *std::max_element(maxEmits.begin(), maxEmits.end()), exportBound});
+  if (emitBound < geometryMode.outputVertices) {
+    LLPC_OUTS("GS output vertices: " << geometryMode.outputVertices << " declared, " << emitBound << " proven\n");
+    geometryMode.outputVertices = emitBound;
+    m_pipelineState->getShaderModes()->setGeometryShaderMode(geometryMode);
+  }
+
+  // Check for exactly one complete primitive per invocation: every path emits exactly the vertices of one primitive
+  // on stream 0, and every cut is reached only after all of them.
+  unsigned outVertsPerPrim = 1;
+  if (geometryMode.outputPrimitive == OutputPrimitives::LineStrip)
+    outVertsPerPrim = 2;
+  else if (geometryMode.outputPrimitive == OutputPrimitives::TriangleStrip)
+    outVertsPerPrim = 3;
+  if (!emitsOnlyStream0 || geometryMode.outputVertices != outVertsPerPrim || maxEmits[0] != outVertsPerPrim ||
+      minEmitsAtReturn[0] != outVertsPerPrim)
+    return;
+
+  for (BasicBlock *block : cutBlocks) {
+    auto entryIt = emitsAtEntry.find(block);
+    if (entryIt == emitsAtEntry.end())
+      continue; // Unreachable
+    unsigned minBefore = entryIt->second.first[0];
+    for (Instruction &inst : *block) {
+      auto call = dyn_cast<CallInst>(&inst);
+      if (!call || call->getCalledFunction() != sendMsg)
+        continue;
+      const uint64_t messageType = cast<ConstantInt>(call->getArgOperand(0))->getZExtValue() & ~GsEmitCutStreamIdMask;
+      if (messageType == GsEmit)
+        ++minBefore;
+      else if (messageType == GsCut && minBefore != outVertsPerPrim)
+        return;
+    }
+  }
+
+  LLPC_OUTS("GS emits exactly one primitive per invocation\n");
+  m_pipelineState->getShaderResourceUsage(ShaderStageGeometry)->inOutUsage.gs.calcFactor.emitsSinglePrimitive = true;
+}
+
+// =====================================================================================================================
+// Chooses the NGG subgroup size for NggSubgroupSizing::Auto in regular launch mode, from the primitive type, the
+// stages present, whether culling is on and the LDS footprint, rather than using one fixed size for all pipelines.
+// The result is recorded in named metadata.
+//
+// @param hasTs : Whether tessellation is present
+// @param hasGs : Whether GS is present
+// @param needsLds : Whether the primitive shader uses LDS
+// @param esGsRingItemSize : Size of an ES-GS ring item in dwords
+// @param gsVsRingItemSize : Size of a GS-VS ring item in dwords
+// @param extraLdsSize : Extra LDS used by the primitive shader in dwords
+// @param [in/out] esVertsPerSubgroup : ES vertices per subgroup
+// @param [in/out] gsPrimsPerSubgroup : GS primitives per subgroup
+void PatchResourceCollect::selectAutoNggSubgroupSize(bool hasTs, bool hasGs, bool needsLds, unsigned esGsRingItemSize,
+                                                     unsigned gsVsRingItemSize, unsigned extraLdsSize,
+                                                     unsigned &esVertsPerSubgroup, unsigned &gsPrimsPerSubgroup) {
+  const auto nggControl = m_pipelineState->getNggControl();
+  const unsigned vertsPerPrimitive = getVerticesPerPrimitive();
+
+  if (hasGs) {
+    // GS is bound by LDS, which holds the ES-GS ring for its input vertices and the GS-VS ring for its output. Take
+    // the largest primitive count whose footprint still lets two subgroups be resident on a CU.
+    const auto &geometryMode = m_pipelineState->getShaderModes()->getGeometryShaderMode();
+    const unsigned gsInstanceCount = std::max(1u, geometryMode.invocations);
+    const unsigned ldsBudget = m_pipelineState->getTargetInfo().getGpuProperty().ldsSizePerCu / 4 / 2; // In dwords
+    const unsigned primLdsSize = vertsPerPrimitive * esGsRingItemSize + gsInstanceCount * gsVsRingItemSize;
+
+    gsPrimsPerSubgroup = 128;
+    while (gsPrimsPerSubgroup > 1 && gsPrimsPerSubgroup * primLdsSize + extraLdsSize > ldsBudget)
+      gsPrimsPerSubgroup /= 2;
+    esVertsPerSubgroup = std::min(gsPrimsPerSubgroup * vertsPerPrimitive, Gfx9::NggMaxThreadsPerSubgroup);
+  } else if (vertsPerPrimitive == 1) {
+    // Points do not share vertices, so the subgroup needs as many vertices as primitives.
+    esVertsPerSubgroup = Gfx9::NggMaxThreadsPerSubgroup;
+    gsPrimsPerSubgroup = Gfx9::NggMaxThreadsPerSubgroup;
+  } else if (hasTs) {
+    // Tessellated vertices are expensive to produce and are reused less than those of indexed meshes, so favor
+    // filling the vertex threads.
+    esVertsPerSubgroup = 128;
+    gsPrimsPerSubgroup = needsLds ? 192 : Gfx9::NggMaxThreadsPerSubgroup;
+  } else if (!nggControl->passthroughMode) {
+    // Without GS, the LDS footprint of culling does not depend on the subgroup size. A full subgroup gives the culler
+    // and the vertex compaction the most primitives to work on, and the most vertex reuse between them.
+    esVertsPerSubgroup = Gfx9::NggMaxThreadsPerSubgroup;
+    gsPrimsPerSubgroup = Gfx9::NggMaxThreadsPerSubgroup;
+  }
+
+  LLPC_OUTS("NGG auto subgroup sizing: verts per subgroup = " << esVertsPerSubgroup
+                                                              << ", prims per subgroup = " << gsPrimsPerSubgroup
+                                                              << "\n");
+
+  IRBuilder<> builder(m_module->getContext());
+  Metadata *values[] = {
+      ConstantAsMetadata::get(builder.getInt32(esVertsPerSubgroup)),
+      ConstantAsMetadata::get(builder.getInt32(gsPrimsPerSubgroup)),
+  };
+  NamedMDNode *namedMetaNode = m_module->getOrInsertNamedMetadata(NggAutoSubgroupSizingMetadataName);
+  namedMetaNode->clearOperands();
+  namedMetaNode->addOperand(MDNode::get(m_module->getContext(), values));
+}
+
 // =====================================================================================================================
 // Determines whether GS on-chip mode is valid for this pipeline, also computes ES-GS/GS-VS ring item size.
 bool PatchResourceCollect::checkGsOnChipValidity() {
@@ -625,6 +1009,10 @@ bool PatchResourceCollect::checkGsOnChipValidity() {
         case NggSubgroupSizing::Auto:
           esVertsPerSubgroup = 126;
           gsPrimsPerSubgroup = 128;
+          if (NggAutoSubgroupSizing) {
+            selectAutoNggSubgroupSize(hasTs, hasGs, needsLds, esGsRingItemSize, gsVsRingItemSize,
+                                      esExtraLdsSize + gsExtraLdsSize, esVertsPerSubgroup, gsPrimsPerSubgroup);
+          }
           break;
         case NggSubgroupSizing::MaximumSize:
           esVertsPerSubgroup = Gfx9::NggMaxThreadsPerSubgroup;
@@ -1014,8 +1402,36 @@ void PatchResourceCollect::processShader() {
   m_hasDynIndexedOutput = false;
   m_resUsage = m_pipelineState->getShaderResourceUsage(m_shaderStage);
 
-  // Invoke handling of "call" instruction
-  visit(m_entryPoint);
+  if (EliminateDeadOutputs)
+    eliminateDeadOutputs();
+
+  // Invoke handling of "call" instruction. Only lgc.input.* and lgc.output.* calls are of interest, so find them
+  // through the use lists of their declarations rather than visiting every instruction in the shader, then handle
+  // them in program order as a visit of the shader would.
+  SmallVector<CallInst *, 32> inOutCalls;
+  for (Function &func : *m_module) {
+    if (!func.isDeclaration() ||
+        (!func.getName().startswith(lgcName::InputCallPrefix) && !func.getName().startswith(lgcName::OutputCallPrefix)))
+      continue;
+    for (User *user : func.users()) {
+      CallInst *call = dyn_cast<CallInst>(user);
+      if (call && call->getCalledFunction() == &func && call->getFunction() == m_entryPoint)
+        inOutCalls.push_back(call);
+    }
+  }
+
+  DenseMap<const BasicBlock *, unsigned> blockOrder;
+  unsigned blockIdx = 0;
+  for (BasicBlock &block : *m_entryPoint)
+    blockOrder[&block] = blockIdx++;
+  std::sort(inOutCalls.begin(), inOutCalls.end(), [&blockOrder](CallInst *lhs, CallInst *rhs) {
+    if (lhs->getParent() != rhs->getParent())
+      return blockOrder[lhs->getParent()] < blockOrder[rhs->getParent()];
+    return lhs->comesBefore(rhs);
+  });
+
+  for (CallInst *call : inOutCalls)
+    visitCallInst(*call);
 
   clearInactiveInput();
   clearInactiveOutput();
@@ -1056,6 +1472,135 @@ void PatchResourceCollect::processShader() {
   m_deadCalls.clear();
 }
 
+// =====================================================================================================================
+// Substitutes generic outputs of the last vertex processing stage that are compile-time constants into the fragment
+// shader inputs reading them.
+//
+// An output component is constant if every export writing it writes the same constant (a path that does not write it
+// leaves it undefined, for which the constant is as good a value as any). Interpolating a constant gives back the
+// constant, so any interpolation mode but custom interpolation can be substituted. The replaced input imports are
+// removed before input usage is collected; if no other input reads the location, the output is then dropped as unused
+// by location matching, which removes its export and frees its parameter cache space.
+//
+// @param [in/out] module : LLVM module
+void PatchResourceCollect::propagateConstantOutputs(Module *module) {
+  if (!m_pipelineState->isGraphics() || m_pipelineState->isUnlinked())
+    return;
+
+  const ShaderStage prevStage = m_pipelineState->getPrevShaderStage(ShaderStageFragment);
+  Function *fsEntryPoint = m_pipelineShaders->getEntryPoint(ShaderStageFragment);
+  if (!fsEntryPoint || (prevStage != ShaderStageVertex && prevStage != ShaderStageTessEval))
+    return;
+  Function *prevEntryPoint = m_pipelineShaders->getEntryPoint(prevStage);
+
+  // Collect the output components of the previous stage, keyed by (location * 4 + component), as 32-bit integer
+  // constants. A null entry marks a component that is not constant.
+  Type *int32Ty = Type::getInt32Ty(*m_context);
+  DenseMap<unsigned, Constant *> outputComps;
+  for (Function &func : *module) {
+    if (!func.isDeclaration() || !func.getName().startswith(lgcName::OutputExportGeneric))
+      continue;
+
+    for (User *user : func.users()) {
+      CallInst *call = dyn_cast<CallInst>(user);
+      if (!call || call->getFunction() != prevEntryPoint)
+        continue;
+
+      // VS:  @lgc.output.export.generic.%Type%(i32 location, i32 elemIdx, %Type% outputValue)
+      // TES: @lgc.output.export.generic.%Type%(i32 location, i32 elemIdx, %Type% outputValue)
+      auto locArg = dyn_cast<ConstantInt>(call->getArgOperand(0));
+      auto elemIdxArg = dyn_cast<ConstantInt>(call->getArgOperand(1));
+      if (!locArg || !elemIdxArg)
+        return; // Dynamic indexing of outputs, don't do anything
+
+      const unsigned loc = locArg->getZExtValue();
+      const unsigned elemIdx = elemIdxArg->getZExtValue();
+      Value *output = call->getArgOperand(2);
+      Type *outputTy = output->getType();
+
+      if (outputTy->getScalarSizeInBits() != 32) {
+        // Only 32-bit components are tracked, treat the whole location(s) as not constant
+        const unsigned locCount = outputTy->getPrimitiveSizeInBits() > (8 * SizeOfVec4) ? 2 : 1;
+        for (unsigned i = 0; i < 4 * locCount; ++i)
+          outputComps[loc * 4 + i] = nullptr;
+        continue;
+      }
+
+      const unsigned compCount = outputTy->isVectorTy() ? cast<VectorType>(outputTy)->getNumElements() : 1;
+      for (unsigned i = 0; i < compCount; ++i) {
+        Constant *comp = dyn_cast<Constant>(output);
+        if (comp && outputTy->isVectorTy())
+          comp = comp->getAggregateElement(i);
+        if (comp && isa<UndefValue>(comp))
+          continue; // Undefined component does not constrain the value
+        if (comp && (isa<ConstantInt>(comp) || isa<ConstantFP>(comp)))
+          comp = ConstantExpr::getBitCast(comp, int32Ty);
+        else
+          comp = nullptr;
+
+        auto result = outputComps.insert({loc * 4 + elemIdx + i, comp});
+        if (!result.second && result.first->second != comp)
+          result.first->second = nullptr;
+      }
+    }
+  }
+
+  // Replace FS input imports whose components are all constant
+  SmallVector<CallInst *, 8> constImports;
+  for (Function &func : *module) {
+    const bool isInterpolant = func.getName().startswith(lgcName::InputImportInterpolant);
+    if (!func.isDeclaration() || (!isInterpolant && !func.getName().startswith(lgcName::InputImportGeneric)))
+      continue;
+
+    for (User *user : func.users()) {
+      CallInst *call = dyn_cast<CallInst>(user);
+      if (!call || call->getFunction() != fsEntryPoint)
+        continue;
+
+      // FS:  @lgc.input.import.generic.%Type%(i32 location, i32 elemIdx, i32 interpMode, i32 interpLoc)
+      //      @lgc.input.import.interpolant.%Type%(i32 location, i32 locOffset, i32 elemIdx,
+      //                                           i32 interpMode, <2 x float> | i32 auxInterpValue)
+      unsigned loc = cast<ConstantInt>(call->getArgOperand(0))->getZExtValue();
+      const unsigned elemIdxArgIdx = isInterpolant ? 2 : 1;
+      if (isInterpolant) {
+        auto locOffset = dyn_cast<ConstantInt>(call->getArgOperand(1));
+        if (!locOffset)
+          continue;
+        loc += locOffset->getZExtValue();
+      }
+
+      auto elemIdxArg = dyn_cast<ConstantInt>(call->getArgOperand(elemIdxArgIdx));
+      const unsigned interpMode = cast<ConstantInt>(call->getArgOperand(elemIdxArgIdx + 1))->getZExtValue();
+      Type *inputTy = call->getType();
+      if (!elemIdxArg || interpMode == InOutInfo::InterpModeCustom || inputTy->getScalarSizeInBits() != 32)
+        continue;
+
+      const unsigned elemIdx = elemIdxArg->getZExtValue();
+      const unsigned compCount = inputTy->isVectorTy() ? cast<VectorType>(inputTy)->getNumElements() : 1;
+      SmallVector<Constant *, 4> comps;
+      for (unsigned i = 0; i < compCount; ++i) {
+        auto it = outputComps.find(loc * 4 + elemIdx + i);
+        if (it == outputComps.end() || !it->second)
+          break;
+        comps.push_back(ConstantExpr::getBitCast(it->second, inputTy->getScalarType()));
+      }
+      if (comps.size() != compCount)
+        continue;
+
+      call->replaceAllUsesWith(inputTy->isVectorTy() ? ConstantVector::get(comps) : comps[0]);
+      constImports.push_back(call);
+    }
+  }
+
+  if (constImports.empty())
+    return;
+
+  LLPC_OUTS("Constant " << getShaderStageAbbreviation(prevStage) << " outputs substituted into FS inputs: "
+                        << constImports.size() << "\n");
+  for (CallInst *call : constImports)
+    call->eraseFromParent();
+}
+
 // =====================================================================================================================
 // Check whether vertex reuse should be disabled.
 bool PatchResourceCollect::isVertexReuseDisabled() {
@@ -1260,13 +1805,76 @@ void PatchResourceCollect::visitCallInst(CallInst &callInst) {
       // Collect LocationSpans according to each FS' input call
       m_locationMapManager->addSpan(&callInst);
       m_inOutCalls.push_back(&callInst);
-    } else if (m_shaderStage == ShaderStageVertex && mangledName.startswith(lgcName::OutputExportGeneric)) {
+    } else if (m_shaderStage == m_pipelineState->getLastVertexProcessingStage() &&
+               mangledName.startswith(lgcName::OutputExportGeneric)) {
       m_inOutCalls.push_back(&callInst);
       m_deadCalls.push_back(&callInst);
     }
   }
 }
 
+// =====================================================================================================================
+// Removes generic output exports of this shader stage that are not read by the next shader stage, together with the
+// computation only feeding them.
+//
+// NOTE: Shader stages are processed in reverse order, so inactive inputs of the next shader stage have already been
+// cleared. Removing the dead exports before usage collection turns the inputs that only fed them into dead calls as
+// well, so the interface of the previous stage (and ES-GS/GS-VS ring item sizes) shrinks before resource sizing.
+void PatchResourceCollect::eliminateDeadOutputs() {
+  if (!m_pipelineState->isGraphics() || m_pipelineState->isUnlinked())
+    return;
+
+  // NOTE: TCS outputs can be read back and are written to memory that TES might index dynamically, so we leave them
+  // alone. Transform feedback outputs are consumed by the hardware rather than the next stage.
+  if (m_shaderStage == ShaderStageFragment || m_shaderStage == ShaderStageTessControl ||
+      m_resUsage->inOutUsage.enableXfb)
+    return;
+
+  const auto nextStage = m_pipelineState->getNextShaderStage(m_shaderStage);
+  if (nextStage == ShaderStageInvalid)
+    return;
+
+  // NOTE: With input/output packing, FS input locations are replaced by the packed ones.
+  if (nextStage == ShaderStageFragment && m_pipelineState->isPackInOut())
+    return;
+
+  const auto &nextInLocMap = m_pipelineState->getShaderResourceUsage(nextStage)->inOutUsage.inputLocMap;
+
+  SmallVector<CallInst *, 8> deadExports;
+  for (Function &func : *m_module) {
+    if (!func.isDeclaration() || !func.getName().startswith(lgcName::OutputExportGeneric))
+      continue;
+
+    for (User *user : func.users()) {
+      CallInst *call = dyn_cast<CallInst>(user);
+      if (!call || call->getFunction() != m_entryPoint)
+        continue;
+
+      // VS:  @lgc.output.export.generic.%Type%(i32 location, i32 elemIdx, %Type% outputValue)
+      // TES: @lgc.output.export.generic.%Type%(i32 location, i32 elemIdx, %Type% outputValue)
+      // GS:  @lgc.output.export.generic.%Type%(i32 location, i32 elemIdx, i32 streamId, %Type% outputValue)
+      auto locArg = dyn_cast<ConstantInt>(call->getArgOperand(0));
+      if (!locArg)
+        return; // Dynamic indexing of outputs, don't do anything
+
+      const unsigned loc = locArg->getZExtValue();
+      Value *output = call->getArgOperand(call->arg_size() - 1);
+      const bool twoLocs = output->getType()->getPrimitiveSizeInBits() > (8 * SizeOfVec4);
+
+      if (nextInLocMap.count(loc) > 0 || (twoLocs && nextInLocMap.count(loc + 1) > 0))
+        continue;
+
+      deadExports.push_back(call);
+    }
+  }
+
+  for (CallInst *call : deadExports) {
+    Value *output = call->getArgOperand(call->arg_size() - 1);
+    call->eraseFromParent();
+    RecursivelyDeleteTriviallyDeadInstructions(output);
+  }
+}
+
 // =====================================================================================================================
 // Clears inactive (those actually unused) inputs.
 void PatchResourceCollect::clearInactiveInput() {
@@ -1675,7 +2283,9 @@ void PatchResourceCollect::matchGenericInOut() {
         unsigned location = locMap.first;
         if (m_pipelineState->getColorExportState().dualSourceBlendEnable && location == 1)
           location = 0;
-        if (m_pipelineState->getColorExportFormat(location).dfmt == BufDataFormatInvalid) {
+        // Without color export formats, keep every output; the color export shader drops those without a format.
+        if (!m_pipelineState->useColorExportShader() &&
+            m_pipelineState->getColorExportFormat(location).dfmt == BufDataFormatInvalid) {
           locMapIt = outLocMap.erase(locMapIt);
           continue;
         }
@@ -2533,15 +3143,17 @@ void PatchResourceCollect::packInOutLocation() {
     m_locationMapManager->buildLocationMap();
     fillInOutLocMap();
     m_inOutCalls.clear(); // It will hold XX' output calls
-  } else if (m_shaderStage == ShaderStageVertex) {
+  } else if (m_shaderStage == m_pipelineState->getLastVertexProcessingStage()) {
+    // NOTE: The last vertex processing stage is either VS (VS-FS) or TES (VS-TCS-TES-FS). Both of them export
+    // generic outputs in the same form.
     reassembleOutputExportCalls();
 
     // For computing the shader hash
     m_pipelineState->getShaderResourceUsage(m_shaderStage)->inOutUsage.inOutLocMap =
         m_pipelineState->getShaderResourceUsage(ShaderStageFragment)->inOutUsage.inOutLocMap;
   } else {
-    // TODO: Pack input/output in other stages is not supported
-    llvm_unreachable("Not implemented!");
+    // NOTE: Interfaces between other stages (VS-TCS and TCS-TES) are not packed.
+    assert(m_shaderStage == ShaderStageVertex || m_shaderStage == ShaderStageTessControl);
   }
 }
 
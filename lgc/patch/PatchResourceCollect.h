@@ -63,12 +63,19 @@ private:
   PatchResourceCollect(const PatchResourceCollect &) = delete;
   PatchResourceCollect &operator=(const PatchResourceCollect &) = delete;
 
+  // Analyzes the vertices emitted along the GS control flow
+  void analyzeGsEmits(llvm::Module *module);
   // Determines whether GS on-chip mode is valid for this pipeline, also computes ES-GS/GS-VS ring item size.
   bool checkGsOnChipValidity();
+  void selectAutoNggSubgroupSize(bool hasTs, bool hasGs, bool needsLds, unsigned esGsRingItemSize,
+                                 unsigned gsVsRingItemSize, unsigned extraLdsSize, unsigned &esVertsPerSubgroup,
+                                 unsigned &gsPrimsPerSubgroup);
 
   // Sets NGG control settings
   void setNggControl(llvm::Module *module);
   bool canUseNggCulling(llvm::Module *module);
+  llvm::CallInst *findPositionExport(llvm::Module *module, ShaderStage shaderStage);
+  void selectNggCullers(llvm::Module *module, bool useCullDistance);
   void buildNggCullingControlRegister(NggControl &nggControl);
   unsigned getVerticesPerPrimitive() const;
 
@@ -76,6 +83,9 @@ private:
 
   bool isVertexReuseDisabled();
 
+  void propagateConstantOutputs(llvm::Module *module);
+
+  void eliminateDeadOutputs();
   void clearInactiveInput();
   void clearInactiveOutput();
 
@@ -0,0 +1,174 @@
+/*
+ ***********************************************************************************************************************
+ *
+ *  Copyright (c) 2020 Advanced Micro Devices, Inc. All Rights Reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ **********************************************************************************************************************/
+/**
+ ***********************************************************************************************************************
+ * @file  PatchWaterfallBatch.cpp
+ * @brief LLPC source file: contains implementation of class lgc::PatchWaterfallBatch.
+ ***********************************************************************************************************************
+ */
+#include "PatchWaterfallBatch.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/IntrinsicsAMDGPU.h"
+#include "llvm/InitializePasses.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+
+#define DEBUG_TYPE "lgc-patch-waterfall-batch"
+
+using namespace lgc;
+using namespace llvm;
+
+namespace llvm {
+
+namespace cl {
+// -batch-waterfall-loops: Merge consecutive waterfall loops that use the same non-uniform index.
+static opt<bool> BatchWaterfallLoops("batch-waterfall-loops",
+                                     desc("Merge consecutive waterfall loops that use the same non-uniform index"),
+                                     init(false));
+} // namespace cl
+
+} // namespace llvm
+
+namespace lgc {
+
+// =====================================================================================================================
+// Define static members (no initializer needed as LLVM only cares about the address of ID, never its value).
+char PatchWaterfallBatch::ID;
+
+// =====================================================================================================================
+// Pass creator, creates the pass of LLVM patching operations for batching waterfall loops.
+FunctionPass *createPatchWaterfallBatch() {
+  return new PatchWaterfallBatch();
+}
+
+// =====================================================================================================================
+PatchWaterfallBatch::PatchWaterfallBatch() : FunctionPass(ID) {
+}
+
+// =====================================================================================================================
+// Get the analysis usage of this pass.
+//
+// @param [out] analysisUsage : The analysis usage.
+void PatchWaterfallBatch::getAnalysisUsage(AnalysisUsage &analysisUsage) const {
+  analysisUsage.setPreservesCFG();
+}
+
+// =====================================================================================================================
+// Executes this LLVM pass on the specified LLVM function.
+//
+// The builder wraps each image or buffer operation with a non-uniform descriptor in its own waterfall loop
+// (llvm.amdgcn.waterfall.begin, .readfirstlane, .end/.last.use). When several such operations use the same non-uniform
+// index, each loop serializes the wave over the same set of distinct index values. Letting all of them share the first
+// waterfall.begin makes the backend emit one loop that covers all the operations.
+//
+// @param [in,out] function : Function that will run this optimization.
+bool PatchWaterfallBatch::runOnFunction(Function &function) {
+  if (!cl::BatchWaterfallLoops || function.isDeclaration())
+    return false;
+
+  LLVM_DEBUG(dbgs() << "Run the pass Patch-Waterfall-Batch\n");
+
+  bool changed = false;
+  for (BasicBlock &block : function)
+    changed |= batchInBlock(block);
+  return changed;
+}
+
+// =====================================================================================================================
+// Merge the waterfall loops in a basic block that can share a waterfall.begin.
+//
+// A later waterfall.begin is folded into the current one if it has the same index and nothing between them needs the
+// whole wave: the instructions in between are then executed inside the loop, once per lane, which leaves their
+// results unchanged.
+//
+// @param [in,out] block : Basic block to process
+bool PatchWaterfallBatch::batchInBlock(BasicBlock &block) {
+  bool changed = false;
+  IntrinsicInst *currentBegin = nullptr;
+
+  for (auto it = block.begin(), end = block.end(); it != end;) {
+    Instruction *inst = &*it++;
+    auto call = dyn_cast<CallInst>(inst);
+    if (!call)
+      continue;
+
+    auto intrinsic = dyn_cast<IntrinsicInst>(call);
+    if (intrinsic) {
+      switch (intrinsic->getIntrinsicID()) {
+      case Intrinsic::amdgcn_waterfall_begin:
+        if (currentBegin && isSameIndex(currentBegin->getArgOperand(0), intrinsic->getArgOperand(0))) {
+          intrinsic->replaceAllUsesWith(currentBegin);
+          intrinsic->eraseFromParent();
+          changed = true;
+        } else
+          currentBegin = intrinsic;
+        continue;
+      case Intrinsic::amdgcn_waterfall_readfirstlane:
+      case Intrinsic::amdgcn_waterfall_end:
+      case Intrinsic::amdgcn_waterfall_last_use:
+        // Parts of another waterfall loop interleaved with the current one end the batch.
+        if (intrinsic->getArgOperand(0) != currentBegin)
+          currentBegin = nullptr;
+        continue;
+      default:
+        break;
+      }
+    }
+
+    // Anything that needs the whole wave (barriers, subgroup operations, readfirstlane) cannot be moved inside a
+    // waterfall loop.
+    if (call->isConvergent() || call->isInlineAsm())
+      currentBegin = nullptr;
+  }
+
+  return changed;
+}
+
+// =====================================================================================================================
+// Check whether two waterfall indices are known to be equal. A combined image+sampler index is an insertvalue chain
+// built for each operation, so those chains are compared element by element.
+//
+// @param index1 : First waterfall index
+// @param index2 : Second waterfall index
+bool PatchWaterfallBatch::isSameIndex(Value *index1, Value *index2) {
+  if (index1 == index2)
+    return true;
+
+  auto insert1 = dyn_cast<InsertValueInst>(index1);
+  auto insert2 = dyn_cast<InsertValueInst>(index2);
+  if (!insert1 || !insert2 || insert1->getType() != insert2->getType() ||
+      insert1->getIndices() != insert2->getIndices())
+    return false;
+
+  return insert1->getInsertedValueOperand() == insert2->getInsertedValueOperand() &&
+         isSameIndex(insert1->getAggregateOperand(), insert2->getAggregateOperand());
+}
+
+} // namespace lgc
+
+// =====================================================================================================================
+// Initializes the pass of LLVM patching operations for batching waterfall loops.
+INITIALIZE_PASS(PatchWaterfallBatch, DEBUG_TYPE, "Patch LLVM for batching waterfall loops", false, false)
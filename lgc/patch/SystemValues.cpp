@@ -330,6 +330,18 @@ Value *ShaderSystemValues::getNumWorkgroups() {
   return m_numWorkgroups;
 }
 
+// =====================================================================================================================
+// Get sample position descriptor (FS)
+Value *ShaderSystemValues::getSamplePosDesc() {
+  assert(m_shaderStage == ShaderStageFragment);
+  if (!m_samplePosDesc) {
+    // Ensure we have got the global table pointer first, and insert new code after that.
+    BuilderBase builder(getInternalGlobalTablePtr()->getNextNode());
+    m_samplePosDesc = loadDescFromDriverTable(SiDrvTableSamplepos, builder);
+  }
+  return m_samplePosDesc;
+}
+
 // =====================================================================================================================
 // Get stream-out buffer descriptor
 //
@@ -452,6 +464,7 @@ Instruction *ShaderSystemValues::loadDescFromDriverTable(unsigned tableOffset, B
   globalTable = cast<Instruction>(builder.CreateBitCast(globalTable, descTy->getPointerTo(ADDR_SPACE_CONST)));
   Value *descPtr = builder.CreateGEP(descTy, globalTable, builder.getInt32(tableOffset));
   LoadInst *desc = builder.CreateLoad(descTy, descPtr);
+  desc->setMetadata(LLVMContext::MD_invariant_load, MDNode::get(desc->getContext(), {}));
   return desc;
 }
 
@@ -46,8 +46,9 @@ struct ResourceNode;
 // "Shader system values" are values set up in a shader entrypoint, such as the ES->GS ring buffer descriptor, or the
 // user descriptor table pointer, that some passes need access to. The ShaderSystemValues class has an instance for each
 // shader in each pass that needs it, and it implements the on-demand emitting of the code to generate such a value, and
-// caches the result for the duration of the pass using it. If multiple passes need the same value, then multiple copies
-// of the generating code will be emitted, but that will be fixed by a later CSE pass.
+// caches the result for the duration of the pass using it. Each value is emitted once per shader, in the entry block,
+// and loads from the driver tables are marked invariant, so that any copies emitted by other code can be commoned up
+// by a later CSE pass even across the calls LGC inserts.
 class ShaderSystemValues {
 public:
   // Initialize this ShaderSystemValues if it was previously uninitialized.
@@ -95,6 +96,9 @@ public:
   // Get number of workgroups value
   llvm::Value *getNumWorkgroups();
 
+  // Get sample position descriptor (FS)
+  llvm::Value *getSamplePosDesc();
+
   // Get stream-out buffer descriptor
   llvm::Value *getStreamOutBufDesc(unsigned xfbBuffer);
 
@@ -133,6 +137,7 @@ private:
   llvm::Value *m_esGsOffsets = nullptr;                             // ES -> GS offsets (GS in)
   llvm::SmallVector<llvm::Value *, MaxGsStreams> m_emitCounterPtrs; // Pointers to emit counters (GS)
   llvm::Value *m_numWorkgroups = nullptr;                           // NumWorkgroups
+  llvm::Value *m_samplePosDesc = nullptr;                           // Sample position descriptor (FS)
 
   llvm::SmallVector<llvm::Value *, 8> m_descTablePtrs;       // Descriptor table pointers
   llvm::SmallVector<llvm::Value *, 8> m_shadowDescTablePtrs; // Shadow descriptor table pointers
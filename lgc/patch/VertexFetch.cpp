@@ -38,15 +38,26 @@
 #include "lgc/state/PipelineState.h"
 #include "lgc/state/TargetInfo.h"
 #include "lgc/util/Internal.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Module.h"
+#include "llvm/Support/CommandLine.h"
+#include <algorithm>
+#include <map>
+#include <tuple>
 
 #define DEBUG_TYPE "lgc-vertex-fetch"
 
 using namespace lgc;
 using namespace llvm;
 
+// -coalesce-vertex-fetches: fetch vertex inputs that are contiguous in the same binding with one wider load
+static cl::opt<bool> CoalesceVertexFetches("coalesce-vertex-fetches",
+                                           cl::desc("Fetch 32-bit vertex inputs that are contiguous in the same "
+                                                    "vertex buffer binding with one wider buffer load"),
+                                           cl::init(false));
+
 namespace lgc {
 class BuilderBase;
 class PipelineState;
@@ -102,9 +113,18 @@ public:
   Value *fetchVertex(Type *inputTy, const VertexInputDescription *description, unsigned location, unsigned compIdx,
                      BuilderBase &builder) override;
 
+  // Generate combined loads for vertex inputs that are contiguous in the same vertex buffer binding
+  void coalesceVertexFetches(ArrayRef<const VertexInputDescription *> descriptions, BuilderBase &builder) override;
+
 private:
   void initialize(PipelineState *pipelineState);
 
+  Value *fetchVertexAttribute(const VertexInputDescription *description, bool is16bitFetch, BuilderBase &builder);
+
+  Value *getVertexBufferIndex(const VertexInputDescription *description, BuilderBase &builder);
+
+  bool canCoalesceVertexFetch(const VertexInputDescription *description) const;
+
   static VertexFormatInfo getVertexFormatInfo(const VertexInputDescription *description);
 
   // Gets variable corresponding to vertex index
@@ -122,7 +142,7 @@ private:
   void addVertexFetchInst(Value *vbDesc, unsigned numChannels, bool is16bitFetch, Value *vbIndex, unsigned offset,
                           unsigned stride, unsigned dfmt, unsigned nfmt, Instruction *insertPos, Value **ppFetch) const;
 
-  bool needPostShuffle(const VertexInputDescription *inputDesc, std::vector<Constant *> &shuffleMask) const;
+  static ArrayRef<unsigned> getFetchSwizzle(const VertexInputDescription *inputDesc);
 
   bool needPatchA2S(const VertexInputDescription *inputDesc) const;
 
@@ -134,6 +154,9 @@ private:
   Value *m_vertexIndex = nullptr;       // Vertex index
   Value *m_instanceIndex = nullptr;     // Instance index
 
+  // Map from vertex input description to its part of a coalesced fetch, in the same form as fetching it alone
+  DenseMap<const VertexInputDescription *, Value *> m_coalescedFetches;
+
   static const VertexCompFormatInfo MVertexCompFormatInfo[]; // Info table of vertex component format
   static const BufFormat MVertexFormatMap[];                 // Info table of vertex format mapping
 
@@ -379,6 +402,32 @@ bool LowerVertexFetch::runOnModule(Module &module) {
 
   if (!pipelineState->isUnlinked() || !pipelineState->getVertexInputDescriptions().empty()) {
     // Whole-pipeline compilation (or shader compilation where we were given the vertex input descriptions).
+    // If enabled, first do combined loads for vertex inputs that are contiguous in the same binding, at the start
+    // of the vertex shader so they dominate all the fetches that use them. An input fetched at a 16-bit type is
+    // left to be fetched alone, as that uses a different form of load.
+    if (CoalesceVertexFetches) {
+      SmallVector<const VertexInputDescription *, 8> descriptions;
+      SmallVector<unsigned, 8> locations16bit;
+      for (CallInst *call : vertexFetches) {
+        unsigned location = cast<ConstantInt>(call->getArgOperand(0))->getZExtValue();
+        if (call->getType()->getScalarSizeInBits() == 16)
+          locations16bit.push_back(location);
+        else if (const VertexInputDescription *description = pipelineState->findVertexInputDescription(location))
+          descriptions.push_back(description);
+      }
+      descriptions.erase(std::remove_if(descriptions.begin(), descriptions.end(),
+                                        [&locations16bit](const VertexInputDescription *description) {
+                                          return is_contained(locations16bit, description->location);
+                                        }),
+                         descriptions.end());
+      std::sort(descriptions.begin(), descriptions.end());
+      descriptions.erase(std::unique(descriptions.begin(), descriptions.end()), descriptions.end());
+      if (descriptions.size() > 1) {
+        builder.SetInsertPoint(&*vertexFetches[0]->getFunction()->front().getFirstInsertionPt());
+        vertexFetch->coalesceVertexFetches(descriptions, builder);
+      }
+    }
+
     // Lower each vertex fetch.
     for (CallInst *call : vertexFetches) {
       Value *vertex = nullptr;
@@ -546,177 +595,17 @@ Value *VertexFetchImpl::fetchVertex(Type *inputTy, const VertexInputDescription
                                     unsigned compIdx, BuilderBase &builder) {
   Value *vertex = nullptr;
   Instruction *insertPos = &*builder.GetInsertPoint();
-  auto vbDesc = loadVertexBufferDescriptor(description->binding, builder);
-
-  Value *vbIndex = nullptr;
-  if (description->inputRate == VertexInputRateVertex) {
-    // Use vertex index
-    if (!m_vertexIndex) {
-      auto savedInsertPoint = builder.saveIP();
-      builder.SetInsertPoint(&*insertPos->getFunction()->front().getFirstInsertionPt());
-      m_vertexIndex = ShaderInputs::getVertexIndex(builder);
-      builder.restoreIP(savedInsertPoint);
-    }
-    vbIndex = m_vertexIndex;
-  } else {
-    if (description->inputRate == VertexInputRateNone) {
-      vbIndex = ShaderInputs::getSpecialUserData(UserDataMapping::BaseInstance, builder);
-    } else if (description->inputRate == VertexInputRateInstance) {
-      // Use instance index
-      if (!m_instanceIndex) {
-        auto savedInsertPoint = builder.saveIP();
-        builder.SetInsertPoint(&*insertPos->getFunction()->front().getFirstInsertionPt());
-        m_instanceIndex = ShaderInputs::getInstanceIndex(builder);
-        builder.restoreIP(savedInsertPoint);
-      }
-      vbIndex = m_instanceIndex;
-    } else {
-      // There is a divisor.
-      vbIndex = builder.CreateUDiv(ShaderInputs::getInput(ShaderInput::InstanceId, builder),
-                                   builder.getInt32(description->inputRate));
-      vbIndex = builder.CreateAdd(vbIndex, ShaderInputs::getSpecialUserData(UserDataMapping::BaseInstance, builder));
-    }
-  }
-
-  Value *vertexFetches[2] = {}; // Two vertex fetch operations might be required
-  Value *vertexFetch = nullptr; // Coalesced vector by combining the results of two vertex fetch operations
-
-  VertexFormatInfo formatInfo = getVertexFormatInfo(description);
 
   const bool is8bitFetch = (inputTy->getScalarSizeInBits() == 8);
   const bool is16bitFetch = (inputTy->getScalarSizeInBits() == 16);
 
-  // Do the first vertex fetch operation
-  addVertexFetchInst(vbDesc, formatInfo.numChannels, is16bitFetch, vbIndex, description->offset, description->stride,
-                     formatInfo.dfmt, formatInfo.nfmt, insertPos, &vertexFetches[0]);
-
-  // Do post-processing in certain cases
-  std::vector<Constant *> shuffleMask;
-  bool postShuffle = needPostShuffle(description, shuffleMask);
-  bool patchA2S = needPatchA2S(description);
-  if (postShuffle || patchA2S) {
-    if (postShuffle) {
-      // NOTE: If we are fetching a swizzled format, we have to add an extra "shufflevector" instruction to
-      // get the components in the right order.
-      assert(shuffleMask.empty() == false);
-      vertexFetches[0] =
-          new ShuffleVectorInst(vertexFetches[0], vertexFetches[0], ConstantVector::get(shuffleMask), "", insertPos);
-    }
-
-    if (patchA2S) {
-      assert(cast<VectorType>(vertexFetches[0]->getType())->getNumElements() == 4);
-
-      // Extract alpha channel: %a = extractelement %vf0, 3
-      Value *alpha = ExtractElementInst::Create(vertexFetches[0], ConstantInt::get(Type::getInt32Ty(*m_context), 3), "",
-                                                insertPos);
-
-      if (formatInfo.nfmt == BufNumFormatSint) {
-        // NOTE: For format "SINT 10_10_10_2", vertex fetches incorrectly return the alpha channel as
-        // unsigned. We have to manually sign-extend it here by doing a "shl" 30 then an "ashr" 30.
-
-        // %a = shl %a, 30
-        alpha = BinaryOperator::CreateShl(alpha, ConstantInt::get(Type::getInt32Ty(*m_context), 30), "", insertPos);
-
-        // %a = ashr %a, 30
-        alpha = BinaryOperator::CreateAShr(alpha, ConstantInt::get(Type::getInt32Ty(*m_context), 30), "", insertPos);
-      } else if (formatInfo.nfmt == BufNumFormatSnorm) {
-        // NOTE: For format "SNORM 10_10_10_2", vertex fetches incorrectly return the alpha channel
-        // as unsigned. We have to somehow remap the values { 0.0, 0.33, 0.66, 1.00 } to { 0.0, 1.0,
-        // -1.0, -1.0 } respectively.
-
-        // %a = bitcast %a to f32
-        alpha = new BitCastInst(alpha, Type::getFloatTy(*m_context), "", insertPos);
-
-        // %a = mul %a, 3.0f
-        alpha = BinaryOperator::CreateFMul(alpha, ConstantFP::get(Type::getFloatTy(*m_context), 3.0f), "", insertPos);
-
-        // %cond = ugt %a, 1.5f
-        auto cond =
-            new FCmpInst(insertPos, FCmpInst::FCMP_UGT, alpha, ConstantFP::get(Type::getFloatTy(*m_context), 1.5f), "");
-
-        // %a = select %cond, -1.0f, pAlpha
-        alpha = SelectInst::Create(cond, ConstantFP::get(Type::getFloatTy(*m_context), -1.0f), alpha, "", insertPos);
-
-        // %a = bitcast %a to i32
-        alpha = new BitCastInst(alpha, Type::getInt32Ty(*m_context), "", insertPos);
-      } else if (formatInfo.nfmt == BufNumFormatSscaled) {
-        // NOTE: For format "SSCALED 10_10_10_2", vertex fetches incorrectly return the alpha channel
-        // as unsigned. We have to somehow remap the values { 0.0, 1.0, 2.0, 3.0 } to { 0.0, 1.0,
-        // -2.0, -1.0 } respectively. We can perform the sign extension here by doing a "fptosi", "shl" 30,
-        // "ashr" 30, and finally "sitofp".
-
-        // %a = bitcast %a to float
-        alpha = new BitCastInst(alpha, Type::getFloatTy(*m_context), "", insertPos);
-
-        // %a = fptosi %a to i32
-        alpha = new FPToSIInst(alpha, Type::getInt32Ty(*m_context), "", insertPos);
-
-        // %a = shl %a, 30
-        alpha = BinaryOperator::CreateShl(alpha, ConstantInt::get(Type::getInt32Ty(*m_context), 30), "", insertPos);
-
-        // %a = ashr a, 30
-        alpha = BinaryOperator::CreateAShr(alpha, ConstantInt::get(Type::getInt32Ty(*m_context), 30), "", insertPos);
-
-        // %a = sitofp %a to float
-        alpha = new SIToFPInst(alpha, Type::getFloatTy(*m_context), "", insertPos);
-
-        // %a = bitcast %a to i32
-        alpha = new BitCastInst(alpha, Type::getInt32Ty(*m_context), "", insertPos);
-      } else
-        llvm_unreachable("Should never be called!");
-
-      // Insert alpha channel: %vf0 = insertelement %vf0, %a, 3
-      vertexFetches[0] = InsertElementInst::Create(vertexFetches[0], alpha,
-                                                   ConstantInt::get(Type::getInt32Ty(*m_context), 3), "", insertPos);
-    }
-  }
-
-  // Do the second vertex fetch operation
-  const bool secondFetch = needSecondVertexFetch(description);
-  if (secondFetch) {
-    unsigned numChannels = formatInfo.numChannels;
-    unsigned dfmt = formatInfo.dfmt;
-
-    if (description->dfmt == BufDataFormat64_64_64) {
-      // Valid number of channels and data format have to be revised
-      numChannels = 2;
-      dfmt = BUF_DATA_FORMAT_32_32;
-    }
-
-    addVertexFetchInst(vbDesc, numChannels, is16bitFetch, vbIndex, description->offset + SizeOfVec4,
-                       description->stride, dfmt, formatInfo.nfmt, insertPos, &vertexFetches[1]);
-  }
-
-  if (secondFetch) {
-    // NOTE: If we performs vertex fetch operations twice, we have to coalesce result values of the two
-    // fetch operations and generate a combined one.
-    assert(vertexFetches[0] && vertexFetches[1]);
-    assert(cast<VectorType>(vertexFetches[0]->getType())->getNumElements() == 4);
-
-    unsigned compCount = cast<VectorType>(vertexFetches[1]->getType())->getNumElements();
-    assert(compCount == 2 || compCount == 4); // Should be <2 x i32> or <4 x i32>
-
-    if (compCount == 2) {
-      // NOTE: We have to enlarge the second vertex fetch, from <2 x i32> to <4 x i32>. Otherwise,
-      // vector shuffle operation could not be performed in that it requires the two vectors have
-      // the same types.
-
-      // %vf1 = shufflevector %vf1, %vf1, <0, 1, undef, undef>
-      Constant *shuffleMask[] = {
-          ConstantInt::get(Type::getInt32Ty(*m_context), 0), ConstantInt::get(Type::getInt32Ty(*m_context), 1),
-          UndefValue::get(Type::getInt32Ty(*m_context)), UndefValue::get(Type::getInt32Ty(*m_context))};
-      vertexFetches[1] =
-          new ShuffleVectorInst(vertexFetches[1], vertexFetches[1], ConstantVector::get(shuffleMask), "", insertPos);
-    }
-
-    // %vf = shufflevector %vf0, %vf1, <0, 1, 2, 3, 4, 5, ...>
-    shuffleMask.clear();
-    for (unsigned i = 0; i < 4 + compCount; ++i)
-      shuffleMask.push_back(ConstantInt::get(Type::getInt32Ty(*m_context), i));
-    vertexFetch =
-        new ShuffleVectorInst(vertexFetches[0], vertexFetches[1], ConstantVector::get(shuffleMask), "", insertPos);
-  } else
-    vertexFetch = vertexFetches[0];
+  // Use the part of a coalesced fetch if this vertex input is covered by one, otherwise fetch it on its own.
+  Value *vertexFetch = nullptr;
+  auto coalescedIt = m_coalescedFetches.find(description);
+  if (coalescedIt != m_coalescedFetches.end())
+    vertexFetch = coalescedIt->second;
+  else
+    vertexFetch = fetchVertexAttribute(description, is16bitFetch, builder);
 
   // Finalize vertex fetch
   Type *basicTy = inputTy->isVectorTy() ? cast<VectorType>(inputTy)->getElementType() : inputTy;
@@ -780,10 +669,12 @@ Value *VertexFetchImpl::fetchVertex(Type *inputTy, const VertexInputDescription
   // NOTE: Original component index is based on the basic scalar type.
   compIdx *= (bitWidth == 64 ? 2 : 1);
 
-  // Vertex input might take values from vertex fetch values or default fetch values
+  // Vertex input might take values from vertex fetch values or default fetch values. For a swizzled format, the
+  // swizzle is applied here as part of selecting the components, rather than as a separate shuffle of the fetch.
+  ArrayRef<unsigned> fetchSwizzle = getFetchSwizzle(description);
   for (unsigned i = 0; i < vertexCompCount; i++) {
     if (compIdx + i < fetchCompCount)
-      vertexValues[i] = fetchValues[compIdx + i];
+      vertexValues[i] = fetchValues[compIdx + i < fetchSwizzle.size() ? fetchSwizzle[compIdx + i] : compIdx + i];
     else if (compIdx + i < defaultCompCount)
       vertexValues[i] = defaultValues[compIdx + i];
     else {
@@ -833,6 +724,288 @@ Value *VertexFetchImpl::fetchVertex(Type *inputTy, const VertexInputDescription
   return vertex;
 }
 
+// =====================================================================================================================
+// Fetches the whole of one vertex attribute, returning the fetched dwords (or 16-bit values) before they are
+// converted to the vertex input type.
+//
+// @param description : Vertex input description
+// @param is16bitFetch : Whether it is 16-bit vertex fetch
+// @param builder : Builder to use to insert vertex fetch instructions
+Value *VertexFetchImpl::fetchVertexAttribute(const VertexInputDescription *description, bool is16bitFetch,
+                                             BuilderBase &builder) {
+  Instruction *insertPos = &*builder.GetInsertPoint();
+  auto vbDesc = loadVertexBufferDescriptor(description->binding, builder);
+  Value *vbIndex = getVertexBufferIndex(description, builder);
+
+  Value *vertexFetches[2] = {}; // Two vertex fetch operations might be required
+  Value *vertexFetch = nullptr; // Coalesced vector by combining the results of two vertex fetch operations
+
+  VertexFormatInfo formatInfo = getVertexFormatInfo(description);
+
+  // Do the first vertex fetch operation
+  addVertexFetchInst(vbDesc, formatInfo.numChannels, is16bitFetch, vbIndex, description->offset, description->stride,
+                     formatInfo.dfmt, formatInfo.nfmt, insertPos, &vertexFetches[0]);
+
+  // Do post-processing in certain cases. A swizzled (BGRA) format is not reordered here; fetchVertex picks the
+  // components in the right order when it selects the ones the vertex input uses.
+  if (needPatchA2S(description)) {
+    assert(cast<VectorType>(vertexFetches[0]->getType())->getNumElements() == 4);
+
+    // Extract alpha channel: %a = extractelement %vf0, 3
+    Value *alpha = ExtractElementInst::Create(vertexFetches[0], ConstantInt::get(Type::getInt32Ty(*m_context), 3), "",
+                                              insertPos);
+
+    if (formatInfo.nfmt == BufNumFormatSint) {
+      // NOTE: For format "SINT 10_10_10_2", vertex fetches incorrectly return the alpha channel as
+      // unsigned. We have to manually sign-extend it here by doing a "shl" 30 then an "ashr" 30.
+
+      // %a = shl %a, 30
+      alpha = BinaryOperator::CreateShl(alpha, ConstantInt::get(Type::getInt32Ty(*m_context), 30), "", insertPos);
+
+      // %a = ashr %a, 30
+      alpha = BinaryOperator::CreateAShr(alpha, ConstantInt::get(Type::getInt32Ty(*m_context), 30), "", insertPos);
+    } else if (formatInfo.nfmt == BufNumFormatSnorm) {
+      // NOTE: For format "SNORM 10_10_10_2", vertex fetches incorrectly return the alpha channel
+      // as unsigned. We have to somehow remap the values { 0.0, 0.33, 0.66, 1.00 } to { 0.0, 1.0,
+      // -1.0, -1.0 } respectively.
+
+      // %a = bitcast %a to f32
+      alpha = new BitCastInst(alpha, Type::getFloatTy(*m_context), "", insertPos);
+
+      // %a = mul %a, 3.0f
+      alpha = BinaryOperator::CreateFMul(alpha, ConstantFP::get(Type::getFloatTy(*m_context), 3.0f), "", insertPos);
+
+      // %cond = ugt %a, 1.5f
+      auto cond =
+          new FCmpInst(insertPos, FCmpInst::FCMP_UGT, alpha, ConstantFP::get(Type::getFloatTy(*m_context), 1.5f), "");
+
+      // %a = select %cond, -1.0f, pAlpha
+      alpha = SelectInst::Create(cond, ConstantFP::get(Type::getFloatTy(*m_context), -1.0f), alpha, "", insertPos);
+
+      // %a = bitcast %a to i32
+      alpha = new BitCastInst(alpha, Type::getInt32Ty(*m_context), "", insertPos);
+    } else if (formatInfo.nfmt == BufNumFormatSscaled) {
+      // NOTE: For format "SSCALED 10_10_10_2", vertex fetches incorrectly return the alpha channel
+      // as unsigned. We have to somehow remap the values { 0.0, 1.0, 2.0, 3.0 } to { 0.0, 1.0,
+      // -2.0, -1.0 } respectively. We can perform the sign extension here by doing a "fptosi", "shl" 30,
+      // "ashr" 30, and finally "sitofp".
+
+      // %a = bitcast %a to float
+      alpha = new BitCastInst(alpha, Type::getFloatTy(*m_context), "", insertPos);
+
+      // %a = fptosi %a to i32
+      alpha = new FPToSIInst(alpha, Type::getInt32Ty(*m_context), "", insertPos);
+
+      // %a = shl %a, 30
+      alpha = BinaryOperator::CreateShl(alpha, ConstantInt::get(Type::getInt32Ty(*m_context), 30), "", insertPos);
+
+      // %a = ashr a, 30
+      alpha = BinaryOperator::CreateAShr(alpha, ConstantInt::get(Type::getInt32Ty(*m_context), 30), "", insertPos);
+
+      // %a = sitofp %a to float
+      alpha = new SIToFPInst(alpha, Type::getFloatTy(*m_context), "", insertPos);
+
+      // %a = bitcast %a to i32
+      alpha = new BitCastInst(alpha, Type::getInt32Ty(*m_context), "", insertPos);
+    } else
+      llvm_unreachable("Should never be called!");
+
+    // Insert alpha channel: %vf0 = insertelement %vf0, %a, 3
+    vertexFetches[0] = InsertElementInst::Create(vertexFetches[0], alpha,
+                                                 ConstantInt::get(Type::getInt32Ty(*m_context), 3), "", insertPos);
+  }
+
+  // Do the second vertex fetch operation
+  const bool secondFetch = needSecondVertexFetch(description);
+  if (secondFetch) {
+    unsigned numChannels = formatInfo.numChannels;
+    unsigned dfmt = formatInfo.dfmt;
+
+    if (description->dfmt == BufDataFormat64_64_64) {
+      // Valid number of channels and data format have to be revised
+      numChannels = 2;
+      dfmt = BUF_DATA_FORMAT_32_32;
+    }
+
+    addVertexFetchInst(vbDesc, numChannels, is16bitFetch, vbIndex, description->offset + SizeOfVec4,
+                       description->stride, dfmt, formatInfo.nfmt, insertPos, &vertexFetches[1]);
+  }
+
+  if (secondFetch) {
+    // NOTE: If we performs vertex fetch operations twice, we have to coalesce result values of the two
+    // fetch operations and generate a combined one.
+    assert(vertexFetches[0] && vertexFetches[1]);
+    assert(cast<VectorType>(vertexFetches[0]->getType())->getNumElements() == 4);
+
+    unsigned compCount = cast<VectorType>(vertexFetches[1]->getType())->getNumElements();
+    assert(compCount == 2 || compCount == 4); // Should be <2 x i32> or <4 x i32>
+
+    if (compCount == 2) {
+      // NOTE: We have to enlarge the second vertex fetch, from <2 x i32> to <4 x i32>. Otherwise,
+      // vector shuffle operation could not be performed in that it requires the two vectors have
+      // the same types.
+
+      // %vf1 = shufflevector %vf1, %vf1, <0, 1, undef, undef>
+      Constant *shuffleMask[] = {
+          ConstantInt::get(Type::getInt32Ty(*m_context), 0), ConstantInt::get(Type::getInt32Ty(*m_context), 1),
+          UndefValue::get(Type::getInt32Ty(*m_context)), UndefValue::get(Type::getInt32Ty(*m_context))};
+      vertexFetches[1] =
+          new ShuffleVectorInst(vertexFetches[1], vertexFetches[1], ConstantVector::get(shuffleMask), "", insertPos);
+    }
+
+    // %vf = shufflevector %vf0, %vf1, <0, 1, 2, 3, 4, 5, ...>
+    std::vector<Constant *> shuffleMask;
+    for (unsigned i = 0; i < 4 + compCount; ++i)
+      shuffleMask.push_back(ConstantInt::get(Type::getInt32Ty(*m_context), i));
+    vertexFetch =
+        new ShuffleVectorInst(vertexFetches[0], vertexFetches[1], ConstantVector::get(shuffleMask), "", insertPos);
+  } else
+    vertexFetch = vertexFetches[0];
+
+  return vertexFetch;
+}
+
+// =====================================================================================================================
+// Generates combined loads for vertex inputs that are contiguous in the same vertex buffer binding, so that the
+// fetchVertex calls for them that follow use parts of the combined loads rather than each doing its own load.
+//
+// Only inputs with a 32-bit data format of one, two or four channels are coalesced. Their buffer loads return the
+// raw dwords whatever the numeric format, so a load of up to four dwords can be split back into the inputs without
+// any conversion.
+//
+// @param descriptions : Descriptions of the vertex inputs that are fetched, none of them with 16-bit fetches
+// @param builder : Builder with insert point set at a place that dominates all the vertex fetches
+void VertexFetchImpl::coalesceVertexFetches(ArrayRef<const VertexInputDescription *> descriptions,
+                                            BuilderBase &builder) {
+  // Data formats of combined fetches of two, three and four dwords
+  static const BufDataFormat CombinedDfmts[] = {BufDataFormat32_32, BufDataFormat32_32_32, BufDataFormat32_32_32_32};
+
+  // Group the inputs that can be coalesced by binding, stride and input rate, in offset order.
+  std::map<std::tuple<unsigned, unsigned, unsigned>, SmallVector<const VertexInputDescription *, 8>> groups;
+  for (const VertexInputDescription *description : descriptions) {
+    if (canCoalesceVertexFetch(description))
+      groups[std::make_tuple(description->binding, description->stride, description->inputRate)].push_back(
+          description);
+  }
+
+  for (auto &group : groups) {
+    auto &members = group.second;
+    std::sort(members.begin(), members.end(),
+              [](const VertexInputDescription *lhs, const VertexInputDescription *rhs) {
+                return lhs->offset < rhs->offset;
+              });
+
+    for (unsigned first = 0; first < members.size();) {
+      // Find the longest run of contiguous inputs from here that fits in four dwords and can be done as one load.
+      unsigned runLength = 1;
+      unsigned runDwords = getVertexFormatInfo(members[first]).numChannels;
+      unsigned bestLength = 1;
+      unsigned bestDwords = runDwords;
+      for (unsigned next = first + 1; next < members.size(); ++next) {
+        unsigned nextDwords = getVertexFormatInfo(members[next]).numChannels;
+        if (members[next]->offset != members[first]->offset + runDwords * 4 || runDwords + nextDwords > 4)
+          break;
+        ++runLength;
+        runDwords += nextDwords;
+        // The combined fetch must be a single load; see the alignment check in addVertexFetchInst.
+        const VertexCompFormatInfo *formatInfo = getVertexComponentFormatInfo(CombinedDfmts[runDwords - 2]);
+        if (members[first]->offset % formatInfo->vertexByteSize == 0 &&
+            members[first]->stride % formatInfo->vertexByteSize == 0) {
+          bestLength = runLength;
+          bestDwords = runDwords;
+        }
+      }
+
+      if (bestLength == 1) {
+        ++first;
+        continue;
+      }
+
+      // Do the combined fetch.
+      Instruction *insertPos = &*builder.GetInsertPoint();
+      Value *vbDesc = loadVertexBufferDescriptor(members[first]->binding, builder);
+      Value *vbIndex = getVertexBufferIndex(members[first], builder);
+      Value *combinedFetch = nullptr;
+      addVertexFetchInst(vbDesc, bestDwords, /*is16bitFetch=*/false, vbIndex, members[first]->offset,
+                         members[first]->stride, CombinedDfmts[bestDwords - 2], BufNumFormatUint, insertPos,
+                         &combinedFetch);
+
+      // Split it into the individual inputs, each in the form that fetching it alone would have given.
+      unsigned dwordIdx = 0;
+      for (unsigned idx = first; idx != first + bestLength; ++idx) {
+        unsigned numChannels = getVertexFormatInfo(members[idx]).numChannels;
+        Value *fetch = nullptr;
+        if (numChannels == 1)
+          fetch = builder.CreateExtractElement(combinedFetch, dwordIdx);
+        else {
+          // A run of more than one input can only contain one- and two-channel inputs.
+          assert(numChannels == 2);
+          int indices[] = {int(dwordIdx), int(dwordIdx) + 1};
+          fetch = builder.CreateShuffleVector(combinedFetch, combinedFetch, indices);
+        }
+        m_coalescedFetches[members[idx]] = fetch;
+        dwordIdx += numChannels;
+      }
+      first += bestLength;
+    }
+  }
+}
+
+// =====================================================================================================================
+// Checks whether a vertex input can be fetched as part of a coalesced fetch.
+//
+// @param description : Vertex input description
+bool VertexFetchImpl::canCoalesceVertexFetch(const VertexInputDescription *description) const {
+  // A zero stride means the buffer range is checked in bytes rather than in whole vertices, so a combined load
+  // could go out of bounds where the individual loads would not.
+  if (description->stride == 0)
+    return false;
+  if (description->dfmt != BufDataFormat32 && description->dfmt != BufDataFormat32_32 &&
+      description->dfmt != BufDataFormat32_32_32_32)
+    return false;
+  return description->nfmt == BufNumFormatUint || description->nfmt == BufNumFormatSint ||
+         description->nfmt == BufNumFormatFloat;
+}
+
+// =====================================================================================================================
+// Gets the index into the vertex buffer of the current vertex or instance for a vertex input.
+//
+// @param description : Vertex input description
+// @param builder : Builder with insert point set
+Value *VertexFetchImpl::getVertexBufferIndex(const VertexInputDescription *description, BuilderBase &builder) {
+  Instruction *insertPos = &*builder.GetInsertPoint();
+  Value *vbIndex = nullptr;
+  if (description->inputRate == VertexInputRateVertex) {
+    // Use vertex index
+    if (!m_vertexIndex) {
+      auto savedInsertPoint = builder.saveIP();
+      builder.SetInsertPoint(&*insertPos->getFunction()->front().getFirstInsertionPt());
+      m_vertexIndex = ShaderInputs::getVertexIndex(builder);
+      builder.restoreIP(savedInsertPoint);
+    }
+    vbIndex = m_vertexIndex;
+  } else {
+    if (description->inputRate == VertexInputRateNone) {
+      vbIndex = ShaderInputs::getSpecialUserData(UserDataMapping::BaseInstance, builder);
+    } else if (description->inputRate == VertexInputRateInstance) {
+      // Use instance index
+      if (!m_instanceIndex) {
+        auto savedInsertPoint = builder.saveIP();
+        builder.SetInsertPoint(&*insertPos->getFunction()->front().getFirstInsertionPt());
+        m_instanceIndex = ShaderInputs::getInstanceIndex(builder);
+        builder.restoreIP(savedInsertPoint);
+      }
+      vbIndex = m_instanceIndex;
+    } else {
+      // There is a divisor.
+      vbIndex = builder.CreateUDiv(ShaderInputs::getInput(ShaderInput::InstanceId, builder),
+                                   builder.getInt32(description->inputRate));
+      vbIndex = builder.CreateAdd(vbIndex, ShaderInputs::getSpecialUserData(UserDataMapping::BaseInstance, builder));
+    }
+  }
+  return vbIndex;
+}
+
 // =====================================================================================================================
 // Gets info from table according to vertex attribute format.
 //
@@ -1101,28 +1274,20 @@ void VertexFetchImpl::addVertexFetchInst(Value *vbDesc, unsigned numChannels, bo
 }
 
 // =====================================================================================================================
-// Checks whether post shuffle is required for vertex fetch oepration.
+// Gets the order in which the components of a vertex input are found in its fetch result, for a swizzled format
+// whose fetch returns them in a different order from the vertex input. Returns an empty array if there is no swizzle.
 //
 // @param inputDesc : Vertex input description
-// @param [out] shuffleMask : Vector shuffle mask
-bool VertexFetchImpl::needPostShuffle(const VertexInputDescription *inputDesc,
-                                      std::vector<Constant *> &shuffleMask) const {
-  bool needShuffle = false;
+ArrayRef<unsigned> VertexFetchImpl::getFetchSwizzle(const VertexInputDescription *inputDesc) {
+  static const unsigned BgraSwizzle[] = {2, 1, 0, 3};
 
   switch (inputDesc->dfmt) {
   case BufDataFormat8_8_8_8_Bgra:
   case BufDataFormat2_10_10_10_Bgra:
-    shuffleMask.push_back(ConstantInt::get(Type::getInt32Ty(*m_context), 2));
-    shuffleMask.push_back(ConstantInt::get(Type::getInt32Ty(*m_context), 1));
-    shuffleMask.push_back(ConstantInt::get(Type::getInt32Ty(*m_context), 0));
-    shuffleMask.push_back(ConstantInt::get(Type::getInt32Ty(*m_context), 3));
-    needShuffle = true;
-    break;
+    return BgraSwizzle;
   default:
-    break;
+    return {};
   }
-
-  return needShuffle;
 }
 
 // =====================================================================================================================
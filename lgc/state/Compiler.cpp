@@ -31,10 +31,12 @@
 #include "lgc/LgcContext.h"
 #include "lgc/PassManager.h"
 #include "lgc/patch/Patch.h"
+#include "lgc/state/PassManagerCache.h"
 #include "lgc/state/PipelineState.h"
 #include "llvm/Analysis/TargetTransformInfo.h"
 #include "llvm/IR/IRPrintingPasses.h"
 #include "llvm/Linker/Linker.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/Timer.h"
 #include "llvm/Target/TargetMachine.h"
@@ -44,6 +46,18 @@
 using namespace lgc;
 using namespace llvm;
 
+// -cache-pipeline-pass-managers: reuse whole-pipeline pass managers across compiles in the same LgcContext
+static cl::opt<bool> CachePipelinePassManagers("cache-pipeline-pass-managers",
+                                               cl::desc("Reuse the whole-pipeline pass manager for pipelines of the "
+                                                        "same shape compiled in the same LgcContext"),
+                                               cl::init(false));
+
+// -link-into-first-module: link the other shader modules into the first one rather than into a new empty module
+static cl::opt<bool> LinkIntoFirstModule("link-into-first-module",
+                                         cl::desc("Link a multi-shader pipeline by moving the other shader modules "
+                                                  "into the first one instead of into a new empty module"),
+                                         cl::init(false));
+
 namespace lgc {
 // Create BuilderReplayer pass
 ModulePass *createBuilderReplayer(Pipeline *pipeline);
@@ -67,8 +81,8 @@ Module *PipelineState::irLink(ArrayRef<std::pair<Module *, ShaderStage>> modules
     if (!module)
       continue;
 
-    // If this is a link of shader modules from earlier separate shader compiles, then the modes are
-    // recorded in IR metadata. Read the modes here.
+    // If this shader module was translated without this pipeline state, as by an earlier separate shader compile
+    // or on another thread, then its modes are recorded in IR metadata. Read the modes here.
     getShaderModes()->readModesFromShader(module, stage);
 
     // Add IR metadata for the shader stage to each function in the shader, and rename the entrypoint to
@@ -92,8 +106,10 @@ Module *PipelineState::irLink(ArrayRef<std::pair<Module *, ShaderStage>> modules
   assert(shaderStageMask == getShaderStageMask());
 #endif
 
-  // If the front-end was using a BuilderRecorder, record pipeline state into IR metadata.
-  if (!m_noReplayer)
+  // The pipeline state stays in this object and is handed directly to the middle-end passes by generate(), so
+  // it only needs recording into IR metadata when the linked module is being written out for -emit-lgc.
+  m_irLinked = true;
+  if (m_emitLgc)
     record(modules[0].first);
 
   // If there is only one shader, just change the name on its module and return it.
@@ -102,17 +118,24 @@ Module *PipelineState::irLink(ArrayRef<std::pair<Module *, ShaderStage>> modules
     pipelineModule = modules[0].first;
     pipelineModule->setModuleIdentifier("lgcPipeline");
   } else {
-    // Create an empty module then link each shader module into it. We record pipeline state into IR
-    // metadata before the link, to avoid problems with a Constant for an immutable descriptor value
-    // disappearing when modules are deleted.
+    // Create an empty module then link each shader module into it. With -link-into-first-module, the first
+    // shader module serves as the pipeline module instead, so its globals, declarations and metadata are kept in
+    // place and only the other shader modules are cloned and merged into it.
     bool result = true;
-    pipelineModule = new Module("lgcPipeline", getContext());
+    unsigned firstModuleToLink = 0;
+    if (LinkIntoFirstModule) {
+      pipelineModule = modules[0].first;
+      pipelineModule->setModuleIdentifier("lgcPipeline");
+      pipelineModule->setSourceFileName("lgcPipeline");
+      firstModuleToLink = 1;
+    } else
+      pipelineModule = new Module("lgcPipeline", getContext());
     TargetMachine *targetMachine = getLgcContext()->getTargetMachine();
     pipelineModule->setTargetTriple(targetMachine->getTargetTriple().getTriple());
     pipelineModule->setDataLayout(targetMachine->createDataLayout());
 
     Linker linker(*pipelineModule);
-    for (auto moduleAndStage : modules) {
+    for (auto moduleAndStage : modules.drop_front(firstModuleToLink)) {
       Module *module = moduleAndStage.first;
       // NOTE: We use unique_ptr here. The shader module will be destroyed after it is
       // linked into pipeline module.
@@ -157,32 +180,117 @@ bool PipelineState::generate(std::unique_ptr<Module> pipelineModule, raw_pwrite_
   assert(otherElf.getBuffer().empty() && "otherElf not supported yet");
 
   m_lastError.clear();
-  unsigned passIndex = 1000;
   Timer *patchTimer = timers.size() >= 1 ? timers[0] : nullptr;
   Timer *optTimer = timers.size() >= 2 ? timers[1] : nullptr;
   Timer *codeGenTimer = timers.size() >= 3 ? timers[2] : nullptr;
 
+  // Codegen runs at the optimization level asked for by the compiler instance, and the fast compile tier also caps
+  // it at a lower level. The target machine is shared by all compiles in the LgcContext, so its level is restored
+  // when this compile is done.
+  TargetMachine *targetMachine = getLgcContext()->getTargetMachine();
+  CodeGenOpt::Level savedOptLevel = targetMachine->getOptLevel();
+  CodeGenOpt::Level optLevel = savedOptLevel;
+  if (getOptions().optLevel != 0)
+    optLevel = static_cast<CodeGenOpt::Level>(getOptions().optLevel - 1);
+  if (getOptions().fastCompile && optLevel > CodeGenOpt::Less)
+    optLevel = CodeGenOpt::Less;
+  targetMachine->setOptLevel(optLevel);
+
   // Set up "whole pipeline" passes, where we have a single module representing the whole pipeline.
-  std::unique_ptr<PassManager> passMgr(PassManager::Create());
-  passMgr->setPassIndex(&passIndex);
-  passMgr->add(createTargetTransformInfoWrapperPass(getLgcContext()->getTargetMachine()->getTargetIRAnalysis()));
+  // The timers are owned by the client for the duration of one compile, so a pass manager with timers is never
+  // cached.
+  std::unique_ptr<PassManager> uncachedPassMgr;
+  PassManager *passMgr = nullptr;
+  PipelineStateWrapper *pipelineStateWrapper = nullptr;
+  CachedPassManager *cachedPassMgr = nullptr;
+  if (CachePipelinePassManagers && !patchTimer && !optTimer && !codeGenTimer) {
+    PassManagerInfo info;
+    memset(&info, 0, sizeof(info));
+    info.emitLgc = m_emitLgc;
+    info.noReplayer = m_noReplayer;
+    info.isGraphics = isGraphics();
+    info.nggDisabled = (getOptions().nggFlags & NggFlagDisable) != 0;
+    info.includeIr = getOptions().includeIr;
+    info.fastCompile = getOptions().fastCompile;
+    info.stageMask = getShaderStageMask();
+    info.optLevel = targetMachine->getOptLevel();
+
+    cachedPassMgr = &getLgcContext()->getPassManagerCache()->getPipelinePassManager(
+        info, outStream, [this](CachedPassManager &cached, raw_pwrite_stream &proxyStream) {
+          // The passes are shared by all compiles using this pass manager, so the shader cache check pass calls
+          // through to the callback of the current compile.
+          CachedPassManager *cachedPtr = &cached;
+          cached.passManager.reset(PassManager::Create());
+          cached.pipelineStateWrapper = addPasses(
+              *cached.passManager, {},
+              [cachedPtr](const Module *module, unsigned stageMask, ArrayRef<ArrayRef<uint8_t>> stageHashes) {
+                if (!cachedPtr->checkShaderCacheFunc)
+                  return stageMask;
+                return cachedPtr->checkShaderCacheFunc(module, stageMask, stageHashes);
+              },
+              proxyStream);
+        });
+    cachedPassMgr->checkShaderCacheFunc = checkShaderCacheFunc;
+    passMgr = &*cachedPassMgr->passManager;
+    pipelineStateWrapper = cachedPassMgr->pipelineStateWrapper;
+  } else {
+    uncachedPassMgr.reset(PassManager::Create());
+    pipelineStateWrapper = addPasses(*uncachedPassMgr, timers, checkShaderCacheFunc, outStream);
+    passMgr = &*uncachedPassMgr;
+  }
+
+  // If we were not using BuilderRecorder, or the module was linked by irLink on this PipelineState, give our
+  // PipelineState to the PipelineStateWrapper pass. (Otherwise, for example when the lgc tool compiles a module
+  // read from a file, the first time PipelineStateWrapper is used, it allocates its own PipelineState and
+  // populates it by reading IR metadata.)
+  if (m_noReplayer || m_irLinked)
+    pipelineStateWrapper->setPipelineState(this);
+
+  // Run the "whole pipeline" passes.
+  passMgr->run(*pipelineModule);
+
+  // Drop the callback so the cached pass manager does not keep references into this compile.
+  if (cachedPassMgr)
+    cachedPassMgr->checkShaderCacheFunc = nullptr;
+  targetMachine->setOptLevel(savedOptLevel);
+
+  // See if there was a recoverable error.
+  if (getLastError() != "")
+    return false;
+
+  return true;
+}
+
+// =====================================================================================================================
+// Add the "whole pipeline" passes to a pass manager: patching, middle-end optimizations and backend codegen.
+//
+// @param [in/out] passMgr : Pass manager to add passes to
+// @param timers : Optional timers for 0 or more of patch passes, LLVM optimizations and codegen (see generate())
+// @param checkShaderCacheFunc : Function to check shader cache in graphics pipeline
+// @param [out] outStream : Stream to write ELF or IR disassembly output
+// @return : The PipelineStateWrapper pass added to the pass manager
+PipelineStateWrapper *PipelineState::addPasses(PassManager &passMgr, ArrayRef<Timer *> timers,
+                                               Pipeline::CheckShaderCacheFunc checkShaderCacheFunc,
+                                               raw_pwrite_stream &outStream) {
+  unsigned passIndex = 1000;
+  Timer *patchTimer = timers.size() >= 1 ? timers[0] : nullptr;
+  Timer *optTimer = timers.size() >= 2 ? timers[1] : nullptr;
+  Timer *codeGenTimer = timers.size() >= 3 ? timers[2] : nullptr;
+
+  passMgr.setPassIndex(&passIndex);
+  passMgr.add(createTargetTransformInfoWrapperPass(getLgcContext()->getTargetMachine()->getTargetIRAnalysis()));
 
   // Manually add a target-aware TLI pass, so optimizations do not think that we have library functions.
-  getLgcContext()->preparePassManager(&*passMgr);
+  getLgcContext()->preparePassManager(&passMgr);
 
   // Manually add a PipelineStateWrapper pass.
-  // If we were not using BuilderRecorder, give our PipelineState to it. (In the BuilderRecorder case,
-  // the first time PipelineStateWrapper is used, it allocates its own PipelineState and populates
-  // it by reading IR metadata.)
   PipelineStateWrapper *pipelineStateWrapper = new PipelineStateWrapper(getLgcContext());
-  passMgr->add(pipelineStateWrapper);
-  if (m_noReplayer)
-    pipelineStateWrapper->setPipelineState(this);
+  passMgr.add(pipelineStateWrapper);
 
   if (m_emitLgc) {
     // -emit-lgc: Just write the module.
-    passMgr->add(createPrintModulePass(outStream));
-    passMgr->stop();
+    passMgr.add(createPrintModulePass(outStream));
+    passMgr.stop();
   }
 
   // Get a BuilderReplayer pass if needed.
@@ -191,22 +299,18 @@ bool PipelineState::generate(std::unique_ptr<Module> pipelineModule, raw_pwrite_
     replayerPass = createBuilderReplayer(this);
 
   // Patching.
-  Patch::addPasses(this, *passMgr, replayerPass, patchTimer, optTimer, checkShaderCacheFunc);
+  Patch::addPasses(this, passMgr, replayerPass, patchTimer, optTimer, checkShaderCacheFunc);
 
   // Add pass to clear pipeline state from IR
-  passMgr->add(createPipelineStateClearer());
+  passMgr.add(createPipelineStateClearer());
 
   // Code generation.
-  getLgcContext()->addTargetPasses(*passMgr, codeGenTimer, outStream);
+  getLgcContext()->addTargetPasses(passMgr, codeGenTimer, outStream);
 
-  // Run the "whole pipeline" passes.
-  passMgr->run(*pipelineModule);
+  // The pass index is only used while adding passes.
+  passMgr.setPassIndex(nullptr);
 
-  // See if there was a recoverable error.
-  if (getLastError() != "")
-    return false;
-
-  return true;
+  return pipelineStateWrapper;
 }
 
 // =====================================================================================================================
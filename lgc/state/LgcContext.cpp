@@ -43,10 +43,13 @@
 #include "llvm/InitializePasses.h"
 #include "llvm/Support/CodeGen.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Mutex.h"
 #include "llvm/Support/TargetRegistry.h"
 #include "llvm/Support/TargetSelect.h"
 #include "llvm/Target/TargetMachine.h"
 #include "llvm/Target/TargetOptions.h"
+#include <map>
+#include <mutex>
 
 #define DEBUG_TYPE "lgc-context"
 
@@ -149,6 +152,26 @@ void LgcContext::initialize() {
   setOptionDefault("amdgpu-conditional-discard-transformations", "1");
 }
 
+namespace {
+
+// Target machines given back by destroyed LgcContexts, for reuse by later LgcContexts for the same target. Creating a
+// target machine, and the subtarget and TTI state it builds on the first compile, costs milliseconds and megabytes, so
+// this keeps growing the LLPC context pool cheap. A target machine is never shared by live LgcContexts, as a compile
+// changes its state (such as the optimization level), so concurrent compiles are unaffected.
+struct TargetMachinePool {
+  sys::Mutex mutex;
+  std::multimap<std::string, std::unique_ptr<TargetMachine>> freeMachines; // Keyed by LgcContext::m_targetMachineKey
+};
+
+} // anonymous namespace
+
+// =====================================================================================================================
+// Get the process-wide pool of free target machines.
+static TargetMachinePool &getTargetMachinePool() {
+  static TargetMachinePool pool;
+  return pool;
+}
+
 // =====================================================================================================================
 // Create the LgcContext. Returns nullptr on failure to recognize the AMDGPU target whose name is specified
 //
@@ -170,6 +193,22 @@ LgcContext *LgcContext::Create(LLVMContext &context, StringRef gpuName, unsigned
     return nullptr;
   }
 
+  // Reuse a target machine for this target from a destroyed LgcContext if there is one. Everything that
+  // createTargetMachine is given below is constant apart from the GPU name and -show-encoding.
+  builderContext->m_targetMachineKey = gpuName.str();
+  if (ShowEncoding)
+    builderContext->m_targetMachineKey += "+show-encoding";
+  {
+    TargetMachinePool &pool = getTargetMachinePool();
+    std::lock_guard<sys::Mutex> lock(pool.mutex);
+    auto it = pool.freeMachines.find(builderContext->m_targetMachineKey);
+    if (it != pool.freeMachines.end()) {
+      builderContext->m_targetMachine = it->second.release();
+      pool.freeMachines.erase(it);
+      return builderContext;
+    }
+  }
+
   // Get the LLVM target and create the target machine. This should not fail, as we determined above
   // that we support the requested target.
   const std::string triple = "amdgcn--amdpal";
@@ -201,9 +240,16 @@ LgcContext::LgcContext(LLVMContext &context, unsigned palAbiVersion) : m_context
 
 // =====================================================================================================================
 LgcContext::~LgcContext() {
-  delete m_targetMachine;
+  if (m_targetMachine) {
+    // Give the target machine back for reuse by a later LgcContext.
+    TargetMachinePool &pool = getTargetMachinePool();
+    std::lock_guard<sys::Mutex> lock(pool.mutex);
+    pool.freeMachines.emplace(m_targetMachineKey, std::unique_ptr<TargetMachine>(m_targetMachine));
+  }
   delete m_targetInfo;
   delete m_passManagerCache;
+  delete m_freeBuilderRecorder;
+  delete m_freeBuilderImpl;
 }
 
 // =====================================================================================================================
@@ -221,11 +267,42 @@ Pipeline *LgcContext::createPipeline() {
 // @param pipeline : Pipeline object for pipeline compile, nullptr for shader compile
 // @param useBuilderRecorder : true to use BuilderRecorder, false to use BuilderImpl
 Builder *LgcContext::createBuilder(Pipeline *pipeline, bool useBuilderRecorder) {
-  if (!pipeline || useBuilderRecorder || EmitLgc)
+  const bool wantRecorder = !pipeline || useBuilderRecorder || EmitLgc;
+
+  // Re-target a free Builder of the right kind if there is one. A BuilderRecorder that omits opcodes for -emit-lgc is
+  // never kept, so a free one always records them.
+  Builder *&freeBuilder = wantRecorder ? m_freeBuilderRecorder : m_freeBuilderImpl;
+  if (freeBuilder && !EmitLgc) {
+    Builder *builder = freeBuilder;
+    freeBuilder = nullptr;
+    builder->setPipeline(pipeline);
+    return builder;
+  }
+
+  if (wantRecorder)
     return Builder::createBuilderRecorder(this, pipeline, EmitLgc);
   return Builder::createBuilderImpl(this, pipeline);
 }
 
+// =====================================================================================================================
+// Give back a Builder created by createBuilder() once its compile is done, keeping it for reuse.
+//
+// @param builder : Builder to give back, or nullptr
+void LgcContext::releaseBuilder(Builder *builder) {
+  if (!builder)
+    return;
+  if (EmitLgc) {
+    delete builder;
+    return;
+  }
+
+  // Drop the references to the finished compile's IR and pipeline before keeping the builder.
+  builder->setPipeline(nullptr);
+  Builder *&freeBuilder = builder->isBuilderRecorder() ? m_freeBuilderRecorder : m_freeBuilderImpl;
+  delete freeBuilder;
+  freeBuilder = builder;
+}
+
 // =====================================================================================================================
 // Prepare a pass manager. This manually adds a target-aware TLI pass, so middle-end optimizations do not think that
 // we have library functions.
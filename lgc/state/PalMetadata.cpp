@@ -158,6 +158,9 @@ void PalMetadata::mergeFromBlob(StringRef blob) {
             *destNode = srcNode;
             return 0;
           }
+          // The fragment shader keeps its name when the linker glues a color export shader on to its end.
+          if (srcNode.getString() == ColorExportEntryName)
+            return 0;
         }
         // Disallow merging other than uint.
         if (destNode->getKind() != msgpack::Type::UInt || srcNode.getKind() != msgpack::Type::UInt)
@@ -170,6 +173,11 @@ void PalMetadata::mergeFromBlob(StringRef blob) {
             // wave32. (This relies on the glue shader's PAL metadata being merged into the vertex-processing
             // half-pipeline, rather than the other way round.)
             return 0;
+          case mmSPI_PS_INPUT_ENA:
+          case mmSPI_PS_INPUT_ADDR:
+            // Ignore the PS input enables of the color export shader. Its args are the values returned by the
+            // fragment shader, not PS inputs, so they must not change which inputs the fragment shader gets.
+            return 0;
           case mmSPI_SHADER_PGM_RSRC1_LS:
           case mmSPI_SHADER_PGM_RSRC1_HS:
           case mmSPI_SHADER_PGM_RSRC1_ES:
@@ -360,16 +368,33 @@ void PalMetadata::fixUpRegisters() {
       regRanges = Gfx10RegRanges;
   }
 
-  // First find the descriptor sets and push const nodes.
+  // First find the descriptor sets and push const nodes. For a set whose descriptors are in the root table, find the
+  // extent of them in user data instead.
   SmallVector<const ResourceNode *, 4> descSetNodes;
-  const ResourceNode *pushConstNode;
+  SmallVector<unsigned, 4> rootDescSetExtents;
+  const ResourceNode *pushConstNode = nullptr;
   for (const auto &node : m_pipelineState->getUserDataNodes()) {
-    if (node.type == ResourceNodeType::DescriptorTableVaPtr && !node.innerTable.empty()) {
-      unsigned descSet = node.innerTable[0].set;
-      descSetNodes.resize(std::max(unsigned(descSetNodes.size()), descSet + 1));
-      descSetNodes[descSet] = &node;
-    } else if (node.type == ResourceNodeType::PushConst) {
+    switch (node.type) {
+    case ResourceNodeType::DescriptorTableVaPtr:
+      if (!node.innerTable.empty()) {
+        unsigned descSet = node.innerTable[0].set;
+        descSetNodes.resize(std::max(unsigned(descSetNodes.size()), descSet + 1));
+        descSetNodes[descSet] = &node;
+      }
+      break;
+    case ResourceNodeType::PushConst:
       pushConstNode = &node;
+      break;
+    case ResourceNodeType::DescriptorResource:
+    case ResourceNodeType::DescriptorSampler:
+    case ResourceNodeType::DescriptorCombinedTexture:
+    case ResourceNodeType::DescriptorTexelBuffer:
+    case ResourceNodeType::DescriptorBuffer:
+      rootDescSetExtents.resize(std::max(unsigned(rootDescSetExtents.size()), node.set + 1));
+      rootDescSetExtents[node.set] = std::max(rootDescSetExtents[node.set], node.offsetInDwords + node.sizeInDwords);
+      break;
+    default:
+      break;
     }
   }
 
@@ -387,13 +412,20 @@ void PalMetadata::fixUpRegisters() {
         unsigned descSet = value - static_cast<unsigned>(UserDataMapping::DescriptorSet0);
         if (descSet <= static_cast<unsigned>(UserDataMapping::DescriptorSetMax) -
                            static_cast<unsigned>(UserDataMapping::DescriptorSet0)) {
-          // This entry is a descriptor set pointer. Replace it with the dword offset for that descriptor set.
-          if (descSet >= descSetNodes.size() || !descSetNodes[descSet])
+          // This entry is a descriptor set pointer. Replace it with the dword offset for that descriptor set, or
+          // with the spill table for a set whose descriptors are in the root table, as their relocated offsets are
+          // offsets in the spill table.
+          if (descSet < descSetNodes.size() && descSetNodes[descSet]) {
+            value = descSetNodes[descSet]->offsetInDwords;
+            it->second = value;
+            unsigned extent = value + descSetNodes[descSet]->sizeInDwords;
+            userDataLimit = std::max(userDataLimit, extent);
+          } else if (descSet < rootDescSetExtents.size() && rootDescSetExtents[descSet] != 0) {
+            it->second = static_cast<unsigned>(UserDataMapping::SpillTable);
+            userDataLimit = std::max(userDataLimit, rootDescSetExtents[descSet]);
+          } else {
             report_fatal_error("Descriptor set " + Twine(descSet) + " not found");
-          value = descSetNodes[descSet]->offsetInDwords;
-          it->second = value;
-          unsigned extent = value + descSetNodes[descSet]->sizeInDwords;
-          userDataLimit = std::max(userDataLimit, extent);
+          }
         } else {
           unsigned pushConstOffset = value - static_cast<unsigned>(UserDataMapping::PushConst0);
           if (pushConstOffset <= static_cast<unsigned>(UserDataMapping::DescriptorSetMax) -
@@ -495,6 +527,37 @@ void PalMetadata::addVertexFetchInfo(ArrayRef<VertexFetchInfo> fetches) {
   }
 }
 
+// =====================================================================================================================
+// Get the scalar or vector type from a type name written by getTypeName
+//
+// @param tyName : Type name, such as "f32" or "v4i16"
+// @param context : LLVM context
+static Type *getTypeFromName(StringRef tyName, LLVMContext &context) {
+  unsigned vecLength = 0;
+  if (tyName[0] == 'v') {
+    tyName = tyName.drop_front();
+    tyName.consumeInteger(10, vecLength);
+  }
+  Type *ty = nullptr;
+  if (tyName == "i8")
+    ty = Type::getInt8Ty(context);
+  else if (tyName == "i16")
+    ty = Type::getInt16Ty(context);
+  else if (tyName == "i32")
+    ty = Type::getInt32Ty(context);
+  else if (tyName == "i64")
+    ty = Type::getInt64Ty(context);
+  else if (tyName == "f16")
+    ty = Type::getHalfTy(context);
+  else if (tyName == "f32")
+    ty = Type::getFloatTy(context);
+  else if (tyName == "f64")
+    ty = Type::getDoubleTy(context);
+  if (vecLength != 0)
+    ty = FixedVectorType::get(ty, vecLength);
+  return ty;
+}
+
 // =====================================================================================================================
 // Get the count of vertex fetches for a fetchless vertex shader with shader compilation (or 0 otherwise).
 unsigned PalMetadata::getVertexFetchCount() {
@@ -519,29 +582,7 @@ void PalMetadata::getVertexFetchInfo(SmallVectorImpl<VertexFetchInfo> &fetches)
     msgpack::ArrayDocNode fetchNode = m_vertexInputs[i].getArray();
     unsigned location = fetchNode[0].getUInt();
     unsigned component = fetchNode[1].getUInt();
-    StringRef tyName = fetchNode[2].getString();
-    unsigned vecLength = 0;
-    if (tyName[0] == 'v') {
-      tyName = tyName.drop_front();
-      tyName.consumeInteger(10, vecLength);
-    }
-    Type *ty = nullptr;
-    if (tyName == "i8")
-      ty = Type::getInt8Ty(m_pipelineState->getContext());
-    else if (tyName == "i16")
-      ty = Type::getInt16Ty(m_pipelineState->getContext());
-    else if (tyName == "i32")
-      ty = Type::getInt32Ty(m_pipelineState->getContext());
-    else if (tyName == "i64")
-      ty = Type::getInt64Ty(m_pipelineState->getContext());
-    else if (tyName == "f16")
-      ty = Type::getHalfTy(m_pipelineState->getContext());
-    else if (tyName == "f32")
-      ty = Type::getFloatTy(m_pipelineState->getContext());
-    else if (tyName == "f64")
-      ty = Type::getDoubleTy(m_pipelineState->getContext());
-    if (vecLength != 0)
-      ty = FixedVectorType::get(ty, vecLength);
+    Type *ty = getTypeFromName(fetchNode[2].getString(), m_pipelineState->getContext());
     fetches.push_back({location, component, ty});
   }
   m_pipelineNode.erase(m_document->getNode(PipelineMetadataKey::VertexInputs));
@@ -642,3 +683,54 @@ void PalMetadata::getVsEntryRegInfo(VsEntryRegInfo &regInfo) {
   if (m_pipelineState->getTargetInfo().getGfxIpVersion().major < 10)
     regInfo.wave32 = false;
 }
+
+// =====================================================================================================================
+// Store the color exports in PAL metadata for a fragment shader whose color exports are done by a color export
+// shader that the linker glues on to its end.
+//
+// @param exports : Array of ColorExportInfo structs, in the order the fragment shader returns the values
+// @param fsInfo : Other fragment shader information needed by the color export shader
+void PalMetadata::addColorExportInfo(ArrayRef<ColorExportInfo> exports, const FsExportInfo &fsInfo) {
+  // Each color export is an array containing {hwColorTarget,location,isSigned,type}.
+  // .colorExports is an array containing the color exports.
+  m_colorExports = m_pipelineNode[PipelineMetadataKey::ColorExports].getArray(true);
+  for (const ColorExportInfo &exp : exports) {
+    msgpack::ArrayDocNode exportNode = m_document->getArrayNode();
+    exportNode.push_back(m_document->getNode(exp.hwColorTarget));
+    exportNode.push_back(m_document->getNode(exp.location));
+    exportNode.push_back(m_document->getNode(unsigned(exp.isSigned)));
+    exportNode.push_back(m_document->getNode(getTypeName(exp.ty), /*copy=*/true));
+    m_colorExports.push_back(exportNode);
+  }
+  m_pipelineNode[PipelineMetadataKey::ColorExportDummy] = unsigned(fsInfo.dummyExport);
+  m_pipelineNode[PipelineMetadataKey::ColorExportWave32] = unsigned(fsInfo.wave32);
+}
+
+// =====================================================================================================================
+// Get the color export information out of PAL metadata. Used by the linker to generate the color export shader.
+// Also removes the color export information, so it does not appear in the final linked ELF.
+//
+// @param [out] exports : Vector to store info of each color export
+// @param [out] fsInfo : Where to store the other fragment shader information
+void PalMetadata::getColorExportInfo(SmallVectorImpl<ColorExportInfo> &exports, FsExportInfo &fsInfo) {
+  fsInfo = {};
+  if (m_colorExports.isEmpty()) {
+    auto it = m_pipelineNode.find(m_document->getNode(PipelineMetadataKey::ColorExports));
+    if (it == m_pipelineNode.end() || !it->second.isArray())
+      return;
+    m_colorExports = it->second.getArray();
+  }
+  for (unsigned i = 0, e = m_colorExports.size(); i != e; ++i) {
+    msgpack::ArrayDocNode exportNode = m_colorExports[i].getArray();
+    unsigned hwColorTarget = exportNode[0].getUInt();
+    unsigned location = exportNode[1].getUInt();
+    bool isSigned = exportNode[2].getUInt() != 0;
+    Type *ty = getTypeFromName(exportNode[3].getString(), m_pipelineState->getContext());
+    exports.push_back({hwColorTarget, location, isSigned, ty});
+  }
+  fsInfo.dummyExport = m_pipelineNode[PipelineMetadataKey::ColorExportDummy].getUInt() != 0;
+  fsInfo.wave32 = m_pipelineNode[PipelineMetadataKey::ColorExportWave32].getUInt() != 0;
+  m_pipelineNode.erase(m_document->getNode(PipelineMetadataKey::ColorExports));
+  m_pipelineNode.erase(m_document->getNode(PipelineMetadataKey::ColorExportDummy));
+  m_pipelineNode.erase(m_document->getNode(PipelineMetadataKey::ColorExportWave32));
+}
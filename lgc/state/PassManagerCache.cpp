@@ -40,45 +40,19 @@
 using namespace lgc;
 using namespace llvm;
 
-namespace lgc {
-
-// =====================================================================================================================
-// Information on how to create a pass manager. This is used as the key in the pass manager cache.
-struct PassManagerInfo {
-  bool isGlue;
-};
-
-} // namespace lgc
-
 // =====================================================================================================================
 // Get pass manager for glue shader compilation
 //
 // @param outStream : Stream to output ELF info
 lgc::PassManager &PassManagerCache::getGlueShaderPassManager(raw_pwrite_stream &outStream) {
-  PassManagerInfo info = {};
+  PassManagerInfo info;
+  memset(&info, 0, sizeof(info));
   info.isGlue = true;
-  return getPassManager(info, outStream);
-}
-
-// =====================================================================================================================
-// Get pass manager given a PassManagerInfo
-//
-// @param info : PassManagerInfo to direct how to create the pass manager
-// @param outStream : Stream to output ELF info
-lgc::PassManager &PassManagerCache::getPassManager(const PassManagerInfo &info, raw_pwrite_stream &outStream) {
-  // Set our single proxy stream to use the provided stream.
-  m_proxyStream.setUnderlyingStream(&outStream);
-
-  // Check the cache.
-  std::unique_ptr<lgc::PassManager> &passManager =
-      m_cache[StringRef(reinterpret_cast<const char *>(&info), sizeof(info))];
-  if (passManager)
-    return *passManager;
-
-  // Need to create the pass manager.
-  // TODO: Creation of a normal compilation pass manager, not just one for a glue shader.
-  assert(info.isGlue && "Non-glue shader compilation not implemented yet");
+  CachedPassManager &cached = getPassManager(info, outStream);
+  if (cached.passManager)
+    return *cached.passManager;
 
+  std::unique_ptr<lgc::PassManager> &passManager = cached.passManager;
   passManager.reset(PassManager::Create());
   passManager->add(createTargetTransformInfoWrapperPass(m_lgcContext->getTargetMachine()->getTargetIRAnalysis()));
 
@@ -102,3 +76,36 @@ lgc::PassManager &PassManagerCache::getPassManager(const PassManagerInfo &info,
 
   return *passManager;
 }
+
+// =====================================================================================================================
+// Get pass manager for whole-pipeline compilation given a PassManagerInfo. The caller must set up the per-compile
+// state in the returned CachedPassManager before running it.
+//
+// @param info : PassManagerInfo describing the shape of the pass pipeline
+// @param outStream : Stream to output ELF info
+// @param createPasses : Function to create and populate the pass manager if it is not cached yet
+CachedPassManager &
+PassManagerCache::getPipelinePassManager(const PassManagerInfo &info, raw_pwrite_stream &outStream,
+                                         function_ref<void(CachedPassManager &, raw_pwrite_stream &)> createPasses) {
+  assert(!info.isGlue);
+  CachedPassManager &cached = getPassManager(info, outStream);
+  if (!cached.passManager) {
+    createPasses(cached, m_proxyStream);
+    assert(cached.passManager && cached.pipelineStateWrapper);
+  }
+  return cached;
+}
+
+// =====================================================================================================================
+// Get the cache entry for a PassManagerInfo, and redirect the proxy stream used by the cached pass managers to the
+// provided stream. The pass manager in the returned entry is null if it has not been created yet.
+//
+// @param info : PassManagerInfo to direct how to create the pass manager
+// @param outStream : Stream to output ELF info
+CachedPassManager &PassManagerCache::getPassManager(const PassManagerInfo &info, raw_pwrite_stream &outStream) {
+  // Set our single proxy stream to use the provided stream.
+  m_proxyStream.setUnderlyingStream(&outStream);
+
+  // Check the cache.
+  return m_cache[StringRef(reinterpret_cast<const char *>(&info), sizeof(info))];
+}
@@ -50,11 +50,19 @@ static cl::opt<bool> EnableTessOffChip("enable-tess-offchip", cl::desc("Enable t
                                        cl::init(false));
 // -pack-in-out: pack input/output
 static cl::opt<bool> PackInOut("pack-in-out", cl::desc("Pack input/output"), cl::init(true));
+// -pack-in-out-tess: also pack input/output of the TES-FS interface in tessellation pipelines
+static cl::opt<bool> PackInOutTess("pack-in-out-tess",
+                                   cl::desc("Pack input/output of TES-FS in tessellation pipelines"), cl::init(false));
+// -wave-size-heuristic: choose the compute shader wave size from the workgroup size
+static cl::opt<bool> WaveSizeHeuristic("wave-size-heuristic",
+                                       cl::desc("Choose the compute shader wave size from the workgroup size"),
+                                       cl::init(false));
 
 // Names for named metadata nodes when storing and reading back pipeline state
 static const char UnlinkedMetadataName[] = "lgc.unlinked";
 static const char OptionsMetadataName[] = "lgc.options";
 static const char UserDataMetadataName[] = "lgc.user.data.nodes";
+static const char ImageFormatHintsMetadataName[] = "lgc.image.format.hints";
 static const char DeviceIndexMetadataName[] = "lgc.device.index";
 static const char VertexInputsMetadataName[] = "lgc.vertex.inputs";
 static const char IaStateMetadataName[] = "lgc.input.assembly.state";
@@ -490,6 +498,24 @@ void PipelineState::setUserDataNodes(ArrayRef<ResourceNode> nodes) {
   assert(destInnerTable == destTable + nodes.size());
 }
 
+// =====================================================================================================================
+// Set the resource mapping nodes for the pipeline, taking ownership of the buffer they were built in.
+//
+// @param allocNodes : Buffer holding the top-level nodes and all their inner tables
+// @param nodes : The top-level resource mapping nodes, within allocNodes
+void PipelineState::setUserDataNodes(std::unique_ptr<ResourceNode[]> allocNodes, ArrayRef<ResourceNode> nodes) {
+  assert(m_allocUserDataNodes == nullptr);
+  m_allocUserDataNodes = std::move(allocNodes);
+  m_userDataNodes = nodes;
+  for (const ResourceNode &node : nodes) {
+    m_haveConvertingSampler |= (node.type == ResourceNodeType::DescriptorYCbCrSampler);
+    if (node.type == ResourceNodeType::DescriptorTableVaPtr) {
+      for (const ResourceNode &innerNode : node.innerTable)
+        m_haveConvertingSampler |= (innerNode.type == ResourceNodeType::DescriptorYCbCrSampler);
+    }
+  }
+}
+
 // =====================================================================================================================
 // Set one user data table, and its inner tables.
 //
@@ -520,6 +546,8 @@ void PipelineState::setUserDataNodesTable(ArrayRef<ResourceNode> nodes, Resource
 //
 // @param [in/out] module : Module to record the IR metadata in
 void PipelineState::recordUserDataNodes(Module *module) {
+  if (auto formatHintsMetaNode = module->getNamedMetadata(ImageFormatHintsMetadataName))
+    module->eraseNamedMetadata(formatHintsMetaNode);
   if (m_userDataNodes.empty()) {
     if (auto userDataMetaNode = module->getNamedMetadata(UserDataMetadataName))
       module->eraseNamedMetadata(userDataMetaNode);
@@ -528,7 +556,10 @@ void PipelineState::recordUserDataNodes(Module *module) {
 
   auto userDataMetaNode = module->getOrInsertNamedMetadata(UserDataMetadataName);
   userDataMetaNode->clearOperands();
-  recordUserDataTable(m_userDataNodes, userDataMetaNode);
+  // Image format hints are recorded in their own metadata node, so that the user data node metadata keeps its
+  // layout. The node is only created if there is a hint.
+  NamedMDNode *formatHintsMetaNode = nullptr;
+  recordUserDataTable(m_userDataNodes, userDataMetaNode, formatHintsMetaNode);
 }
 
 // =====================================================================================================================
@@ -536,7 +567,9 @@ void PipelineState::recordUserDataNodes(Module *module) {
 //
 // @param nodes : Table of user data nodes
 // @param userDataMetaNode : IR metadata node to record them into
-void PipelineState::recordUserDataTable(ArrayRef<ResourceNode> nodes, NamedMDNode *userDataMetaNode) {
+// @param [in/out] formatHintsMetaNode : IR metadata node to record image format hints into; created when needed
+void PipelineState::recordUserDataTable(ArrayRef<ResourceNode> nodes, NamedMDNode *userDataMetaNode,
+                                        NamedMDNode *&formatHintsMetaNode) {
   IRBuilder<> builder(getContext());
 
   for (const ResourceNode &node : nodes) {
@@ -556,7 +589,7 @@ void PipelineState::recordUserDataTable(ArrayRef<ResourceNode> nodes, NamedMDNod
       // Create the metadata node here.
       userDataMetaNode->addOperand(MDNode::get(getContext(), operands));
       // Create nodes for the sub-table.
-      recordUserDataTable(node.innerTable, userDataMetaNode);
+      recordUserDataTable(node.innerTable, userDataMetaNode, formatHintsMetaNode);
       continue;
     }
     case ResourceNodeType::IndirectUserDataVaPtr:
@@ -570,6 +603,14 @@ void PipelineState::recordUserDataTable(ArrayRef<ResourceNode> nodes, NamedMDNod
       operands.push_back(ConstantAsMetadata::get(builder.getInt32(node.set)));
       // Operand 4: binding
       operands.push_back(ConstantAsMetadata::get(builder.getInt32(node.binding)));
+      if (node.formatHint != ImageFormatHint::Unknown) {
+        if (!formatHintsMetaNode)
+          formatHintsMetaNode = userDataMetaNode->getParent()->getOrInsertNamedMetadata(ImageFormatHintsMetadataName);
+        Metadata *hintOperands[] = {ConstantAsMetadata::get(builder.getInt32(node.set)),
+                                    ConstantAsMetadata::get(builder.getInt32(node.binding)),
+                                    ConstantAsMetadata::get(builder.getInt32(static_cast<unsigned>(node.formatHint)))};
+        formatHintsMetaNode->addOperand(MDNode::get(getContext(), hintOperands));
+      }
       if (node.immutableValue) {
         // Operand 5 onwards: immutable descriptor constant.
         // Writing the constant array directly does not seem to work, as it does not survive IR linking.
@@ -648,6 +689,7 @@ void PipelineState::readUserDataNodes(Module *module) {
         // Operand 4: binding
         nextNode->binding = mdconst::dyn_extract<ConstantInt>(metadataNode->getOperand(4))->getZExtValue();
         nextNode->immutableValue = nullptr;
+        nextNode->formatHint = ImageFormatHint::Unknown;
         if (metadataNode->getNumOperands() >= 6) {
           // Operand 5 onward: immutable descriptor constant
           // The descriptor is either a sampler (<4 x i32>) or converting sampler (<8 x i32>).
@@ -684,6 +726,32 @@ void PipelineState::readUserDataNodes(Module *module) {
     }
   }
   m_userDataNodes = ArrayRef<ResourceNode>(m_allocUserDataNodes.get(), nextOuterNode);
+  readImageFormatHints(module);
+}
+
+// =====================================================================================================================
+// Read image format hints from IR metadata, and apply them to the user data nodes just read
+//
+// @param module : LLVM module
+void PipelineState::readImageFormatHints(Module *module) {
+  auto formatHintsMetaNode = module->getNamedMetadata(ImageFormatHintsMetadataName);
+  if (!formatHintsMetaNode)
+    return;
+
+  // The user data nodes were allocated as one buffer, so all of them, including inner tables, can be walked here.
+  MutableArrayRef<ResourceNode> allNodes(m_allocUserDataNodes.get(),
+                                         module->getNamedMetadata(UserDataMetadataName)->getNumOperands());
+  for (MDNode *hintMetaNode : formatHintsMetaNode->operands()) {
+    unsigned set = mdconst::dyn_extract<ConstantInt>(hintMetaNode->getOperand(0))->getZExtValue();
+    unsigned binding = mdconst::dyn_extract<ConstantInt>(hintMetaNode->getOperand(1))->getZExtValue();
+    auto hint = static_cast<ImageFormatHint>(
+        mdconst::dyn_extract<ConstantInt>(hintMetaNode->getOperand(2))->getZExtValue());
+    for (ResourceNode &node : allNodes) {
+      if (node.type != ResourceNodeType::DescriptorTableVaPtr && node.type != ResourceNodeType::IndirectUserDataVaPtr &&
+          node.type != ResourceNodeType::StreamOutTableVaPtr && node.set == set && node.binding == binding)
+        node.formatHint = hint;
+    }
+  }
 }
 
 // =====================================================================================================================
@@ -736,7 +804,8 @@ PipelineState::findResourceNode(ResourceNodeType nodeType, unsigned descSet, uns
       }
     } else if (node.set == descSet && node.binding == binding) {
       if (nodeType == ResourceNodeType::Unknown || nodeType == node.type ||
-          (nodeType == ResourceNodeType::DescriptorBuffer && node.type == ResourceNodeType::DescriptorBufferCompact) ||
+          (nodeType == ResourceNodeType::DescriptorBuffer &&
+           (node.type == ResourceNodeType::DescriptorBufferCompact || node.type == ResourceNodeType::InlineBuffer)) ||
           ((node.type == ResourceNodeType::DescriptorCombinedTexture ||
             node.type == ResourceNodeType::DescriptorYCbCrSampler) &&
            (nodeType == ResourceNodeType::DescriptorResource || nodeType == ResourceNodeType::DescriptorTexelBuffer ||
@@ -980,8 +1049,16 @@ bool PipelineState::isTessOffChip() {
 bool PipelineState::isPackInOut() {
   // Pack input/output requirements:
   // 1) -pack-in-out option is on
-  // 2) It is a VS-FS pipeline
-  return PackInOut && (m_stageMask == (shaderStageToMask(ShaderStageVertex) | shaderStageToMask(ShaderStageFragment)));
+  // 2) It is a VS-FS pipeline, or a VS-TCS-TES-FS pipeline with -pack-in-out-tess option on
+  if (!PackInOut)
+    return false;
+
+  const unsigned vsFsStageMask = shaderStageToMask(ShaderStageVertex) | shaderStageToMask(ShaderStageFragment);
+  if (m_stageMask == vsFsStageMask)
+    return true;
+
+  const unsigned tessStageMask = shaderStageToMask(ShaderStageTessControl) | shaderStageToMask(ShaderStageTessEval);
+  return PackInOutTess && m_stageMask == (vsFsStageMask | tessStageMask);
 }
 
 // =====================================================================================================================
@@ -1003,8 +1080,9 @@ unsigned PipelineState::getShaderWaveSize(ShaderStage stage) {
   if (getTargetInfo().getGfxIpVersion().major >= 10) {
     // NOTE: GPU property wave size is used in shader, unless:
     //  1) A stage-specific default is preferred.
-    //  2) If specified by tuning option, use the specified wave size.
-    //  3) If gl_SubgroupSize is used in shader, use the specified subgroup size when required.
+    //  2) The wave size heuristic (-wave-size-heuristic) prefers a different one.
+    //  3) If specified by tuning option, use the specified wave size.
+    //  4) If gl_SubgroupSize is used in shader, use the specified subgroup size when required.
 
     if (stage == ShaderStageFragment) {
       // Per programming guide, it's recommended to use wave64 for fragment shader.
@@ -1014,6 +1092,16 @@ unsigned PipelineState::getShaderWaveSize(ShaderStage stage) {
       waveSize = 64;
     }
 
+    if (WaveSizeHeuristic && stage == ShaderStageCompute) {
+      // A workgroup that is not a multiple of 64 threads leaves the last wave64 half empty, so use wave32. That also
+      // gives the shader twice the VGPRs per thread at the same occupancy.
+      const auto &mode = getShaderModes()->getComputeShaderMode();
+      const unsigned workgroupSize =
+          std::max(mode.workgroupSizeX, 1U) * std::max(mode.workgroupSizeY, 1U) * std::max(mode.workgroupSizeZ, 1U);
+      if (workgroupSize % 64 != 0)
+        waveSize = 32;
+    }
+
     unsigned waveSizeOption = getShaderOptions(stage).waveSize;
     if (waveSizeOption != 0)
       waveSize = waveSizeOption;
@@ -1047,11 +1135,10 @@ ResourceUsage *PipelineState::getShaderResourceUsage(ShaderStage shaderStage) {
   if (shaderStage == ShaderStageCopyShader)
     shaderStage = ShaderStageGeometry;
 
-  auto &resUsage = MutableArrayRef<std::unique_ptr<ResourceUsage>>(m_resourceUsage)[shaderStage];
-  if (!resUsage) {
-    resUsage.reset(new ResourceUsage(shaderStage));
-  }
-  return &*resUsage;
+  auto &resUsage = MutableArrayRef<ResourceUsage *>(m_resourceUsage)[shaderStage];
+  if (!resUsage)
+    resUsage = new (m_resourceUsageAllocator.Allocate()) ResourceUsage(shaderStage);
+  return resUsage;
 }
 
 // =====================================================================================================================
@@ -1062,11 +1149,10 @@ InterfaceData *PipelineState::getShaderInterfaceData(ShaderStage shaderStage) {
   if (shaderStage == ShaderStageCopyShader)
     shaderStage = ShaderStageGeometry;
 
-  auto &intfData = MutableArrayRef<std::unique_ptr<InterfaceData>>(m_interfaceData)[shaderStage];
-  if (!intfData) {
-    intfData.reset(new InterfaceData());
-  }
-  return &*intfData;
+  auto &intfData = MutableArrayRef<InterfaceData *>(m_interfaceData)[shaderStage];
+  if (!intfData)
+    intfData = new (m_interfaceDataAllocator.Allocate()) InterfaceData();
+  return intfData;
 }
 
 // =====================================================================================================================
@@ -1163,6 +1249,29 @@ unsigned PipelineState::computeExportFormat(Type *outputTy, unsigned location) {
   return expFmt;
 }
 
+// =====================================================================================================================
+// Compute the mask of channels of the specified color export location whose values can reach the color target.
+// A channel is dead if the target's write mask excludes it and nothing else (dual-source blending, source alpha
+// blended to color channels, or alpha-to-coverage) reads it.
+//
+// @param location : Location
+unsigned PipelineState::computeExportChannelMask(unsigned location) {
+  const auto cbState = &m_colorExportState;
+  if (cbState->dualSourceBlendEnable)
+    return 0xF;
+
+  const ColorExportFormat *colorExportFormat = &getColorExportFormat(location);
+  unsigned channelMask = colorExportFormat->channelWriteMask & 0xF;
+  if (channelMask == 0)
+    return 0xF;
+
+  // NOTE: Alpha-to-coverage only takes effect for outputs from color target 0.
+  if (colorExportFormat->blendSrcAlphaToColor || (cbState->alphaToCoverageEnable && location == 0))
+    channelMask |= 0x8;
+
+  return channelMask;
+}
+
 // =====================================================================================================================
 // Helper macro
 #define CASE_CLASSENUM_TO_STRING(TYPE, ENUM)                                                                           \
@@ -1287,10 +1396,13 @@ PipelineStateWrapper::PipelineStateWrapper(LgcContext *builderContext)
 }
 
 // =====================================================================================================================
-// Clean-up of PipelineStateWrapper at end of pass manager run
+// Clean-up of PipelineStateWrapper at end of pass manager run. This drops the pipeline state, so a cached pass
+// manager can be run again for another pipeline.
 //
 // @param module : Module
 bool PipelineStateWrapper::doFinalization(Module &module) {
+  m_pipelineState = nullptr;
+  m_allocatedPipelineState.reset();
   return false;
 }
 
@@ -59,7 +59,6 @@ void ShaderModes::clear() {
 void ShaderModes::setCommonShaderMode(ShaderStage stage, const CommonShaderMode &commonShaderMode) {
   auto modes = MutableArrayRef<CommonShaderMode>(m_commonShaderModes);
   modes[stage] = commonShaderMode;
-  m_anySet = true;
 }
 
 // =====================================================================================================================
@@ -179,40 +178,63 @@ void ShaderModes::record(Module *module) {
 }
 
 // =====================================================================================================================
-// Read shader modes (common and specific) from a shader IR module, but only if no modes have been set
-// in this ShaderModes. This is used to handle the case that the shader module comes from an earlier
-// shader compile, and it had its ShaderModes recorded into IR then.
+// Read the shader modes (common and specific) of a shader stage from its shader IR module, and merge them into this
+// ShaderModes. The modes are recorded in the IR of a shader that was translated without this ShaderModes: in an
+// earlier shader compile, on another thread, or for the cache of lowered shaders. In a pipeline compile they are in
+// this ShaderModes already, and merging them again changes nothing. The metadata is then removed from the module, so
+// that it is not linked into the pipeline module.
 //
 // @param module : LLVM module
 // @param stage : Shader stage
 void ShaderModes::readModesFromShader(Module *module, ShaderStage stage) {
-  // Bail if any modes have been set, which would mean that this is a full pipeline compile.
-  if (m_anySet)
-    return;
-
   // First the common state.
   std::string metadataName =
       std::string(CommonShaderModeMetadataPrefix) + getShaderStageAbbreviation(static_cast<ShaderStage>(stage));
-  PipelineState::readNamedMetadataArrayOfInt32(module, metadataName, m_commonShaderModes[stage]);
+  CommonShaderMode commonShaderMode = {};
+  if (PipelineState::readNamedMetadataArrayOfInt32(module, metadataName, commonShaderMode))
+    setCommonShaderMode(stage, commonShaderMode);
 
   // Then the specific shader modes.
   switch (stage) {
   case ShaderStageTessControl:
-  case ShaderStageTessEval:
-    PipelineState::readNamedMetadataArrayOfInt32(module, TessellationModeMetadataName, m_tessellationMode);
+  case ShaderStageTessEval: {
+    TessellationMode tessellationMode = {};
+    if (PipelineState::readNamedMetadataArrayOfInt32(module, TessellationModeMetadataName, tessellationMode))
+      setTessellationMode(tessellationMode);
     break;
-  case ShaderStageGeometry:
-    PipelineState::readNamedMetadataArrayOfInt32(module, GeometryShaderModeMetadataName, m_geometryShaderMode);
+  }
+  case ShaderStageGeometry: {
+    GeometryShaderMode geometryShaderMode = {};
+    if (PipelineState::readNamedMetadataArrayOfInt32(module, GeometryShaderModeMetadataName, geometryShaderMode))
+      setGeometryShaderMode(geometryShaderMode);
     break;
-  case ShaderStageFragment:
-    PipelineState::readNamedMetadataArrayOfInt32(module, FragmentShaderModeMetadataName, m_fragmentShaderMode);
+  }
+  case ShaderStageFragment: {
+    FragmentShaderMode fragmentShaderMode = {};
+    if (PipelineState::readNamedMetadataArrayOfInt32(module, FragmentShaderModeMetadataName, fragmentShaderMode))
+      setFragmentShaderMode(fragmentShaderMode);
     break;
-  case ShaderStageCompute:
-    PipelineState::readNamedMetadataArrayOfInt32(module, ComputeShaderModeMetadataName, m_computeShaderMode);
+  }
+  case ShaderStageCompute: {
+    ComputeShaderMode computeShaderMode = {};
+    if (PipelineState::readNamedMetadataArrayOfInt32(module, ComputeShaderModeMetadataName, computeShaderMode))
+      setComputeShaderMode(computeShaderMode);
     break;
+  }
   default:
     break;
   }
+
+  SmallVector<NamedMDNode *, 8> modeMetaNodes;
+  for (NamedMDNode &namedMetaNode : module->named_metadata()) {
+    StringRef name = namedMetaNode.getName();
+    if (name.startswith(CommonShaderModeMetadataPrefix) || name == TessellationModeMetadataName ||
+        name == GeometryShaderModeMetadataName || name == FragmentShaderModeMetadataName ||
+        name == ComputeShaderModeMetadataName)
+      modeMetaNodes.push_back(&namedMetaNode);
+  }
+  for (NamedMDNode *namedMetaNode : modeMetaNodes)
+    module->eraseNamedMetadata(namedMetaNode);
 }
 
 // =====================================================================================================================
@@ -32,12 +32,17 @@
 #include "lgc/ElfLinker.h"
 #include "lgc/LgcContext.h"
 #include "lgc/Pipeline.h"
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/AsmParser/Parser.h"
 #include "llvm/BinaryFormat/ELF.h"
 #include "llvm/IR/Verifier.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/ThreadPool.h"
+#include <atomic>
+#include <chrono>
 
 using namespace lgc;
 using namespace llvm;
@@ -71,6 +76,27 @@ cl::opt<std::string> OutFileName("o", cl::cat(LgcCategory), cl::desc("Output fil
 cl::opt<unsigned> PalAbiVersion("pal-abi-version", cl::init(0xFFFFFFFF), cl::cat(LgcCategory),
                                 cl::desc("PAL pipeline version to compile for (default latest known)"),
                                 cl::value_desc("version"));
+
+// -j: number of threads to compile modules with
+cl::opt<unsigned> NumThreads("j", cl::init(1), cl::cat(LgcCategory),
+                             cl::desc("Number of threads to compile separate modules with (ignored with -l)"),
+                             cl::value_desc("threads"));
+
+// -time-modules: report the compile time of each module
+cl::opt<bool> TimeModules("time-modules", cl::init(false), cl::cat(LgcCategory),
+                          cl::desc("Report the time taken to compile each module on stderr"));
+
+// A module of LLVM IR assembler from an input file, and the result of compiling it.
+struct ModuleJob {
+  StringRef bufferName;    // Name of the input file
+  unsigned index;          // Zero-based index of the module in the input file
+  bool multiModule;        // Whether the input file has more than one module
+  std::string asmText;     // IR assembler, preceded by newlines so line numbers match the input file
+  bool success = false;    // Whether the module was compiled and its output written
+  std::string output;      // Output for stdout
+  std::string diagnostics; // Error messages
+  double seconds = 0.0;    // Time taken to compile the module
+};
 } // anonymous namespace
 
 // =====================================================================================================================
@@ -96,6 +122,166 @@ static bool isIsaText(StringRef data) {
   // with a tab character.
   return data.startswith("\t");
 }
+// =====================================================================================================================
+// Splits the text of an input file into multiple LLVM IR modules. We assume that a new module starts with a "target"
+// line to set the datalayout or triple, but not until after we have seen at least one line starting with '!'
+// (metadata declaration) in the previous module.
+//
+// @param buffer : Text of the input file
+static SmallVector<StringRef, 4> splitModules(StringRef buffer) {
+  SmallVector<StringRef, 4> separatedAsms;
+  StringRef remaining = buffer;
+  separatedAsms.push_back(remaining);
+  bool hadMetadata = false;
+  for (;;) {
+    auto notSpacePos = remaining.find_first_not_of(" \t\n");
+    if (notSpacePos != StringRef::npos) {
+      if (remaining[notSpacePos] == '!')
+        hadMetadata = true;
+      else if (hadMetadata && remaining.slice(notSpacePos, StringRef::npos).startswith("target")) {
+        // End the current split module and go on to the next one.
+        separatedAsms.back() = separatedAsms.back().slice(0, remaining.data() - separatedAsms.back().data());
+        separatedAsms.push_back(remaining);
+        hadMetadata = false;
+      }
+    }
+    auto nlPos = remaining.find_first_of('\n');
+    if (nlPos == StringRef::npos)
+      break;
+    remaining = remaining.slice(nlPos + 1, StringRef::npos);
+  }
+  return separatedAsms;
+}
+
+// =====================================================================================================================
+// Compiles (or with -l, links) one module, and writes its output to a file or keeps it for stdout. Errors are kept in
+// the job rather than printed, so that modules compiled on different threads can be reported in input order.
+//
+// @param [in/out] job : Module to compile, and its result
+// @param context : LLVM context to parse the module into
+// @param lgcContext : LgcContext for the LLVM context
+// @param inBuffers : All input files; with -l, the ones after the first are the ELF files to link
+// @param progName : Name of this program, for error messages
+static void processModule(ModuleJob &job, LLVMContext &context, LgcContext &lgcContext,
+                          ArrayRef<std::unique_ptr<MemoryBuffer>> inBuffers, StringRef progName) {
+  raw_string_ostream diagStream(job.diagnostics);
+  auto startTime = std::chrono::steady_clock::now();
+  auto finish = [&](bool success) {
+    job.success = success;
+    job.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    diagStream.flush();
+  };
+
+  // Use a MemoryBufferRef with the original filename so error reporting reports it.
+  MemoryBufferRef asmBuffer(job.asmText, job.bufferName);
+
+  // Assemble the text
+  SMDiagnostic error;
+  std::unique_ptr<Module> module = parseAssembly(asmBuffer, error, context);
+  if (!module) {
+    error.print(progName.data(), diagStream);
+    diagStream << "\n";
+    return finish(false);
+  }
+
+  // Verify the resulting IR.
+  if (verifyModule(*module, &diagStream)) {
+    diagStream << progName << ": " << job.bufferName << ": IR verification errors in module " << job.index << "\n";
+    return finish(false);
+  }
+
+  // Determine whether we are outputting to a file.
+  bool outputToFile = OutFileName != "-";
+  if (OutFileName.empty()) {
+    // No -o specified: output to stdout if input is -
+    outputToFile = job.bufferName != "-" && job.bufferName != "<stdin>";
+  }
+
+  SmallString<64> outFileName;
+  if (OutFileName.empty()) {
+    // Start to determine the output filename by taking the input filename, removing the directory,
+    // removing the extension. We add the extension below once we can see what the output contents
+    // look like. Each module of a multi-module input file gets its own output file.
+    outFileName = sys::path::stem(job.bufferName);
+    if (job.multiModule)
+      outFileName += "." + utostr(job.index + 1);
+  }
+
+  SmallString<16> outBuffer;
+  raw_svector_ostream outStream(outBuffer);
+  std::unique_ptr<Pipeline> pipeline(lgcContext.createPipeline());
+  StringRef err;
+
+  if (Link) {
+    // The -l option (link) is handled differently: We have just read the first input file as IR, and
+    // we get the pipeline state from that. Subsequent input files are ELF, and we link them.
+    pipeline->setStateFromModule(&*module);
+
+    SmallVector<MemoryBufferRef, 4> elfRefs;
+    for (unsigned i = 1; i != inBuffers.size(); ++i)
+      elfRefs.push_back(inBuffers[i]->getMemBufferRef());
+    std::unique_ptr<ElfLinker> elfLinker(pipeline->createElfLinker(elfRefs));
+
+    if (Glue) {
+      // Instead of doing a full link, we have been asked to compile a glue shader used in a link.
+      ArrayRef<StringRef> glueInfo = elfLinker->getGlueInfo();
+      if (Glue > glueInfo.size())
+        report_fatal_error("Only " + Twine(glueInfo.size()) + " glue shader(s) in this link");
+      outStream << elfLinker->compileGlue(Glue - 1);
+      if (outStream.str().empty())
+        err = pipeline->getLastError();
+    } else {
+      // Do a full link.
+      if (!elfLinker->link(outStream))
+        err = pipeline->getLastError();
+    }
+  } else {
+    // Run the middle-end compiler.
+    if (!pipeline->generate(std::move(module), outStream, nullptr, {}, {}))
+      err = pipeline->getLastError();
+  }
+
+  if (err != "") {
+    // Link or compile reported recoverable error.
+    diagStream << err << "\n";
+    return finish(false);
+  }
+
+  if (outputToFile == false) {
+    // Output to stdout.
+    job.output = std::string(outBuffer.str());
+  } else {
+    // Output to file.
+    if (outFileName.empty()) {
+      // Use given filename.
+      outFileName = OutFileName;
+    } else {
+      // We are in the middle of deriving the output filename from the input filename. Add the
+      // extension now.
+      const char *ext = ".s";
+      if (isElfBinary(outBuffer)) {
+        ext = ".elf";
+      } else if (isIsaText(outBuffer)) {
+        ext = ".s";
+      } else {
+        ext = ".ll";
+      }
+      outFileName += ext;
+    }
+
+    bool fileWriteSuccess = false;
+    if (FILE *outFile = fopen(outFileName.c_str(), "wb")) {
+      if (fwrite(outBuffer.data(), 1, outBuffer.size(), outFile) == outBuffer.size())
+        fileWriteSuccess = fclose(outFile) == 0;
+    }
+    if (!fileWriteSuccess) {
+      diagStream << progName << ": " << outFileName << ": " << strerror(errno) << "\n";
+      return finish(false);
+    }
+  }
+  finish(true);
+}
+
 // =====================================================================================================================
 // Main code of LGC standalone tool
 //
@@ -130,7 +316,10 @@ int main(int argc, char **argv) {
                                    "\n"
                                    "If the -glue option is given in addition to the -l (link) option, then input\n"
                                    "files are the same as in a link operation, but lgc instead compiles the glue\n"
-                                   "shader of the given one-based index that would be used in the link.\n";
+                                   "shader of the given one-based index that would be used in the link.\n"
+                                   "\n"
+                                   "With -j, the modules of all input files are compiled on that many threads,\n"
+                                   "and their output and errors are reported in input order once all are done.\n";
   cl::ParseCommandLineOptions(argc, argv, commandDesc);
 
   // Find the -mcpu option and get its value.
@@ -171,35 +360,13 @@ int main(int argc, char **argv) {
     inBuffers.push_back(std::move(*fileOrErr));
   }
 
-  // Process each input file.
+  // Split the input files into their modules. With the -l option (link), only the first module (or the one selected
+  // by -extract) of the first input file is IR; the remaining input files are ELF files to link.
+  std::vector<ModuleJob> jobs;
   for (auto &inBuffer : inBuffers) {
     MemoryBufferRef bufferRef = inBuffer->getMemBufferRef();
     StringRef bufferName = bufferRef.getBufferIdentifier();
-
-    // Split the input into multiple LLVM IR modules. We assume that a new module starts with
-    // a "target" line to set the datalayout or triple, but not until after we have seen at least
-    // one line starting with '!' (metadata declaration) in the previous module.
-    SmallVector<StringRef, 4> separatedAsms;
-    StringRef remaining = bufferRef.getBuffer();
-    separatedAsms.push_back(remaining);
-    bool hadMetadata = false;
-    for (;;) {
-      auto notSpacePos = remaining.find_first_not_of(" \t\n");
-      if (notSpacePos != StringRef::npos) {
-        if (remaining[notSpacePos] == '!')
-          hadMetadata = true;
-        else if (hadMetadata && remaining.slice(notSpacePos, StringRef::npos).startswith("target")) {
-          // End the current split module and go on to the next one.
-          separatedAsms.back() = separatedAsms.back().slice(0, remaining.data() - separatedAsms.back().data());
-          separatedAsms.push_back(remaining);
-          hadMetadata = false;
-        }
-      }
-      auto nlPos = remaining.find_first_of('\n');
-      if (nlPos == StringRef::npos)
-        break;
-      remaining = remaining.slice(nlPos + 1, StringRef::npos);
-    }
+    SmallVector<StringRef, 4> separatedAsms = splitModules(bufferRef.getBuffer());
 
     // Check that the -extract option is not out of range.
     if (Extract > separatedAsms.size()) {
@@ -207,131 +374,74 @@ int main(int argc, char **argv) {
       exit(1);
     }
 
-    // Process each module. Put extra newlines at the start of each one other than the first so that
-    // line numbers are correct for error reporting.
+    // Put extra newlines at the start of each module other than the first so that line numbers are correct for
+    // error reporting.
     unsigned extraNlCount = 0;
     for (unsigned idx = 0; idx != separatedAsms.size(); ++idx) {
       StringRef separatedAsm = separatedAsms[idx];
-      std::string asmText;
-      asmText.insert(asmText.end(), extraNlCount, '\n');
+      unsigned nlCount = extraNlCount;
       extraNlCount += separatedAsm.count('\n');
-      asmText += separatedAsm;
 
       // Skip this module if -extract was specified for a different index.
       if (Extract && Extract != idx + 1)
         continue;
 
-      // Use a MemoryBufferRef with the original filename so error reporting reports it.
-      MemoryBufferRef asmBuffer(asmText, bufferName);
-
-      // Assemble the text
-      SMDiagnostic error;
-      std::unique_ptr<Module> module = parseAssembly(asmBuffer, error, context);
-      if (!module) {
-        error.print(progName, errs());
-        errs() << "\n";
-        return 1;
-      }
-
-      // Verify the resulting IR.
-      if (verifyModule(*module, &errs())) {
-        errs() << progName << ": " << bufferName << ": IR verification errors in module " << idx << "\n";
-        return 1;
-      }
-
-      // Determine whether we are outputting to a file.
-      bool outputToFile = OutFileName != "-";
-      if (OutFileName.empty()) {
-        // No -o specified: output to stdout if input is -
-        outputToFile = bufferName != "-" && bufferName != "<stdin>";
-      }
-
-      SmallString<64> outFileName;
-      if (OutFileName.empty()) {
-        // Start to determine the output filename by taking the input filename, removing the directory,
-        // removing the extension. We add the extension below once we can see what the output contents
-        // look like.
-        outFileName = sys::path::stem(bufferName);
-      }
-
-      SmallString<16> outBuffer;
-      raw_svector_ostream outStream(outBuffer);
-      std::unique_ptr<Pipeline> pipeline(lgcContext->createPipeline());
-      StringRef err;
-
-      if (Link) {
-        // The -l option (link) is handled differently: We have just read the first input file as IR, and
-        // we get the pipeline state from that. Subsequent input files are ELF, and we link them.
-        pipeline->setStateFromModule(&*module);
-
-        SmallVector<MemoryBufferRef, 4> elfRefs;
-        for (unsigned i = 1; i != inBuffers.size(); ++i)
-          elfRefs.push_back(inBuffers[i]->getMemBufferRef());
-        std::unique_ptr<ElfLinker> elfLinker(pipeline->createElfLinker(elfRefs));
-
-        if (Glue) {
-          // Instead of doing a full link, we have been asked to compile a glue shader used in a link.
-          ArrayRef<StringRef> glueInfo = elfLinker->getGlueInfo();
-          if (Glue > glueInfo.size())
-            report_fatal_error("Only " + Twine(glueInfo.size()) + " glue shader(s) in this link");
-          outStream << elfLinker->compileGlue(Glue - 1);
-          if (outStream.str().empty())
-            err = pipeline->getLastError();
-        } else {
-          // Do a full link.
-          if (!elfLinker->link(outStream))
-            err = pipeline->getLastError();
-        }
-      } else {
-        // Run the middle-end compiler.
-        if (!pipeline->generate(std::move(module), outStream, nullptr, {}, {}))
-          err = pipeline->getLastError();
-      }
+      ModuleJob job;
+      job.bufferName = bufferName;
+      job.index = idx;
+      job.multiModule = separatedAsms.size() > 1 && !Extract;
+      job.asmText.insert(job.asmText.end(), nlCount, '\n');
+      job.asmText += separatedAsm;
+      jobs.push_back(std::move(job));
+      if (Link)
+        break;
+    }
+    if (Link)
+      break;
+  }
 
-      if (err != "") {
-        // Link or compile reported recoverable error.
-        errs() << err << "\n";
+  // Reports the result of a module, in input order.
+  auto reportJob = [&](const ModuleJob &job) {
+    outs() << job.output;
+    outs().flush();
+    errs() << job.diagnostics;
+    if (TimeModules) {
+      errs() << progName << ": " << job.bufferName << ": module " << (job.index + 1)
+             << format(": %.6f s\n", job.seconds);
+    }
+  };
+
+  unsigned threadCount = Link ? 1 : std::min(std::max(1u, NumThreads.getValue()), unsigned(jobs.size()));
+  if (threadCount <= 1) {
+    for (ModuleJob &job : jobs) {
+      processModule(job, context, *lgcContext, inBuffers, progName);
+      reportJob(job);
+      if (!job.success)
         return 1;
-      }
-
-      if (outputToFile == false) {
-        // Output to stdout.
-        outs() << outBuffer;
-      } else {
-        // Output to file.
-        if (outFileName.empty()) {
-          // Use given filename.
-          outFileName = OutFileName;
-        } else {
-          // We are in the middle of deriving the output filename from the input filename. Add the
-          // extension now.
-          const char *ext = ".s";
-          if (isElfBinary(outBuffer)) {
-            ext = ".elf";
-          } else if (isIsaText(outBuffer)) {
-            ext = ".s";
-          } else {
-            ext = ".ll";
-          }
-          outFileName += ext;
-        }
-
-        bool fileWriteSuccess = false;
-        if (FILE *outFile = fopen(outFileName.c_str(), "wb")) {
-          if (fwrite(outBuffer.data(), 1, outBuffer.size(), outFile) == outBuffer.size())
-            fileWriteSuccess = fclose(outFile) == 0;
-        }
-        if (!fileWriteSuccess) {
-          errs() << progName << ": " << outFileName << ": " << strerror(errno) << "\n";
-          return 1;
-        }
-      }
-
-      // With the -l option (link), we have already consumed all the input files.
-      if (Link)
-        return 0;
     }
+    return 0;
+  }
+
+  // Compile the modules on worker threads. Each worker has its own LLVMContext and LgcContext, so it creates its
+  // target machine once and reuses it for all the modules it compiles. Output and errors are reported in input
+  // order once all modules are compiled.
+  std::atomic<unsigned> nextJob(0);
+  ThreadPool threadPool(hardware_concurrency(threadCount));
+  for (unsigned i = 0; i != threadCount; ++i) {
+    threadPool.async([&] {
+      LLVMContext workerContext;
+      std::unique_ptr<LgcContext> workerLgcContext(LgcContext::Create(workerContext, gpuName, PalAbiVersion));
+      for (unsigned jobIdx = nextJob++; jobIdx < jobs.size(); jobIdx = nextJob++)
+        processModule(jobs[jobIdx], workerContext, *workerLgcContext, inBuffers, progName);
+    });
   }
+  threadPool.wait();
 
-  return 0;
+  int exitCode = 0;
+  for (const ModuleJob &job : jobs) {
+    reportJob(job);
+    if (!job.success)
+      exitCode = 1;
+  }
+  return exitCode;
 }
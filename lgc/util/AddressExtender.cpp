@@ -33,6 +33,7 @@
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Instruction.h"
+#include "llvm/IR/Instructions.h"
 #include "llvm/IR/IntrinsicsAMDGPU.h"
 
 using namespace lgc;
@@ -69,6 +70,33 @@ Instruction *AddressExtender::extend(Value *addr32, unsigned highHalf, Type *ptr
   return cast<Instruction>(builder.CreateIntToPtr(ptr, ptrTy));
 }
 
+// =====================================================================================================================
+// Extend an i32 into a 64-bit pointer, generating the code only once in the function for each combination of
+// arguments, straight after addr32 is defined, so the result can replace uses anywhere in the function.
+//
+// @param addr32 : Address as 32-bit value; must be an argument or an instruction in this function
+// @param highHalf : Value to use for high half; HighAddrPc to use PC
+// @param ptrTy : Type to cast pointer to
+// @return : 64-bit pointer value
+Instruction *AddressExtender::extendShared(Value *addr32, unsigned highHalf, Type *ptrTy) {
+  Instruction *&ptr = m_sharedExtends[std::make_tuple(addr32, highHalf, ptrTy)];
+  if (!ptr) {
+    // Get PC first if needed, so the insertion point below is after it.
+    if (highHalf == HighAddrPc)
+      getPc();
+    IRBuilder<> builder(m_func->getContext());
+    auto addrInst = dyn_cast<Instruction>(addr32);
+    if (!addrInst)
+      builder.SetInsertPoint(getFirstInsertionPt());
+    else if (isa<PHINode>(addrInst))
+      builder.SetInsertPoint(&*addrInst->getParent()->getFirstInsertionPt());
+    else
+      builder.SetInsertPoint(addrInst->getNextNode());
+    ptr = extend(addr32, highHalf, ptrTy, builder);
+  }
+  return ptr;
+}
+
 // =====================================================================================================================
 // Get PC value as v2i32. The caller is only using the high half, so this only writes a single instance of the
 // code at the start of the function.
@@ -0,0 +1,155 @@
+/*
+ ***********************************************************************************************************************
+ *
+ *  Copyright (c) 2020 Advanced Micro Devices, Inc. All Rights Reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ **********************************************************************************************************************/
+/**
+ ***********************************************************************************************************************
+ * @file  PassCosts.cpp
+ * @brief LLPC source file: contains implementation of class lgc::PassCosts and the pass cost accounting pass.
+ ***********************************************************************************************************************
+ */
+#include "lgc/PassCosts.h"
+#include "lgc/util/Internal.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Process.h"
+#include <chrono>
+
+#define DEBUG_TYPE "lgc-pass-cost"
+
+using namespace llvm;
+using namespace lgc;
+
+namespace llvm {
+namespace cl {
+
+// -pass-costs: account the time and memory used by each pass of a build
+static opt<bool> PassCostsOpt("pass-costs", desc("Account the time and memory used by each pass of a build"),
+                              init(false));
+
+} // namespace cl
+} // namespace llvm
+
+namespace {
+
+// =====================================================================================================================
+// Pass that accounts the cost of the pass run between a begin instance and an end instance of it.
+class PassCostPass : public ModulePass {
+public:
+  static char ID;
+  PassCostPass() : ModulePass(ID) {}
+  PassCostPass(StringRef passName, PassCostPass *beginPass)
+      : ModulePass(ID), m_passName(passName), m_beginPass(beginPass) {}
+
+  void getAnalysisUsage(AnalysisUsage &analysisUsage) const override { analysisUsage.setPreservesAll(); }
+  bool runOnModule(Module &module) override;
+
+private:
+  PassCostPass(const PassCostPass &) = delete;
+  PassCostPass &operator=(const PassCostPass &) = delete;
+
+  std::string m_passName;                            // Name of the accounted pass
+  PassCostPass *m_beginPass = nullptr;               // For the end instance, the begin instance; nullptr for the begin
+                                                     //  instance
+  std::chrono::steady_clock::time_point m_startTime; // For the begin instance, the time the pass last started
+  size_t m_startMemUsage = 0;                        // For the begin instance, the allocated memory at that time
+};
+
+char PassCostPass::ID = 0;
+
+// The pass cost map of the current thread
+thread_local PassCostMap *ThreadCostMap = nullptr;
+
+} // namespace
+
+// =====================================================================================================================
+// Gets whether pass costs are being accounted.
+bool PassCosts::isEnabled() {
+  return cl::PassCostsOpt;
+}
+
+// =====================================================================================================================
+// Sets the pass cost map that passes run on the current thread add to.
+//
+// @param costMap : Pass cost map, or nullptr to stop accounting on this thread
+// @returns : The previous pass cost map of the thread
+PassCostMap *PassCosts::setThreadCostMap(PassCostMap *costMap) {
+  PassCostMap *oldCostMap = ThreadCostMap;
+  ThreadCostMap = costMap;
+  return oldCostMap;
+}
+
+// =====================================================================================================================
+// Gets the pass cost map of the current thread, or nullptr if none.
+PassCostMap *PassCosts::getThreadCostMap() {
+  return ThreadCostMap;
+}
+
+// =====================================================================================================================
+// Adds the costs of one pass cost map into another.
+//
+// @param [in/out] dest : Map to add the costs to
+// @param src : Map to add the costs of
+void PassCosts::merge(PassCostMap &dest, const PassCostMap &src) {
+  for (const auto &entry : src) {
+    PassCost &cost = dest[entry.first];
+    cost.runCount += entry.second.runCount;
+    cost.time += entry.second.time;
+    cost.memUsed += entry.second.memUsed;
+  }
+}
+
+// =====================================================================================================================
+// Create a pass that accounts the cost of a pass. The begin instance is added before the accounted pass, and the end
+// instance, which adds the cost to the pass cost map of the thread, after it.
+//
+// @param passName : Name of the accounted pass
+// @param beginPass : For the end instance, the begin instance returned by an earlier call; nullptr for the begin
+//                    instance
+ModulePass *lgc::createPassCostPass(StringRef passName, ModulePass *beginPass) {
+  return new PassCostPass(passName, static_cast<PassCostPass *>(beginPass));
+}
+
+// =====================================================================================================================
+// Run the pass on the specified LLVM module.
+//
+// @param [in,out] module : LLVM module to be run on
+bool PassCostPass::runOnModule(Module &module) {
+  if (!m_beginPass) {
+    if (ThreadCostMap) {
+      m_startMemUsage = sys::Process::GetMallocUsage();
+      m_startTime = std::chrono::steady_clock::now();
+    }
+  } else if (ThreadCostMap) {
+    std::chrono::duration<double> time = std::chrono::steady_clock::now() - m_beginPass->m_startTime;
+    PassCost &cost = (*ThreadCostMap)[m_passName];
+    ++cost.runCount;
+    cost.time += time.count();
+    cost.memUsed += int64_t(sys::Process::GetMallocUsage()) - int64_t(m_beginPass->m_startMemUsage);
+  }
+  return false;
+}
+
+// =====================================================================================================================
+// Initializes the pass
+INITIALIZE_PASS(PassCostPass, DEBUG_TYPE, "Account pass cost", false, false)
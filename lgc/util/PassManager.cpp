@@ -29,10 +29,15 @@
  ***********************************************************************************************************************
  */
 #include "lgc/PassManager.h"
+#include "lgc/PassCosts.h"
+#include "lgc/TraceEvents.h"
 #include "lgc/util/Debug.h"
+#include "lgc/util/Internal.h"
 #include "llvm/Analysis/CFGPrinter.h"
 #include "llvm/IR/Verifier.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/raw_ostream.h"
+#include <atomic>
 
 namespace llvm {
 namespace cl {
@@ -40,6 +45,13 @@ namespace cl {
 // -verify-ir : verify the IR after each pass
 static cl::opt<bool> VerifyIr("verify-ir", cl::desc("Verify IR after each pass"), cl::init(false));
 
+// -verify-ir-sample-rate : verify the IR after each module pass in one of every N compiles, reporting a failure
+// instead of aborting (0 to disable)
+static cl::opt<unsigned> VerifyIrSampleRate("verify-ir-sample-rate",
+                                            cl::desc("Verify IR after each module pass in one of every N compiles, "
+                                                     "reporting failures instead of aborting (0 to disable)"),
+                                            cl::init(0));
+
 // -dump-cfg-after : dump CFG as .dot files after specified pass
 static cl::opt<std::string> DumpCfgAfter("dump-cfg-after", cl::desc("Dump CFG as .dot files after specified pass"),
                                          cl::init(""));
@@ -73,15 +85,63 @@ public:
   void stop() override;
 
 private:
-  bool m_stopped = false;               // Whether we have already stopped adding new passes.
-  AnalysisID m_dumpCfgAfter = nullptr;  // -dump-cfg-after pass id
-  AnalysisID m_printModule = nullptr;   // Pass id of dump pass "Print Module IR"
-  AnalysisID m_jumpThreading = nullptr; // Pass id of opt pass "Jump Threading"
-  unsigned *m_passIndex = nullptr;      // Pass Index
+  bool m_stopped = false;                  // Whether we have already stopped adding new passes.
+  bool m_sampledVerify = false;            // Whether this pass manager was sampled by -verify-ir-sample-rate
+  bool m_sampledVerifyFailed = false;      // Whether a sampled verification has already failed
+  AnalysisID m_dumpCfgAfter = nullptr;     // -dump-cfg-after pass id
+  AnalysisID m_printModule = nullptr;      // Pass id of dump pass "Print Module IR"
+  AnalysisID m_jumpThreading = nullptr;    // Pass id of opt pass "Jump Threading"
+  AnalysisID m_targetPassConfig = nullptr; // Pass id of codegen pass "Target Pass Configuration"
+  bool m_addingCodeGen = false;            // Whether codegen passes are being added
+  unsigned *m_passIndex = nullptr;         // Pass Index
 };
 
+// =====================================================================================================================
+// Pass that verifies the module after a pass in a compile sampled by -verify-ir-sample-rate. Unlike the verifier added
+// by -verify-ir, a failure is reported (and recorded as a trace event) rather than being fatal, and only the first
+// failure in a compile is reported.
+class SampledVerifierPass final : public ModulePass {
+public:
+  static char ID;
+  SampledVerifierPass() : ModulePass(ID) {}
+  SampledVerifierPass(StringRef passName, bool *failed) : ModulePass(ID), m_passName(passName), m_failed(failed) {}
+
+  void getAnalysisUsage(AnalysisUsage &analysisUsage) const override { analysisUsage.setPreservesAll(); }
+  bool runOnModule(Module &module) override;
+
+private:
+  SampledVerifierPass(const SampledVerifierPass &) = delete;
+  SampledVerifierPass &operator=(const SampledVerifierPass &) = delete;
+
+  std::string m_passName; // Name of the pass that the module is verified after
+  bool *m_failed;         // Shared flag set once a verification in this compile has failed
+};
+
+char SampledVerifierPass::ID = 0;
+
 } // namespace
 
+// =====================================================================================================================
+// Verify the module, and report the failure if it is broken.
+//
+// @param [in] module : Module to verify
+bool SampledVerifierPass::runOnModule(Module &module) {
+  if (*m_failed)
+    return false;
+
+  std::string message;
+  raw_string_ostream messageStream(message);
+  if (verifyModule(module, &messageStream)) {
+    *m_failed = true;
+    errs() << "IR verification failed after pass " << m_passName << ":\n" << messageStream.str();
+    if (TraceEvents::isEnabled()) {
+      uint64_t time = TraceEvents::getTime();
+      TraceEvents::record("IR verification failed after " + m_passName, "verify", time, time);
+    }
+  }
+  return false;
+}
+
 // =====================================================================================================================
 // Get the PassInfo for a registered pass given short name
 //
@@ -120,6 +180,15 @@ PassManagerImpl::PassManagerImpl() : PassManager() {
 
   m_jumpThreading = getPassIdFromName("jump-threading");
   m_printModule = getPassIdFromName("print-module");
+  if (PassCosts::isEnabled())
+    m_targetPassConfig = getPassIdFromName("targetpassconfig");
+
+  // Sample pass managers rather than whole compiles. Every compile creates its own, so over many compiles this
+  // verifies about one in N of them.
+  if (!cl::VerifyIr && cl::VerifyIrSampleRate != 0) {
+    static std::atomic<unsigned> passManagerCount(0);
+    m_sampledVerify = passManagerCount++ % cl::VerifyIrSampleRate == 0;
+  }
 }
 
 // =====================================================================================================================
@@ -151,12 +220,45 @@ void PassManagerImpl::add(Pass *pass) {
       LLPC_OUTS("Pass[" << passIndex << "] = " << pass->getPassName() << "\n");
   }
 
+  // With -pass-costs, bracket a module or function pass with passes that account its cost. Codegen function passes
+  // are not bracketed, as machine function passes must not be split from the ones around them.
+  if (passId == m_targetPassConfig)
+    m_addingCodeGen = true;
+  ModulePass *costBeginPass = nullptr;
+  std::string costPassName;
+  if (PassCosts::isEnabled() &&
+      (pass->getPassKind() == PT_Module || (pass->getPassKind() == PT_Function && !m_addingCodeGen))) {
+    costPassName = pass->getPassName().str();
+    costBeginPass = createPassCostPass(costPassName, nullptr);
+    legacy::PassManager::add(costBeginPass);
+  }
+
+  // With -trace-events-file, bracket a module pass with passes that record a trace event for it. Function passes are
+  // not bracketed, as that would split up the function pass manager they are grouped into.
+  ModulePass *traceBeginPass = nullptr;
+  std::string tracedPassName;
+  if (TraceEvents::isEnabled() && pass->getPassKind() == PT_Module) {
+    tracedPassName = pass->getPassName().str();
+    traceBeginPass = createTraceEventPass(tracedPassName, nullptr);
+    legacy::PassManager::add(traceBeginPass);
+  }
+
   // Add the pass to the superclass pass manager.
   legacy::PassManager::add(pass);
 
+  if (traceBeginPass)
+    legacy::PassManager::add(createTraceEventPass(tracedPassName, traceBeginPass));
+
+  if (costBeginPass)
+    legacy::PassManager::add(createPassCostPass(costPassName, costBeginPass));
+
   if (cl::VerifyIr) {
     // Add a verify pass after it.
     legacy::PassManager::add(createVerifierPass(true)); // FatalErrors=true
+  } else if (m_sampledVerify && pass->getPassKind() == PT_Module) {
+    // Verify after module passes only, so as not to split up the function pass manager function passes are grouped
+    // into.
+    legacy::PassManager::add(new SampledVerifierPass(pass->getPassName(), &m_sampledVerifyFailed));
   }
 
   if (passId == m_dumpCfgAfter) {
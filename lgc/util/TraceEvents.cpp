@@ -0,0 +1,221 @@
+/*
+ ***********************************************************************************************************************
+ *
+ *  Copyright (c) 2020 Advanced Micro Devices, Inc. All Rights Reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ **********************************************************************************************************************/
+/**
+***********************************************************************************************************************
+* @file  TraceEvents.cpp
+* @brief LLPC source file: recording of trace events and the pass that records a trace event for another pass
+***********************************************************************************************************************
+*/
+#include "lgc/TraceEvents.h"
+#include "lgc/util/Internal.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/Mutex.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/raw_ostream.h"
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#define DEBUG_TYPE "lgc-trace-event"
+
+using namespace llvm;
+using namespace lgc;
+
+namespace llvm {
+namespace cl {
+
+// -trace-events-file: record trace events of compiler phases, and write them to the specified file on exit
+static opt<std::string> TraceEventsFile("trace-events-file",
+                                        desc("Record trace events of compiler phases, and write them in Chrome trace "
+                                             "event format to the specified file on exit"),
+                                        value_desc("filename"), init(""));
+
+} // namespace cl
+} // namespace llvm
+
+namespace {
+
+// A complete trace event
+struct TraceEvent {
+  std::string name;     // Name of the event
+  const char *category; // Category of the event
+  uint64_t startTime;   // Start time in microseconds
+  uint64_t duration;    // Duration in microseconds
+};
+
+// The trace events recorded by one thread
+struct ThreadTraceEvents {
+  uint64_t threadId;              // Thread ID
+  std::vector<TraceEvent> events; // Events recorded by the thread
+};
+
+// =====================================================================================================================
+// The trace events of all threads, written to the trace events file when destroyed at process exit.
+class TraceEventRecorder {
+public:
+  TraceEventRecorder() : m_fileName(cl::TraceEventsFile) {}
+  ~TraceEventRecorder();
+
+  ThreadTraceEvents &getThreadEvents();
+
+private:
+  std::string m_fileName;                                    // Trace events file, copied as the option may go first
+  sys::Mutex m_lock;                                         // Lock for m_threads
+  std::vector<std::unique_ptr<ThreadTraceEvents>> m_threads; // Events of each thread that has recorded any
+};
+
+// =====================================================================================================================
+// Pass that records a trace event for the module pass run between a begin instance and an end instance of it.
+class TraceEventPass : public ModulePass {
+public:
+  static char ID;
+  TraceEventPass() : ModulePass(ID) {}
+  TraceEventPass(StringRef passName, TraceEventPass *beginPass)
+      : ModulePass(ID), m_passName(passName), m_beginPass(beginPass) {}
+
+  bool runOnModule(Module &module) override;
+
+  void getAnalysisUsage(AnalysisUsage &analysisUsage) const override { analysisUsage.setPreservesAll(); }
+
+private:
+  TraceEventPass(const TraceEventPass &) = delete;
+  TraceEventPass &operator=(const TraceEventPass &) = delete;
+
+  std::string m_passName;                // Name of the traced pass
+  TraceEventPass *m_beginPass = nullptr; // For the end instance, the begin instance; nullptr for the begin instance
+  uint64_t m_startTime = 0;              // For the begin instance, the time the traced pass last started
+};
+
+char TraceEventPass::ID = 0;
+
+} // namespace
+
+// =====================================================================================================================
+// Gets the trace event recorder
+static TraceEventRecorder &getRecorder() {
+  static TraceEventRecorder Recorder;
+  return Recorder;
+}
+
+// =====================================================================================================================
+// Writes the recorded events of all threads to the trace events file.
+TraceEventRecorder::~TraceEventRecorder() {
+  std::error_code errorCode;
+  raw_fd_ostream outFile(m_fileName, errorCode);
+  if (errorCode) {
+    errs() << "Failed to open trace events file " << m_fileName << ": " << errorCode.message() << "\n";
+    return;
+  }
+
+  unsigned processId = sys::Process::getProcessId();
+  json::OStream json(outFile);
+  json.object([&] {
+    json.attributeArray("traceEvents", [&] {
+      for (const auto &thread : m_threads) {
+        for (const TraceEvent &event : thread->events) {
+          json.object([&] {
+            json.attribute("name", event.name);
+            json.attribute("cat", event.category);
+            json.attribute("ph", "X");
+            json.attribute("pid", int64_t(processId));
+            json.attribute("tid", int64_t(thread->threadId));
+            json.attribute("ts", int64_t(event.startTime));
+            json.attribute("dur", int64_t(event.duration));
+          });
+        }
+      }
+    });
+    json.attribute("displayTimeUnit", "ms");
+  });
+}
+
+// =====================================================================================================================
+// Gets the trace events of the current thread, registering the thread on its first event.
+ThreadTraceEvents &TraceEventRecorder::getThreadEvents() {
+  static thread_local ThreadTraceEvents *ThreadEvents = nullptr;
+  if (!ThreadEvents) {
+    std::lock_guard<sys::Mutex> lock(m_lock);
+    m_threads.push_back(std::make_unique<ThreadTraceEvents>());
+    ThreadEvents = &*m_threads.back();
+    ThreadEvents->threadId = get_threadid();
+  }
+  return *ThreadEvents;
+}
+
+// =====================================================================================================================
+// Gets whether trace events are being recorded.
+bool TraceEvents::isEnabled() {
+  return !cl::TraceEventsFile.empty();
+}
+
+// =====================================================================================================================
+// Gets the current time in microseconds, as used for trace event timestamps.
+uint64_t TraceEvents::getTime() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// =====================================================================================================================
+// Records a complete event on the current thread.
+//
+// @param name : Name of the event
+// @param category : Category of the event
+// @param startTime : Start time of the event, from getTime()
+// @param endTime : End time of the event, from getTime()
+void TraceEvents::record(StringRef name, const char *category, uint64_t startTime, uint64_t endTime) {
+  getRecorder().getThreadEvents().events.push_back({name.str(), category, startTime, endTime - startTime});
+}
+
+// =====================================================================================================================
+// Create a pass that records a trace event for a module pass. The begin instance is added before the traced pass,
+// and the end instance, which records the event, after it.
+//
+// @param passName : Name of the traced pass
+// @param beginPass : For the end instance, the begin instance returned by an earlier call; nullptr for the begin
+//                    instance
+ModulePass *lgc::createTraceEventPass(StringRef passName, ModulePass *beginPass) {
+  return new TraceEventPass(passName, static_cast<TraceEventPass *>(beginPass));
+}
+
+// =====================================================================================================================
+// Run the pass on the specified LLVM module.
+//
+// @param [in,out] module : LLVM module to be run on
+bool TraceEventPass::runOnModule(Module &module) {
+  if (!m_beginPass)
+    m_startTime = TraceEvents::getTime();
+  else
+    TraceEvents::record(m_passName, "pass", m_beginPass->m_startTime, TraceEvents::getTime());
+  return false;
+}
+
+// =====================================================================================================================
+// Initializes the pass
+INITIALIZE_PASS(TraceEventPass, DEBUG_TYPE, "Record trace event for pass", false, false)
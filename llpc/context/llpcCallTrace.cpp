@@ -0,0 +1,143 @@
+/*
+ ***********************************************************************************************************************
+ *
+ *  Copyright (c) 2020 Advanced Micro Devices, Inc. All Rights Reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ **********************************************************************************************************************/
+/**
+ ***********************************************************************************************************************
+ @file llpcCallTrace.cpp
+ @brief LLPC source file: contains implementation of class Llpc::CallTrace.
+ ***********************************************************************************************************************
+ */
+#include "llpcCallTrace.h"
+#include "llpcDebug.h"
+#include "vkgcPipelineDumper.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+
+#define DEBUG_TYPE "llpc-call-trace"
+
+using namespace llvm;
+using namespace Vkgc;
+
+// -capture-trace-dir: directory where the ICompiler calls of the process are captured for replay (empty for none)
+static cl::opt<std::string> CaptureTraceDir("capture-trace-dir",
+                                            cl::desc("Directory where the ICompiler calls of the process and their "
+                                                     "inputs are captured, for amdllpc -replay-trace (empty for none)"),
+                                            cl::value_desc("dir"), cl::init(""));
+
+namespace Llpc {
+
+// =====================================================================================================================
+// Gets the call trace of the process, starting it on first use. Returns nullptr if no trace is captured, or if the
+// trace file could not be created.
+//
+// @param gfxIp : Graphics IP version of the calling compiler
+// @param shaderCacheMode : Shader cache mode of the calling compiler
+CallTrace *CallTrace::get(GfxIpVersion gfxIp, unsigned shaderCacheMode) {
+  if (CaptureTraceDir.empty())
+    return nullptr;
+
+  static std::unique_ptr<CallTrace> TheCallTrace = [gfxIp, shaderCacheMode]() -> std::unique_ptr<CallTrace> {
+    std::string dir = CaptureTraceDir;
+    if (std::error_code errCode = sys::fs::create_directories(dir)) {
+      LLPC_ERRS("Failed to create call trace directory " << dir << ": " << errCode.message() << "\n");
+      return nullptr;
+    }
+    SmallString<256> path(dir);
+    sys::path::append(path, CallTraceFileName);
+    std::error_code errCode;
+    auto stream = std::make_unique<raw_fd_ostream>(path, errCode, sys::fs::OF_None);
+    if (errCode) {
+      LLPC_ERRS("Failed to create call trace " << path << ": " << errCode.message() << "\n");
+      return nullptr;
+    }
+
+    CallTraceHeader header = {};
+    memcpy(header.magic, CallTraceMagic, sizeof(header.magic));
+    header.version = CallTraceVersion;
+    header.shaderCacheMode = shaderCacheMode;
+    header.gfxIpMajor = gfxIp.major;
+    header.gfxIpMinor = gfxIp.minor;
+    header.gfxIpStepping = gfxIp.stepping;
+    stream->write(reinterpret_cast<const char *>(&header), sizeof(header));
+    stream->flush();
+    return std::unique_ptr<CallTrace>(new CallTrace(dir, std::move(stream)));
+  }();
+  return TheCallTrace.get();
+}
+
+// =====================================================================================================================
+// Dumps the input of a BuildShaderModule call. Only SPIR-V is dumped; a module of any other binary type is recorded
+// but cannot be replayed.
+//
+// @param shaderBin : Shader binary passed to BuildShaderModule
+// @param hash : Shader hash of the module
+void CallTrace::dumpShaderModule(const BinaryData *shaderBin, MetroHash::Hash *hash) {
+  PipelineDumper::DumpSpirvBinary(m_dir.c_str(), shaderBin, hash);
+}
+
+// =====================================================================================================================
+// Dumps the input of a BuildGraphicsPipeline or BuildComputePipeline call. A pipeline that was already dumped is not
+// dumped again. Returns the pipeline hash that names the dumped file.
+//
+// @param pipelineInfo : Build info of the pipeline
+uint64_t CallTrace::dumpPipeline(PipelineBuildInfo pipelineInfo) {
+  MetroHash::Hash hash = {};
+  if (pipelineInfo.pComputeInfo)
+    hash = PipelineDumper::generateHashForComputePipeline(pipelineInfo.pComputeInfo, false, false);
+  else
+    hash = PipelineDumper::generateHashForGraphicsPipeline(pipelineInfo.pGraphicsInfo, false, false);
+
+  PipelineDumpOptions dumpOptions = {};
+  dumpOptions.pDumpDir = m_dir.c_str();
+  PipelineDumper::EndPipelineDump(PipelineDumper::BeginPipelineDump(&dumpOptions, pipelineInfo, &hash));
+  return MetroHash::compact64(&hash);
+}
+
+// =====================================================================================================================
+// Records a finished call in the trace. The record is flushed to the trace file at once, so that the trace of a
+// process that crashes is complete up to the crash.
+//
+// @param type : Kind of call
+// @param hash : Shader hash or pipeline hash, which names the dumped input of the call
+// @param flags : CallTraceFlags of the call
+// @param startTime : Start time of the call, as returned by getTime()
+// @param result : Result of the call
+void CallTrace::record(CallTraceType type, uint64_t hash, uint32_t flags, uint64_t startTime, Result result) {
+  CallTraceRecord record = {};
+  record.type = static_cast<uint32_t>(type);
+  record.startTime = startTime;
+  record.duration = getTime() - startTime;
+  record.hash = hash;
+  record.result = static_cast<uint32_t>(result);
+  record.flags = flags;
+
+  std::lock_guard<sys::Mutex> lock(m_lock);
+  auto threadIndex = m_threadIndices.insert({std::this_thread::get_id(), m_threadIndices.size()});
+  record.threadIndex = threadIndex.first->second;
+  m_stream->write(reinterpret_cast<const char *>(&record), sizeof(record));
+  m_stream->flush();
+}
+
+} // namespace Llpc
@@ -0,0 +1,123 @@
+/*
+ ***********************************************************************************************************************
+ *
+ *  Copyright (c) 2020 Advanced Micro Devices, Inc. All Rights Reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ **********************************************************************************************************************/
+/**
+ ***********************************************************************************************************************
+ @file llpcCallTrace.h
+ @brief LLPC header file: contains declaration of class Llpc::CallTrace and the call trace file format.
+ ***********************************************************************************************************************
+ */
+#pragma once
+
+#include "llpc.h"
+#include "vkgcMetroHash.h"
+#include "llvm/Support/Mutex.h"
+#include "llvm/Support/raw_ostream.h"
+#include <chrono>
+#include <map>
+#include <memory>
+#include <thread>
+
+namespace Llpc {
+
+// Kinds of ICompiler call recorded in a call trace
+enum class CallTraceType : uint32_t {
+  ShaderModule = 0,     // BuildShaderModule
+  GraphicsPipeline = 1, // BuildGraphicsPipeline
+  ComputePipeline = 2,  // BuildComputePipeline
+};
+
+// Flags of a call trace record, describing the cache configuration of the call
+enum CallTraceFlags : uint32_t {
+  CallTraceHasUserCache = 0x1,   // The pipeline build info has an ICache
+  CallTraceHasShaderCache = 0x2, // The pipeline build info has an IShaderCache
+};
+
+// Magic number at the start of a call trace file
+static constexpr char CallTraceMagic[8] = {'L', 'L', 'P', 'C', 'T', 'R', 'C', '\0'};
+
+// Version of the call trace file format
+static constexpr uint32_t CallTraceVersion = 1;
+
+// Name of the call trace file in the capture directory
+static constexpr const char *CallTraceFileName = "calls.llpctrace";
+
+// Header at the start of a call trace file
+struct CallTraceHeader {
+  char magic[8];            // CallTraceMagic
+  uint32_t version;         // CallTraceVersion
+  uint32_t shaderCacheMode; // Shader cache mode of the compiler that started the trace
+  uint32_t gfxIpMajor;      // Graphics IP version of the compiler that started the trace
+  uint32_t gfxIpMinor;
+  uint32_t gfxIpStepping;
+  uint32_t reserved;
+};
+
+// One call in a call trace file. Records are written as calls finish, so they are in order of finish time. The input
+// of a call is dumped next to the trace file, in a file named by its hash: Shader_0x<hash>.spv for a shader module,
+// and Pipeline<stages>_0x<hash>.pipe for a pipeline.
+struct CallTraceRecord {
+  uint32_t type;        // CallTraceType
+  uint32_t threadIndex; // Index of the calling thread, in order of the first call of each thread
+  uint64_t startTime;   // Start of the call, in nanoseconds since the trace was started
+  uint64_t duration;    // Duration of the call in nanoseconds
+  uint64_t hash;        // Shader hash or pipeline hash, which names the dumped input of the call
+  uint32_t result;      // Result of the call
+  uint32_t flags;       // CallTraceFlags
+};
+
+// =====================================================================================================================
+// Captures the ICompiler calls of the process into a call trace, when -capture-trace-dir is given. The trace has the
+// start time, duration and thread of every call, and the inputs of the calls are dumped next to it, so that the
+// workload can be replayed with the same concurrency by amdllpc -replay-trace.
+class CallTrace {
+public:
+  static CallTrace *get(GfxIpVersion gfxIp, unsigned shaderCacheMode);
+
+  // Gets the time since the trace was started, in nanoseconds
+  uint64_t getTime() const {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_startTime)
+        .count();
+  }
+
+  void dumpShaderModule(const BinaryData *shaderBin, MetroHash::Hash *hash);
+  uint64_t dumpPipeline(Vkgc::PipelineBuildInfo pipelineInfo);
+  void record(CallTraceType type, uint64_t hash, uint32_t flags, uint64_t startTime, Result result);
+
+private:
+  CallTrace(const std::string &dir, std::unique_ptr<llvm::raw_fd_ostream> stream)
+      : m_dir(dir), m_stream(std::move(stream)), m_startTime(std::chrono::steady_clock::now()) {}
+
+  CallTrace() = delete;
+  CallTrace(const CallTrace &) = delete;
+  CallTrace &operator=(const CallTrace &) = delete;
+
+  std::string m_dir;                                   // Directory of the trace and the dumped inputs
+  std::unique_ptr<llvm::raw_fd_ostream> m_stream;      // Stream of the trace file
+  std::chrono::steady_clock::time_point m_startTime;   // Time the trace was started
+  llvm::sys::Mutex m_lock;                             // Lock for the stream and the thread indices
+  std::map<std::thread::id, uint32_t> m_threadIndices; // Index of each thread that made a call
+};
+
+} // namespace Llpc
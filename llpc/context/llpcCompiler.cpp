@@ -31,12 +31,14 @@
 #include "llpcCompiler.h"
 #include "LLVMSPIRVLib.h"
 #include "SPIRVInternal.h"
+#include "llpcCallTrace.h"
 #include "llpcComputeContext.h"
 #include "llpcContext.h"
 #include "llpcDebug.h"
 #include "llpcElfWriter.h"
 #include "llpcFile.h"
 #include "llpcGraphicsContext.h"
+#include "llpcPipelineJobQueue.h"
 #include "llpcShaderModuleHelper.h"
 #include "llpcSpirvLower.h"
 #include "llpcSpirvLowerResourceCollect.h"
@@ -48,21 +50,28 @@
 #include "lgc/Builder.h"
 #include "lgc/ElfLinker.h"
 #include "lgc/PassManager.h"
+#include "lgc/TraceEvents.h"
+#include "llvm/ADT/SmallSet.h"
 #include "llvm/BinaryFormat/MsgPackDocument.h"
 #include "llvm/Bitcode/BitcodeWriterPass.h"
 #include "llvm/IR/DiagnosticInfo.h"
 #include "llvm/IR/DiagnosticPrinter.h"
 #include "llvm/IR/IRPrintingPasses.h"
+#include "llvm/IR/OptBisect.h"
 #include "llvm/Linker/Linker.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Format.h"
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/Mutex.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Support/Timer.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Transforms/IPO/AlwaysInliner.h"
+#include <chrono>
+#include <future>
 #include <mutex>
 #include <set>
+#include <unordered_map>
 #include <unordered_set>
 
 #ifdef LLPC_ENABLE_SPIRV_OPT
@@ -122,6 +131,21 @@ opt<int> RelocatableShaderElfLimit("relocatable-shader-elf-limit",
                                             "relocatable shader ELF.  -1 means unlimited."),
                                    init(-1));
 
+// -relocatable-fetch-attrib-limit=<n>: Limits the number of vertex attributes for which a relocatable pipeline is
+// linked with a glue fetch shader. Beyond that, the call and register handoff of the fetch shader costs more than the
+// fast link saves, so the pipeline is fully compiled with vertex fetch inlined into the vertex shader.
+opt<int> RelocatableFetchAttribLimit("relocatable-fetch-attrib-limit",
+                                     cl::desc("Max number of vertex attributes for which a pipeline is linked from "
+                                              "relocatable shader ELF with a fetch shader.  -1 means unlimited."),
+                                     init(-1));
+
+// -pipeline-library-hot-links=<n>: Number of times a combination of graphics pipeline library parts is linked before
+// it counts as hot, and a fully optimized compile of it is scheduled in the background.
+opt<unsigned> PipelineLibraryHotLinks("pipeline-library-hot-links",
+                                      cl::desc("Number of links of the same graphics pipeline library parts after "
+                                               "which an optimized compile of the pipeline is scheduled"),
+                                      init(1));
+
 // -build-relocatable-shader-cache: Populates the shader cache with relocatable shader variants.
 opt<bool> BuildShaderCache("build-shader-cache",
                            cl::desc("[WIP] Populates shader cache with relocatable shader variants."
@@ -134,9 +158,11 @@ opt<bool> BuildShaderCache("build-shader-cache",
 // 2 - Cache to disk
 // 3 - Use internal on-disk cache in read/write mode.
 // 4 - Use internal on-disk cache in read-only mode.
+// 5 - Use a shared memory cache for all processes.
 static opt<unsigned> ShaderCacheMode("shader-cache-mode",
                                      desc("Shader cache mode, 0 - disable, 1 - runtime cache, 2 - cache to disk, 3 - "
-                                          "load on-disk cache for read/write, 4 - load on-disk cache for read only"),
+                                          "load on-disk cache for read/write, 4 - load on-disk cache for read only, "
+                                          "5 - shared memory cache for all processes"),
                                      init(0));
 
 // -executable-name: executable file name
@@ -155,6 +181,21 @@ opt<bool> EnableDynamicLoopUnroll("enable-dynamic-loop-unroll", desc("Enable dyn
 // -force-loop-unroll-count: Force to set the loop unroll count.
 opt<int> ForceLoopUnrollCount("force-loop-unroll-count", cl::desc("Force loop unroll count"), init(0));
 
+// -unroll-feedback-waves: compile a pipeline again with less loop unrolling if its register usage allows fewer waves
+// per SIMD than this, or it spills, and keep the variant with less register pressure (0 disables)
+opt<unsigned> UnrollFeedbackWaves("unroll-feedback-waves",
+                                  desc("Compile a pipeline again with less loop unrolling if its register usage allows "
+                                       "fewer waves per SIMD than this, or it spills registers, and keep the variant "
+                                       "with less register pressure (0 disables)"),
+                                  init(0));
+
+// -compile-time-budget: compile-time budget of a pipeline build in milliseconds, after which the remaining optional
+// optimization passes are skipped (0 disables)
+opt<unsigned> CompileTimeBudget("compile-time-budget",
+                                desc("Compile-time budget of a pipeline build in milliseconds, after which the "
+                                     "remaining optional optimization passes are skipped (0 disables)"),
+                                value_desc("ms"), init(0));
+
 // -enable-shader-module-opt: Enable translate & lower phase in shader module build.
 opt<bool> EnableShaderModuleOpt("enable-shader-module-opt",
                                 cl::desc("Enable translate & lower phase in shader module build."), init(false));
@@ -165,13 +206,90 @@ opt<bool> DisableLicm("disable-licm", desc("Disable LLVM LICM pass"), init(false
 // -trim-debug-info: Trim debug information in SPIR-V binary
 opt<bool> TrimDebugInfo("trim-debug-info", cl::desc("Trim debug information in SPIR-V binary"), init(true));
 
+// -cache-key-hash: hash algorithm of the shader module cache keys
+opt<MetroHash::HashAlgorithm> CacheKeyHash(
+    "cache-key-hash",
+    cl::desc("Hash algorithm of the shader module cache keys (dump file names always use MetroHash64)"),
+    values(clEnumValN(MetroHash::HashAlgorithm::MetroHash64, "metro64", "MetroHash64, widened to 128 bits"),
+           clEnumValN(MetroHash::HashAlgorithm::MetroHash128, "metro128", "MetroHash128, a full 128-bit key")),
+    init(MetroHash::HashAlgorithm::MetroHash64));
+
+// -raw-module-cache-alias: Look up a cached shader module by the hash of its raw code, before scanning it
+opt<bool> RawModuleCacheAlias("raw-module-cache-alias",
+                              cl::desc("Look up a cached shader module by the hash of its raw code, so that a cache "
+                                       "hit does not verify and scan the SPIR-V again"),
+                              init(true));
+
 // -enable-per-stage-cache: Enable shader cache per shader stage
 opt<bool> EnablePerStageCache("enable-per-stage-cache", cl::desc("Enable shader cache per shader stage"), init(true));
 
+// -early-per-stage-cache: Look up the per stage cache before the front-end runs
+opt<bool> EarlyPerStageCache("early-per-stage-cache",
+                             cl::desc("Look up the shader cache per shader stage before the front-end runs"),
+                             init(true));
+
 // -context-reuse-limit: The maximum number of times a compiler context can be reused.
 opt<int> ContextReuseLimit("context-reuse-limit",
                            cl::desc("The maximum number of times a compiler context can be reused"), init(100));
 
+// -context-reuse-spirv-limit: The maximum amount of SPIR-V (in KB) a compiler context can translate before it is
+// recreated.
+opt<unsigned> ContextReuseSpirvLimit("context-reuse-spirv-limit",
+                                     cl::desc("The maximum amount of SPIR-V, in KB, that a compiler context can "
+                                              "translate before it is recreated (0 for no limit)"),
+                                     init(0));
+
+// -context-pool-prewarm: The number of compiler contexts to create in the background when a compiler is created.
+opt<unsigned> ContextPoolPrewarm("context-pool-prewarm",
+                                 cl::desc("The number of compiler contexts, with their target machines, to create on "
+                                          "background threads when a compiler is created (0 to create them on "
+                                          "demand)"),
+                                 init(0));
+
+// -cache-lowered-shaders: Cache the lowered module of each shader stage of a pipeline
+opt<bool> CacheLoweredShaders("cache-lowered-shaders",
+                              cl::desc("Cache the module of each shader stage after SPIR-V translation and lowering, "
+                                       "for reuse by other pipelines"),
+                              init(false));
+
+// -share-shader-module-cache: Share shader module build results between the compilers of the process
+opt<bool> ShareShaderModuleCache("share-shader-module-cache",
+                                 cl::desc("Share the shader module build results of all compilers in the process that "
+                                          "have the same GFXIP and options"),
+                                 init(false));
+
+// -share-shader-module-cache-all-gfxip: Share shader module build results between compilers of different GFXIPs
+opt<bool> ShareShaderModuleCacheAllGfxIp(
+    "share-shader-module-cache-all-gfxip",
+    cl::desc("With -share-shader-module-cache, share the shader module build results of compilers with the same "
+             "options whatever their GFXIP, so the SPIR-V front-end runs once for all the GPUs of the process"),
+    init(false));
+
+// -parallel-stage-lowering: Translate and lower the shader stages of a pipeline in parallel
+opt<bool> ParallelStageLowering("parallel-stage-lowering",
+                                cl::desc("Translate and lower the shader stages of a pipeline in parallel, each in "
+                                         "its own context"),
+                                init(false));
+
+// -strip-pipeline-elf: Strip the sections not needed at run time from compiled pipeline ELFs
+opt<bool> StripPipelineElf("strip-pipeline-elf",
+                           cl::desc("Strip the disassembly, AMDIL and LLVM IR sections from compiled pipeline ELFs "
+                                    "before they are cached and returned"),
+                           init(false));
+
+// -pipeline-elf-debug-dir: Directory where the unstripped pipeline ELFs are written when -strip-pipeline-elf is set
+opt<std::string> PipelineElfDebugDir("pipeline-elf-debug-dir",
+                                     cl::desc("Directory where the unstripped ELF of each pipeline stripped by "
+                                              "-strip-pipeline-elf is written for tools (empty for none)"),
+                                     value_desc("dir"), init(""));
+
+// -async-memory-budget: memory budget of the concurrently running asynchronous pipeline builds in MB, against the
+// estimated peak memory of each build (0 for no budget)
+opt<unsigned> AsyncMemoryBudget("async-memory-budget",
+                                desc("Memory budget, in MB, of the asynchronous pipeline builds running at once; a "
+                                     "build is only started when its estimated peak memory fits (0 for no budget)"),
+                                value_desc("MB"), init(0));
+
 // -fatal-llvm-errors: Make all LLVM errors fatal
 opt<bool> FatalLlvmErrors("fatal-llvm-errors", cl::desc("Make all LLVM errors fatal"), init(false));
 
@@ -192,10 +310,17 @@ static cl::opt<bool> UseBuilderRecorder("use-builder-recorder",
                                         cl::desc("Do lowering via recording and replaying LLPC builder"),
                                         cl::init(true));
 
+// -use-direct-builder
+static cl::opt<bool> UseDirectBuilder("use-direct-builder",
+                                      cl::desc("Emit final IR straight through BuilderImpl in whole-pipeline compiles "
+                                               "that do not need recorded builder calls"),
+                                      cl::init(false));
+
 namespace Llpc {
 
 sys::Mutex Compiler::m_contextPoolMutex;
 std::vector<Context *> *Compiler::m_contextPool = nullptr;
+std::map<unsigned, ContextFreeList *> *Compiler::m_contextFreeLists = nullptr;
 
 // Enumerates modes used in shader replacement
 enum ShaderReplaceMode {
@@ -205,8 +330,23 @@ enum ShaderReplaceMode {
 };
 
 static ManagedStatic<sys::Mutex> SCompilerMutex;
+static std::once_flag SInitializeOnce; // Runs the process-wide LLVM target and pass initialization once
 static bool HaveParsedOptions = false;
 static MetroHash::Hash SOptionHash = {};
+static MetroHash::Hash SGlobalOptionHash = {};
+
+// Options that are captured per compiler instance, in CompilerOptions or when the compiler is created, rather than
+// read from the global LLVM options during a build. Compilers that differ only in these can coexist.
+static const StringRef CompilerOptionNames[] = {"codegen-opt-level",
+                                                "vgpr-limit",
+                                                "sgpr-limit",
+                                                "waves-per-eu",
+                                                "enable-load-scalarizer",
+                                                "scalar-threshold",
+                                                "enable-si-scheduler",
+                                                "subgroup-size",
+                                                "shader-cache-mode",
+                                                "spirv-debug-info"};
 
 unsigned Compiler::m_instanceCount = 0;
 unsigned Compiler::m_outRedirectCount = 0;
@@ -261,6 +401,90 @@ class LlpcDiagnosticHandler : public DiagnosticHandler {
   }
 };
 
+// =====================================================================================================================
+// Represents a scope whose pass costs, with -pass-costs, are collected on the current thread and added to the costs of
+// the compiler when it ends.
+class PassCostScope {
+public:
+  // @param mutex : Mutex for the compiler's pass costs
+  // @param [in/out] passCosts : The compiler's pass costs
+  PassCostScope(sys::Mutex &mutex, PassCostMap &passCosts) : m_mutex(mutex), m_passCosts(passCosts) {
+    if (PassCosts::isEnabled())
+      m_oldCostMap = PassCosts::setThreadCostMap(&m_costMap);
+  }
+
+  ~PassCostScope() {
+    if (PassCosts::isEnabled()) {
+      PassCosts::setThreadCostMap(m_oldCostMap);
+      std::lock_guard<sys::Mutex> lock(m_mutex);
+      PassCosts::merge(m_passCosts, m_costMap);
+    }
+  }
+
+private:
+  PassCostScope(const PassCostScope &) = delete;
+  PassCostScope &operator=(const PassCostScope &) = delete;
+
+  sys::Mutex &m_mutex;                 // Mutex for the compiler's pass costs
+  PassCostMap &m_passCosts;            // The compiler's pass costs
+  PassCostMap m_costMap;               // Pass costs collected in this scope
+  PassCostMap *m_oldCostMap = nullptr; // Pass cost map of the thread before this scope
+};
+
+// =====================================================================================================================
+// Pass gate that lets the optional passes of a build run only until its compile-time budget is used up. LLVM asks the
+// gate before running each pass that can be skipped (the optimizations, including loop unrolling, and optimizing
+// codegen passes such as the machine scheduler), so a build that runs out of time carries on with only the passes it
+// needs for correct code. The gate is shared by the contexts of a build's parallel stage lowering.
+class CompileBudgetGate final : public OptPassGate {
+public:
+  // @param budget : Compile-time budget, from now
+  CompileBudgetGate(std::chrono::milliseconds budget) : m_deadline(std::chrono::steady_clock::now() + budget) {}
+
+  bool shouldRunPass(const Pass *pass, StringRef description) override {
+    if (m_exceeded)
+      return false;
+    if (std::chrono::steady_clock::now() < m_deadline)
+      return true;
+    m_exceeded = true;
+    return false;
+  }
+
+  bool isEnabled() const override { return true; }
+
+  // Get whether the budget was used up
+  bool isExceeded() const { return m_exceeded; }
+
+private:
+  std::chrono::steady_clock::time_point m_deadline; // Time at which the budget is used up
+  std::atomic<bool> m_exceeded{false};              // Whether the budget was used up
+};
+
+// =====================================================================================================================
+// Represents a scope in which an LLVM context uses a pass gate, if one is given.
+class OptPassGateScope {
+public:
+  // @param [in/out] context : LLVM context
+  // @param gate : Pass gate, or nullptr to leave the context unchanged
+  OptPassGateScope(LLVMContext &context, OptPassGate *gate)
+      : m_context(context), m_oldGate(gate ? &context.getOptPassGate() : nullptr) {
+    if (gate)
+      context.setOptPassGate(*gate);
+  }
+
+  ~OptPassGateScope() {
+    if (m_oldGate)
+      m_context.setOptPassGate(*m_oldGate);
+  }
+
+private:
+  OptPassGateScope(const OptPassGateScope &) = delete;
+  OptPassGateScope &operator=(const OptPassGateScope &) = delete;
+
+  LLVMContext &m_context; // LLVM context
+  OptPassGate *m_oldGate; // Pass gate of the context before this scope, or nullptr if it was left unchanged
+};
+
 // =====================================================================================================================
 // Creates LLPC compiler from the specified info.
 //
@@ -278,28 +502,46 @@ Result VKAPI_CALL ICompiler::Create(GfxIpVersion gfxIp, unsigned optionCount, co
 
   raw_null_ostream nullStream;
 
-  std::lock_guard<sys::Mutex> lock(*SCompilerMutex);
+  // Hashing the options needs no lock.
   MetroHash::Hash optionHash = Compiler::generateHashForCompileOptions(optionCount, options);
+  MetroHash::Hash globalOptionHash =
+      Compiler::generateHashForCompileOptions(optionCount, options, /*excludeCompilerOptions=*/true);
+
+  // Initialize the target and the passes, so they can be referenced by -print-after etc. This only needs doing once
+  // per process, and std::call_once costs just an atomic load after that.
+  std::call_once(SInitializeOnce, [] {
+    initializeLowerPasses(*PassRegistry::getPassRegistry());
+    LgcContext::initialize();
+  });
 
-  // Initialize passes so they can be referenced by -print-after etc.
-  initializeLowerPasses(*PassRegistry::getPassRegistry());
-  LgcContext::initialize();
+  std::lock_guard<sys::Mutex> lock(*SCompilerMutex);
 
   bool parseCmdOption = true;
   if (HaveParsedOptions) {
-    bool isSameOption = memcmp(&optionHash, &SOptionHash, sizeof(optionHash)) == 0;
+    bool isSameOption = memcmp(&globalOptionHash, &SGlobalOptionHash, sizeof(globalOptionHash)) == 0;
 
     parseCmdOption = false;
     if (!isSameOption) {
       if (Compiler::getOutRedirectCount() == 0) {
-        // All compiler instances are destroyed, we can reset LLVM options
+        // All compiler instances are destroyed, we can reset LLVM options. That also resets the option defaults set
+        // by LGC, so set them again before parsing.
         cl::ResetAllOptionOccurrences();
+        LgcContext::initialize();
         parseCmdOption = true;
       } else {
         LLPC_ERRS("Incompatible compiler options cross compiler instances!");
         result = Result::ErrorInvalidValue;
         llvm_unreachable("Should never be called!");
       }
+    } else if (memcmp(&optionHash, &SOptionHash, sizeof(optionHash)) != 0) {
+      // Only options that each compiler captures for itself may differ, so re-apply just those. Builds of the
+      // existing compilers do not read them from the LLVM options. If the options are exactly those of the last
+      // compiler created, they are still applied, so creating another such compiler neither parses nor applies any.
+      if (!Compiler::applyCompilerOptions(optionCount, options)) {
+        // The options may be partly applied, so do not let the next compiler skip applying its own.
+        SOptionHash = {};
+        result = Result::ErrorInvalidValue;
+      }
     }
   }
 
@@ -308,12 +550,16 @@ Result VKAPI_CALL ICompiler::Create(GfxIpVersion gfxIp, unsigned optionCount, co
     if (cl::ParseCommandLineOptions(optionCount, options, "AMD LLPC compiler", ignoreErrors ? &nullStream : nullptr)) {
       HaveParsedOptions = true;
     } else {
+      // The options may be partly parsed, so do not let the next compiler take them as those it asked for.
+      SOptionHash = {};
+      SGlobalOptionHash = {};
       result = Result::ErrorInvalidValue;
     }
   }
 
   if (result == Result::Success) {
     SOptionHash = optionHash;
+    SGlobalOptionHash = globalOptionHash;
     *ppCompiler = new Compiler(gfxIp, optionCount, options, SOptionHash, cache);
     assert(*ppCompiler);
 
@@ -346,9 +592,18 @@ bool VKAPI_CALL ICompiler::IsVertexFormatSupported(VkFormat format) {
 // @param cache : Pointer to ICache implemented in client
 Compiler::Compiler(GfxIpVersion gfxIp, unsigned optionCount, const char *const *options, MetroHash::Hash optionHash,
                    ICache *cache)
-    : m_optionHash(optionHash), m_gfxIp(gfxIp), m_cache(cache), m_relocatablePipelineCompilations(0) {
+    : m_optionHash(optionHash), m_gfxIp(gfxIp), m_cache(cache), m_contextFreeList(nullptr),
+      m_relocatablePipelineCompilations(0) {
   for (unsigned i = 0; i < optionCount; ++i)
     m_options.push_back(options[i]);
+  m_compilerOptions = PipelineContext::readCompilerOptions();
+  m_compilerOptions.shaderCacheMode = cl::ShaderCacheMode;
+
+  for (unsigned stage = 0; stage < ShaderStageCount; ++stage) {
+    m_stageCacheHits[stage] = 0;
+    m_stageCacheMisses[stage] = 0;
+  }
+  m_userDataNodeMergeCache = std::make_unique<UserDataNodeMergeCache>();
 
   if (m_outRedirectCount == 0)
     redirectLogOutput(false, optionCount, options);
@@ -362,16 +617,25 @@ Compiler::Compiler(GfxIpVersion gfxIp, unsigned optionCount, const char *const *
       std::lock_guard<sys::Mutex> lock(m_contextPoolMutex);
 
       m_contextPool = new std::vector<Context *>();
+      m_contextFreeLists = new std::map<unsigned, ContextFreeList *>();
     }
   }
 
+  {
+    std::lock_guard<sys::Mutex> lock(m_contextPoolMutex);
+    m_contextFreeList = getContextFreeList(m_gfxIp);
+  }
+
+  if (cl::ContextPoolPrewarm > 0)
+    prewarmContexts(cl::ContextPoolPrewarm);
+
   // Initialize shader cache
   ShaderCacheCreateInfo createInfo = {};
   ShaderCacheAuxCreateInfo auxCreateInfo = {};
-  unsigned shaderCacheMode = cl::ShaderCacheMode;
-  auxCreateInfo.shaderCacheMode = static_cast<ShaderCacheMode>(shaderCacheMode);
+  auxCreateInfo.shaderCacheMode = static_cast<ShaderCacheMode>(m_compilerOptions.shaderCacheMode);
   auxCreateInfo.gfxIp = m_gfxIp;
   auxCreateInfo.hash = m_optionHash;
+  auxCreateInfo.keyHashAlgorithm = cl::CacheKeyHash;
   auxCreateInfo.executableName = cl::ExecutableName.c_str();
 
   const char *shaderCachePath = cl::ShaderCacheFileDir.c_str();
@@ -392,12 +656,39 @@ Compiler::Compiler(GfxIpVersion gfxIp, unsigned optionCount, const char *const *
 
   m_shaderCache = ShaderCacheManager::getShaderCacheManager()->getShaderCacheObject(&createInfo, &auxCreateInfo);
 
+  // The shared shader module cache is a runtime shader cache of its own, found by a hash derived from the option hash,
+  // so that every compiler with the same GFXIP and options gets the same one even if its client cache differs. The
+  // front-end that builds a shader module does not depend on the GFXIP: it only records Builder calls, and a pipeline
+  // build sets its own target machine in the bitcode it loads. So with -share-shader-module-cache-all-gfxip, the
+  // compilers of all GFXIPs get the same cache, and each of them generates code for its own GPU from the bitcode.
+  if (cl::ShareShaderModuleCache) {
+    ShaderCacheAuxCreateInfo moduleAuxCreateInfo = auxCreateInfo;
+    moduleAuxCreateInfo.shaderCacheMode = ShaderCacheEnableRuntime;
+    if (cl::ShareShaderModuleCacheAllGfxIp)
+      moduleAuxCreateInfo.gfxIp = {};
+    MetroHash64 hasher;
+    static const char ModuleCacheTag[] = "ShaderModuleCache";
+    hasher.Update(reinterpret_cast<const uint8_t *>(ModuleCacheTag), sizeof(ModuleCacheTag));
+    hasher.Update(m_optionHash);
+    hasher.Finalize(moduleAuxCreateInfo.hash.bytes);
+    ShaderCacheCreateInfo moduleCreateInfo = {};
+    m_moduleCache =
+        ShaderCacheManager::getShaderCacheManager()->getShaderCacheObject(&moduleCreateInfo, &moduleAuxCreateInfo);
+  }
+
   ++m_instanceCount;
   ++m_outRedirectCount;
 }
 
 // =====================================================================================================================
 Compiler::~Compiler() {
+  // Finish the asynchronous builds and the optimized compiles of tiered builds while the contexts and caches they use
+  // still exist. Queued asynchronous builds are cancelled.
+  m_jobQueue.reset();
+  m_backgroundPool.reset();
+  // Builds release their contexts above, so only then can the context workers finish.
+  m_contextWorkers.reset();
+
   bool shutdown = false;
   {
     // Free context pool
@@ -416,7 +707,20 @@ Compiler::~Compiler() {
       if (maxResidentContextsEnv)
         maxResidentContexts = strtoul(maxResidentContextsEnv, nullptr, 0);
 
-      if (!context->isInUse() && m_contextPool->size() > maxResidentContexts) {
+      bool removed = false;
+      if (m_contextPool->size() > maxResidentContexts) {
+        // A context that is not in use is in the free list of its GfxIp version. Removing it from there under the
+        // free list lock guarantees that no other thread acquires it while it is being deleted.
+        ContextFreeList *freeList = getContextFreeList(context->getGfxIpVersion());
+        std::lock_guard<sys::Mutex> freeListLock(freeList->lock);
+        auto freeIt = std::find(freeList->contexts.begin(), freeList->contexts.end(), context);
+        if (freeIt != freeList->contexts.end()) {
+          freeList->contexts.erase(freeIt);
+          removed = true;
+        }
+      }
+
+      if (removed) {
         it = m_contextPool->erase(it);
         delete context;
       } else
@@ -424,6 +728,14 @@ Compiler::~Compiler() {
     }
   }
 
+  if (m_shaderCache) {
+    // Report the counters of the internal shader cache, which are used to tune -shader-cache-max-size.
+    ShaderCacheCounters counters = m_shaderCache->getCounters();
+    LLPC_OUTS("Shader cache: " << counters.hits << " hits, " << counters.misses << " misses, " << counters.waits
+                               << " waits (" << format("%.3f", counters.waitTime) << " s), " << counters.evictions
+                               << " evictions, " << counters.evictableSize << " bytes evictable\n");
+  }
+
   // Restore default output
   {
     std::lock_guard<sys::Mutex> lock(*SCompilerMutex);
@@ -432,6 +744,8 @@ Compiler::~Compiler() {
       redirectLogOutput(true, 0, nullptr);
 
     ShaderCacheManager::getShaderCacheManager()->releaseShaderCacheObject(m_shaderCache);
+    if (m_moduleCache)
+      ShaderCacheManager::getShaderCacheManager()->releaseShaderCacheObject(m_moduleCache);
   }
 
   {
@@ -447,6 +761,10 @@ Compiler::~Compiler() {
     remove_fatal_error_handler();
     delete m_contextPool;
     m_contextPool = nullptr;
+    for (auto &freeList : *m_contextFreeLists)
+      delete freeList.second;
+    delete m_contextFreeLists;
+    m_contextFreeLists = nullptr;
   }
 }
 
@@ -484,38 +802,88 @@ Result Compiler::BuildShaderModule(const ShaderModuleBuildInfo *shaderInfo, Shad
   Result cacheResult = Result::Unsupported;
   EntryHandle cacheEntry;
   bool allocateOnMiss = true;
+  ShaderCache *moduleCache = m_moduleCache ? m_moduleCache.get() : m_shaderCache.get();
 
-  // Calculate the hash code of input data
-  MetroHash::Hash hash = {};
-  MetroHash64::Hash(reinterpret_cast<const uint8_t *>(shaderInfo->shaderBin.pCode), shaderInfo->shaderBin.codeSize,
-                    hash.bytes);
+  CallTrace *callTrace = CallTrace::get(m_gfxIp, m_compilerOptions.shaderCacheMode);
+  uint64_t callStartTime = callTrace ? callTrace->getTime() : 0;
 
-  memcpy(moduleDataEx.common.hash, &hash, sizeof(hash));
+  // Calculate the hash code of input data. A SPIR-V binary is hashed by the same pass over its code that verifies it,
+  // collects its info and trims its debug info, which also calculates the cache hash of the trimmed code.
+  MetroHash::Hash hash = {};
+  MetroHash::Hash cacheHash = {};
+  const bool isSpirv = ShaderModuleHelper::isSpirvBinary(&shaderInfo->shaderBin);
+#ifdef LLPC_ENABLE_SPIRV_OPT
+  std::vector<uint8_t> optimizedSpirv;
+#endif
+  auto scanSpirv = [&]() {
+    size_t trimmedCodeSize = 0;
+    if (cl::TrimDebugInfo)
+      trimmedCode = new uint8_t[shaderInfo->shaderBin.codeSize];
+    if (ShaderModuleHelper::scanSpirvBinary(&shaderInfo->shaderBin, &moduleDataEx.common.usage, entryNames,
+                                            trimmedCode, &trimmedCodeSize, &hash, cl::CacheKeyHash,
+                                            &cacheHash) != Result::Success) {
+      LLPC_ERRS("Unsupported SPIR-V instructions are found!\n");
+      result = Result::Unsupported;
+      delete[] trimmedCode;
+      trimmedCode = nullptr;
+    }
 
-  TimerProfiler timerProfiler(MetroHash::compact64(&hash), "LLPC ShaderModule",
-                              TimerProfiler::ShaderModuleTimerEnableMask);
+    if (trimmedCode) {
+      moduleDataEx.common.binCode.pCode = trimmedCode;
+      moduleDataEx.common.binCode.codeSize = trimmedCodeSize;
+    } else {
+      moduleDataEx.common.binCode.pCode = shaderInfo->shaderBin.pCode;
+      moduleDataEx.common.binCode.codeSize = shaderInfo->shaderBin.codeSize;
+    }
 
-  // Check the type of input shader binary
-  if (ShaderModuleHelper::isSpirvBinary(&shaderInfo->shaderBin)) {
-    unsigned debugInfoSize = 0;
+#ifdef LLPC_ENABLE_SPIRV_OPT
+    // Run the SPIR-V optimizer once for the module, rather than in the SPIR-V translation of every pipeline that uses
+    // it.
+    if (cl::EnableSpirvOpt && result == Result::Success &&
+        optimizeSpirvCached(cacheHash, &moduleDataEx.common.binCode, optimizedSpirv) == Result::Success) {
+      moduleDataEx.common.binCode.pCode = optimizedSpirv.data();
+      moduleDataEx.common.binCode.codeSize = optimizedSpirv.size();
+    }
+#endif
+  };
 
+  // A module that may be cached is first looked up by the hash of its raw code. The alias entry under that hash gives
+  // the cache hash of the trimmed code, so a cache hit skips the scan of the SPIR-V. If the module itself has since
+  // been evicted, the scan is done after the lookup instead.
+  const bool useAlias =
+      isSpirv && cl::RawModuleCacheAlias && (cl::EnableShaderModuleOpt || shaderInfo->options.enableOpt);
+  MetroHash::Hash aliasHash = {};
+  bool aliasHit = false;
+  bool scanned = false;
+  if (isSpirv) {
     moduleDataEx.common.binType = BinaryType::Spirv;
-    if (ShaderModuleHelper::verifySpirvBinary(&shaderInfo->shaderBin) != Result::Success) {
-      LLPC_ERRS("Unsupported SPIR-V instructions are found!\n");
-      result = Result::Unsupported;
+
+    if (useAlias) {
+      computeShaderModuleAliasHash(&shaderInfo->shaderBin, &hash, &aliasHash);
+      aliasHit = lookUpShaderModuleAlias(aliasHash, &cacheHash);
     }
-    if (result == Result::Success) {
-      ShaderModuleHelper::collectInfoFromSpirvBinary(&shaderInfo->shaderBin, &moduleDataEx.common.usage, entryNames,
-                                                     &debugInfoSize);
+    if (!aliasHit) {
+      scanSpirv();
+      scanned = true;
     }
-    moduleDataEx.common.binCode.codeSize = shaderInfo->shaderBin.codeSize;
-    if (cl::TrimDebugInfo)
-      moduleDataEx.common.binCode.codeSize -= debugInfoSize;
-  } else if (ShaderModuleHelper::isLlvmBitcode(&shaderInfo->shaderBin)) {
-    moduleDataEx.common.binType = BinaryType::LlvmBc;
-    moduleDataEx.common.binCode = shaderInfo->shaderBin;
-  } else
-    result = Result::ErrorInvalidShader;
+  } else {
+    MetroHash64::Hash(reinterpret_cast<const uint8_t *>(shaderInfo->shaderBin.pCode), shaderInfo->shaderBin.codeSize,
+                      hash.bytes);
+  }
+
+  memcpy(moduleDataEx.common.hash, &hash, sizeof(hash));
+
+  TimerProfiler timerProfiler(MetroHash::compact64(&hash), "LLPC ShaderModule",
+                              TimerProfiler::ShaderModuleTimerEnableMask);
+
+  // Check the type of input shader binary, if it is not SPIR-V
+  if (!isSpirv) {
+    if (ShaderModuleHelper::isLlvmBitcode(&shaderInfo->shaderBin)) {
+      moduleDataEx.common.binType = BinaryType::LlvmBc;
+      moduleDataEx.common.binCode = shaderInfo->shaderBin;
+    } else
+      result = Result::ErrorInvalidShader;
+  }
 
   if (moduleDataEx.common.binType == BinaryType::Spirv) {
     // Dump SPIRV binary
@@ -523,18 +891,6 @@ Result Compiler::BuildShaderModule(const ShaderModuleBuildInfo *shaderInfo, Shad
       PipelineDumper::DumpSpirvBinary(cl::PipelineDumpDir.c_str(), &shaderInfo->shaderBin, &hash);
     }
 
-    // Trim debug info
-    if (cl::TrimDebugInfo) {
-      trimmedCode = new uint8_t[moduleDataEx.common.binCode.codeSize];
-      ShaderModuleHelper::trimSpirvDebugInfo(&shaderInfo->shaderBin, moduleDataEx.common.binCode.codeSize, trimmedCode);
-      moduleDataEx.common.binCode.pCode = trimmedCode;
-    } else
-      moduleDataEx.common.binCode.pCode = shaderInfo->shaderBin.pCode;
-
-    // Calculate SPIR-V cache hash
-    MetroHash::Hash cacheHash = {};
-    MetroHash64::Hash(reinterpret_cast<const uint8_t *>(moduleDataEx.common.binCode.pCode),
-                      moduleDataEx.common.binCode.codeSize, cacheHash.bytes);
     static_assert(sizeof(moduleDataEx.common.cacheHash) == sizeof(cacheHash), "Unexpected value!");
     memcpy(moduleDataEx.common.cacheHash, cacheHash.dwords, sizeof(cacheHash));
     HashId cacheHashId = {};
@@ -564,12 +920,22 @@ Result Compiler::BuildShaderModule(const ShaderModuleBuildInfo *shaderInfo, Shad
             }
           }
         }
-      } else {
-        cacheEntryState = m_shaderCache->findShader(cacheHash, allocateOnMiss, &hEntry);
-        if (cacheEntryState == ShaderEntryState::Ready)
-          result = m_shaderCache->retrieveShader(hEntry, &cacheData, &allocSize);
       }
-      if (cacheResult != Result::Success && cacheEntryState != ShaderEntryState::Ready) {
+      // With -share-shader-module-cache, a miss in the client's cache is looked up in the shared cache, and a hit there
+      // is stored in the client's cache too.
+      if (!m_cache || (m_moduleCache && cacheResult != Result::Success)) {
+        cacheEntryState = moduleCache->findShader(cacheHash, allocateOnMiss, &hEntry);
+        if (cacheEntryState == ShaderEntryState::Ready) {
+          result = moduleCache->retrieveShader(hEntry, &cacheData, &allocSize);
+          if (result == Result::Success && m_cache && cacheResult == Result::NotFound)
+            cacheEntry.SetValue(true, cacheData, allocSize);
+        }
+      }
+      if (cacheResult != Result::Success && cacheEntryState != ShaderEntryState::Ready && !scanned) {
+        scanSpirv();
+        scanned = true;
+      }
+      if (cacheResult != Result::Success && cacheEntryState != ShaderEntryState::Ready && result == Result::Success) {
         Context *context = acquireContext();
 
         context->setDiagnosticHandler(std::make_unique<LlpcDiagnosticHandler>());
@@ -674,6 +1040,22 @@ Result Compiler::BuildShaderModule(const ShaderModuleBuildInfo *shaderInfo, Shad
         context->setDiagnosticHandlerCallBack(nullptr);
       }
       moduleDataEx.extra.entryCount = entryNames.size();
+    } else if (result == Result::Success) {
+      // Record the entry-points of the module, so that pipeline builds look them up in this table rather than
+      // scanning the SPIR-V again. The names must point into the code that is stored in the module data, which
+      // differs from the input when it has been trimmed or optimized.
+      if (moduleDataEx.common.binCode.pCode != shaderInfo->shaderBin.pCode) {
+        entryNames.clear();
+        result = ShaderModuleHelper::getEntryPointsFromSpirvBinary(&moduleDataEx.common.binCode, entryNames);
+      }
+      for (const ShaderEntryName &entryName : entryNames) {
+        ShaderModuleEntryData moduleEntryData = {};
+        moduleEntryData.stage = entryName.stage;
+        moduleEntryData.pEntryName = entryName.name;
+        moduleEntryDatas.push_back(moduleEntryData);
+        moduleEntries.push_back(ShaderModuleEntry());
+      }
+      moduleDataEx.extra.entryCount = entryNames.size();
     }
   }
 
@@ -738,9 +1120,17 @@ Result Compiler::BuildShaderModule(const ShaderModuleBuildInfo *shaderInfo, Shad
         entryData[i].pShaderEntry = &entry[i];
         // Copy module entry
         memcpy(entryData[i].pShaderEntry, &moduleEntries[i], sizeof(ShaderModuleEntry));
+        // Entry names of a SPIR-V module point into its code, so move them to the copy of the code.
+        if (moduleDataEx.common.binType == BinaryType::Spirv) {
+          entryData[i].pEntryName =
+              static_cast<const char *>(code) +
+              (entryData[i].pEntryName - static_cast<const char *>(moduleDataEx.common.binCode.pCode));
+        }
         // Copy resourceNodeData and set resource node pointer
-        memcpy(resNodeData, &entryResourceNodeDatas[i][0],
-               moduleEntryDatas[i].resNodeDataCount * sizeof(ResourceNodeData));
+        if (moduleEntryDatas[i].resNodeDataCount > 0) {
+          memcpy(resNodeData, &entryResourceNodeDatas[i][0],
+                 moduleEntryDatas[i].resNodeDataCount * sizeof(ResourceNodeData));
+        }
         entryData[i].pResNodeDatas = resNodeData;
         entryData[i].resNodeDataCount = moduleEntryDatas[i].resNodeDataCount;
         resNodeData += moduleEntryDatas[i].resNodeDataCount;
@@ -763,11 +1153,11 @@ Result Compiler::BuildShaderModule(const ShaderModuleBuildInfo *shaderInfo, Shad
         cacheEntry.SetValue(true, moduleDataExCopy, allocSize);
       if (cacheEntryState == ShaderEntryState::Compiling) {
         if (hEntry)
-          m_shaderCache->insertShader(hEntry, moduleDataExCopy, allocSize);
+          moduleCache->insertShader(hEntry, moduleDataExCopy, allocSize);
       }
     } else {
       // Update the pointers
-      for (unsigned i = 0; i < moduleDataEx.extra.entryCount; ++i) {
+      for (unsigned i = 0; i < moduleDataExCopy->extra.entryCount; ++i) {
         entryData[i].pShaderEntry = &entry[i];
         entryData[i].pResNodeDatas = resNodeData;
         resNodeData += entryData[i].resNodeDataCount;
@@ -776,15 +1166,252 @@ Result Compiler::BuildShaderModule(const ShaderModuleBuildInfo *shaderInfo, Shad
     moduleDataExCopy->common.binCode.pCode = code;
     moduleDataExCopy->extra.pFsOutInfos = fsOutInfo;
     shaderOut->pModuleData = &moduleDataExCopy->common;
+
+    // Record the cache hash under the hash of the raw code, so that the next build of the same code finds the module
+    // without scanning it.
+    if (useAlias && !aliasHit && moduleDataExCopy->common.binType == BinaryType::MultiLlvmBc)
+      addShaderModuleAlias(aliasHash, cacheHash);
   } else {
-    if (hEntry)
-      m_shaderCache->resetShader(hEntry);
+    if (hEntry && cacheEntryState == ShaderEntryState::Compiling)
+      moduleCache->resetShader(hEntry);
   }
+  if (cacheEntryState == ShaderEntryState::Ready)
+    moduleCache->releaseShader(hEntry);
   delete[] allocData;
 
+  if (callTrace) {
+    callTrace->record(CallTraceType::ShaderModule, MetroHash::compact64(&hash), 0, callStartTime, result);
+    if (isSpirv)
+      callTrace->dumpShaderModule(&shaderInfo->shaderBin, &hash);
+  }
+
+  return result;
+}
+
+// =====================================================================================================================
+// Runs the SPIR-V optimizer on the code of a shader module, or gets its result for the same code from the caches. The
+// optimized code is cached under the cache hash of the module and the optimizer configuration, so it is only produced
+// once for a module however many pipelines use it.
+//
+// @param cacheHash : Cache hash of the shader module
+// @param spirvBin : SPIR-V code of the shader module
+// @param [out] optimizedSpirv : Optimized SPIR-V code
+Result Compiler::optimizeSpirvCached(const MetroHash::Hash &cacheHash, const BinaryData *spirvBin,
+                                     std::vector<uint8_t> &optimizedSpirv) const {
+  MetroHash64 hasher;
+  static const char OptimizedSpirvTag[] = "OptimizedSpirv";
+  hasher.Update(reinterpret_cast<const uint8_t *>(OptimizedSpirvTag), sizeof(OptimizedSpirvTag));
+  hasher.Update(cacheHash);
+  ShaderModuleHelper::updateHashForSpirvOpt(&hasher);
+  MetroHash::Hash hash = {};
+  hasher.Finalize(hash.bytes);
+
+  ShaderCache *moduleCache = m_moduleCache ? m_moduleCache.get() : m_shaderCache.get();
+  const void *cacheData = nullptr;
+  size_t cacheDataSize = 0;
+  Result cacheResult = Result::Unsupported;
+  EntryHandle cacheEntry;
+  ShaderEntryState cacheEntryState = ShaderEntryState::New;
+  CacheEntryHandle hEntry = nullptr;
+  if (m_cache) {
+    HashId hashId = {};
+    memcpy(hashId.bytes, hash.bytes, sizeof(hash));
+    cacheResult = m_cache->GetEntry(hashId, true, &cacheEntry);
+    if (cacheResult == Result::NotReady)
+      cacheResult = cacheEntry.WaitForEntry();
+    if (cacheResult == Result::Success) {
+      cacheResult = cacheEntry.GetValueZeroCopy(&cacheData, &cacheDataSize);
+      if (cacheResult == Result::Unsupported && !cacheData) {
+        cacheResult = cacheEntry.GetValue(nullptr, &cacheDataSize);
+        if (cacheResult == Result::Success && cacheDataSize > 0) {
+          optimizedSpirv.resize(cacheDataSize);
+          cacheResult = cacheEntry.GetValue(optimizedSpirv.data(), &cacheDataSize);
+        }
+      } else if (cacheResult == Result::Success) {
+        optimizedSpirv.assign(static_cast<const uint8_t *>(cacheData),
+                              static_cast<const uint8_t *>(cacheData) + cacheDataSize);
+      }
+    }
+  } else {
+    cacheEntryState = moduleCache->findShader(hash, true, &hEntry);
+    if (cacheEntryState == ShaderEntryState::Ready) {
+      cacheResult = moduleCache->retrieveShader(hEntry, &cacheData, &cacheDataSize);
+      if (cacheResult == Result::Success)
+        optimizedSpirv.assign(static_cast<const uint8_t *>(cacheData),
+                              static_cast<const uint8_t *>(cacheData) + cacheDataSize);
+      moduleCache->releaseShader(hEntry);
+      hEntry = nullptr;
+    }
+  }
+  if (cacheResult == Result::Success)
+    return Result::Success;
+
+  BinaryData optimizedSpirvBin = {};
+  Result result = ShaderModuleHelper::optimizeSpirv(spirvBin, &optimizedSpirvBin);
+  if (result == Result::Success) {
+    const uint8_t *optimizedCode = static_cast<const uint8_t *>(optimizedSpirvBin.pCode);
+    optimizedSpirv.assign(optimizedCode, optimizedCode + optimizedSpirvBin.codeSize);
+    ShaderModuleHelper::cleanOptimizedSpirv(&optimizedSpirvBin);
+  }
+
+  // A failed optimization is not cached, so that the next build of the module reports it again.
+  if (m_cache) {
+    if (cacheResult == Result::NotFound)
+      cacheEntry.SetValue(result == Result::Success, optimizedSpirv.data(), optimizedSpirv.size());
+  } else if (hEntry && cacheEntryState == ShaderEntryState::Compiling) {
+    if (result == Result::Success)
+      moduleCache->insertShader(hEntry, optimizedSpirv.data(), optimizedSpirv.size());
+    else
+      moduleCache->resetShader(hEntry);
+  }
   return result;
 }
 
+// =====================================================================================================================
+// Calculates the hash of the raw code of a SPIR-V shader module, and the hash of the alias entry that records the cache
+// hash of the module under it. The alias hash takes the options that change the cache hash of the same code.
+//
+// @param spirvBin : SPIR-V code of the shader module
+// @param [out] hash : MetroHash64 hash of the code, as calculated by ShaderModuleHelper::scanSpirvBinary
+// @param [out] aliasHash : Hash of the alias entry
+void Compiler::computeShaderModuleAliasHash(const BinaryData *spirvBin, MetroHash::Hash *hash,
+                                            MetroHash::Hash *aliasHash) const {
+  const uint8_t *code = static_cast<const uint8_t *>(spirvBin->pCode);
+  MetroHash::Hash codeHash = {};
+  MetroHash::CacheKeyHasher codeHasher(cl::CacheKeyHash);
+  codeHasher.Update(code, spirvBin->codeSize);
+  codeHasher.Finalize(&codeHash);
+
+  // A MetroHash64 key of the code is the hash of the code itself, so the code is only hashed again for a wider key.
+  *hash = {};
+  if (cl::CacheKeyHash == MetroHash::HashAlgorithm::MetroHash64)
+    *hash = codeHash;
+  else
+    MetroHash64::Hash(code, spirvBin->codeSize, hash->bytes);
+
+  static const char ShaderModuleAliasTag[] = "ShaderModuleAlias";
+  const bool trimDebugInfo = cl::TrimDebugInfo;
+  MetroHash::CacheKeyHasher aliasHasher(cl::CacheKeyHash);
+  aliasHasher.Update(reinterpret_cast<const uint8_t *>(ShaderModuleAliasTag), sizeof(ShaderModuleAliasTag));
+  aliasHasher.Update(codeHash.bytes, sizeof(codeHash));
+  aliasHasher.Update(reinterpret_cast<const uint8_t *>(&trimDebugInfo), sizeof(trimDebugInfo));
+  *aliasHash = {};
+  aliasHasher.Finalize(aliasHash);
+}
+
+// =====================================================================================================================
+// Looks up the alias entry of a shader module, which gives the cache hash of the module built from the same raw code.
+// The lookup does not wait for, or allocate, an entry that is not ready.
+//
+// @param aliasHash : Hash of the alias entry
+// @param [out] cacheHash : Cache hash of the shader module
+// @returns : True if the alias entry was found
+bool Compiler::lookUpShaderModuleAlias(const MetroHash::Hash &aliasHash, MetroHash::Hash *cacheHash) const {
+  size_t dataSize = sizeof(*cacheHash);
+  if (m_cache) {
+    HashId hashId = {};
+    memcpy(hashId.bytes, aliasHash.bytes, sizeof(aliasHash));
+    EntryHandle cacheEntry;
+    return m_cache->GetEntry(hashId, false, &cacheEntry) == Result::Success &&
+           cacheEntry.GetValue(cacheHash, &dataSize) == Result::Success && dataSize == sizeof(*cacheHash);
+  }
+
+  ShaderCache *moduleCache = m_moduleCache ? m_moduleCache.get() : m_shaderCache.get();
+  CacheEntryHandle hEntry = nullptr;
+  if (moduleCache->findShader(aliasHash, false, &hEntry) != ShaderEntryState::Ready)
+    return false;
+  const void *data = nullptr;
+  bool found = moduleCache->retrieveShader(hEntry, &data, &dataSize) == Result::Success &&
+               dataSize == sizeof(*cacheHash);
+  if (found)
+    memcpy(cacheHash, data, sizeof(*cacheHash));
+  moduleCache->releaseShader(hEntry);
+  return found;
+}
+
+// =====================================================================================================================
+// Adds the alias entry of a shader module, unless it is already there.
+//
+// @param aliasHash : Hash of the alias entry
+// @param cacheHash : Cache hash of the shader module
+void Compiler::addShaderModuleAlias(const MetroHash::Hash &aliasHash, const MetroHash::Hash &cacheHash) const {
+  if (m_cache) {
+    HashId hashId = {};
+    memcpy(hashId.bytes, aliasHash.bytes, sizeof(aliasHash));
+    EntryHandle cacheEntry;
+    if (m_cache->GetEntry(hashId, true, &cacheEntry) == Result::NotFound)
+      cacheEntry.SetValue(true, &cacheHash, sizeof(cacheHash));
+    return;
+  }
+
+  ShaderCache *moduleCache = m_moduleCache ? m_moduleCache.get() : m_shaderCache.get();
+  CacheEntryHandle hEntry = nullptr;
+  ShaderEntryState cacheEntryState = moduleCache->findShader(aliasHash, true, &hEntry);
+  if (!hEntry)
+    return;
+  if (cacheEntryState == ShaderEntryState::Compiling)
+    moduleCache->insertShader(hEntry, &cacheHash, sizeof(cacheHash));
+  else if (cacheEntryState == ShaderEntryState::Ready)
+    moduleCache->releaseShader(hEntry);
+}
+
+// =====================================================================================================================
+// Check whether a pipeline compile can use BuilderImpl directly, rather than recording builder calls for
+// BuilderReplayer. A whole-pipeline compile has all of its pipeline state set before SPIR-V translation, so the
+// front-end does not have to defer builder calls. Recorded calls are still needed for an unlinked compile, for modules
+// that were translated by BuildShaderModule, and where stages are handed between contexts as bitcode by the cache of
+// lowered shader stages or by parallel stage lowering.
+//
+// @param shaderInfo : Shader info of this pipeline
+// @param unlinked : Whether the compile is unlinked, or builds relocatable shader ELF
+bool Compiler::canUseDirectBuilder(ArrayRef<const PipelineShaderInfo *> shaderInfo, bool unlinked) const {
+  if (unlinked || cl::CacheLoweredShaders || cl::ParallelStageLowering)
+    return false;
+
+  for (const PipelineShaderInfo *shaderInfoEntry : shaderInfo) {
+    if (!shaderInfoEntry || !shaderInfoEntry->pModuleData)
+      continue;
+    const ShaderModuleData *moduleData = reinterpret_cast<const ShaderModuleData *>(shaderInfoEntry->pModuleData);
+    if (moduleData->binType != BinaryType::Spirv)
+      return false;
+  }
+  return true;
+}
+
+// =====================================================================================================================
+// Strips the sections that are not needed at run time from a pipeline ELF that has just been compiled or linked, before
+// it is cached and returned, if -strip-pipeline-elf is set. The unstripped ELF is written first as a sidecar for tools,
+// named after the pipeline hash, if -pipeline-elf-debug-dir is set.
+//
+// @param context : Acquired context
+// @param [in,out] pipelineElf : Pipeline ELF
+static void stripPipelineElf(Context *context, ElfPackage *pipelineElf) {
+  if (!cl::StripPipelineElf)
+    return;
+
+  BinaryData elfBin = {};
+  elfBin.codeSize = pipelineElf->size();
+  elfBin.pCode = pipelineElf->data();
+  ElfPackage strippedElf;
+  if (!ElfWriter<Elf64>::stripNonRuntimeSections(context->getGfxIpVersion(), &elfBin, &strippedElf))
+    return;
+
+  if (!cl::PipelineElfDebugDir.empty()) {
+    std::string fileName;
+    raw_string_ostream(fileName) << cl::PipelineElfDebugDir << "/PipelineElf_"
+                                 << format("0x%016" PRIX64, context->getPiplineHashCode()) << ".elf";
+    File sidecarFile;
+    if (sidecarFile.open(fileName.c_str(), FileAccessWrite | FileAccessBinary) == Result::Success) {
+      sidecarFile.write(pipelineElf->data(), pipelineElf->size());
+      sidecarFile.close();
+    } else
+      LLPC_ERRS("Failed to write unstripped pipeline ELF to " << fileName << "\n");
+  }
+
+  LLPC_OUTS("Stripped pipeline ELF from " << pipelineElf->size() << " to " << strippedElf.size() << " bytes.\n");
+  pipelineElf->swap(strippedElf);
+}
+
 // =====================================================================================================================
 // Builds a pipeline by building relocatable elf files and linking them together.  The relocatable elf files will be
 // cached for future use.
@@ -793,19 +1420,37 @@ Result Compiler::BuildShaderModule(const ShaderModuleBuildInfo *shaderInfo, Shad
 // @param shaderInfo : Shader info of this pipeline
 // @param forceLoopUnrollCount : Force loop unroll count (0 means disable)
 // @param [out] pipelineElf : Output Elf package
+// @param linkStages : False to build one part of a graphics pipeline library: its relocatable elf is returned in
+//                     pipelineElf as it is, without a link
 Result Compiler::buildPipelineWithRelocatableElf(Context *context, ArrayRef<const PipelineShaderInfo *> shaderInfo,
-                                                 unsigned forceLoopUnrollCount, ElfPackage *pipelineElf) {
+                                                 unsigned forceLoopUnrollCount, ElfPackage *pipelineElf,
+                                                 bool linkStages) {
   LLPC_OUTS("Building pipeline with relocatable shader elf.\n")
   Result result = Result::Success;
 
   // Merge the user data once for all stages.
-  context->getPipelineContext()->doUserDataNodeMerge();
+  context->getPipelineContext()->doUserDataNodeMerge(m_userDataNodeMergeCache.get());
   unsigned originalShaderStageMask = context->getPipelineContext()->getShaderStageMask();
   context->getPipelineContext()->setUnlinked(true);
 
+  // The ELF of each stage is referenced in place when it is found in a cache, so it is copied only once, into the
+  // linked pipeline ELF. The cache entries of hits are held until the link is done.
   ElfPackage elf[ShaderStageNativeStageCount];
+  StringRef elfBlobs[ShaderStageNativeStageCount];
+  EntryHandle cacheEntries[ShaderStageNativeStageCount];
+  ShaderCache *hitShaderCaches[ShaderStageNativeStageCount] = {};
+  CacheEntryHandle hHitEntries[ShaderStageNativeStageCount] = {};
+  PipelineBuildStats *buildStats = context->getPipelineContext()->getBuildStats();
+  // A depth-only pipeline is linked with a null fragment shader. That is compiled on its own as the fragment stage,
+  // so it is cached under the fragment key, which all depth-only pipelines with the same fragment state share.
+  // The pre-rasterization part of a pipeline library has no fragment shader of its own; the fragment part of a
+  // depth-only pipeline is the null fragment shader.
+  const bool needNullFs = context->isGraphics() &&
+                          !(originalShaderStageMask & shaderStageToMask(ShaderStageFragment)) &&
+                          (linkStages || originalShaderStageMask == 0);
   for (unsigned stage = 0; stage < shaderInfo.size() && result == Result::Success; ++stage) {
-    if (!shaderInfo[stage] || !shaderInfo[stage]->pModuleData)
+    const bool isNullFs = needNullFs && stage == ShaderStageFragment;
+    if (!isNullFs && (!shaderInfo[stage] || !shaderInfo[stage]->pModuleData))
       continue;
 
     context->getPipelineContext()->setShaderStageMask(shaderStageToMask(static_cast<ShaderStage>(stage)));
@@ -816,14 +1461,14 @@ Result Compiler::buildPipelineWithRelocatableElf(Context *context, ArrayRef<cons
     ICache *userCache = nullptr;
     if (context->isGraphics()) {
       auto pipelineInfo = reinterpret_cast<const GraphicsPipelineBuildInfo *>(context->getPipelineBuildInfo());
-      cacheHash = PipelineDumper::generateHashForGraphicsPipeline(pipelineInfo, true, true, stage);
+      cacheHash = PipelineDumper::generateHashForGraphicsPipeline(pipelineInfo, true, true, stage, &m_optionHash);
 #if LLPC_CLIENT_INTERFACE_MAJOR_VERSION < 38 || LLPC_ENABLE_SHADER_CACHE
       userShaderCache = reinterpret_cast<IShaderCache *>(pipelineInfo->pShaderCache);
 #endif
       userCache = pipelineInfo->cache;
     } else {
       auto pipelineInfo = reinterpret_cast<const ComputePipelineBuildInfo *>(context->getPipelineBuildInfo());
-      cacheHash = PipelineDumper::generateHashForComputePipeline(pipelineInfo, true, true);
+      cacheHash = PipelineDumper::generateHashForComputePipeline(pipelineInfo, true, true, &m_optionHash);
 #if LLPC_CLIENT_INTERFACE_MAJOR_VERSION < 38 || LLPC_ENABLE_SHADER_CACHE
       userShaderCache = reinterpret_cast<IShaderCache *>(pipelineInfo->pShaderCache);
 #endif
@@ -833,29 +1478,34 @@ Result Compiler::buildPipelineWithRelocatableElf(Context *context, ArrayRef<cons
     ShaderEntryState cacheEntryState = ShaderEntryState::New;
     BinaryData elfBin = {};
 
-    EntryHandle cacheEntry;
+    EntryHandle &cacheEntry = cacheEntries[stage];
     HashId hashId = {};
     memcpy(&hashId.bytes, &cacheHash.bytes, sizeof(cacheHash));
-    Result cacheResult = lookUpCaches(userCache, &hashId, &elfBin, &cacheEntry);
+    ShaderCache *shaderCache;
+    CacheEntryHandle hEntry;
+    Result cacheResult = Result::ErrorUnknown;
+    {
+      BuildStatsTimeScope cacheLookupTimeScope(buildStats ? &buildStats->cacheLookupTime : nullptr);
+      cacheResult = lookUpCaches(userCache, &hashId, &elfBin, &cacheEntry);
+      if (cacheResult != Result::Success)
+        cacheEntryState = lookUpShaderCaches(userShaderCache, &cacheHash, &elfBin, &shaderCache, &hEntry);
+    }
     if (cacheResult == Result::Success) {
-      auto data = reinterpret_cast<const char *>(elfBin.pCode);
-      elf[stage].assign(data, data + elfBin.codeSize);
-      // Release Entry
-      ReleaseCacheEntry(false, nullptr, &cacheEntry);
+      elfBlobs[stage] = StringRef(reinterpret_cast<const char *>(elfBin.pCode), elfBin.codeSize);
+      recordStageCacheResult(shaderStageToMask(static_cast<ShaderStage>(stage)), true);
       continue;
     }
 
-    ShaderCache *shaderCache;
-    CacheEntryHandle hEntry;
-    cacheEntryState = lookUpShaderCaches(userShaderCache, &cacheHash, &elfBin, &shaderCache, &hEntry);
-
     if (cacheEntryState == ShaderEntryState::Ready) {
-      auto data = reinterpret_cast<const char *>(elfBin.pCode);
-      elf[stage].assign(data, data + elfBin.codeSize);
+      elfBlobs[stage] = StringRef(reinterpret_cast<const char *>(elfBin.pCode), elfBin.codeSize);
+      hitShaderCaches[stage] = shaderCache;
+      hHitEntries[stage] = hEntry;
       LLPC_OUTS("Cache hit for shader stage " << stage << "\n");
+      recordStageCacheResult(shaderStageToMask(static_cast<ShaderStage>(stage)), true);
       continue;
     }
     LLPC_OUTS("Cache miss for shader stage " << stage << "\n");
+    recordStageCacheResult(shaderStageToMask(static_cast<ShaderStage>(stage)), false);
 
     // There was a cache miss, so we need to build the relocatable shader for
     // this stage.
@@ -870,18 +1520,37 @@ Result Compiler::buildPipelineWithRelocatableElf(Context *context, ArrayRef<cons
     if (result == Result::Success) {
       elfBin.codeSize = elf[stage].size();
       elfBin.pCode = elf[stage].data();
+      elfBlobs[stage] = elf[stage];
     }
     updateShaderCache((result == Result::Success), &elfBin, shaderCache, hEntry);
     LLPC_OUTS("Updating the cache for shader stage " << stage << "\n");
     ReleaseCacheEntry((result == Result::Success), &elfBin, &cacheEntry);
   }
-  context->getPipelineContext()->setShaderStageMask(originalShaderStageMask);
 
-  if (!cl::BuildShaderCache) {
+  if (!linkStages && result == Result::Success) {
+    // Return the relocatable elf of the one stage of the pipeline library part.
+    for (StringRef elfBlob : elfBlobs) {
+      if (!elfBlob.empty())
+        pipelineElf->assign(elfBlob.begin(), elfBlob.end());
+    }
+  } else if (!cl::BuildShaderCache && result == Result::Success) {
     // Link the relocatable shaders into a single pipeline elf file.
     // Not needed if we are just interested in building the cache.
-    linkRelocatableShaderElf(elf, pipelineElf, context);
+    BuildStatsTimeScope linkTimeScope(buildStats ? &buildStats->linkTime : nullptr,
+                                      buildStats ? &buildStats->maxPhaseMemoryGrowth : nullptr);
+    unsigned linkShaderStageMask = originalShaderStageMask;
+    if (needNullFs)
+      linkShaderStageMask |= shaderStageToMask(ShaderStageFragment);
+    context->getPipelineContext()->setShaderStageMask(linkShaderStageMask);
+    linkRelocatableShaderElf(elfBlobs, pipelineElf, context);
+    stripPipelineElf(context, pipelineElf);
   }
+  context->getPipelineContext()->setShaderStageMask(originalShaderStageMask);
+
+  for (EntryHandle &cacheEntry : cacheEntries)
+    ReleaseCacheEntry(false, nullptr, &cacheEntry);
+  for (unsigned stage = 0; stage < ShaderStageNativeStageCount; ++stage)
+    releaseShaderCacheEntry(hitShaderCaches[stage], hHitEntries[stage]);
 
   return result;
 }
@@ -889,29 +1558,55 @@ Result Compiler::buildPipelineWithRelocatableElf(Context *context, ArrayRef<cons
 // =====================================================================================================================
 // Returns true if userDataNode contains descriptor types that are unsupported by relocatable shader compilation.
 //
+// A relocatable shader gets each descriptor through the pointer for its descriptor set. A descriptor set whose
+// descriptors are all in the root table gets the spill table as that pointer when the shader is linked, so root
+// descriptors are supported as long as their set does not also have a descriptor table.
+//
 // @param [in] nodes : user data nodes
 // @param nodeCount : number of user data nodes
 static bool hasUnrelocatableDescriptorNode(const ResourceMappingNode *nodes, unsigned nodeCount) {
+  SmallSet<unsigned, 8> tableSets;
   for (unsigned i = 0; i < nodeCount; ++i) {
     const ResourceMappingNode *node = nodes + i;
-    switch (node->type) {
-    case ResourceMappingNodeType::DescriptorTableVaPtr: {
-      const ResourceMappingNode *startInnerNode = node->tablePtr.pNext;
-      const ResourceMappingNode *endInnerNode = startInnerNode + node->tablePtr.nodeCount;
-      for (const ResourceMappingNode *innerNode = startInnerNode; innerNode != endInnerNode; ++innerNode) {
-        if (innerNode->type == ResourceMappingNodeType::DescriptorBufferCompact)
-          // The code to handle a compact descriptor cannot be easily patched, so relocatable shaders assume there are
-          // no compact descriptors.
-          return true;
+    if (node->type != ResourceMappingNodeType::DescriptorTableVaPtr)
+      continue;
+    const ResourceMappingNode *startInnerNode = node->tablePtr.pNext;
+    const ResourceMappingNode *endInnerNode = startInnerNode + node->tablePtr.nodeCount;
+    for (const ResourceMappingNode *innerNode = startInnerNode; innerNode != endInnerNode; ++innerNode) {
+      switch (innerNode->type) {
+      case ResourceMappingNodeType::DescriptorBufferCompact:
+        // The code to handle a compact descriptor cannot be easily patched, so relocatable shaders assume there are
+        // no compact descriptors.
+      case ResourceMappingNodeType::DescriptorYCbCrSampler:
+        // The sampler conversion is generated from the immutable value of the node, which a relocatable shader does
+        // not have.
+      case ResourceMappingNodeType::InlineBuffer:
+        // A relocatable shader loads a descriptor for the buffer, rather than pointing at its data in the table.
+        return true;
+      default:
+        tableSets.insert(innerNode->srdRange.set);
+        break;
       }
-      break;
     }
+  }
+
+  for (unsigned i = 0; i < nodeCount; ++i) {
+    const ResourceMappingNode *node = nodes + i;
+    switch (node->type) {
     case ResourceMappingNodeType::DescriptorResource:
     case ResourceMappingNodeType::DescriptorSampler:
     case ResourceMappingNodeType::DescriptorCombinedTexture:
     case ResourceMappingNodeType::DescriptorTexelBuffer:
+    case ResourceMappingNodeType::DescriptorBuffer:
+      // A root descriptor can only be relocated if its set pointer can be the spill table.
+      if (tableSets.count(node->srdRange.set))
+        return true;
+      break;
+    case ResourceMappingNodeType::DescriptorFmask:
+      // F-mask may be loaded through the shadow descriptor table, which has no root counterpart.
     case ResourceMappingNodeType::DescriptorBufferCompact:
-      // Generic descriptors in the top level are not handled by the linker.
+    case ResourceMappingNodeType::DescriptorYCbCrSampler:
+    case ResourceMappingNodeType::InlineBuffer:
       return true;
     default:
       break;
@@ -927,11 +1622,15 @@ static bool hasUnrelocatableDescriptorNode(const ResourceMappingNode *nodes, uns
 bool Compiler::canUseRelocatableGraphicsShaderElf(const ArrayRef<const PipelineShaderInfo *> &shaderInfo) {
   for (unsigned stage = 0; stage < shaderInfo.size(); ++stage) {
     if (stage != ShaderStageVertex && stage != ShaderStageFragment) {
+      // Tessellation and geometry shaders are merged with the stage before them into one hardware stage, which
+      // cannot be linked from separately compiled ELFs.
       if (shaderInfo[stage] && shaderInfo[stage]->pModuleData)
         return false;
     } else if (!shaderInfo[stage] || !shaderInfo[stage]->pModuleData) {
-      // TODO: Generate pass-through shaders when the fragment or vertex shaders are missing.
-      return false;
+      // A missing vertex shader has nothing to stand in for it at link time, so the pipeline is compiled whole. A
+      // missing fragment shader is replaced by a null fragment shader when linking.
+      if (stage == ShaderStageVertex)
+        return false;
     } else {
       // Check UserDataNode for unsupported Descriptor types.
       if (hasUnrelocatableDescriptorNode(shaderInfo[stage]->pUserDataNodes, shaderInfo[stage]->userDataNodeCount))
@@ -954,6 +1653,23 @@ bool Compiler::canUseRelocatableGraphicsShaderElf(const ArrayRef<const PipelineS
   return true;
 }
 
+// =====================================================================================================================
+// Returns true if linking a relocatable vertex shader with a glue fetch shader is expected to be cheaper overall than
+// a full compile with vertex fetch inlined. The fetch shader adds a call and a register handoff per vertex, whose cost
+// grows with the number of attributes fetched, so a pipeline with many attributes is fully compiled instead.
+//
+// @param pipelineInfo : Info to build this graphics pipeline
+bool Compiler::isFetchShaderLinkCheaper(const GraphicsPipelineBuildInfo *pipelineInfo) {
+  unsigned attribCount = pipelineInfo->pVertexInput ? pipelineInfo->pVertexInput->vertexAttributeDescriptionCount : 0;
+  if (cl::RelocatableFetchAttribLimit != -1 && attribCount > static_cast<unsigned>(cl::RelocatableFetchAttribLimit)) {
+    LLPC_OUTS("Vertex fetch inlined: " << attribCount << " vertex attributes exceed the fetch shader limit of "
+                                       << cl::RelocatableFetchAttribLimit << ".\n");
+    return false;
+  }
+  LLPC_OUTS("Vertex fetch through fetch shader: " << attribCount << " vertex attributes.\n");
+  return true;
+}
+
 // =====================================================================================================================
 // Returns true if a compute pipeline can be built out of the given shader info.
 //
@@ -998,7 +1714,17 @@ Result Compiler::buildPipelineInternal(Context *context, ArrayRef<const Pipeline
   Result result = Result::Success;
   unsigned passIndex = 0;
   const PipelineShaderInfo *fragmentShaderInfo = nullptr;
-  TimerProfiler timerProfiler(context->getPiplineHashCode(), "LLPC", TimerProfiler::PipelineTimerEnableMask);
+  PipelineBuildStats *buildStats = context->getPipelineContext()->getBuildStats();
+  size_t *maxMemoryGrowth = buildStats ? &buildStats->maxPhaseMemoryGrowth : nullptr;
+  TimerProfiler timerProfiler(context->getPiplineHashCode(), "LLPC", TimerProfiler::PipelineTimerEnableMask,
+                              buildStats);
+  PassCostScope passCostScope(m_passCostsMutex, m_passCosts);
+  // With -compile-time-budget, the optional passes of this build are skipped once the budget is used up.
+  std::unique_ptr<CompileBudgetGate> budgetGate;
+  if (cl::CompileTimeBudget != 0)
+    budgetGate.reset(new CompileBudgetGate(std::chrono::milliseconds(cl::CompileTimeBudget)));
+  context->getPipelineContext()->setCompileBudgetGate(budgetGate.get());
+  OptPassGateScope budgetGateScope(*context, budgetGate.get());
   bool buildingRelocatableElf = context->getPipelineContext()->isUnlinked();
 
   context->setDiagnosticHandler(std::make_unique<LlpcDiagnosticHandler>());
@@ -1010,14 +1736,17 @@ Result Compiler::buildPipelineInternal(Context *context, ArrayRef<const Pipeline
 
   if (!buildingRelocatableElf) {
     // Merge user data for shader stages into one.
-    context->getPipelineContext()->doUserDataNodeMerge();
+    context->getPipelineContext()->doUserDataNodeMerge(m_userDataNodeMergeCache.get());
   }
 
   // Set up middle-end objects.
   LgcContext *builderContext = context->getLgcContext();
   std::unique_ptr<Pipeline> pipeline(builderContext->createPipeline());
   context->getPipelineContext()->setPipelineState(&*pipeline, unlinked);
-  context->setBuilder(builderContext->createBuilder(&*pipeline, UseBuilderRecorder));
+  bool useBuilderRecorder = UseBuilderRecorder;
+  if (UseDirectBuilder && canUseDirectBuilder(shaderInfo, unlinked || buildingRelocatableElf))
+    useBuilderRecorder = false;
+  context->setBuilder(builderContext->createBuilder(&*pipeline, useBuilderRecorder));
 
   std::unique_ptr<Module> pipelineModule;
 
@@ -1030,9 +1759,36 @@ Result Compiler::buildPipelineInternal(Context *context, ArrayRef<const Pipeline
       pipelineModule.reset(context->loadLibary(&moduleData->binCode).release());
   }
 
+  // Set up function to check shader cache.
+  GraphicsShaderCacheChecker graphicsShaderCacheChecker(this, context);
+
+  Pipeline::CheckShaderCacheFunc checkShaderCacheFunc =
+      [&graphicsShaderCacheChecker](
+          const Module *module, unsigned stageMask,
+          ArrayRef<ArrayRef<uint8_t>> stageHashes //
+                                                  // @param module : Module
+                                                  // @param stageMask : Shader stage mask
+                                                  // @param stageHashes : Per-stage hash of in/out usage
+      ) { return graphicsShaderCacheChecker.check(module, stageMask, stageHashes); };
+
+  // Only enable per stage cache for full graphic pipeline
+  bool checkPerStageCache =
+      cl::EnablePerStageCache && context->isGraphics() && !buildingRelocatableElf &&
+      (context->getShaderStageMask() & (shaderStageToMask(ShaderStageVertex) | shaderStageToMask(ShaderStageFragment)));
+  if (!checkPerStageCache)
+    checkShaderCacheFunc = nullptr;
+
+  // If both halves of the pipeline are in the cache under keys that do not need the front-end, skip the compile.
+  bool earlyCacheHit = false;
+  if (checkPerStageCache && cl::EarlyPerStageCache && !unlinked && pipelineModule == nullptr) {
+    earlyCacheHit = graphicsShaderCacheChecker.checkEarly(shaderInfo, forceLoopUnrollCount, pipelineElf);
+    if (earlyCacheHit)
+      fragmentShaderInfo = shaderInfo[ShaderStageFragment];
+  }
+
   // If not IR input, run the per-shader passes, including SPIR-V translation, and then link the modules
   // into a single pipeline module.
-  if (pipelineModule == nullptr) {
+  if (pipelineModule == nullptr && !earlyCacheHit) {
     // Create empty modules and set target machine in each.
     std::vector<Module *> modules(shaderInfo.size());
     unsigned stageSkipMask = 0;
@@ -1084,8 +1840,83 @@ Result Compiler::buildPipelineInternal(Context *context, ArrayRef<const Pipeline
       context->setModuleTargetMachine(module);
     }
 
-    for (unsigned shaderIndex = 0; shaderIndex < shaderInfo.size() && result == Result::Success; ++shaderIndex) {
-      const PipelineShaderInfo *shaderInfoEntry = shaderInfo[shaderIndex];
+    // Look up the cache of lowered shader stages, and load each hit to be linked without translating it again. This
+    // relies on the translator only recording Builder calls, so needs the BuilderRecorder.
+    LoweredShaderCacheChecker loweredShaderCacheChecker(this, context);
+    if (cl::CacheLoweredShaders && useBuilderRecorder) {
+      for (unsigned shaderIndex = 0; shaderIndex < shaderInfo.size() && result == Result::Success; ++shaderIndex) {
+        const PipelineShaderInfo *shaderInfoEntry = shaderInfo[shaderIndex];
+        if (!shaderInfoEntry || !shaderInfoEntry->pModuleData || (stageSkipMask & (1 << shaderIndex)))
+          continue;
+
+        BinaryData bitcode = {};
+        if (!loweredShaderCacheChecker.lookUp(shaderIndex, shaderInfoEntry, forceLoopUnrollCount, &bitcode))
+          continue;
+        Module *module = context->loadLibary(&bitcode).release();
+        if (!module)
+          continue;
+        delete modules[shaderIndex];
+        modules[shaderIndex] = module;
+        stageSkipMask |= (1 << shaderIndex);
+      }
+    }
+
+    // If enabled, translate and lower the shader stages in parallel. Each stage is done in a context of its own and
+    // the result is handed back to this context as bitcode, with the Builder calls and shader modes recorded in it.
+    // Timers and -enable-outs output are not thread-safe, so stay serial if either is in use.
+    unsigned parallelStageCount = 0;
+    for (unsigned shaderIndex = 0; shaderIndex < shaderInfo.size(); ++shaderIndex) {
+      if (shaderInfo[shaderIndex] && shaderInfo[shaderIndex]->pModuleData && !(stageSkipMask & (1 << shaderIndex)))
+        ++parallelStageCount;
+    }
+    if (result == Result::Success && cl::ParallelStageLowering && useBuilderRecorder && parallelStageCount > 1 &&
+        !EnableOuts() && !timerProfiler.getTimer(TimerLower)) {
+      std::vector<SmallVector<char, 0>> bitcodes(shaderInfo.size());
+      std::vector<Result> stageResults(shaderInfo.size(), Result::Success);
+      {
+        BuildStatsTimeScope lowerTimeScope(buildStats ? &buildStats->lowerTime : nullptr, maxMemoryGrowth);
+        ThreadPool threadPool(hardware_concurrency(parallelStageCount));
+        for (unsigned shaderIndex = 0; shaderIndex < shaderInfo.size(); ++shaderIndex) {
+          const PipelineShaderInfo *shaderInfoEntry = shaderInfo[shaderIndex];
+          if (!shaderInfoEntry || !shaderInfoEntry->pModuleData || (stageSkipMask & (1 << shaderIndex)))
+            continue;
+          threadPool.async([=, &bitcodes, &stageResults] {
+            stageResults[shaderIndex] =
+                lowerShaderStage(context->getPipelineContext(), shaderInfoEntry, shaderIndex, forceLoopUnrollCount,
+                                 unlinked, bitcodes[shaderIndex]);
+          });
+        }
+        threadPool.wait();
+      }
+
+      for (unsigned shaderIndex = 0; shaderIndex < shaderInfo.size() && result == Result::Success; ++shaderIndex) {
+        const PipelineShaderInfo *shaderInfoEntry = shaderInfo[shaderIndex];
+        if (!shaderInfoEntry || !shaderInfoEntry->pModuleData || (stageSkipMask & (1 << shaderIndex)))
+          continue;
+        result = stageResults[shaderIndex];
+        if (result != Result::Success)
+          break;
+
+        BinaryData binCode = {};
+        binCode.codeSize = bitcodes[shaderIndex].size();
+        binCode.pCode = bitcodes[shaderIndex].data();
+        Module *module = context->loadLibary(&binCode).release();
+        if (!module) {
+          result = Result::ErrorInvalidShader;
+          break;
+        }
+        delete modules[shaderIndex];
+        modules[shaderIndex] = module;
+        stageSkipMask |= (1 << shaderIndex);
+        if (loweredShaderCacheChecker.needsUpdate(shaderIndex))
+          loweredShaderCacheChecker.update(shaderIndex, true, &binCode);
+        // The module has been parsed from the bitcode, so the bitcode is not needed any more.
+        SmallVector<char, 0>().swap(bitcodes[shaderIndex]);
+      }
+    }
+
+    for (unsigned shaderIndex = 0; shaderIndex < shaderInfo.size() && result == Result::Success; ++shaderIndex) {
+      const PipelineShaderInfo *shaderInfoEntry = shaderInfo[shaderIndex];
       ShaderStage entryStage = shaderInfoEntry ? shaderInfoEntry->entryStage : ShaderStageInvalid;
 
       if (entryStage == ShaderStageFragment)
@@ -1114,6 +1945,7 @@ Result Compiler::buildPipelineInternal(Context *context, ArrayRef<const Pipeline
       timerProfiler.addTimerStartStopPass(&*lowerPassMgr, TimerTranslate, false);
 
       // Run the passes.
+      BuildStatsTimeScope translateTimeScope(buildStats ? &buildStats->translateTime : nullptr, maxMemoryGrowth);
       bool success = runPasses(&*lowerPassMgr, modules[shaderIndex]);
       if (!success) {
         LLPC_ERRS("Failed to translate SPIR-V or run per-shader passes\n");
@@ -1140,46 +1972,58 @@ Result Compiler::buildPipelineInternal(Context *context, ArrayRef<const Pipeline
 
       SpirvLower::addPasses(context, entryStage, *lowerPassMgr, timerProfiler.getTimer(TimerLower),
                             forceLoopUnrollCount);
+
+      // Write out the lowered module if it is to be stored in the cache of lowered shader stages.
+      SmallVector<char, 0> bitcode;
+      raw_svector_ostream bitcodeStream(bitcode);
+      bool updateLoweredShaderCache = loweredShaderCacheChecker.needsUpdate(shaderIndex);
+      if (updateLoweredShaderCache)
+        lowerPassMgr->add(createBitcodeWriterPass(bitcodeStream));
+
       // Run the passes.
+      BuildStatsTimeScope lowerTimeScope(buildStats ? &buildStats->lowerTime : nullptr, maxMemoryGrowth);
       bool success = runPasses(&*lowerPassMgr, modules[shaderIndex]);
       if (!success) {
         LLPC_ERRS("Failed to translate SPIR-V or run per-shader passes\n");
         result = Result::ErrorInvalidShader;
+      } else if (updateLoweredShaderCache) {
+        BinaryData binCode = {};
+        binCode.codeSize = bitcode.size();
+        binCode.pCode = bitcode.data();
+        loweredShaderCacheChecker.update(shaderIndex, true, &binCode);
       }
       modulesToLink.push_back({modules[shaderIndex], getLgcShaderStage(static_cast<ShaderStage>(shaderIndex))});
     }
 
-    // Link the shader modules into a single pipeline module.
-    pipelineModule.reset(pipeline->irLink(modulesToLink, context->getPipelineContext()->isUnlinked()));
-    if (pipelineModule == nullptr) {
-      LLPC_ERRS("Failed to link shader modules into pipeline module\n");
-      result = Result::ErrorInvalidShader;
+    // An unlinked fragment-only compile without a fragment shader builds the null fragment shader for a depth-only
+    // pipeline. Give the middle-end an empty fragment module for it to be generated in.
+    if (result == Result::Success && modulesToLink.empty() && unlinked &&
+        context->getShaderStageMask() == shaderStageToMask(ShaderStageFragment)) {
+      Module *module = new Module("llpcFS.null", *context);
+      context->setModuleTargetMachine(module);
+      modulesToLink.push_back({module, lgc::ShaderStageFragment});
     }
-  }
-
-  // Set up function to check shader cache.
-  GraphicsShaderCacheChecker graphicsShaderCacheChecker(this, context);
-
-  Pipeline::CheckShaderCacheFunc checkShaderCacheFunc =
-      [&graphicsShaderCacheChecker](
-          const Module *module, unsigned stageMask,
-          ArrayRef<ArrayRef<uint8_t>> stageHashes //
-                                                  // @param module : Module
-                                                  // @param stageMask : Shader stage mask
-                                                  // @param stageHashes : Per-stage hash of in/out usage
-      ) { return graphicsShaderCacheChecker.check(module, stageMask, stageHashes); };
 
-  // Only enable per stage cache for full graphic pipeline
-  bool checkPerStageCache =
-      cl::EnablePerStageCache && context->isGraphics() && !buildingRelocatableElf &&
-      (context->getShaderStageMask() & (shaderStageToMask(ShaderStageVertex) | shaderStageToMask(ShaderStageFragment)));
-  if (!checkPerStageCache)
-    checkShaderCacheFunc = nullptr;
+    if (result == Result::Success) {
+      // Link the shader modules into a single pipeline module. irLink takes ownership of the shader modules, and
+      // frees each one as soon as it is linked in.
+      pipelineModule.reset(pipeline->irLink(modulesToLink, context->getPipelineContext()->isUnlinked()));
+      if (pipelineModule == nullptr) {
+        LLPC_ERRS("Failed to link shader modules into pipeline module\n");
+        result = Result::ErrorInvalidShader;
+      }
+    } else {
+      // The shader modules were not handed to irLink. Free them now, rather than leaving them owned by the
+      // LLVM context, which is pooled and outlives this build.
+      for (Module *module : modules)
+        delete module;
+    }
+  }
 
   // Generate pipeline.
   raw_svector_ostream elfStream(*pipelineElf);
 
-  if (result == Result::Success) {
+  if (result == Result::Success && !earlyCacheHit) {
     result = Result::ErrorInvalidShader;
 #if LLPC_ENABLE_EXCEPTION
     try
@@ -1191,6 +2035,7 @@ Result Compiler::buildPipelineInternal(Context *context, ArrayRef<const Pipeline
           timerProfiler.getTimer(TimerCodeGen),
       };
 
+      BuildStatsTimeScope generateTimeScope(buildStats ? &buildStats->generateTime : nullptr, maxMemoryGrowth);
       pipeline->generate(std::move(pipelineModule), elfStream, checkShaderCacheFunc, timers, {});
       result = Result::Success;
     }
@@ -1209,11 +2054,95 @@ Result Compiler::buildPipelineInternal(Context *context, ArrayRef<const Pipeline
       (context->getShaderStageMask() & shaderStageToMask(ShaderStageFragment)))
     graphicsShaderCacheChecker.updateRootUserDateOffset(pipelineElf);
 
+  // Only the final ELF is stripped. The halves in the per stage cache are kept whole, as ELF merging does not expect
+  // the emptied sections, and a relocatable shader ELF is stripped once it is linked, as its relocations refer to
+  // symbols by index.
+  if (result == Result::Success && !unlinked)
+    stripPipelineElf(context, pipelineElf);
+
+  context->getPipelineContext()->setCompileBudgetGate(nullptr);
+  if (budgetGate && budgetGate->isExceeded()) {
+    LLPC_OUTS("Compile-time budget exceeded, optional passes were skipped\n");
+    context->getPipelineContext()->setCompileBudgetExceeded();
+    if (buildStats)
+      buildStats->compileBudgetExceeded = true;
+  }
+
   context->setDiagnosticHandlerCallBack(nullptr);
 
   return result;
 }
 
+// =====================================================================================================================
+// Release the old shader cache entries of the halves of the pipeline that were found in the cache, whose ELFs are
+// used until the ELF outputs are merged.
+GraphicsShaderCacheChecker::~GraphicsShaderCacheChecker() {
+  if (m_fragmentCacheEntryState == ShaderEntryState::Ready)
+    m_compiler->releaseShaderCacheEntry(m_fragmentShaderCache, m_hFragmentEntry);
+  if (m_nonFragmentCacheEntryState == ShaderEntryState::Ready)
+    m_compiler->releaseShaderCacheEntry(m_nonFragmentShaderCache, m_hNonFragmentEntry);
+}
+
+// =====================================================================================================================
+// Check shader cache for graphics pipeline before the front-end has run. This is called from BuildPipelineInternal
+// before SPIR-V translation, so that a pipeline whose fragment and non-fragment halves are both in the cache skips
+// translation, lowering and the middle-end entirely. The in/out usage that check() hashes is not known yet, so the
+// keys from buildEarlyShaderCacheHash are conservative. The halves are only taken if both are found; otherwise the
+// pipeline is compiled as usual with check() as the fallback, and updateAndMerge() stores it under these keys too.
+//
+// Entries that another compile is populating are not waited for, so that an entry we have allocated here cannot
+// deadlock against a compile holding the other half.
+//
+// @param shaderInfo : Shader info of this pipeline
+// @param forceLoopUnrollCount : Force loop unroll count (0 means disable)
+// @param [out] pipelineElf : Pipeline ELF merged from the cached halves, if both were found
+bool GraphicsShaderCacheChecker::checkEarly(ArrayRef<const PipelineShaderInfo *> shaderInfo,
+                                            unsigned forceLoopUnrollCount, ElfPackage *pipelineElf) {
+  // Only the ICache can be looked up without waiting, and only a pipeline with both halves is handled.
+  const unsigned stageMask = m_context->getShaderStageMask();
+  const unsigned fragmentMask = shaderStageToMask(ShaderStageFragment);
+  if (!m_compiler->IsCacheValid() || (stageMask & fragmentMask) == 0 || (stageMask & ~fragmentMask) == 0)
+    return false;
+
+  MetroHash::Hash fragmentHash = {};
+  MetroHash::Hash nonFragmentHash = {};
+  Compiler::buildEarlyShaderCacheHash(m_context, shaderInfo, forceLoopUnrollCount, &fragmentHash, &nonFragmentHash);
+  HashId fragmentHashId = {};
+  HashId nonFragmentHashId = {};
+  memcpy(&fragmentHashId.bytes, &fragmentHash.bytes, sizeof(fragmentHash));
+  memcpy(&nonFragmentHashId.bytes, &nonFragmentHash.bytes, sizeof(nonFragmentHash));
+
+  auto pipelineInfo = reinterpret_cast<const GraphicsPipelineBuildInfo *>(m_context->getPipelineBuildInfo());
+  ICache *userCache = pipelineInfo->cache;
+  BinaryData fragmentElf = {};
+  BinaryData nonFragmentElf = {};
+  m_earlyFragmentCacheResult = m_compiler->lookUpCaches(userCache, &fragmentHashId, &fragmentElf,
+                                                        &m_earlyFragmentEntry, /*waitIfNotReady=*/false);
+  m_earlyNonFragmentCacheResult = m_compiler->lookUpCaches(userCache, &nonFragmentHashId, &nonFragmentElf,
+                                                           &m_earlyNonFragmentEntry, /*waitIfNotReady=*/false);
+
+  bool hit = m_earlyFragmentCacheResult == Result::Success && m_earlyNonFragmentCacheResult == Result::Success;
+  if (hit) {
+    ElfWriter<Elf64> writer(m_context->getGfxIpVersion());
+    auto result = writer.ReadFromBuffer(nonFragmentElf.pCode, nonFragmentElf.codeSize);
+    assert(result == Result::Success);
+    (void(result)); // unused
+    writer.mergeElfBinary(m_context, &fragmentElf, pipelineElf);
+    m_compiler->recordStageCacheResult(stageMask, true);
+  }
+
+  // Keep only the entries that we have allocated, to be populated by updateAndMerge().
+  if (m_earlyFragmentCacheResult != Result::NotFound) {
+    EntryHandle::ReleaseHandle(std::move(m_earlyFragmentEntry));
+    m_earlyFragmentCacheResult = Result::ErrorUnknown;
+  }
+  if (m_earlyNonFragmentCacheResult != Result::NotFound) {
+    EntryHandle::ReleaseHandle(std::move(m_earlyNonFragmentEntry));
+    m_earlyNonFragmentCacheResult = Result::ErrorUnknown;
+  }
+  return hit;
+}
+
 // =====================================================================================================================
 // Check shader cache for graphics pipeline, returning mask of which shader stages we want to keep in this compile.
 // This is called from the PatchCheckShaderCache pass (via a lambda in BuildPipelineInternal), to remove
@@ -1261,14 +2190,21 @@ unsigned GraphicsShaderCacheChecker::check(const Module *module, unsigned stageM
                                                                   &m_nonFragmentShaderCache, &m_hNonFragmentEntry);
   };
 
+  const unsigned lookupStageMask = stageMask;
   auto lookupFragFunc = m_compiler->IsCacheValid() ? lookupFragCache : lookupFragShader;
   auto lookupNonFragFunc = m_compiler->IsCacheValid() ? lookupNonFragCache : lookupNonFragShader;
 
-  if (stageMask & shaderStageToMask(ShaderStageFragment))
-    lookupFragFunc();
+  bool lookupFrag = stageMask & shaderStageToMask(ShaderStageFragment);
+  bool lookupNonFrag = stageMask & ~shaderStageToMask(ShaderStageFragment);
+  if (m_compiler->IsCacheValid() && lookupFrag && lookupNonFrag)
+    lookUpCachesTogether(userCache, &fragmentHashId, &nonFragmentHashId);
+  else {
+    if (lookupFrag)
+      lookupFragFunc();
 
-  if (stageMask & ~shaderStageToMask(ShaderStageFragment))
-    lookupNonFragFunc();
+    if (lookupNonFrag)
+      lookupNonFragFunc();
+  }
 
   if ((m_compiler->IsCacheValid() && m_nonFragmentCacheResult != Result::NotFound) ||
       (!m_compiler->IsCacheValid() && m_nonFragmentCacheEntryState != ShaderEntryState::Compiling))
@@ -1280,9 +2216,156 @@ unsigned GraphicsShaderCacheChecker::check(const Module *module, unsigned stageM
     // Remove fragment shader stages.
     stageMask &= ~shaderStageToMask(ShaderStageFragment);
 
+  m_compiler->recordStageCacheResult(lookupStageMask & ~stageMask, true);
+  m_compiler->recordStageCacheResult(stageMask, false);
   return stageMask;
 }
 
+// =====================================================================================================================
+// Look up both the fragment and the non-fragment half of the pipeline in the ICache caches. Both entries are requested
+// before waiting for either, and entries that another compile is still populating are waited for together, so the
+// latency of a slow cache is paid once rather than twice.
+//
+// Waiting for an entry while holding one we have just allocated could deadlock against another compile holding the
+// two entries the other way round. So if we allocated one half, we do not wait for the other half: we compile it here
+// as well, without populating its entry, which is left to the compile that owns it.
+//
+// @param userCache : ICache supplied by the application
+// @param fragmentHashId : Hash of the fragment half
+// @param nonFragmentHashId : Hash of the non-fragment half
+void GraphicsShaderCacheChecker::lookUpCachesTogether(ICache *userCache, HashId *fragmentHashId,
+                                                      HashId *nonFragmentHashId) {
+  m_fragmentCacheResult =
+      m_compiler->lookUpCaches(userCache, fragmentHashId, &m_fragmentElf, &m_fragmentEntry, /*waitIfNotReady=*/false);
+  m_nonFragmentCacheResult = m_compiler->lookUpCaches(userCache, nonFragmentHashId, &m_nonFragmentElf,
+                                                      &m_nonFragmentEntry, /*waitIfNotReady=*/false);
+
+  bool fragmentNotReady = m_fragmentCacheResult == Result::NotReady;
+  bool nonFragmentNotReady = m_nonFragmentCacheResult == Result::NotReady;
+  if (!fragmentNotReady && !nonFragmentNotReady)
+    return;
+
+  bool holdsAllocatedEntry =
+      m_fragmentCacheResult == Result::NotFound || m_nonFragmentCacheResult == Result::NotFound;
+  if (!holdsAllocatedEntry) {
+    std::future<Result> fragmentWait;
+    if (fragmentNotReady) {
+      fragmentWait = std::async(std::launch::async, [this] {
+        return m_compiler->waitForCacheEntry(&m_fragmentElf, &m_fragmentEntry);
+      });
+    }
+    if (nonFragmentNotReady)
+      m_nonFragmentCacheResult = m_compiler->waitForCacheEntry(&m_nonFragmentElf, &m_nonFragmentEntry);
+    if (fragmentNotReady)
+      m_fragmentCacheResult = fragmentWait.get();
+  }
+
+  // Any half that we did not get from the cache and do not own is compiled here, without populating its entry.
+  if (fragmentNotReady && m_fragmentCacheResult != Result::Success) {
+    EntryHandle::ReleaseHandle(std::move(m_fragmentEntry));
+    m_fragmentCacheResult = Result::NotFound;
+  }
+  if (nonFragmentNotReady && m_nonFragmentCacheResult != Result::Success) {
+    EntryHandle::ReleaseHandle(std::move(m_nonFragmentEntry));
+    m_nonFragmentCacheResult = Result::NotFound;
+  }
+}
+
+// =====================================================================================================================
+// Record failure for any lowered shader stage that we were to store but did not, so that other compiles waiting for
+// it do not wait forever, and release the old shader cache entries of the stages that were found in the cache.
+LoweredShaderCacheChecker::~LoweredShaderCacheChecker() {
+  for (unsigned shaderIndex = 0; shaderIndex < ShaderStageNativeStageCount; ++shaderIndex) {
+    if (needsUpdate(shaderIndex))
+      update(shaderIndex, false, nullptr);
+    StageEntry &stageEntry = m_stages[shaderIndex];
+    if (stageEntry.entryState == ShaderEntryState::Ready)
+      m_compiler->releaseShaderCacheEntry(stageEntry.shaderCache, stageEntry.hEntry);
+  }
+}
+
+// =====================================================================================================================
+// Look up the lowered module of a shader stage in the shader caches. Upon miss, the cache entry is held for the stage
+// until update() stores the module compiled by this pipeline.
+//
+// @param shaderIndex : Index of the shader stage in the pipeline's shader info array
+// @param shaderInfo : Shader info of the shader stage
+// @param forceLoopUnrollCount : Force loop unroll count (0 means disable)
+// @param [out] bitcode : Bitcode of the lowered module upon hit
+bool LoweredShaderCacheChecker::lookUp(unsigned shaderIndex, const PipelineShaderInfo *shaderInfo,
+                                       unsigned forceLoopUnrollCount, BinaryData *bitcode) {
+  // Build the hash from the shader info, including its specialization info and shader options, the pipeline options
+  // that the front-end reads, and the compilation options, which cover the debug info level, the VGPR limit and the
+  // options of the lowering passes. For a SPIR-V module, only the specialization constant values that take effect are
+  // hashed, so pipelines that specialize the module the same way share the entry even if their specialization info
+  // differs.
+  auto pipelineOptions = m_context->getPipelineContext()->getPipelineOptions();
+  MetroHash64 hasher;
+  static const char LoweredShaderTag[] = "LoweredShader";
+  hasher.Update(reinterpret_cast<const uint8_t *>(LoweredShaderTag), sizeof(LoweredShaderTag));
+  const ShaderModuleData *moduleData = reinterpret_cast<const ShaderModuleData *>(shaderInfo->pModuleData);
+  if (moduleData->binType == BinaryType::Spirv) {
+    PipelineShaderInfo unspecializedShaderInfo = *shaderInfo;
+    unspecializedShaderInfo.pSpecializationInfo = nullptr;
+    PipelineDumper::updateHashForPipelineShaderInfo(shaderInfo->entryStage, &unspecializedShaderInfo, true, &hasher,
+                                                    false);
+    ShaderModuleHelper::updateHashForSpecConstants(&moduleData->binCode, shaderInfo->pSpecializationInfo, &hasher);
+  } else
+    PipelineDumper::updateHashForPipelineShaderInfo(shaderInfo->entryStage, shaderInfo, true, &hasher, false);
+  hasher.Update(m_context->getGfxIpVersion());
+  hasher.Update(pipelineOptions->scalarBlockLayout);
+  hasher.Update(pipelineOptions->robustBufferAccess);
+  hasher.Update(pipelineOptions->extendedRobustness.robustBufferAccess);
+  hasher.Update(pipelineOptions->extendedRobustness.robustImageAccess);
+  hasher.Update(pipelineOptions->extendedRobustness.nullDescriptor);
+  hasher.Update(forceLoopUnrollCount);
+  hasher.Update(m_compiler->getOptionHash());
+
+  MetroHash::Hash hash = {};
+  hasher.Finalize(hash.bytes);
+
+  StageEntry &stageEntry = m_stages[shaderIndex];
+  if (m_compiler->IsCacheValid()) {
+    HashId hashId = {};
+    memcpy(&hashId.bytes, &hash.bytes, sizeof(hash));
+    stageEntry.cacheResult = m_compiler->lookUpCaches(nullptr, &hashId, bitcode, &stageEntry.entry);
+    if (stageEntry.cacheResult != Result::Success && stageEntry.cacheResult != Result::NotFound)
+      EntryHandle::ReleaseHandle(std::move(stageEntry.entry));
+    return stageEntry.cacheResult == Result::Success;
+  }
+
+  stageEntry.entryState =
+      m_compiler->lookUpShaderCaches(nullptr, &hash, bitcode, &stageEntry.shaderCache, &stageEntry.hEntry);
+  return stageEntry.entryState == ShaderEntryState::Ready;
+}
+
+// =====================================================================================================================
+// Check whether the lowered module of a shader stage missed in the cache, and so needs to be stored by update().
+//
+// @param shaderIndex : Index of the shader stage in the pipeline's shader info array
+bool LoweredShaderCacheChecker::needsUpdate(unsigned shaderIndex) const {
+  const StageEntry &stageEntry = m_stages[shaderIndex];
+  return stageEntry.cacheResult == Result::NotFound || stageEntry.entryState == ShaderEntryState::Compiling;
+}
+
+// =====================================================================================================================
+// Store the lowered module of a shader stage in the cache entry held since lookUp(), or record failure.
+//
+// @param shaderIndex : Index of the shader stage in the pipeline's shader info array
+// @param success : Whether the shader stage was successfully lowered
+// @param bitcode : Bitcode of the lowered module (ignored if not success)
+void LoweredShaderCacheChecker::update(unsigned shaderIndex, bool success, const BinaryData *bitcode) {
+  StageEntry &stageEntry = m_stages[shaderIndex];
+  if (stageEntry.cacheResult == Result::NotFound) {
+    m_compiler->ReleaseCacheEntry(success, bitcode, &stageEntry.entry);
+    stageEntry.cacheResult = Result::ErrorUnknown;
+  }
+  if (stageEntry.entryState == ShaderEntryState::Compiling) {
+    m_compiler->updateShaderCache(success, bitcode, stageEntry.shaderCache, stageEntry.hEntry);
+    stageEntry.entryState = ShaderEntryState::New;
+  }
+}
+
 // =====================================================================================================================
 // Update root level descriptor offset for graphics pipeline.
 //
@@ -1310,17 +2393,27 @@ void GraphicsShaderCacheChecker::updateAndMerge(Result result, ElfPackage *outpu
     pipelineElf.codeSize = outputPipelineElf->size();
     pipelineElf.pCode = outputPipelineElf->data();
 
+    // The fragment half is stored pre-split, so that merging it on a later cache hit does not parse an ELF.
+    ElfPackage fragmentPart;
+    BinaryData fragmentElf = pipelineElf;
+    if (result == Result::Success &&
+        (m_fragmentCacheEntryState == ShaderEntryState::Compiling || m_fragmentCacheResult == Result::NotFound)) {
+      ElfWriter<Elf64>::splitFragmentElf(m_context->getGfxIpVersion(), &pipelineElf, &fragmentPart);
+      fragmentElf.codeSize = fragmentPart.size();
+      fragmentElf.pCode = fragmentPart.data();
+    }
+
     if (m_compiler->IsCacheValid()) {
       bool withValue = (result == Result::Success);
 
-      m_compiler->ReleaseCacheEntry(withValue && (m_fragmentCacheResult == Result::NotFound), &pipelineElf,
+      m_compiler->ReleaseCacheEntry(withValue && (m_fragmentCacheResult == Result::NotFound), &fragmentElf,
                                     &m_fragmentEntry);
       m_compiler->ReleaseCacheEntry(withValue && (m_nonFragmentCacheResult == Result::NotFound), &pipelineElf,
                                     &m_nonFragmentEntry);
     }
 
     if (m_fragmentCacheEntryState == ShaderEntryState::Compiling) {
-      m_compiler->updateShaderCache(result == Result::Success, &pipelineElf, m_fragmentShaderCache, m_hFragmentEntry);
+      m_compiler->updateShaderCache(result == Result::Success, &fragmentElf, m_fragmentShaderCache, m_hFragmentEntry);
     }
 
     if (m_nonFragmentCacheEntryState == ShaderEntryState::Compiling) {
@@ -1363,6 +2456,29 @@ void GraphicsShaderCacheChecker::updateAndMerge(Result result, ElfPackage *outpu
     (void(result)); // unused
     writer.mergeElfBinary(m_context, &fragmentElf, outputPipelineElf);
   }
+
+  // Store the halves of the complete pipeline ELF under the keys that checkEarly() allocated.
+  if (m_earlyFragmentCacheResult == Result::NotFound || m_earlyNonFragmentCacheResult == Result::NotFound) {
+    BinaryData pipelineElf = {};
+    pipelineElf.codeSize = outputPipelineElf->size();
+    pipelineElf.pCode = outputPipelineElf->data();
+
+    ElfPackage fragmentPart;
+    BinaryData fragmentElf = {};
+    if (result == Result::Success && m_earlyFragmentCacheResult == Result::NotFound) {
+      ElfWriter<Elf64>::splitFragmentElf(m_context->getGfxIpVersion(), &pipelineElf, &fragmentPart);
+      fragmentElf.codeSize = fragmentPart.size();
+      fragmentElf.pCode = fragmentPart.data();
+    }
+
+    bool withValue = (result == Result::Success);
+    if (m_earlyFragmentCacheResult == Result::NotFound)
+      m_compiler->ReleaseCacheEntry(withValue, &fragmentElf, &m_earlyFragmentEntry);
+    if (m_earlyNonFragmentCacheResult == Result::NotFound)
+      m_compiler->ReleaseCacheEntry(withValue, &pipelineElf, &m_earlyNonFragmentEntry);
+    m_earlyFragmentCacheResult = Result::ErrorUnknown;
+    m_earlyNonFragmentCacheResult = Result::ErrorUnknown;
+  }
 }
 
 // =====================================================================================================================
@@ -1380,6 +2496,7 @@ unsigned Compiler::ConvertColorBufferFormatToExportFormat(const ColorTarget *tar
   std::tie(format.dfmt, format.nfmt) = PipelineContext::mapVkFormat(target->format, true);
   format.blendEnable = target->blendEnable;
   format.blendSrcAlphaToColor = target->blendSrcAlphaToColor;
+  format.channelWriteMask = target->channelWriteMask;
   state.alphaToCoverageEnable = enableAlphaToCoverage;
   pipeline->setColorExportState(format, state);
 
@@ -1416,6 +2533,161 @@ Result Compiler::buildGraphicsPipelineInternal(GraphicsContext *graphicsContext,
   return result;
 }
 
+// PAL metadata registers that are set from graphics pipeline state left out of the cache hash
+static const unsigned MmPaClClipCntl = 0xA204;
+static const unsigned MmPaScAaConfig = 0xA2F8;
+
+// =====================================================================================================================
+// Sets the PAL metadata register bits that come from graphics pipeline state that only affects metadata, which
+// PipelineDumper::updateHashForNonFragmentState and updateHashForFragmentState leave out of the cache hash. An ELF
+// from the cache may have been compiled with other values of that state. The ELF is left as it is if the registers
+// already match, which is the usual case.
+//
+// Returns true if the registers were set, in which case elfBin is changed to refer to the patched ELF in patchedElf.
+//
+// @param gfxIp : Graphics IP version info
+// @param pipelineInfo : Info to build the graphics pipeline
+// @param [in,out] elfBin : Pipeline ELF
+// @param [out] patchedElf : Storage for the patched ELF
+static bool setMetadataOnlyRegisters(GfxIpVersion gfxIp, const GraphicsPipelineBuildInfo *pipelineInfo,
+                                     BinaryData *elfBin, ElfPackage *patchedElf) {
+  struct RegisterBits {
+    unsigned regNumber;
+    unsigned mask;
+    unsigned value;
+  };
+  SmallVector<RegisterBits, 2> registers;
+
+  // PA_CL_CLIP_CNTL: UCP_ENA_0..5, DX_RASTERIZATION_KILL, ZCLIP_NEAR_DISABLE and ZCLIP_FAR_DISABLE.
+  const unsigned depthClipDisable = pipelineInfo->vpState.depthClipEnable ? 0 : 1;
+  registers.push_back({MmPaClClipCntl, 0x3F | (1u << 22) | (3u << 26),
+                       (pipelineInfo->rsState.usrClipPlaneMask & 0x3Fu) |
+                           (pipelineInfo->rsState.rasterizerDiscardEnable ? 1u << 22 : 0) |
+                           (depthClipDisable << 26) | (depthClipDisable << 27)});
+
+  // PA_SC_AA_CONFIG: COVERAGE_TO_SHADER_SELECT, which is only set on GFX9+.
+  if (gfxIp.major >= 9)
+    registers.push_back({MmPaScAaConfig, 3u << 26, (pipelineInfo->rsState.innerCoverage ? 1u : 0) << 26});
+
+  bool patched = false;
+  for (const RegisterBits &reg : registers) {
+    ElfPackage newElf;
+    if (ElfWriter<Elf64>::updatePalMetadataRegister(gfxIp, elfBin, reg.regNumber, reg.mask, reg.value, &newElf)) {
+      patchedElf->swap(newElf);
+      elfBin->pCode = patchedElf->data();
+      elfBin->codeSize = patchedElf->size();
+      patched = true;
+    }
+  }
+  return patched;
+}
+
+// Register pressure of a pipeline ELF, from its PAL metadata.
+struct RegisterPressure {
+  unsigned waves;   // Fewest waves per SIMD that the register usage of any hardware stage allows
+  bool usesScratch; // Whether any hardware stage uses scratch memory, which is where spilled registers go
+};
+
+// =====================================================================================================================
+// Gets the register pressure of a pipeline ELF. Returns false if the ELF has no usable PAL metadata.
+//
+// @param gfxIp : Graphics IP version info
+// @param elf : Pipeline ELF
+// @param [out] pressure : Register pressure of the ELF
+static bool getRegisterPressure(GfxIpVersion gfxIp, const ElfPackage &elf, RegisterPressure *pressure) {
+  ElfReader<Elf64> reader(gfxIp);
+  size_t readSize = elf.size();
+  if (reader.ReadFromBuffer(elf.data(), &readSize) != Result::Success)
+    return false;
+  ElfNote metaNote = reader.getNote(Util::Abi::PipelineAbiNoteType::PalMetadata);
+  if (!metaNote.data)
+    return false;
+  msgpack::Document document;
+  if (!document.readFromBlob(StringRef(reinterpret_cast<const char *>(metaNote.data), metaNote.hdr.descSize), false))
+    return false;
+
+  auto getUInt = [](msgpack::MapDocNode &map, StringRef key) -> unsigned {
+    auto it = map.find(key);
+    return it != map.end() && it->second.getKind() == msgpack::Type::UInt ? it->second.getUInt() : 0;
+  };
+
+  auto &pipelines = document.getRoot().getMap(true)[Util::Abi::PalCodeObjectMetadataKey::Pipelines].getArray(true);
+  if (pipelines.size() == 0)
+    return false;
+  auto &hwStages = pipelines[0].getMap(true)[Util::Abi::PipelineMetadataKey::HardwareStages].getMap(true);
+  pressure->waves = 0;
+  pressure->usesScratch = false;
+  for (auto &hwStage : hwStages) {
+    if (!hwStage.second.isMap())
+      continue;
+    auto &stageMap = hwStage.second.getMap();
+    const unsigned vgprCount = std::max(getUInt(stageMap, Util::Abi::HardwareStageMetadataKey::VgprCount), 1U);
+    const unsigned sgprCount = std::max(getUInt(stageMap, Util::Abi::HardwareStageMetadataKey::SgprCount), 1U);
+    const unsigned waveSize = getUInt(stageMap, Util::Abi::HardwareStageMetadataKey::WavefrontSize);
+    unsigned waves = 0;
+    if (gfxIp.major >= 10) {
+      // A SIMD32 has 1024 VGPRs per lane, allocated in blocks of 8; a wave64 uses two lanes' worth.
+      const unsigned vgprWaves = (waveSize == 32 ? 1024 : 512) / alignTo(vgprCount, 8);
+      waves = std::min(waveSize == 32 ? 20U : 10U, vgprWaves);
+    } else {
+      const unsigned vgprWaves = 256 / alignTo(vgprCount, 4);
+      const unsigned sgprWaves = gfxIp.major >= 8 ? 800 / alignTo(sgprCount, 16) : 512 / alignTo(sgprCount, 8);
+      waves = std::min(10U, std::min(vgprWaves, sgprWaves));
+    }
+    waves = std::max(waves, 1U);
+    pressure->waves = pressure->waves == 0 ? waves : std::min(pressure->waves, waves);
+    if (getUInt(stageMap, Util::Abi::HardwareStageMetadataKey::ScratchMemorySize) != 0)
+      pressure->usesScratch = true;
+  }
+  return pressure->waves != 0;
+}
+
+// =====================================================================================================================
+// Checks whether a pipeline should be compiled again with less loop unrolling, because -unroll-feedback-waves is set
+// and the register usage of its first compile allows fewer waves than that, or spills. Returns the loop unroll count
+// to force in the second compile.
+//
+// @param gfxIp : Graphics IP version info
+// @param elf : Pipeline ELF of the first compile
+// @param forceLoopUnrollCount : Force loop unroll count of the first compile (0 means disable)
+// @param [out] lessUnrollCount : Force loop unroll count for the second compile
+static bool needsLessUnrolling(GfxIpVersion gfxIp, const ElfPackage &elf, unsigned forceLoopUnrollCount,
+                               unsigned *lessUnrollCount) {
+  if (cl::UnrollFeedbackWaves == 0 || forceLoopUnrollCount == 1)
+    return false;
+  RegisterPressure pressure = {};
+  if (!getRegisterPressure(gfxIp, elf, &pressure))
+    return false;
+  if (pressure.waves >= cl::UnrollFeedbackWaves && !pressure.usesScratch)
+    return false;
+  // Halve a forced unroll count; otherwise stop unrolling the loops that have no unroll hint in the SPIR-V.
+  *lessUnrollCount = forceLoopUnrollCount > 1 ? forceLoopUnrollCount / 2 : 1;
+  return true;
+}
+
+// =====================================================================================================================
+// Checks whether the less unrolled compile of a pipeline is the better one. That is the case if it does not spill
+// when the first one does, or if its register usage allows more waves, up to the -unroll-feedback-waves target.
+// Otherwise the first compile is kept, as its unrolled loops run fewer instructions.
+//
+// @param gfxIp : Graphics IP version info
+// @param firstElf : Pipeline ELF of the first compile
+// @param lessUnrolledElf : Pipeline ELF of the compile with less loop unrolling
+static bool isLessUnrollingBetter(GfxIpVersion gfxIp, const ElfPackage &firstElf, const ElfPackage &lessUnrolledElf) {
+  RegisterPressure first = {};
+  RegisterPressure lessUnrolled = {};
+  if (!getRegisterPressure(gfxIp, firstElf, &first) || !getRegisterPressure(gfxIp, lessUnrolledElf, &lessUnrolled))
+    return false;
+  if (first.usesScratch != lessUnrolled.usesScratch)
+    return first.usesScratch;
+  const unsigned target = cl::UnrollFeedbackWaves;
+  const bool better = std::min(lessUnrolled.waves, target) > std::min(first.waves, target);
+  LLPC_OUTS("Loop unroll feedback: waves " << first.waves << (first.usesScratch ? " (spills)" : "") << " -> "
+                                           << lessUnrolled.waves << (lessUnrolled.usesScratch ? " (spills)" : "")
+                                           << ", keeping the " << (better ? "less unrolled" : "first") << " compile\n");
+  return better;
+}
+
 // =====================================================================================================================
 // Build graphics pipeline from the specified info.
 //
@@ -1427,19 +2699,31 @@ Result Compiler::BuildGraphicsPipeline(const GraphicsPipelineBuildInfo *pipeline
   Result result = Result::Success;
   BinaryData elfBin = {};
 
+  CallTrace *callTrace = CallTrace::get(m_gfxIp, m_compilerOptions.shaderCacheMode);
+  uint64_t callStartTime = 0;
+  uint64_t callHash = 0;
+  if (callTrace) {
+    PipelineBuildInfo buildInfo = {};
+    buildInfo.pGraphicsInfo = pipelineInfo;
+    callHash = callTrace->dumpPipeline(buildInfo);
+    callStartTime = callTrace->getTime();
+  }
+
   const PipelineShaderInfo *shaderInfo[ShaderStageGfxCount] = {
       &pipelineInfo->vs, &pipelineInfo->tcs, &pipelineInfo->tes, &pipelineInfo->gs, &pipelineInfo->fs,
   };
 
   bool buildingRelocatableElf = pipelineInfo->options.enableRelocatableShaderElf || cl::UseRelocatableShaderElf;
   buildingRelocatableElf = buildingRelocatableElf && canUseRelocatableGraphicsShaderElf(shaderInfo);
+  buildingRelocatableElf = buildingRelocatableElf && isFetchShaderLinkCheaper(pipelineInfo);
 
   for (unsigned i = 0; i < ShaderStageGfxCount && result == Result::Success; ++i)
     result = validatePipelineShaderInfo(shaderInfo[i]);
 
   MetroHash::Hash cacheHash = {};
   MetroHash::Hash pipelineHash = {};
-  cacheHash = PipelineDumper::generateHashForGraphicsPipeline(pipelineInfo, true, buildingRelocatableElf);
+  cacheHash = PipelineDumper::generateHashForGraphicsPipeline(pipelineInfo, true, buildingRelocatableElf,
+                                                              ShaderStageInvalid, &m_optionHash);
   pipelineHash = PipelineDumper::generateHashForGraphicsPipeline(pipelineInfo, false, false);
 
   if (result == Result::Success && EnableOuts()) {
@@ -1481,7 +2765,12 @@ Result Compiler::BuildGraphicsPipeline(const GraphicsPipelineBuildInfo *pipeline
   EntryHandle cacheEntry;
   Result cacheResult = Result::ErrorUnknown;
 
+  PipelineBuildStats *buildStats = pipelineOut->pStats;
+  if (buildStats)
+    memset(buildStats, 0, sizeof(PipelineBuildStats));
+
   if (!buildingRelocatableElf) {
+    BuildStatsTimeScope cacheLookupTimeScope(buildStats ? &buildStats->cacheLookupTime : nullptr);
     if (m_cache)
       cacheResult = lookUpCaches(userCache, &hashId, &elfBin, &cacheEntry);
     else
@@ -1491,33 +2780,76 @@ Result Compiler::BuildGraphicsPipeline(const GraphicsPipelineBuildInfo *pipeline
   }
 
   ElfPackage candidateElf;
+  ElfPackage patchedElf;
+
+  if (buildStats)
+    buildStats->cacheHit = cacheEntryState == ShaderEntryState::Ready || cacheResult == Result::Success;
 
   if (cacheEntryState == ShaderEntryState::Compiling || (m_cache && cacheResult != Result::Success)) {
     unsigned forceLoopUnrollCount = cl::ForceLoopUnrollCount;
 
     GraphicsContext graphicsContext(m_gfxIp, pipelineInfo, &pipelineHash, &cacheHash);
+    graphicsContext.setBuildStats(buildStats);
+    graphicsContext.setCompilerOptions(&m_compilerOptions);
     result = buildGraphicsPipelineInternal(&graphicsContext, shaderInfo, forceLoopUnrollCount, buildingRelocatableElf,
                                            &candidateElf);
 
+    unsigned lessUnrollCount = 0;
+    if (result == Result::Success && !buildingRelocatableElf && !graphicsContext.isCompileBudgetExceeded() &&
+        needsLessUnrolling(m_gfxIp, candidateElf, forceLoopUnrollCount, &lessUnrollCount)) {
+      GraphicsContext lessUnrolledContext(m_gfxIp, pipelineInfo, &pipelineHash, &cacheHash);
+      lessUnrolledContext.setBuildStats(buildStats);
+      lessUnrolledContext.setCompilerOptions(&m_compilerOptions);
+      ElfPackage lessUnrolledElf;
+      if (buildGraphicsPipelineInternal(&lessUnrolledContext, shaderInfo, lessUnrollCount, false, &lessUnrolledElf) ==
+              Result::Success &&
+          isLessUnrollingBetter(m_gfxIp, candidateElf, lessUnrolledElf)) {
+        candidateElf.swap(lessUnrolledElf);
+        if (buildStats)
+          buildStats->lessUnrolled = true;
+      }
+    }
+
     if (result == Result::Success) {
       elfBin.codeSize = candidateElf.size();
       elfBin.pCode = candidateElf.data();
+      // Halves of the pipeline merged from the shader caches may have been compiled with other metadata-only state.
+      setMetadataOnlyRegisters(m_gfxIp, pipelineInfo, &elfBin, &patchedElf);
     }
 
     if (!buildingRelocatableElf && !m_cache)
       updateShaderCache((result == Result::Success), &elfBin, shaderCache, hEntry);
   }
 
-  if (result == Result::Success) {
+  if (pipelineOut->ppBinHandle)
+    *pipelineOut->ppBinHandle = nullptr;
+
+  const bool cacheHit = m_cache ? cacheResult == Result::Success : cacheEntryState == ShaderEntryState::Ready;
+  // A cache hit whose metadata-only state differs is returned as a patched copy rather than in cache memory.
+  const bool patchedCacheHit =
+      result == Result::Success && cacheHit && setMetadataOnlyRegisters(m_gfxIp, pipelineInfo, &elfBin, &patchedElf);
+  if (result == Result::Success && cacheHit && !patchedCacheHit && pipelineOut->ppBinHandle) {
+    // Return the ELF in cache memory, and hand the cache entry over to the client, which releases it with
+    // ReleasePipelineBinary.
+    PipelineBinaryHandle *binHandle = new PipelineBinaryHandle;
+    binHandle->cacheEntry = std::move(cacheEntry);
+    binHandle->shaderCache = shaderCache;
+    binHandle->hEntry = hEntry;
+    hEntry = nullptr;
+    pipelineOut->pipelineBin = elfBin;
+    *pipelineOut->ppBinHandle = binHandle;
+  } else if (result == Result::Success) {
     void *allocBuf = nullptr;
     if (pipelineInfo->pfnOutputAlloc) {
       allocBuf = pipelineInfo->pfnOutputAlloc(pipelineInfo->pInstance, pipelineInfo->pUserData, elfBin.codeSize);
+      if (allocBuf) {
+        uint8_t *code = static_cast<uint8_t *>(allocBuf);
+        memcpy(code, elfBin.pCode, elfBin.codeSize);
 
-      uint8_t *code = static_cast<uint8_t *>(allocBuf);
-      memcpy(code, elfBin.pCode, elfBin.codeSize);
-
-      pipelineOut->pipelineBin.codeSize = elfBin.codeSize;
-      pipelineOut->pipelineBin.pCode = code;
+        pipelineOut->pipelineBin.codeSize = elfBin.codeSize;
+        pipelineOut->pipelineBin.pCode = code;
+      } else
+        result = Result::ErrorOutOfMemory;
     } else {
       // Allocator is not specified
       result = Result::ErrorInvalidPointer;
@@ -1527,11 +2859,292 @@ Result Compiler::BuildGraphicsPipeline(const GraphicsPipelineBuildInfo *pipeline
   if (m_cache) {
     bool withValue = (result == Result::Success) && (cacheResult != Result::Success);
     ReleaseCacheEntry(withValue, &elfBin, &cacheEntry);
+  } else if (cacheEntryState == ShaderEntryState::Ready)
+    releaseShaderCacheEntry(shaderCache, hEntry);
+
+  if (callTrace) {
+    uint32_t flags = (userCache ? CallTraceHasUserCache : 0) | (appCache ? CallTraceHasShaderCache : 0);
+    callTrace->record(CallTraceType::GraphicsPipeline, callHash, flags, callStartTime, result);
+  }
+
+  return result;
+}
+
+// =====================================================================================================================
+// Build a batch of graphics pipelines from the specified infos.
+//
+// Pipelines in the batch with the same pipeline hash produce the same ELF, so only the first of each such group is
+// built, and the others get a copy of its result. The distinct pipelines are built in parallel on a thread pool.
+//
+// @param pipelineCount : Count of pipelines to build
+// @param pipelineInfos : Infos to build the pipelines
+// @param [out] pipelineOuts : Outputs of building the pipelines, one for each pipeline info
+// @param [out] results : Result of building each pipeline
+Result Compiler::BuildGraphicsPipelines(unsigned pipelineCount, const GraphicsPipelineBuildInfo *const *pipelineInfos,
+                                        GraphicsPipelineBuildOut *pipelineOuts, Result *results) {
+  // Find the first pipeline in the batch with the same hash as each pipeline.
+  std::vector<unsigned> buildIndices(pipelineCount);
+  std::unordered_map<uint64_t, unsigned> firstIndexByHash;
+  unsigned buildCount = 0;
+  for (unsigned i = 0; i < pipelineCount; ++i) {
+    MetroHash::Hash pipelineHash = PipelineDumper::generateHashForGraphicsPipeline(pipelineInfos[i], false, false);
+    auto inserted = firstIndexByHash.insert({MetroHash::compact64(&pipelineHash), i});
+    buildIndices[i] = inserted.first->second;
+    if (inserted.second)
+      ++buildCount;
+  }
+
+  {
+    ThreadPool threadPool(hardware_concurrency(buildCount));
+    for (unsigned i = 0; i < pipelineCount; ++i) {
+      if (buildIndices[i] != i)
+        continue;
+      threadPool.async([=] { results[i] = BuildGraphicsPipeline(pipelineInfos[i], &pipelineOuts[i]); });
+    }
+    threadPool.wait();
+  }
+
+  Result batchResult = Result::Success;
+  for (unsigned i = 0; i < pipelineCount; ++i) {
+    unsigned buildIndex = buildIndices[i];
+    if (buildIndex != i) {
+      // Copy the ELF of the identical pipeline that was built, into memory from this pipeline's own allocator.
+      // Nothing is compiled for this pipeline, so its stats report it like a cache hit.
+      results[i] = results[buildIndex];
+      if (PipelineBuildStats *buildStats = pipelineOuts[i].pStats) {
+        memset(buildStats, 0, sizeof(PipelineBuildStats));
+        buildStats->cacheHit = true;
+      }
+      if (pipelineOuts[i].ppBinHandle)
+        *pipelineOuts[i].ppBinHandle = nullptr;
+      if (results[i] == Result::Success) {
+        const BinaryData &pipelineBin = pipelineOuts[buildIndex].pipelineBin;
+        const GraphicsPipelineBuildInfo *pipelineInfo = pipelineInfos[i];
+        if (pipelineInfo->pfnOutputAlloc) {
+          void *allocBuf =
+              pipelineInfo->pfnOutputAlloc(pipelineInfo->pInstance, pipelineInfo->pUserData, pipelineBin.codeSize);
+          if (allocBuf) {
+            memcpy(allocBuf, pipelineBin.pCode, pipelineBin.codeSize);
+            pipelineOuts[i].pipelineBin.codeSize = pipelineBin.codeSize;
+            pipelineOuts[i].pipelineBin.pCode = allocBuf;
+          } else
+            results[i] = Result::ErrorOutOfMemory;
+        } else {
+          // Allocator is not specified
+          results[i] = Result::ErrorInvalidPointer;
+        }
+      }
+    }
+    if (batchResult == Result::Success && results[i] != Result::Success)
+      batchResult = results[i];
+  }
+
+  return batchResult;
+}
+
+// =====================================================================================================================
+// Build graphics pipeline in two tiers: a pipeline linked from relocatable shader ELF is returned now, and a fully
+// optimized compile is scheduled on a background thread, which passes its ELF to the callback when done.
+//
+// @param pipelineInfo : Info to build this graphics pipeline; must stay valid until the callback is called
+// @param [out] pipelineOut : Output of building the linked pipeline
+// @param optimizedCallback : Callback that receives the optimized pipeline (may be null)
+// @param callbackData : Client data passed to the callback
+Result Compiler::BuildGraphicsPipelineTiered(const GraphicsPipelineBuildInfo *pipelineInfo,
+                                             GraphicsPipelineBuildOut *pipelineOut,
+                                             OptimizedPipelineCallback optimizedCallback, void *callbackData) {
+  // If the pipeline cannot be built from relocatable shader ELF, this is already a full compile, and the optimized
+  // compile below finds it in the pipeline cache.
+  GraphicsPipelineBuildInfo linkedPipelineInfo = *pipelineInfo;
+  linkedPipelineInfo.options.enableRelocatableShaderElf = true;
+  Result result = BuildGraphicsPipeline(&linkedPipelineInfo, pipelineOut);
+  if (result != Result::Success || !optimizedCallback)
+    return result;
+
+  scheduleOptimizedGraphicsPipeline(pipelineInfo, optimizedCallback, callbackData);
+  return result;
+}
+
+// =====================================================================================================================
+// Schedule a fully optimized compile of a graphics pipeline on a background thread, which passes its ELF to the
+// callback when done.
+//
+// @param pipelineInfo : Info to build this graphics pipeline; must stay valid until the callback is called
+// @param optimizedCallback : Callback that receives the optimized pipeline
+// @param callbackData : Client data passed to the callback
+void Compiler::scheduleOptimizedGraphicsPipeline(const GraphicsPipelineBuildInfo *pipelineInfo,
+                                                 OptimizedPipelineCallback optimizedCallback, void *callbackData) {
+  {
+    std::lock_guard<sys::Mutex> lock(m_backgroundPoolMutex);
+    if (!m_backgroundPool)
+      m_backgroundPool.reset(new ThreadPool(hardware_concurrency(1)));
+  }
+
+  GraphicsPipelineBuildInfo optimizedPipelineInfo = *pipelineInfo;
+  optimizedPipelineInfo.options.enableRelocatableShaderElf = false;
+  m_backgroundPool->async([=] {
+    GraphicsPipelineBuildOut optimizedOut = {};
+    Result optimizedResult = BuildGraphicsPipeline(&optimizedPipelineInfo, &optimizedOut);
+    optimizedCallback(callbackData, optimizedResult,
+                      optimizedResult == Result::Success ? &optimizedOut.pipelineBin : nullptr);
+  });
+}
+
+// =====================================================================================================================
+// Build one part of a graphics pipeline for a graphics pipeline library, as relocatable shader ELF.
+//
+// @param pipelineInfo : Info of the pipeline the part belongs to
+// @param part : Part to build
+// @param [out] partOut : Output of building the part
+Result Compiler::BuildGraphicsPipelinePart(const GraphicsPipelineBuildInfo *pipelineInfo, GraphicsPipelinePart part,
+                                           GraphicsPipelineBuildOut *partOut) {
+  // Build from a copy of the pipeline info that has only the shader stages of the part, so the stage loop and cache
+  // keys are those of the same stages in a pipeline built from relocatable shader ELF.
+  GraphicsPipelineBuildInfo partInfo = *pipelineInfo;
+  if (part == GraphicsPipelinePart::PreRasterization)
+    partInfo.fs = {};
+  else if (part == GraphicsPipelinePart::Fragment)
+    partInfo.vs = partInfo.tcs = partInfo.tes = partInfo.gs = {};
+  else
+    return Result::ErrorInvalidValue;
+
+  const PipelineShaderInfo *shaderInfo[ShaderStageGfxCount] = {
+      &partInfo.vs, &partInfo.tcs, &partInfo.tes, &partInfo.gs, &partInfo.fs,
+  };
+  if (part == GraphicsPipelinePart::PreRasterization && !partInfo.vs.pModuleData)
+    return Result::ErrorInvalidValue;
+
+  Result result = Result::Success;
+  for (unsigned stage = 0; stage < ShaderStageGfxCount && result == Result::Success; ++stage) {
+    result = validatePipelineShaderInfo(shaderInfo[stage]);
+    const ShaderModuleData *moduleData = reinterpret_cast<const ShaderModuleData *>(shaderInfo[stage]->pModuleData);
+    if (result != Result::Success || !moduleData)
+      continue;
+    // Only a vertex shader and a fragment shader can be linked from relocatable shader ELF, and the same limits on
+    // descriptors apply as for a pipeline built that way.
+    if ((stage != ShaderStageVertex && stage != ShaderStageFragment) || moduleData->binType != BinaryType::Spirv ||
+        hasUnrelocatableDescriptorNode(shaderInfo[stage]->pUserDataNodes, shaderInfo[stage]->userDataNodeCount))
+      result = Result::Unsupported;
   }
+  if (result != Result::Success)
+    return result;
+
+  PipelineBuildStats *buildStats = partOut->pStats;
+  if (buildStats)
+    memset(buildStats, 0, sizeof(PipelineBuildStats));
+  if (partOut->ppBinHandle)
+    *partOut->ppBinHandle = nullptr;
+
+  MetroHash::Hash cacheHash =
+      PipelineDumper::generateHashForGraphicsPipeline(&partInfo, true, true, ShaderStageInvalid, &m_optionHash);
+  MetroHash::Hash pipelineHash = PipelineDumper::generateHashForGraphicsPipeline(&partInfo, false, false);
+  GraphicsContext graphicsContext(m_gfxIp, &partInfo, &pipelineHash, &cacheHash);
+  graphicsContext.setBuildStats(buildStats);
+  graphicsContext.setCompilerOptions(&m_compilerOptions);
+
+  ElfPackage partElf;
+  Context *context = acquireContext();
+  context->attachPipelineContext(&graphicsContext);
+  result = buildPipelineWithRelocatableElf(context, shaderInfo, cl::ForceLoopUnrollCount, &partElf,
+                                           /*linkStages=*/false);
+  releaseContext(context);
 
+  if (result == Result::Success) {
+    if (partInfo.pfnOutputAlloc) {
+      void *allocBuf = partInfo.pfnOutputAlloc(partInfo.pInstance, partInfo.pUserData, partElf.size());
+      if (allocBuf) {
+        memcpy(allocBuf, partElf.data(), partElf.size());
+        partOut->pipelineBin.codeSize = partElf.size();
+        partOut->pipelineBin.pCode = allocBuf;
+      } else
+        result = Result::ErrorOutOfMemory;
+    } else {
+      // Allocator is not specified
+      result = Result::ErrorInvalidPointer;
+    }
+  }
   return result;
 }
 
+// =====================================================================================================================
+// Link parts of a graphics pipeline built by BuildGraphicsPipelinePart into a pipeline, and schedule an optimized
+// compile of the pipeline if this combination of parts is hot.
+//
+// @param pipelineInfo : Info to build the pipeline
+// @param partBins : Part ELFs, indexed by GraphicsPipelinePart
+// @param [out] pipelineOut : Output of linking the pipeline
+// @param optimizedCallback : Callback that receives the optimized pipeline (may be null)
+// @param callbackData : Client data passed to the callback
+Result Compiler::LinkGraphicsPipelineParts(const GraphicsPipelineBuildInfo *pipelineInfo, const BinaryData *partBins,
+                                           GraphicsPipelineBuildOut *pipelineOut,
+                                           OptimizedPipelineCallback optimizedCallback, void *callbackData) {
+  for (unsigned part = 0; part != unsigned(GraphicsPipelinePart::Count); ++part) {
+    if (!partBins[part].pCode || partBins[part].codeSize == 0)
+      return Result::ErrorInvalidPointer;
+  }
+  if (pipelineInfo->tcs.pModuleData || pipelineInfo->tes.pModuleData || pipelineInfo->gs.pModuleData)
+    return Result::Unsupported;
+  if (!pipelineInfo->pfnOutputAlloc)
+    return Result::ErrorInvalidPointer;
+
+  PipelineBuildStats *buildStats = pipelineOut->pStats;
+  if (buildStats)
+    memset(buildStats, 0, sizeof(PipelineBuildStats));
+  if (pipelineOut->ppBinHandle)
+    *pipelineOut->ppBinHandle = nullptr;
+
+  MetroHash::Hash cacheHash =
+      PipelineDumper::generateHashForGraphicsPipeline(pipelineInfo, true, true, ShaderStageInvalid, &m_optionHash);
+  MetroHash::Hash pipelineHash = PipelineDumper::generateHashForGraphicsPipeline(pipelineInfo, false, false);
+  GraphicsContext graphicsContext(m_gfxIp, pipelineInfo, &pipelineHash, &cacheHash);
+  graphicsContext.setBuildStats(buildStats);
+  graphicsContext.setCompilerOptions(&m_compilerOptions);
+
+  StringRef elfBlobs[ShaderStageNativeStageCount];
+  elfBlobs[ShaderStageVertex] =
+      StringRef(static_cast<const char *>(partBins[unsigned(GraphicsPipelinePart::PreRasterization)].pCode),
+                partBins[unsigned(GraphicsPipelinePart::PreRasterization)].codeSize);
+  elfBlobs[ShaderStageFragment] =
+      StringRef(static_cast<const char *>(partBins[unsigned(GraphicsPipelinePart::Fragment)].pCode),
+                partBins[unsigned(GraphicsPipelinePart::Fragment)].codeSize);
+
+  ElfPackage pipelineElf;
+  Context *context = acquireContext();
+  context->attachPipelineContext(&graphicsContext);
+  context->getPipelineContext()->doUserDataNodeMerge(m_userDataNodeMergeCache.get());
+  context->getPipelineContext()->setShaderStageMask(shaderStageToMask(ShaderStageVertex) |
+                                                    shaderStageToMask(ShaderStageFragment));
+  {
+    BuildStatsTimeScope linkTimeScope(buildStats ? &buildStats->linkTime : nullptr,
+                                      buildStats ? &buildStats->maxPhaseMemoryGrowth : nullptr);
+    linkRelocatableShaderElf(elfBlobs, &pipelineElf, context);
+    stripPipelineElf(context, &pipelineElf);
+  }
+  releaseContext(context);
+
+  void *allocBuf = pipelineInfo->pfnOutputAlloc(pipelineInfo->pInstance, pipelineInfo->pUserData, pipelineElf.size());
+  if (!allocBuf)
+    return Result::ErrorOutOfMemory;
+  memcpy(allocBuf, pipelineElf.data(), pipelineElf.size());
+  pipelineOut->pipelineBin.codeSize = pipelineElf.size();
+  pipelineOut->pipelineBin.pCode = allocBuf;
+
+  if (!optimizedCallback)
+    return Result::Success;
+
+  // Count the links of this combination of parts, and schedule the optimized compile once it is hot.
+  bool isHot = false;
+  {
+    std::lock_guard<sys::Mutex> lock(m_libraryLinkMutex);
+    unsigned &linkCount = m_libraryLinkCounts[MetroHash::compact64(&pipelineHash)];
+    isHot = ++linkCount == std::max(1U, unsigned(cl::PipelineLibraryHotLinks));
+  }
+  if (!isHot)
+    return Result::Success;
+  scheduleOptimizedGraphicsPipeline(pipelineInfo, optimizedCallback, callbackData);
+  return Result::Delayed;
+}
+
 // =====================================================================================================================
 // Build compute pipeline internally
 //
@@ -1569,6 +3182,16 @@ Result Compiler::BuildComputePipeline(const ComputePipelineBuildInfo *pipelineIn
                                       ComputePipelineBuildOut *pipelineOut, void *pipelineDumpFile) {
   BinaryData elfBin = {};
 
+  CallTrace *callTrace = CallTrace::get(m_gfxIp, m_compilerOptions.shaderCacheMode);
+  uint64_t callStartTime = 0;
+  uint64_t callHash = 0;
+  if (callTrace) {
+    PipelineBuildInfo buildInfo = {};
+    buildInfo.pComputeInfo = pipelineInfo;
+    callHash = callTrace->dumpPipeline(buildInfo);
+    callStartTime = callTrace->getTime();
+  }
+
   bool buildingRelocatableElf = pipelineInfo->options.enableRelocatableShaderElf || cl::UseRelocatableShaderElf;
   buildingRelocatableElf = buildingRelocatableElf && canUseRelocatableComputeShaderElf(&pipelineInfo->cs);
 
@@ -1576,7 +3199,7 @@ Result Compiler::BuildComputePipeline(const ComputePipelineBuildInfo *pipelineIn
 
   MetroHash::Hash cacheHash = {};
   MetroHash::Hash pipelineHash = {};
-  cacheHash = PipelineDumper::generateHashForComputePipeline(pipelineInfo, true, buildingRelocatableElf);
+  cacheHash = PipelineDumper::generateHashForComputePipeline(pipelineInfo, true, buildingRelocatableElf, &m_optionHash);
   pipelineHash = PipelineDumper::generateHashForComputePipeline(pipelineInfo, false, buildingRelocatableElf);
 
   if (result == Result::Success && EnableOuts()) {
@@ -1614,7 +3237,12 @@ Result Compiler::BuildComputePipeline(const ComputePipelineBuildInfo *pipelineIn
   EntryHandle cacheEntry;
   Result cacheResult = Result::ErrorUnknown;
 
+  PipelineBuildStats *buildStats = pipelineOut->pStats;
+  if (buildStats)
+    memset(buildStats, 0, sizeof(PipelineBuildStats));
+
   if (!buildingRelocatableElf) {
+    BuildStatsTimeScope cacheLookupTimeScope(buildStats ? &buildStats->cacheLookupTime : nullptr);
     if (m_cache)
       cacheResult = lookUpCaches(userCache, &hashId, &elfBin, &cacheEntry);
     else
@@ -1624,23 +3252,58 @@ Result Compiler::BuildComputePipeline(const ComputePipelineBuildInfo *pipelineIn
 
   ElfPackage candidateElf;
 
+  if (buildStats)
+    buildStats->cacheHit = cacheEntryState == ShaderEntryState::Ready || cacheResult == Result::Success;
+
   if ((cacheEntryState == ShaderEntryState::Compiling) || (m_cache && (cacheResult != Result::Success))) {
     unsigned forceLoopUnrollCount = cl::ForceLoopUnrollCount;
 
     ComputeContext computeContext(m_gfxIp, pipelineInfo, &pipelineHash, &cacheHash);
+    computeContext.setBuildStats(buildStats);
+    computeContext.setCompilerOptions(&m_compilerOptions);
 
     result = buildComputePipelineInternal(&computeContext, pipelineInfo, forceLoopUnrollCount, buildingRelocatableElf,
                                           &candidateElf);
 
-    if (result == Result::Success) {
-      elfBin.codeSize = candidateElf.size();
+    unsigned lessUnrollCount = 0;
+    if (result == Result::Success && !buildingRelocatableElf && !computeContext.isCompileBudgetExceeded() &&
+        needsLessUnrolling(m_gfxIp, candidateElf, forceLoopUnrollCount, &lessUnrollCount)) {
+      ComputeContext lessUnrolledContext(m_gfxIp, pipelineInfo, &pipelineHash, &cacheHash);
+      lessUnrolledContext.setBuildStats(buildStats);
+      lessUnrolledContext.setCompilerOptions(&m_compilerOptions);
+      ElfPackage lessUnrolledElf;
+      if (buildComputePipelineInternal(&lessUnrolledContext, pipelineInfo, lessUnrollCount, false, &lessUnrolledElf) ==
+              Result::Success &&
+          isLessUnrollingBetter(m_gfxIp, candidateElf, lessUnrolledElf)) {
+        candidateElf.swap(lessUnrolledElf);
+        if (buildStats)
+          buildStats->lessUnrolled = true;
+      }
+    }
+
+    if (result == Result::Success) {
+      elfBin.codeSize = candidateElf.size();
       elfBin.pCode = candidateElf.data();
     }
     if (!buildingRelocatableElf && !m_cache)
       updateShaderCache((result == Result::Success), &elfBin, shaderCache, hEntry);
   }
 
-  if (result == Result::Success) {
+  if (pipelineOut->ppBinHandle)
+    *pipelineOut->ppBinHandle = nullptr;
+
+  const bool cacheHit = m_cache ? cacheResult == Result::Success : cacheEntryState == ShaderEntryState::Ready;
+  if (result == Result::Success && cacheHit && pipelineOut->ppBinHandle) {
+    // Return the ELF in cache memory, and hand the cache entry over to the client, which releases it with
+    // ReleasePipelineBinary.
+    PipelineBinaryHandle *binHandle = new PipelineBinaryHandle;
+    binHandle->cacheEntry = std::move(cacheEntry);
+    binHandle->shaderCache = shaderCache;
+    binHandle->hEntry = hEntry;
+    hEntry = nullptr;
+    pipelineOut->pipelineBin = elfBin;
+    *pipelineOut->ppBinHandle = binHandle;
+  } else if (result == Result::Success) {
     void *allocBuf = nullptr;
     if (pipelineInfo->pfnOutputAlloc) {
       allocBuf = pipelineInfo->pfnOutputAlloc(pipelineInfo->pInstance, pipelineInfo->pUserData, elfBin.codeSize);
@@ -1661,17 +3324,236 @@ Result Compiler::BuildComputePipeline(const ComputePipelineBuildInfo *pipelineIn
   if (m_cache) {
     bool withValue = (result == Result::Success) && (cacheResult != Result::Success);
     ReleaseCacheEntry(withValue, &elfBin, &cacheEntry);
+  } else if (cacheEntryState == ShaderEntryState::Ready)
+    releaseShaderCacheEntry(shaderCache, hEntry);
+
+  if (callTrace) {
+    uint32_t flags = (userCache ? CallTraceHasUserCache : 0) | (appCache ? CallTraceHasShaderCache : 0);
+    callTrace->record(CallTraceType::ComputePipeline, callHash, flags, callStartTime, result);
   }
 
   return result;
 }
 
+// =====================================================================================================================
+// Queue a graphics pipeline build on the job threads of the compiler.
+//
+// @param pipelineInfo : Info to build this graphics pipeline
+// @param [out] pipelineOut : Output of building this graphics pipeline
+// @param priority : Priority of the build against other queued builds
+// @param doneCallback : Callback that is called when the job has finished
+// @param callbackData : Client data passed to doneCallback
+// @param [out] job : Handle of the queued job
+Result Compiler::BuildGraphicsPipelineAsync(const GraphicsPipelineBuildInfo *pipelineInfo,
+                                            GraphicsPipelineBuildOut *pipelineOut, PipelineJobPriority priority,
+                                            PipelineJobCallback doneCallback, void *callbackData, void **job) {
+  if (!pipelineInfo || !pipelineOut || !job)
+    return Result::ErrorInvalidPointer;
+
+  auto build = [this, pipelineInfo, pipelineOut] { return BuildGraphicsPipeline(pipelineInfo, pipelineOut); };
+  const PipelineShaderInfo *shaderInfo[] = {&pipelineInfo->vs, &pipelineInfo->tcs, &pipelineInfo->tes,
+                                            &pipelineInfo->gs, &pipelineInfo->fs};
+  uint64_t memEstimate = estimateBuildMemory(shaderInfo);
+  MetroHash::Hash cacheHash =
+      PipelineDumper::generateHashForGraphicsPipeline(pipelineInfo, true, false, ShaderStageInvalid, &m_optionHash);
+  auto isWaiting = [this, pipelineInfo, cacheHash] {
+    IShaderCache *appShaderCache = nullptr;
+#if LLPC_CLIENT_INTERFACE_MAJOR_VERSION < 38 || LLPC_ENABLE_SHADER_CACHE
+    appShaderCache = reinterpret_cast<IShaderCache *>(pipelineInfo->pShaderCache);
+#endif
+    return isCacheEntryCompiling(pipelineInfo->cache, appShaderCache, cacheHash);
+  };
+  return queuePipelineJob(build, isWaiting, MetroHash::compact64(&cacheHash), priority, memEstimate, doneCallback,
+                          callbackData, job);
+}
+
+// =====================================================================================================================
+// Queue a compute pipeline build on the job threads of the compiler.
+//
+// @param pipelineInfo : Info to build this compute pipeline
+// @param [out] pipelineOut : Output of building this compute pipeline
+// @param priority : Priority of the build against other queued builds
+// @param doneCallback : Callback that is called when the job has finished
+// @param callbackData : Client data passed to doneCallback
+// @param [out] job : Handle of the queued job
+Result Compiler::BuildComputePipelineAsync(const ComputePipelineBuildInfo *pipelineInfo,
+                                           ComputePipelineBuildOut *pipelineOut, PipelineJobPriority priority,
+                                           PipelineJobCallback doneCallback, void *callbackData, void **job) {
+  if (!pipelineInfo || !pipelineOut || !job)
+    return Result::ErrorInvalidPointer;
+
+  auto build = [this, pipelineInfo, pipelineOut] { return BuildComputePipeline(pipelineInfo, pipelineOut); };
+  const PipelineShaderInfo *shaderInfo[] = {&pipelineInfo->cs};
+  uint64_t memEstimate = estimateBuildMemory(shaderInfo);
+  MetroHash::Hash cacheHash = PipelineDumper::generateHashForComputePipeline(pipelineInfo, true, false, &m_optionHash);
+  auto isWaiting = [this, pipelineInfo, cacheHash] {
+    IShaderCache *appShaderCache = nullptr;
+#if LLPC_CLIENT_INTERFACE_MAJOR_VERSION < 38 || LLPC_ENABLE_SHADER_CACHE
+    appShaderCache = reinterpret_cast<IShaderCache *>(pipelineInfo->pShaderCache);
+#endif
+    return isCacheEntryCompiling(pipelineInfo->cache, appShaderCache, cacheHash);
+  };
+  return queuePipelineJob(build, isWaiting, MetroHash::compact64(&cacheHash), priority, memEstimate, doneCallback,
+                          callbackData, job);
+}
+
+// =====================================================================================================================
+// Estimate the peak memory of building a pipeline, for the memory budget of asynchronous builds. The estimate grows
+// with the amount of SPIR-V, which bounds the size of the IR of each stage, plus a fixed cost per stage for its
+// module and the pipeline-wide state.
+//
+// @param shaderInfo : Shader info of the stages of the pipeline
+uint64_t Compiler::estimateBuildMemory(ArrayRef<const PipelineShaderInfo *> shaderInfo) {
+  // Peak memory per byte of SPIR-V, and per shader stage
+  static const uint64_t MemPerSpirvByte = 256;
+  static const uint64_t MemPerStage = 4 * 1024 * 1024;
+
+  uint64_t memEstimate = 0;
+  for (const PipelineShaderInfo *stageShaderInfo : shaderInfo) {
+    auto moduleData = reinterpret_cast<const ShaderModuleData *>(stageShaderInfo->pModuleData);
+    if (!moduleData)
+      continue;
+    memEstimate += MemPerStage + moduleData->binCode.codeSize * MemPerSpirvByte;
+  }
+  return memEstimate;
+}
+
+// =====================================================================================================================
+// Queue an asynchronous pipeline build, creating the job threads on first use.
+//
+// @param build : Function that runs the build
+// @param isWaiting : Function that probes whether the build would wait for a compile running in another thread
+// @param key : Compacted cache hash of the pipeline, used to promote queued duplicates of an urgent build
+// @param priority : Priority of the build against other queued builds
+// @param memEstimate : Estimated peak memory of the build in bytes
+// @param doneCallback : Callback that is called when the job has finished
+// @param callbackData : Client data passed to doneCallback
+// @param [out] job : Handle of the queued job
+Result Compiler::queuePipelineJob(std::function<Result()> build, std::function<bool()> isWaiting, uint64_t key,
+                                  PipelineJobPriority priority, uint64_t memEstimate, PipelineJobCallback doneCallback,
+                                  void *callbackData, void **job) {
+  if (priority >= PipelineJobPriority::Count)
+    return Result::ErrorInvalidValue;
+
+  {
+    std::lock_guard<sys::Mutex> lock(m_backgroundPoolMutex);
+    if (!m_jobQueue)
+      m_jobQueue.reset(new PipelineJobQueue(hardware_concurrency().compute_thread_count(),
+                                            uint64_t(cl::AsyncMemoryBudget.getValue()) * 1024 * 1024));
+  }
+
+  PipelineJob *pipelineJob =
+      new PipelineJob(std::move(build), std::move(isWaiting), key, priority, memEstimate, doneCallback, callbackData);
+  m_jobQueue->enqueue(pipelineJob);
+  *job = pipelineJob;
+  return Result::Success;
+}
+
+// =====================================================================================================================
+// Cancel a queued asynchronous pipeline build.
+//
+// @param job : Handle of the job
+Result Compiler::CancelPipelineJob(void *job) {
+  if (!job)
+    return Result::ErrorInvalidPointer;
+  return static_cast<PipelineJob *>(job)->cancel() ? Result::Success : Result::NotReady;
+}
+
+// =====================================================================================================================
+// Wait for an asynchronous pipeline build to finish, and return its result.
+//
+// @param job : Handle of the job
+Result Compiler::WaitPipelineJob(void *job) {
+  if (!job)
+    return Result::ErrorInvalidPointer;
+  return static_cast<PipelineJob *>(job)->wait();
+}
+
+// =====================================================================================================================
+// Release the handle of an asynchronous pipeline build.
+//
+// @param job : Handle of the job
+void Compiler::ReleasePipelineJob(void *job) {
+  if (job)
+    static_cast<PipelineJob *>(job)->release();
+}
+
+// =====================================================================================================================
+// Warm the pipeline caches for pipelines that are about to be built, by looking up their cache entries in parallel.
+//
+// The entries are looked up with the cache hash a full compile of each pipeline uses. A pipeline built from
+// relocatable shader ELF does not look up the pipeline cache, but the optimized compile of a tiered build, or a build
+// that exceeds the relocatable compilation limit, does.
+//
+// @param graphicsPipelineCount : Count of graphics pipelines to prefetch
+// @param graphicsPipelineInfos : Infos of the graphics pipelines
+// @param computePipelineCount : Count of compute pipelines to prefetch
+// @param computePipelineInfos : Infos of the compute pipelines
+Result Compiler::PrefetchPipelines(unsigned graphicsPipelineCount,
+                                   const GraphicsPipelineBuildInfo *const *graphicsPipelineInfos,
+                                   unsigned computePipelineCount,
+                                   const ComputePipelineBuildInfo *const *computePipelineInfos) {
+  lgc::TraceScope traceScope("Compiler::PrefetchPipelines", "cache");
+
+  struct PrefetchEntry {
+    ICache *userCache;         // Client's pipeline cache
+    IShaderCache *appCache;    // App's shader cache
+    MetroHash::Hash cacheHash; // Cache hash of the pipeline
+  };
+
+  // Identical pipelines share a cache entry, so each entry is only looked up once.
+  std::vector<PrefetchEntry> entries;
+  std::unordered_set<uint64_t> seenHashes;
+  auto addEntry = [&](ICache *userCache, void *appCache, const MetroHash::Hash &cacheHash) {
+    if (!seenHashes.insert(MetroHash::compact64(&cacheHash)).second)
+      return;
+    IShaderCache *appShaderCache = nullptr;
+#if LLPC_CLIENT_INTERFACE_MAJOR_VERSION < 38 || LLPC_ENABLE_SHADER_CACHE
+    appShaderCache = reinterpret_cast<IShaderCache *>(appCache);
+#endif
+    entries.push_back({userCache, appShaderCache, cacheHash});
+  };
+
+  for (unsigned i = 0; i < graphicsPipelineCount; ++i) {
+    const GraphicsPipelineBuildInfo *pipelineInfo = graphicsPipelineInfos[i];
+    void *appCache = nullptr;
+#if LLPC_CLIENT_INTERFACE_MAJOR_VERSION < 38 || LLPC_ENABLE_SHADER_CACHE
+    appCache = pipelineInfo->pShaderCache;
+#endif
+    addEntry(pipelineInfo->cache, appCache,
+             PipelineDumper::generateHashForGraphicsPipeline(pipelineInfo, true, false, ShaderStageInvalid,
+                                                             &m_optionHash));
+  }
+
+  for (unsigned i = 0; i < computePipelineCount; ++i) {
+    const ComputePipelineBuildInfo *pipelineInfo = computePipelineInfos[i];
+    void *appCache = nullptr;
+#if LLPC_CLIENT_INTERFACE_MAJOR_VERSION < 38 || LLPC_ENABLE_SHADER_CACHE
+    appCache = pipelineInfo->pShaderCache;
+#endif
+    addEntry(pipelineInfo->cache, appCache,
+             PipelineDumper::generateHashForComputePipeline(pipelineInfo, true, false, &m_optionHash));
+  }
+
+  if (entries.empty())
+    return Result::Success;
+
+  ThreadPool threadPool(hardware_concurrency(entries.size()));
+  for (const PrefetchEntry &entry : entries)
+    threadPool.async([this, &entry] { prefetchCacheEntry(entry.userCache, entry.appCache, entry.cacheHash); });
+  threadPool.wait();
+
+  return Result::Success;
+}
+
 // =====================================================================================================================
 // Builds hash code from compilation-options
 //
 // @param optionCount : Count of compilation-option strings
 // @param options : An array of compilation-option strings
-MetroHash::Hash Compiler::generateHashForCompileOptions(unsigned optionCount, const char *const *options) {
+// @param excludeCompilerOptions : Leave out the options that each compiler instance captures for itself
+MetroHash::Hash Compiler::generateHashForCompileOptions(unsigned optionCount, const char *const *options,
+                                                        bool excludeCompilerOptions) {
   // Options which needn't affect compilation results
   static StringRef IgnoredOptions[] = {cl::PipelineDumpDir.ArgStr,
                                        cl::EnablePipelineDump.ArgStr,
@@ -1683,6 +3565,7 @@ MetroHash::Hash Compiler::generateHashForCompileOptions(unsigned optionCount, co
                                        cl::LogFileOuts.ArgStr,
                                        cl::ExecutableName.ArgStr,
                                        cl::BuildShaderCache.ArgStr,
+                                       "spirv-debug-info",
                                        "o"};
 
   std::set<StringRef> effectingOptions;
@@ -1702,6 +3585,9 @@ MetroHash::Hash Compiler::generateHashForCompileOptions(unsigned optionCount, co
       }
     }
 
+    if (excludeCompilerOptions && isCompilerOption(option))
+      ignore = true;
+
     if (!ignore)
       effectingOptions.insert(option);
   }
@@ -1718,6 +3604,44 @@ MetroHash::Hash Compiler::generateHashForCompileOptions(unsigned optionCount, co
   return hash;
 }
 
+// =====================================================================================================================
+// Checks whether a compilation-option string (without the leading '-') sets an option that each compiler instance
+// captures for itself.
+//
+// @param option : Compilation-option string
+bool Compiler::isCompilerOption(StringRef option) {
+  StringRef name = option.ltrim('-').split('=').first;
+  return std::find(std::begin(CompilerOptionNames), std::end(CompilerOptionNames), name) !=
+         std::end(CompilerOptionNames);
+}
+
+// =====================================================================================================================
+// Re-apply the options that each compiler instance captures for itself from the specified compilation-options,
+// leaving all other LLVM options as they are. The options not given are reset to their defaults. This function
+// assumes that SCompilerMutex has been taken by the calling function. Returns false if an option value is invalid.
+//
+// @param optionCount : Count of compilation-option strings
+// @param options : An array of compilation-option strings
+bool Compiler::applyCompilerOptions(unsigned optionCount, const char *const *options) {
+  StringMap<cl::Option *> &registeredOptions = cl::getRegisteredOptions();
+  for (StringRef name : CompilerOptionNames) {
+    if (cl::Option *option = registeredOptions.lookup(name))
+      option->reset();
+  }
+
+  for (unsigned i = 1; i < optionCount; ++i) {
+    if (options[i][0] != '-' || !isCompilerOption(options[i] + 1))
+      continue;
+
+    StringRef name, value;
+    std::tie(name, value) = StringRef(options[i]).ltrim('-').split('=');
+    cl::Option *option = registeredOptions.lookup(name);
+    if (!option || option->addOccurrence(i, name, value))
+      return false;
+  }
+  return true;
+}
+
 // =====================================================================================================================
 // Checks whether fields in pipeline shader info are valid.
 //
@@ -1731,7 +3655,17 @@ Result Compiler::validatePipelineShaderInfo(const PipelineShaderInfo *shaderInfo
     if (moduleData->binType == BinaryType::Spirv) {
       auto spirvBin = &moduleData->binCode;
       if (shaderInfo->pEntryTarget) {
-        unsigned stageMask = ShaderModuleHelper::getStageMaskFromSpirvBinary(spirvBin, shaderInfo->pEntryTarget);
+        // Use the entry-point table recorded by BuildShaderModule if there is one, rather than scanning the SPIR-V.
+        const ShaderModuleDataEx *moduleDataEx = reinterpret_cast<const ShaderModuleDataEx *>(moduleData);
+        unsigned stageMask = 0;
+        if (moduleDataEx->extra.entryCount > 0) {
+          for (unsigned i = 0; i < moduleDataEx->extra.entryCount; ++i) {
+            const ShaderModuleEntryData &entryData = moduleDataEx->extra.entryDatas[i];
+            if (strcmp(shaderInfo->pEntryTarget, entryData.pEntryName) == 0)
+              stageMask |= shaderStageToMask(entryData.stage);
+          }
+        } else
+          stageMask = ShaderModuleHelper::getStageMaskFromSpirvBinary(spirvBin, shaderInfo->pEntryTarget);
 
         if ((stageMask & shaderStageToMask(shaderStage)) == 0) {
           LLPC_ERRS("Fail to find entry-point " << shaderInfo->pEntryTarget << " for "
@@ -1766,6 +3700,7 @@ Result Compiler::CreateShaderCache(const ShaderCacheCreateInfo *pCreateInfo, ISh
   auxCreateInfo.shaderCacheMode = ShaderCacheMode::ShaderCacheEnableRuntime;
   auxCreateInfo.gfxIp = m_gfxIp;
   auxCreateInfo.hash = m_optionHash;
+  auxCreateInfo.keyHashAlgorithm = cl::CacheKeyHash;
 
   ShaderCache *shaderCache = new ShaderCache();
 
@@ -1783,7 +3718,8 @@ Result Compiler::CreateShaderCache(const ShaderCacheCreateInfo *pCreateInfo, ISh
   *ppShaderCache = shaderCache;
 
   if ((result == Result::Success) &&
-      ((cl::ShaderCacheMode == ShaderCacheEnableRuntime) || (cl::ShaderCacheMode == ShaderCacheEnableOnDisk)) &&
+      ((m_compilerOptions.shaderCacheMode == ShaderCacheEnableRuntime) ||
+       (m_compilerOptions.shaderCacheMode == ShaderCacheEnableOnDisk)) &&
       (pCreateInfo->initialDataSize > 0)) {
     m_shaderCache->Merge(1, const_cast<const IShaderCache **>(ppShaderCache));
   }
@@ -1792,33 +3728,40 @@ Result Compiler::CreateShaderCache(const ShaderCacheCreateInfo *pCreateInfo, ISh
 }
 #endif
 
+// =====================================================================================================================
+// Gets the free list of the context pool for the specified GfxIp version, creating it if necessary. This function
+// assumes that m_contextPoolMutex has been taken by the calling function.
+//
+// @param gfxIp : Graphics IP version info
+ContextFreeList *Compiler::getContextFreeList(GfxIpVersion gfxIp) {
+  const unsigned key = (gfxIp.major << 16) | (gfxIp.minor << 8) | gfxIp.stepping;
+
+  ContextFreeList *&freeList = (*m_contextFreeLists)[key];
+  if (!freeList)
+    freeList = new ContextFreeList;
+  return freeList;
+}
+
 // =====================================================================================================================
 // Acquires a free context from context pool.
 Context *Compiler::acquireContext() const {
+  lgc::TraceScope traceScope("Compiler::acquireContext", "context");
   Context *freeContext = nullptr;
 
-  std::lock_guard<sys::Mutex> lock(m_contextPoolMutex);
-
-  // Try to find a free context from pool first
-  for (auto &context : *m_contextPool) {
-    GfxIpVersion gfxIpVersion = context->getGfxIpVersion();
-
-    if (!context->isInUse() && gfxIpVersion.major == m_gfxIp.major && gfxIpVersion.minor == m_gfxIp.minor &&
-        gfxIpVersion.stepping == m_gfxIp.stepping) {
-      // Free up context if it is being used too many times to avoid consuming too much memory.
-      int contextReuseLimit = cl::ContextReuseLimit.getValue();
-      if (contextReuseLimit > 0 && context->getUseCount() > contextReuseLimit) {
-        delete context;
-        context = new Context(m_gfxIp);
-      }
-      freeContext = context;
-      break;
+  // Try to pop a free context from the free list of our GfxIp version first
+  {
+    std::lock_guard<sys::Mutex> lock(m_contextFreeList->lock);
+    if (!m_contextFreeList->contexts.empty()) {
+      freeContext = m_contextFreeList->contexts.back();
+      m_contextFreeList->contexts.pop_back();
     }
   }
 
+  // Contexts past their reuse limits are replaced by releaseContext, so a free one can be used as it is.
   if (!freeContext) {
     // Create a new one if we fail to find an available one
     freeContext = new Context(m_gfxIp);
+    std::lock_guard<sys::Mutex> lock(m_contextPoolMutex);
     m_contextPool->push_back(freeContext);
   }
 
@@ -1850,14 +3793,177 @@ bool Compiler::runPasses(lgc::PassManager *passMgr, Module *module) const {
   return success;
 }
 
+// =====================================================================================================================
+// Translate and lower one shader stage in a context of its own, and write the lowered module out as bitcode. This is
+// used by buildPipelineInternal to do the per-stage front-end work of a pipeline on several threads at once.
+//
+// @param pipelineContext : Pipeline context of the pipeline being built
+// @param shaderInfo : Shader info of the shader stage
+// @param shaderIndex : Index of the shader stage in the pipeline's shader info array
+// @param forceLoopUnrollCount : Force loop unroll count (0 means disable)
+// @param unlinked : Do not provide some state to LGC, so offsets are generated as relocs
+// @param [out] bitcode : Bitcode of the lowered module
+Result Compiler::lowerShaderStage(PipelineContext *pipelineContext, const PipelineShaderInfo *shaderInfo,
+                                  unsigned shaderIndex, unsigned forceLoopUnrollCount, bool unlinked,
+                                  SmallVectorImpl<char> &bitcode) const {
+  Result result = Result::Success;
+  unsigned passIndex = 0;
+  ShaderStage entryStage = shaderInfo->entryStage;
+  // This runs on a thread of its own, so it collects its pass costs separately from the rest of the pipeline build.
+  PassCostScope passCostScope(m_passCostsMutex, m_passCosts);
+
+  Context *context = acquireContext();
+  context->attachPipelineContext(pipelineContext);
+  // Share the compile-time budget of the pipeline build, restoring the context's own pass gate before releasing it.
+  OptPassGate *oldGate = nullptr;
+  if (OptPassGate *budgetGate = pipelineContext->getCompileBudgetGate()) {
+    oldGate = &context->getOptPassGate();
+    context->setOptPassGate(*budgetGate);
+  }
+  context->setDiagnosticHandler(std::make_unique<LlpcDiagnosticHandler>());
+  context->setScalarBlockLayout(pipelineContext->getPipelineOptions()->scalarBlockLayout);
+  context->setRobustBufferAccess(pipelineContext->getPipelineOptions()->robustBufferAccess);
+
+  LgcContext *builderContext = context->getLgcContext();
+  std::unique_ptr<Pipeline> pipeline(builderContext->createPipeline());
+  pipelineContext->setPipelineState(&*pipeline, unlinked);
+  // The pipeline state of this context is thrown away, so the Builder calls are recorded, and the translator records
+  // the shader modes into the module, for the pipeline build to replay and read them.
+  context->setBuilder(builderContext->createBuilder(&*pipeline, true));
+  context->getBuilder()->setShaderStage(getLgcShaderStage(entryStage));
+
+  std::unique_ptr<Module> module(new Module(
+      (Twine("llpc") + getShaderStageName(entryStage)).str() + std::to_string(getModuleIdByIndex(shaderIndex)),
+      *context));
+  context->setModuleTargetMachine(&*module);
+
+  raw_svector_ostream bitcodeStream(bitcode);
+  std::unique_ptr<lgc::PassManager> lowerPassMgr(lgc::PassManager::Create());
+  lowerPassMgr->setPassIndex(&passIndex);
+  lowerPassMgr->add(createSpirvLowerTranslator(entryStage, shaderInfo));
+  SpirvLower::addPasses(context, entryStage, *lowerPassMgr, nullptr, forceLoopUnrollCount);
+  lowerPassMgr->add(createBitcodeWriterPass(bitcodeStream));
+
+  if (!runPasses(&*lowerPassMgr, &*module)) {
+    LLPC_ERRS("Failed to translate SPIR-V or run per-shader passes\n");
+    result = Result::ErrorInvalidShader;
+  }
+
+  // Free everything that belongs to the context before handing it back to the pool.
+  lowerPassMgr.reset();
+  module.reset();
+  pipeline.reset();
+  context->setDiagnosticHandlerCallBack(nullptr);
+  if (oldGate)
+    context->setOptPassGate(*oldGate);
+  releaseContext(context);
+
+  return result;
+}
+
 // =====================================================================================================================
 // Releases LLPC context.
 //
 // @param context : LLPC context
 void Compiler::releaseContext(Context *context) const {
-  std::lock_guard<sys::Mutex> lock(m_contextPoolMutex);
+  lgc::TraceScope traceScope("Compiler::releaseContext", "context");
+  // The context is still owned by this thread here, so it can be reset without holding any lock.
   context->reset();
   context->setInUse(false);
+
+  // Free up context if it is being used too many times, or has translated too much SPIR-V, to avoid consuming
+  // too much memory. Types, constants and metadata created by each compile stay in the LLVMContext until it is
+  // destroyed, and grow roughly with the amount of SPIR-V translated. The context is destroyed and replaced on a
+  // context worker, so that neither this build nor the next one pays for it.
+  int contextReuseLimit = cl::ContextReuseLimit.getValue();
+  uint64_t contextReuseSpirvLimit = uint64_t(cl::ContextReuseSpirvLimit.getValue()) * 1024;
+  if ((contextReuseLimit > 0 && context->getUseCount() > unsigned(contextReuseLimit)) ||
+      (contextReuseSpirvLimit > 0 && context->getTranslatedSpirvSize() > contextReuseSpirvLimit)) {
+    getContextWorkers()->async([this, context] {
+      {
+        std::lock_guard<sys::Mutex> lock(m_contextPoolMutex);
+        m_contextPool->erase(std::find(m_contextPool->begin(), m_contextPool->end(), context));
+      }
+      delete context;
+      addFreeContext(new Context(m_gfxIp));
+    });
+    return;
+  }
+
+  std::lock_guard<sys::Mutex> lock(m_contextFreeList->lock);
+  m_contextFreeList->contexts.push_back(context);
+}
+
+// =====================================================================================================================
+// Adds a newly created context to the context pool and to the free list, creating its LgcContext first so that the
+// build that acquires it does not.
+//
+// @param context : Context to add
+void Compiler::addFreeContext(Context *context) const {
+  context->getLgcContext();
+  {
+    std::lock_guard<sys::Mutex> lock(m_contextPoolMutex);
+    m_contextPool->push_back(context);
+  }
+  std::lock_guard<sys::Mutex> lock(m_contextFreeList->lock);
+  m_contextFreeList->contexts.push_back(context);
+}
+
+// =====================================================================================================================
+// Creates contexts on the context workers until the free list of this compiler's GfxIp version holds the given
+// number. Builds that find the free list empty in the meantime create their own context as before.
+//
+// @param count : Number of free contexts wanted
+void Compiler::prewarmContexts(unsigned count) const {
+  size_t freeCount = 0;
+  {
+    std::lock_guard<sys::Mutex> lock(m_contextFreeList->lock);
+    freeCount = m_contextFreeList->contexts.size();
+  }
+  for (size_t i = freeCount; i < count; ++i)
+    getContextWorkers()->async([this] { addFreeContext(new Context(m_gfxIp)); });
+}
+
+// =====================================================================================================================
+// Gets the thread pool that creates and recycles contexts off the build threads, creating it on first use.
+ThreadPool *Compiler::getContextWorkers() const {
+  std::lock_guard<sys::Mutex> lock(m_backgroundPoolMutex);
+  if (!m_contextWorkers) {
+    unsigned threadCount =
+        std::min(std::max(1u, cl::ContextPoolPrewarm.getValue()), hardware_concurrency().compute_thread_count());
+    m_contextWorkers.reset(new ThreadPool(hardware_concurrency(threadCount)));
+  }
+  return m_contextWorkers.get();
+}
+
+// =====================================================================================================================
+// Returns whether a cache entry is being filled in by a compile running in another thread, so that a build looking it
+// up now would wait for that compile. The entry is not waited for, and a miss is not allocated.
+//
+// @param appPipelineCache : Client's pipeline cache (used with the ICache)
+// @param appShaderCache : App's shader cache (used with the internal shader cache)
+// @param cacheHash : Cache hash of the pipeline
+bool Compiler::isCacheEntryCompiling(ICache *appPipelineCache, IShaderCache *appShaderCache,
+                                     const MetroHash::Hash &cacheHash) {
+  if (m_cache) {
+    HashId hashId = {};
+    memcpy(&hashId.bytes, &cacheHash.bytes, sizeof(cacheHash));
+    EntryHandle entry;
+    Result cacheResult = m_cache->GetEntry(hashId, false, &entry);
+    EntryHandle::ReleaseHandle(std::move(entry));
+    if (cacheResult == Result::NotReady)
+      return true;
+    if (cacheResult == Result::Success || !appPipelineCache)
+      return false;
+    cacheResult = appPipelineCache->GetEntry(hashId, false, &entry);
+    EntryHandle::ReleaseHandle(std::move(entry));
+    return cacheResult == Result::NotReady;
+  }
+
+  if (m_shaderCache->isShaderCompiling(cacheHash))
+    return true;
+  return appShaderCache && m_compilerOptions.shaderCacheMode != ShaderCacheForceInternalCacheOnDisk &&
+         static_cast<ShaderCache *>(appShaderCache)->isShaderCompiling(cacheHash);
 }
 
 // =====================================================================================================================
@@ -1865,8 +3971,9 @@ void Compiler::releaseContext(Context *context) const {
 // It will try App's pipelince cache first if that's available.
 // Then try on the internal shader cache next if it misses.
 //
-// Upon hit, Ready is returned and pElfBin is filled in. Upon miss, Compiling is returned and ppShaderCache and
-// phEntry are filled in.
+// Upon hit, Ready is returned and pElfBin, ppShaderCache and phEntry are filled in; the entry is pinned until it is
+// released by calling releaseShaderCacheEntry(). Upon miss, Compiling is returned and ppShaderCache and phEntry are
+// filled in.
 //
 // @param appPipelineCache : App's pipeline cache
 // @param cacheHash : Hash code of the shader
@@ -1879,9 +3986,12 @@ ShaderEntryState Compiler::lookUpShaderCaches(IShaderCache *appPipelineCache, Me
   ShaderCache *shaderCache[2];
   unsigned shaderCacheCount = 0;
 
-  shaderCache[shaderCacheCount++] = m_shaderCache.get();
+  // A disabled internal cache answers every lookup with a compile and no entry, so leave it out; that way the
+  // application's cache is still used when the internal one is off.
+  if (m_compilerOptions.shaderCacheMode != ShaderCacheDisable)
+    shaderCache[shaderCacheCount++] = m_shaderCache.get();
 
-  if (appPipelineCache && cl::ShaderCacheMode != ShaderCacheForceInternalCacheOnDisk) {
+  if (appPipelineCache && m_compilerOptions.shaderCacheMode != ShaderCacheForceInternalCacheOnDisk) {
     // Put the application's cache last so that we prefer adding entries there (only relevant with old
     // client version).
     shaderCache[shaderCacheCount++] = static_cast<ShaderCache *>(appPipelineCache);
@@ -1894,11 +4004,17 @@ ShaderEntryState Compiler::lookUpShaderCaches(IShaderCache *appPipelineCache, Me
     ShaderEntryState cacheEntryState = shaderCache[i]->findShader(*cacheHash, allocateOnMiss, &currentEntry);
     if (cacheEntryState == ShaderEntryState::Ready) {
       Result result = shaderCache[i]->retrieveShader(currentEntry, &elfBin->pCode, &elfBin->codeSize);
-      if (result == Result::Success)
+      if (result == Result::Success) {
+        *ppShaderCache = shaderCache[i];
+        *phEntry = currentEntry;
+        ++m_cacheLookupCounters.hits;
         return ShaderEntryState::Ready;
+      }
+      shaderCache[i]->releaseShader(currentEntry);
     } else if (cacheEntryState == ShaderEntryState::Compiling) {
       *ppShaderCache = shaderCache[i];
       *phEntry = currentEntry;
+      ++m_cacheLookupCounters.misses;
       return ShaderEntryState::Compiling;
     }
   }
@@ -1906,6 +4022,7 @@ ShaderEntryState Compiler::lookUpShaderCaches(IShaderCache *appPipelineCache, Me
   // Unable to allocate an entry in a cache, but we can compile anyway.
   *ppShaderCache = nullptr;
   *phEntry = nullptr;
+  ++m_cacheLookupCounters.misses;
 
   return ShaderEntryState::Compiling;
 }
@@ -1928,10 +4045,50 @@ void Compiler::updateShaderCache(bool insert, const BinaryData *elfBin, ShaderCa
   if (insert) {
     assert(elfBin->codeSize > 0);
     shaderCache->insertShader(hEntry, elfBin->pCode, elfBin->codeSize);
+    m_cacheLookupCounters.bytesStored += elfBin->codeSize;
   } else
     shaderCache->resetShader(hEntry);
 }
 
+// =====================================================================================================================
+// Release the entry of a shader cache hit returned by lookUpShaderCaches(), after which the shader data retrieved
+// from it must no longer be used.
+//
+// @param shaderCache : Shader cache of the entry
+// @param hEntry : Handle to release
+void Compiler::releaseShaderCacheEntry(ShaderCache *shaderCache, CacheEntryHandle hEntry) {
+  if (hEntry)
+    shaderCache->releaseShader(hEntry);
+}
+
+// =====================================================================================================================
+// Look up a cache entry ahead of a build, in the same caches that the build looks it up in, and release it again. A
+// hit leaves the shader data in memory for the build; a miss is not marked as compiling, so the build still compiles
+// the pipeline as usual.
+//
+// @param appPipelineCache : Client's pipeline cache (used with the ICache)
+// @param appShaderCache : App's shader cache (used with the internal shader cache)
+// @param cacheHash : Cache hash of the pipeline
+void Compiler::prefetchCacheEntry(ICache *appPipelineCache, IShaderCache *appShaderCache,
+                                  const MetroHash::Hash &cacheHash) {
+  if (m_cache) {
+    HashId hashId = {};
+    memcpy(&hashId.bytes, &cacheHash.bytes, sizeof(cacheHash));
+    // An entry that is not ready is being filled in by another thread already, so there is no need to wait for it.
+    EntryHandle entry;
+    Result cacheResult = m_cache->GetEntry(hashId, false, &entry);
+    if (appPipelineCache && cacheResult != Result::Success && cacheResult != Result::NotReady) {
+      EntryHandle::ReleaseHandle(std::move(entry));
+      appPipelineCache->GetEntry(hashId, false, &entry);
+    }
+    return;
+  }
+
+  m_shaderCache->prefetchShader(cacheHash);
+  if (appShaderCache && m_compilerOptions.shaderCacheMode != ShaderCacheForceInternalCacheOnDisk)
+    static_cast<ShaderCache *>(appShaderCache)->prefetchShader(cacheHash);
+}
+
 // =====================================================================================================================
 // Lookup in the shader caches with the given pipeline hash code.
 // It will try App's pipelince cache first if that's available.
@@ -1945,19 +4102,27 @@ void Compiler::updateShaderCache(bool insert, const BinaryData *elfBin, ShaderCa
 // @param cacheHash : Hash code of the shader
 // @param elfBin : [out] Pointer to shader data
 // @param entryHandle : [out] Handle to use
+// @param waitIfNotReady : Whether to wait for an entry that is not ready; if false, NotReady is returned with the
+//                         handle filled in, to be passed to waitForCacheEntry()
 Result Compiler::lookUpCaches(ICache *appPipelineCache, HashId *cacheHash, BinaryData *elfBin,
-                              EntryHandle *entryHandle) {
+                              EntryHandle *entryHandle, bool waitIfNotReady) {
+  lgc::TraceScope traceScope("Compiler::lookUpCaches", "cache");
   Result cacheResult = Result::Unsupported;
 
-  auto LookUpCache = [](ICache *cache, bool allocateOnMiss, HashId *cacheHash, BinaryData *elfBin,
-                        EntryHandle *entryHandle) -> Result {
+  auto LookUpCache = [this, waitIfNotReady](ICache *cache, bool allocateOnMiss, HashId *cacheHash,
+                                            BinaryData *elfBin, EntryHandle *entryHandle) -> Result {
     EntryHandle currentEntry;
     Result cacheResult = Result::Unsupported;
 
     cacheResult = cache->GetEntry(*cacheHash, allocateOnMiss, &currentEntry);
 
-    if (cacheResult == Result::NotReady)
-      cacheResult = currentEntry.WaitForEntry();
+    if (cacheResult == Result::NotReady) {
+      if (!waitIfNotReady) {
+        *entryHandle = std::move(currentEntry);
+        return cacheResult;
+      }
+      cacheResult = timeCacheWait([&] { return currentEntry.WaitForEntry(); });
+    }
 
     if (cacheResult == Result::Success) {
       cacheResult = currentEntry.GetValueZeroCopy(&elfBin->pCode, &elfBin->codeSize);
@@ -1972,9 +4137,32 @@ Result Compiler::lookUpCaches(ICache *appPipelineCache, HashId *cacheHash, Binar
   if (m_cache)
     cacheResult = LookUpCache(m_cache, appPipelineCache == nullptr, cacheHash, elfBin, entryHandle);
 
-  if (appPipelineCache && cacheResult != Result::Success)
+  if (appPipelineCache && cacheResult != Result::Success && cacheResult != Result::NotReady)
     cacheResult = LookUpCache(appPipelineCache, true, cacheHash, elfBin, entryHandle);
 
+  // An entry that is not ready is counted when it is waited for.
+  if (cacheResult == Result::Success)
+    ++m_cacheLookupCounters.hits;
+  else if (cacheResult != Result::NotReady)
+    ++m_cacheLookupCounters.misses;
+
+  return cacheResult;
+}
+
+// =====================================================================================================================
+// Wait for a cache entry that lookUpCaches returned as not ready, and get its value if the wait succeeded.
+//
+// @param [out] elfBin : Pointer to shader data
+// @param entryHandle : Handle of the entry returned by lookUpCaches
+Result Compiler::waitForCacheEntry(BinaryData *elfBin, EntryHandle *entryHandle) {
+  lgc::TraceScope traceScope("Compiler::waitForCacheEntry", "cache");
+  Result cacheResult = timeCacheWait([entryHandle] { return entryHandle->WaitForEntry(); });
+  if (cacheResult == Result::Success)
+    cacheResult = entryHandle->GetValueZeroCopy(&elfBin->pCode, &elfBin->codeSize);
+  if (cacheResult == Result::Success)
+    ++m_cacheLookupCounters.hits;
+  else
+    ++m_cacheLookupCounters.misses;
   return cacheResult;
 }
 
@@ -1993,15 +4181,125 @@ void Compiler::ReleaseCacheEntry(bool withValue, const BinaryData *elfBin, Entry
   if (withValue) {
     assert(elfBin->codeSize > 0);
     entryHandle->SetValue(withValue, elfBin->pCode, elfBin->codeSize);
+    m_cacheLookupCounters.bytesStored += elfBin->codeSize;
   }
 
   // Empty EntryHandle
   EntryHandle::ReleaseHandle(std::move(*entryHandle));
 }
 
+// =====================================================================================================================
+// Wait for a cache entry, counting the wait and its time in the cache lookup counters.
+//
+// @param wait : Function that waits for the entry and returns the result of the wait
+Result Compiler::timeCacheWait(function_ref<Result()> wait) {
+  auto waitStart = std::chrono::steady_clock::now();
+  Result result = wait();
+  ++m_cacheLookupCounters.waits;
+  m_cacheLookupCounters.waitNanoseconds +=
+      std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - waitStart).count();
+  return result;
+}
+
+// =====================================================================================================================
+// Record the result of a cache lookup of part of a pipeline, or of a relocatable shader ELF, for each shader stage
+// that it contains.
+//
+// @param stageMask : Mask of the shader stages the looked up code contains
+// @param hit : Whether the lookup found the code in a cache
+void Compiler::recordStageCacheResult(unsigned stageMask, bool hit) {
+  std::atomic<uint64_t> *counters = hit ? m_stageCacheHits : m_stageCacheMisses;
+  for (unsigned stage = 0; stage < ShaderStageCount; ++stage) {
+    if (stageMask & shaderStageToMask(static_cast<ShaderStage>(stage)))
+      ++counters[stage];
+  }
+}
+
+// =====================================================================================================================
+// Get the cache statistics of the compiler.
+//
+// @param [out] stats : Cache statistics accumulated since the compiler was created
+void Compiler::GetCacheStats(CompilerCacheStats *stats) const {
+  memset(stats, 0, sizeof(CompilerCacheStats));
+  stats->lookups.hits = m_cacheLookupCounters.hits;
+  stats->lookups.misses = m_cacheLookupCounters.misses;
+  stats->lookups.waits = m_cacheLookupCounters.waits;
+  stats->lookups.waitTime = m_cacheLookupCounters.waitNanoseconds * 1e-9;
+  stats->lookups.bytesStored = m_cacheLookupCounters.bytesStored;
+
+  if (m_shaderCache) {
+    ShaderCacheCounters counters = m_shaderCache->getCounters();
+    stats->shaderCache.hits = counters.hits;
+    stats->shaderCache.misses = counters.misses;
+    stats->shaderCache.waits = counters.waits;
+    stats->shaderCache.waitTime = counters.waitTime;
+    stats->shaderCache.bytesStored = counters.bytesStored;
+    stats->shaderCacheEvictions = counters.evictions;
+    stats->shaderCacheMaxWaiters = counters.maxWaiters;
+    stats->priorityBoosts = counters.boosts;
+  }
+
+  {
+    std::lock_guard<sys::Mutex> lock(m_backgroundPoolMutex);
+    if (m_jobQueue)
+      stats->priorityBoosts += m_jobQueue->getPromotionCount();
+  }
+
+  for (unsigned stage = 0; stage < ShaderStageCount; ++stage) {
+    stats->stageHits[stage] = m_stageCacheHits[stage];
+    stats->stageMisses[stage] = m_stageCacheMisses[stage];
+  }
+}
+
+// =====================================================================================================================
+// Get the per-pass costs of the compiler's builds.
+//
+// @param [out] stats : Array to return the costs in, sorted by pass name
+// @param count : Number of entries stats has room for
+// @returns : Number of passes that have costs
+unsigned Compiler::GetPassStats(PassBuildStats *stats, unsigned count) const {
+  std::lock_guard<sys::Mutex> lock(m_passCostsMutex);
+  unsigned index = 0;
+  for (const auto &entry : m_passCosts) {
+    if (index < count) {
+      PassBuildStats &passStats = stats[index];
+      memset(&passStats, 0, sizeof(PassBuildStats));
+      strncpy(passStats.passName, entry.first.c_str(), sizeof(passStats.passName) - 1);
+      passStats.runCount = entry.second.runCount;
+      passStats.time = entry.second.time;
+      passStats.memUsed = entry.second.memUsed;
+    }
+    ++index;
+  }
+  return index;
+}
+
+// =====================================================================================================================
+// Releases a pipeline binary that a build returned in cache memory.
+//
+// @param binHandle : Handle returned in ppBinHandle of the build output, or null
+void Compiler::ReleasePipelineBinary(void *binHandle) {
+  if (!binHandle)
+    return;
+
+  PipelineBinaryHandle *pipelineBinHandle = static_cast<PipelineBinaryHandle *>(binHandle);
+  if (!pipelineBinHandle->cacheEntry.IsEmpty())
+    EntryHandle::ReleaseHandle(std::move(pipelineBinHandle->cacheEntry));
+  releaseShaderCacheEntry(pipelineBinHandle->shaderCache, pipelineBinHandle->hEntry);
+  delete pipelineBinHandle;
+}
+
 // =====================================================================================================================
 // Builds hash code from input context for per shader stage cache
 //
+// A key is built for each hardware stage: LS-HS (vertex and tessellation control shaders), ES-GS or NGG (the last
+// vertex processing shader with the geometry shader), VS (the last vertex processing shader when there is no
+// geometry shader) and PS. Each hardware stage key covers the API shader stages it runs and the in/out usage on both
+// sides of its boundaries with the adjacent hardware stages, so a change in one stage's interface invalidates the
+// stages that consume it. The non-fragment key is then built from the keys of its hardware stages; they are not
+// separate cache units because they share register state (such as the tessellation and GS ring layouts and
+// VGT_SHADER_STAGES_EN) that is only valid for the combination they were compiled in.
+//
 // @param context : Acquired context
 // @param stageMask : Shader stage mask
 // @param stageHashes : Per-stage hash of in/out usage
@@ -2009,70 +4307,165 @@ void Compiler::ReleaseCacheEntry(bool withValue, const BinaryData *elfBin, Entry
 // @param [out] nonFragmentHash : Hash code of all non-fragment shader
 void Compiler::buildShaderCacheHash(Context *context, unsigned stageMask, ArrayRef<ArrayRef<uint8_t>> stageHashes,
                                     MetroHash::Hash *fragmentHash, MetroHash::Hash *nonFragmentHash) {
-  MetroHash64 fragmentHasher;
-  MetroHash64 nonFragmentHasher;
   auto pipelineInfo = reinterpret_cast<const GraphicsPipelineBuildInfo *>(context->getPipelineBuildInfo());
   auto pipelineOptions = context->getPipelineContext()->getPipelineOptions();
 
-  // Build hash per shader stage
-  for (auto stage = ShaderStageVertex; stage < ShaderStageGfxCount; stage = static_cast<ShaderStage>(stage + 1)) {
-    if ((stageMask & shaderStageToMask(stage)) == 0)
+  // Group the API shader stages into hardware stages. The vertex shader goes in LS-HS with tessellation, and the last
+  // vertex processing shader goes in ES-GS with a geometry shader.
+  const unsigned vsMask = shaderStageToMask(ShaderStageVertex);
+  const unsigned tcsMask = shaderStageToMask(ShaderStageTessControl);
+  const unsigned tesMask = shaderStageToMask(ShaderStageTessEval);
+  const unsigned gsMask = shaderStageToMask(ShaderStageGeometry);
+  const unsigned fsMask = shaderStageToMask(ShaderStageFragment);
+  const bool hasTs = (stageMask & (tcsMask | tesMask)) != 0;
+  const unsigned lastVertexMask = hasTs ? tesMask : vsMask;
+  SmallVector<unsigned, 4> hwStageMasks;
+  if (hasTs)
+    hwStageMasks.push_back(stageMask & (vsMask | tcsMask));
+  if (stageMask & gsMask)
+    hwStageMasks.push_back(stageMask & (lastVertexMask | gsMask));
+  else
+    hwStageMasks.push_back(stageMask & lastVertexMask);
+  hwStageMasks.push_back(stageMask & fsMask);
+
+  // Build hash per hardware stage
+  MetroHash64 fragmentHasher;
+  MetroHash64 nonFragmentHasher;
+  for (unsigned hwStageIdx = 0; hwStageIdx != hwStageMasks.size(); ++hwStageIdx) {
+    unsigned hwStageMask = hwStageMasks[hwStageIdx];
+    if (hwStageMask == 0)
       continue;
 
-    auto shaderInfo = context->getPipelineShaderInfo(stage);
-    MetroHash64 hasher;
+    MetroHash64 hwStageHasher;
+    hwStageHasher.Update(hwStageIdx);
+    for (auto stage = ShaderStageVertex; stage < ShaderStageGfxCount; stage = static_cast<ShaderStage>(stage + 1)) {
+      if ((hwStageMask & shaderStageToMask(stage)) == 0)
+        continue;
+
+      auto shaderInfo = context->getPipelineShaderInfo(stage);
+      MetroHash64 hasher;
 
-    // Update common shader info
-    PipelineDumper::updateHashForPipelineShaderInfo(stage, shaderInfo, true, &hasher, false);
-    hasher.Update(pipelineInfo->iaState.deviceIndex);
+      // Update common shader info
+      PipelineDumper::updateHashForPipelineShaderInfo(stage, shaderInfo, true, &hasher, false);
+      hasher.Update(pipelineInfo->iaState.deviceIndex);
 
-    // Update input/output usage (provided by middle-end caller of this callback).
-    hasher.Update(stageHashes[stage].data(), stageHashes[stage].size());
+      // Update input/output usage (provided by middle-end caller of this callback).
+      hasher.Update(stageHashes[stage].data(), stageHashes[stage].size());
 
-    // Update vertex input state
-    if (stage == ShaderStageVertex)
-      PipelineDumper::updateHashForVertexInputState(pipelineInfo->pVertexInput, &hasher);
+      // Update vertex input state
+      if (stage == ShaderStageVertex)
+        PipelineDumper::updateHashForVertexInputState(pipelineInfo->pVertexInput, &hasher);
+
+      MetroHash::Hash hash = {};
+      hasher.Finalize(hash.bytes);
+      hwStageHasher.Update(MetroHash::compact64(&hash));
+    }
 
-    MetroHash::Hash hash = {};
-    hasher.Finalize(hash.bytes);
+    // Update the cross-stage interface: the in/out usage of the last stage of the previous hardware stage and of the
+    // first stage of the next one.
+    static const char InterfaceTag[] = "HwStageInterface";
+    hwStageHasher.Update(reinterpret_cast<const uint8_t *>(InterfaceTag), sizeof(InterfaceTag));
+    if (hwStageIdx != 0 && hwStageMasks[hwStageIdx - 1] != 0) {
+      unsigned prevStage = Log2_32(hwStageMasks[hwStageIdx - 1]);
+      hwStageHasher.Update(stageHashes[prevStage].data(), stageHashes[prevStage].size());
+    }
+    if (hwStageIdx + 1 != hwStageMasks.size() && hwStageMasks[hwStageIdx + 1] != 0) {
+      unsigned nextStage = countTrailingZeros(hwStageMasks[hwStageIdx + 1]);
+      hwStageHasher.Update(stageHashes[nextStage].data(), stageHashes[nextStage].size());
+    }
 
-    // Add per stage hash code to fragmentHasher or nonFragmentHaser per shader stage
-    auto shaderHashCode = MetroHash::compact64(&hash);
-    if (stage == ShaderStageFragment)
-      fragmentHasher.Update(shaderHashCode);
+    // Update pipeline options, which affect the code of every hardware stage.
+    hwStageHasher.Update(pipelineOptions->includeDisassembly);
+    hwStageHasher.Update(pipelineOptions->scalarBlockLayout);
+    hwStageHasher.Update(pipelineOptions->reconfigWorkgroupLayout);
+    hwStageHasher.Update(pipelineOptions->includeIr);
+    hwStageHasher.Update(pipelineOptions->robustBufferAccess);
+    hwStageHasher.Update(pipelineOptions->extendedRobustness.robustBufferAccess);
+    hwStageHasher.Update(pipelineOptions->extendedRobustness.robustImageAccess);
+    hwStageHasher.Update(pipelineOptions->extendedRobustness.nullDescriptor);
+    hwStageHasher.Update(pipelineOptions->fastCompile);
+
+    MetroHash::Hash hwStageHash = {};
+    hwStageHasher.Finalize(hwStageHash.bytes);
+    if (hwStageMask == fsMask)
+      fragmentHasher.Update(hwStageHash.bytes, sizeof(hwStageHash));
     else
-      nonFragmentHasher.Update(shaderHashCode);
+      nonFragmentHasher.Update(hwStageHash.bytes, sizeof(hwStageHash));
   }
 
   // Add addtional pipeline state to final hasher
-  if (stageMask & shaderStageToMask(ShaderStageFragment)) {
-    // Add pipeline options to fragment hash
-    fragmentHasher.Update(pipelineOptions->includeDisassembly);
-    fragmentHasher.Update(pipelineOptions->scalarBlockLayout);
-    fragmentHasher.Update(pipelineOptions->reconfigWorkgroupLayout);
-    fragmentHasher.Update(pipelineOptions->includeIr);
-    fragmentHasher.Update(pipelineOptions->robustBufferAccess);
-    fragmentHasher.Update(pipelineOptions->extendedRobustness.robustBufferAccess);
-    fragmentHasher.Update(pipelineOptions->extendedRobustness.robustImageAccess);
-    fragmentHasher.Update(pipelineOptions->extendedRobustness.nullDescriptor);
-    PipelineDumper::updateHashForFragmentState(pipelineInfo, &fragmentHasher);
+  if (stageMask & fsMask) {
+    PipelineDumper::updateHashForFragmentState(pipelineInfo, true, &fragmentHasher, false);
     fragmentHasher.Finalize(fragmentHash->bytes);
   }
 
-  if (stageMask & ~shaderStageToMask(ShaderStageFragment)) {
+  if (stageMask & ~fsMask) {
     PipelineDumper::updateHashForNonFragmentState(pipelineInfo, true, &nonFragmentHasher);
     nonFragmentHasher.Finalize(nonFragmentHash->bytes);
   }
 }
 
+// =====================================================================================================================
+// Builds hash code for the per stage cache that is looked up before the front-end has run. Without the in/out usage
+// that buildShaderCacheHash gets from the middle-end, the code of each half depends on the shaders of the other half
+// through their interface, so both hashes cover the shaders of every stage, plus the pipeline state and options
+// that the half depends on.
+//
+// @param context : Acquired context
+// @param shaderInfo : Shader info of this pipeline
+// @param forceLoopUnrollCount : Force loop unroll count (0 means disable)
+// @param [out] fragmentHash : Hash code of fragment shader
+// @param [out] nonFragmentHash : Hash code of all non-fragment shader
+void Compiler::buildEarlyShaderCacheHash(Context *context, ArrayRef<const PipelineShaderInfo *> shaderInfo,
+                                         unsigned forceLoopUnrollCount, MetroHash::Hash *fragmentHash,
+                                         MetroHash::Hash *nonFragmentHash) {
+  auto pipelineInfo = reinterpret_cast<const GraphicsPipelineBuildInfo *>(context->getPipelineBuildInfo());
+  auto pipelineOptions = context->getPipelineContext()->getPipelineOptions();
+
+  MetroHash64 hasher;
+  static const char EarlyShaderCacheTag[] = "EarlyShaderCache";
+  hasher.Update(reinterpret_cast<const uint8_t *>(EarlyShaderCacheTag), sizeof(EarlyShaderCacheTag));
+  for (const PipelineShaderInfo *shaderInfoEntry : shaderInfo) {
+    if (shaderInfoEntry && shaderInfoEntry->pModuleData)
+      PipelineDumper::updateHashForPipelineShaderInfo(shaderInfoEntry->entryStage, shaderInfoEntry, true, &hasher,
+                                                      false);
+  }
+  hasher.Update(pipelineInfo->iaState.deviceIndex);
+  PipelineDumper::updateHashForVertexInputState(pipelineInfo->pVertexInput, &hasher);
+  hasher.Update(context->getGfxIpVersion());
+  hasher.Update(forceLoopUnrollCount);
+  hasher.Update(pipelineOptions->includeDisassembly);
+  hasher.Update(pipelineOptions->scalarBlockLayout);
+  hasher.Update(pipelineOptions->reconfigWorkgroupLayout);
+  hasher.Update(pipelineOptions->includeIr);
+  hasher.Update(pipelineOptions->robustBufferAccess);
+  hasher.Update(pipelineOptions->extendedRobustness.robustBufferAccess);
+  hasher.Update(pipelineOptions->extendedRobustness.robustImageAccess);
+  hasher.Update(pipelineOptions->extendedRobustness.nullDescriptor);
+  hasher.Update(pipelineOptions->fastCompile);
+  MetroHash::Hash shadersHash = {};
+  hasher.Finalize(shadersHash.bytes);
+
+  MetroHash64 fragmentHasher;
+  fragmentHasher.Update(shadersHash.bytes, sizeof(shadersHash));
+  PipelineDumper::updateHashForFragmentState(pipelineInfo, true, &fragmentHasher, false);
+  fragmentHasher.Finalize(fragmentHash->bytes);
+
+  MetroHash64 nonFragmentHasher;
+  nonFragmentHasher.Update(shadersHash.bytes, sizeof(shadersHash));
+  PipelineDumper::updateHashForNonFragmentState(pipelineInfo, true, &nonFragmentHasher);
+  nonFragmentHasher.Finalize(nonFragmentHash->bytes);
+}
+
 // =====================================================================================================================
 // Link relocatable shader elf file into a pipeline elf file and apply relocations.
 //
-// @param shaderElfs : An array of pipeline elf packages, indexed by stage, containing relocatable elf.
-//                     TODO: This has an implicit length of ShaderStageNativeStageCount. Use ArrayRef instead.
+// @param shaderElfs : Relocatable elf of each shader stage, indexed by stage (empty if the stage is not present). The
+//                     elfs are read in place, and must stay valid until the link is done.
 // @param [out] pipelineElf : Elf package containing the pipeline elf
 // @param context : Acquired context
-void Compiler::linkRelocatableShaderElf(ElfPackage *shaderElfs, ElfPackage *pipelineElf, Context *context) {
+void Compiler::linkRelocatableShaderElf(ArrayRef<StringRef> shaderElfs, ElfPackage *pipelineElf, Context *context) {
+  assert(shaderElfs.size() == ShaderStageNativeStageCount);
   assert(shaderElfs[ShaderStageTessControl].empty() && "Cannot link tessellation shaders yet.");
   assert(shaderElfs[ShaderStageTessEval].empty() && "Cannot link tessellation shaders yet.");
   assert(shaderElfs[ShaderStageGeometry].empty() && "Cannot link geometry shaders yet.");
@@ -2084,16 +4477,71 @@ void Compiler::linkRelocatableShaderElf(ElfPackage *shaderElfs, ElfPackage *pipe
   context->getPipelineContext()->setPipelineState(&*pipeline, /*unlinked=*/false);
 
   // Create linker, passing ELFs to it.
+  // Reserve the output for the total size of the input ELFs, which the linked ELF does not normally exceed, so the
+  // output stream does not have to grow and copy it as sections are written.
   SmallVector<MemoryBufferRef, 3> elfs;
+  size_t totalElfSize = 0;
   for (unsigned stage = 0; stage != ShaderStageNativeStageCount; ++stage) {
-    if (!shaderElfs[stage].empty())
-      elfs.push_back(MemoryBufferRef(shaderElfs[stage].str(), getShaderStageName(static_cast<ShaderStage>(stage))));
+    if (!shaderElfs[stage].empty()) {
+      elfs.push_back(MemoryBufferRef(shaderElfs[stage], getShaderStageName(static_cast<ShaderStage>(stage))));
+      totalElfSize += shaderElfs[stage].size();
+    }
   }
+  pipelineElf->reserve(totalElfSize);
   std::unique_ptr<ElfLinker> elfLinker(pipeline->createElfLinker(elfs));
 
+  // Look up each glue shader in the caches, keyed by its glue info string. A hit is passed to the linker with
+  // addGlue(); a miss is compiled with compileGlue() and stored. Cache entry handles are held until the link is
+  // done, as addGlue() does not copy the blob.
+  ArrayRef<StringRef> glueInfo = elfLinker->getGlueInfo();
+  SmallVector<EntryHandle, 4> glueEntries(glueInfo.size());
+  SmallVector<std::pair<ShaderCache *, CacheEntryHandle>, 4> hitGlueEntries;
+  for (unsigned glueIndex = 0; glueIndex != glueInfo.size(); ++glueIndex) {
+    MetroHash64 hasher;
+    static const char GlueShaderTag[] = "GlueShader";
+    hasher.Update(reinterpret_cast<const uint8_t *>(GlueShaderTag), sizeof(GlueShaderTag));
+    hasher.Update(context->getGfxIpVersion());
+    hasher.Update(reinterpret_cast<const uint8_t *>(glueInfo[glueIndex].data()), glueInfo[glueIndex].size());
+    MetroHash::Hash glueHash = {};
+    hasher.Finalize(glueHash.bytes);
+
+    BinaryData glueBin = {};
+    if (IsCacheValid()) {
+      HashId hashId = {};
+      memcpy(&hashId.bytes, &glueHash.bytes, sizeof(glueHash));
+      Result cacheResult = lookUpCaches(nullptr, &hashId, &glueBin, &glueEntries[glueIndex]);
+      if (cacheResult == Result::Success) {
+        elfLinker->addGlue(glueIndex, StringRef(reinterpret_cast<const char *>(glueBin.pCode), glueBin.codeSize));
+        continue;
+      }
+      StringRef glueElf = elfLinker->compileGlue(glueIndex);
+      glueBin.pCode = glueElf.data();
+      glueBin.codeSize = glueElf.size();
+      ReleaseCacheEntry(cacheResult == Result::NotFound && !glueElf.empty(), &glueBin, &glueEntries[glueIndex]);
+      continue;
+    }
+
+    ShaderCache *shaderCache;
+    CacheEntryHandle hEntry;
+    if (lookUpShaderCaches(nullptr, &glueHash, &glueBin, &shaderCache, &hEntry) == ShaderEntryState::Ready) {
+      elfLinker->addGlue(glueIndex, StringRef(reinterpret_cast<const char *>(glueBin.pCode), glueBin.codeSize));
+      hitGlueEntries.push_back({shaderCache, hEntry});
+      continue;
+    }
+    StringRef glueElf = elfLinker->compileGlue(glueIndex);
+    glueBin.pCode = glueElf.data();
+    glueBin.codeSize = glueElf.size();
+    updateShaderCache(!glueElf.empty(), &glueBin, shaderCache, hEntry);
+  }
+
   // Do the link.
   raw_svector_ostream outStream(*pipelineElf);
-  if (!elfLinker->link(outStream)) {
+  bool linked = elfLinker->link(outStream);
+  for (EntryHandle &glueEntry : glueEntries)
+    ReleaseCacheEntry(false, nullptr, &glueEntry);
+  for (auto &hitGlueEntry : hitGlueEntries)
+    releaseShaderCacheEntry(hitGlueEntry.first, hitGlueEntry.second);
+  if (!linked) {
     // Link failed in a recoverable way.
     // TODO: Action this failure by doing a full pipeline compile.
     report_fatal_error("Link failed; need full pipeline compile instead: " + pipeline->getLastError());
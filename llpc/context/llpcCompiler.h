@@ -36,10 +36,20 @@
 #include "vkgcElfReader.h"
 #include "vkgcMetroHash.h"
 #include "lgc/CommonDefs.h"
+#include "lgc/PassCosts.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Support/Mutex.h"
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <vector>
 
 namespace llvm {
 
 class Module;
+class ThreadPool;
 
 } // namespace llvm
 
@@ -59,12 +69,20 @@ class Compiler;
 class ComputeContext;
 class Context;
 class GraphicsContext;
+class PipelineContext;
+class PipelineJobQueue;
+class UserDataNodeMergeCache;
 
 // =====================================================================================================================
 // Object to manage checking and updating shader cache for graphics pipeline.
 class GraphicsShaderCacheChecker {
 public:
   GraphicsShaderCacheChecker(Compiler *compiler, Context *context) : m_compiler(compiler), m_context(context) {}
+  ~GraphicsShaderCacheChecker();
+
+  // Check shader caches before the front-end has run, returning true if both halves of the pipeline were found.
+  bool checkEarly(llvm::ArrayRef<const PipelineShaderInfo *> shaderInfo, unsigned forceLoopUnrollCount,
+                  ElfPackage *pipelineElf);
 
   // Check shader caches, returning mask of which shader stages we want to keep in this compile.
   unsigned check(const llvm::Module *module, unsigned stageMask, llvm::ArrayRef<llvm::ArrayRef<uint8_t>> stageHashes);
@@ -78,6 +96,8 @@ public:
   void updateRootUserDateOffset(ElfPackage *pipelineElf);
 
 private:
+  void lookUpCachesTogether(Vkgc::ICache *userCache, Vkgc::HashId *fragmentHashId, Vkgc::HashId *nonFragmentHashId);
+
   Compiler *m_compiler;
   Context *m_context;
 
@@ -98,6 +118,92 @@ private:
 
   Vkgc::Result m_fragmentCacheResult = Vkgc::Result::ErrorUnknown;
   Vkgc::EntryHandle m_fragmentEntry;
+
+  // ICache entries keyed before the front-end has run
+  Vkgc::Result m_earlyNonFragmentCacheResult = Vkgc::Result::ErrorUnknown;
+  Vkgc::EntryHandle m_earlyNonFragmentEntry;
+
+  Vkgc::Result m_earlyFragmentCacheResult = Vkgc::Result::ErrorUnknown;
+  Vkgc::EntryHandle m_earlyFragmentEntry;
+};
+
+// =====================================================================================================================
+// Object to manage checking and updating the cache of lowered shader stages for a pipeline. A lowered shader stage is
+// the module of one stage after SPIR-V translation and lowering, stored as bitcode, and is keyed on everything that
+// the front-end reads, including specialization constants and compilation options, so it can be reused by any pipeline
+// with the same stage. The shader modes that the translator sets are recorded in the module with it.
+class LoweredShaderCacheChecker {
+public:
+  LoweredShaderCacheChecker(Compiler *compiler, Context *context) : m_compiler(compiler), m_context(context) {}
+  ~LoweredShaderCacheChecker();
+
+  // Look up the lowered module of a shader stage, returning true and setting its bitcode on a hit.
+  bool lookUp(unsigned shaderIndex, const PipelineShaderInfo *shaderInfo, unsigned forceLoopUnrollCount,
+              BinaryData *bitcode);
+
+  // Whether the lowered module of a shader stage needs to be stored after it has been compiled.
+  bool needsUpdate(unsigned shaderIndex) const;
+
+  // Store the lowered module of a shader stage, or record that compiling it failed.
+  void update(unsigned shaderIndex, bool success, const BinaryData *bitcode);
+
+private:
+  // Cache lookup state for one shader stage
+  struct StageEntry {
+    Vkgc::Result cacheResult = Vkgc::Result::ErrorUnknown; // Result of ICache lookup
+    Vkgc::EntryHandle entry;                               // ICache entry
+    ShaderEntryState entryState = ShaderEntryState::New;   // Old shader cache entry state
+    ShaderCache *shaderCache = nullptr;                    // Old shader cache
+    CacheEntryHandle hEntry = nullptr;                     // Old shader cache entry
+  };
+
+  Compiler *m_compiler;
+  Context *m_context;
+  StageEntry m_stages[ShaderStageNativeStageCount];
+};
+
+// =====================================================================================================================
+// Options of one compiler instance that only affect the code it generates or how it caches it. They are captured
+// from the compilation options when the compiler is created and given to each pipeline it builds, so that compilers
+// in one process can differ in them (for example a fast tier and a fully optimized tier).
+struct CompilerOptions {
+  unsigned optLevel;        // Codegen optimization level, as CodeGenOpt::Level (-codegen-opt-level)
+  unsigned vgprLimit;       // Maximum VGPR limit (-vgpr-limit)
+  unsigned sgprLimit;       // Maximum SGPR limit (-sgpr-limit)
+  unsigned wavesPerEu;      // Maximum number of waves per EU (-waves-per-eu)
+  bool enableScalarLoad;    // Whether to enable the load scalarizer (-enable-load-scalarizer)
+  unsigned scalarThreshold; // Vector size threshold for the load scalarizer (-scalar-threshold)
+  bool enableSiScheduler;   // Whether to enable target option si-scheduler (-enable-si-scheduler)
+  int subgroupSize;         // Sub-group size exposed via Vulkan API (-subgroup-size)
+  unsigned shaderCacheMode; // Shader cache mode (-shader-cache-mode)
+  unsigned debugInfoLevel;  // Debug info translated from SPIR-V, as SPIRV::SPIRVDebugInfoLevel (-spirv-debug-info)
+};
+
+// =====================================================================================================================
+// Handle of a pipeline binary returned in cache memory, which keeps the cache entry holding it alive until the client
+// releases the handle.
+struct PipelineBinaryHandle {
+  Vkgc::EntryHandle cacheEntry;       // Entry of the ICache, or empty
+  ShaderCache *shaderCache = nullptr; // Shader cache holding hEntry
+  CacheEntryHandle hEntry = nullptr;  // Entry of the shader cache, or null
+};
+
+// =====================================================================================================================
+// Free list of the contexts in the context pool that are not in use, for one GfxIp version. The lock is held only
+// to push or pop a context, so acquiring and releasing contexts of different GfxIp versions never contend.
+struct ContextFreeList {
+  llvm::sys::Mutex lock;           // Lock for access to the free list
+  std::vector<Context *> contexts; // Contexts that are not in use
+};
+
+// =====================================================================================================================
+// Counters of cache lookups, updated by concurrent builds.
+struct CacheLookupCounters {
+  std::atomic<uint64_t> hits{0};            // Lookups that found the entry ready
+  std::atomic<uint64_t> misses{0};          // Lookups that did not find the entry ready
+  std::atomic<uint64_t> waits{0};           // Lookups that waited for an entry another thread was populating
+  std::atomic<uint64_t> waitNanoseconds{0}; // Total time of those waits, in nanoseconds
+  std::atomic<uint64_t> bytesStored{0};     // Bytes of data stored in the caches
 };
 
 // =====================================================================================================================
@@ -118,8 +224,48 @@ public:
   virtual Result BuildGraphicsPipeline(const GraphicsPipelineBuildInfo *pipelineInfo,
                                        GraphicsPipelineBuildOut *pipelineOut, void *pipelineDumpFile = nullptr);
 
+  virtual Result BuildGraphicsPipelines(unsigned pipelineCount, const GraphicsPipelineBuildInfo *const *pipelineInfos,
+                                        GraphicsPipelineBuildOut *pipelineOuts, Result *results);
+
+  virtual Result BuildGraphicsPipelineTiered(const GraphicsPipelineBuildInfo *pipelineInfo,
+                                             GraphicsPipelineBuildOut *pipelineOut,
+                                             OptimizedPipelineCallback optimizedCallback, void *callbackData);
+
+  virtual Result BuildGraphicsPipelinePart(const GraphicsPipelineBuildInfo *pipelineInfo, GraphicsPipelinePart part,
+                                           GraphicsPipelineBuildOut *partOut);
+
+  virtual Result LinkGraphicsPipelineParts(const GraphicsPipelineBuildInfo *pipelineInfo, const BinaryData *partBins,
+                                           GraphicsPipelineBuildOut *pipelineOut,
+                                           OptimizedPipelineCallback optimizedCallback, void *callbackData);
+
   virtual Result BuildComputePipeline(const ComputePipelineBuildInfo *pipelineInfo,
                                       ComputePipelineBuildOut *pipelineOut, void *pipelineDumpFile = nullptr);
+
+  virtual Result BuildGraphicsPipelineAsync(const GraphicsPipelineBuildInfo *pipelineInfo,
+                                            GraphicsPipelineBuildOut *pipelineOut, PipelineJobPriority priority,
+                                            PipelineJobCallback doneCallback, void *callbackData, void **job);
+
+  virtual Result BuildComputePipelineAsync(const ComputePipelineBuildInfo *pipelineInfo,
+                                           ComputePipelineBuildOut *pipelineOut, PipelineJobPriority priority,
+                                           PipelineJobCallback doneCallback, void *callbackData, void **job);
+
+  virtual Result CancelPipelineJob(void *job);
+
+  virtual Result WaitPipelineJob(void *job);
+
+  virtual void ReleasePipelineJob(void *job);
+
+  virtual void GetCacheStats(CompilerCacheStats *stats) const;
+
+  virtual unsigned GetPassStats(PassBuildStats *stats, unsigned count) const;
+
+  virtual void ReleasePipelineBinary(void *binHandle);
+
+  virtual Result PrefetchPipelines(unsigned graphicsPipelineCount,
+                                   const GraphicsPipelineBuildInfo *const *graphicsPipelineInfos,
+                                   unsigned computePipelineCount,
+                                   const ComputePipelineBuildInfo *const *computePipelineInfos);
+
   Result buildGraphicsPipelineInternal(GraphicsContext *graphicsContext,
                                        llvm::ArrayRef<const PipelineShaderInfo *> shaderInfo,
                                        unsigned forceLoopUnrollCount, bool buildingRelocatableElf,
@@ -130,7 +276,8 @@ public:
                                       ElfPackage *pipelineElf);
 
   Result buildPipelineWithRelocatableElf(Context *context, llvm::ArrayRef<const PipelineShaderInfo *> shaderInfo,
-                                         unsigned forceLoopUnrollCount, ElfPackage *pipelineElf);
+                                         unsigned forceLoopUnrollCount, ElfPackage *pipelineElf,
+                                         bool linkStages = true);
 
   Result buildPipelineInternal(Context *context, llvm::ArrayRef<const PipelineShaderInfo *> shaderInfo,
                                unsigned forceLoopUnrollCount, bool unlinked, ElfPackage *pipelineElf);
@@ -141,7 +288,17 @@ public:
   // Gets the count of redirect output
   static unsigned getOutRedirectCount() { return m_outRedirectCount; }
 
-  static MetroHash::Hash generateHashForCompileOptions(unsigned optionCount, const char *const *options);
+  static MetroHash::Hash generateHashForCompileOptions(unsigned optionCount, const char *const *options,
+                                                       bool excludeCompilerOptions = false);
+
+  static bool isCompilerOption(llvm::StringRef option);
+  static bool applyCompilerOptions(unsigned optionCount, const char *const *options);
+
+  // Gets the options that this compiler instance captured for itself
+  const CompilerOptions &getCompilerOptions() const { return m_compilerOptions; }
+
+  // Gets the hash code of the compilation options of this compiler instance
+  const MetroHash::Hash &getOptionHash() const { return m_optionHash; }
 
 #if LLPC_CLIENT_INTERFACE_MAJOR_VERSION < 38 || LLPC_ENABLE_SHADER_CACHE
   virtual Result CreateShaderCache(const ShaderCacheCreateInfo *pCreateInfo, IShaderCache **ppShaderCache);
@@ -152,42 +309,104 @@ public:
 
   void updateShaderCache(bool insert, const BinaryData *elfBin, ShaderCache *shaderCache, CacheEntryHandle phEntry);
 
+  void releaseShaderCacheEntry(ShaderCache *shaderCache, CacheEntryHandle hEntry);
+
+  void prefetchCacheEntry(Vkgc::ICache *appPipelineCache, IShaderCache *appShaderCache,
+                          const MetroHash::Hash &cacheHash);
+
+  bool isCacheEntryCompiling(Vkgc::ICache *appPipelineCache, IShaderCache *appShaderCache,
+                             const MetroHash::Hash &cacheHash);
+
   Vkgc::Result lookUpCaches(Vkgc::ICache *appPipelineCache, Vkgc::HashId *cacheHash, BinaryData *elfBin,
-                            Vkgc::EntryHandle *entryHandle);
+                            Vkgc::EntryHandle *entryHandle, bool waitIfNotReady = true);
+
+  Vkgc::Result waitForCacheEntry(BinaryData *elfBin, Vkgc::EntryHandle *entryHandle);
 
   void ReleaseCacheEntry(bool withValue, const BinaryData *elfBin, Vkgc::EntryHandle *entryHandle);
 
   bool IsCacheValid() { return m_cache != nullptr; }
 
+  void recordStageCacheResult(unsigned stageMask, bool hit);
+
   static void buildShaderCacheHash(Context *context, unsigned stageMask,
                                    llvm::ArrayRef<llvm::ArrayRef<uint8_t>> stageHashes, MetroHash::Hash *fragmentHash,
                                    MetroHash::Hash *nonFragmentHash);
 
+  static void buildEarlyShaderCacheHash(Context *context, llvm::ArrayRef<const PipelineShaderInfo *> shaderInfo,
+                                        unsigned forceLoopUnrollCount, MetroHash::Hash *fragmentHash,
+                                        MetroHash::Hash *nonFragmentHash);
+
 private:
   Compiler() = delete;
   Compiler(const Compiler &) = delete;
   Compiler &operator=(const Compiler &) = delete;
 
   Result validatePipelineShaderInfo(const PipelineShaderInfo *shaderInfo) const;
+  Result optimizeSpirvCached(const MetroHash::Hash &cacheHash, const BinaryData *spirvBin,
+                             std::vector<uint8_t> &optimizedSpirv) const;
+  void computeShaderModuleAliasHash(const BinaryData *spirvBin, MetroHash::Hash *hash,
+                                    MetroHash::Hash *aliasHash) const;
+  bool lookUpShaderModuleAlias(const MetroHash::Hash &aliasHash, MetroHash::Hash *cacheHash) const;
+  void addShaderModuleAlias(const MetroHash::Hash &aliasHash, const MetroHash::Hash &cacheHash) const;
 
   Context *acquireContext() const;
   void releaseContext(Context *context) const;
+  void addFreeContext(Context *context) const;
+  void prewarmContexts(unsigned count) const;
+  llvm::ThreadPool *getContextWorkers() const;
+  static ContextFreeList *getContextFreeList(GfxIpVersion gfxIp);
 
   bool runPasses(lgc::PassManager *passMgr, llvm::Module *module) const;
-  void linkRelocatableShaderElf(ElfPackage *shaderElfs, ElfPackage *pipelineElf, Context *context);
+  Result lowerShaderStage(PipelineContext *pipelineContext, const PipelineShaderInfo *shaderInfo, unsigned shaderIndex,
+                          unsigned forceLoopUnrollCount, bool unlinked, llvm::SmallVectorImpl<char> &bitcode) const;
+  void linkRelocatableShaderElf(llvm::ArrayRef<llvm::StringRef> shaderElfs, ElfPackage *pipelineElf,
+                                Context *context);
+  bool canUseDirectBuilder(llvm::ArrayRef<const PipelineShaderInfo *> shaderInfo, bool unlinked) const;
   bool canUseRelocatableGraphicsShaderElf(const llvm::ArrayRef<const PipelineShaderInfo *> &shaderInfo);
   bool canUseRelocatableComputeShaderElf(const PipelineShaderInfo *shaderInfo);
+  Result timeCacheWait(llvm::function_ref<Result()> wait);
+  bool isFetchShaderLinkCheaper(const GraphicsPipelineBuildInfo *pipelineInfo);
+  void scheduleOptimizedGraphicsPipeline(const GraphicsPipelineBuildInfo *pipelineInfo,
+                                         OptimizedPipelineCallback optimizedCallback, void *callbackData);
+  static uint64_t estimateBuildMemory(llvm::ArrayRef<const PipelineShaderInfo *> shaderInfo);
+  Result queuePipelineJob(std::function<Result()> build, std::function<bool()> isWaiting, uint64_t key,
+                          PipelineJobPriority priority, uint64_t memEstimate, PipelineJobCallback doneCallback,
+                          void *callbackData, void **job);
 
   std::vector<std::string> m_options;           // Compilation options
   MetroHash::Hash m_optionHash;                 // Hash code of compilation options
+  CompilerOptions m_compilerOptions;            // Options this compiler captured for itself
   GfxIpVersion m_gfxIp;                         // Graphics IP version info
   Vkgc::ICache *m_cache;                        // Point to ICache implemented in client
   static unsigned m_instanceCount;              // The count of compiler instance
   static unsigned m_outRedirectCount;           // The count of output redirect
   ShaderCachePtr m_shaderCache;                 // Shader cache
-  static llvm::sys::Mutex m_contextPoolMutex;   // Mutex for context pool access
+  ShaderCachePtr m_moduleCache;                 // Shader module cache shared by compilers (may be null)
+  CacheLookupCounters m_cacheLookupCounters;    // Counters of the cache lookups of this compiler's builds
+  // Per-stage hits of pipeline part and shader ELF lookups
+  std::atomic<uint64_t> m_stageCacheHits[ShaderStageCount];
+  // Per-stage misses of those lookups
+  std::atomic<uint64_t> m_stageCacheMisses[ShaderStageCount];
+  static llvm::sys::Mutex m_contextPoolMutex;   // Mutex for context pool and free list map access
   static std::vector<Context *> *m_contextPool; // Context pool
-  unsigned m_relocatablePipelineCompilations;   // The number of pipelines compiled using relocatable shader elf
+  // Free lists of the context pool, keyed by packed GfxIp version
+  static std::map<unsigned, ContextFreeList *> *m_contextFreeLists;
+  ContextFreeList *m_contextFreeList;             // Free list for the GfxIp version of this compiler
+  unsigned m_relocatablePipelineCompilations;     // The number of pipelines compiled using relocatable shader elf
+  mutable llvm::sys::Mutex m_backgroundPoolMutex; // Mutex for creating the background thread pools
+  // Thread pool running the optimized compiles of tiered pipeline builds, created on first use
+  std::unique_ptr<llvm::ThreadPool> m_backgroundPool;
+  llvm::sys::Mutex m_libraryLinkMutex; // Mutex for m_libraryLinkCounts
+  // Number of links of each combination of graphics pipeline library parts, keyed by pipeline hash
+  std::unordered_map<uint64_t, unsigned> m_libraryLinkCounts;
+  // Worker threads running asynchronous pipeline builds, created on first use
+  std::unique_ptr<PipelineJobQueue> m_jobQueue;
+  // Thread pool creating and recycling contexts off the build threads, created on first use
+  mutable std::unique_ptr<llvm::ThreadPool> m_contextWorkers;
+  // Merged user data node tables of graphics pipelines, keyed by their per-stage inputs
+  std::unique_ptr<UserDataNodeMergeCache> m_userDataNodeMergeCache;
+  mutable llvm::sys::Mutex m_passCostsMutex; // Mutex for m_passCosts
+  mutable lgc::PassCostMap m_passCosts;      // Per-pass costs of the compiler's builds, with -pass-costs
 };
 
 // Convert front-end LLPC shader stage to middle-end LGC shader stage
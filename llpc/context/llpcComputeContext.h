@@ -60,7 +60,7 @@ public:
   virtual unsigned getActiveShaderStageCount() const { return 1; }
 
   // Does user data node merging for all shader stages
-  virtual void doUserDataNodeMerge() {}
+  virtual void doUserDataNodeMerge(UserDataNodeMergeCache *mergeCache = nullptr) {}
 
   // Gets per pipeline options
   virtual const PipelineOptions *getPipelineOptions() const { return &m_pipelineInfo->options; }
@@ -72,7 +72,9 @@ Context::~Context() {
 // =====================================================================================================================
 void Context::reset() {
   m_pipelineContext = nullptr;
-  delete m_builder;
+  // Give the builder back to the LgcContext, which re-targets it for the next pipeline instead of reallocating it.
+  if (m_builder)
+    m_builderContext->releaseBuilder(m_builder);
   m_builder = nullptr;
 }
 
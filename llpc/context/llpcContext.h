@@ -38,11 +38,42 @@
 #include "llvm/IR/Metadata.h"
 #include "llvm/IR/Type.h"
 #include "llvm/Target/TargetMachine.h"
+#include <string>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 namespace Llpc {
 
+// =====================================================================================================================
+// Memoized translation of a SPIR-V type to an LLVM type. The LLVM type belongs to the context, so it can be reused by
+// every pipeline compiled in it; the effects the translation has on the translator's per-module bookkeeping are kept
+// alongside so that they can be replayed on each reuse.
+struct SpirvTypeTranslation {
+  enum EffectKind : unsigned {
+    RemappedTypeElement, // Struct member or padded array element was remapped
+    TypeWithPad,         // LLVM type contains manually inserted padding
+    OverlappingMember,   // Struct member was replaced by a pad array because of overlapping offsets
+    MappedType,          // Nested SPIR-V type was mapped to its LLVM type
+  };
+
+  struct Effect {
+    EffectKind kind;  // Kind of the effect
+    unsigned node;    // Preorder index of the SPIR-V type node the effect applies to
+    unsigned from;    // Member index (RemappedTypeElement, OverlappingMember)
+    unsigned to;      // Remapped member index (RemappedTypeElement)
+    llvm::Type *type; // Padded type (TypeWithPad), original member type (OverlappingMember) or mapped type
+                      // (MappedType)
+    bool isMatrixRow; // Whether the padded type is a row-major matrix (TypeWithPad)
+  };
+
+  llvm::Type *type;            // Translated LLVM type
+  std::vector<Effect> effects; // Effects to replay when the translation is reused
+};
+
+// Map from the structural key of a SPIR-V type (plus layout parameters) to its translation
+typedef std::unordered_map<std::string, SpirvTypeTranslation> SpirvTypeTranslationCache;
+
 // =====================================================================================================================
 // Represents LLPC context for pipeline compilation. Derived from the base class llvm::LLVMContext.
 class Context : public llvm::LLVMContext {
@@ -66,6 +97,12 @@ public:
   // Get the number of times this context is used.
   unsigned getUseCount() const { return m_useCount; }
 
+  // Account for SPIR-V translated in this context, as a measure of how much the context has grown.
+  void addTranslatedSpirvSize(size_t size) { m_translatedSpirvSize += size; }
+
+  // Get the total size in bytes of SPIR-V translated in this context.
+  uint64_t getTranslatedSpirvSize() const { return m_translatedSpirvSize; }
+
   // Attaches pipeline context to LLPC context.
   void attachPipelineContext(PipelineContext *pipelineContext) { m_pipelineContext = pipelineContext; }
 
@@ -120,7 +157,9 @@ public:
 
   GfxIpVersion getGfxIpVersion() const { return m_gfxIp; }
 
-  void doUserDataNodeMerge() { m_pipelineContext->doUserDataNodeMerge(); }
+  void doUserDataNodeMerge(UserDataNodeMergeCache *mergeCache = nullptr) {
+    m_pipelineContext->doUserDataNodeMerge(mergeCache);
+  }
 
   uint64_t getPiplineHashCode() const { return m_pipelineContext->getPiplineHashCode(); }
 
@@ -133,6 +172,9 @@ public:
   // Sets triple and data layout in specified module from the context's target machine.
   void setModuleTargetMachine(llvm::Module *module);
 
+  // Gets the cache of SPIR-V type translations shared by all pipelines compiled in this context.
+  SpirvTypeTranslationCache &getSpirvTypeTranslationCache() { return m_spirvTypeTranslationCache; }
+
 private:
   Context() = delete;
   Context(const Context &) = delete;
@@ -149,7 +191,10 @@ private:
   bool m_scalarBlockLayout = false;                     // scalarBlockLayout option from last pipeline compile
   bool m_robustBufferAccess = false;                    // robustBufferAccess option from last pipeline compile
 
-  unsigned m_useCount = 0; // Number of times this context is used.
+  unsigned m_useCount = 0;            // Number of times this context is used.
+  uint64_t m_translatedSpirvSize = 0; // Total size in bytes of SPIR-V translated in this context
+
+  SpirvTypeTranslationCache m_spirvTypeTranslationCache; // SPIR-V type translations, kept for the context lifetime
 };
 
 } // namespace Llpc
@@ -31,16 +31,29 @@
 #include "llpcGraphicsContext.h"
 #include "SPIRVInternal.h"
 #include "llpcCompiler.h"
+#include "vkgcPipelineDumper.h"
 #include "lgc/Builder.h"
 #include "llvm/Support/Format.h"
+#include <mutex>
 
 #define DEBUG_TYPE "llpc-graphics-context"
 
 using namespace llvm;
+using namespace MetroHash;
 using namespace SPIRV;
+using Vkgc::PipelineDumper;
 
 namespace Llpc {
 
+// =====================================================================================================================
+// Gets the size in dwords of one element of the static SRDs of a descriptor range value.
+//
+// @param rangeValue : Descriptor range value
+static unsigned getDescriptorRangeValueSize(const DescriptorRangeValue &rangeValue) {
+  // A YCbCr sampler is followed by its YCbCrMetaData, which is another 4 dwords.
+  return rangeValue.type != ResourceMappingNodeType::DescriptorYCbCrSampler ? 4 : 8;
+}
+
 // =====================================================================================================================
 //
 // @param gfxIp : Graphics Ip version info
@@ -112,14 +125,93 @@ const PipelineShaderInfo *GraphicsContext::getPipelineShaderInfo(ShaderStage sha
 
 // =====================================================================================================================
 // Does user data node merging for all shader stages
-void GraphicsContext::doUserDataNodeMerge() {
+//
+// @param mergeCache : Cache of merged user data to look the result up in and add it to (may be null)
+void GraphicsContext::doUserDataNodeMerge(UserDataNodeMergeCache *mergeCache) {
   unsigned stageMask = getShaderStageMask();
-  SmallVector<ResourceMappingNode, 8> allNodes;
 
   // No need to merge if there is only one shader stage.
   if (isPowerOf2_32(stageMask))
     return;
 
+  uint64_t key = 0;
+  std::shared_ptr<const MergedUserData> mergedUserData;
+  if (mergeCache) {
+    key = getUserDataNodeMergeKey(stageMask);
+    mergedUserData = mergeCache->lookUp(key);
+  }
+
+  if (!mergedUserData) {
+    mergedUserData = mergeUserData(stageMask);
+    if (mergeCache)
+      mergeCache->insert(key, mergedUserData);
+  }
+  m_mergedUserData = std::move(mergedUserData);
+
+  // Point each shader stage at the merged user data nodes and descriptor range values.
+  for (unsigned stage = 0; stage < ShaderStageNativeStageCount; ++stage) {
+    if ((stageMask >> stage) & 1) {
+      auto shaderInfo = const_cast<PipelineShaderInfo *>(getPipelineShaderInfo(ShaderStage(stage)));
+      shaderInfo->pUserDataNodes = m_mergedUserData->userDataNodes.data();
+      shaderInfo->userDataNodeCount = m_mergedUserData->userDataNodes.size();
+      // The client's hash was of the stage's own nodes, not the merged ones.
+      shaderInfo->userDataNodesHash = 0;
+      if (!m_mergedUserData->descriptorRangeValues.empty()) {
+        shaderInfo->pDescriptorRangeValues = m_mergedUserData->descriptorRangeValues.data();
+        shaderInfo->descriptorRangeValueCount = m_mergedUserData->descriptorRangeValues.size();
+      }
+    }
+  }
+}
+
+// =====================================================================================================================
+// Gets the key of the user data merge cache for the user data nodes and descriptor range values of all shader stages.
+// The user data nodes of a stage are represented by the client's userDataNodesHash when it supplies one.
+//
+// @param stageMask : Mask of shader stages to merge
+uint64_t GraphicsContext::getUserDataNodeMergeKey(unsigned stageMask) const {
+  MetroHash64 hasher;
+  for (unsigned stage = 0; stage < ShaderStageNativeStageCount; ++stage) {
+    if ((stageMask >> stage) & 1) {
+      auto shaderInfo = getPipelineShaderInfo(ShaderStage(stage));
+      hasher.Update(stage);
+
+      hasher.Update(shaderInfo->userDataNodeCount);
+      if (shaderInfo->userDataNodeCount > 0) {
+        uint64_t userDataNodesHash = shaderInfo->userDataNodesHash;
+        if (userDataNodesHash == 0) {
+          userDataNodesHash = PipelineDumper::generateHashForResourceMappingNodes(
+              shaderInfo->pUserDataNodes, shaderInfo->userDataNodeCount, false);
+        }
+        hasher.Update(userDataNodesHash);
+      }
+
+      hasher.Update(shaderInfo->descriptorRangeValueCount);
+      for (const DescriptorRangeValue &rangeValue :
+           ArrayRef<DescriptorRangeValue>(shaderInfo->pDescriptorRangeValues, shaderInfo->descriptorRangeValueCount)) {
+        hasher.Update(rangeValue.type);
+        hasher.Update(rangeValue.set);
+        hasher.Update(rangeValue.binding);
+        hasher.Update(rangeValue.arraySize);
+        hasher.Update(reinterpret_cast<const uint8_t *>(rangeValue.pValue),
+                      rangeValue.arraySize * getDescriptorRangeValueSize(rangeValue) * sizeof(unsigned));
+      }
+    }
+  }
+
+  MetroHash::Hash hash = {};
+  hasher.Finalize(hash.bytes);
+  return MetroHash::compact64(&hash);
+}
+
+// =====================================================================================================================
+// Merges the user data nodes and descriptor range values of all shader stages into new tables.
+//
+// @param stageMask : Mask of shader stages to merge
+std::shared_ptr<const MergedUserData> GraphicsContext::mergeUserData(unsigned stageMask) const {
+  auto mergedUserData = std::make_shared<MergedUserData>();
+  SmallVector<ResourceMappingNode, 8> allNodes;
+
   // Collect user data nodes from all shader stages into one big table.
   for (unsigned stage = 0; stage < ShaderStageNativeStageCount; ++stage) {
     if ((stageMask >> stage) & 1) {
@@ -131,7 +223,7 @@ void GraphicsContext::doUserDataNodeMerge() {
   }
 
   // Sort and merge.
-  ArrayRef<ResourceMappingNode> mergedNodes = mergeUserDataNodeTable(allNodes);
+  mergedUserData->userDataNodes = mergeUserDataNodeTable(allNodes, *mergedUserData);
 
   // Collect descriptor range values (immutable descriptors) from all shader stages into one big table.
   SmallVector<DescriptorRangeValue, 8> allRangeValues;
@@ -152,61 +244,58 @@ void GraphicsContext::doUserDataNodeMerge() {
               return left.binding < right.binding;
             });
 
-  if (!allRangeValues.empty()) {
-    // Create a new table with merged duplicates.
-    m_allocDescriptorRangeValues = std::make_unique<SmallVector<DescriptorRangeValue, 8>>();
-    auto &mergedRangeValues = *m_allocDescriptorRangeValues;
-    ArrayRef<DescriptorRangeValue> rangeValues = allRangeValues;
-
-    while (!rangeValues.empty()) {
-      // Find the next block of duplicate rangeValues.
-      unsigned duplicateCount = 1;
-      for (; duplicateCount != rangeValues.size(); ++duplicateCount) {
-        if (rangeValues[0].set != rangeValues[duplicateCount].set ||
-            rangeValues[0].binding != rangeValues[duplicateCount].binding)
-          break;
-        assert(rangeValues[0].type == rangeValues[duplicateCount].type &&
-               "Descriptor range value merge conflict: type");
-        assert(rangeValues[0].arraySize == rangeValues[duplicateCount].arraySize &&
-               "Descriptor range value merge conflict: arraySize");
-        assert(memcmp(rangeValues[0].pValue, rangeValues[duplicateCount].pValue,
-                      rangeValues[0].arraySize * sizeof(unsigned)) == 0 &&
-               "Descriptor range value merge conflict: value");
-      }
+  // Create a new table with merged duplicates.
+  auto &mergedRangeValues = mergedUserData->descriptorRangeValues;
+  ArrayRef<DescriptorRangeValue> rangeValues = allRangeValues;
 
-      // Keep the merged range.
-      mergedRangeValues.push_back(rangeValues[0]);
-      rangeValues = rangeValues.slice(duplicateCount);
+  while (!rangeValues.empty()) {
+    // Find the next block of duplicate rangeValues.
+    unsigned duplicateCount = 1;
+    for (; duplicateCount != rangeValues.size(); ++duplicateCount) {
+      if (rangeValues[0].set != rangeValues[duplicateCount].set ||
+          rangeValues[0].binding != rangeValues[duplicateCount].binding)
+        break;
+      assert(rangeValues[0].type == rangeValues[duplicateCount].type && "Descriptor range value merge conflict: type");
+      assert(rangeValues[0].arraySize == rangeValues[duplicateCount].arraySize &&
+             "Descriptor range value merge conflict: arraySize");
+      assert(memcmp(rangeValues[0].pValue, rangeValues[duplicateCount].pValue,
+                    rangeValues[0].arraySize * sizeof(unsigned)) == 0 &&
+             "Descriptor range value merge conflict: value");
     }
+
+    // Keep the merged range.
+    mergedRangeValues.push_back(rangeValues[0]);
+    rangeValues = rangeValues.slice(duplicateCount);
   }
 
-  // Point each shader stage at the merged user data nodes and descriptor range values.
-  for (unsigned stage = 0; stage < ShaderStageNativeStageCount; ++stage) {
-    if ((stageMask >> stage) & 1) {
-      auto shaderInfo = const_cast<PipelineShaderInfo *>(getPipelineShaderInfo(ShaderStage(stage)));
-      shaderInfo->pUserDataNodes = mergedNodes.data();
-      shaderInfo->userDataNodeCount = mergedNodes.size();
-      if (m_allocDescriptorRangeValues) {
-        shaderInfo->pDescriptorRangeValues = m_allocDescriptorRangeValues->data();
-        shaderInfo->descriptorRangeValueCount = m_allocDescriptorRangeValues->size();
-      }
-    }
+  // Copy the static SRDs, as the merged user data may be used by later pipelines.
+  mergedUserData->allocValues.resize(mergedRangeValues.size());
+  for (unsigned i = 0; i != mergedRangeValues.size(); ++i) {
+    DescriptorRangeValue &rangeValue = mergedRangeValues[i];
+    auto &values = mergedUserData->allocValues[i];
+    values.assign(rangeValue.pValue,
+                  rangeValue.pValue + rangeValue.arraySize * getDescriptorRangeValueSize(rangeValue));
+    rangeValue.pValue = values.data();
   }
+
+  return mergedUserData;
 }
 
 // =====================================================================================================================
 // Merge user data nodes that have been collected into one big table
 //
 // @param allNodes : Table of nodes
-ArrayRef<ResourceMappingNode> GraphicsContext::mergeUserDataNodeTable(SmallVectorImpl<ResourceMappingNode> &allNodes) {
+// @param [in,out] mergedUserData : Merged user data that owns the new tables
+ArrayRef<ResourceMappingNode> GraphicsContext::mergeUserDataNodeTable(SmallVectorImpl<ResourceMappingNode> &allNodes,
+                                                                      MergedUserData &mergedUserData) {
   // Sort the nodes by offset, so we can spot duplicates.
   std::sort(allNodes.begin(), allNodes.end(), [](const ResourceMappingNode &left, const ResourceMappingNode &right) {
     return left.offsetInDwords < right.offsetInDwords;
   });
 
   // Merge duplicates.
-  m_allocUserDataNodes.push_back(std::make_unique<SmallVector<ResourceMappingNode, 8>>());
-  auto &mergedNodes = *m_allocUserDataNodes.back();
+  mergedUserData.allocUserDataNodes.push_back(std::make_unique<SmallVector<ResourceMappingNode, 8>>());
+  auto &mergedNodes = *mergedUserData.allocUserDataNodes.back();
   ArrayRef<ResourceMappingNode> nodes = allNodes;
 
   while (!nodes.empty()) {
@@ -228,9 +317,17 @@ ArrayRef<ResourceMappingNode> GraphicsContext::mergeUserDataNodeTable(SmallVecto
       }
     }
 
-    if (duplicatesCount == 1 || nodes[0].type != ResourceMappingNodeType::DescriptorTableVaPtr) {
+    if (nodes[0].type != ResourceMappingNodeType::DescriptorTableVaPtr) {
       // Keep the merged node.
       mergedNodes.push_back(nodes[0]);
+    } else if (duplicatesCount == 1) {
+      // Keep the node, with a copy of its inner table so the merged user data does not point at the build info.
+      ResourceMappingNode modifiedNode = nodes[0];
+      modifiedNode.tablePtr.pNext =
+          copyUserDataNodeTable(ArrayRef<ResourceMappingNode>(nodes[0].tablePtr.pNext, nodes[0].tablePtr.nodeCount),
+                                mergedUserData)
+              .data();
+      mergedNodes.push_back(modifiedNode);
     } else {
       // Merge the inner tables too. First collect nodes from all inner tables.
       SmallVector<ResourceMappingNode, 8> allInnerNodes;
@@ -242,7 +339,7 @@ ArrayRef<ResourceMappingNode> GraphicsContext::mergeUserDataNodeTable(SmallVecto
       }
 
       // Call recursively to sort and merge.
-      auto mergedInnerNodes = mergeUserDataNodeTable(allInnerNodes);
+      auto mergedInnerNodes = mergeUserDataNodeTable(allInnerNodes, mergedUserData);
 
       // Finished merging the inner tables. Keep the merged DescriptorTableVaPtr node.
       ResourceMappingNode modifiedNode = nodes[0];
@@ -256,4 +353,50 @@ ArrayRef<ResourceMappingNode> GraphicsContext::mergeUserDataNodeTable(SmallVecto
   return mergedNodes;
 }
 
+// =====================================================================================================================
+// Copy a table of user data nodes, including any inner tables, without merging it
+//
+// @param nodes : Table of nodes
+// @param [in,out] mergedUserData : Merged user data that owns the new tables
+ArrayRef<ResourceMappingNode> GraphicsContext::copyUserDataNodeTable(ArrayRef<ResourceMappingNode> nodes,
+                                                                     MergedUserData &mergedUserData) {
+  mergedUserData.allocUserDataNodes.push_back(
+      std::make_unique<SmallVector<ResourceMappingNode, 8>>(nodes.begin(), nodes.end()));
+  auto &copiedNodes = *mergedUserData.allocUserDataNodes.back();
+
+  for (ResourceMappingNode &node : copiedNodes) {
+    if (node.type == ResourceMappingNodeType::DescriptorTableVaPtr) {
+      node.tablePtr.pNext =
+          copyUserDataNodeTable(ArrayRef<ResourceMappingNode>(node.tablePtr.pNext, node.tablePtr.nodeCount),
+                                mergedUserData)
+              .data();
+    }
+  }
+  return copiedNodes;
+}
+
+// =====================================================================================================================
+// Looks up merged user data in the cache.
+//
+// @param key : Key of the per-stage user data nodes and descriptor range values
+std::shared_ptr<const MergedUserData> UserDataNodeMergeCache::lookUp(uint64_t key) {
+  std::lock_guard<sys::Mutex> lock(m_lock);
+  auto it = m_entries.find(key);
+  if (it == m_entries.end())
+    return nullptr;
+  return it->second;
+}
+
+// =====================================================================================================================
+// Adds merged user data to the cache.
+//
+// @param key : Key of the per-stage user data nodes and descriptor range values
+// @param mergedUserData : Merged user data
+void UserDataNodeMergeCache::insert(uint64_t key, std::shared_ptr<const MergedUserData> mergedUserData) {
+  std::lock_guard<sys::Mutex> lock(m_lock);
+  if (m_entries.size() >= MaxEntryCount)
+    m_entries.clear();
+  m_entries[key] = std::move(mergedUserData);
+}
+
 } // namespace Llpc
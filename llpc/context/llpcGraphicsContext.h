@@ -32,10 +32,43 @@
 
 #include "llpcPipelineContext.h"
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/Mutex.h"
+#include <memory>
+#include <vector>
 
 namespace Llpc {
 
+// =====================================================================================================================
+// Result of merging the user data nodes and descriptor range values of all shader stages of a graphics pipeline. It
+// owns every table it points to, so it can outlive the build info it was merged from.
+struct MergedUserData {
+  llvm::ArrayRef<ResourceMappingNode> userDataNodes;                // Merged root-level user data nodes
+  llvm::SmallVector<DescriptorRangeValue, 8> descriptorRangeValues; // Merged descriptor range values
+
+  llvm::SmallVector<std::unique_ptr<llvm::SmallVectorImpl<ResourceMappingNode>>, 4>
+      allocUserDataNodes;                          // Allocated root and inner user data node tables
+  std::vector<std::vector<unsigned>> allocValues; // Allocated static SRDs of the descriptor range values
+};
+
+// =====================================================================================================================
+// Cache of merged user data, shared by the graphics pipeline builds of one compiler. Pipelines created from the same
+// pipeline layout have the same per-stage inputs, so merging becomes a lookup for all but the first of them.
+class UserDataNodeMergeCache {
+public:
+  std::shared_ptr<const MergedUserData> lookUp(uint64_t key);
+  void insert(uint64_t key, std::shared_ptr<const MergedUserData> mergedUserData);
+
+private:
+  // Maximum number of entries; the cache is emptied when it is full. Contexts keep their own reference to the entry
+  // they use, so that is safe while builds are in flight.
+  static constexpr unsigned MaxEntryCount = 256;
+
+  llvm::sys::Mutex m_lock;                                                   // Lock for the entry map
+  llvm::DenseMap<uint64_t, std::shared_ptr<const MergedUserData>> m_entries; // Merged user data by input key
+};
+
 // =====================================================================================================================
 // Represents LLPC context for graphics pipeline compilation. Derived from the base class Llpc::Context.
 class GraphicsContext : public PipelineContext {
@@ -61,7 +94,7 @@ public:
   // Gets the count of active shader stages
   virtual unsigned getActiveShaderStageCount() const { return m_activeStageCount; }
 
-  virtual void doUserDataNodeMerge();
+  virtual void doUserDataNodeMerge(UserDataNodeMergeCache *mergeCache = nullptr);
 
   // Gets per pipeline options
   virtual const PipelineOptions *getPipelineOptions() const { return &m_pipelineInfo->options; }
@@ -71,7 +104,12 @@ private:
   GraphicsContext(const GraphicsContext &) = delete;
   GraphicsContext &operator=(const GraphicsContext &) = delete;
 
-  llvm::ArrayRef<ResourceMappingNode> mergeUserDataNodeTable(llvm::SmallVectorImpl<ResourceMappingNode> &allNodes);
+  uint64_t getUserDataNodeMergeKey(unsigned stageMask) const;
+  std::shared_ptr<const MergedUserData> mergeUserData(unsigned stageMask) const;
+  static llvm::ArrayRef<ResourceMappingNode>
+  mergeUserDataNodeTable(llvm::SmallVectorImpl<ResourceMappingNode> &allNodes, MergedUserData &mergedUserData);
+  static llvm::ArrayRef<ResourceMappingNode> copyUserDataNodeTable(llvm::ArrayRef<ResourceMappingNode> nodes,
+                                                                   MergedUserData &mergedUserData);
 
   void buildNggCullingControlRegister();
 
@@ -82,10 +120,7 @@ private:
 
   bool m_gsOnChip; // Whether to enable GS on-chip mode
 
-  llvm::SmallVector<std::unique_ptr<llvm::SmallVectorImpl<ResourceMappingNode>>, 4>
-      m_allocUserDataNodes; // Allocated merged user data nodes
-  std::unique_ptr<llvm::SmallVectorImpl<DescriptorRangeValue>>
-      m_allocDescriptorRangeValues; // Allocated merged descriptor range values
+  std::shared_ptr<const MergedUserData> m_mergedUserData; // Merged user data the shader stages point at
 };
 
 } // namespace Llpc
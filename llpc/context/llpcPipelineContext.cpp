@@ -36,6 +36,7 @@
 #include "lgc/Pipeline.h"
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/Module.h"
+#include "llvm/Support/CodeGen.h"
 #include "llvm/Support/CommandLine.h"
 
 #define DEBUG_TYPE "llpc-pipeline-context"
@@ -45,6 +46,7 @@ namespace llvm {
 namespace cl {
 
 extern opt<bool> EnablePipelineDump;
+extern opt<bool> EnablePerStageCache;
 
 } // namespace cl
 
@@ -86,6 +88,18 @@ static cl::opt<bool> EnableSiScheduler("enable-si-scheduler", cl::desc("Enable t
 // -subgroup-size: sub-group size exposed via Vulkan API.
 static cl::opt<int> SubgroupSize("subgroup-size", cl::desc("Sub-group size exposed via Vulkan API"), cl::init(64));
 
+// -codegen-opt-level: codegen optimization level (0 = none, 1 = less, 2 = default, 3 = aggressive)
+static cl::opt<unsigned> OptLevel("codegen-opt-level", cl::desc("Codegen optimization level (0-3)"),
+                                  cl::init(CodeGenOpt::Default));
+
+// -spirv-debug-info: debug info translated from SPIR-V debug instructions
+static cl::opt<SPIRV::SPIRVDebugInfoLevel> SpirvDebugInfo(
+    "spirv-debug-info", cl::desc("Debug info translated from SPIR-V debug instructions"),
+    cl::init(SPIRV::SPIRVDebugInfoLevel::Full),
+    cl::values(clEnumValN(SPIRV::SPIRVDebugInfoLevel::None, "none", "No debug info"),
+               clEnumValN(SPIRV::SPIRVDebugInfoLevel::LineTablesOnly, "line-tables", "Source locations only"),
+               clEnumValN(SPIRV::SPIRVDebugInfoLevel::Full, "full", "Full debug info")));
+
 // -enable-shadow-desc: enable shadow descriptor table
 static cl::opt<bool> EnableShadowDescriptorTable("enable-shadow-desc", cl::desc("Enable shadow descriptor table"));
 
@@ -215,7 +229,7 @@ void PipelineContext::setPipelineState(Pipeline *pipeline, bool unlinked) const
     setVertexInputDescriptions(pipeline);
 
     // Give the color export state to the middle-end.
-    setColorExportState(pipeline);
+    setColorExportState(pipeline, unlinked);
 
     // Give the graphics pipeline state to the middle-end.
     setGraphicsStateInPipeline(pipeline);
@@ -223,11 +237,31 @@ void PipelineContext::setPipelineState(Pipeline *pipeline, bool unlinked) const
     pipeline->setDeviceIndex(static_cast<const ComputePipelineBuildInfo *>(getPipelineBuildInfo())->deviceIndex);
 }
 
+// =====================================================================================================================
+// Read the options that only affect generated code from the current command-line option values. A compiler captures
+// these when it is created, as the command-line options may be re-applied for a later compiler with other values.
+CompilerOptions PipelineContext::readCompilerOptions() {
+  CompilerOptions compilerOptions = {};
+  compilerOptions.optLevel = std::min(unsigned(OptLevel), unsigned(CodeGenOpt::Aggressive));
+  compilerOptions.vgprLimit = VgprLimit;
+  compilerOptions.sgprLimit = SgprLimit;
+  compilerOptions.wavesPerEu = WavesPerEu;
+  compilerOptions.enableScalarLoad = EnableScalarLoad;
+  compilerOptions.scalarThreshold = ScalarThreshold;
+  compilerOptions.enableSiScheduler = EnableSiScheduler;
+  compilerOptions.subgroupSize = SubgroupSize;
+  compilerOptions.debugInfoLevel = static_cast<unsigned>(SpirvDebugInfo.getValue());
+  return compilerOptions;
+}
+
 // =====================================================================================================================
 // Give the pipeline options to the middle-end.
 //
 // @param [in/out] pipeline : Middle-end pipeline object
 void PipelineContext::setOptionsInPipeline(Pipeline *pipeline) const {
+  assert(m_compilerOptions && "Compiler options must be set before the pipeline state");
+  const CompilerOptions &compilerOptions = *m_compilerOptions;
+
   Options options = {};
   options.hash[0] = getPiplineHashCode();
   options.hash[1] = getCacheHashCode();
@@ -275,7 +309,8 @@ void PipelineContext::setOptionsInPipeline(Pipeline *pipeline) const {
                          (nggState.enableBoxFilterCulling ? NggFlagEnableBoxFilterCulling : 0) |
                          (nggState.enableSphereCulling ? NggFlagEnableSphereCulling : 0) |
                          (nggState.enableSmallPrimFilter ? NggFlagEnableSmallPrimFilter : 0) |
-                         (nggState.enableCullDistanceCulling ? NggFlagEnableCullDistanceCulling : 0);
+                         (nggState.enableCullDistanceCulling ? NggFlagEnableCullDistanceCulling : 0) |
+                         (nggState.enableAutoCulling ? NggFlagEnableAutoCulling : 0);
       options.nggBackfaceExponent = nggState.backfaceExponent;
 
       // Use a static cast from Vkgc NggSubgroupSizingType to LGC NggSubgroupSizing, and static assert that
@@ -302,6 +337,10 @@ void PipelineContext::setOptionsInPipeline(Pipeline *pipeline) const {
   }
 
   options.allowNullDescriptor = getPipelineOptions()->extendedRobustness.nullDescriptor;
+  options.fastCompile = getPipelineOptions()->fastCompile;
+  options.robustBufferAccess = getPipelineOptions()->extendedRobustness.robustBufferAccess;
+  options.optLevel = compilerOptions.optLevel + 1;
+  options.separateStageCache = isGraphics() && cl::EnablePerStageCache;
   pipeline->setOptions(options);
 
   // Give the shader options (including the hash) to the middle-end.
@@ -328,24 +367,24 @@ void PipelineContext::setOptionsInPipeline(Pipeline *pipeline) const {
       if (shaderInfo->options.vgprLimit != 0 && shaderInfo->options.vgprLimit != UINT_MAX)
         shaderOptions.vgprLimit = shaderInfo->options.vgprLimit;
       else
-        shaderOptions.vgprLimit = VgprLimit;
+        shaderOptions.vgprLimit = compilerOptions.vgprLimit;
 
       if (shaderInfo->options.sgprLimit != 0 && shaderInfo->options.sgprLimit != UINT_MAX)
         shaderOptions.sgprLimit = shaderInfo->options.sgprLimit;
       else
-        shaderOptions.sgprLimit = SgprLimit;
+        shaderOptions.sgprLimit = compilerOptions.sgprLimit;
 
       if (shaderInfo->options.maxThreadGroupsPerComputeUnit != 0)
         shaderOptions.maxThreadGroupsPerComputeUnit = shaderInfo->options.maxThreadGroupsPerComputeUnit;
       else
-        shaderOptions.maxThreadGroupsPerComputeUnit = WavesPerEu;
+        shaderOptions.maxThreadGroupsPerComputeUnit = compilerOptions.wavesPerEu;
 
       shaderOptions.waveSize = shaderInfo->options.waveSize;
       shaderOptions.wgpMode = shaderInfo->options.wgpMode;
       if (!shaderInfo->options.allowVaryWaveSize) {
         // allowVaryWaveSize is disabled, so use -subgroup-size (default 64) to override the wave
         // size for a shader that uses gl_SubgroupSize.
-        shaderOptions.subgroupSize = SubgroupSize;
+        shaderOptions.subgroupSize = compilerOptions.subgroupSize;
       }
 
       // Use a static cast from Vkgc WaveBreakSize to LGC WaveBreak, and static assert that
@@ -358,8 +397,8 @@ void PipelineContext::setOptionsInPipeline(Pipeline *pipeline) const {
       shaderOptions.waveBreakSize = static_cast<WaveBreak>(shaderInfo->options.waveBreakSize);
 
       shaderOptions.loadScalarizerThreshold = 0;
-      if (EnableScalarLoad)
-        shaderOptions.loadScalarizerThreshold = ScalarThreshold;
+      if (compilerOptions.enableScalarLoad)
+        shaderOptions.loadScalarizerThreshold = compilerOptions.scalarThreshold;
 #if LLPC_CLIENT_INTERFACE_MAJOR_VERSION >= 33
       if (shaderInfo->options.enableLoadScalarizer) {
         if (shaderInfo->options.scalarThreshold != 0)
@@ -369,10 +408,35 @@ void PipelineContext::setOptionsInPipeline(Pipeline *pipeline) const {
       }
 #endif
 
-      shaderOptions.useSiScheduler = EnableSiScheduler || shaderInfo->options.useSiScheduler;
+      shaderOptions.useSiScheduler = compilerOptions.enableSiScheduler || shaderInfo->options.useSiScheduler;
       shaderOptions.updateDescInElf = shaderInfo->options.updateDescInElf;
       shaderOptions.unrollThreshold = shaderInfo->options.unrollThreshold;
 
+      static_assert(static_cast<lgc::TranscendentalPrecision>(Vkgc::TranscendentalPrecision::Accurate) ==
+                        lgc::TranscendentalPrecision::Accurate,
+                    "mismatch");
+      static_assert(static_cast<lgc::TranscendentalPrecision>(Vkgc::TranscendentalPrecision::Relaxed) ==
+                        lgc::TranscendentalPrecision::Relaxed,
+                    "mismatch");
+      static_assert(static_cast<lgc::TranscendentalPrecision>(Vkgc::TranscendentalPrecision::Fast) ==
+                        lgc::TranscendentalPrecision::Fast,
+                    "mismatch");
+      shaderOptions.transcendentalPrecision =
+          static_cast<lgc::TranscendentalPrecision>(shaderInfo->options.transcendentalPrecision);
+
+      static_assert(static_cast<lgc::WorkgroupSwizzle>(Vkgc::WorkgroupSwizzle::Default) ==
+                        lgc::WorkgroupSwizzle::Default,
+                    "mismatch");
+      static_assert(static_cast<lgc::WorkgroupSwizzle>(Vkgc::WorkgroupSwizzle::Auto) == lgc::WorkgroupSwizzle::Auto,
+                    "mismatch");
+      static_assert(static_cast<lgc::WorkgroupSwizzle>(Vkgc::WorkgroupSwizzle::Enable) ==
+                        lgc::WorkgroupSwizzle::Enable,
+                    "mismatch");
+      static_assert(static_cast<lgc::WorkgroupSwizzle>(Vkgc::WorkgroupSwizzle::Disable) ==
+                        lgc::WorkgroupSwizzle::Disable,
+                    "mismatch");
+      shaderOptions.workgroupSwizzle = static_cast<lgc::WorkgroupSwizzle>(shaderInfo->options.workgroupSwizzle);
+
       pipeline->setShaderOptions(getLgcShaderStage(static_cast<ShaderStage>(stage)), shaderOptions);
     }
   }
@@ -399,6 +463,23 @@ void PipelineContext::setUserDataInPipeline(Pipeline *pipeline) const {
   for (auto &rangeValue : descriptorRangeValues)
     immutableNodesMap[{rangeValue.set, rangeValue.binding}] = &rangeValue;
 
+  // Create a map of image format hints. Unlike the user data nodes, the hints are not merged between shader
+  // stages, so collect them from every active stage. Stages that disagree about a binding leave it unknown.
+  FormatHintsMap formatHintsMap;
+  for (unsigned stage = 0; stage < ShaderStageCount; ++stage) {
+    if (!((stageMask >> stage) & 1))
+      continue;
+    const PipelineShaderInfo *stageShaderInfo = getPipelineShaderInfo(ShaderStage(stage));
+    if (!stageShaderInfo)
+      continue;
+    for (const auto &formatHint : ArrayRef<Vkgc::DescriptorFormatHint>(stageShaderInfo->pFormatHints,
+                                                                        stageShaderInfo->formatHintCount)) {
+      auto inserted = formatHintsMap.insert({{formatHint.set, formatHint.binding}, formatHint.hint});
+      if (!inserted.second && inserted.first->second != formatHint.hint)
+        inserted.first->second = Vkgc::ImageFormatHint::Unknown;
+    }
+  }
+
   // Count how many user data nodes we have, and allocate the buffer.
   unsigned nodeCount = nodes.size();
   for (auto &node : nodes) {
@@ -411,11 +492,12 @@ void PipelineContext::setUserDataInPipeline(Pipeline *pipeline) const {
   ResourceNode *destTable = allocUserDataNodes.get();
   ResourceNode *destInnerTable = destTable + nodeCount;
   auto userDataNodes = ArrayRef<ResourceNode>(destTable, nodes.size());
-  setUserDataNodesTable(pipeline->getContext(), nodes, immutableNodesMap, /*isRoot=*/true, destTable, destInnerTable);
+  setUserDataNodesTable(pipeline->getContext(), nodes, immutableNodesMap, formatHintsMap, /*isRoot=*/true, destTable,
+                        destInnerTable);
   assert(destInnerTable == destTable + nodes.size());
 
-  // Give the table to the LGC Pipeline interface.
-  pipeline->setUserDataNodes(userDataNodes);
+  // Give the table to the LGC Pipeline interface, handing over the buffer so it does not get copied again.
+  pipeline->setUserDataNodes(std::move(allocUserDataNodes), userDataNodes);
 }
 
 // =====================================================================================================================
@@ -425,12 +507,14 @@ void PipelineContext::setUserDataInPipeline(Pipeline *pipeline) const {
 // @param context : LLVM context
 // @param nodes : The resource mapping nodes
 // @param immutableNodesMap : Map of immutable nodes
+// @param formatHintsMap : Map of image format hints
 // @param isRoot : Whether this is the root table
 // @param [out] destTable : Where to write nodes
 // @param [in/out] destInnerTable : End of space available for inner tables
 void PipelineContext::setUserDataNodesTable(LLVMContext &context, ArrayRef<ResourceMappingNode> nodes,
-                                            const ImmutableNodesMap &immutableNodesMap, bool isRoot,
-                                            ResourceNode *destTable, ResourceNode *&destInnerTable) const {
+                                            const ImmutableNodesMap &immutableNodesMap,
+                                            const FormatHintsMap &formatHintsMap, bool isRoot, ResourceNode *destTable,
+                                            ResourceNode *&destInnerTable) const {
   for (unsigned idx = 0; idx != nodes.size(); ++idx) {
     auto &node = nodes[idx];
     auto &destNode = destTable[idx];
@@ -445,7 +529,7 @@ void PipelineContext::setUserDataNodesTable(LLVMContext &context, ArrayRef<Resou
       destInnerTable -= node.tablePtr.nodeCount;
       destNode.innerTable = ArrayRef<ResourceNode>(destInnerTable, node.tablePtr.nodeCount);
       setUserDataNodesTable(context, ArrayRef<ResourceMappingNode>(node.tablePtr.pNext, node.tablePtr.nodeCount),
-                            immutableNodesMap, /*isRoot=*/false, destInnerTable, destInnerTable);
+                            immutableNodesMap, formatHintsMap, /*isRoot=*/false, destInnerTable, destInnerTable);
       break;
     }
     case ResourceMappingNodeType::IndirectUserDataVaPtr: {
@@ -487,8 +571,10 @@ void PipelineContext::setUserDataNodesTable(LLVMContext &context, ArrayRef<Resou
       static_assert(ResourceNodeType::DescriptorBufferCompact ==
                         static_cast<ResourceNodeType>(ResourceMappingNodeType::DescriptorBufferCompact),
                     "mismatch");
-      // A "PushConst" is in fact an InlineBuffer when it appears in a non-root table.
-      if (node.type == ResourceMappingNodeType::PushConst && !isRoot)
+      // A "PushConst" is in fact an InlineBuffer when it appears in a non-root table. An explicit InlineBuffer can
+      // be in any table.
+      if ((node.type == ResourceMappingNodeType::PushConst && !isRoot) ||
+          node.type == ResourceMappingNodeType::InlineBuffer)
         destNode.type = ResourceNodeType::InlineBuffer;
       else if (node.type == ResourceMappingNodeType::DescriptorYCbCrSampler)
         destNode.type = ResourceNodeType::DescriptorYCbCrSampler;
@@ -498,6 +584,11 @@ void PipelineContext::setUserDataNodesTable(LLVMContext &context, ArrayRef<Resou
       destNode.set = node.srdRange.set;
       destNode.binding = node.srdRange.binding;
       destNode.immutableValue = nullptr;
+      destNode.formatHint = lgc::ImageFormatHint::Unknown;
+
+      auto hintIt = formatHintsMap.find({destNode.set, destNode.binding});
+      if (hintIt != formatHintsMap.end())
+        destNode.formatHint = static_cast<lgc::ImageFormatHint>(hintIt->second);
 
       auto it = immutableNodesMap.find(std::pair<unsigned, unsigned>(destNode.set, destNode.binding));
       if (it != immutableNodesMap.end()) {
@@ -642,7 +733,9 @@ void PipelineContext::setVertexInputDescriptions(Pipeline *pipeline) const {
 // Set color export state in middle-end Pipeline object
 //
 // @param pipeline : Pipeline object
-void PipelineContext::setColorExportState(Pipeline *pipeline) const {
+// @param unlinked : Leave out the color export formats, so the color exports are done by a color export shader
+//                   glued on in the link
+void PipelineContext::setColorExportState(Pipeline *pipeline, bool unlinked) const {
   const auto &cbState = static_cast<const GraphicsPipelineBuildInfo *>(getPipelineBuildInfo())->cbState;
   ColorExportState state = {};
   SmallVector<ColorExportFormat, MaxColorTargets> formats;
@@ -650,7 +743,7 @@ void PipelineContext::setColorExportState(Pipeline *pipeline) const {
   state.alphaToCoverageEnable = cbState.alphaToCoverageEnable;
   state.dualSourceBlendEnable = cbState.dualSourceBlendEnable;
 
-  for (unsigned targetIndex = 0; targetIndex < MaxColorTargets; ++targetIndex) {
+  for (unsigned targetIndex = 0; targetIndex < MaxColorTargets && !unlinked; ++targetIndex) {
     if (cbState.target[targetIndex].format != VK_FORMAT_UNDEFINED) {
       auto dfmt = BufDataFormatInvalid;
       auto nfmt = BufNumFormatUnorm;
@@ -660,6 +753,7 @@ void PipelineContext::setColorExportState(Pipeline *pipeline) const {
       formats[targetIndex].nfmt = nfmt;
       formats[targetIndex].blendEnable = cbState.target[targetIndex].blendEnable;
       formats[targetIndex].blendSrcAlphaToColor = cbState.target[targetIndex].blendSrcAlphaToColor;
+      formats[targetIndex].channelWriteMask = cbState.target[targetIndex].channelWriteMask;
     }
   }
 
@@ -41,6 +41,12 @@
 #include <unordered_map>
 #include <unordered_set>
 
+namespace llvm {
+
+class OptPassGate;
+
+} // namespace llvm
+
 namespace lgc {
 
 class Pipeline;
@@ -113,8 +119,8 @@ public:
   // Gets the count of active shader stages
   virtual unsigned getActiveShaderStageCount() const = 0;
 
-  // Does user data node merge for merged shader
-  virtual void doUserDataNodeMerge() = 0;
+  // Does user data node merge for merged shader, looking the result up in the given cache if there is one
+  virtual void doUserDataNodeMerge(UserDataNodeMergeCache *mergeCache = nullptr) = 0;
 
   static void getGpuNameString(GfxIpVersion gfxIp, std::string &gpuName);
   static const char *getGpuNameAbbreviation(GfxIpVersion gfxIp);
@@ -141,12 +147,42 @@ public:
   // VkFormat is not supported.
   static std::pair<lgc::BufDataFormat, lgc::BufNumFormat> mapVkFormat(VkFormat format, bool isColorExport);
 
+  // Read the options that only affect generated code from the current command-line option values
+  static CompilerOptions readCompilerOptions();
+
+  // Set the options of the compiler building this pipeline
+  void setCompilerOptions(const CompilerOptions *compilerOptions) { m_compilerOptions = compilerOptions; }
+
+  // Get the options of the compiler building this pipeline
+  const CompilerOptions &getCompilerOptions() const {
+    assert(m_compilerOptions && "Compiler options must be set before building the pipeline");
+    return *m_compilerOptions;
+  }
+
   // Set whether we are building a relocatable (unlinked) ElF
   void setUnlinked(bool unlinked) { m_unlinked = unlinked; }
 
   // Get whether we are building a relocatable (unlinked) ElF
   bool isUnlinked() const { return m_unlinked; }
 
+  // Set the build stats to collect for this pipeline (nullptr if not collecting)
+  void setBuildStats(PipelineBuildStats *buildStats) { m_buildStats = buildStats; }
+
+  // Get the build stats to collect for this pipeline, or nullptr if not collecting
+  PipelineBuildStats *getBuildStats() const { return m_buildStats; }
+
+  // Set the pass gate that enforces the compile-time budget of this build (nullptr if none)
+  void setCompileBudgetGate(llvm::OptPassGate *gate) { m_compileBudgetGate = gate; }
+
+  // Get the pass gate that enforces the compile-time budget of this build, or nullptr if none
+  llvm::OptPassGate *getCompileBudgetGate() const { return m_compileBudgetGate; }
+
+  // Record that this build ran out of its compile-time budget
+  void setCompileBudgetExceeded() { m_compileBudgetExceeded = true; }
+
+  // Get whether this build ran out of its compile-time budget
+  bool isCompileBudgetExceeded() const { return m_compileBudgetExceeded; }
+
 protected:
   // Gets dummy vertex input create info
   virtual VkPipelineVertexInputStateCreateInfo *getDummyVertexInputInfo() { return nullptr; }
@@ -168,6 +204,8 @@ private:
 
   // Type of immutable nodes map used in SetUserDataNodesTable
   typedef std::map<std::pair<unsigned, unsigned>, const DescriptorRangeValue *> ImmutableNodesMap;
+  // Type of image format hints map used in SetUserDataNodesTable
+  typedef std::map<std::pair<unsigned, unsigned>, Vkgc::ImageFormatHint> FormatHintsMap;
 
   // Give the pipeline options to the middle-end.
   void setOptionsInPipeline(lgc::Pipeline *pipeline) const;
@@ -175,8 +213,8 @@ private:
   // Give the user data nodes and descriptor range values to the middle-end.
   void setUserDataInPipeline(lgc::Pipeline *pipeline) const;
   void setUserDataNodesTable(llvm::LLVMContext &context, llvm::ArrayRef<ResourceMappingNode> nodes,
-                             const ImmutableNodesMap &immutableNodesMap, bool isRoot, lgc::ResourceNode *destTable,
-                             lgc::ResourceNode *&destInnerTable) const;
+                             const ImmutableNodesMap &immutableNodesMap, const FormatHintsMap &formatHintsMap,
+                             bool isRoot, lgc::ResourceNode *destTable, lgc::ResourceNode *&destInnerTable) const;
 
   // Give the graphics pipeline state to the middle-end.
   void setGraphicsStateInPipeline(lgc::Pipeline *pipeline) const;
@@ -185,10 +223,14 @@ private:
   void setVertexInputDescriptions(lgc::Pipeline *pipeline) const;
 
   // Give the color export state to the middle-end.
-  void setColorExportState(lgc::Pipeline *pipeline) const;
+  void setColorExportState(lgc::Pipeline *pipeline, bool unlinked) const;
 
   ShaderFpMode m_shaderFpModes[ShaderStageCountInternal] = {};
-  bool m_unlinked = false; // Whether we are building an "unlinked" half-pipeline ELF
+  bool m_unlinked = false;                           // Whether we are building an "unlinked" half-pipeline ELF
+  PipelineBuildStats *m_buildStats = nullptr;        // Build stats to collect for this pipeline
+  llvm::OptPassGate *m_compileBudgetGate = nullptr;  // Pass gate enforcing the compile-time budget of this build
+  bool m_compileBudgetExceeded = false;              // Whether this build ran out of its compile-time budget
+  const CompilerOptions *m_compilerOptions = nullptr; // Options of the compiler building this pipeline
 };
 
 } // namespace Llpc
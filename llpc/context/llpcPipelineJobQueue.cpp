@@ -0,0 +1,279 @@
+/*
+ ***********************************************************************************************************************
+ *
+ *  Copyright (c) 2020 Advanced Micro Devices, Inc. All Rights Reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ **********************************************************************************************************************/
+/**
+ ***********************************************************************************************************************
+ @file llpcPipelineJobQueue.cpp
+ @brief LLPC source file: contains implementation of classes Llpc::PipelineJob and Llpc::PipelineJobQueue.
+ ***********************************************************************************************************************
+ */
+#include "llpcPipelineJobQueue.h"
+#include <algorithm>
+#include <chrono>
+
+#define DEBUG_TYPE "llpc-pipeline-job-queue"
+
+namespace Llpc {
+
+// Priority of the job running on the current thread. Threads that are not running a job are building pipelines
+// synchronously, which is on demand.
+static thread_local PipelineJobPriority CurrentPriority = PipelineJobPriority::OnDemand;
+
+// Count of threads waiting for a compile that a less urgent job is running. While it is not zero, no worker of any
+// queue starts a prefetch job.
+static std::atomic<unsigned> BoostCount{0};
+
+// Interval at which workers that only have prefetch jobs queued check whether a boost has ended
+static constexpr std::chrono::milliseconds BoostPollInterval(10);
+
+// Count of times a job that does not fit in the memory budget lets a smaller job start ahead of it. After that, no
+// other job of its queue is started until it has started, so that a stream of small jobs cannot starve it.
+static constexpr unsigned MaxBudgetBypassCount = 16;
+
+// =====================================================================================================================
+// Runs the build of the job, unless the job has been cancelled.
+void PipelineJob::run() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_state != State::Queued)
+      return;
+    m_state = State::Running;
+  }
+  CurrentPriority = m_priority;
+  Result result = m_build();
+  CurrentPriority = PipelineJobPriority::OnDemand;
+  finish(result);
+}
+
+// =====================================================================================================================
+// Cancels the job if it has not started yet. Returns true if it was cancelled.
+bool PipelineJob::cancel() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_state != State::Queued)
+      return false;
+    m_state = State::Running;
+  }
+  finish(Result::ErrorUnavailable);
+  return true;
+}
+
+// =====================================================================================================================
+// Waits for the job to finish, and returns the result of its build.
+Result PipelineJob::wait() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_condition.wait(lock, [this] { return m_state == State::Done; });
+  return m_result;
+}
+
+// =====================================================================================================================
+// Calls the client callback of the job, and then wakes the threads that wait for it, so that a wait returns only after
+// the callback has run.
+//
+// @param result : Result of the build
+void PipelineJob::finish(Result result) {
+  if (m_doneCallback)
+    m_doneCallback(m_callbackData, result);
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_result = result;
+    m_state = State::Done;
+  }
+  m_condition.notify_all();
+}
+
+// =====================================================================================================================
+// Starts the worker threads.
+//
+// @param threadCount : Count of worker threads
+// @param memBudget : Memory budget of the running jobs in bytes, or 0 for none
+PipelineJobQueue::PipelineJobQueue(unsigned threadCount, uint64_t memBudget) : m_memBudget(memBudget) {
+  for (unsigned i = 0; i < threadCount; ++i)
+    m_workers.emplace_back([this] { runWorker(); });
+}
+
+// =====================================================================================================================
+// Waits for the running jobs, and cancels the queued ones.
+PipelineJobQueue::~PipelineJobQueue() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_shutdown = true;
+  }
+  m_condition.notify_all();
+  for (std::thread &worker : m_workers)
+    worker.join();
+
+  for (auto &queue : m_queues) {
+    for (PipelineJob *job : queue) {
+      job->cancel();
+      job->release();
+    }
+  }
+}
+
+// =====================================================================================================================
+// Queues a job. The queue holds a reference to the job until it has run. Less urgent queued jobs for the same pipeline
+// are promoted to the priority of the job, ahead of it, so that the pipeline is compiled once and as early as the job
+// needs it.
+//
+// @param job : Job to queue
+void PipelineJobQueue::enqueue(PipelineJob *job) {
+  job->retain();
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto &queue = m_queues[static_cast<unsigned>(job->getPriority())];
+    for (unsigned lessUrgent = static_cast<unsigned>(job->getPriority()) + 1;
+         lessUrgent < static_cast<unsigned>(PipelineJobPriority::Count); ++lessUrgent) {
+      auto &lessUrgentQueue = m_queues[lessUrgent];
+      for (auto it = lessUrgentQueue.begin(); it != lessUrgentQueue.end();) {
+        PipelineJob *duplicate = *it;
+        if (duplicate->getKey() != job->getKey()) {
+          ++it;
+          continue;
+        }
+        duplicate->m_priority = job->getPriority();
+        queue.push_back(duplicate);
+        it = lessUrgentQueue.erase(it);
+        ++m_promotionCount;
+      }
+    }
+    queue.push_back(job);
+  }
+  m_condition.notify_one();
+}
+
+// =====================================================================================================================
+// Gets the priority of the job running on the current thread, or on-demand if the thread is not running a job.
+PipelineJobPriority PipelineJobQueue::getCurrentPriority() {
+  return CurrentPriority;
+}
+
+// =====================================================================================================================
+// Starts a boost: the current thread waits for a compile that a less urgent job is running, so prefetch jobs are not
+// started until the boost ends.
+void PipelineJobQueue::beginBoost() {
+  ++BoostCount;
+}
+
+// =====================================================================================================================
+// Ends a boost started by beginBoost.
+void PipelineJobQueue::endBoost() {
+  --BoostCount;
+}
+
+// =====================================================================================================================
+// Main loop of a worker thread.
+void PipelineJobQueue::runWorker() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (PipelineJob *job = takeJob(lock)) {
+    uint64_t memEstimate = job->getMemEstimate();
+    lock.unlock();
+    job->run();
+    job->release();
+    lock.lock();
+    m_memInUse -= memEstimate;
+    // Memory has been freed, so jobs that did not fit in the budget might fit now.
+    if (m_memBudget != 0)
+      m_condition.notify_all();
+  }
+}
+
+// =====================================================================================================================
+// Finds the first job of a queue whose estimated peak memory fits in what the running jobs leave of the memory budget.
+// A job always fits if no job is running. Returns the end of the queue if no job can be started now. The queue mutex
+// is held.
+//
+// @param [in/out] queue : Queue to search
+std::deque<PipelineJob *>::iterator PipelineJobQueue::findJobInBudget(std::deque<PipelineJob *> &queue) {
+  auto fits = [this](const PipelineJob *job) {
+    return m_memBudget == 0 || m_memInUse == 0 || m_memInUse + job->getMemEstimate() <= m_memBudget;
+  };
+  if (fits(queue.front()))
+    return queue.begin();
+
+  // The front job does not fit. Let a smaller job go ahead of it, unless it has been passed over too often.
+  PipelineJob *frontJob = queue.front();
+  if (frontJob->m_bypassCount >= MaxBudgetBypassCount)
+    return queue.end();
+  auto it = std::find_if(std::next(queue.begin()), queue.end(), fits);
+  if (it != queue.end())
+    ++frontJob->m_bypassCount;
+  return it;
+}
+
+// =====================================================================================================================
+// Takes the next job to run off the queues, waiting for one to be queued if there is none. Returns null when the queue
+// is being destroyed. The queue mutex is held on entry and on return.
+//
+// @param [in/out] lock : Lock of the queue mutex
+PipelineJob *PipelineJobQueue::takeJob(std::unique_lock<std::mutex> &lock) {
+  auto isNotEmpty = [](const std::deque<PipelineJob *> &queue) { return !queue.empty(); };
+  while (!m_shutdown) {
+    auto queueIt = std::find_if(std::begin(m_queues), std::end(m_queues), isNotEmpty);
+    if (queueIt == std::end(m_queues)) {
+      m_condition.wait(lock);
+      continue;
+    }
+    auto priority = static_cast<PipelineJobPriority>(queueIt - std::begin(m_queues));
+    if (priority >= PipelineJobPriority::Prefetch && BoostCount != 0) {
+      m_condition.wait_for(lock, BoostPollInterval);
+      continue;
+    }
+
+    auto jobIt = findJobInBudget(*queueIt);
+    if (jobIt == queueIt->end()) {
+      // Nothing fits in the memory budget; wait for a running job to finish.
+      m_condition.wait(lock);
+      continue;
+    }
+    PipelineJob *job = *jobIt;
+    queueIt->erase(jobIt);
+
+    // Only probe the caches if another job could run instead. A job that was put back is started anyway if no job
+    // has been started since, so that the workers do not spin on jobs that all wait for other threads; it then waits
+    // for the other compile in its build.
+    bool otherJobQueued = std::any_of(std::begin(m_queues), std::end(m_queues), isNotEmpty);
+    if (otherJobQueued && job->m_deferredAt != m_startCount + 1) {
+      lock.unlock();
+      bool waiting = job->isWaiting();
+      lock.lock();
+      if (m_shutdown) {
+        queueIt->push_front(job);
+        break;
+      }
+      if (waiting) {
+        job->m_deferredAt = m_startCount + 1;
+        queueIt->push_back(job);
+        continue;
+      }
+    }
+
+    ++m_startCount;
+    m_memInUse += job->getMemEstimate();
+    return job;
+  }
+  return nullptr;
+}
+
+} // namespace Llpc
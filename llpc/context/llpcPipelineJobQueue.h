@@ -0,0 +1,145 @@
+/*
+ ***********************************************************************************************************************
+ *
+ *  Copyright (c) 2020 Advanced Micro Devices, Inc. All Rights Reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ **********************************************************************************************************************/
+/**
+ ***********************************************************************************************************************
+ @file llpcPipelineJobQueue.h
+ @brief LLPC header file: contains declaration of classes Llpc::PipelineJob and Llpc::PipelineJobQueue.
+ ***********************************************************************************************************************
+ */
+#pragma once
+
+#include "llpc.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Llpc {
+
+// =====================================================================================================================
+// Represents an asynchronous pipeline build. A job is reference counted: the client's handle holds one reference, and
+// the job queue holds another while the job is queued or running.
+class PipelineJob {
+public:
+  PipelineJob(std::function<Result()> build, std::function<bool()> isWaiting, uint64_t key,
+              PipelineJobPriority priority, uint64_t memEstimate, PipelineJobCallback doneCallback,
+              void *callbackData)
+      : m_build(std::move(build)), m_isWaiting(std::move(isWaiting)), m_key(key), m_priority(priority),
+        m_memEstimate(memEstimate), m_doneCallback(doneCallback), m_callbackData(callbackData) {}
+
+  PipelineJobPriority getPriority() const { return m_priority; }
+  uint64_t getKey() const { return m_key; }
+  uint64_t getMemEstimate() const { return m_memEstimate; }
+
+  // Returns whether the job would have to wait for another thread's compile if it was started now
+  bool isWaiting() const { return m_isWaiting && m_isWaiting(); }
+
+  void run();
+  bool cancel();
+  Result wait();
+
+  void retain() { ++m_refCount; }
+  void release() {
+    if (--m_refCount == 0)
+      delete this;
+  }
+
+private:
+  friend class PipelineJobQueue;
+
+  enum class State { Queued, Running, Done };
+
+  PipelineJob(const PipelineJob &) = delete;
+  PipelineJob &operator=(const PipelineJob &) = delete;
+
+  void finish(Result result);
+
+  std::function<Result()> m_build;      // Function that runs the build
+  std::function<bool()> m_isWaiting;    // Function that probes whether the build would wait for another compile
+  uint64_t m_key;                       // Compacted cache hash of the pipeline, shared by duplicate builds
+  PipelineJobPriority m_priority;       // Priority of the job, raised when a more urgent duplicate is queued
+  uint64_t m_memEstimate;               // Estimated peak memory of the build, in bytes
+  PipelineJobCallback m_doneCallback;   // Client callback called when the job has finished
+  void *m_callbackData;                 // Client data passed to the callback
+  std::atomic<unsigned> m_refCount{1};  // Reference count of the job
+  std::mutex m_mutex;                   // Mutex guarding the state of the job
+  std::condition_variable m_condition;  // Condition variable that wakes threads waiting for the job
+  State m_state = State::Queued;        // State of the job
+  Result m_result = Result::Success;    // Result of the build, once done
+  unsigned m_deferredAt = 0;            // Start count of the queue when the job was last put back, plus one
+  unsigned m_bypassCount = 0;           // Count of smaller jobs started ahead of this one to fit the memory budget
+};
+
+// =====================================================================================================================
+// Runs asynchronous pipeline builds on a fixed set of worker threads. Each priority has its own FIFO queue, and a
+// worker always takes a job of the most urgent priority that has one. A job whose pipeline is being compiled by
+// another thread is put back at the end of its queue instead of blocking the worker, unless no other job has been
+// started since it was last put back.
+//
+// A queued prefetch job is promoted to the on-demand queue when an on-demand job for the same pipeline is queued, and
+// no prefetch job is started while any more urgent thread waits for a compile that a prefetch job is running.
+//
+// With a memory budget, a job is only started if its estimated peak memory fits in what the running jobs leave of the
+// budget. If the job at the front of the most urgent queue does not fit, a later job of that queue that fits is started
+// instead, so that small pipelines are not held up behind a large one. The large job is started when enough memory is
+// free, or on its own once it has been passed over too often.
+class PipelineJobQueue {
+public:
+  PipelineJobQueue(unsigned threadCount, uint64_t memBudget);
+  ~PipelineJobQueue();
+
+  void enqueue(PipelineJob *job);
+
+  // Gets the count of queued jobs that were promoted to a more urgent priority
+  uint64_t getPromotionCount() const { return m_promotionCount; }
+
+  static PipelineJobPriority getCurrentPriority();
+  static void beginBoost();
+  static void endBoost();
+
+private:
+  PipelineJobQueue(const PipelineJobQueue &) = delete;
+  PipelineJobQueue &operator=(const PipelineJobQueue &) = delete;
+
+  void runWorker();
+  PipelineJob *takeJob(std::unique_lock<std::mutex> &lock);
+  std::deque<PipelineJob *>::iterator findJobInBudget(std::deque<PipelineJob *> &queue);
+
+  std::mutex m_mutex;                        // Mutex guarding the queues
+  std::condition_variable m_condition;       // Condition variable that wakes the workers
+  std::vector<std::thread> m_workers;        // Worker threads
+  unsigned m_startCount = 0;                 // Count of jobs started so far
+  bool m_shutdown = false;                   // Whether the queue is being destroyed
+  std::atomic<uint64_t> m_promotionCount{0}; // Count of queued jobs promoted to a more urgent priority
+  uint64_t m_memBudget;                      // Memory budget of the running jobs in bytes, or 0 for none
+  uint64_t m_memInUse = 0;                   // Sum of the estimated peak memory of the running jobs
+  // Queued jobs of each priority, most urgent first
+  std::deque<PipelineJob *> m_queues[static_cast<unsigned>(PipelineJobPriority::Count)];
+};
+
+} // namespace Llpc
@@ -29,12 +29,21 @@
 ***********************************************************************************************************************
 */
 #include "llpcShaderCache.h"
+#include "llpcPipelineJobQueue.h"
+#include "llpcSharedShaderCache.h"
 #include "vkgcUtil.h"
+#include "lgc/TraceEvents.h"
 #include "llvm/ADT/StringExtras.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Compression.h"
 #include "llvm/Support/DJB.h"
+#include "llvm/Support/Endian.h"
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/ThreadPool.h"
+#include <chrono>
 #include <string.h>
+#include <unordered_set>
 
 #define DEBUG_TYPE "llpc-shader-cache"
 
@@ -43,6 +52,63 @@ using namespace llvm;
 static cl::opt<std::string> ShaderCacheFilename("shader-cache-filename", cl::desc("Filename for the shader cache"),
                                                 cl::value_desc("filename"), cl::init(""));
 
+static cl::opt<bool> ShaderCacheDeferCrc("shader-cache-defer-crc",
+                                         cl::desc("Defer CRC validation of shader cache entries loaded from a file or "
+                                                  "blob until the entry is first looked up"),
+                                         cl::init(false));
+
+// NOTE: A mapped cache file must not be truncated by another process while it is in use.
+static cl::opt<bool> ShaderCacheMapFile("shader-cache-mmap",
+                                        cl::desc("Memory-map the on-disk shader cache file and serve cached shaders "
+                                                 "directly from the mapping instead of reading the whole file"),
+                                        cl::init(false));
+
+// -shader-cache-stream-load: stream the shader data of the on-disk file in after the cache is created
+//
+// NOTE: A lookup of an entry whose data has not been read yet waits for that entry only, which is read next.
+static cl::opt<bool> ShaderCacheStreamLoad("shader-cache-stream-load",
+                                           cl::desc("Only load the index of the on-disk shader cache file when the "
+                                                    "cache is created, and read the shader data in the background"),
+                                           cl::init(false));
+
+// -shader-cache-hot-window: period after the cache is created in which the shaders hit are recorded as hot
+//
+// NOTE: Hot shaders are placed together at the front of the data when the on-disk file is compacted or the cache is
+// serialized, so the next session reads them with one sequential read.
+static cl::opt<unsigned> ShaderCacheHotWindow("shader-cache-hot-window",
+                                              cl::desc("Seconds after the shader cache is created in which the "
+                                                       "shaders hit are recorded as hot (0 to disable)"),
+                                              cl::value_desc("seconds"), cl::init(0));
+
+// -shader-cache-prefetch-hot: read the hot region of a mapped on-disk file when the cache is created
+static cl::opt<bool> ShaderCachePrefetchHot("shader-cache-prefetch-hot",
+                                            cl::desc("Read and validate the hot shaders at the front of a mapped "
+                                                     "shader cache file when the cache is created"),
+                                            cl::init(false));
+
+// NOTE: Only entries with their own allocation, i.e. not loaded from the cache file or the initial data blob, count
+// towards the budget and can be evicted.
+static cl::opt<unsigned> ShaderCacheMaxSize("shader-cache-max-size",
+                                            cl::desc("Maximum size in MB of the shader data held in memory by each "
+                                                     "shader cache, beyond which entries are evicted (0 for no limit)"),
+                                            cl::value_desc("size"), cl::init(0));
+
+// -shader-cache-compress: compress the data of new shader cache entries
+//
+// NOTE: A compressed entry is decompressed on its first hit, and the decompressed copy is kept until it is evicted.
+static cl::opt<bool> ShaderCacheCompress("shader-cache-compress",
+                                         cl::desc("Compress the data of new shader cache entries with zlib, in memory, "
+                                                  "in the on-disk file and in the serialized cache"),
+                                         cl::init(false));
+
+// -shader-cache-shared-size: size of the shared memory segment created for the shared shader cache mode
+//
+// NOTE: A process that opens a segment created by another process uses it with the size it was created with.
+static cl::opt<unsigned> ShaderCacheSharedSize("shader-cache-shared-size",
+                                               cl::desc("Size in MB of the shared memory segment created for shader "
+                                                        "cache mode 5"),
+                                               cl::value_desc("size"), cl::init(256));
+
 namespace Llpc {
 
 #if defined(__unix__)
@@ -53,6 +119,15 @@ static const char CacheFileSubPath[] = "\\AMD\\LlpcCache\\";
 
 static const char ClientStr[] = "LLPC";
 
+// The on-disk file is compacted once at least 1/CompactionStaleRatio of its shader data is stale.
+static constexpr size_t CompactionStaleRatio = 4;
+
+// Merges of fewer source entries than this are done on the calling thread.
+static constexpr size_t MinParallelMergeEntries = 1024;
+
+// Serialized data smaller than this is copied on the calling thread.
+static constexpr size_t MinParallelCopySize = 16 << 20;
+
 static constexpr uint64_t CrcWidth = sizeof(uint64_t) * 8;
 static constexpr uint64_t CrcInitialValue = 0xFFFFFFFFFFFFFFFF;
 
@@ -110,10 +185,34 @@ static const uint64_t CrcLookup[256] = {
     0xF989DB4A98BD5062, 0x541A097F0C7465CB, 0x4FC6939CCB9986C6, 0xE25541A95F50B36F, 0xB972E5C276C2D83D,
     0x14E137F7E20BED94};
 
+// Lookup tables for the slice-by-8 CRC calculation. table[k][v] is the CRC state obtained by shifting a state that has
+// only byte k set to v through 8 bytes of zero data. Since the CRC is linear, this lets 8 data bytes be folded into the
+// CRC with 8 lookups instead of 8 dependent iterations. The tables are derived from CrcLookup, so the checksum is
+// identical to the byte-at-a-time calculation.
+struct CrcSliceTables {
+  CrcSliceTables() {
+    for (unsigned k = 0; k < 8; ++k) {
+      for (unsigned v = 0; v < 256; ++v) {
+        uint64_t crc = static_cast<uint64_t>(v) << (8 * k);
+        for (unsigned i = 0; i < 8; ++i)
+          crc = (crc << 8) ^ CrcLookup[crc >> (CrcWidth - 8)];
+        table[k][v] = crc;
+      }
+    }
+  }
+
+  uint64_t table[8][256];
+};
+
 // =====================================================================================================================
 ShaderCache::ShaderCache()
-    : m_onDiskFile(), m_disableCache(true), m_shaderDataEnd(sizeof(ShaderCacheSerializedHeader)), m_totalShaders(0),
-      m_serializedSize(sizeof(ShaderCacheSerializedHeader)), m_getValueFunc(nullptr), m_storeValueFunc(nullptr) {
+    : m_onDiskFile(), m_disableCache(true), m_shaderDataEnd(sizeof(ShaderCacheSerializedHeader)), m_fileShaderCount(0),
+      m_totalShaders(0), m_staleFileSize(0), m_stopFileWriter(false), m_streamData(nullptr), m_stopStreamLoader(false),
+      m_hotDataSize(0), m_recordingHot(false), m_hotReorder(false), m_loadedEntryInvalidated(false),
+      m_serializedSize(sizeof(ShaderCacheSerializedHeader)), m_clockHand(0), m_evictableSize(0), m_hitCount(0),
+      m_missCount(0), m_waitCount(0), m_waitNanoseconds(0), m_bytesStored(0), m_evictionCount(0),
+      m_maxWaiters(0), m_boostCount(0), m_getValueFunc(nullptr), m_storeValueFunc(nullptr),
+      m_keyHashAlgorithm(MetroHash::HashAlgorithm::MetroHash64) {
   memset(m_fileFullPath, 0, MaxFilePathLen);
   memset(&m_gfxIp, 0, sizeof(m_gfxIp));
 }
@@ -126,24 +225,49 @@ ShaderCache::~ShaderCache() {
 // =====================================================================================================================
 // Destruction, does clean-up work.
 void ShaderCache::Destroy() {
+  stopStreamLoader();
+  stopFileWriter();
   if (m_onDiskFile.isOpen())
     m_onDiskFile.close();
   resetRuntimeCache();
+  if (m_sharedCache) {
+    m_getValueFunc = nullptr;
+    m_storeValueFunc = nullptr;
+    m_sharedCache.reset();
+  }
 }
 
 // =====================================================================================================================
 // Resets the runtime shader cache to an empty state. Releases all allocator memory and decommits it back to the OS.
 void ShaderCache::resetRuntimeCache() {
-  for (auto indexMap : m_shaderIndexMap)
-    delete indexMap.second;
-  m_shaderIndexMap.clear();
+  for (ShaderIndexShard &shard : m_shaderIndexShards) {
+    for (auto indexMap : shard.map) {
+      if (indexMap.second->ownsDataBlob)
+        delete[] static_cast<uint8_t *>(indexMap.second->dataBlob);
+      delete indexMap.second;
+    }
+    shard.map.clear();
+  }
+  m_clockEntries.clear();
+  m_clockHand = 0;
+  m_evictableSize = 0;
 
   for (auto allocIt : m_allocationList)
     delete[] allocIt.first;
   m_allocationList.clear();
+  m_mappedFile.reset();
+  m_streamedShaders.clear();
+  m_streamRequests.clear();
+  m_streamData = nullptr;
+  if (m_streamFile.isOpen())
+    m_streamFile.close();
+  m_hotDataSize = 0;
+  m_loadedEntryInvalidated = false;
 
   m_totalShaders = 0;
   m_shaderDataEnd = sizeof(ShaderCacheSerializedHeader);
+  m_fileShaderCount = 0;
+  m_staleFileSize = 0;
   m_serializedSize = sizeof(ShaderCacheSerializedHeader);
 }
 
@@ -165,38 +289,84 @@ Result ShaderCache::Serialize(void *blob, size_t *size) {
     // Do serialize
     assert(m_shaderDataEnd == m_serializedSize || m_shaderDataEnd == sizeof(ShaderCacheSerializedHeader));
 
+    // The data of the on-disk file must all be in memory before it can be copied.
+    waitForStreamLoader();
+
+    // With shaders recorded as hot, the data is copied entry by entry, which needs the shard locks, so the hot
+    // shaders can go first. They then form the hot region of the serialized data. The same is done once a loaded
+    // entry has been found corrupted, as its data is still in the loaded memory and must not be copied.
+    const std::vector<uint64_t> hotKeys = getHotKeys();
+    const bool copyPerEntry = !hotKeys.empty() || m_loadedEntryInvalidated;
+    if (copyPerEntry)
+      lockCacheMap(true);
+
+    std::lock_guard<sys::Mutex> dataLock(m_dataLock);
     if (m_serializedSize >= sizeof(ShaderCacheSerializedHeader)) {
       if (blob && (*size) >= m_serializedSize) {
-        // First construct the header and copy it into the memory provided
+        // First construct the header
         ShaderCacheSerializedHeader header = {};
         header.headerSize = sizeof(ShaderCacheSerializedHeader);
         header.shaderCount = m_totalShaders;
         header.shaderDataEnd = m_shaderDataEnd;
         getBuildTime(&header.buildId);
-
-        memcpy(blob, &header, sizeof(ShaderCacheSerializedHeader));
-
-        void *dataDst = voidPtrInc(blob, sizeof(ShaderCacheSerializedHeader));
-
-        // Then iterate through all allocators (which hold the backing memory for the shader data)
-        // and copy their contents to the blob.
-        for (auto it : m_allocationList) {
-          assert(it.first);
-
-          const size_t copySize = it.second;
-          if (voidPtrDiff(dataDst, blob) + copySize > (*size)) {
-            result = Result::ErrorUnknown;
-            break;
+        header.keyHashAlgorithm = m_keyHashAlgorithm;
+
+        std::vector<std::pair<const void *, size_t>> copyList;
+        if (!copyPerEntry) {
+          // Gather the memory that holds the shader data: the data loaded from a mapped cache file precedes all data
+          // in the allocators, which is followed by the data of the entries that have their own allocation. Each
+          // entry carries the CRC computed when it was added, so the data is copied as is.
+          copyList.reserve((m_mappedFile ? 1 : 0) + m_allocationList.size() + m_clockEntries.size());
+          if (m_mappedFile)
+            copyList.push_back({m_mappedFile->getBufferStart(), m_mappedFile->getBufferSize()});
+          for (auto it : m_allocationList) {
+            assert(it.first);
+            copyList.push_back({it.first, it.second});
+          }
+          for (const ShaderIndex *index : m_clockEntries)
+            copyList.push_back({index->dataBlob, index->header.size});
+        } else {
+          // Gather the data of the Ready entries: the hot shaders in the order they were hit, then all others. Stale
+          // duplicates and corrupted entries in the loaded data are dropped, so the data may be smaller than the
+          // queried size.
+          std::unordered_set<const ShaderIndex *> hotEntries;
+          for (uint64_t key : hotKeys) {
+            const ShaderIndexMap &indexMapOfShard = getShard(key).map;
+            auto indexMap = indexMapOfShard.find(key);
+            if (indexMap == indexMapOfShard.end() || indexMap->second->state != ShaderEntryState::Ready ||
+                !hotEntries.insert(indexMap->second).second)
+              continue;
+            copyList.push_back({indexMap->second->dataBlob, indexMap->second->header.size});
+            header.hotDataSize += indexMap->second->header.size;
+          }
+          for (const ShaderIndexShard &shard : m_shaderIndexShards) {
+            for (auto indexMap : shard.map) {
+              if (indexMap.second->state == ShaderEntryState::Ready && !hotEntries.count(indexMap.second))
+                copyList.push_back({indexMap.second->dataBlob, indexMap.second->header.size});
+            }
+          }
+          header.shaderCount = copyList.size();
+
+          size_t dataSize = 0;
+          for (const auto &piece : copyList)
+            dataSize += piece.second;
+          if (dataSize <= m_serializedSize - sizeof(ShaderCacheSerializedHeader)) {
+            memset(voidPtrInc(blob, sizeof(ShaderCacheSerializedHeader) + dataSize), 0,
+                   m_serializedSize - sizeof(ShaderCacheSerializedHeader) - dataSize);
           }
-
-          memcpy(dataDst, it.first, copySize);
-          dataDst = voidPtrInc(dataDst, copySize);
         }
+
+        memcpy(blob, &header, sizeof(ShaderCacheSerializedHeader));
+        result = copyDataParallel(copyList, voidPtrInc(blob, sizeof(ShaderCacheSerializedHeader)),
+                                  (*size) - sizeof(ShaderCacheSerializedHeader));
       } else {
         llvm_unreachable("Should never be called!");
         result = Result::ErrorUnknown;
       }
     }
+
+    if (copyPerEntry)
+      unlockCacheMap(true);
   }
 
   return result;
@@ -213,38 +383,126 @@ Result ShaderCache::Merge(unsigned srcCacheCount, const IShaderCache **ppSrcCach
 
   Result result = Result::Success;
 
+  // The data of the sources must all be in memory before it can be copied.
+  for (unsigned i = 0; i < srcCacheCount; i++)
+    static_cast<ShaderCache *>(const_cast<IShaderCache *>(ppSrcCaches[i]))->waitForStreamLoader();
+
   lockCacheMap(false);
+  std::unique_lock<sys::Mutex> dataLock(m_dataLock);
 
+  size_t srcEntryCount = 0;
   for (unsigned i = 0; i < srcCacheCount; i++) {
     ShaderCache *srcCache = static_cast<ShaderCache *>(const_cast<IShaderCache *>(ppSrcCaches[i]));
     srcCache->lockCacheMap(true);
+    srcEntryCount += srcCache->m_totalShaders;
+  }
 
-    for (auto it : srcCache->m_shaderIndexMap) {
-      uint64_t key = it.first;
-
-      auto indexMap = m_shaderIndexMap.find(key);
-      if (indexMap == m_shaderIndexMap.end()) {
-        ShaderIndex *index = nullptr;
-        void *mem = getCacheSpace(it.second->header.size);
-        memcpy(mem, it.second->dataBlob, it.second->header.size);
-
-        index = new ShaderIndex;
-        index->dataBlob = mem;
-        index->state = ShaderEntryState::Ready;
+  // Source and destination use the same shard count and key-to-shard mapping, so each shard of the destination is
+  // merged from the same shard of all sources, independently of the other shards. An entry whose key is already
+  // present, either from the destination or from an earlier source, is skipped without copying its data.
+  std::vector<ShaderIndex *> newEntries[ShaderIndexShardCount];
+  auto mergeShard = [&](unsigned shardIdx) {
+    ShaderIndexMap &dstMap = m_shaderIndexShards[shardIdx].map;
+    for (unsigned i = 0; i < srcCacheCount; i++) {
+      const ShaderCache *srcCache = static_cast<const ShaderCache *>(ppSrcCaches[i]);
+      for (auto it : srcCache->m_shaderIndexShards[shardIdx].map) {
+        auto inserted = dstMap.insert({it.first, nullptr});
+        if (!inserted.second)
+          continue;
+
+        ShaderIndex *index = new ShaderIndex;
         index->header = it.second->header;
+        index->dataBlob = new uint8_t[index->header.size];
+        index->ownsDataBlob = true;
+        memcpy(index->dataBlob, it.second->dataBlob, it.second->header.size);
+        index->state = ShaderEntryState::Ready;
+        index->crcValidated = it.second->crcValidated;
 
-        m_shaderIndexMap[key] = index;
-        m_totalShaders++;
+        inserted.first->second = index;
+        newEntries[shardIdx].push_back(index);
       }
     }
-    srcCache->unlockCacheMap(true);
+  };
+
+  if (srcEntryCount >= MinParallelMergeEntries) {
+    ThreadPool threadPool(hardware_concurrency(ShaderIndexShardCount));
+    for (unsigned shardIdx = 0; shardIdx < ShaderIndexShardCount; ++shardIdx)
+      threadPool.async([=, &mergeShard] { mergeShard(shardIdx); });
+    threadPool.wait();
+  } else {
+    for (unsigned shardIdx = 0; shardIdx < ShaderIndexShardCount; ++shardIdx)
+      mergeShard(shardIdx);
   }
 
+  for (unsigned i = 0; i < srcCacheCount; i++)
+    static_cast<ShaderCache *>(const_cast<IShaderCache *>(ppSrcCaches[i]))->unlockCacheMap(true);
+
+  // The cache data storage is not sharded, so the new entries are added to it once all shards are merged.
+  for (unsigned shardIdx = 0; shardIdx < ShaderIndexShardCount; ++shardIdx) {
+    for (ShaderIndex *index : newEntries[shardIdx]) {
+      trackEntrySpace(index);
+      m_totalShaders++;
+    }
+  }
+
+  dataLock.unlock();
   unlockCacheMap(false);
+  evictEntries();
 
   return result;
 }
 
+// =====================================================================================================================
+// Copies the given pieces of memory one after another into the destination buffer. Large copies are split between
+// threads, which is what it takes to get near the memory bandwidth for a cache of hundreds of MB.
+//
+// @param copyList : Pieces of memory to copy, in order
+// @param [out] dst : Destination buffer
+// @param dstSize : Size of the destination buffer
+Result ShaderCache::copyDataParallel(const std::vector<std::pair<const void *, size_t>> &copyList, void *dst,
+                                     size_t dstSize) {
+  size_t totalSize = 0;
+  for (const auto &piece : copyList)
+    totalSize += piece.second;
+  if (totalSize > dstSize)
+    return Result::ErrorUnknown;
+
+  if (totalSize < MinParallelCopySize) {
+    for (const auto &piece : copyList) {
+      memcpy(dst, piece.first, piece.second);
+      dst = voidPtrInc(dst, piece.second);
+    }
+    return Result::Success;
+  }
+
+  // Cut the output into chunks of roughly equal size, splitting pieces where necessary.
+  const unsigned threadCount = hardware_concurrency().compute_thread_count();
+  const size_t chunkSize = std::max(MinParallelCopySize / 4, alignTo(totalSize / threadCount, 4096));
+  ThreadPool threadPool(hardware_concurrency(threadCount));
+  size_t chunkStart = 0;
+  while (chunkStart < totalSize) {
+    const size_t chunkEnd = std::min(totalSize, chunkStart + chunkSize);
+    threadPool.async([=, &copyList] {
+      size_t pieceStart = 0;
+      for (const auto &piece : copyList) {
+        const size_t pieceEnd = pieceStart + piece.second;
+        const size_t copyStart = std::max(pieceStart, chunkStart);
+        const size_t copyEnd = std::min(pieceEnd, chunkEnd);
+        if (copyStart < copyEnd) {
+          memcpy(voidPtrInc(dst, copyStart), voidPtrInc(piece.first, copyStart - pieceStart), copyEnd - copyStart);
+        }
+        if (pieceEnd >= chunkEnd)
+          break;
+        pieceStart = pieceEnd;
+      }
+    });
+    chunkStart = chunkEnd;
+  }
+  threadPool.wait();
+
+  return Result::Success;
+}
+
 // =====================================================================================================================
 // Initializes the Shader Cache in late stage.
 //
@@ -260,8 +518,12 @@ Result ShaderCache::init(const ShaderCacheCreateInfo *createInfo, const ShaderCa
     m_storeValueFunc = createInfo->pfnStoreValueFunc;
     m_gfxIp = auxCreateInfo->gfxIp;
     m_hash = auxCreateInfo->hash;
+    m_keyHashAlgorithm = auxCreateInfo->keyHashAlgorithm;
+    m_hotWindowEnd = std::chrono::steady_clock::now() + std::chrono::seconds(ShaderCacheHotWindow);
+    m_recordingHot = ShaderCacheHotWindow > 0;
 
     lockCacheMap(false);
+    std::unique_lock<sys::Mutex> dataLock(m_dataLock);
 
     // If we're in runtime mode and the caller provided a data blob, try to load the from that blob.
     if (auxCreateInfo->shaderCacheMode == ShaderCacheEnableRuntime && createInfo->initialDataSize > 0) {
@@ -307,8 +569,29 @@ Result ShaderCache::init(const ShaderCacheCreateInfo *createInfo, const ShaderCa
       // any memory allocated
       if (loadResult != Result::Success)
         resetRuntimeCache();
+
+      // New shaders are appended to the file in the background, so compiles do not wait on disk I/O.
+      if (m_onDiskFile.isOpen())
+        startFileWriter();
+
+      // The shader data is read in the background if only the index was loaded.
+      if (loadResult == Result::Success && m_streamFile.isOpen())
+        startStreamLoader();
+    }
+    // In shared mode, the shared memory segment takes the place of the external cache, so a miss in this cache is
+    // looked up there and new shaders are stored there, where other processes find them.
+    else if (auxCreateInfo->shaderCacheMode == ShaderCacheEnableShared) {
+      BuildUniqueId buildId;
+      getBuildTime(&buildId);
+      m_sharedCache.reset(SharedShaderCache::open(buildId, static_cast<size_t>(ShaderCacheSharedSize) << 20));
+      if (m_sharedCache) {
+        m_clientData = m_sharedCache.get();
+        m_getValueFunc = &SharedShaderCache::getValue;
+        m_storeValueFunc = &SharedShaderCache::storeValue;
+      }
     }
 
+    dataLock.unlock();
     unlockCacheMap(false);
   } else
     m_disableCache = true;
@@ -371,6 +654,7 @@ void ShaderCache::resetCacheFile() {
   header.shaderCount = 0;
   header.shaderDataEnd = header.headerSize;
   getBuildTime(&header.buildId);
+  header.keyHashAlgorithm = m_keyHashAlgorithm;
 
   m_onDiskFile.write(&header, header.headerSize);
 }
@@ -383,10 +667,14 @@ void ShaderCache::resetCacheFile() {
 //    Compiling   - if an entry was created and must be compiled/populated by the caller
 //    Unavailable - if an unrecoverable error was encountered
 //
+// The entry of a Ready shader is pinned, so it is not evicted while the caller uses its data. The caller must unpin
+// it with releaseShader() once done.
+//
 // @param hash : Hash code of shader
 // @param allocateOnMiss : Whether allocate a new entry for new hash
 // @param [out] phEntry : Handle of shader cache entry
 ShaderEntryState ShaderCache::findShader(MetroHash::Hash hash, bool allocateOnMiss, CacheEntryHandle *phEntry) {
+  lgc::TraceScope traceScope("ShaderCache::findShader", "cache");
   // Early return if shader cache is disabled
   if (m_disableCache) {
     *phEntry = nullptr;
@@ -395,20 +683,50 @@ ShaderEntryState ShaderCache::findShader(MetroHash::Hash hash, bool allocateOnMi
 
   ShaderEntryState result = ShaderEntryState::Unavailable;
   bool existed = false;
+  bool fetchedExternal = false;
   ShaderIndex *index = nullptr;
   Result mapResult = Result::Success;
   assert(phEntry);
 
-  bool readOnlyLock = (!allocateOnMiss);
-  lockCacheMap(readOnlyLock);
   uint64_t hashKey = MetroHash::compact64(&hash);
-  auto indexMap = m_shaderIndexMap.find(hashKey);
-  if (indexMap != m_shaderIndexMap.end()) {
+  ShaderIndexShard &shard = getShard(hashKey);
+
+  // Fast path: a cache hit on an entry that is already Ready only needs the shared lock of its shard, so concurrent
+  // hits scale with the number of threads.
+  lockShard(shard, true);
+  auto indexMap = shard.map.find(hashKey);
+  if (indexMap != shard.map.end() && indexMap->second->state == ShaderEntryState::Ready &&
+      indexMap->second->crcValidated &&
+      (indexMap->second->header.codec == ShaderCacheCodec::None || indexMap->second->rawData)) {
+    index = indexMap->second;
+    assert(index->dataBlob && index->header.size != 0);
+    index->referenced = true;
+    ++index->pinCount;
+    unlockShard(shard, true);
+    ++m_hitCount;
+    recordHotShader(index);
+    (*phEntry) = index;
+    return ShaderEntryState::Ready;
+  }
+  const bool found = indexMap != shard.map.end();
+  unlockShard(shard, true);
+
+  if (!found && !allocateOnMiss) {
+    ++m_missCount;
+    return ShaderEntryState::Unavailable;
+  }
+
+  // Slow path: the entry is missing or not ready, so its state may have to change. Take the exclusive lock of the
+  // shard and look the entry up again, as another thread may have changed it in the meantime.
+  const bool readOnlyLock = false;
+  lockShard(shard, readOnlyLock);
+  indexMap = shard.map.find(hashKey);
+  if (indexMap != shard.map.end()) {
     existed = true;
     index = indexMap->second;
   } else if (allocateOnMiss) {
     index = new ShaderIndex;
-    m_shaderIndexMap[hashKey] = index;
+    shard.map[hashKey] = index;
   }
 
   if (!index)
@@ -416,11 +734,29 @@ ShaderEntryState ShaderCache::findShader(MetroHash::Hash hash, bool allocateOnMi
 
   if (mapResult == Result::Success) {
     if (existed) {
-      // We don't need to hold on to the write lock if we're not the one doing the compile
-      if (!readOnlyLock) {
-        unlockCacheMap(readOnlyLock);
-        readOnlyLock = true;
-        lockCacheMap(readOnlyLock);
+      if (index->state == ShaderEntryState::Ready &&
+          ((!index->crcValidated && !validateDeferredCrc(index)) || !decompressEntryData(index))) {
+        // The entry loaded from the file or blob is corrupted. Treat it as a miss so it gets compiled again.
+        if (index->ownsDataBlob) {
+          std::lock_guard<sys::Mutex> dataLock(m_dataLock);
+          freeEntrySpace(index);
+        } else {
+          // The corrupted data stays in the loaded memory, so Serialize must copy the entries one by one from now on.
+          m_loadedEntryInvalidated = true;
+          if (m_fileWriter.joinable()) {
+            // The corrupted entry is in the on-disk file; let the file writer thread know, as it may compact the
+            // file. The update is made under the file write mutex, so the notification cannot be lost between the
+            // file writer thread checking for compaction and waiting.
+            {
+              std::lock_guard<std::mutex> lock(m_fileWriteMutex);
+              m_staleFileSize += index->header.size;
+            }
+            m_fileWriteCondition.notify_one();
+          }
+        }
+        index->state = ShaderEntryState::New;
+        index->header.size = 0;
+        index->dataBlob = nullptr;
       }
     } else {
       bool needsInit = true;
@@ -432,7 +768,10 @@ ShaderEntryState ShaderCache::findShader(MetroHash::Hash hash, bool allocateOnMi
         if (extResult == Result::Success) {
           // An entry was found matching our hash, we should allocate memory to hold the data and call again
           assert(index->header.size > 0);
-          index->dataBlob = getCacheSpace(index->header.size);
+          {
+            std::lock_guard<sys::Mutex> dataLock(m_dataLock);
+            allocateEntrySpace(index);
+          }
 
           if (!index->dataBlob)
             extResult = Result::ErrorOutOfMemory;
@@ -450,7 +789,9 @@ ShaderEntryState ShaderCache::findShader(MetroHash::Hash hash, bool allocateOnMi
 
           index->header = (*header);
           index->state = ShaderEntryState::Ready;
+          index->crcValidated = true;
           needsInit = false;
+          fetchedExternal = true;
         } else if (extResult == Result::ErrorUnavailable) {
           // This means the external cache is unavailable and we shouldn't bother using it anymore. To
           // prevent useless calls we'll zero out the function pointers.
@@ -466,44 +807,99 @@ ShaderEntryState ShaderCache::findShader(MetroHash::Hash hash, bool allocateOnMi
       }
 
       if (needsInit) {
-        // This is a brand new cache entry so we need to initialize the ShaderIndex.
-        memset(index, 0, sizeof(*index));
+        // This is a brand new cache entry so we need to initialize the ShaderIndex, releasing the space allocated
+        // for a failed fetch from the external cache.
+        if (index->ownsDataBlob) {
+          std::lock_guard<sys::Mutex> dataLock(m_dataLock);
+          freeEntrySpace(index);
+        }
+        index->header = {};
         index->header.key = hashKey;
+        index->dataBlob = nullptr;
+        index->crcValidated = false;
         index->state = ShaderEntryState::New;
       }
     } // End if (existed == false)
 
     if (index->state == ShaderEntryState::Compiling) {
-      // The shader is being compiled by another thread, we should release the lock and wait for it to complete
+      // The shader is being compiled by another thread, we should release the lock and wait for it to complete. The
+      // entry is pinned while we wait, so it cannot be evicted as soon as it becomes Ready.
+      ++index->pinCount;
+      ++m_waitCount;
+      uint64_t waiters = ++index->waiterCount;
+      // An entry whose data is still to be read from the on-disk file is "compiled" by the stream loader thread, so
+      // have it read this entry next.
+      if (index->streaming)
+        requestStreamedShader(index);
+      uint64_t maxWaiters = m_maxWaiters;
+      while (waiters > maxWaiters && !m_maxWaiters.compare_exchange_weak(maxWaiters, waiters))
+        ;
+
+      // If this thread is more urgent than the one compiling the entry, boost the compile: no prefetch build is
+      // started while we wait, so that it does not compete with the compile we are waiting for.
+      PipelineJobPriority waiterPriority = PipelineJobQueue::getCurrentPriority();
+      bool boosted = waiterPriority < index->priority;
+      if (boosted) {
+        index->priority = waiterPriority;
+        ++m_boostCount;
+        PipelineJobQueue::beginBoost();
+      }
+      auto waitStart = std::chrono::steady_clock::now();
       while (index->state == ShaderEntryState::Compiling) {
-        unlockCacheMap(readOnlyLock);
+        unlockShard(shard, readOnlyLock);
         {
+          lgc::TraceScope waitTraceScope("ShaderCache wait for entry", "cache");
           std::unique_lock<std::mutex> lock(m_conditionMutex);
 
           m_conditionVariable.wait_for(lock, std::chrono::seconds(1));
         }
-        lockCacheMap(readOnlyLock);
+        lockShard(shard, readOnlyLock);
       }
+      m_waitNanoseconds +=
+          std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - waitStart).count();
+      if (boosted)
+        PipelineJobQueue::endBoost();
+      --index->waiterCount;
+      --index->pinCount;
       // At this point the shader entry is either Ready, New or something failed. We've already
       // initialized our result code to an error code above, the Ready and New cases are handled below so
       // nothing else to do here.
     }
 
-    if (index->state == ShaderEntryState::Ready) {
-      // The shader has been compiled, just verify it has valid data and then return success.
-      assert(index->dataBlob && index->header.size != 0);
-    } else if (index->state == ShaderEntryState::New) {
-      // The shader entry is new (or previously failed compilation) and we're the first thread to get a
-      // crack at it, move it into the Compiling state
-      index->state = ShaderEntryState::Compiling;
-    }
+    if (index->state == ShaderEntryState::Ready && !decompressEntryData(index)) {
+      // Another thread compiled the shader while we waited, but its data cannot be decompressed. Leave the entry as
+      // it is, and let the caller compile the shader without the cache.
+      (*phEntry) = nullptr;
+      result = ShaderEntryState::Unavailable;
+    } else {
+      if (index->state == ShaderEntryState::Ready) {
+        // The shader has been compiled, just verify it has valid data and then return success.
+        assert(index->dataBlob && index->header.size != 0);
+        index->referenced = true;
+        ++index->pinCount;
+      } else if (index->state == ShaderEntryState::New) {
+        // The shader entry is new (or previously failed compilation) and we're the first thread to get a
+        // crack at it, move it into the Compiling state
+        index->state = ShaderEntryState::Compiling;
+        index->priority = PipelineJobQueue::getCurrentPriority();
+      }
 
-    // Return the ShaderIndex as a handle so subsequent calls into the cache can avoid the hash map lookup.
-    (*phEntry) = index;
-    result = index->state;
+      // Return the ShaderIndex as a handle so subsequent calls into the cache can avoid the hash map lookup.
+      (*phEntry) = index;
+      result = index->state;
+    }
   }
 
-  unlockCacheMap(readOnlyLock);
+  unlockShard(shard, readOnlyLock);
+
+  if (result == ShaderEntryState::Ready) {
+    ++m_hitCount;
+    recordHotShader(index);
+  } else
+    ++m_missCount;
+
+  if (fetchedExternal)
+    evictEntries();
 
   return result;
 }
@@ -516,11 +912,29 @@ ShaderEntryState ShaderCache::findShader(MetroHash::Hash hash, bool allocateOnMi
 // @param blob : Shader data
 // @param shaderSize : size of shader data in bytes
 void ShaderCache::insertShader(CacheEntryHandle hEntry, const void *blob, size_t shaderSize) {
+  lgc::TraceScope traceScope("ShaderCache::insertShader", "cache");
   auto *const index = static_cast<ShaderIndex *>(hEntry);
   assert(m_disableCache == false);
   assert(index && index->state == ShaderEntryState::Compiling);
 
-  lockCacheMap(false);
+  // Compress the shader before taking any lock. It is stored as is if it does not get smaller.
+  SmallVector<char, 0> compressedBlob;
+  ShaderCacheCodec codec = ShaderCacheCodec::None;
+  const size_t rawSize = shaderSize;
+  if (ShaderCacheCompress && zlib::isAvailable()) {
+    StringRef rawBlob(static_cast<const char *>(blob), shaderSize);
+    if (Error err = zlib::compress(rawBlob, compressedBlob, zlib::BestSpeedCompression))
+      consumeError(std::move(err));
+    else if (compressedBlob.size() < shaderSize) {
+      codec = ShaderCacheCodec::Zlib;
+      blob = compressedBlob.data();
+      shaderSize = compressedBlob.size();
+    }
+  }
+
+  ShaderIndexShard &shard = getShard(index->header.key);
+  lockShard(shard, false);
+  std::unique_lock<sys::Mutex> dataLock(m_dataLock);
 
   Result result = Result::Success;
 
@@ -528,7 +942,9 @@ void ShaderCache::insertShader(CacheEntryHandle hEntry, const void *blob, size_t
     // Allocate space to store the serialized shader and a copy of the header. The header is duplicated in the
     // data to simplify serialize/load.
     index->header.size = (shaderSize + sizeof(ShaderHeader));
-    index->dataBlob = getCacheSpace(index->header.size);
+    index->header.codec = codec;
+    index->header.rawSize = codec == ShaderCacheCodec::None ? 0 : rawSize;
+    allocateEntrySpace(index);
 
     if (!index->dataBlob)
       result = Result::ErrorOutOfMemory;
@@ -540,6 +956,7 @@ void ShaderCache::insertShader(CacheEntryHandle hEntry, const void *blob, size_t
 
       // Serialize the shader into an opaque blob of data.
       memcpy(dataBlob, blob, shaderSize);
+      m_bytesStored += shaderSize;
 
       // Compute a CRC for the serialized data (useful for detecting data corruption), and copy the index's
       // header into the data's header.
@@ -563,10 +980,11 @@ void ShaderCache::insertShader(CacheEntryHandle hEntry, const void *blob, size_t
 
       // Mark this entry as ready, we'll wake the waiting threads once we release the lock
       index->state = ShaderEntryState::Ready;
+      index->crcValidated = true;
 
       // Finally, update the file if necessary.
-      if (m_onDiskFile.isOpen())
-        addShaderToFile(index);
+      if (m_fileWriter.joinable())
+        queueShaderForFile(index);
     }
   }
 
@@ -580,8 +998,13 @@ void ShaderCache::insertShader(CacheEntryHandle hEntry, const void *blob, size_t
     index->dataBlob = nullptr;
   }
 
-  unlockCacheMap(false);
+  dataLock.unlock();
+  unlockShard(shard, false);
   m_conditionVariable.notify_all();
+  // The shader is hit from the cache in the next session, at the same point of it.
+  if (result == Result::Success)
+    recordHotShader(index);
+  evictEntries();
 }
 
 // =====================================================================================================================
@@ -589,14 +1012,16 @@ void ShaderCache::insertShader(CacheEntryHandle hEntry, const void *blob, size_t
 //
 // @param hEntry : Handle of shader cache entry
 void ShaderCache::resetShader(CacheEntryHandle hEntry) {
+  lgc::TraceScope traceScope("ShaderCache::resetShader", "cache");
   auto *const index = static_cast<ShaderIndex *>(hEntry);
   assert(m_disableCache == false);
   assert(index && index->state == ShaderEntryState::Compiling);
-  lockCacheMap(false);
+  ShaderIndexShard &shard = getShard(index->header.key);
+  lockShard(shard, false);
   index->state = ShaderEntryState::New;
   index->header.size = 0;
   index->dataBlob = nullptr;
-  unlockCacheMap(false);
+  unlockShard(shard, false);
   m_conditionVariable.notify_all();
 }
 
@@ -607,49 +1032,305 @@ void ShaderCache::resetShader(CacheEntryHandle hEntry) {
 // @param [out] ppBlob : Shader data
 // @param [out] size : size of shader data in bytes
 Result ShaderCache::retrieveShader(CacheEntryHandle hEntry, const void **ppBlob, size_t *size) {
+  lgc::TraceScope traceScope("ShaderCache::retrieveShader", "cache");
   const auto *const index = static_cast<ShaderIndex *>(hEntry);
 
   assert(m_disableCache == false);
   assert(index);
   assert(index->header.size >= sizeof(ShaderHeader));
 
-  lockCacheMap(true);
+  ShaderIndexShard &shard = getShard(index->header.key);
+  lockShard(shard, true);
 
-  *ppBlob = voidPtrInc(index->dataBlob, sizeof(ShaderHeader));
-  *size = index->header.size - sizeof(ShaderHeader);
+  if (index->header.codec != ShaderCacheCodec::None) {
+    // The entry was decompressed when findShader() returned it as Ready.
+    assert(index->rawData);
+    *ppBlob = index->rawData.get();
+    *size = index->header.rawSize;
+  } else {
+    *ppBlob = voidPtrInc(index->dataBlob, sizeof(ShaderHeader));
+    *size = index->header.size - sizeof(ShaderHeader);
+  }
 
-  unlockCacheMap(true);
+  unlockShard(shard, true);
 
   return *size > 0 ? Result::Success : Result::ErrorUnknown;
 }
 
 // =====================================================================================================================
-// Adds data for a new shader to the on-disk file
+// Unpins the entry of a shader that findShader() returned as Ready. After this the data retrieved from the entry must
+// no longer be used, as the entry may be evicted.
+//
+// @param hEntry : Handle of shader cache entry
+void ShaderCache::releaseShader(CacheEntryHandle hEntry) {
+  auto *const index = static_cast<ShaderIndex *>(hEntry);
+  assert(index && index->pinCount > 0);
+  --index->pinCount;
+}
+
+// =====================================================================================================================
+// Warms the entry of a shader ahead of its lookup: an entry loaded from the on-disk file or a blob has its data read
+// and CRC validated, and a shader that is only in the external cache is fetched from there. A shader that is not in
+// any cache is left for the build to compile.
+//
+// @param hash : Hash code of the shader
+void ShaderCache::prefetchShader(MetroHash::Hash hash) {
+  if (m_disableCache)
+    return;
+
+  // Only allocate on a miss if the external cache may have the shader; findShader() fetches it into a new entry.
+  CacheEntryHandle hEntry = nullptr;
+  ShaderEntryState state = findShader(hash, useExternalCache(), &hEntry);
+  if (state == ShaderEntryState::Ready)
+    releaseShader(hEntry);
+  else if (state == ShaderEntryState::Compiling && hEntry)
+    resetShader(hEntry);
+}
+
+// =====================================================================================================================
+// Returns whether the shader with the given hash is being compiled by another thread, without waiting for it and
+// without allocating an entry for it.
+//
+// @param hash : Hash code of the shader
+bool ShaderCache::isShaderCompiling(MetroHash::Hash hash) {
+  if (m_disableCache)
+    return false;
+
+  uint64_t hashKey = MetroHash::compact64(&hash);
+  ShaderIndexShard &shard = getShard(hashKey);
+  lockShard(shard, true);
+  auto indexMap = shard.map.find(hashKey);
+  bool compiling = indexMap != shard.map.end() && indexMap->second->state == ShaderEntryState::Compiling;
+  unlockShard(shard, true);
+  return compiling;
+}
+
+// =====================================================================================================================
+// Returns the lookup, store and eviction counters of the shader cache.
+ShaderCacheCounters ShaderCache::getCounters() {
+  ShaderCacheCounters counters = {};
+  counters.hits = m_hitCount;
+  counters.misses = m_missCount;
+  counters.waits = m_waitCount;
+  counters.waitTime = m_waitNanoseconds * 1e-9;
+  counters.bytesStored = m_bytesStored;
+  counters.evictions = m_evictionCount;
+  counters.maxWaiters = m_maxWaiters;
+  counters.boosts = m_boostCount;
+  std::lock_guard<sys::Mutex> dataLock(m_dataLock);
+  counters.evictableSize = m_evictableSize;
+  return counters;
+}
+
+// =====================================================================================================================
+// Queues a new shader to be appended to the on-disk file by the file writer thread. The entry is pinned until it has
+// been written, so it is not evicted before then.
 //
 // @param index : A new shader
-void ShaderCache::addShaderToFile(const ShaderIndex *index) {
-  assert(m_onDiskFile.isOpen());
+void ShaderCache::queueShaderForFile(ShaderIndex *index) {
+  ++index->pinCount;
+  {
+    std::lock_guard<std::mutex> lock(m_fileWriteMutex);
+    m_fileWriteQueue.push_back(index);
+  }
+  m_fileWriteCondition.notify_one();
+}
 
-  // We only need to update the parts of the file that changed, which is the number of shaders, the new data section,
-  // and the shaderDataEnd.
+// =====================================================================================================================
+// Appends a batch of new shaders to the on-disk file, then unpins their entries. This function is only called by the
+// file writer thread.
+//
+// @param indices : New shaders
+void ShaderCache::writeShadersToFile(const std::vector<ShaderIndex *> &indices) {
+  lgc::TraceScope traceScope("ShaderCache::writeShadersToFile", "cache");
+  // The file is closed if reopening it failed after compaction.
+  if (m_onDiskFile.isOpen()) {
+    // We only need to update the parts of the file that changed, which is the new data section, the number of
+    // shaders and the shaderDataEnd. The header is written after the data, so it never counts shaders whose data
+    // has not been written yet.
+    m_onDiskFile.seek(static_cast<unsigned>(m_shaderDataEnd), true);
+    for (const ShaderIndex *index : indices) {
+      m_onDiskFile.write(index->dataBlob, index->header.size);
+      m_shaderDataEnd += index->header.size;
+    }
+    m_fileShaderCount += indices.size();
 
-  // Calculate the header offsets, then write the relavent data to the file.
-  const unsigned shaderCountOffset = offsetof(struct ShaderCacheSerializedHeader, shaderCount);
-  const unsigned dataEndOffset = offsetof(struct ShaderCacheSerializedHeader, shaderDataEnd);
+    // Calculate the header offsets, then write the relavent data to the file.
+    const unsigned shaderCountOffset = offsetof(struct ShaderCacheSerializedHeader, shaderCount);
+    const unsigned dataEndOffset = offsetof(struct ShaderCacheSerializedHeader, shaderDataEnd);
 
-  m_onDiskFile.seek(shaderCountOffset, true);
-  m_onDiskFile.write(&m_totalShaders, sizeof(size_t));
+    m_onDiskFile.seek(shaderCountOffset, true);
+    m_onDiskFile.write(&m_fileShaderCount, sizeof(size_t));
+    m_onDiskFile.seek(dataEndOffset, true);
+    m_onDiskFile.write(&m_shaderDataEnd, sizeof(size_t));
 
-  // Write the new shader data at the current end of the data section
-  m_onDiskFile.seek(static_cast<unsigned>(m_shaderDataEnd), true);
-  m_onDiskFile.write(index->dataBlob, index->header.size);
+    m_onDiskFile.flush();
+  }
 
-  // Then update the data end value and write it out to the file.
-  m_shaderDataEnd += index->header.size;
-  m_onDiskFile.seek(dataEndOffset, true);
-  m_onDiskFile.write(&m_shaderDataEnd, sizeof(size_t));
+  for (ShaderIndex *index : indices)
+    releaseShader(index);
+}
+
+// =====================================================================================================================
+// Starts the thread that appends new shaders to the on-disk file. This function assumes that the on-disk file is open.
+void ShaderCache::startFileWriter() {
+  assert(m_onDiskFile.isOpen() && !m_fileWriter.joinable());
+  m_stopFileWriter = false;
+  m_fileWriter = std::thread([this] { runFileWriter(); });
+}
+
+// =====================================================================================================================
+// Stops the file writer thread, if it is running, after it has written all queued shaders.
+void ShaderCache::stopFileWriter() {
+  if (!m_fileWriter.joinable())
+    return;
+
+  {
+    std::lock_guard<std::mutex> lock(m_fileWriteMutex);
+    m_stopFileWriter = true;
+  }
+  m_fileWriteCondition.notify_one();
+  m_fileWriter.join();
+}
+
+// =====================================================================================================================
+// Main loop of the file writer thread. Shaders queued while the previous batch was being written are appended as one
+// batch, with a single flush of the file. When there is nothing to write and enough of the file is stale, the file is
+// compacted.
+void ShaderCache::runFileWriter() {
+  std::unique_lock<std::mutex> lock(m_fileWriteMutex);
+  while (true) {
+    if (!m_fileWriteQueue.empty()) {
+      std::vector<ShaderIndex *> batch;
+      batch.swap(m_fileWriteQueue);
+      lock.unlock();
+      writeShadersToFile(batch);
+      lock.lock();
+    } else if (m_stopFileWriter)
+      break;
+    else if (needsCompaction()) {
+      lock.unlock();
+      compactCacheFile();
+      lock.lock();
+    } else if (m_hotReorder && isHotWindowOpen()) {
+      // Wake up when the hot window closes, to move the hot shaders to the front of the file.
+      m_fileWriteCondition.wait_until(lock, m_hotWindowEnd);
+    } else
+      m_fileWriteCondition.wait(lock);
+  }
+}
+
+// =====================================================================================================================
+// Returns true if enough of the on-disk file is stale that it should be compacted, or if shaders hit early in this
+// session are to be moved to the front of the file. This function is only called by the file writer thread.
+bool ShaderCache::needsCompaction() const {
+  if (m_hotReorder && !isHotWindowOpen())
+    return true;
+  const size_t staleSize = m_staleFileSize;
+  return staleSize > 0 && staleSize * CompactionStaleRatio >= m_shaderDataEnd - sizeof(ShaderCacheSerializedHeader);
+}
+
+// =====================================================================================================================
+// Compacts the on-disk file: rewrites it keeping only the first copy of each entry whose data matches its CRC, which
+// drops duplicate entries (such as entries evicted from memory and then added again), corrupted entries and any
+// unused space at the end of the file. The shaders recorded as hot are written first, in the order they were hit, and
+// form the hot region of the compacted file. The compacted file is written next to the cache file and then renamed over
+// it, so a mapping of the old file stays valid. This function is only called by the file writer thread.
+Result ShaderCache::compactCacheFile() {
+  lgc::TraceScope traceScope("ShaderCache::compactCacheFile", "cache");
+  assert(m_onDiskFile.isOpen());
+
+  // Whether or not compaction succeeds, do not try again until more of the file becomes stale.
+  const size_t staleSize = m_staleFileSize;
+  m_staleFileSize -= staleSize;
+  m_hotReorder = false;
 
   m_onDiskFile.flush();
+  const size_t dataSize = m_shaderDataEnd - sizeof(ShaderCacheSerializedHeader);
+  auto bufferOrErr = MemoryBuffer::getFileSlice(m_fileFullPath, dataSize, sizeof(ShaderCacheSerializedHeader));
+  if (!bufferOrErr || (*bufferOrErr)->getBufferSize() != dataSize)
+    return Result::ErrorUnknown;
+  const char *const dataStart = (*bufferOrErr)->getBufferStart();
+
+  const std::string compactFilePath = std::string(m_fileFullPath) + ".compact";
+  File compactFile;
+  Result result = compactFile.open(compactFilePath.c_str(), (FileAccessWrite | FileAccessBinary));
+  if (result != Result::Success)
+    return result;
+
+  // Write the header first to reserve its space, and again once the final counts are known.
+  ShaderCacheSerializedHeader header = {};
+  header.headerSize = sizeof(ShaderCacheSerializedHeader);
+  header.shaderDataEnd = header.headerSize;
+  getBuildTime(&header.buildId);
+  header.keyHashAlgorithm = m_keyHashAlgorithm;
+  result = compactFile.write(&header, header.headerSize);
+
+  // Find the first copy of each entry whose data matches its CRC, as offset and size in the file data.
+  std::vector<std::pair<size_t, size_t>> keptEntries;
+  std::unordered_map<uint64_t, size_t> keptKeys;
+  size_t offset = 0;
+  for (size_t shader = 0; shader < m_fileShaderCount; ++shader) {
+    ShaderHeader shaderHeader;
+    if (dataSize - offset < sizeof(ShaderHeader))
+      break;
+    memcpy(&shaderHeader, dataStart + offset, sizeof(ShaderHeader));
+    if (shaderHeader.size < sizeof(ShaderHeader) || shaderHeader.size > dataSize - offset)
+      break;
+
+    const auto *const dataBlob = reinterpret_cast<const uint8_t *>(dataStart + offset + sizeof(ShaderHeader));
+    if (calculateCrc(dataBlob, shaderHeader.size - sizeof(ShaderHeader)) == shaderHeader.crc &&
+        keptKeys.insert({shaderHeader.key, keptEntries.size()}).second)
+      keptEntries.push_back({offset, shaderHeader.size});
+
+    // Move to next entry in file
+    offset += shaderHeader.size;
+  }
+
+  std::vector<bool> written(keptEntries.size());
+  auto writeEntry = [&](size_t entry) {
+    written[entry] = true;
+    result = compactFile.write(dataStart + keptEntries[entry].first, keptEntries[entry].second);
+    ++header.shaderCount;
+    header.shaderDataEnd += keptEntries[entry].second;
+  };
+
+  // The hot shaders go first, then the others in file order.
+  for (uint64_t key : getHotKeys()) {
+    auto keptKey = keptKeys.find(key);
+    if (keptKey == keptKeys.end() || written[keptKey->second] || result != Result::Success)
+      continue;
+    writeEntry(keptKey->second);
+    header.hotDataSize += keptEntries[keptKey->second].second;
+  }
+  for (size_t entry = 0; entry < keptEntries.size() && result == Result::Success; ++entry) {
+    if (!written[entry])
+      writeEntry(entry);
+  }
+
+  if (result == Result::Success) {
+    compactFile.rewind();
+    result = compactFile.write(&header, header.headerSize);
+  }
+  if (result == Result::Success)
+    result = compactFile.flush();
+  compactFile.close();
+
+  if (result == Result::Success) {
+    m_onDiskFile.close();
+    if (sys::fs::rename(compactFilePath, m_fileFullPath))
+      result = Result::ErrorUnknown;
+    if (m_onDiskFile.open(m_fileFullPath, (FileAccessReadUpdate | FileAccessBinary)) != Result::Success)
+      result = Result::ErrorUnknown;
+  }
+
+  if (result == Result::Success) {
+    m_shaderDataEnd = header.shaderDataEnd;
+    m_fileShaderCount = header.shaderCount;
+  } else
+    sys::fs::remove(compactFilePath);
+
+  return result;
 }
 
 // =====================================================================================================================
@@ -670,6 +1351,17 @@ Result ShaderCache::loadCacheFromFile() {
   const size_t dataSize = fileSize - sizeof(ShaderCacheSerializedHeader);
   Result result = validateAndLoadHeader(&header, fileSize);
 
+  if (result == Result::Success) {
+    // Any space beyond the end of the shader data is stale, and is dropped when the file is compacted.
+    m_fileShaderCount = m_totalShaders;
+    m_staleFileSize += fileSize - m_shaderDataEnd;
+  }
+
+  if (result == Result::Success && ShaderCacheMapFile)
+    return loadCacheFromMappedFile(dataSize);
+  if (result == Result::Success && ShaderCacheStreamLoad)
+    return loadCacheIndexFromFile(dataSize);
+
   void *dataMem = nullptr;
   if (result == Result::Success) {
     // The header is valid, so allocate space to fit all of the shader data.
@@ -692,7 +1384,7 @@ Result ShaderCache::loadCacheFromFile() {
 
   if (result == Result::Success) {
     // Now setup the shader index hash map.
-    result = populateIndexMap(dataMem, dataSize);
+    result = populateIndexMap(dataMem, dataSize, ShaderCacheDeferCrc);
   }
 
   if (result != Result::Success) {
@@ -703,6 +1395,291 @@ Result ShaderCache::loadCacheFromFile() {
   return result;
 }
 
+// =====================================================================================================================
+// Maps the shader data of the cache file into memory and builds the index hash map from the shader headers in the
+// mapping. Cached shaders are then handed out directly from the mapping, and the CRC of each entry is only validated
+// when it is first looked up.
+//
+// NOTE: This function assumes that a write lock has already been taken by the calling function and that the header
+// of the on-disk file has been validated.
+//
+// @param dataSize : Size of the shader data following the header in the file
+Result ShaderCache::loadCacheFromMappedFile(size_t dataSize) {
+  assert(!m_mappedFile);
+
+  Result result = Result::Success;
+  auto bufferOrErr = MemoryBuffer::getFileSlice(m_fileFullPath, dataSize, sizeof(ShaderCacheSerializedHeader));
+  if (bufferOrErr && (*bufferOrErr)->getBufferSize() == dataSize) {
+    m_mappedFile = std::move(*bufferOrErr);
+    m_serializedSize += dataSize;
+
+    // The mapping is read-only. Entries in it are never written, only copied from or handed out to callers.
+    result = populateIndexMap(const_cast<char *>(m_mappedFile->getBufferStart()), dataSize, /*deferCrc=*/true);
+    if (result == Result::Success && ShaderCachePrefetchHot)
+      prefetchHotRegion(m_mappedFile->getBufferStart());
+  } else
+    result = Result::ErrorUnknown;
+
+  if (result != Result::Success) {
+    // Something went wrong in loading the file, so reset it
+    resetRuntimeCache();
+    resetCacheFile();
+  }
+
+  return result;
+}
+
+// =====================================================================================================================
+// Builds the index hash map from the shader headers of the cache file, without reading the shader data. The entries
+// are left Compiling until the stream loader thread has read their data into memory, so a lookup of an entry that is
+// not there yet waits for it as for a compile by another thread.
+//
+// NOTE: This function assumes that a write lock has already been taken by the calling function and that the header
+// of the on-disk file has been validated.
+//
+// @param dataSize : Size of the shader data following the header in the file
+Result ShaderCache::loadCacheIndexFromFile(size_t dataSize) {
+  assert(m_streamedShaders.empty());
+
+  // The stream loader thread reads the file through its own handle, as the file writer thread appends to the file
+  // through m_onDiskFile meanwhile.
+  Result result = m_streamFile.open(m_fileFullPath, (FileAccessRead | FileAccessBinary));
+  if (result == Result::Success) {
+    m_streamData = getCacheSpace(dataSize);
+    if (!m_streamData)
+      result = Result::ErrorOutOfMemory;
+  }
+
+  size_t offset = 0;
+  for (size_t shader = 0; shader < m_totalShaders && result == Result::Success; ++shader) {
+    ShaderHeader header;
+    size_t bytesRead = 0;
+    m_onDiskFile.seek(static_cast<int>(sizeof(ShaderCacheSerializedHeader) + offset), true);
+    m_onDiskFile.read(&header, sizeof(ShaderHeader), &bytesRead);
+    if (bytesRead != sizeof(ShaderHeader) || header.size < sizeof(ShaderHeader) || header.size > dataSize - offset) {
+      result = Result::ErrorUnknown;
+      break;
+    }
+
+    ShaderIndex *index = nullptr;
+    auto inserted = getShard(header.key).map.insert({header.key, nullptr});
+    if (inserted.second) {
+      index = new ShaderIndex;
+      index->header = header;
+      index->dataBlob = voidPtrInc(m_streamData, offset);
+      index->state = ShaderEntryState::Compiling;
+      index->crcValidated = false;
+      index->streaming = true;
+      index->inHotRegion = offset < m_hotDataSize;
+      inserted.first->second = index;
+    } else {
+      // A duplicate entry in the on-disk file is stale, and is dropped when the file is compacted.
+      m_staleFileSize += header.size;
+    }
+    m_streamedShaders.push_back({offset, header.size, index});
+
+    // Move to next entry in file
+    offset += header.size;
+  }
+
+  if (result != Result::Success) {
+    // Something went wrong in loading the file, so reset it
+    resetRuntimeCache();
+    resetCacheFile();
+  }
+
+  return result;
+}
+
+// =====================================================================================================================
+// Starts the thread that reads the shader data of the on-disk file whose index loadCacheIndexFromFile() has loaded.
+void ShaderCache::startStreamLoader() {
+  assert(m_streamFile.isOpen() && !m_streamLoader.joinable());
+  m_stopStreamLoader = false;
+  m_streamLoader = std::thread([this] { runStreamLoader(); });
+}
+
+// =====================================================================================================================
+// Stops the stream loader thread, if it is running, without waiting for it to read the rest of the shader data.
+void ShaderCache::stopStreamLoader() {
+  if (!m_streamLoader.joinable())
+    return;
+
+  {
+    std::lock_guard<std::mutex> lock(m_streamMutex);
+    m_stopStreamLoader = true;
+  }
+  m_streamLoader.join();
+}
+
+// =====================================================================================================================
+// Waits for the stream loader thread, if it is running, to read all of the shader data of the on-disk file. This
+// function must not be called with any lock of the cache taken, as the stream loader thread takes the shard locks.
+void ShaderCache::waitForStreamLoader() {
+  if (m_streamLoader.joinable())
+    m_streamLoader.join();
+}
+
+// =====================================================================================================================
+// Main loop of the stream loader thread. The entries are read in file order, except that an entry a lookup is waiting
+// for is read next, so that lookup does not wait for the entries before it in the file.
+void ShaderCache::runStreamLoader() {
+  lgc::TraceScope traceScope("ShaderCache::runStreamLoader", "cache");
+  size_t next = 0;
+  while (true) {
+    ShaderIndex *requested = nullptr;
+    {
+      std::lock_guard<std::mutex> lock(m_streamMutex);
+      if (m_stopStreamLoader)
+        break;
+      if (!m_streamRequests.empty()) {
+        requested = m_streamRequests.back();
+        m_streamRequests.pop_back();
+      }
+    }
+
+    // Only this thread clears the streaming flag of an entry, so it can read the flag without the shard lock.
+    if (requested) {
+      if (requested->streaming) {
+        loadStreamedShader({voidPtrDiff(requested->dataBlob, m_streamData), requested->header.size, requested});
+      }
+      continue;
+    }
+
+    while (next < m_streamedShaders.size() && m_streamedShaders[next].index &&
+           !m_streamedShaders[next].index->streaming)
+      ++next;
+    if (next == m_streamedShaders.size())
+      break;
+    loadStreamedShader(m_streamedShaders[next++]);
+  }
+
+  m_streamFile.close();
+}
+
+// =====================================================================================================================
+// Reads the data of one entry of the on-disk file into memory and validates its CRC. The entry then becomes Ready, or
+// New if its data is corrupted, and the lookups waiting for it are woken. This function is only called by the stream
+// loader thread.
+//
+// @param streamed : Entry to read
+void ShaderCache::loadStreamedShader(const StreamedShader &streamed) {
+  void *const data = voidPtrInc(m_streamData, streamed.offset);
+  size_t bytesRead = 0;
+  m_streamFile.seek(static_cast<int>(sizeof(ShaderCacheSerializedHeader) + streamed.offset), true);
+  m_streamFile.read(data, streamed.size, &bytesRead);
+
+  ShaderIndex *const index = streamed.index;
+  if (!index)
+    return;
+
+  // The CRC is validated here rather than on the first hit, as this is off the path of any lookup.
+  const bool valid =
+      bytesRead == streamed.size &&
+      calculateCrc(static_cast<const uint8_t *>(voidPtrInc(data, sizeof(ShaderHeader))),
+                   streamed.size - sizeof(ShaderHeader)) == index->header.crc;
+
+  ShaderIndexShard &shard = getShard(index->header.key);
+  lockShard(shard, false);
+  index->streaming = false;
+  if (valid) {
+    index->crcValidated = true;
+    index->state = ShaderEntryState::Ready;
+  } else {
+    // The entry is corrupted. Treat it as a miss so it gets compiled again, and let the file writer thread know, as
+    // it may compact the file.
+    {
+      std::lock_guard<std::mutex> lock(m_fileWriteMutex);
+      m_staleFileSize += index->header.size;
+    }
+    m_loadedEntryInvalidated = true;
+    index->state = ShaderEntryState::New;
+    index->header.size = 0;
+    index->dataBlob = nullptr;
+  }
+  unlockShard(shard, false);
+
+  if (!valid && m_fileWriter.joinable())
+    m_fileWriteCondition.notify_one();
+  m_conditionVariable.notify_all();
+}
+
+// =====================================================================================================================
+// Asks the stream loader thread to read the data of an entry next, as a lookup is waiting for it.
+//
+// @param index : Entry whose data is still to be read
+void ShaderCache::requestStreamedShader(ShaderIndex *index) {
+  std::lock_guard<std::mutex> lock(m_streamMutex);
+  m_streamRequests.push_back(index);
+}
+
+// =====================================================================================================================
+// Reads the hot region at the front of the shader data of a mapped cache file, in one sequential pass, and validates
+// the CRC of the entries in it. The hot shaders of the last session are then in memory before they are looked up.
+//
+// NOTE: This function assumes that a write lock has already been taken by the calling function.
+//
+// @param dataStart : Start of the mapped shader data
+void ShaderCache::prefetchHotRegion(const void *dataStart) {
+  lgc::TraceScope traceScope("ShaderCache::prefetchHotRegion", "cache");
+  size_t offset = 0;
+  while (offset < m_hotDataSize) {
+    const auto *const header = static_cast<const ShaderHeader *>(voidPtrInc(dataStart, offset));
+    if (header->size < sizeof(ShaderHeader))
+      break;
+    ShaderIndexMap &indexMapOfShard = getShard(header->key).map;
+    auto indexMap = indexMapOfShard.find(header->key);
+    if (indexMap != indexMapOfShard.end() && indexMap->second->dataBlob == header &&
+        !indexMap->second->crcValidated && !validateDeferredCrc(indexMap->second)) {
+      // The entry is corrupted. Leave it to its first lookup to treat it as a miss.
+      indexMap->second->crcValidated = false;
+    }
+    offset += header->size;
+  }
+}
+
+// =====================================================================================================================
+// Records a shader that was hit or inserted as hot, if that happens early enough in the session. Only the first hit of
+// each shader is recorded.
+//
+// @param index : Entry of the shader
+void ShaderCache::recordHotShader(ShaderIndex *index) {
+  if (!m_recordingHot)
+    return;
+  if (!isHotWindowOpen()) {
+    m_recordingHot = false;
+    return;
+  }
+  if (index->hot.exchange(true))
+    return;
+
+  // A hot shader outside of the hot region of the loaded data means the data needs reordering for the next session.
+  if (!index->inHotRegion && !m_hotReorder) {
+    bool alreadyReordering = false;
+    {
+      std::lock_guard<std::mutex> lock(m_fileWriteMutex);
+      alreadyReordering = m_hotReorder.exchange(true);
+    }
+    if (!alreadyReordering && m_fileWriter.joinable())
+      m_fileWriteCondition.notify_one();
+  }
+  std::lock_guard<std::mutex> lock(m_hotMutex);
+  m_hotKeys.push_back(index->header.key);
+}
+
+// =====================================================================================================================
+// Returns whether shaders that are hit are still recorded as hot.
+bool ShaderCache::isHotWindowOpen() const {
+  return m_recordingHot && std::chrono::steady_clock::now() < m_hotWindowEnd;
+}
+
+// =====================================================================================================================
+// Returns the keys of the shaders recorded as hot so far, in the order they were first hit.
+std::vector<uint64_t> ShaderCache::getHotKeys() {
+  std::lock_guard<std::mutex> lock(m_hotMutex);
+  return m_hotKeys;
+}
+
 // =====================================================================================================================
 // Loads all shader data from a client provided initial data blob. Returns true if the file contents were loaded
 // successfully or false if invalid data was found.
@@ -726,7 +1703,7 @@ Result ShaderCache::loadCacheFromBlob(const void *initialData, size_t initialDat
     if (dataMem) {
       // Then copy the data and setup the shader index hash map.
       memcpy(dataMem, voidPtrInc(initialData, header->headerSize), dataSize);
-      result = populateIndexMap(dataMem, dataSize);
+      result = populateIndexMap(dataMem, dataSize, ShaderCacheDeferCrc);
     } else
       result = Result::ErrorOutOfMemory;
   }
@@ -740,7 +1717,8 @@ Result ShaderCache::loadCacheFromBlob(const void *initialData, size_t initialDat
 //
 // @param dataStart : Start pointer of cached shader data
 // @param dataSize : Shader data size in bytes
-Result ShaderCache::populateIndexMap(void *dataStart, size_t dataSize) {
+// @param deferCrc : Whether to defer CRC validation of each entry until it is first looked up
+Result ShaderCache::populateIndexMap(void *dataStart, size_t dataSize, bool deferCrc) {
   Result result = Result::Success;
 
   // Iterate through all of the entries to verify the data CRC, zero out the GPU memory pointer/offset and add to the
@@ -757,19 +1735,26 @@ Result ShaderCache::populateIndexMap(void *dataStart, size_t dataSize) {
     // The serialized data blob representing each RelocatableShader object immediately follows the header.
     void *const dataBlob = (header + 1);
 
-    // Verify the CRC
-    const uint64_t crc = calculateCrc(static_cast<uint8_t *>(dataBlob), (header->size - sizeof(ShaderHeader)));
+    // Verify the CRC, unless verification is deferred to the first lookup of the entry.
+    const uint64_t crc =
+        deferCrc ? header->crc : calculateCrc(static_cast<uint8_t *>(dataBlob), (header->size - sizeof(ShaderHeader)));
 
     if (crc == header->crc) {
       // It all checks out, so add this shader to the hash map!
       ShaderIndex *index = nullptr;
-      auto indexMap = m_shaderIndexMap.find(header->key);
-      if (indexMap == m_shaderIndexMap.end()) {
+      ShaderIndexMap &indexMapOfShard = getShard(header->key).map;
+      auto indexMap = indexMapOfShard.find(header->key);
+      if (indexMap == indexMapOfShard.end()) {
         index = new ShaderIndex;
         index->header = (*header);
         index->dataBlob = header;
         index->state = ShaderEntryState::Ready;
-        m_shaderIndexMap[header->key] = index;
+        index->crcValidated = !deferCrc;
+        index->inHotRegion = voidPtrDiff(header, dataStart) < m_hotDataSize;
+        indexMapOfShard[header->key] = index;
+      } else if (m_onDiskFile.isOpen()) {
+        // A duplicate entry in the on-disk file is stale, and is dropped when the file is compacted.
+        m_staleFileSize += header->size;
       }
     } else
       result = Result::ErrorUnknown;
@@ -784,11 +1769,24 @@ Result ShaderCache::populateIndexMap(void *dataStart, size_t dataSize) {
 // =====================================================================================================================
 // Caclulates a 64-bit CRC of the data provided
 //
+// The bulk of the data is processed 8 bytes at a time with the slice-by-8 tables; the remaining tail bytes use the
+// byte-at-a-time table.
+//
 // @param data : Data need generate CRC
 // @param numBytes : Data size in bytes
 uint64_t ShaderCache::calculateCrc(const uint8_t *data, size_t numBytes) {
+  static const CrcSliceTables SliceTables;
+  const auto &table = SliceTables.table;
+
   uint64_t crc = CrcInitialValue;
-  for (unsigned byte = 0; byte < numBytes; ++byte) {
+  size_t byte = 0;
+  for (; byte + 8 <= numBytes; byte += 8) {
+    crc = table[7][crc >> 56] ^ table[6][(crc >> 48) & 0xFF] ^ table[5][(crc >> 40) & 0xFF] ^
+          table[4][(crc >> 32) & 0xFF] ^ table[3][(crc >> 24) & 0xFF] ^ table[2][(crc >> 16) & 0xFF] ^
+          table[1][(crc >> 8) & 0xFF] ^ table[0][crc & 0xFF] ^ support::endian::read64be(data + byte);
+  }
+
+  for (; byte < numBytes; ++byte) {
     uint8_t tableIndex = static_cast<uint8_t>(crc >> (CrcWidth - 8)) & 0xFF;
     crc = (crc << 8) ^ CrcLookup[tableIndex] ^ data[byte];
   }
@@ -796,6 +1794,56 @@ uint64_t ShaderCache::calculateCrc(const uint8_t *data, size_t numBytes) {
   return crc;
 }
 
+// =====================================================================================================================
+// Validates the CRC of a shader cache entry whose validation was deferred at load time. This function assumes that
+// the exclusive lock of the entry's shard has been taken by the calling function.
+//
+// Returns true if the entry's data matches its CRC.
+//
+// @param index : Shader cache entry to validate
+bool ShaderCache::validateDeferredCrc(ShaderIndex *index) {
+  assert(index->state == ShaderEntryState::Ready && !index->crcValidated);
+  const auto *const dataBlob = static_cast<const uint8_t *>(voidPtrInc(index->dataBlob, sizeof(ShaderHeader)));
+  const uint64_t crc = calculateCrc(dataBlob, index->header.size - sizeof(ShaderHeader));
+  index->crcValidated = true;
+  return crc == index->header.crc;
+}
+
+// =====================================================================================================================
+// Decompresses the data blob of a Ready entry that is stored compressed into a buffer owned by the entry, which
+// retrieveShader() returns. This is done once, on the first hit of the entry, and assumes that the exclusive lock of
+// the entry's shard has been taken by the calling function. The decompressed data counts towards the memory budget of
+// the cache if the entry can be evicted.
+//
+// Returns false if the data blob cannot be decompressed.
+//
+// @param index : Shader cache entry to decompress
+bool ShaderCache::decompressEntryData(ShaderIndex *index) {
+  assert(index->state == ShaderEntryState::Ready);
+  if (index->header.codec == ShaderCacheCodec::None || index->rawData)
+    return true;
+  if (index->header.codec != ShaderCacheCodec::Zlib || !zlib::isAvailable())
+    return false;
+
+  StringRef compressedBlob(static_cast<const char *>(voidPtrInc(index->dataBlob, sizeof(ShaderHeader))),
+                           index->header.size - sizeof(ShaderHeader));
+  std::unique_ptr<uint8_t[]> rawData(new uint8_t[index->header.rawSize]);
+  size_t rawSize = index->header.rawSize;
+  if (Error err = zlib::uncompress(compressedBlob, reinterpret_cast<char *>(rawData.get()), rawSize)) {
+    consumeError(std::move(err));
+    return false;
+  }
+  if (rawSize != index->header.rawSize)
+    return false;
+
+  index->rawData = std::move(rawData);
+  if (index->ownsDataBlob) {
+    std::lock_guard<sys::Mutex> dataLock(m_dataLock);
+    m_evictableSize += index->header.rawSize;
+  }
+  return true;
+}
+
 // =====================================================================================================================
 // Validates the provided header and stores the data contained within it if valid.
 //
@@ -813,10 +1861,12 @@ Result ShaderCache::validateAndLoadHeader(const ShaderCacheSerializedHeader *hea
       memcmp(header->buildId.buildDate, buildId.buildDate, sizeof(buildId.buildDate)) == 0 &&
       memcmp(header->buildId.buildTime, buildId.buildTime, sizeof(buildId.buildTime)) == 0 &&
       memcmp(&header->buildId.gfxIp, &buildId.gfxIp, sizeof(buildId.gfxIp)) == 0 &&
-      memcmp(&header->buildId.hash, &buildId.hash, sizeof(buildId.hash)) == 0) {
+      memcmp(&header->buildId.hash, &buildId.hash, sizeof(buildId.hash)) == 0 &&
+      header->keyHashAlgorithm == m_keyHashAlgorithm) {
     // The header appears valid so copy the header data to the runtime cache
     m_totalShaders = header->shaderCount;
     m_shaderDataEnd = header->shaderDataEnd;
+    m_hotDataSize = header->hotDataSize;
   } else
     result = Result::ErrorUnknown;
 
@@ -824,12 +1874,14 @@ Result ShaderCache::validateAndLoadHeader(const ShaderCacheSerializedHeader *hea
   // if the shaderDataEnd is beyond the end of the file we have a problem.
   if (result == Result::Success && m_shaderDataEnd > dataSourceSize)
     result = Result::ErrorUnknown;
+  if (result == Result::Success && m_hotDataSize > dataSourceSize - sizeof(ShaderCacheSerializedHeader))
+    result = Result::ErrorUnknown;
 
   return result;
 }
 
 // =====================================================================================================================
-// Allocates memory from the shader cache's linear allocator. This function assumes that a write lock has been taken by
+// Allocates memory from the shader cache's linear allocator. This function assumes that m_dataLock has been taken by
 // the calling function.
 //
 // @param numBytes : Allocation size in bytes
@@ -840,6 +1892,146 @@ void *ShaderCache::getCacheSpace(size_t numBytes) {
   return p;
 }
 
+// =====================================================================================================================
+// Allocates a data blob of index->header.size bytes that is owned by the entry, and adds the entry to the CLOCK list,
+// making it a candidate for eviction. This function assumes that m_dataLock has been taken by the calling function.
+//
+// @param index : Shader cache entry to allocate the data blob for
+void ShaderCache::allocateEntrySpace(ShaderIndex *index) {
+  assert(!index->ownsDataBlob);
+  index->dataBlob = new uint8_t[index->header.size];
+  index->ownsDataBlob = true;
+  trackEntrySpace(index);
+}
+
+// =====================================================================================================================
+// Adds an entry that owns its data blob to the CLOCK list and accounts for the size of the data blob. This function
+// assumes that m_dataLock has been taken by the calling function.
+//
+// @param index : Shader cache entry that owns its data blob
+void ShaderCache::trackEntrySpace(ShaderIndex *index) {
+  assert(index->ownsDataBlob);
+  index->clockSlot = m_clockEntries.size();
+  m_clockEntries.push_back(index);
+  m_evictableSize += index->header.size;
+  m_serializedSize += index->header.size;
+}
+
+// =====================================================================================================================
+// Frees the data blob owned by an entry and removes the entry from the CLOCK list. This function assumes that
+// m_dataLock has been taken by the calling function.
+//
+// @param index : Shader cache entry to free the data blob of
+void ShaderCache::freeEntrySpace(ShaderIndex *index) {
+  assert(index->ownsDataBlob && m_clockEntries[index->clockSlot] == index);
+  ShaderIndex *lastEntry = m_clockEntries.back();
+  lastEntry->clockSlot = index->clockSlot;
+  m_clockEntries[index->clockSlot] = lastEntry;
+  m_clockEntries.pop_back();
+
+  m_evictableSize -= index->header.size;
+  m_serializedSize -= index->header.size;
+  if (index->rawData) {
+    m_evictableSize -= index->header.rawSize;
+    index->rawData.reset();
+  }
+  delete[] static_cast<uint8_t *>(index->dataBlob);
+  index->dataBlob = nullptr;
+  index->ownsDataBlob = false;
+}
+
+// =====================================================================================================================
+// Evicts Ready entries that own their data blob until the cache is within the budget set by -shader-cache-max-size,
+// using the CLOCK algorithm: the hand skips (and clears the reference bit of) entries that were hit since it last
+// passed them, and skips entries pinned by a handle. Entries that are mirrored to the on-disk file stay in the file.
+void ShaderCache::evictEntries() {
+  const size_t budget = static_cast<size_t>(ShaderCacheMaxSize) << 20;
+  if (budget == 0)
+    return;
+
+  std::unique_lock<sys::Mutex> dataLock(m_dataLock);
+  // Each entry is considered at most twice, once to clear its reference bit and once to evict it, so give up after
+  // that if the remaining entries are all pinned.
+  for (size_t step = 0; m_evictableSize > budget && step < 2 * m_clockEntries.size(); ++step) {
+    if (m_clockHand >= m_clockEntries.size())
+      m_clockHand = 0;
+    ShaderIndex *candidate = m_clockEntries[m_clockHand];
+    if (candidate->referenced.exchange(false) || candidate->pinCount > 0 ||
+        candidate->state != ShaderEntryState::Ready) {
+      ++m_clockHand;
+      continue;
+    }
+
+    // The shard lock has to be taken before the data lock. Once both are held, look the entry up again by its key,
+    // as another thread may have evicted it, or been handed it for a hit, in the meantime.
+    const uint64_t hashKey = candidate->header.key;
+    ShaderIndexShard &shard = getShard(hashKey);
+    dataLock.unlock();
+    lockShard(shard, false);
+    dataLock.lock();
+
+    auto indexMap = shard.map.find(hashKey);
+    if (indexMap != shard.map.end()) {
+      ShaderIndex *index = indexMap->second;
+      if (index->ownsDataBlob && index->state == ShaderEntryState::Ready && index->pinCount == 0 &&
+          !index->referenced) {
+        freeEntrySpace(index);
+        shard.map.erase(indexMap);
+        delete index;
+        ++m_evictionCount;
+        --m_totalShaders;
+      }
+    }
+    unlockShard(shard, false);
+  }
+}
+
+// =====================================================================================================================
+// Locks one shard of the shader index map.
+//
+// @param shard : Shard to lock
+// @param readOnly : Whether a shared (read-only) lock is sufficient
+void ShaderCache::lockShard(ShaderIndexShard &shard, bool readOnly) {
+  // Only a wait for the lock is traced, so that taking an uncontended lock on this hot path records no event.
+  if (readOnly ? shard.lock.try_lock_shared() : shard.lock.try_lock())
+    return;
+  lgc::TraceScope traceScope("ShaderCache wait for shard lock", "lock");
+  if (readOnly)
+    shard.lock.lock_shared();
+  else
+    shard.lock.lock();
+}
+
+// =====================================================================================================================
+// Unlocks one shard of the shader index map.
+//
+// @param shard : Shard to unlock
+// @param readOnly : Whether the shard was locked with a shared (read-only) lock
+void ShaderCache::unlockShard(ShaderIndexShard &shard, bool readOnly) {
+  if (readOnly)
+    shard.lock.unlock_shared();
+  else
+    shard.lock.unlock();
+}
+
+// =====================================================================================================================
+// Locks the whole shader index map by locking all of its shards in ascending order.
+//
+// @param readOnly : Whether a shared (read-only) lock is sufficient
+void ShaderCache::lockCacheMap(bool readOnly) {
+  for (ShaderIndexShard &shard : m_shaderIndexShards)
+    lockShard(shard, readOnly);
+}
+
+// =====================================================================================================================
+// Unlocks the whole shader index map.
+//
+// @param readOnly : Whether the shards were locked with a shared (read-only) lock
+void ShaderCache::unlockCacheMap(bool readOnly) {
+  for (ShaderIndexShard &shard : m_shaderIndexShards)
+    unlockShard(shard, readOnly);
+}
+
 // =====================================================================================================================
 // Returns the time & date that pipeline.cpp was compiled.
 //
@@ -859,7 +2051,8 @@ void ShaderCache::getBuildTime(BuildUniqueId *buildId) {
 // @param auxCreateInfo : Shader cache auxiliary info (static fields)
 bool ShaderCache::isCompatible(const ShaderCacheCreateInfo *createInfo, const ShaderCacheAuxCreateInfo *auxCreateInfo) {
   // Check hash first
-  bool isCompatible = (memcmp(&(auxCreateInfo->hash), &m_hash, sizeof(m_hash)) == 0);
+  bool isCompatible = (memcmp(&(auxCreateInfo->hash), &m_hash, sizeof(m_hash)) == 0) &&
+                      auxCreateInfo->keyHashAlgorithm == m_keyHashAlgorithm;
 
   return isCompatible && m_gfxIp.major == auxCreateInfo->gfxIp.major && m_gfxIp.minor == auxCreateInfo->gfxIp.minor &&
          m_gfxIp.stepping == auxCreateInfo->gfxIp.stepping;
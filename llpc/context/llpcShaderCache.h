@@ -34,19 +34,33 @@
 #include "llpcFile.h"
 #include "llpcUtil.h"
 #include "vkgcMetroHash.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Mutex.h"
+#include "llvm/Support/RWMutex.h"
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <list>
 #include <mutex>
+#include <thread>
 #include <unordered_map>
+#include <vector>
 
 namespace Llpc {
 
+// Enumerates the codecs that the data of a shader cache entry can be compressed with.
+enum class ShaderCacheCodec : uint32_t {
+  None = 0, // Stored as is
+  Zlib = 1, // Compressed with zlib
+};
+
 // Header data that is stored with each shader in the cache.
 struct ShaderHeader {
-  uint64_t key; // Compacted hash key used to identify shaders
-  uint64_t crc; // CRC of the shader cache entry, used to detect data corruption.
-  size_t size;  // Total size of the shader data in the storage file
+  uint64_t key;           // Compacted hash key used to identify shaders
+  uint64_t crc;           // CRC of the shader cache entry, used to detect data corruption.
+  size_t size;            // Total size of the shader data in the storage file
+  ShaderCacheCodec codec; // Codec the shader data is compressed with
+  size_t rawSize;         // Size of the shader data once decompressed, if it is compressed
 };
 
 // Enum defining the states a shader cache entry can be in
@@ -57,6 +71,8 @@ enum class ShaderEntryState : unsigned {
   Unavailable = 3, // Entry doesn't exist in cache
 };
 
+class SharedShaderCache;
+
 // Enumerates modes used in shader cache.
 enum ShaderCacheMode {
   ShaderCacheDisable = 0,                  // Disabled
@@ -64,26 +80,60 @@ enum ShaderCacheMode {
   ShaderCacheEnableOnDisk = 2,             // Enabled with on-disk file
   ShaderCacheForceInternalCacheOnDisk = 3, // Force to use internal cache on disk
   ShaderCacheEnableOnDiskReadOnly = 4,     // Only read on-disk file with write-protection
+  ShaderCacheEnableShared = 5,             // Enabled with a shared memory segment used by all processes
 };
 
 // Stores data in the hash map of cached shaders and helps correlated a shader in the hash to a location in the
 // cache's linear allocators where the shader is actually stored.
+//
+// An entry whose data blob has its own allocation (rather than living inside the data loaded from a file or blob) can
+// be evicted when the cache is over its memory budget, unless it is pinned by a handle returned for a hit.
 struct ShaderIndex {
-  ShaderHeader header;             // Shader header data (key, crc, size)
-  volatile ShaderEntryState state; // Shader entry state
-  void *dataBlob;                  // Serialized data blob representing a cached RelocatableShader object.
+  ShaderHeader header;                 // Shader header data (key, crc, size)
+  volatile ShaderEntryState state;     // Shader entry state
+  void *dataBlob;                      // Serialized data blob representing a cached RelocatableShader object.
+  std::unique_ptr<uint8_t[]> rawData;  // Decompressed shader data, if the data blob is compressed
+  bool crcValidated;                   // Whether the data blob has been checked against header.crc
+  bool ownsDataBlob = false;           // Whether the data blob has its own allocation
+  size_t clockSlot = 0;                // Index of the entry in m_clockEntries, if it owns its data blob
+  std::atomic<bool> referenced{false}; // CLOCK reference bit, set by every hit on the entry
+  std::atomic<unsigned> pinCount{0};   // Count of handles that keep the entry from being evicted
+  unsigned waiterCount = 0;            // Count of threads waiting for the entry to be compiled
+  bool streaming = false;              // Whether the entry's data is still to be read by the stream loader thread
+  bool inHotRegion = false;            // Whether the entry was loaded from the hot region at the front of the data
+  std::atomic<bool> hot{false};        // Whether the entry was recorded as hit early in this session
+  // Priority of the thread compiling the entry, raised to that of the most urgent waiter
+  PipelineJobPriority priority = PipelineJobPriority::OnDemand;
+};
+
+// An entry of the on-disk file whose data is read by the stream loader thread, after init() has loaded the index.
+struct StreamedShader {
+  size_t offset;      // Offset of the entry's header from the start of the shader data
+  size_t size;        // Size of the entry, including its header
+  ShaderIndex *index; // Index of the entry, or nullptr if the entry is a stale duplicate
 };
 
 // The key in hash map is a 64-bit compacted Shader Hash
 typedef std::unordered_map<uint64_t, ShaderIndex *> ShaderIndexMap;
 
+// Number of shards the shader index map is split into. Must be a power of two.
+static constexpr unsigned ShaderIndexShardCount = 16;
+
+// One shard of the shader index map. Each shard has its own read/write lock, so cache hits on different shards never
+// contend, and cache hits on the same shard only contend with inserts into that shard.
+struct ShaderIndexShard {
+  llvm::sys::RWMutex lock; // Read/Write lock for access to this shard's hash map
+  ShaderIndexMap map;      // Hash map of the shader index data that falls into this shard
+};
+
 // Specifies auxiliary info necessary to create a shader cache object.
 struct ShaderCacheAuxCreateInfo {
-  ShaderCacheMode shaderCacheMode; // Mode of shader cache
-  GfxIpVersion gfxIp;              // Graphics IP version info
-  MetroHash::Hash hash;            // Hash code of compilation options
-  const char *cacheFilePath;       // root directory of cache file
-  const char *executableName;      // Name of executable file
+  ShaderCacheMode shaderCacheMode;           // Mode of shader cache
+  GfxIpVersion gfxIp;                        // Graphics IP version info
+  MetroHash::Hash hash;                      // Hash code of compilation options
+  MetroHash::HashAlgorithm keyHashAlgorithm; // Hash algorithm of the keys of the cache
+  const char *cacheFilePath;                 // root directory of cache file
+  const char *executableName;                // Name of executable file
 };
 
 // Length of date field used in BuildUniqueId
@@ -105,15 +155,30 @@ struct BuildUniqueId {
 
 // This the header for the shader cache data when the cache is serialized/written to disk
 struct ShaderCacheSerializedHeader {
-  size_t headerSize;     // Size of the header structure. This member must always be first
-                         // since it is used to validate the serialized data.
-  BuildUniqueId buildId; // Build time/date of the PAL version that created the cache file
-  size_t shaderCount;    // Number of shaders in the shaderIndex array
-  size_t shaderDataEnd;  // Offset to the end of shader data
+  size_t headerSize;                         // Size of the header structure. This member must always be first
+                                             // since it is used to validate the serialized data.
+  BuildUniqueId buildId;                     // Build time/date of the PAL version that created the cache file
+  size_t shaderCount;                        // Number of shaders in the shaderIndex array
+  size_t shaderDataEnd;                      // Offset to the end of shader data
+  size_t hotDataSize;                        // Size of the shader data at the front that was hit early in a session
+  MetroHash::HashAlgorithm keyHashAlgorithm; // Hash algorithm of the keys of the shaders
 };
 
 constexpr unsigned MaxFilePathLen = 512;
 
+// Counters of a shader cache, for tuning its memory budget
+struct ShaderCacheCounters {
+  uint64_t hits;        // Lookups that found a Ready entry
+  uint64_t misses;      // Lookups that did not find a Ready entry
+  uint64_t waits;       // Lookups that waited for another thread compiling the entry
+  double waitTime;      // Total wall-clock time of those waits, in seconds
+  uint64_t bytesStored; // Bytes of shader data inserted into the cache
+  uint64_t evictions;   // Entries evicted to keep the cache within its memory budget
+  size_t evictableSize; // Current size in bytes of the data of the entries that can be evicted
+  uint64_t maxWaiters;  // Most threads that waited at once for one entry to be compiled
+  uint64_t boosts;      // Waits of a more urgent thread on an entry compiled by a prefetch build
+};
+
 typedef void *CacheEntryHandle;
 
 // =====================================================================================================================
@@ -139,6 +204,16 @@ public:
 
   Result retrieveShader(CacheEntryHandle hEntry, const void **ppBlob, size_t *size);
 
+  void releaseShader(CacheEntryHandle hEntry);
+
+  void prefetchShader(MetroHash::Hash hash);
+
+  bool isShaderCompiling(MetroHash::Hash hash);
+
+  ShaderCacheCounters getCounters();
+
+  static uint64_t calculateCrc(const uint8_t *data, size_t numBytes);
+
   bool isCompatible(const ShaderCacheCreateInfo *createInfo, const ShaderCacheAuxCreateInfo *auxCreateInfo);
 
 private:
@@ -149,43 +224,114 @@ private:
                        bool *cacheFileExists);
   Result validateAndLoadHeader(const ShaderCacheSerializedHeader *header, size_t dataSourceSize);
   Result loadCacheFromBlob(const void *initialData, size_t initialDataSize);
-  Result populateIndexMap(void *dataStart, size_t dataSize);
-  uint64_t calculateCrc(const uint8_t *data, size_t numBytes);
+  Result populateIndexMap(void *dataStart, size_t dataSize, bool deferCrc);
+  static Result copyDataParallel(const std::vector<std::pair<const void *, size_t>> &copyList, void *dst,
+                                 size_t dstSize);
+  bool validateDeferredCrc(ShaderIndex *index);
+  bool decompressEntryData(ShaderIndex *index);
 
   Result loadCacheFromFile();
+  Result loadCacheFromMappedFile(size_t dataSize);
+  Result loadCacheIndexFromFile(size_t dataSize);
+  void startStreamLoader();
+  void stopStreamLoader();
+  void waitForStreamLoader();
+  void runStreamLoader();
+  void loadStreamedShader(const StreamedShader &streamed);
+  void requestStreamedShader(ShaderIndex *index);
+  void prefetchHotRegion(const void *dataStart);
+
+  void recordHotShader(ShaderIndex *index);
+  bool isHotWindowOpen() const;
+  std::vector<uint64_t> getHotKeys();
   void resetCacheFile();
-  void addShaderToFile(const ShaderIndex *index);
+  void queueShaderForFile(ShaderIndex *index);
+  void writeShadersToFile(const std::vector<ShaderIndex *> &indices);
+  void startFileWriter();
+  void stopFileWriter();
+  void runFileWriter();
+  bool needsCompaction() const;
+  Result compactCacheFile();
 
   void *getCacheSpace(size_t numBytes);
+  void allocateEntrySpace(ShaderIndex *index);
+  void trackEntrySpace(ShaderIndex *index);
+  void freeEntrySpace(ShaderIndex *index);
+  void evictEntries();
+
+  // Gets the shard of the shader index map that the specified key belongs to
+  ShaderIndexShard &getShard(uint64_t hashKey) { return m_shaderIndexShards[hashKey & (ShaderIndexShardCount - 1)]; }
 
-  // Lock cache map
-  void lockCacheMap(bool readOnly) { m_lock.lock(); }
+  void lockShard(ShaderIndexShard &shard, bool readOnly);
+  void unlockShard(ShaderIndexShard &shard, bool readOnly);
 
-  // Unlock cache map
-  void unlockCacheMap(bool readOnly) { m_lock.unlock(); }
+  void lockCacheMap(bool readOnly);
+  void unlockCacheMap(bool readOnly);
 
   bool useExternalCache() { return m_getValueFunc && m_storeValueFunc; }
 
   void resetRuntimeCache();
   void getBuildTime(BuildUniqueId *buildId);
 
-  llvm::sys::Mutex m_lock; // Read/Write lock for access to the shader cache hash map
-  File m_onDiskFile;       // File for on-disk storage of the cache
-  bool m_disableCache;     // Whether disable cache completely
+  // Lock for the cache data storage: m_allocationList, m_clockEntries, m_serializedSize and m_totalShaders. When both
+  // are needed, a shard lock is always taken before this lock.
+  //
+  // The on-disk file, m_shaderDataEnd and m_fileShaderCount are only accessed by init() and Destroy(), under the locks
+  // of the whole cache, and in between by the file writer thread, so they need no lock of their own.
+  llvm::sys::Mutex m_dataLock;
+  File m_onDiskFile;   // File for on-disk storage of the cache
+  bool m_disableCache; // Whether disable cache completely
 
   // Map of shader index data which detail the hash, crc, size and CPU memory location for each shader
-  // in the cache.
-  ShaderIndexMap m_shaderIndexMap;
+  // in the cache, split into shards by hash key.
+  ShaderIndexShard m_shaderIndexShards[ShaderIndexShardCount];
 
-  // In memory copy of the shaderDataEnd and totalShaders stored in the on-disk file. We keep a copy to avoid having
+  // In memory copy of the shaderDataEnd and shaderCount stored in the on-disk file. We keep a copy to avoid having
   //  to do a read/modify/write of the value when adding a new shader.
   size_t m_shaderDataEnd;
-  size_t m_totalShaders;
+  size_t m_fileShaderCount;
+  size_t m_totalShaders; // Number of shaders in the serialized data of the cache
+
+  std::atomic<size_t> m_staleFileSize;          // Size of the data in the on-disk file that compaction would remove
+  std::thread m_fileWriter;                     // Thread that appends new shaders to the on-disk file
+  std::mutex m_fileWriteMutex;                  // Mutex for m_fileWriteQueue and m_stopFileWriter
+  std::condition_variable m_fileWriteCondition; // Condition variable that wakes the file writer thread
+  std::vector<ShaderIndex *> m_fileWriteQueue;  // Pinned entries waiting to be appended to the on-disk file
+  bool m_stopFileWriter;                        // Whether the file writer thread is to exit once the queue is empty
+
+  File m_streamFile;                             // File the stream loader thread reads the shader data from
+  void *m_streamData;                            // Memory the stream loader thread reads the shader data into
+  std::vector<StreamedShader> m_streamedShaders; // Entries of the on-disk file, in file order, to be streamed in
+  std::thread m_streamLoader;                    // Thread that reads the shader data of the on-disk file
+  std::mutex m_streamMutex;                      // Mutex for m_streamRequests and m_stopStreamLoader
+  std::vector<ShaderIndex *> m_streamRequests;   // Entries still to be streamed in that a lookup is waiting for
+  bool m_stopStreamLoader;                       // Whether the stream loader thread is to exit before it is done
+
+  size_t m_hotDataSize;                                 // Size of the hot region at the front of the loaded data
+  std::chrono::steady_clock::time_point m_hotWindowEnd; // End of the period in which hits are recorded as hot
+  std::atomic<bool> m_recordingHot;                     // Whether hits are recorded as hot
+  std::atomic<bool> m_hotReorder;                       // Whether a hot shader lies outside of the hot region
+  std::atomic<bool> m_loadedEntryInvalidated;           // Whether a corrupted entry's data is in the loaded memory
+  std::mutex m_hotMutex;                                // Mutex for m_hotKeys
+  std::vector<uint64_t> m_hotKeys;                      // Keys of the shaders recorded as hot, in hit order
 
   char m_fileFullPath[MaxFilePathLen]; // Full path/filename of the shader cache on-disk file
 
   std::list<std::pair<uint8_t *, size_t>> m_allocationList; // Memory allcoated by GetCacheSpace
-  unsigned m_serializedSize;                                // Serialized byte size of whole shader cache
+  std::unique_ptr<llvm::MemoryBuffer> m_mappedFile;         // Shader data mapped from the on-disk file
+  std::unique_ptr<SharedShaderCache> m_sharedCache;         // Shared memory segment used as the external cache
+  std::vector<ShaderIndex *> m_clockEntries;                // Entries that own their data blob, in CLOCK order
+  size_t m_clockHand;                                       // Next entry in m_clockEntries considered for eviction
+  size_t m_evictableSize;                                   // Total data size of the entries in m_clockEntries
+  std::atomic<uint64_t> m_hitCount;                         // Count of lookups that found a Ready entry
+  std::atomic<uint64_t> m_missCount;                        // Count of lookups that did not find a Ready entry
+  std::atomic<uint64_t> m_waitCount;                        // Count of lookups that waited for a Compiling entry
+  std::atomic<uint64_t> m_waitNanoseconds;                  // Total time of those waits, in nanoseconds
+  std::atomic<uint64_t> m_bytesStored;                      // Bytes of shader data inserted
+  std::atomic<uint64_t> m_evictionCount;                    // Count of entries evicted
+  std::atomic<uint64_t> m_maxWaiters;                       // Most threads that waited at once for one entry
+  std::atomic<uint64_t> m_boostCount;                       // Count of waits that boosted a prefetch compile
+  size_t m_serializedSize;                                  // Serialized byte size of whole shader cache
   std::mutex m_conditionMutex;                              // Mutex that will be used with the condition variable
   std::condition_variable m_conditionVariable; // Condition variable that will be used to wait compile finish
   const void *m_clientData;                    // Client data that will be used by function GetValue and StoreValue
@@ -193,6 +339,7 @@ private:
   ShaderCacheStoreValue m_storeValueFunc;      // StoreValue function used to store shader data in an external cache
   GfxIpVersion m_gfxIp;                        // Graphics IP version info
   MetroHash::Hash m_hash;                      // Hash code of compilation options
+  MetroHash::HashAlgorithm m_keyHashAlgorithm; // Hash algorithm of the keys of the cache
 };
 
 } // namespace Llpc
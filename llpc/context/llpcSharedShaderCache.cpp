@@ -0,0 +1,304 @@
+/*
+ ***********************************************************************************************************************
+ *
+ *  Copyright (c) 2020 Advanced Micro Devices, Inc. All Rights Reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ **********************************************************************************************************************/
+/**
+***********************************************************************************************************************
+@file llpcSharedShaderCache.cpp
+@brief LLPC source file: contains implementation of class Llpc::SharedShaderCache.
+***********************************************************************************************************************
+*/
+#include "llpcSharedShaderCache.h"
+#include "vkgcUtil.h"
+#include "llvm/Support/MathExtras.h"
+#include <chrono>
+#include <errno.h>
+#include <string.h>
+#include <thread>
+#if defined(__unix__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace llvm;
+
+namespace Llpc {
+
+// Magic number and version of the layout of the shared memory segment
+static constexpr uint32_t SharedCacheMagic = 0x4353504C; // "LPSC"
+static constexpr uint32_t SharedCacheVersion = 1;
+
+// Expected average size of a cache entry, used to size the index of the segment
+static constexpr size_t SharedCacheAverageEntrySize = 16 * 1024;
+
+// Minimum number of slots in the index of the segment
+static constexpr uint32_t SharedCacheMinSlotCount = 1024;
+
+// Time to wait for the process that created the segment to initialize it
+static constexpr std::chrono::milliseconds SharedCacheInitTimeout(1000);
+
+// States of an index slot
+enum SlotState : uint32_t {
+  SlotFree = 0,   // The slot is not claimed, or its key is claimed but the data is not written yet
+  SlotReady = 1,  // The data of the entry is written and may be read
+  SlotFailed = 2, // The data area was full when storing the entry
+};
+
+// Header of the shared memory segment. The creator of the segment fills it in, and then publishes it by storing the
+// magic number. The rest of the segment is zero when it is created.
+struct SharedShaderCache::SegmentHeader {
+  std::atomic<uint32_t> magic;   // SharedCacheMagic once the header is initialized
+  uint32_t version;              // SharedCacheVersion
+  BuildUniqueId buildId;         // ID of the build of LLPC, GFXIP and compilation options the segment is for
+  uint64_t segmentSize;          // Size of the whole segment
+  uint32_t slotCount;            // Number of slots in the index, a power of two
+  uint32_t reserved;             // Reserved
+  uint64_t dataStart;            // Offset of the data area
+  std::atomic<uint64_t> dataEnd; // Offset of the end of the allocated part of the data area
+};
+
+// A slot of the index of the shared memory segment
+struct SharedShaderCache::IndexSlot {
+  std::atomic<uint64_t> key;   // Key of the entry, or 0 if the slot is free
+  std::atomic<uint32_t> state; // SlotState of the entry
+  uint32_t reserved;           // Reserved
+  uint64_t offset;             // Offset of the data of the entry in the segment, valid once the state is SlotReady
+  uint64_t size;               // Size of the data of the entry, valid once the state is SlotReady
+};
+
+// =====================================================================================================================
+SharedShaderCache::~SharedShaderCache() {
+#if defined(__unix__)
+  munmap(m_segment, m_segmentSize);
+#endif
+}
+
+// =====================================================================================================================
+// Opens the shared memory segment for the specified build ID, creating and initializing it if no process has done so
+// yet. Returns nullptr if the segment cannot be used, in which case the caller goes on without it.
+//
+// The segment is private to the user: its name includes the user ID, it is created with mode 0600, and one that is
+// owned by another user is not used. If its creator does not initialize it in time, it is unlinked, so that the next
+// process to open it creates it again.
+//
+// @param buildId : ID of the build of LLPC, GFXIP and compilation options
+// @param segmentSize : Size of the segment to create
+SharedShaderCache *SharedShaderCache::open(const BuildUniqueId &buildId, size_t segmentSize) {
+#if defined(__unix__)
+  MetroHash::Hash buildHash = {};
+  MetroHash64::Hash(reinterpret_cast<const uint8_t *>(&buildId), sizeof(buildId), buildHash.bytes);
+  char name[64];
+  snprintf(name, sizeof(name), "/AMD_LlpcCache_%u_%016llx", static_cast<unsigned>(getuid()),
+           static_cast<unsigned long long>(MetroHash::compact64(&buildHash)));
+
+  const uint32_t slotCount =
+      std::max(SharedCacheMinSlotCount, static_cast<uint32_t>(PowerOf2Ceil(segmentSize / SharedCacheAverageEntrySize)));
+  const uint64_t dataStart = alignTo(sizeof(SegmentHeader) + slotCount * sizeof(IndexSlot), 4096);
+  if (segmentSize <= dataStart)
+    return nullptr;
+
+  // Exactly one process succeeds in creating the segment, and initializes it.
+  bool created = true;
+  int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd < 0 && errno == EEXIST) {
+    created = false;
+    fd = shm_open(name, O_RDWR, 0600);
+  }
+  if (fd < 0)
+    return nullptr;
+
+  struct stat fileStat = {};
+  if (fstat(fd, &fileStat) != 0 || fileStat.st_uid != getuid() || (fileStat.st_mode & (S_IRWXG | S_IRWXO)) != 0) {
+    close(fd);
+    return nullptr;
+  }
+
+  if (created) {
+    if (ftruncate(fd, segmentSize) != 0) {
+      close(fd);
+      shm_unlink(name);
+      return nullptr;
+    }
+  } else {
+    // The segment of another process has the size that process asked for, which takes precedence. Wait for the
+    // creator to set it.
+    const auto deadline = std::chrono::steady_clock::now() + SharedCacheInitTimeout;
+    while (fstat(fd, &fileStat) == 0 && fileStat.st_size == 0 && std::chrono::steady_clock::now() < deadline)
+      std::this_thread::yield();
+    segmentSize = static_cast<size_t>(fileStat.st_size);
+    if (segmentSize < sizeof(SegmentHeader)) {
+      close(fd);
+      if (segmentSize == 0)
+        shm_unlink(name);
+      return nullptr;
+    }
+  }
+
+  void *segment = mmap(nullptr, segmentSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (segment == MAP_FAILED)
+    return nullptr;
+
+  SharedShaderCache *sharedCache = new SharedShaderCache(segment, segmentSize);
+  SegmentHeader *header = sharedCache->getHeader();
+  // The atomics in the segment only work across processes if they are lock free.
+  if (!header->dataEnd.is_lock_free() || !header->magic.is_lock_free()) {
+    delete sharedCache;
+    return nullptr;
+  }
+
+  if (created) {
+    header->version = SharedCacheVersion;
+    header->buildId = buildId;
+    header->segmentSize = segmentSize;
+    header->slotCount = slotCount;
+    header->dataStart = dataStart;
+    header->dataEnd.store(dataStart, std::memory_order_relaxed);
+    header->magic.store(SharedCacheMagic, std::memory_order_release);
+  } else {
+    const auto deadline = std::chrono::steady_clock::now() + SharedCacheInitTimeout;
+    while (header->magic.load(std::memory_order_acquire) != SharedCacheMagic &&
+           std::chrono::steady_clock::now() < deadline)
+      std::this_thread::yield();
+
+    if (header->magic.load(std::memory_order_acquire) != SharedCacheMagic) {
+      // The creator died or hung before initializing the segment.
+      shm_unlink(name);
+      delete sharedCache;
+      sharedCache = nullptr;
+    } else if (header->version != SharedCacheVersion || memcmp(&header->buildId, &buildId, sizeof(buildId)) != 0 ||
+               header->segmentSize != segmentSize || !isPowerOf2_32(header->slotCount) ||
+               header->dataStart < sizeof(SegmentHeader) + uint64_t(header->slotCount) * sizeof(IndexSlot) ||
+               header->dataStart > segmentSize) {
+      delete sharedCache;
+      sharedCache = nullptr;
+    }
+  }
+  return sharedCache;
+#else
+  (void(buildId));
+  (void(segmentSize));
+  return nullptr;
+#endif
+}
+
+// =====================================================================================================================
+// Gets the index of the shared memory segment.
+SharedShaderCache::IndexSlot *SharedShaderCache::getSlots() const {
+  return static_cast<IndexSlot *>(voidPtrInc(m_segment, sizeof(SegmentHeader)));
+}
+
+// =====================================================================================================================
+// Searches the index for the published entry with the specified key. Returns nullptr if there is none.
+//
+// @param key : Key of the entry
+const SharedShaderCache::IndexSlot *SharedShaderCache::findSlot(uint64_t key) const {
+  const uint32_t slotCount = getHeader()->slotCount;
+  const IndexSlot *slots = getSlots();
+  for (uint32_t probe = 0; probe < slotCount; ++probe) {
+    const IndexSlot &slot = slots[(key + probe) & (slotCount - 1)];
+    const uint64_t slotKey = slot.key.load(std::memory_order_acquire);
+    if (slotKey == 0)
+      break;
+    if (slotKey == key)
+      return slot.state.load(std::memory_order_acquire) == SlotReady ? &slot : nullptr;
+  }
+  return nullptr;
+}
+
+// =====================================================================================================================
+// Looks up an entry in the shared memory segment, with the protocol of ShaderCacheGetValue: if value is null, only the
+// size of the entry is returned.
+//
+// @param clientData : The SharedShaderCache
+// @param hash : Key of the entry
+// @param [out] value : Buffer for the data of the entry, or null to query its size
+// @param [in,out] valueLen : Size of the buffer, then size of the entry
+Result SharedShaderCache::getValue(const void *clientData, uint64_t hash, void *value, size_t *valueLen) {
+  const SharedShaderCache *sharedCache = static_cast<const SharedShaderCache *>(clientData);
+  const IndexSlot *slot = hash != 0 ? sharedCache->findSlot(hash) : nullptr;
+  if (!slot)
+    return Result::NotFound;
+
+  // The segment is writable by every process that uses it, so do not trust the slot to be within it. Read the slot
+  // once, so that what is checked is what is copied.
+  const uint64_t offset = slot->offset;
+  const uint64_t size = slot->size;
+  if (offset < sharedCache->getHeader()->dataStart || offset > sharedCache->m_segmentSize ||
+      size > sharedCache->m_segmentSize - offset)
+    return Result::NotFound;
+
+  if (value) {
+    if (*valueLen < size)
+      return Result::ErrorOutOfMemory;
+    memcpy(value, voidPtrInc(sharedCache->m_segment, offset), size);
+  }
+  *valueLen = size;
+  return Result::Success;
+}
+
+// =====================================================================================================================
+// Stores an entry in the shared memory segment, with the protocol of ShaderCacheStoreValue. Storing an entry that
+// another process has already stored, or is storing, succeeds without copying the data again.
+//
+// @param clientData : The SharedShaderCache
+// @param hash : Key of the entry
+// @param value : Data of the entry
+// @param valueLen : Size of the data of the entry
+Result SharedShaderCache::storeValue(const void *clientData, uint64_t hash, const void *value, size_t valueLen) {
+  const SharedShaderCache *sharedCache = static_cast<const SharedShaderCache *>(clientData);
+  SegmentHeader *header = sharedCache->getHeader();
+  if (hash == 0)
+    return Result::ErrorInvalidValue;
+
+  // Claim a slot for the key.
+  const uint32_t slotCount = header->slotCount;
+  IndexSlot *slots = sharedCache->getSlots();
+  IndexSlot *slot = nullptr;
+  for (uint32_t probe = 0; probe < slotCount && !slot; ++probe) {
+    IndexSlot &candidate = slots[(hash + probe) & (slotCount - 1)];
+    uint64_t slotKey = 0;
+    if (candidate.key.compare_exchange_strong(slotKey, hash, std::memory_order_acq_rel))
+      slot = &candidate;
+    else if (slotKey == hash)
+      return Result::Success;
+  }
+  if (!slot)
+    return Result::ErrorOutOfMemory;
+
+  // Allocate space in the data area, then write the data and publish the entry.
+  const uint64_t offset = header->dataEnd.fetch_add(alignTo(valueLen, 8), std::memory_order_relaxed);
+  if (offset > sharedCache->m_segmentSize || valueLen > sharedCache->m_segmentSize - offset) {
+    slot->state.store(SlotFailed, std::memory_order_release);
+    return Result::ErrorOutOfMemory;
+  }
+  memcpy(voidPtrInc(sharedCache->m_segment, offset), value, valueLen);
+  slot->offset = offset;
+  slot->size = valueLen;
+  slot->state.store(SlotReady, std::memory_order_release);
+  return Result::Success;
+}
+
+} // namespace Llpc
@@ -0,0 +1,72 @@
+/*
+ ***********************************************************************************************************************
+ *
+ *  Copyright (c) 2020 Advanced Micro Devices, Inc. All Rights Reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ **********************************************************************************************************************/
+/**
+ ***********************************************************************************************************************
+ @file llpcSharedShaderCache.h
+ @brief LLPC header file: contains declaration of class Llpc::SharedShaderCache.
+ ***********************************************************************************************************************
+ */
+#pragma once
+
+#include "llpcShaderCache.h"
+
+namespace Llpc {
+
+// =====================================================================================================================
+// This class implements a shader cache store in a named shared memory segment, which all processes that use the same
+// build of LLPC with the same GFXIP and compilation options open and use at the same time. It is used by ShaderCache
+// in place of the external cache callbacks.
+//
+// The segment consists of a header, a fixed-size open-addressing index, and an append-only data area. Entries are
+// never removed or moved, so lookups need no lock: an index slot is claimed by a compare-and-swap of its key, which
+// also serves to skip an entry that another process is already storing, and is published by a release store of its
+// state once its data has been written. Space in the data area is allocated by an atomic add to the data end. An
+// entry whose writer died before publishing it stays unpublished, and is a miss for the lifetime of the segment.
+class SharedShaderCache {
+public:
+  ~SharedShaderCache();
+
+  static SharedShaderCache *open(const BuildUniqueId &buildId, size_t segmentSize);
+
+  static Result getValue(const void *clientData, uint64_t hash, void *value, size_t *valueLen);
+  static Result storeValue(const void *clientData, uint64_t hash, const void *value, size_t valueLen);
+
+private:
+  struct SegmentHeader;
+  struct IndexSlot;
+
+  SharedShaderCache(void *segment, size_t segmentSize) : m_segment(segment), m_segmentSize(segmentSize) {}
+  SharedShaderCache(const SharedShaderCache &) = delete;
+  SharedShaderCache &operator=(const SharedShaderCache &) = delete;
+
+  SegmentHeader *getHeader() const { return static_cast<SegmentHeader *>(m_segment); }
+  IndexSlot *getSlots() const;
+  const IndexSlot *findSlot(uint64_t key) const;
+
+  void *m_segment;      // Mapping of the shared memory segment
+  size_t m_segmentSize; // Size of the shared memory segment
+};
+
+} // namespace Llpc
@@ -95,16 +95,114 @@ struct ShaderModuleBuildOut {
   ShaderModuleData *pModuleData; ///< Output shader module data (opaque)
 };
 
+/// Represents compile statistics of building a pipeline. Times are wall-clock times in seconds. Collecting them does
+/// not enable the phase timers, so the build still caches pass managers and lowers stages in parallel; the times
+/// inside the middle-end and back-end are only split up when the timers are enabled for reports anyway.
+struct PipelineBuildStats {
+  double translateTime;        ///< Time translating SPIR-V to LLVM IR (included in lowerTime when stages are lowered in
+                               ///  parallel)
+  double lowerTime;            ///< Time in SPIR-V lowering
+  double generateTime;         ///< Time in the middle-end and back-end, from the linked pipeline module to the ELF
+  double patchTime;            ///< Part of generateTime in LGC patching (0 unless -enable-timer-profile or
+                               ///  -time-passes is set)
+  double optTime;              ///< Part of generateTime in LLVM optimizations (0 unless timers are enabled)
+  double codeGenTime;          ///< Part of generateTime in backend code generation (0 unless timers are enabled)
+  double linkTime;             ///< Time linking relocatable shader ELFs
+  double cacheLookupTime;      ///< Time looking up the pipeline, or its relocatable shaders, in caches
+  bool cacheHit;               ///< Whether the pipeline ELF was found in a cache, so that nothing was compiled
+  size_t maxPhaseMemoryGrowth; ///< Largest growth of allocated memory during one of the translate, lower, generate
+                               ///  and link phases, in bytes. This is not the peak memory use of the build.
+  /// Whether the register pressure of the pipeline made it be compiled again with less loop unrolling, and that
+  /// variant was kept (see the -unroll-feedback-waves option)
+  bool lessUnrolled;
+  /// Whether the build ran out of its compile-time budget (see the -compile-time-budget option), so that the
+  /// remaining optional optimization passes were skipped
+  bool compileBudgetExceeded;
+};
+
+/// Represents the cost of one compiler pass, accumulated over the builds of a compiler. Only collected when the
+/// -pass-costs option is set. Times are wall-clock times in seconds.
+struct PassBuildStats {
+  char passName[64]; ///< Name of the pass, truncated to fit
+  uint64_t runCount; ///< Number of times the pass was run
+  double time;       ///< Total time of those runs
+  int64_t memUsed;   ///< Total growth of allocated memory during those runs, in bytes
+};
+
+/// Represents counters of cache lookups. Times are wall-clock times in seconds.
+struct CacheLookupStats {
+  uint64_t hits;        ///< Lookups that found the entry ready
+  uint64_t misses;      ///< Lookups that did not find the entry ready, so that it was compiled
+  uint64_t waits;       ///< Lookups that waited for another thread compiling the entry
+  double waitTime;      ///< Total time of those waits
+  uint64_t bytesStored; ///< Bytes of compiled data stored in the caches after misses
+};
+
+/// Represents cache statistics of a compiler, accumulated since the compiler was created.
+struct CompilerCacheStats {
+  /// All cache lookups of the compiler's builds: pipelines, relocatable shader ELFs, pipeline parts and lowered
+  /// shader stages. Waits only count waits on entries of an ICache; waits on the internal shader cache are counted in
+  /// shaderCache.
+  CacheLookupStats lookups;
+  /// Lookups in the internal shader cache, which is shared by all compilers with the same GFXIP and options
+  CacheLookupStats shaderCache;
+  uint64_t shaderCacheEvictions;  ///< Entries evicted from the internal shader cache
+  uint64_t shaderCacheMaxWaiters; ///< Most threads that waited at once for one internal shader cache entry
+  /// Times an on-demand build found a prefetch build of the same pipeline queued or compiling, and raised its priority
+  uint64_t priorityBoosts;
+  /// Per shader stage, lookups of the part of a pipeline, or of the relocatable shader ELF, that contains the stage
+  /// and was found in a cache
+  uint64_t stageHits[ShaderStageCount];
+  /// Per shader stage, such lookups that missed, so that the stage was compiled
+  uint64_t stageMisses[ShaderStageCount];
+};
+
 /// Represents output of building a graphics pipeline.
 struct GraphicsPipelineBuildOut {
-  BinaryData pipelineBin; ///< Output pipeline binary data
+  BinaryData pipelineBin;     ///< Output pipeline binary data
+  PipelineBuildStats *pStats; ///< [in] If not null, compile statistics of this build are returned here
+  void **ppBinHandle;         ///< [in] If not null, a cache hit may return pipelineBin in cache memory instead of
+                              ///  copying it to memory from pfnOutputAlloc. The handle that keeps the cache memory
+                              ///  alive is then returned here, to be released with ICompiler::ReleasePipelineBinary;
+                              ///  otherwise null is returned here.
 };
 
 /// Represents output of building a compute pipeline.
 struct ComputePipelineBuildOut {
-  BinaryData pipelineBin; ///< Output pipeline binary data
+  BinaryData pipelineBin;     ///< Output pipeline binary data
+  PipelineBuildStats *pStats; ///< [in] If not null, compile statistics of this build are returned here
+  void **ppBinHandle;         ///< [in] If not null, a cache hit may return pipelineBin in cache memory instead of
+                              ///  copying it to memory from pfnOutputAlloc. The handle that keeps the cache memory
+                              ///  alive is then returned here, to be released with ICompiler::ReleasePipelineBinary;
+                              ///  otherwise null is returned here.
+};
+
+/// Defines callback function that receives the optimized pipeline ELF of a tiered pipeline build. The ELF is allocated
+/// with the allocator of the pipeline build info, and is owned by the client. pPipelineBin is null if the build failed.
+typedef void (*OptimizedPipelineCallback)(void *pCallbackData, Result result, const BinaryData *pPipelineBin);
+
+/// Represents a part of a graphics pipeline that a graphics pipeline library builds on its own, to be linked with the
+/// other parts later. The vertex input state and the color target state are not built into either part: they are
+/// applied when the parts are linked, by the fetch shader and the color export shader that the link adds.
+enum class GraphicsPipelinePart : unsigned {
+  PreRasterization = 0, ///< Vertex processing shaders (currently the vertex shader only)
+  Fragment,             ///< Fragment shader, or the null fragment shader of a depth-only pipeline
+  Count,
 };
 
+/// Represents the priority of an asynchronous pipeline build. Queued on-demand builds are started before any queued
+/// prefetch build.
+enum class PipelineJobPriority : unsigned {
+  OnDemand = 0, ///< The pipeline is needed for rendering now
+  Prefetch,     ///< The pipeline is built ahead of its first use
+  Count,
+};
+
+/// Defines callback function that is called when an asynchronous pipeline build has finished, on the thread that ran
+/// it. The build output passed to the build call has been filled in by then. A build that was cancelled before it
+/// started calls it with Result::ErrorUnavailable, on the thread that cancelled it.
+typedef void (*PipelineJobCallback)(void *pCallbackData, Result result);
+
 /// Defines callback function used to lookup shader cache info in an external cache
 typedef Result (*ShaderCacheGetValue)(const void *pClientData, uint64_t hash, void *pValue, size_t *pValueLen);
 
@@ -218,6 +316,131 @@ public:
   virtual Result BuildGraphicsPipeline(const GraphicsPipelineBuildInfo *pPipelineInfo,
                                        GraphicsPipelineBuildOut *pPipelineOut, void *pPipelineDumpFile = nullptr) = 0;
 
+  /// Build a batch of graphics pipelines from the specified infos. The pipelines are built in parallel, and each
+  /// group of identical pipelines in the batch is only built once.
+  ///
+  /// @param [in]  pipelineCount    Count of pipelines to build
+  /// @param [in]  ppPipelineInfos  Infos to build the pipelines
+  /// @param [out] pPipelineOuts    Outputs of building the pipelines, one for each pipeline info
+  /// @param [out] pResults         Result of building each pipeline
+  ///
+  /// @returns Result::Success if all pipelines were built successfully. Otherwise, the result of the first pipeline
+  ///          that failed.
+  virtual Result BuildGraphicsPipelines(unsigned pipelineCount, const GraphicsPipelineBuildInfo *const *ppPipelineInfos,
+                                        GraphicsPipelineBuildOut *pPipelineOuts, Result *pResults) = 0;
+
+  /// Build graphics pipeline in two tiers. A pipeline linked from relocatable shader ELF is returned straight away,
+  /// and a fully optimized compile of the same pipeline is scheduled on a background thread. When that compile is
+  /// done, pfnOptimized is called on the background thread so that the client can swap in the optimized ELF.
+  ///
+  /// The pipeline info, and everything it points to, must stay valid until pfnOptimized has been called.
+  ///
+  /// @param [in]  pPipelineInfo  Info to build this graphics pipeline
+  /// @param [out] pPipelineOut   Output of building the linked pipeline
+  /// @param [in]  pfnOptimized   Callback that receives the optimized pipeline, or null to skip the optimized compile
+  /// @param [in]  pCallbackData  Client data passed to pfnOptimized
+  ///
+  /// @returns Result::Success if the linked pipeline was built successfully. Other return codes indicate failure, in
+  ///          which case no optimized compile is scheduled.
+  virtual Result BuildGraphicsPipelineTiered(const GraphicsPipelineBuildInfo *pPipelineInfo,
+                                             GraphicsPipelineBuildOut *pPipelineOut,
+                                             OptimizedPipelineCallback pfnOptimized, void *pCallbackData) = 0;
+
+  /// Build one part of a graphics pipeline for a graphics pipeline library. The part is built as relocatable shader
+  /// ELF, which is cached in the same way as the stages of a pipeline built from relocatable shader ELF, and returned
+  /// in pPartOut->pipelineBin to be passed to LinkGraphicsPipelineParts. Only the shader stages of the part are looked
+  /// at in the pipeline info; the other stages may be absent.
+  ///
+  /// @param [in]  pPipelineInfo  Info of the pipeline the part belongs to
+  /// @param [in]  part           Part to build
+  /// @param [out] pPartOut       Output of building the part
+  ///
+  /// @returns Result::Success if successful, Result::Unsupported if the part cannot be built as relocatable shader
+  ///          ELF (for example, it has tessellation or geometry shaders), in which case the client needs to build
+  ///          the whole pipeline with BuildGraphicsPipeline. Other return codes indicate failure.
+  virtual Result BuildGraphicsPipelinePart(const GraphicsPipelineBuildInfo *pPipelineInfo, GraphicsPipelinePart part,
+                                           GraphicsPipelineBuildOut *pPartOut) = 0;
+
+  /// Link parts of a graphics pipeline built by BuildGraphicsPipelinePart into a pipeline. The link adds the fetch
+  /// shader and color export shader from the vertex input and color target state of the pipeline info, and does no
+  /// other compiling, so it is fast enough to do at draw time. The pipeline info must have all the state of the
+  /// pipeline, including the shader stages of every part.
+  ///
+  /// If pfnOptimized is not null, a fully optimized compile of the pipeline is scheduled on a background thread when
+  /// this combination of parts has been linked often enough to be hot (see -pipeline-library-hot-links), and
+  /// pfnOptimized is called with its ELF when it is done. The pipeline info, and everything it points to, must then
+  /// stay valid until pfnOptimized has been called, or until this call returns if the compile was not scheduled,
+  /// which is indicated by the return of Result::Success rather than Result::Delayed.
+  ///
+  /// @param [in]  pPipelineInfo  Info to build the pipeline
+  /// @param [in]  pPartBins      Part ELFs, indexed by GraphicsPipelinePart
+  /// @param [out] pPipelineOut   Output of linking the pipeline
+  /// @param [in]  pfnOptimized   Callback that receives the optimized pipeline, or null to skip the optimized compile
+  /// @param [in]  pCallbackData  Client data passed to pfnOptimized
+  ///
+  /// @returns Result::Success if the pipeline was linked, or Result::Delayed if it was linked and an optimized
+  ///          compile was scheduled. Other return codes indicate failure.
+  virtual Result LinkGraphicsPipelineParts(const GraphicsPipelineBuildInfo *pPipelineInfo, const BinaryData *pPartBins,
+                                           GraphicsPipelineBuildOut *pPipelineOut,
+                                           OptimizedPipelineCallback pfnOptimized, void *pCallbackData) = 0;
+
+  /// Queue a graphics pipeline build on the compiler's job threads and return straight away. The job threads are
+  /// created on first use, one per hardware thread. When the build has finished, pfnDone is called; the job handle
+  /// returned in ppJob can also be waited on or cancelled, and must be released with ReleasePipelineJob.
+  ///
+  /// The pipeline info, everything it points to, and the pipeline output must stay valid until the job has finished.
+  ///
+  /// @param [in]  pPipelineInfo  Info to build this graphics pipeline
+  /// @param [out] pPipelineOut   Output of building this graphics pipeline, filled in when the job has finished
+  /// @param [in]  priority       Priority of the build against other queued builds
+  /// @param [in]  pfnDone        Callback that is called when the job has finished, or null
+  /// @param [in]  pCallbackData  Client data passed to pfnDone
+  /// @param [out] ppJob          Handle of the queued job
+  ///
+  /// @returns Result::Success if the build was queued. Other return codes indicate failure, in which case pfnDone is
+  ///          not called.
+  virtual Result BuildGraphicsPipelineAsync(const GraphicsPipelineBuildInfo *pPipelineInfo,
+                                            GraphicsPipelineBuildOut *pPipelineOut, PipelineJobPriority priority,
+                                            PipelineJobCallback pfnDone, void *pCallbackData, void **ppJob) = 0;
+
+  /// Queue a compute pipeline build on the compiler's job threads and return straight away. See
+  /// BuildGraphicsPipelineAsync.
+  ///
+  /// @param [in]  pPipelineInfo  Info to build this compute pipeline
+  /// @param [out] pPipelineOut   Output of building this compute pipeline, filled in when the job has finished
+  /// @param [in]  priority       Priority of the build against other queued builds
+  /// @param [in]  pfnDone        Callback that is called when the job has finished, or null
+  /// @param [in]  pCallbackData  Client data passed to pfnDone
+  /// @param [out] ppJob          Handle of the queued job
+  ///
+  /// @returns Result::Success if the build was queued. Other return codes indicate failure, in which case pfnDone is
+  ///          not called.
+  virtual Result BuildComputePipelineAsync(const ComputePipelineBuildInfo *pPipelineInfo,
+                                           ComputePipelineBuildOut *pPipelineOut, PipelineJobPriority priority,
+                                           PipelineJobCallback pfnDone, void *pCallbackData, void **ppJob) = 0;
+
+  /// Cancel a queued asynchronous pipeline build. A build that has already started runs to completion.
+  ///
+  /// @param [in]  pJob  Handle of the job
+  ///
+  /// @returns Result::Success if the build was cancelled before it started, Result::NotReady if it is running or has
+  ///          finished.
+  virtual Result CancelPipelineJob(void *pJob) = 0;
+
+  /// Wait for an asynchronous pipeline build to finish.
+  ///
+  /// @param [in]  pJob  Handle of the job
+  ///
+  /// @returns Result of the build, or Result::ErrorUnavailable if it was cancelled.
+  virtual Result WaitPipelineJob(void *pJob) = 0;
+
+  /// Release the handle of an asynchronous pipeline build. A job that has not finished yet still runs, and still
+  /// calls its callback. All job handles must be released before the compiler is destroyed; destroying the compiler
+  /// waits for running builds and cancels queued ones.
+  ///
+  /// @param [in]  pJob  Handle of the job; null is ignored
+  virtual void ReleasePipelineJob(void *pJob) = 0;
+
   /// Build compute pipeline from the specified info.
   ///
   /// @param [in]  pPipelineInfo  Info to build this compute pipeline
@@ -227,6 +450,44 @@ public:
   virtual Result BuildComputePipeline(const ComputePipelineBuildInfo *pPipelineInfo,
                                       ComputePipelineBuildOut *pPipelineOut, void *pPipelineDumpFile = nullptr) = 0;
 
+  /// Warm the pipeline caches for pipelines that are about to be built. The cache entries of the pipelines are looked
+  /// up in parallel, so that shader data is read from the on-disk cache file, or fetched from the client's caches,
+  /// ahead of time, and the later build calls for these pipelines hit in memory. Pipelines that are not in any cache
+  /// are not compiled. The call returns once all lookups are done, so clients may want to issue it from a loading
+  /// thread.
+  ///
+  /// @param [in]  graphicsPipelineCount  Count of graphics pipelines to prefetch
+  /// @param [in]  ppGraphicsPipelineInfos  Infos of the graphics pipelines, as they will be passed to build them
+  /// @param [in]  computePipelineCount  Count of compute pipelines to prefetch
+  /// @param [in]  ppComputePipelineInfos  Infos of the compute pipelines, as they will be passed to build them
+  ///
+  /// @returns Result::Success if the lookups were issued. Misses are not reported as failures.
+  virtual Result PrefetchPipelines(unsigned graphicsPipelineCount,
+                                   const GraphicsPipelineBuildInfo *const *ppGraphicsPipelineInfos,
+                                   unsigned computePipelineCount,
+                                   const ComputePipelineBuildInfo *const *ppComputePipelineInfos) = 0;
+
+  /// Get the cache statistics of the compiler, so that build time can be attributed to cache misses or to waits on
+  /// compiles running in other threads.
+  ///
+  /// @param [out] pStats  Cache statistics accumulated since the compiler was created
+  virtual void GetCacheStats(CompilerCacheStats *pStats) const = 0;
+
+  /// Get the per-pass costs of the compiler's builds, so that compile time can be attributed to individual passes
+  /// across many pipelines. Returns nothing unless the -pass-costs option is set.
+  ///
+  /// @param [out] pStats  Array to return the costs in, sorted by pass name; may be null if count is 0
+  /// @param [in]  count   Number of entries pStats has room for
+  ///
+  /// @returns Number of passes that have costs, which may be more than count
+  virtual unsigned GetPassStats(PassBuildStats *pStats, unsigned count) const = 0;
+
+  /// Releases a pipeline binary that a build returned in cache memory, once the client no longer needs it. All such
+  /// binaries must be released before the compiler is destroyed.
+  ///
+  /// @param [in]  pBinHandle  Handle returned in ppBinHandle of the build output; null is ignored
+  virtual void ReleasePipelineBinary(void *pBinHandle) = 0;
+
 #if LLPC_CLIENT_INTERFACE_MAJOR_VERSION < 38 || LLPC_ENABLE_SHADER_CACHE
   /// Creates a shader cache object with the requested properties.
   ///
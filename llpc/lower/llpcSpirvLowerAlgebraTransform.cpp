@@ -37,8 +37,11 @@
 #include "llvm/Analysis/ConstantFolding.h"
 #include "llvm/Analysis/TargetLibraryInfo.h"
 #include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/InstIterator.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
 #include "llvm/IR/Operator.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Transforms/Utils.h"
@@ -51,6 +54,12 @@ using namespace llvm;
 using namespace SPIRV;
 using namespace Llpc;
 
+// -spirv-lower-contract-fma: contract floating-point multiplies into the adds that use them
+static cl::opt<bool> ContractFma("spirv-lower-contract-fma",
+                                 cl::desc("Contract a floating-point multiply and the add or subtract that uses it "
+                                          "into llvm.fmuladd when both allow contraction"),
+                                 cl::init(true));
+
 namespace Llpc {
 
 // =====================================================================================================================
@@ -134,9 +143,14 @@ bool SpirvLowerAlgebraTransform::runOnModule(Module &module) {
     }
   }
 
-  if (m_enableFloatOpt)
+  if (m_enableFloatOpt) {
     visit(m_module);
 
+    // Contract after the visit, which has cleared the contract flag of adds that use a NoContraction result.
+    if (ContractFma)
+      contractMulAdd();
+  }
+
   return m_changed;
 }
 
@@ -146,9 +160,7 @@ bool SpirvLowerAlgebraTransform::runOnModule(Module &module) {
 // @param inst : Instruction to flush denormals if needed
 void SpirvLowerAlgebraTransform::flushDenormIfNeeded(Instruction *inst) {
   auto destTy = inst->getType();
-  if ((destTy->getScalarType()->isHalfTy() && m_fp16DenormFlush) ||
-      (destTy->getScalarType()->isFloatTy() && m_fp32DenormFlush) ||
-      (destTy->getScalarType()->isDoubleTy() && m_fp64DenormFlush)) {
+  if (isDenormFlushed(destTy)) {
     // Has to flush denormals, insert canonicalize to make a MUL (* 1.0) forcibly
     auto builder = m_context->getBuilder();
     builder->SetInsertPoint(inst->getNextNode());
@@ -160,6 +172,16 @@ void SpirvLowerAlgebraTransform::flushDenormIfNeeded(Instruction *inst) {
   }
 }
 
+// =====================================================================================================================
+// Checks whether the FP mode wants denormals of the specified floating-point type (or vector of it) to be flushed.
+//
+// @param ty : Floating-point type
+bool SpirvLowerAlgebraTransform::isDenormFlushed(Type *ty) {
+  Type *scalarTy = ty->getScalarType();
+  return (scalarTy->isHalfTy() && m_fp16DenormFlush) || (scalarTy->isFloatTy() && m_fp32DenormFlush) ||
+         (scalarTy->isDoubleTy() && m_fp64DenormFlush);
+}
+
 // =====================================================================================================================
 // Visits unary operator instruction.
 //
@@ -374,6 +396,111 @@ bool SpirvLowerAlgebraTransform::isOperandNoContract(Value *operand) {
   return false;
 }
 
+// =====================================================================================================================
+// Contracts floating-point multiplies into the adds and subtracts that use them, forming llvm.fmuladd, which the
+// backend turns into a fused or unfused multiply-add as suits the target. Adds are visited in program order, so in a
+// chain of accumulations each add takes the previous fmuladd as its addend.
+void SpirvLowerAlgebraTransform::contractMulAdd() {
+  SmallVector<BinaryOperator *, 16> adds;
+  for (Function &func : *m_module) {
+    for (Instruction &inst : instructions(func)) {
+      if (inst.getOpcode() == Instruction::FAdd || inst.getOpcode() == Instruction::FSub)
+        adds.push_back(cast<BinaryOperator>(&inst));
+    }
+  }
+
+  for (BinaryOperator *add : adds) {
+    if (contractMulAdd(add))
+      m_changed = true;
+  }
+}
+
+// =====================================================================================================================
+// Contracts the multiply that is an operand of the specified add or subtract into an llvm.fmuladd with it. Returns
+// true if the add was replaced.
+//
+// Contraction needs the contract flag on both the multiply and the add, which SPIR-V translation leaves off for
+// NoContraction results and when denormals are flushed. It is also skipped where the FP mode flushes denormals or
+// rounds half to zero, as a fused multiply-add does not round or flush its intermediate result.
+//
+// An add with reassociation allowed also reaches into an operand that is an fmuladd of two multiplies, as formed from
+// a sum of products, to chain the other multiply onto its addend:
+//   x + fmuladd(a, b, c * d) => fmuladd(a, b, fmuladd(c, d, x))
+//
+// @param add : FAdd or FSub instruction
+bool SpirvLowerAlgebraTransform::contractMulAdd(BinaryOperator *add) {
+  Type *ty = add->getType();
+  if (!add->getFastMathFlags().allowContract() || isDenormFlushed(ty) ||
+      (ty->getScalarType()->isHalfTy() && m_fp16Rtz))
+    return false;
+
+  const bool isSub = add->getOpcode() == Instruction::FSub;
+  IRBuilder<> builder(add);
+  builder.setFastMathFlags(add->getFastMathFlags());
+
+  for (unsigned opIdx = 0; opIdx < 2; ++opIdx) {
+    BinaryOperator *mul = getContractibleMul(add->getOperand(opIdx), add);
+    if (!mul)
+      continue;
+
+    // a * b + c, c + a * b => fmuladd(a, b, c); a * b - c => fmuladd(a, b, -c); c - a * b => fmuladd(-a, b, c)
+    Value *mulSrc = mul->getOperand(0);
+    Value *addend = add->getOperand(1 - opIdx);
+    if (isSub && opIdx == 0)
+      addend = builder.CreateFNeg(addend);
+    else if (isSub)
+      mulSrc = builder.CreateFNeg(mulSrc);
+    Value *mulAdd = builder.CreateIntrinsic(Intrinsic::fmuladd, ty, {mulSrc, mul->getOperand(1), addend});
+
+    LLVM_DEBUG(dbgs() << "Algebriac transform: contract: " << *mul << " into: " << *add << '\n');
+    add->replaceAllUsesWith(mulAdd);
+    add->eraseFromParent();
+    mul->eraseFromParent();
+    return true;
+  }
+
+  if (isSub || !add->getFastMathFlags().allowReassoc())
+    return false;
+
+  for (unsigned opIdx = 0; opIdx < 2; ++opIdx) {
+    auto inner = dyn_cast<IntrinsicInst>(add->getOperand(opIdx));
+    if (!inner || inner->getIntrinsicID() != Intrinsic::fmuladd || !inner->hasOneUse() ||
+        inner->getParent() != add->getParent() || !inner->getFastMathFlags().allowReassoc())
+      continue;
+    BinaryOperator *innerMul = getContractibleMul(inner->getArgOperand(2), inner);
+    if (!innerMul)
+      continue;
+
+    // x + fmuladd(a, b, c * d) => fmuladd(a, b, fmuladd(c, d, x))
+    Value *chained = builder.CreateIntrinsic(
+        Intrinsic::fmuladd, ty, {innerMul->getOperand(0), innerMul->getOperand(1), add->getOperand(1 - opIdx)});
+    Value *mulAdd = builder.CreateIntrinsic(Intrinsic::fmuladd, ty,
+                                            {inner->getArgOperand(0), inner->getArgOperand(1), chained});
+
+    LLVM_DEBUG(dbgs() << "Algebriac transform: reassociate: " << *add << " into: " << *inner << '\n');
+    add->replaceAllUsesWith(mulAdd);
+    add->eraseFromParent();
+    inner->eraseFromParent();
+    innerMul->eraseFromParent();
+    return true;
+  }
+
+  return false;
+}
+
+// =====================================================================================================================
+// Gets the specified operand as a multiply that can be contracted into its only user, or nullptr if it is not one.
+//
+// @param operand : Operand to check
+// @param user : Instruction that uses the operand
+BinaryOperator *SpirvLowerAlgebraTransform::getContractibleMul(Value *operand, Instruction *user) {
+  auto mul = dyn_cast<BinaryOperator>(operand);
+  if (!mul || mul->getOpcode() != Instruction::FMul || !mul->hasOneUse() || mul->getParent() != user->getParent() ||
+      !mul->getFastMathFlags().allowContract())
+    return nullptr;
+  return mul;
+}
+
 // =====================================================================================================================
 // Disable fast math for all values related with the specified value
 //
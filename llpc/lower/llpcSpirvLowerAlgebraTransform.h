@@ -61,6 +61,10 @@ private:
 
   bool isOperandNoContract(llvm::Value *operand);
   void disableFastMath(llvm::Value *value);
+  bool isDenormFlushed(llvm::Type *ty);
+  void contractMulAdd();
+  bool contractMulAdd(llvm::BinaryOperator *add);
+  llvm::BinaryOperator *getContractibleMul(llvm::Value *operand, llvm::Instruction *user);
 
   bool m_enableConstFolding; // Whether enable constant folding in this pass
   bool m_enableFloatOpt;     // Whether enable floating point optimization in this pass
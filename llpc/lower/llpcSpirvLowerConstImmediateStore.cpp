@@ -31,8 +31,10 @@
 #include "llpcSpirvLowerConstImmediateStore.h"
 #include "SPIRVInternal.h"
 #include "llpcContext.h"
+#include "llvm/IR/Constants.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/Support/Debug.h"
+#include <algorithm>
 #include <vector>
 
 #define DEBUG_TYPE "llpc-spirv-lower-const-immediate-store"
@@ -79,88 +81,181 @@ bool SpirvLowerConstImmediateStore::runOnModule(Module &module) {
 }
 
 // =====================================================================================================================
-// Processes "alloca" instructions at the beginning of the given non-empty function to see if they
-// can be optimized to a read-only global variable.
+// Processes "alloca" instructions of the given non-empty function to see if they can be optimized to a read-only
+// global variable.
 //
 // @param func : Function to process
 void SpirvLowerConstImmediateStore::processAllocaInsts(Function *func) {
-  // NOTE: We only visit the entry block on the basis that SPIR-V translator puts all "alloca"
-  // instructions there.
-  auto entryBlock = &func->front();
-  for (auto instIt = entryBlock->begin(), instItEnd = entryBlock->end(); instIt != instItEnd; ++instIt) {
-    auto inst = &*instIt;
-    if (auto allocaInst = dyn_cast<AllocaInst>(inst)) {
-      if (allocaInst->getType()->getElementType()->isAggregateType()) {
-        // Got an "alloca" instruction of aggregate type.
-        auto storeInst = findSingleStore(allocaInst);
-        if (storeInst && isa<Constant>(storeInst->getValueOperand())) {
-          // Got an aggregate "alloca" with a single store to the whole type.
-          // Do the optimization.
-          convertAllocaToReadOnlyGlobal(storeInst);
-        }
+  // NOTE: The SPIR-V translator puts all "alloca" instructions in the entry block, but inlining can leave them
+  // elsewhere, so look at every block.
+  SmallVector<AllocaInst *, 8> allocaInsts;
+  for (BasicBlock &block : *func) {
+    for (Instruction &inst : block) {
+      if (auto allocaInst = dyn_cast<AllocaInst>(&inst)) {
+        if (allocaInst->getType()->getElementType()->isAggregateType())
+          allocaInsts.push_back(allocaInst);
       }
     }
   }
+
+  for (AllocaInst *allocaInst : allocaInsts) {
+    // Got an "alloca" instruction of aggregate type. If it is only ever stored with constants, possibly part by part
+    // and across multiple blocks, do the optimization.
+    SmallVector<ConstantStore, 4> stores;
+    if (!findConstantStores(allocaInst, stores) || stores.empty())
+      continue;
+    Constant *initializer = getInitializer(allocaInst, stores);
+    if (!initializer)
+      continue;
+    for (const ConstantStore &store : stores)
+      store.storeInst->eraseFromParent();
+    convertAllocaToReadOnlyGlobal(allocaInst, initializer);
+  }
 }
 
 // =====================================================================================================================
-// Finds the single "store" instruction storing to this pointer.
+// Finds the "store" instructions storing to this pointer, each of which must store a constant to the whole "alloca" or
+// to a part of it selected by constant indices.
 //
-// Returns nullptr if no "store", multiple "store", or partial "store" instructions (store only part
-// of the memory) are found.
+// Returns false if any "store" is not like that.
 //
-// NOTE: This is conservative in that it returns nullptr if the pointer escapes by being used in anything
+// NOTE: This is conservative in that it returns false if the pointer escapes by being used in anything
 // other than "store" (as the pointer), "load" or "getelementptr" instruction.
 //
 // @param allocaInst : The "alloca" instruction to process
-StoreInst *SpirvLowerConstImmediateStore::findSingleStore(AllocaInst *allocaInst) {
-  std::vector<Instruction *> pointers;
-  bool isOuterPointer = true;
-  StoreInst *storeInstFound = nullptr;
-  Instruction *pointer = allocaInst;
-  while (true) {
-    for (auto useIt = pointer->use_begin(), useItEnd = pointer->use_end(); useIt != useItEnd; ++useIt) {
-      auto user = cast<Instruction>(useIt->getUser());
+// @param [out] stores : The "store" instructions found
+bool SpirvLowerConstImmediateStore::findConstantStores(AllocaInst *allocaInst,
+                                                       SmallVectorImpl<ConstantStore> &stores) {
+  // A pointer into the "alloca", with the constant indices that select the part it points to. A pointer with a
+  // dynamic index (or one that steps outside the part) may be loaded from, but not stored to.
+  struct PointerInfo {
+    Instruction *pointer;
+    SmallVector<unsigned, 4> indices;
+    bool isConstantPath;
+  };
+  SmallVector<PointerInfo, 4> pointers;
+  pointers.push_back({allocaInst, {}, true});
+  while (!pointers.empty()) {
+    PointerInfo pointerInfo = pointers.pop_back_val();
+    for (User *user : pointerInfo.pointer->users()) {
       if (auto storeInst = dyn_cast<StoreInst>(user)) {
-        if (pointer == storeInst->getValueOperand() || storeInstFound || !isOuterPointer) {
-          // Pointer escapes by being stored, or we have already found a "store"
-          // instruction, or this is a partial "store" instruction.
-          return nullptr;
+        if (pointerInfo.pointer == storeInst->getValueOperand() || !pointerInfo.isConstantPath ||
+            !isa<Constant>(storeInst->getValueOperand())) {
+          // Pointer escapes by being stored, or this is a store of a non-constant or to a dynamically indexed part.
+          return false;
         }
-        storeInstFound = storeInst;
-      } else if (auto getElemPtrInst = dyn_cast<GetElementPtrInst>(user))
-        pointers.push_back(getElemPtrInst);
-      else if (!isa<LoadInst>(user)) {
+        stores.push_back({storeInst, pointerInfo.indices});
+      } else if (auto getElemPtrInst = dyn_cast<GetElementPtrInst>(user)) {
+        PointerInfo elementInfo = {getElemPtrInst, pointerInfo.indices, pointerInfo.isConstantPath};
+        // The first index steps over whole parts, so only 0 stays in the part.
+        auto idxIt = getElemPtrInst->idx_begin();
+        auto firstIdx = dyn_cast<ConstantInt>(*idxIt);
+        if (!firstIdx || !firstIdx->isZero())
+          elementInfo.isConstantPath = false;
+        for (++idxIt; elementInfo.isConstantPath && idxIt != getElemPtrInst->idx_end(); ++idxIt) {
+          auto idx = dyn_cast<ConstantInt>(*idxIt);
+          if (!idx)
+            elementInfo.isConstantPath = false;
+          else
+            elementInfo.indices.push_back(idx->getZExtValue());
+        }
+        pointers.push_back(elementInfo);
+      } else if (!isa<LoadInst>(user)) {
         // Pointer escapes by being used in some way other than "load/store/getelementptr".
-        return nullptr;
+        return false;
       }
     }
+  }
+  return true;
+}
+
+// =====================================================================================================================
+// Inserts a constant into a constant aggregate at the given constant indices. Returns nullptr if an index is out of
+// range.
+//
+// @param aggregate : Constant aggregate
+// @param value : Constant to insert
+// @param indices : Indices of the part of the aggregate to replace with the constant
+static Constant *insertConstant(Constant *aggregate, Constant *value, ArrayRef<unsigned> indices) {
+  if (indices.empty())
+    return value;
 
-    if (pointers.empty())
-      break;
+  Type *aggregateTy = aggregate->getType();
+  unsigned elementCount = 0;
+  if (auto structTy = dyn_cast<StructType>(aggregateTy))
+    elementCount = structTy->getNumElements();
+  else if (auto arrayTy = dyn_cast<ArrayType>(aggregateTy))
+    elementCount = arrayTy->getNumElements();
+  else if (auto vectorTy = dyn_cast<VectorType>(aggregateTy))
+    elementCount = vectorTy->getNumElements();
+  if (indices[0] >= elementCount)
+    return nullptr;
 
-    pointer = pointers.back();
-    pointers.pop_back();
-    isOuterPointer = false;
+  SmallVector<Constant *, 16> elements;
+  for (unsigned i = 0; i != elementCount; ++i)
+    elements.push_back(aggregate->getAggregateElement(i));
+  elements[indices[0]] = insertConstant(elements[indices[0]], value, indices.slice(1));
+  if (!elements[indices[0]])
+    return nullptr;
+
+  if (auto structTy = dyn_cast<StructType>(aggregateTy))
+    return ConstantStruct::get(structTy, elements);
+  if (auto arrayTy = dyn_cast<ArrayType>(aggregateTy))
+    return ConstantArray::get(arrayTy, elements);
+  return ConstantVector::get(elements);
+}
+
+// =====================================================================================================================
+// Gets the initializer of the read-only global variable that replaces an "alloca" whose stores are all constant.
+// Returns nullptr if two stores write the same part with different values, or one writes a part of what the other
+// writes, as then a load could see either value.
+//
+// A load that may run before the store to its part reads undefined memory, so reading the stored constant from the
+// global instead is a valid refinement. That is what allows the stores to be spread across blocks.
+//
+// @param allocaInst : The "alloca" instruction
+// @param stores : The constant "store" instructions to the "alloca"
+Constant *SpirvLowerConstImmediateStore::getInitializer(AllocaInst *allocaInst, ArrayRef<ConstantStore> stores) {
+  // Stores are compared pairwise, so give up on an "alloca" initialized element by element in a huge number of stores.
+  static const unsigned MaxStoreCount = 1024;
+  if (stores.size() > MaxStoreCount)
+    return nullptr;
+
+  for (unsigned i = 0; i != stores.size(); ++i) {
+    for (unsigned j = i + 1; j != stores.size(); ++j) {
+      ArrayRef<unsigned> indices = stores[i].indices;
+      ArrayRef<unsigned> otherIndices = stores[j].indices;
+      size_t commonSize = std::min(indices.size(), otherIndices.size());
+      if (indices.take_front(commonSize) != otherIndices.take_front(commonSize))
+        continue;
+      if (indices.size() != otherIndices.size() ||
+          stores[i].storeInst->getValueOperand() != stores[j].storeInst->getValueOperand())
+        return nullptr;
+    }
   }
 
-  return storeInstFound;
+  Constant *initializer = UndefValue::get(allocaInst->getAllocatedType());
+  for (const ConstantStore &store : stores) {
+    initializer = insertConstant(initializer, cast<Constant>(store.storeInst->getValueOperand()), store.indices);
+    if (!initializer)
+      return nullptr;
+  }
+  return initializer;
 }
 
 // =====================================================================================================================
-// Converts an "alloca" instruction with a single constant store into a read-only global variable.
+// Converts an "alloca" instruction whose constant stores have been removed into a read-only global variable.
 //
-// NOTE: This erases the "store" instruction (so it will not be lowered by a later lowering pass
-// any more) but not the "alloca" or replaced "getelementptr" instruction (they will be removed
+// NOTE: This does not erase the "alloca" or replaced "getelementptr" instruction (they will be removed
 // later by DCE pass).
 //
-// @param storeInst : The single constant store into the "alloca"
-void SpirvLowerConstImmediateStore::convertAllocaToReadOnlyGlobal(StoreInst *storeInst) {
-  auto allocaInst = cast<AllocaInst>(storeInst->getPointerOperand());
+// @param allocaInst : The "alloca" instruction
+// @param initializer : Constant contents of the "alloca", from its stores
+void SpirvLowerConstImmediateStore::convertAllocaToReadOnlyGlobal(AllocaInst *allocaInst, Constant *initializer) {
   auto global = new GlobalVariable(*m_module, allocaInst->getType()->getElementType(),
                                    true, // isConstant
-                                   GlobalValue::InternalLinkage, cast<Constant>(storeInst->getValueOperand()), "",
-                                   nullptr, GlobalValue::NotThreadLocal, SPIRAS_Constant);
+                                   GlobalValue::InternalLinkage, initializer, "", nullptr, GlobalValue::NotThreadLocal,
+                                   SPIRAS_Constant);
   global->takeName(allocaInst);
   // Change all uses of pAllocaInst to use pGlobal. We need to do it manually, as there is a change
   // of address space, and we also need to recreate "getelementptr"s.
@@ -191,7 +286,6 @@ void SpirvLowerConstImmediateStore::convertAllocaToReadOnlyGlobal(StoreInst *sto
     }
     // Visit next map pair.
   } while (!allocaToGlobalMap.empty());
-  storeInst->eraseFromParent();
 }
 
 } // namespace Llpc
@@ -31,14 +31,24 @@
 #pragma once
 
 #include "llpcSpirvLower.h"
+#include "llvm/ADT/SmallVector.h"
 
 namespace llvm {
 class AllocaInst;
+class Constant;
 class StoreInst;
 } // namespace llvm
 
 namespace Llpc {
 
+// =====================================================================================================================
+// A store of a constant into an aggregate "alloca", and the constant indices of the part of the aggregate it stores
+// (empty for the whole aggregate).
+struct ConstantStore {
+  llvm::StoreInst *storeInst;
+  llvm::SmallVector<unsigned, 4> indices;
+};
+
 // =====================================================================================================================
 // Represents the pass of SPIR-V lowering operations for constant immediate store
 class SpirvLowerConstImmediateStore : public SpirvLower {
@@ -54,8 +64,9 @@ private:
   SpirvLowerConstImmediateStore &operator=(const SpirvLowerConstImmediateStore &) = delete;
 
   void processAllocaInsts(llvm::Function *func);
-  llvm::StoreInst *findSingleStore(llvm::AllocaInst *allocaInst);
-  void convertAllocaToReadOnlyGlobal(llvm::StoreInst *storeInst);
+  bool findConstantStores(llvm::AllocaInst *allocaInst, llvm::SmallVectorImpl<ConstantStore> &stores);
+  llvm::Constant *getInitializer(llvm::AllocaInst *allocaInst, llvm::ArrayRef<ConstantStore> stores);
+  void convertAllocaToReadOnlyGlobal(llvm::AllocaInst *allocaInst, llvm::Constant *initializer);
 };
 
 } // namespace Llpc
@@ -198,6 +198,8 @@ bool SpirvLowerGlobal::runOnModule(Module &module) {
   // Do lowering operations
   lowerGlobalVar();
 
+  visitInOutInsts();
+
   if (m_lowerInputInPlace && m_lowerOutputInPlace) {
     // Both input and output have to be lowered in-place (without proxy variables)
     lowerInOutInPlace(); // Just one lowering operation is sufficient
@@ -689,6 +691,34 @@ void SpirvLowerGlobal::lowerGlobalVar() {
   }
 }
 
+// =====================================================================================================================
+// Visits the instructions that input and output lowering have to handle, for both of them in a single walk of the
+// module: interpolation calls (fragment shader inputs lowered with proxy variables), "return" instructions and "emit"
+// calls (outputs lowered with proxy variables), and "load"/"store" instructions (inputs and outputs lowered in-place).
+void SpirvLowerGlobal::visitInOutInsts() {
+  m_instVisitFlags.u32All = 0;
+
+  if (m_lowerInputInPlace || m_lowerOutputInPlace) {
+    m_instVisitFlags.checkLoad = true;
+    if (m_shaderStage == ShaderStageTessControl)
+      m_instVisitFlags.checkStore = true;
+  }
+
+  if (!m_lowerInputInPlace && m_shaderStage == ShaderStageFragment && !m_inputProxyMap.empty())
+    m_instVisitFlags.checkInterpCall = true;
+
+  if (!m_lowerOutputInPlace) {
+    // "Return" instructions are redirected to a new return block, where outputs are exported.
+    m_retBlock = BasicBlock::Create(*m_context, "", m_entryPoint);
+    m_instVisitFlags.checkReturn = true;
+    if (m_shaderStage == ShaderStageGeometry)
+      m_instVisitFlags.checkEmitCall = true;
+  }
+
+  visit(m_module);
+  m_instVisitFlags.u32All = 0;
+}
+
 // =====================================================================================================================
 // Does lowering opertions for SPIR-V inputs, replaces inputs with proxy variables.
 void SpirvLowerGlobal::lowerInput() {
@@ -702,13 +732,8 @@ void SpirvLowerGlobal::lowerInput() {
   assert(m_shaderStage != ShaderStageTessControl && m_shaderStage != ShaderStageTessEval);
 
   // NOTE: For fragment shader, we have to handle interpolation functions first since input interpolants must be
-  // lowered in-place.
+  // lowered in-place. They have been handled by visitInOutInsts().
   if (m_shaderStage == ShaderStageFragment) {
-    // Invoke handling of interpolation calls
-    m_instVisitFlags.u32All = 0;
-    m_instVisitFlags.checkInterpCall = true;
-    visit(m_module);
-
     // Remove interpolation calls, they must have been replaced with LLPC intrinsics
     std::unordered_set<GetElementPtrInst *> getElemInsts;
     for (auto interpCall : m_interpCalls) {
@@ -757,17 +782,8 @@ void SpirvLowerGlobal::lowerInput() {
 // =====================================================================================================================
 // Does lowering opertions for SPIR-V outputs, replaces outputs with proxy variables.
 void SpirvLowerGlobal::lowerOutput() {
-  m_retBlock = BasicBlock::Create(*m_context, "", m_entryPoint);
-
-  // Invoke handling of "return" instructions or "emit" calls
-  m_instVisitFlags.u32All = 0;
-  if (m_shaderStage == ShaderStageGeometry) {
-    m_instVisitFlags.checkEmitCall = true;
-    m_instVisitFlags.checkReturn = true;
-  } else
-    m_instVisitFlags.checkReturn = true;
-  visit(m_module);
-
+  // "Return" instructions and "emit" calls have been handled by visitInOutInsts().
+  assert(m_retBlock);
   auto retInst = ReturnInst::Create(*m_context, m_retBlock);
 
   for (auto retInst : m_retInsts) {
@@ -855,13 +871,7 @@ void SpirvLowerGlobal::lowerOutput() {
 void SpirvLowerGlobal::lowerInOutInPlace() {
   assert(m_shaderStage == ShaderStageTessControl || m_shaderStage == ShaderStageTessEval);
 
-  // Invoke handling of "load" and "store" instruction
-  m_instVisitFlags.u32All = 0;
-  m_instVisitFlags.checkLoad = true;
-  if (m_shaderStage == ShaderStageTessControl)
-    m_instVisitFlags.checkStore = true;
-  visit(m_module);
-
+  // "Load" and "store" instructions have been handled by visitInOutInsts().
   DenseSet<GetElementPtrInst *> getElemInsts;
 
   // Remove unnecessary "load" instructions
@@ -62,6 +62,7 @@ private:
   void mapOutputToProxy(llvm::GlobalVariable *input);
 
   void lowerGlobalVar();
+  void visitInOutInsts();
   void lowerInput();
   void lowerOutput();
   void lowerInOutInPlace();
@@ -31,8 +31,12 @@
 #include "llpcSpirvLowerMemoryOp.h"
 #include "SPIRVInternal.h"
 #include "llpcContext.h"
+#include "llpcDebug.h"
+#include "llpcPipelineContext.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/IR/Operator.h"
 #include "llvm/IR/Verifier.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/raw_ostream.h"
 
@@ -42,6 +46,14 @@ using namespace llvm;
 using namespace SPIRV;
 using namespace Llpc;
 
+// -dyn-index-expand-max-dwords: max size of a dynamically indexed private array that is expanded whatever its
+// element count
+static cl::opt<unsigned> DynIndexExpandMaxDwords("dyn-index-expand-max-dwords",
+                                                 cl::desc("Maximum size, in dwords, of a dynamically indexed private "
+                                                          "array that is expanded into selects on the index (so kept "
+                                                          "out of scratch) whatever its element count"),
+                                                 cl::init(16));
+
 namespace Llpc {
 
 // =====================================================================================================================
@@ -67,6 +79,7 @@ bool SpirvLowerMemoryOp::runOnModule(Module &module) {
 
   SpirvLower::init(&module);
 
+  m_maxExpandDwords = getMaxExpandDwords();
   visit(m_module);
 
   // Remove those instructions that are replaced by this lower pass
@@ -90,6 +103,15 @@ bool SpirvLowerMemoryOp::runOnModule(Module &module) {
   }
   m_removeInsts.clear();
 
+  if (!m_expandedVariables.empty()) {
+    uint64_t expandedBytes = 0;
+    for (AllocaInst *alloca : m_expandedVariables)
+      expandedBytes += module.getDataLayout().getTypeAllocSize(alloca->getAllocatedType());
+    LLPC_OUTS("Dynamic indexing of " << m_expandedVariables.size() << " private variable(s), " << expandedBytes
+                                     << " bytes, expanded to keep them out of scratch\n");
+    m_expandedVariables.clear();
+  }
+
   LLVM_DEBUG(dbgs() << "After the pass Spirv-Lower-Memory-Op " << module);
 
   return true;
@@ -175,7 +197,30 @@ void SpirvLowerMemoryOp::visitGetElementPtrInst(GetElementPtrInst &getElemPtrIns
 
     // Collect replaced instructions that will be removed
     m_removeInsts.insert(&getElemPtrInst);
+
+    // Record the variable, for reporting how much private memory was kept out of scratch.
+    Value *variable = getElemPtrInst.getPointerOperand()->stripPointerCasts();
+    while (auto baseGetElemPtr = dyn_cast<GEPOperator>(variable))
+      variable = baseGetElemPtr->getPointerOperand()->stripPointerCasts();
+    if (auto alloca = dyn_cast<AllocaInst>(variable))
+      m_expandedVariables.insert(alloca);
+  }
+}
+
+// =====================================================================================================================
+// Gets the max size in dwords of a dynamically indexed array that is expanded whatever its element count. Expanding
+// keeps every element of the array live in VGPRs around each access, so the limit is reduced to a quarter of the VGPR
+// limit of the shader if that is tighter.
+unsigned SpirvLowerMemoryOp::getMaxExpandDwords() const {
+  unsigned maxExpandDwords = DynIndexExpandMaxDwords;
+  if (m_context->getPipelineContext()) {
+    unsigned vgprLimit = m_context->getPipelineShaderInfo(m_shaderStage)->options.vgprLimit;
+    if (vgprLimit == 0 || vgprLimit == UINT_MAX)
+      vgprLimit = m_context->getPipelineContext()->getCompilerOptions().vgprLimit;
+    if (vgprLimit != 0 && vgprLimit != UINT_MAX)
+      maxExpandDwords = std::min(maxExpandDwords, vgprLimit / 4);
   }
+  return maxExpandDwords;
 }
 
 // =====================================================================================================================
@@ -212,8 +257,10 @@ bool SpirvLowerMemoryOp::needExpandDynamicIndex(GetElementPtrInst *getElemPtr, u
           // Check the upper bound of dynamic index
           if (isa<ArrayType>(indexedTy)) {
             auto arrayTy = dyn_cast<ArrayType>(indexedTy);
-            if (arrayTy->getNumElements() > MaxDynIndexBound) {
-              // Skip expand if array size greater than threshold
+            uint64_t arrayDwords = (m_module->getDataLayout().getTypeAllocSize(arrayTy) + 3) / 4;
+            if (arrayTy->getNumElements() > MaxDynIndexBound && arrayDwords > m_maxExpandDwords) {
+              // Skip expand if array size greater than threshold, unless the whole array is small enough to keep
+              // in registers, which is much faster than the scratch memory it would otherwise go to.
               allowExpand = false;
             } else
               *dynIndexBound = arrayTy->getNumElements();
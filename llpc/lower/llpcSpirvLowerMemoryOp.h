@@ -35,6 +35,7 @@
 #include <unordered_set>
 
 namespace llvm {
+class AllocaInst;
 class GetElementPtrInst;
 class StoreInst;
 } // namespace llvm
@@ -73,7 +74,10 @@ private:
                              llvm::Value *dynIndex);
   void expandStoreInst(llvm::StoreInst *storeInst, llvm::ArrayRef<llvm::GetElementPtrInst *> getElemPtrs,
                        llvm::Value *dynIndex);
+  unsigned getMaxExpandDwords() const;
 
+  unsigned m_maxExpandDwords = 0; // Max size in dwords of an array of any element count whose dynamic index is expanded
+  std::unordered_set<llvm::AllocaInst *> m_expandedVariables; // Private variables with dynamic indexing expanded
   std::unordered_set<llvm::Instruction *> m_removeInsts;
   std::unordered_set<llvm::Instruction *> m_preRemoveInsts;
   llvm::SmallVector<StoreExpandInfo, 1> m_storeExpandInfo;
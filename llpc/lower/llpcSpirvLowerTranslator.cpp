@@ -61,10 +61,6 @@ bool SpirvLowerTranslator::runOnModule(Module &module) {
 
   SpirvLower::init(&module);
 
-#ifdef LLPC_ENABLE_SPIRV_OPT
-  InitSpvGen();
-#endif
-
   m_context = static_cast<Context *>(&module.getContext());
 
   // Translate SPIR-V binary to machine-independent LLVM module
@@ -78,12 +74,11 @@ bool SpirvLowerTranslator::runOnModule(Module &module) {
 // @param shaderInfo : Specialization info
 // @param [in/out] module : Module to translate into, initially empty
 void SpirvLowerTranslator::translateSpirvToLlvm(const PipelineShaderInfo *shaderInfo, Module *module) {
-  BinaryData optimizedSpirvBin = {};
   const ShaderModuleData *moduleData = reinterpret_cast<const ShaderModuleData *>(shaderInfo->pModuleData);
   assert(moduleData->binType == BinaryType::Spirv);
+  // NOTE: With -enable-spirv-opt, the SPIR-V optimizer has already been run on the module by BuildShaderModule.
   const BinaryData *spirvBin = &moduleData->binCode;
-  if (ShaderModuleHelper::optimizeSpirv(spirvBin, &optimizedSpirvBin) == Result::Success)
-    spirvBin = &optimizedSpirvBin;
+  m_context->addTranslatedSpirvSize(spirvBin->codeSize);
 
   std::string spirvCode(static_cast<const char *>(spirvBin->pCode), spirvBin->codeSize);
   std::istringstream spirvStream(spirvCode);
@@ -103,8 +98,10 @@ void SpirvLowerTranslator::translateSpirvToLlvm(const PipelineShaderInfo *shader
 
   Context *context = static_cast<Context *>(&module->getContext());
 
+  auto debugInfoLevel =
+      static_cast<SPIRV::SPIRVDebugInfoLevel>(context->getPipelineContext()->getCompilerOptions().debugInfoLevel);
   if (!readSpirv(context->getBuilder(), &(moduleData->usage), spirvStream, convertToExecModel(entryStage),
-                 shaderInfo->pEntryTarget, specConstMap, module, errMsg)) {
+                 shaderInfo->pEntryTarget, specConstMap, module, errMsg, debugInfoLevel)) {
     report_fatal_error(Twine("Failed to translate SPIR-V to LLVM (") +
                            getShaderStageName(static_cast<ShaderStage>(entryStage)) + " shader): " + errMsg,
                        false);
@@ -114,8 +111,6 @@ void SpirvLowerTranslator::translateSpirvToLlvm(const PipelineShaderInfo *shader
   // rather than a pipeline compile.
   m_context->getBuilder()->recordShaderModes(module);
 
-  ShaderModuleHelper::cleanOptimizedSpirv(&optimizedSpirvBin);
-
   // NOTE: Our shader entrypoint is marked in the SPIR-V reader as dllexport. Here we mark it as follows:
   //   * remove the dllexport;
   //   * ensure it is public.
@@ -0,0 +1,34 @@
+#version 450
+
+layout(std430, set = 0, binding = 0) buffer BufferObject
+{
+    uint ui;
+    vec4 v4;
+} ssbo;
+
+layout(location = 0) out vec4 output0;
+
+void main()
+{
+    output0 = ssbo.v4;
+}
+
+// BEGIN_SHADERTEST
+/*
+; Nothing in the pipeline writes buffer memory, so with -scalarize-unwritten-buffer-loads the uniform read of the
+; storage buffer uses a scalar load.
+; RUN: amdllpc -spvgen-dir=%spvgendir% -v %gfxip -scalarize-unwritten-buffer-loads %s \
+; RUN:   | FileCheck -check-prefix=SCALAR %s
+; SCALAR-LABEL: {{^// LLPC}} pipeline patching results
+; SCALAR: call {{.*}}@llvm.amdgcn.s.buffer.load.{{[a-z0-9]+}}(<4 x i32> {{%[^,]+}}, i32 16, i32 0)
+; SCALAR-NOT: @llvm.amdgcn.raw.buffer.load
+; SCALAR: AMDLLPC SUCCESS
+
+; RUN: amdllpc -spvgen-dir=%spvgendir% -v %gfxip -scalarize-unwritten-buffer-loads=false %s \
+; RUN:   | FileCheck -check-prefix=VECTOR %s
+; VECTOR-LABEL: {{^// LLPC}} pipeline patching results
+; VECTOR: call {{.*}}@llvm.amdgcn.raw.buffer.load.{{[a-z0-9]+}}(<4 x i32> {{%[^,]+}}, i32 16, i32 0, i32 0)
+; VECTOR-NOT: @llvm.amdgcn.s.buffer.load
+; VECTOR: AMDLLPC SUCCESS
+*/
+// END_SHADERTEST
@@ -0,0 +1,29 @@
+#version 450
+
+layout(std430, set = 0, binding = 0) buffer BufferObject
+{
+    uint ui;
+    vec4 v4;
+} ssbo;
+
+layout(location = 0) out vec4 output0;
+
+void main()
+{
+    output0 = ssbo.v4;
+    ssbo.ui = 1;
+}
+
+// BEGIN_SHADERTEST
+/*
+; The shader writes the storage buffer, so -scalarize-unwritten-buffer-loads must leave the uniform read of it as a
+; vector memory load.
+; RUN: amdllpc -spvgen-dir=%spvgendir% -v %gfxip -scalarize-unwritten-buffer-loads %s \
+; RUN:   | FileCheck -check-prefix=SHADERTEST %s
+; SHADERTEST-LABEL: {{^// LLPC}} pipeline patching results
+; SHADERTEST: call {{.*}}@llvm.amdgcn.raw.buffer.load.{{[a-z0-9]+}}(<4 x i32> {{%[^,]+}}, i32 16, i32 0, i32 0)
+; SHADERTEST-NOT: @llvm.amdgcn.s.buffer.load
+; SHADERTEST: call void @llvm.amdgcn.raw.buffer.store.i32(i32 1, <4 x i32> {{%[^,]+}}, i32 0, i32 0, i32 0)
+; SHADERTEST: AMDLLPC SUCCESS
+*/
+// END_SHADERTEST
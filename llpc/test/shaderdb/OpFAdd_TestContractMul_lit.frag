@@ -0,0 +1,34 @@
+#version 450
+
+layout(binding = 0) uniform Uniforms
+{
+    vec4 a, b, c;
+    float d, e;
+};
+
+layout(location = 0) out vec4 fragColor0;
+layout(location = 1) out vec4 fragColor1;
+layout(location = 2) out float fragColor2;
+
+void main()
+{
+    fragColor0 = a * b + c;
+
+    precise vec4 p = b * c + a;
+    fragColor1 = p;
+
+    fragColor2 = d * e - a.x;
+}
+// BEGIN_SHADERTEST
+/*
+; RUN: amdllpc -spvgen-dir=%spvgendir% -v %gfxip %s | FileCheck -check-prefix=SHADERTEST %s
+; SHADERTEST-LABEL: {{^// LLPC}} SPIR-V lowering results
+; SHADERTEST: call reassoc nnan nsz arcp contract afn <4 x float> @llvm.fmuladd.v4f32(<4 x float> %{{[0-9]*}}, <4 x float> %{{[0-9]*}}, <4 x float> %{{[0-9]*}})
+; SHADERTEST: fmul nnan arcp afn <4 x float>
+; SHADERTEST: fadd nnan arcp afn <4 x float>
+; SHADERTEST: fneg reassoc nnan nsz arcp contract afn float
+; SHADERTEST: call reassoc nnan nsz arcp contract afn float @llvm.fmuladd.f32(float %{{[0-9]*}}, float %{{[0-9]*}}, float %{{[0-9]*}})
+; SHADERTEST-LABEL: {{^// LLPC}} pipeline patching results
+; SHADERTEST: AMDLLPC SUCCESS
+*/
+// END_SHADERTEST
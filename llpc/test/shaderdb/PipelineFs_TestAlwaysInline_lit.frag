@@ -0,0 +1,29 @@
+#version 450
+
+layout(location = 0) in vec4 color;
+layout(location = 1) in vec2 uv;
+layout(location = 0) out vec4 frag;
+
+vec4 scale(vec4 value, float factor)
+{
+    return value * factor;
+}
+
+void main()
+{
+    frag = scale(color, uv.x) + scale(color.wzyx, uv.y);
+}
+
+// BEGIN_SHADERTEST
+/*
+; The shader functions and the always-inline helpers added by the patch passes are all inlined into the entry-point,
+; and removed once they have no users left.
+; RUN: amdllpc -spvgen-dir=%spvgendir% -v %gfxip %s | FileCheck -check-prefix=SHADERTEST %s
+; SHADERTEST-LABEL: {{^// LLPC}} pipeline patching results
+; SHADERTEST-NOT: define
+; SHADERTEST: define {{.*}} @_amdgpu_ps_main(
+; SHADERTEST-NOT: define
+; SHADERTEST-NOT: call {{.*}} @{{.*}}scale
+; SHADERTEST: AMDLLPC SUCCESS
+*/
+// END_SHADERTEST
@@ -0,0 +1,28 @@
+#version 450
+#extension GL_EXT_demote_to_helper_invocation : require
+
+layout(location = 0) in vec4 color;
+layout(location = 0) out vec4 frag;
+
+void main()
+{
+    demote;
+    frag = color * 2.0;
+}
+
+// BEGIN_SHADERTEST
+/*
+; After a demote that runs with all live lanes active, the wave branches to a null export and ends when no lane is
+; left that can export.
+; RUN: amdllpc -spvgen-dir=%spvgendir% -v %gfxip %s | FileCheck -check-prefix=SHADERTEST %s
+; SHADERTEST-LABEL: {{^// LLPC}} pipeline patching results
+; SHADERTEST: call void @llvm.amdgcn.wqm.demote(i1 false)
+; SHADERTEST: call i1 @llvm.amdgcn.wqm.helper()
+; SHADERTEST: call {{i32|i64}} @llvm.amdgcn.icmp.{{i32|i64}}.i32(
+; SHADERTEST: br i1 %{{.*}}, label %.demoteExit, label %
+; SHADERTEST: .demoteExit:
+; SHADERTEST: call void @llvm.amdgcn.exp.f32(i32 9, i32 0, {{.*}}, i1 true, i1 true)
+; SHADERTEST-NEXT: ret void
+; SHADERTEST: AMDLLPC SUCCESS
+*/
+// END_SHADERTEST
@@ -0,0 +1,29 @@
+#version 450 core
+#extension GL_AMD_shader_ballot : enable
+#extension GL_KHR_shader_subgroup_quad : enable
+
+layout(location = 0) in flat uint value;
+layout(location = 0) out uvec4 result;
+
+void main()
+{
+    result = uvec4(swizzleInvocationsAMD(value, uvec4(1, 0, 3, 2)),
+                   swizzleInvocationsMaskedAMD(value, uvec3(0x1F, 0, 3)),
+                   subgroupQuadBroadcast(value, 2),
+                   swizzleInvocationsMaskedAMD(value, uvec3(0x1F, 0, 8)));
+}
+
+// BEGIN_SHADERTEST
+/*
+; Swizzles that stay within a quad, and a quad broadcast of a constant lane, are quad_perm DPP movs. A swizzle that
+; moves lanes between quads still uses ds_swizzle.
+; RUN: amdllpc -spvgen-dir=%spvgendir% -v %gfxip %s | FileCheck -check-prefix=SHADERTEST %s
+; SHADERTEST-LABEL: {{^// LLPC}} pipeline patching results
+; SHADERTEST: call i32 @llvm.amdgcn.mov.dpp.i32(i32 %{{.*}}, i32 177, i32 15, i32 15, i1 false)
+; SHADERTEST: call i32 @llvm.amdgcn.mov.dpp.i32(i32 %{{.*}}, i32 27, i32 15, i32 15, i1 false)
+; SHADERTEST: call i32 @llvm.amdgcn.mov.dpp.i32(i32 %{{.*}}, i32 170, i32 15, i32 15, i1 false)
+; SHADERTEST-NOT: call i32 @llvm.amdgcn.mov.dpp.i32
+; SHADERTEST: call i32 @llvm.amdgcn.ds.swizzle(i32 %{{.*}}, i32 8223)
+; SHADERTEST: AMDLLPC SUCCESS
+*/
+// END_SHADERTEST
@@ -0,0 +1,31 @@
+#version 310 es
+precision mediump float;
+
+layout(location = 0) in vec4 a;
+layout(location = 1) in vec4 b;
+layout(location = 0) out vec4 o;
+
+void main()
+{
+    o = ((a * b + 0.5) * a - b * 0.25) * 2.0;
+}
+
+// BEGIN_SHADERTEST
+/*
+; Without -relaxed-precision-to-f16, mediump arithmetic is computed in 32 bits.
+; RUN: amdllpc -spvgen-dir=%spvgendir% -v -gfxip=9.0.0 %s | FileCheck -check-prefix=SHADERTEST %s
+; SHADERTEST-LABEL: {{^// LLPC}} pipeline patching results
+; SHADERTEST-NOT: half
+; SHADERTEST: AMDLLPC SUCCESS
+
+; With -relaxed-precision-to-f16, the chain is computed in half precision; its inputs are truncated and its result
+; is extended again for the export.
+; RUN: amdllpc -spvgen-dir=%spvgendir% -v -gfxip=9.0.0 -relaxed-precision-to-f16 %s \
+; RUN:   | FileCheck -check-prefix=F16 %s
+; F16-LABEL: {{^// LLPC}} pipeline patching results
+; F16: fptrunc {{.*}} to {{.*}}half
+; F16: fmul {{.*}}half
+; F16: fpext {{.*}}half{{.*}} to
+; F16: AMDLLPC SUCCESS
+*/
+// END_SHADERTEST
@@ -0,0 +1,31 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(set = 0, binding = 0) uniform sampler2D samp[4];
+
+layout(location = 0) flat in int index;
+layout(location = 1) in vec2 uv;
+layout(location = 0) out vec4 frag;
+
+void main()
+{
+    frag = texture(samp[nonuniformEXT(index)], uv) + texture(samp[nonuniformEXT(index)], uv * 2.0);
+}
+
+// BEGIN_SHADERTEST
+/*
+; Without -batch-waterfall-loops, each non-uniform sample gets its own waterfall loop.
+; RUN: amdllpc -spvgen-dir=%spvgendir% -v %gfxip %s | FileCheck -check-prefix=SHADERTEST %s
+; SHADERTEST-LABEL: {{^// LLPC}} pipeline patching results
+; SHADERTEST-COUNT-2: call {{.*}} @llvm.amdgcn.waterfall.begin
+; SHADERTEST: AMDLLPC SUCCESS
+
+; With -batch-waterfall-loops, both samples use the same non-uniform index and share one waterfall loop.
+; RUN: amdllpc -spvgen-dir=%spvgendir% -v %gfxip -batch-waterfall-loops %s | FileCheck -check-prefix=BATCH %s
+; BATCH-LABEL: {{^// LLPC}} pipeline patching results
+; BATCH: call {{.*}} @llvm.amdgcn.waterfall.begin
+; BATCH-NOT: @llvm.amdgcn.waterfall.begin
+; BATCH-COUNT-2: call {{.*}} @llvm.amdgcn.waterfall.end
+; BATCH: AMDLLPC SUCCESS
+*/
+// END_SHADERTEST
@@ -29,8 +29,7 @@ void main()
 ; SHADERTEST-LABEL: {{^// LLPC}} SPIRV-to-LLVM translation results
 ; SHADERTEST-LABEL: {{^// LLPC}} SPIR-V lowering results
 ; SHADERTEST: fadd reassoc nnan nsz arcp contract afn <4 x half> %{{[0-9]*}}, %{{[0-9]*}}
-; SHADERTEST: fmul reassoc nnan nsz arcp contract afn <4 x half> %{{[0-9]*}}, %{{[0-9]*}}
-; SHADERTEST: fsub reassoc nnan nsz arcp contract afn <4 x half> %{{[0-9]*}}, %{{[0-9]*}}
+; SHADERTEST: call reassoc nnan nsz arcp contract afn <4 x half> @llvm.fmuladd.v4f16(<4 x half> %{{[0-9]*}}, <4 x half> %{{[0-9]*}}, <4 x half> %{{[0-9]*}})
 ; SHADERTEST: fdiv reassoc nnan nsz arcp contract afn <4 x half> <half 0xH3C00, half 0xH3C00, half 0xH3C00, half 0xH3C00>,
 ; SHADERTEST: fmul reassoc nnan nsz arcp contract afn <4 x half>
 ; SHADERTEST-LABEL: {{^// LLPC}} pipeline patching results
@@ -32,6 +32,7 @@ import platform
 import time
 import shutil
 import argparse
+import json
 from multiprocessing import Pool
 
 RESULT = "result"
@@ -42,12 +43,31 @@ SPVGEN  = ""
 
 GFX_DIRS = [".", "gfx9"]
 GFXIP = 0
+LOWER_TIME = False
+PERF_ITERATIONS = 3
+PERF_REPORT = ""
+PERF_BASELINE = ""
+PERF_THRESHOLD = 10.0
 
 fail_count = 0
 total_count = 0
 compile_name = "amdllpc"
 gfxip_str = " -gfxip="
 
+# Sum the wall time of the SPIR-V lowering phase reported by -enable-timer-profile in the log of a test
+def getLowerTime(logname):
+    lowerTime = 0.0
+    if os.path.exists(logname):
+        rf = open(logname, "r")
+        for line in rf:
+            if re.search(" Lower 0x", line):
+                # The last "time (percent)" column is the wall time
+                times = re.findall(r"([0-9.]+) \(\s*[0-9.]+%\)", line)
+                if times:
+                    lowerTime += float(times[-1])
+        rf.close()
+    return lowerTime
+
 # Compile specified shader in sub process
 def compile(cmdname, gfx, f, compiler):
     start = time.time()
@@ -74,8 +94,143 @@ def compile(cmdname, gfx, f, compiler):
         msg = "(PASS) " + f + " (" + str(escape_time) +")"
     else :
         msg = "(FAIL) " + f + " (" + str(escape_time) +")"
+    if LOWER_TIME:
+        msg += " [lower: " + str(getLowerTime(RESULT + "/" + gfx + "/" + f + ".log")) + "]"
     return msg
 
+# Phases reported by "amdllpc -build-stats", in the order they are printed. Patch, Optimization and CodeGen are parts
+# of Generate, and are only measured with -enable-timer-profile.
+PERF_PHASES = ["Translate", "Lower", "Generate", "Patch", "Optimization", "CodeGen", "Link", "CacheLookup"]
+
+# Build the given shader PERF_ITERATIONS times in one amdllpc process and collect its compile statistics
+def measure(cmdname, logname):
+    log = open(logname, "w")
+    proc = subprocess.Popen(cmdname, shell = True, stdout = log, stderr = subprocess.STDOUT)
+    # Peak RSS of the compiler process, in KB on Linux (only available where wait4 is)
+    peak_rss = 0
+    if hasattr(os, "wait4"):
+        pid, status, usage = os.wait4(proc.pid, 0)
+        proc.returncode = os.WEXITSTATUS(status) if os.WIFEXITED(status) else 1
+        peak_rss = usage.ru_maxrss
+    else:
+        proc.wait()
+    log.close()
+
+    stats = {"passed": proc.returncode == 0, "peakRss": peak_rss, "builds": 0, "cacheHits": 0}
+    for phase in PERF_PHASES:
+        stats[phase] = 0.0
+    rf = open(logname, "r")
+    for line in rf:
+        if line.startswith("LLPC PipelineMetrics: "):
+            stats["metrics"] = json.loads(line[len("LLPC PipelineMetrics: "):].split(" Files: ")[0])
+            continue
+        if not line.startswith("LLPC BuildStats:"):
+            continue
+        stats["builds"] += 1
+        for phase in PERF_PHASES:
+            m = re.search(" " + phase + r": ([0-9.]+)", line)
+            if m:
+                stats[phase] += float(m.group(1))
+        m = re.search(r" CacheHit: ([01])", line)
+        if m:
+            stats["cacheHits"] += int(m.group(1))
+    rf.close()
+    # Report the average time of one build
+    if stats["builds"] > 0:
+        for phase in PERF_PHASES:
+            stats[phase] /= stats["builds"]
+    return stats
+
+# Sum one phase over every shader of a report
+def perfTotal(report, phase):
+    total = 0.0
+    for stats in report.values():
+        total += stats[phase]
+    return total
+
+# Compare a report with a baseline report, print the regressions and return the number of them
+def comparePerf(report, baseline):
+    regressions = 0
+    for phase in PERF_PHASES + ["peakRss"]:
+        new_total = perfTotal(report, phase)
+        old_total = perfTotal(dict((k, v) for k, v in baseline.items() if k in report), phase)
+        if old_total <= 0:
+            continue
+        change = (new_total - old_total) * 100.0 / old_total
+        status = ""
+        if change > PERF_THRESHOLD:
+            status = " (REGRESSION)"
+            regressions += 1
+        print("%-13s %12.6f -> %12.6f (%+.1f%%)%s" % (phase, old_total, new_total, change, status))
+    # Static code metrics are reported as they are, the changes are not necessarily regressions
+    for name in sorted(report.keys()):
+        if name not in baseline:
+            continue
+        new_metrics = report[name].get("metrics", {})
+        old_metrics = baseline[name].get("metrics", {})
+        for stage in sorted(new_metrics.keys()):
+            for key in sorted(new_metrics[stage].keys()):
+                old_value = old_metrics.get(stage, {}).get(key)
+                if old_value is not None and old_value != new_metrics[stage][key]:
+                    print("%s %s %s: %d -> %d" % (name, stage, key, old_value, new_metrics[stage][key]))
+    return regressions
+
+# Build every shader of the corpus repeatedly, write a JSON report and optionally compare it with a baseline
+def runPerf():
+    report = {}
+    fail = 0
+    for gfx in GFX_DIRS:
+        if not os.path.exists(SHADER_SRC + "/" + gfx):
+            continue
+        if gfx.startswith("gfx") and GFXIP and gfx[3] > GFXIP:
+            continue
+        # Shaders are built one at a time, so that they do not compete for the CPU
+        for f in sorted(os.listdir(SHADER_SRC + "/" + gfx)):
+            if not (f.endswith(".vert") or f.endswith(".tesc") or f.endswith(".tese") or f.endswith(".frag") or f.endswith(".geom") or f.endswith(".comp") or f.endswith(".spvasm") or f.endswith(".pipe")):
+                continue
+            gfxip = " "
+            if GFXIP:
+                gfxip = gfxip_str + GFXIP
+            elif gfx.startswith("gfx"):
+                gfxip = gfxip_str + gfx[3]
+            cmd = COMPILER + gfxip + " -enable-outs=0 -pipeline-metrics -build-stats -build-repeat=" + str(PERF_ITERATIONS) + " " + SHADER_SRC + "/" + gfx + "/" + f
+            stats = measure(cmd, RESULT + "/" + gfx + "/" + f + ".log")
+            if not stats["passed"]:
+                fail += 1
+                print("(FAIL) " + f)
+                continue
+            report[gfx + "/" + f] = stats
+
+    wf = open(PERF_REPORT, "w")
+    json.dump(report, wf, indent = 2, sort_keys = True)
+    wf.close()
+
+    print("================================  PERF SUMMARY  ===============================")
+    print("Shaders: " + str(len(report)) + " Iterations: " + str(PERF_ITERATIONS) + " Failed: " + str(fail))
+    builds = sum(stats["builds"] for stats in report.values())
+    hits = sum(stats["cacheHits"] for stats in report.values())
+    if builds > 0:
+        print("Cache hit rate: %.1f%%" % (hits * 100.0 / builds))
+    regressions = 0
+    if PERF_BASELINE:
+        rf = open(PERF_BASELINE, "r")
+        baseline = json.load(rf)
+        rf.close()
+        regressions = comparePerf(report, baseline)
+    else:
+        for phase in PERF_PHASES:
+            print("%-13s %12.6f" % (phase, perfTotal(report, phase)))
+    print("Report: " + PERF_REPORT)
+    return fail == 0 and regressions == 0
+
+# Accumulate the lowering time reported in a result message
+total_lower_time = 0.0
+def addLowerTime(msg):
+    global total_lower_time
+    m = re.search(r"\[lower: ([0-9.e-]+)\]", msg)
+    if m:
+        total_lower_time += float(m.group(1))
+
 def prepareTesting():
     # parser argument
     parser = argparse.ArgumentParser(description = 'Script for shader compiler testing.')
@@ -87,6 +242,16 @@ def prepareTesting():
             help = 'Folder containing shader.')
     parser.add_argument('--gfxip',
             help = 'Assign gfxip to compile the shader.')
+    parser.add_argument('--lower-time', action = 'store_true',
+            help = 'Report the SPIR-V lowering time of each shader.')
+    parser.add_argument('--perf-report',
+            help = 'Measure compile time instead of testing, and write a JSON report to this file.')
+    parser.add_argument('--perf-iterations', type = int,
+            help = 'Number of times each shader is built when measuring compile time (default 3).')
+    parser.add_argument('--perf-baseline',
+            help = 'JSON report to compare the compile time measurement with.')
+    parser.add_argument('--perf-threshold', type = float,
+            help = 'Percentage of slowdown over the baseline reported as a regression (default 10).')
 
     args = parser.parse_args()
     compiler_path = args.compiler
@@ -102,6 +267,20 @@ def prepareTesting():
         global GFXIP
         GFXIP = args.gfxip
 
+    if args.lower_time:
+        global LOWER_TIME
+        LOWER_TIME = True
+
+    global PERF_REPORT, PERF_ITERATIONS, PERF_BASELINE, PERF_THRESHOLD
+    if args.perf_report:
+        PERF_REPORT = args.perf_report
+    if args.perf_iterations:
+        PERF_ITERATIONS = args.perf_iterations
+    if args.perf_baseline:
+        PERF_BASELINE = args.perf_baseline
+    if args.perf_threshold:
+        PERF_THRESHOLD = args.perf_threshold
+
     # Check compiler
     global COMPILER
     if platform.system() != "Windows":
@@ -146,6 +325,9 @@ if __name__=='__main__':
 
     if prepareTesting():
 
+        if PERF_REPORT:
+            sys.exit(0 if runPerf() else 1)
+
         print("\n=================================  RUN TESTS  =================================")
         start_time = time.time()
         for gfx in GFX_DIRS:
@@ -181,10 +363,14 @@ if __name__=='__main__':
                                 val = "-val=false"
 
                         cmd = COMPILER + gfxip + " " + val + " -enable-outs=0 " + SHADER_SRC + "/" + gfx + "/" + f + " 2>&1 >> " + RESULT + "/" + gfx + "/" + f + ".log"
+                        if LOWER_TIME:
+                            # Timer reports go to stderr, so send it to the log as well
+                            cmd = COMPILER + gfxip + " " + val + " -enable-outs=0 -enable-timer-profile " + SHADER_SRC + "/" + gfx + "/" + f + " >> " + RESULT + "/" + gfx + "/" + f + ".log 2>&1"
                     if sub_index == 0 :
                         # Run test in sync-compile mode to setup context cache
                         result = compile(cmd, gfx, f, compile_name)
                         print(result)
+                        addLowerTime(result)
                         if re.search("(FAIL)", result):
                             fail_count = fail_count + 1
                     else :
@@ -195,6 +381,7 @@ if __name__=='__main__':
                     if (sub_index > 8) :
                         result = result_msg[sub_index - 8].get()
                         print(result)
+                        addLowerTime(result)
                         if re.search("(FAIL)", result):
                             fail_count = fail_count + 1
 
@@ -209,6 +396,7 @@ if __name__=='__main__':
             while (i >= 0) and i < len(result_msg) :
                 result = result_msg[i].get()
                 print(result)
+                addLowerTime(result)
                 if re.search("(FAIL)", result):
                     fail_count = fail_count + 1
                 i += 1
@@ -220,6 +408,8 @@ if __name__=='__main__':
                 os.remove(f)
         print("================================  TEST SUMMARY  ===============================")
         print("Total time: " + str(end_time - start_time))
+        if LOWER_TIME:
+            print("Total lower time: " + str(total_lower_time))
         if fail_count == 0:
             print(compile_name.upper() + " TEST PASS (TOTAL: " + str(total_count) + ")")
             sys.exit(0)
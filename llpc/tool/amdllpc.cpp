@@ -34,6 +34,7 @@
 #endif
 
 #include "amdllpc.h"
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/AsmParser/Parser.h"
 #include "llvm/Bitcode/BitcodeWriter.h"
 #include "llvm/IR/LLVMContext.h"
@@ -43,6 +44,7 @@
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Format.h"
 #include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/PrettyStackTrace.h"
 #include "llvm/Support/Signals.h"
@@ -61,8 +63,15 @@
 #endif
 #endif
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <mutex>
 #include <sstream>
 #include <stdlib.h> // getenv
+#include <thread>
 
 // NOTE: To enable VLD, please add option BUILD_WIN_VLD=1 in build option.To run amdllpc with VLD enabled,
 // please copy vld.ini and all files in.\winVisualMemDetector\bin\Win64 to current directory of amdllpc.
@@ -74,7 +83,9 @@
 #define SPVGEN_STATIC_LIB 1
 #endif
 #include "llpc.h"
+#include "llpcCallTrace.h"
 #include "llpcDebug.h"
+#include "llpcRemoteCache.h"
 #include "llpcShaderModuleHelper.h"
 #include "llpcSpirvLowerUtil.h"
 #include "llpcUtil.h"
@@ -98,7 +109,7 @@ static cl::opt<std::string> GfxIp("gfxip", cl::desc("Graphics IP version"), cl::
 static GfxIpVersion ParsedGfxIp = {8, 0, 2};
 
 // Input sources
-static cl::list<std::string> InFiles(cl::Positional, cl::OneOrMore, cl::ValueRequired,
+static cl::list<std::string> InFiles(cl::Positional, cl::ZeroOrMore, cl::ValueRequired,
                                      cl::desc("<source>...\n"
                                               "Type of input file is determined by its filename extension:\n"
                                               "  .spv      SPIR-V binary\n"
@@ -110,6 +121,7 @@ static cl::list<std::string> InFiles(cl::Positional, cl::OneOrMore, cl::ValueReq
                                               "  .frag     GLSL fragment shader\n"
                                               "  .comp     GLSL compute shader\n"
                                               "  .pipe     Pipeline info file\n"
+                                              "  .pipeb    Binary pipeline info file (see -emit-pipeline-binary)\n"
                                               "  .ll       LLVM IR assembly text"));
 
 // -o: output
@@ -199,6 +211,12 @@ static cl::opt<bool>
                                  cl::desc("Enable culling when \"cull distance\" exports are present (NGG)"),
                                  cl::init(false));
 
+// -ngg-enable-auto-culling: choose the cullers from the cost of the vertex-processing stage (NGG)
+static cl::opt<bool> NggEnableAutoCulling("ngg-enable-auto-culling",
+                                          cl::desc("Choose the cullers from the cost of the vertex-processing "
+                                                   "stage (NGG)"),
+                                          cl::init(false));
+
 // -ngg-backface-exponent: control backface culling algorithm (NGG, 1 ~ UINT32_MAX, 0 disables it)
 static cl::opt<unsigned> NggBackfaceExponent("ngg-backface-exponent",
                                              cl::desc("Control backface culling algorithm (NGG)"),
@@ -238,6 +256,12 @@ static cl::opt<bool> EnableRelocatableShaderElf("enable-relocatable-shader-elf",
                                                 cl::desc("Compile pipelines using relocatable shader elf"),
                                                 cl::init(false));
 
+// -pipeline-library: build graphics pipelines as separately compiled pipeline library parts that are then linked
+static cl::opt<bool> PipelineLibrary("pipeline-library",
+                                     cl::desc("Build graphics pipelines as pipeline library parts, "
+                                              "then link the parts"),
+                                     cl::init(false));
+
 // -check-auto-layout-compatible: check if auto descriptor layout got from spv file is commpatible with real layout
 static cl::opt<bool> CheckAutoLayoutCompatible(
     "check-auto-layout-compatible",
@@ -279,17 +303,117 @@ static opt<bool>
 
 } // namespace llvm
 
+// -server: run as a compile server
+static cl::opt<bool> ServerMode("server",
+                                cl::desc("Run as a compile server, compiling the input files named on stdin, one "
+                                         "request per line"),
+                                cl::init(false));
+
+// -j: number of threads to compile pipeline files with
+static cl::opt<unsigned> NumThreads("j", cl::desc("Number of threads to compile separate pipeline files with"),
+                                    cl::value_desc("threads"), cl::init(1));
+
+// -build-stats: print the compile statistics of each pipeline build
+static cl::opt<bool> BuildStats("build-stats", cl::desc("Print the compile statistics of each pipeline build"),
+                                cl::init(false));
+
+// -build-repeat: number of times to build each pipeline
+static cl::opt<unsigned> BuildRepeat("build-repeat",
+                                     cl::desc("Number of times to build each pipeline in this process, so that "
+                                              "compile time and cache behavior can be measured"),
+                                     cl::value_desc("count"), cl::init(1));
+
+// -pipeline-metrics: print the static code metrics of each pipeline
+static cl::opt<bool> PipelineMetrics("pipeline-metrics",
+                                     cl::desc("Print the static code metrics (register usage, occupancy, LDS and "
+                                              "scratch size, instruction counts) of each pipeline as JSON"),
+                                     cl::init(false));
+
+// -compile-only: compile without producing output, and report compile cost as CSV
+static cl::opt<bool> CompileOnly("compile-only",
+                                 cl::desc("Compile each input without writing the output file, disassembly or "
+                                          "pipeline dumps, and print the compile time and largest memory growth of a "
+                                          "compile phase of each as a CSV line on stdout"),
+                                 cl::init(false));
+
+// -remote-cache-plugin: plugin that provides a remote store for the pipeline cache
+static cl::opt<std::string> RemoteCachePlugin("remote-cache-plugin",
+                                              cl::desc("Shared library that provides a remote store to look up and "
+                                                       "upload compiled pipelines"),
+                                              cl::value_desc("filename"), cl::init(""));
+
+// -remote-cache-config: configuration string passed to the remote cache plugin
+static cl::opt<std::string> RemoteCacheConfig("remote-cache-config",
+                                              cl::desc("Configuration string passed to the remote cache plugin"),
+                                              cl::value_desc("config"), cl::init(""));
+
+// -remote-cache-key-list: file of the cache keys to prefetch from the remote store
+static cl::opt<std::string> RemoteCacheKeyList("remote-cache-key-list",
+                                               cl::desc("File listing the cache keys to prefetch from the remote "
+                                                        "store, rewritten on exit with the keys used by this run"),
+                                               cl::value_desc("filename"), cl::init(""));
+
+// -emit-cache-blob: compile the input pipelines into a shader cache blob
+static cl::opt<std::string> EmitCacheBlob("emit-cache-blob",
+                                          cl::desc("Compile the input pipeline files (or the .pipe files in the "
+                                                   "input directories) into one shader cache, and write it to the "
+                                                   "named file in the form loaded by CreateShaderCache"),
+                                          cl::value_desc("filename"), cl::init(""));
+
+// -cache-blob-initial-data: shader cache blob to seed the -emit-cache-blob cache with
+static cl::opt<std::string> CacheBlobInitialData("cache-blob-initial-data",
+                                                 cl::desc("Seed the shader cache of -emit-cache-blob with the named "
+                                                          "cache blob, as the initial data of CreateShaderCache"),
+                                                 cl::value_desc("filename"), cl::init(""));
+
+// -emit-pipeline-binary: convert the input pipeline info file to the binary form
+static cl::opt<bool> EmitPipelineBinary("emit-pipeline-binary",
+                                        cl::desc("Write the input .pipe file as a binary pipeline info file (.pipeb), "
+                                                 "which loads without parsing, to the -o file or next to the input "
+                                                 "file, instead of compiling it. A .pipeb file compiles like a .pipe "
+                                                 "file, so -enable-pipeline-dump turns it back into text"),
+                                        cl::init(false));
+
+// -replay-trace: replay the ICompiler calls of a call trace captured with -capture-trace-dir
+static cl::opt<std::string> ReplayTrace("replay-trace",
+                                        cl::desc("Replay the ICompiler calls of a call trace captured with "
+                                                 "-capture-trace-dir, with the same threads and call timing"),
+                                        cl::value_desc("filename"), cl::init(""));
+
+// -replay-time-scale: scale of the call start times in -replay-trace
+static cl::opt<double> ReplayTimeScale("replay-time-scale",
+                                       cl::desc("Scale of the call start times in -replay-trace (0 to issue the calls "
+                                                "of each thread back to back)"),
+                                       cl::init(1.0));
+
 #ifdef WIN_OS
 // -assert-to-msgbox: pop message box when an assert is hit, only valid in Windows
 static cl::opt<bool> AssertToMsgBox("assert-to-msgbox", cl::desc("Pop message box when assert is hit"));
 #endif
 
+// Remote cache given to the compilers if -remote-cache-plugin is set. Its key list is written when it is destroyed
+// at exit.
+static struct RemoteCacheHolder {
+  ~RemoteCacheHolder() {
+    if (cache && !RemoteCacheKeyList.empty() && cache->saveKeyList(RemoteCacheKeyList.c_str()) != Result::Success)
+      LLPC_ERRS("Failed to write remote cache key list " << RemoteCacheKeyList << "\n");
+  }
+  std::unique_ptr<RemoteCache> cache;
+} TheRemoteCache;
+
+#if LLPC_CLIENT_INTERFACE_MAJOR_VERSION < 38 || LLPC_ENABLE_SHADER_CACHE
+// Shader cache that all pipelines are built into if -emit-cache-blob is set. It is shared by the compilers of all
+// threads, so a pipeline that appears in several input files is compiled and stored once.
+static IShaderCache *CacheBlobCache = nullptr;
+#endif
+
 // Represents allowed extensions of LLPC source files.
 namespace LlpcExt {
 
 const char SpirvBin[] = ".spv";
 const char SpirvText[] = ".spvasm";
 const char PipelineInfo[] = ".pipe";
+const char PipelineBinary[] = ".pipeb";
 const char LlvmIr[] = ".ll";
 
 } // namespace LlpcExt
@@ -319,6 +443,7 @@ struct CompileInfo {
   bool doAutoLayout;              // Whether to auto layout descriptors
   bool checkAutoLayoutCompatible; // Whether to comapre if auto layout descriptors is
                                   // same as specified pipeline layout
+  PipelineBuildStats buildStats;  // Compile statistics of the last pipeline build
 };
 
 // =====================================================================================================================
@@ -446,6 +571,21 @@ static Result init(int argc, char *argv[], ICompiler **ppCompiler) {
     }
 
     result = ICompiler::Create(ParsedGfxIp, argc, argv, ppCompiler);
+
+    // The options are only parsed by ICompiler::Create, so once the remote cache is set up the compiler is created
+    // again to use it.
+    if (result == Result::Success && !RemoteCachePlugin.empty()) {
+      TheRemoteCache.cache.reset(
+          RemoteCache::create(ParsedGfxIp, RemoteCachePlugin.c_str(), RemoteCacheConfig.c_str()));
+      if (TheRemoteCache.cache) {
+        // The key list does not exist before the first run.
+        if (!RemoteCacheKeyList.empty())
+          TheRemoteCache.cache->loadKeyList(RemoteCacheKeyList.c_str());
+        (*ppCompiler)->Destroy();
+        result = ICompiler::Create(ParsedGfxIp, argc, argv, ppCompiler, TheRemoteCache.cache.get());
+      } else
+        result = Result::ErrorUnavailable;
+    }
   }
 
   if (result == Result::Success && SpvGenDir != "") {
@@ -488,6 +628,7 @@ static Result initCompileInfo(CompileInfo *compileInfo) {
     nggState.subgroupSizing = static_cast<NggSubgroupSizingType>(NggSubgroupSizing.getValue());
     nggState.primsPerSubgroup = NggPrimsPerSubgroup;
     nggState.vertsPerSubgroup = NggVertsPerSubgroup;
+    nggState.enableAutoCulling = NggEnableAutoCulling;
   }
 
   return Result::Success;
@@ -563,7 +704,7 @@ static bool isSpirvBinaryFile(const std::string &fileName) {
 }
 
 // =====================================================================================================================
-// Checks whether the specified file name represents a LLPC pipeline info file (.pipe).
+// Checks whether the specified file name represents a LLPC pipeline info file (.pipe), or its binary form (.pipeb).
 //
 // @param fileName : File name to check
 static bool isPipelineInfoFile(const std::string &fileName) {
@@ -574,7 +715,7 @@ static bool isPipelineInfoFile(const std::string &fileName) {
   if (extPos != std::string::npos)
     extName = fileName.substr(extPos, fileName.size() - extPos);
 
-  if (!extName.empty() && extName == LlpcExt::PipelineInfo)
+  if (!extName.empty() && (extName == LlpcExt::PipelineInfo || extName == LlpcExt::PipelineBinary))
     isPipelineInfo = true;
 
   return isPipelineInfo;
@@ -814,6 +955,13 @@ static Result decodePipelineBinary(const BinaryData *pipelineBin, CompileInfo *c
     LLPC_OUTS("===============================================================================\n");
     LLPC_OUTS("// LLPC final ELF info\n");
     LLPC_OUTS(reader);
+
+    if (PipelineMetrics) {
+      outs() << "LLPC PipelineMetrics: ";
+      dumpElfMetrics(outs(), reader);
+      outs() << " Files: " << compileInfo->fileNames << "\n";
+      outs().flush();
+    }
   }
 
   return Result::Success;
@@ -923,6 +1071,55 @@ static Result checkAutoLayoutCompatibleFunc(const ICompiler *compiler, CompileIn
   return result;
 }
 
+// =====================================================================================================================
+// Prints the compile statistics of one pipeline build, one line per build.
+//
+// @param compileInfo : Compilation info of LLPC standalone tool
+// @param iteration : Index of this build when the pipeline is built repeatedly
+// @param stats : Compile statistics of the build
+static void printBuildStats(const CompileInfo *compileInfo, unsigned iteration, const PipelineBuildStats &stats) {
+  outs() << "LLPC BuildStats: Iteration: " << iteration << format(" Translate: %.6f", stats.translateTime)
+         << format(" Lower: %.6f", stats.lowerTime) << format(" Generate: %.6f", stats.generateTime)
+         << format(" Patch: %.6f", stats.patchTime) << format(" Optimization: %.6f", stats.optTime)
+         << format(" CodeGen: %.6f", stats.codeGenTime) << format(" Link: %.6f", stats.linkTime)
+         << format(" CacheLookup: %.6f", stats.cacheLookupTime) << " CacheHit: " << (stats.cacheHit ? 1 : 0)
+         << " MaxPhaseMemoryGrowth: " << stats.maxPhaseMemoryGrowth << " LessUnrolled: " << (stats.lessUnrolled ? 1 : 0)
+         << " BudgetExceeded: " << (stats.compileBudgetExceeded ? 1 : 0) << " Files: " << compileInfo->fileNames
+         << "\n";
+  outs().flush();
+}
+
+// =====================================================================================================================
+// Builds a graphics pipeline as the parts of a graphics pipeline library, then links the parts.
+//
+// @param compiler : LLPC compiler object
+// @param [in,out] pipelineInfo : Info to build the pipeline
+// @param [out] pipelineOut : Output of linking the pipeline
+static Result buildGraphicsPipelineFromParts(ICompiler *compiler, GraphicsPipelineBuildInfo *pipelineInfo,
+                                             GraphicsPipelineBuildOut *pipelineOut) {
+  constexpr unsigned PartCount = static_cast<unsigned>(GraphicsPipelinePart::Count);
+  void *partBufs[PartCount] = {};
+  BinaryData partBins[PartCount] = {};
+  void *pipelineUserData = pipelineInfo->pUserData;
+
+  // Each part gets its own output buffer, as allocateBuffer() overwrites the one it is given.
+  Result result = Result::Success;
+  for (unsigned part = 0; part < PartCount && result == Result::Success; ++part) {
+    GraphicsPipelineBuildOut partOut = {};
+    pipelineInfo->pUserData = &partBufs[part];
+    result = compiler->BuildGraphicsPipelinePart(pipelineInfo, static_cast<GraphicsPipelinePart>(part), &partOut);
+    partBins[part] = partOut.pipelineBin;
+  }
+  pipelineInfo->pUserData = pipelineUserData;
+
+  if (result == Result::Success)
+    result = compiler->LinkGraphicsPipelineParts(pipelineInfo, partBins, pipelineOut, nullptr, nullptr);
+
+  for (void *partBuf : partBufs)
+    free(partBuf);
+  return result;
+}
+
 // =====================================================================================================================
 // Builds pipeline and do linking.
 //
@@ -973,9 +1170,16 @@ static Result buildPipeline(ICompiler *compiler, CompileInfo *compileInfo) {
 
     pipelineInfo->options.robustBufferAccess = RobustBufferAccess;
     pipelineInfo->options.enableRelocatableShaderElf = EnableRelocatableShaderElf;
+#if LLPC_CLIENT_INTERFACE_MAJOR_VERSION < 38 || LLPC_ENABLE_SHADER_CACHE
+    pipelineInfo->pShaderCache = CacheBlobCache;
+#endif
+    if (PipelineMetrics && !CompileOnly) {
+      // Instruction counts come from the disassembly.
+      pipelineInfo->options.includeDisassembly = true;
+    }
 
     void *pipelineDumpHandle = nullptr;
-    if (cl::EnablePipelineDump) {
+    if (cl::EnablePipelineDump && !CompileOnly) {
       PipelineDumpOptions dumpOptions = {};
       dumpOptions.pDumpDir = cl::PipelineDumpDir.c_str();
       dumpOptions.filterPipelineDumpByType = cl::FilterPipelineDumpByType;
@@ -993,10 +1197,30 @@ static Result buildPipeline(ICompiler *compiler, CompileInfo *compileInfo) {
       outs().flush();
     }
 
-    result = compiler->BuildGraphicsPipeline(pipelineInfo, pipelineOut, pipelineDumpHandle);
+    PipelineBuildStats &stats = compileInfo->buildStats;
+    if (BuildStats || CompileOnly)
+      pipelineOut->pStats = &stats;
+
+    // NOTE: Repeated builds only dump the first one, and keep only the output of the last one.
+    for (unsigned iteration = 0; iteration < std::max(1u, BuildRepeat.getValue()); ++iteration) {
+      if (iteration > 0) {
+        free(compileInfo->pipelineBuf);
+        compileInfo->pipelineBuf = nullptr;
+      }
+      void *dumpHandle = iteration == 0 ? pipelineDumpHandle : nullptr;
+      if (PipelineLibrary)
+        result = buildGraphicsPipelineFromParts(compiler, pipelineInfo, pipelineOut);
+      else
+        result = compiler->BuildGraphicsPipeline(pipelineInfo, pipelineOut, dumpHandle);
+      if (result != Result::Success)
+        break;
+      if (BuildStats)
+        printBuildStats(compileInfo, iteration, stats);
+    }
+    pipelineOut->pStats = nullptr;
 
     if (result == Result::Success) {
-      if (cl::EnablePipelineDump) {
+      if (cl::EnablePipelineDump && !CompileOnly) {
         Vkgc::BinaryData pipelineBinary = {};
         pipelineBinary.codeSize = pipelineOut->pipelineBin.codeSize;
         pipelineBinary.pCode = pipelineOut->pipelineBin.pCode;
@@ -1005,7 +1229,8 @@ static Result buildPipeline(ICompiler *compiler, CompileInfo *compileInfo) {
         Vkgc::IPipelineDumper::EndPipelineDump(pipelineDumpHandle);
       }
 
-      result = decodePipelineBinary(&pipelineOut->pipelineBin, compileInfo, true);
+      if (!CompileOnly)
+        result = decodePipelineBinary(&pipelineOut->pipelineBin, compileInfo, true);
     }
   }
   else {
@@ -1040,9 +1265,16 @@ static Result buildPipeline(ICompiler *compiler, CompileInfo *compileInfo) {
     pipelineInfo->unlinked = compileInfo->unlinked;
     pipelineInfo->options.robustBufferAccess = RobustBufferAccess;
     pipelineInfo->options.enableRelocatableShaderElf = EnableRelocatableShaderElf;
+#if LLPC_CLIENT_INTERFACE_MAJOR_VERSION < 38 || LLPC_ENABLE_SHADER_CACHE
+    pipelineInfo->pShaderCache = CacheBlobCache;
+#endif
+    if (PipelineMetrics && !CompileOnly) {
+      // Instruction counts come from the disassembly.
+      pipelineInfo->options.includeDisassembly = true;
+    }
 
     void *pipelineDumpHandle = nullptr;
-    if (cl::EnablePipelineDump) {
+    if (cl::EnablePipelineDump && !CompileOnly) {
       PipelineDumpOptions dumpOptions = {};
       dumpOptions.pDumpDir = cl::PipelineDumpDir.c_str();
       dumpOptions.filterPipelineDumpByType = cl::FilterPipelineDumpByType;
@@ -1059,10 +1291,27 @@ static Result buildPipeline(ICompiler *compiler, CompileInfo *compileInfo) {
       outs().flush();
     }
 
-    result = compiler->BuildComputePipeline(pipelineInfo, pipelineOut, pipelineDumpHandle);
+    PipelineBuildStats &stats = compileInfo->buildStats;
+    if (BuildStats || CompileOnly)
+      pipelineOut->pStats = &stats;
+
+    // NOTE: Repeated builds only dump the first one, and keep only the output of the last one.
+    for (unsigned iteration = 0; iteration < std::max(1u, BuildRepeat.getValue()); ++iteration) {
+      if (iteration > 0) {
+        free(compileInfo->pipelineBuf);
+        compileInfo->pipelineBuf = nullptr;
+      }
+      void *dumpHandle = iteration == 0 ? pipelineDumpHandle : nullptr;
+      result = compiler->BuildComputePipeline(pipelineInfo, pipelineOut, dumpHandle);
+      if (result != Result::Success)
+        break;
+      if (BuildStats)
+        printBuildStats(compileInfo, iteration, stats);
+    }
+    pipelineOut->pStats = nullptr;
 
     if (result == Result::Success) {
-      if (cl::EnablePipelineDump) {
+      if (cl::EnablePipelineDump && !CompileOnly) {
         Vkgc::BinaryData pipelineBinary = {};
         pipelineBinary.codeSize = pipelineOut->pipelineBin.codeSize;
         pipelineBinary.pCode = pipelineOut->pipelineBin.pCode;
@@ -1071,7 +1320,8 @@ static Result buildPipeline(ICompiler *compiler, CompileInfo *compileInfo) {
         Vkgc::IPipelineDumper::EndPipelineDump(pipelineDumpHandle);
       }
 
-      result = decodePipelineBinary(&pipelineOut->pipelineBin, compileInfo, false);
+      if (!CompileOnly)
+        result = decodePipelineBinary(&pipelineOut->pipelineBin, compileInfo, false);
     }
   }
 
@@ -1118,6 +1368,9 @@ static Result outputElf(CompileInfo *compileInfo, const std::string &suppliedOut
   }
 
   if (result == Result::Success) {
+    // In server mode, stdout also carries the responses, so frame the ELF with its size.
+    if (ServerMode && outFile == stdout)
+      fprintf(outFile, "ELF %zu\n", pipelineBin->codeSize);
     if (fwrite(pipelineBin->pCode, 1, pipelineBin->codeSize, outFile) != pipelineBin->codeSize)
       result = Result::ErrorUnavailable;
 
@@ -1159,6 +1412,25 @@ static void enableMemoryLeakDetection() {
 }
 #endif
 
+// =====================================================================================================================
+// Prints the CSV record of one input compiled with -compile-only, under the header printed by main(). Each record is
+// flushed as it is printed, so a sweep that crashes still has the records of the inputs before the crash.
+//
+// @param fileNames : Names of the input files, separated by spaces
+// @param result : Result of compiling them
+// @param compileTime : Wall time taken to compile them, in seconds
+// @param stats : Compile statistics of the pipeline build
+static void printCompileOnlyRecord(StringRef fileNames, Result result, double compileTime,
+                                   const PipelineBuildStats &stats) {
+  // With -j, records from several threads must not interleave.
+  static std::mutex outputMutex;
+  std::lock_guard<std::mutex> lock(outputMutex);
+  outs() << "\"" << fileNames.trim() << "\"," << (result == Result::Success ? "pass" : "fail") << ","
+         << static_cast<int>(result) << format(",%.6f,", compileTime) << stats.maxPhaseMemoryGrowth
+         << "," << (stats.cacheHit ? 1 : 0) << "\n";
+  outs().flush();
+}
+
 // =====================================================================================================================
 // Process one pipeline.
 //
@@ -1166,11 +1438,14 @@ static void enableMemoryLeakDetection() {
 // @param inFiles : Input filename(s)
 // @param startFile : Index of the starting file name being processed in the file name array
 // @param [out] nextFile : Index of next file name being processed in the file name array
+// @param outFile : Name of the file to output ELF binary (see outputElf)
 static Result processPipeline(ICompiler *compiler, ArrayRef<std::string> inFiles, unsigned startFile,
-                              unsigned *nextFile) {
+                              unsigned *nextFile, const std::string &outFile) {
+  auto startTime = std::chrono::steady_clock::now();
   Result result = Result::Success;
   CompileInfo compileInfo = {};
   std::string fileNames;
+  bool emittedPipelineBinary = false;
   compileInfo.unlinked = true;
   compileInfo.doAutoLayout = true;
   compileInfo.checkAutoLayoutCompatible = CheckAutoLayoutCompatible;
@@ -1196,7 +1471,7 @@ static Result processPipeline(ICompiler *compiler, ArrayRef<std::string> inFiles
       if (result == Result::Success) {
         result = getSpirvBinaryFromFile(spvBinFile, &spvBin);
 
-        if (result == Result::Success) {
+        if (result == Result::Success && !CompileOnly) {
           if (!InitSpvGen()) {
             LLPC_OUTS("Failed to load SPVGEN -- no SPIR-V disassembler available\n");
           } else {
@@ -1228,11 +1503,23 @@ static Result processPipeline(ICompiler *compiler, ArrayRef<std::string> inFiles
       }
 
       if (result == Result::Success) {
+        // Scan the entry-points once, for both the default entry target and the stage mask.
+        std::vector<ShaderEntryName> entryNames;
+        ShaderModuleHelper::getEntryPointsFromSpirvBinary(&spvBin, entryNames);
+
         // NOTE: If the entry target is not specified, we set it to the one gotten from SPIR-V binary.
-        if (EntryTarget.empty())
-          EntryTarget.setValue(ShaderModuleHelper::getEntryPointNameFromSpirvBinary(&spvBin));
+        if (EntryTarget.empty()) {
+          if (entryNames.empty())
+            LLPC_ERRS("Entry-point not found\n");
+          else
+            EntryTarget.setValue(entryNames[0].name);
+        }
 
-        unsigned stageMask = ShaderModuleHelper::getStageMaskFromSpirvBinary(&spvBin, EntryTarget.c_str());
+        unsigned stageMask = 0;
+        for (const ShaderEntryName &entryName : entryNames) {
+          if (strcmp(EntryTarget.c_str(), entryName.name) == 0)
+            stageMask |= shaderStageToMask(entryName.stage);
+        }
 
         if ((stageMask & compileInfo.stageMask) != 0)
           break;
@@ -1265,6 +1552,20 @@ static Result processPipeline(ICompiler *compiler, ArrayRef<std::string> inFiles
           LLPC_ERRS("Version incompatible, SPVGEN::Version = " << pipelineState->version
                                                                << " AMDLLPC::Version = " << Vkgc::Version << "\n");
           result = Result::ErrorInvalidShader;
+        } else if (EmitPipelineBinary) {
+          // Convert the pipeline info file to the binary form instead of compiling it.
+          SmallString<256> binaryFile(outFile);
+          if (binaryFile.empty()) {
+            binaryFile = inFile;
+            sys::path::replace_extension(binaryFile, LlpcExt::PipelineBinary);
+          }
+          if (!Vfx::vfxWritePipelineBinary(compileInfo.pipelineInfoFile, binaryFile.c_str(), &log)) {
+            LLPC_ERRS("Failed to write binary pipeline file: " << binaryFile << "\n" << log << "\n");
+            result = Result::ErrorUnavailable;
+          }
+          emittedPipelineBinary = true;
+          *nextFile = i + 1;
+          break;
         } else {
           LLPC_OUTS("===============================================================================\n");
           LLPC_OUTS("// Pipeline file info for " << inFile << " \n\n");
@@ -1299,7 +1600,7 @@ static Result processPipeline(ICompiler *compiler, ArrayRef<std::string> inFiles
               compileInfo.shaderModuleDatas.push_back(shaderModuleData);
               compileInfo.stageMask |= shaderStageToMask(pipelineState->stages[stage].stage);
 
-              if (spvDisassembleSpirv) {
+              if (spvDisassembleSpirv && !CompileOnly) {
                 unsigned binSize = pipelineState->stages[stage].dataSize;
                 unsigned textSize = binSize * 10 + 1024;
                 char *spvText = new char[textSize];
@@ -1409,6 +1710,11 @@ static Result processPipeline(ICompiler *compiler, ArrayRef<std::string> inFiles
     *nextFile = i + 1;
   }
 
+  if (emittedPipelineBinary) {
+    cleanupCompileInfo(&compileInfo);
+    return result;
+  }
+
   if (result == Result::Success && compileInfo.checkAutoLayoutCompatible) {
     compileInfo.fileNames = fileNames.c_str();
     result = checkAutoLayoutCompatibleFunc(compiler, &compileInfo);
@@ -1425,10 +1731,15 @@ static Result processPipeline(ICompiler *compiler, ArrayRef<std::string> inFiles
     if (result == Result::Success && ToLink) {
       compileInfo.fileNames = fileNames.c_str();
       result = buildPipeline(compiler, &compileInfo);
-      if (result == Result::Success)
-        result = outputElf(&compileInfo, OutFile, inFiles[0]);
+      if (result == Result::Success && !CompileOnly)
+        result = outputElf(&compileInfo, outFile, inFiles[0]);
     }
   }
+
+  if (CompileOnly) {
+    std::chrono::duration<double> compileTime = std::chrono::steady_clock::now() - startTime;
+    printCompileOnlyRecord(fileNames, result, compileTime.count(), compileInfo.buildStats);
+  }
   //
   // Clean up
   //
@@ -1437,6 +1748,309 @@ static Result processPipeline(ICompiler *compiler, ArrayRef<std::string> inFiles
   return result;
 }
 
+// =====================================================================================================================
+// Process each of the given pipeline files separately, sharing them out between -j worker threads. Each worker
+// creates its own compiler, so it gets its own context from the pool, but all compilers created with the same options
+// share the same shader cache.
+//
+// Failures are reported in input file order once all files have been processed. Returns the result of the first
+// failing file, or Result::Success.
+//
+// @param argc : Count of arguments
+// @param argv : List of arguments
+// @param inFiles : Pipeline files to process
+static Result processPipelinesInParallel(int argc, char *argv[], ArrayRef<std::string> inFiles) {
+  // Load spvgen up front, as loading it on demand is not thread-safe. Files that need it report its absence.
+  InitSpvGen(SpvGenDir.empty() ? nullptr : SpvGenDir.c_str());
+
+  std::vector<Result> results(inFiles.size(), Result::Success);
+  std::atomic<unsigned> nextFileIndex(0);
+  auto processFiles = [&] {
+    ICompiler *compiler = nullptr;
+    Result result = ICompiler::Create(ParsedGfxIp, argc, argv, &compiler, TheRemoteCache.cache.get());
+    for (unsigned fileIndex = nextFileIndex++; fileIndex < inFiles.size(); fileIndex = nextFileIndex++) {
+      unsigned nextFile = 0;
+      results[fileIndex] =
+          result == Result::Success ? processPipeline(compiler, inFiles[fileIndex], 0, &nextFile, OutFile) : result;
+    }
+    if (compiler)
+      compiler->Destroy();
+  };
+
+  unsigned threadCount = std::min(unsigned(NumThreads), unsigned(inFiles.size()));
+  std::vector<std::thread> threads;
+  for (unsigned i = 0; i < threadCount; ++i)
+    threads.emplace_back(processFiles);
+  for (std::thread &thread : threads)
+    thread.join();
+
+  Result result = Result::Success;
+  for (unsigned fileIndex = 0; fileIndex < inFiles.size(); ++fileIndex) {
+    if (results[fileIndex] == Result::Success)
+      continue;
+    LLPC_ERRS("Failed to compile " << inFiles[fileIndex] << "\n");
+    if (result == Result::Success)
+      result = results[fileIndex];
+  }
+  return result;
+}
+
+// =====================================================================================================================
+// Replays the ICompiler calls of the -replay-trace call trace. Each thread of the trace is replayed by a thread of its
+// own, which issues the calls of that thread in order, each at its start time in the trace scaled by
+// -replay-time-scale. As in processPipelinesInParallel, each thread creates its own compiler, and all of them share
+// the same shader cache. A pipeline call is replayed by building its dumped .pipe file, which builds its shader modules
+// as well; those mostly hit in the shader module cache. Prints the captured and replayed time of each kind of call.
+//
+// @param argc : Count of arguments
+// @param argv : List of arguments
+static Result replayCallTrace(int argc, char *argv[]) {
+  auto bufferOrErr = MemoryBuffer::getFile(ReplayTrace, -1, false);
+  if (!bufferOrErr) {
+    LLPC_ERRS("Failed to read call trace " << ReplayTrace << "\n");
+    return Result::ErrorUnavailable;
+  }
+  StringRef traceData = (*bufferOrErr)->getBuffer();
+  const auto *header = reinterpret_cast<const CallTraceHeader *>(traceData.data());
+  if (traceData.size() < sizeof(CallTraceHeader) ||
+      memcmp(header->magic, CallTraceMagic, sizeof(CallTraceMagic)) != 0 || header->version != CallTraceVersion) {
+    LLPC_ERRS("Not a call trace of this version: " << ReplayTrace << "\n");
+    return Result::ErrorInvalidValue;
+  }
+
+  // A trace cut short by a crash ends with a partial record, which is dropped.
+  size_t recordCount = (traceData.size() - sizeof(CallTraceHeader)) / sizeof(CallTraceRecord);
+  std::vector<CallTraceRecord> records(recordCount);
+  memcpy(records.data(), traceData.data() + sizeof(CallTraceHeader), recordCount * sizeof(CallTraceRecord));
+  std::sort(records.begin(), records.end(),
+            [](const CallTraceRecord &lhs, const CallTraceRecord &rhs) { return lhs.startTime < rhs.startTime; });
+
+  // Find the dumped inputs next to the trace. They are named by hash, as <prefix>_0x<hash>.<ext>.
+  StringRef traceDir = sys::path::parent_path(ReplayTrace);
+  if (traceDir.empty())
+    traceDir = ".";
+  std::map<uint64_t, std::string> pipeFiles;
+  std::map<uint64_t, std::string> spirvFiles;
+  std::error_code errCode;
+  for (sys::fs::directory_iterator it(traceDir, errCode), end; it != end && !errCode; it.increment(errCode)) {
+    StringRef fileName = sys::path::filename(it->path());
+    StringRef hashText = sys::path::stem(fileName);
+    size_t hashPos = hashText.rfind("_0x");
+    uint64_t hash = 0;
+    if (hashPos == StringRef::npos || hashText.substr(hashPos + 3).getAsInteger(16, hash))
+      continue;
+    if (isPipelineInfoFile(fileName.str()))
+      pipeFiles[hash] = it->path();
+    else if (isSpirvBinaryFile(fileName.str()))
+      spirvFiles[hash] = it->path();
+  }
+
+  LLPC_OUTS("Replaying " << recordCount << " calls of " << ReplayTrace << " (captured on gfxip " << header->gfxIpMajor
+                         << "." << header->gfxIpMinor << "." << header->gfxIpStepping << ", shader cache mode "
+                         << header->shaderCacheMode << ")\n");
+
+  // Load spvgen up front, as loading it on demand is not thread-safe.
+  InitSpvGen(SpvGenDir.empty() ? nullptr : SpvGenDir.c_str());
+
+  unsigned threadCount = 0;
+  for (const CallTraceRecord &record : records)
+    threadCount = std::max(threadCount, record.threadIndex + 1);
+
+  static constexpr unsigned CallTypeCount = static_cast<unsigned>(CallTraceType::ComputePipeline) + 1;
+  std::mutex statsLock;
+  unsigned callCounts[CallTypeCount] = {};
+  unsigned skippedCount = 0;
+  unsigned failedCount = 0;
+  double capturedTimes[CallTypeCount] = {};
+  double replayedTimes[CallTypeCount] = {};
+
+  auto replayStart = std::chrono::steady_clock::now();
+  auto replayThread = [&](unsigned threadIndex) {
+    ICompiler *compiler = nullptr;
+    if (ICompiler::Create(ParsedGfxIp, argc, argv, &compiler, TheRemoteCache.cache.get()) != Result::Success)
+      return;
+
+    for (const CallTraceRecord &record : records) {
+      if (record.threadIndex != threadIndex || record.type >= CallTypeCount)
+        continue;
+      const bool isShaderModule = record.type == static_cast<uint32_t>(CallTraceType::ShaderModule);
+      const auto &inputFiles = isShaderModule ? spirvFiles : pipeFiles;
+      auto inputFile = inputFiles.find(record.hash);
+      if (inputFile == inputFiles.end()) {
+        std::lock_guard<std::mutex> lock(statsLock);
+        ++skippedCount;
+        continue;
+      }
+
+      uint64_t startTime = uint64_t(record.startTime * ReplayTimeScale);
+      std::this_thread::sleep_until(replayStart + std::chrono::nanoseconds(startTime));
+      auto callStart = std::chrono::steady_clock::now();
+      Result result = Result::Success;
+      if (isShaderModule) {
+        BinaryData spirvBin = {};
+        result = getSpirvBinaryFromFile(inputFile->second, &spirvBin);
+        if (result == Result::Success) {
+          void *shaderBuf = nullptr;
+          ShaderModuleBuildInfo shaderInfo = {};
+          ShaderModuleBuildOut shaderOut = {};
+          shaderInfo.pUserData = &shaderBuf;
+          shaderInfo.pfnOutputAlloc = allocateBuffer;
+          shaderInfo.shaderBin = spirvBin;
+          result = compiler->BuildShaderModule(&shaderInfo, &shaderOut);
+          free(shaderBuf);
+          delete[] reinterpret_cast<const char *>(spirvBin.pCode);
+        }
+      } else {
+        unsigned nextFile = 0;
+        result = processPipeline(compiler, inputFile->second, 0, &nextFile, OutFile);
+      }
+      std::chrono::duration<double> callTime = std::chrono::steady_clock::now() - callStart;
+
+      std::lock_guard<std::mutex> lock(statsLock);
+      ++callCounts[record.type];
+      capturedTimes[record.type] += record.duration / 1e9;
+      replayedTimes[record.type] += callTime.count();
+      if (result != Result::Success && result != Result::Delayed)
+        ++failedCount;
+    }
+    compiler->Destroy();
+  };
+
+  std::vector<std::thread> threads;
+  for (unsigned threadIndex = 0; threadIndex < threadCount; ++threadIndex)
+    threads.emplace_back(replayThread, threadIndex);
+  for (std::thread &thread : threads)
+    thread.join();
+  std::chrono::duration<double> replayTime = std::chrono::steady_clock::now() - replayStart;
+
+  static const char *const CallTypeNames[CallTypeCount] = {"shader module", "graphics pipeline", "compute pipeline"};
+  outs() << "call,count,captured_seconds,replayed_seconds\n";
+  for (unsigned type = 0; type < CallTypeCount; ++type) {
+    outs() << CallTypeNames[type] << "," << callCounts[type] << "," << format("%.6f", capturedTimes[type]) << ","
+           << format("%.6f", replayedTimes[type]) << "\n";
+  }
+  outs() << "Replayed " << threadCount << " threads in " << format("%.6f", replayTime.count()) << " seconds; "
+         << skippedCount << " calls skipped for lack of a dumped input, " << failedCount << " calls failed\n";
+  outs().flush();
+  return failedCount == 0 ? Result::Success : Result::ErrorUnknown;
+}
+
+// =====================================================================================================================
+// Compiles the given pipeline files into one shader cache and writes its serialized form to the -emit-cache-blob file.
+// The blob starts with the build-id header of the serialized cache, so a driver built from the same LLPC can pass it as
+// the initial data of CreateShaderCache to find these pipelines already compiled.
+//
+// @param argc : Count of arguments
+// @param argv : List of arguments
+// @param compiler : LLPC compiler
+// @param inFiles : Input pipeline files
+// @returns : Result::Success on success, other status codes on failure
+static Result emitCacheBlob(int argc, char *argv[], ICompiler *compiler, ArrayRef<std::string> inFiles) {
+#if LLPC_CLIENT_INTERFACE_MAJOR_VERSION < 38 || LLPC_ENABLE_SHADER_CACHE
+  auto nonPipeIt = llvm::find_if_not(inFiles, [](const std::string &filename) { return isPipelineInfoFile(filename); });
+  if (nonPipeIt != inFiles.end()) {
+    LLPC_ERRS(format("A non-pipeline file cannot be compiled into a cache blob: %s\n", nonPipeIt->c_str()));
+    return Result::ErrorInvalidValue;
+  }
+  if (!RemoteCachePlugin.empty()) {
+    // With a remote cache, pipelines are looked up and stored there instead of in the shader cache.
+    LLPC_ERRS("-emit-cache-blob cannot be used with -remote-cache-plugin\n");
+    return Result::ErrorInvalidValue;
+  }
+
+  ShaderCacheCreateInfo createInfo = {};
+  std::unique_ptr<MemoryBuffer> initialData;
+  if (!CacheBlobInitialData.empty()) {
+    auto bufferOrErr = MemoryBuffer::getFile(CacheBlobInitialData, -1, false);
+    if (!bufferOrErr) {
+      LLPC_ERRS("Failed to read cache blob " << CacheBlobInitialData << "\n");
+      return Result::ErrorUnavailable;
+    }
+    initialData = std::move(*bufferOrErr);
+    createInfo.pInitialData = initialData->getBufferStart();
+    createInfo.initialDataSize = initialData->getBufferSize();
+  }
+
+  Result result = compiler->CreateShaderCache(&createInfo, &CacheBlobCache);
+  if (result != Result::Success) {
+    LLPC_ERRS("Failed to create the shader cache for " << EmitCacheBlob << "\n");
+    return result;
+  }
+
+  if (NumThreads > 1) {
+    result = processPipelinesInParallel(argc, argv, inFiles);
+  } else {
+    unsigned nextFile = 0;
+    for (const std::string &file : inFiles) {
+      result = processPipeline(compiler, {file}, 0, &nextFile, OutFile);
+      if (result != Result::Success)
+        break;
+    }
+  }
+
+  if (result == Result::Success) {
+    size_t blobSize = 0;
+    result = CacheBlobCache->Serialize(nullptr, &blobSize);
+    std::vector<char> blob(blobSize);
+    if (result == Result::Success)
+      result = CacheBlobCache->Serialize(blob.data(), &blobSize);
+    if (result == Result::Success) {
+      std::error_code errCode;
+      raw_fd_ostream blobFile(EmitCacheBlob, errCode, sys::fs::OF_None);
+      if (!errCode) {
+        blobFile.write(blob.data(), blobSize);
+        blobFile.close();
+        errCode = blobFile.error();
+      }
+      if (errCode) {
+        LLPC_ERRS("Failed to write " << EmitCacheBlob << ": " << errCode.message() << "\n");
+        blobFile.clear_error();
+        result = Result::ErrorUnavailable;
+      } else {
+        LLPC_OUTS("Wrote shader cache blob of " << blobSize << " bytes to " << EmitCacheBlob << "\n");
+      }
+    }
+  }
+
+  CacheBlobCache->Destroy();
+  CacheBlobCache = nullptr;
+  return result;
+#else
+  LLPC_ERRS("A cache blob can only be emitted with ShaderCache enabled.\n");
+  return Result::Unsupported;
+#endif
+}
+
+// =====================================================================================================================
+// Run as a compile server, keeping the compiler with its context pool and shader cache warm across requests. Requests
+// are read from stdin until end of input or a "quit" request.
+//
+// Each request is a line holding the name of an input file, optionally followed by the name of the output file. The
+// output file defaults as for a normal run; "-" streams the ELF back on stdout as a line "ELF <size>" followed by
+// <size> bytes. Each request is answered on stdout by a line "OK <input>" or "FAILED <input>". LLPC messages should
+// be redirected with -log-file-outs so they do not mix with the responses.
+//
+// @param compiler : LLPC compiler
+static void runCompileServer(ICompiler *compiler) {
+  std::string line;
+  while (std::getline(std::cin, line)) {
+    StringRef request = StringRef(line).trim();
+    if (request.empty())
+      continue;
+    if (request == "quit")
+      break;
+
+    std::pair<StringRef, StringRef> files = getToken(request);
+    std::string inFile = files.first.str();
+    std::string outFile = files.second.trim().str();
+    unsigned nextFile = 0;
+    Result result = processPipeline(compiler, inFile, 0, &nextFile, outFile);
+
+    fprintf(stdout, "%s %s\n", result == Result::Success ? "OK" : "FAILED", inFile.c_str());
+    fflush(stdout);
+  }
+}
+
 #ifdef WIN_OS
 // =====================================================================================================================
 // Finds all filenames which can match input file name
@@ -1476,6 +2090,22 @@ static void findAllMatchFiles(const std::string &inFile, std::vector<std::string
 static Result expandInputFilenames(std::vector<std::string> &expandedFilenames) {
   unsigned i = 0;
   for (const auto &inFile : InFiles) {
+    if (sys::fs::is_directory(inFile)) {
+      // A directory stands for the pipeline files in it, in name order so that runs are reproducible.
+      size_t initialSize = expandedFilenames.size();
+      std::error_code errCode;
+      for (sys::fs::directory_iterator it(inFile, errCode), end; it != end && !errCode; it.increment(errCode)) {
+        if (isPipelineInfoFile(it->path()))
+          expandedFilenames.push_back(it->path());
+      }
+      if (errCode) {
+        LLPC_ERRS("\nFailed to read directory " << inFile << ": " << errCode.message() << "\n");
+        return Result::ErrorInvalidValue;
+      }
+      std::sort(expandedFilenames.begin() + initialSize, expandedFilenames.end());
+      ++i;
+      continue;
+    }
 #ifdef WIN_OS
     {
       if (i > 0 && inFile.find_last_of("*?") != std::string::npos) {
@@ -1548,12 +2178,41 @@ int main(int argc, char *argv[]) {
   if (isFailure())
     return onFailure();
 
+  if (ServerMode) {
+    runCompileServer(compiler);
+    compiler->Destroy();
+    return 0;
+  }
+
+  if (!ReplayTrace.empty()) {
+    result = replayCallTrace(argc, argv);
+    if (isFailure())
+      return onFailure();
+    compiler->Destroy();
+    return 0;
+  }
+
+  if (InFiles.empty()) {
+    LLPC_ERRS("No input files\n");
+    compiler->Destroy();
+    return 1;
+  }
+
   std::vector<std::string> expandedInputFiles;
   result = expandInputFilenames(expandedInputFiles);
   if (isFailure())
     return onFailure();
 
-  if (llvm::cl::BuildShaderCache) {
+  if (CompileOnly) {
+    outs() << "files,status,result,compile_seconds,max_phase_memory_growth_bytes,cache_hit\n";
+    outs().flush();
+  }
+
+  if (!EmitCacheBlob.empty()) {
+    result = emitCacheBlob(argc, argv, compiler, expandedInputFiles);
+    if (isFailure())
+      return onFailure();
+  } else if (llvm::cl::BuildShaderCache) {
     // Build relocatable shader cache. We require all inputs to be .pipe files.
     // This is work in progress and will be extended to handle shader inputs in the
     // future.
@@ -1573,26 +2232,38 @@ int main(int argc, char *argv[]) {
       return onFailure();
     }
 
-    unsigned nextFile = 0;
-    for (const std::string &file : expandedInputFiles) {
-      result = processPipeline(compiler, {file}, 0, &nextFile);
+    if (NumThreads > 1) {
+      result = processPipelinesInParallel(argc, argv, expandedInputFiles);
       if (isFailure())
         return onFailure();
+    } else {
+      unsigned nextFile = 0;
+      for (const std::string &file : expandedInputFiles) {
+        result = processPipeline(compiler, {file}, 0, &nextFile, OutFile);
+        if (isFailure())
+          return onFailure();
+      }
     }
   } else if (isPipelineInfoFile(expandedInputFiles[0]) || isLlvmIrFile(expandedInputFiles[0])) {
     // The first input file is a pipeline file or LLVM IR file. Assume they all are, and compile each one
-    // separately but in the same context.
-    unsigned nextFile = 0;
-
-    for (const std::string &file : expandedInputFiles) {
-      result = processPipeline(compiler, {file}, 0, &nextFile);
+    // separately but in the same context, or with -j, in as many contexts as there are threads.
+    if (NumThreads > 1) {
+      result = processPipelinesInParallel(argc, argv, expandedInputFiles);
       if (isFailure())
         return onFailure();
+    } else {
+      unsigned nextFile = 0;
+
+      for (const std::string &file : expandedInputFiles) {
+        result = processPipeline(compiler, {file}, 0, &nextFile, OutFile);
+        if (isFailure())
+          return onFailure();
+      }
     }
   } else {
     // Otherwise, join all input files into the same pipeline.
     for (unsigned nextFile = 0; nextFile < unsigned(expandedInputFiles.size());) {
-      result = processPipeline(compiler, expandedInputFiles, nextFile, &nextFile);
+      result = processPipeline(compiler, expandedInputFiles, nextFile, &nextFile, OutFile);
       if (isFailure())
         return onFailure();
     }
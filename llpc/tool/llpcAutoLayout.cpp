@@ -43,6 +43,9 @@
 #include "vfx.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Format.h"
+#include "llvm/Support/xxhash.h"
+#include <mutex>
+#include <tuple>
 
 #define DEBUG_TYPE "llpc-auto-layout"
 
@@ -55,6 +58,24 @@ struct ResourceNodeSet {
   std::map<unsigned, unsigned> bindingMap; // Map from binding to index in nodes vector
 };
 
+// Dummy color target info derived from a fragment shader output
+struct AutoLayoutColorTarget {
+  unsigned location;         // Location of the output
+  VkFormat format;           // Color target format
+  unsigned channelWriteMask; // Color channel write mask
+};
+
+// Auto-layout information of one shader stage that is derived from its SPIR-V alone
+struct AutoLayoutResult {
+  bool hasEntryPoint = false;                                   // Whether the entry target was found
+  std::vector<VkVertexInputBindingDescription> vertexBindings;  // Dummy vertex bindings (vertex shader)
+  std::vector<VkVertexInputAttributeDescription> vertexAttribs; // Dummy vertex attributes (vertex shader)
+  VkPrimitiveTopology topology = VkPrimitiveTopology(0);        // Primitive topology (geometry shader)
+  std::vector<AutoLayoutColorTarget> colorTargets;              // Dummy color targets (fragment shader)
+  std::map<unsigned, ResourceNodeSet> resNodeSets;              // Descriptor nodes in sets, with offsets allocated
+  unsigned pushConstSize = 0;                                   // Size of push constants in dwords
+};
+
 // -auto-layout-desc: automatically create descriptor layout based on resource usages
 static cl::opt<bool> AutoLayoutDesc("auto-layout-desc",
                                     cl::desc("Automatically create descriptor layout based on resource usages"));
@@ -262,19 +283,16 @@ bool checkPipelineStateCompatible(const ICompiler *compiler, Llpc::GraphicsPipel
 }
 
 // =====================================================================================================================
-// Lay out dummy descriptors and other information for one shader stage. This is used when running amdllpc on a single
-// SPIR-V or GLSL shader, rather than on a .pipe file. Memory allocated here may be leaked, but that does not
-// matter because we are running a short-lived command-line utility.
+// Scan the SPIR-V of one shader stage for the information that auto-layout derives from it, which does not depend on
+// the rest of the pipeline.
 //
 // @param shaderStage : Shader stage
 // @param spirvBin : SPIR-V binary
-// @param [in/out] pipelineInfo : Graphics pipeline info, will have dummy information filled in. nullptr if not a
-// graphics pipeline.
-// @param [in/out] shaderInfo : Shader info, will have user data nodes added to it
-// @param [in/out] topLevelOffset : User data offset; ensures that multiple shader stages use disjoint offsets
+// @param entryTarget : Name of the entry-point
 // @param checkAutoLayoutCompatible : if check AutoLayout Compatiple
-void doAutoLayoutDesc(ShaderStage shaderStage, BinaryData spirvBin, GraphicsPipelineBuildInfo *pipelineInfo,
-                      PipelineShaderInfo *shaderInfo, unsigned &topLevelOffset, bool checkAutoLayoutCompatible) {
+// @param [out] autoLayout : Auto-layout information of the shader stage
+static void scanAutoLayout(ShaderStage shaderStage, BinaryData spirvBin, const char *entryTarget,
+                           bool checkAutoLayoutCompatible, AutoLayoutResult *autoLayout) {
   // Read the SPIR-V.
   std::string spirvCode(static_cast<const char *>(spirvBin.pCode), spirvBin.codeSize);
   std::istringstream spirvStream(spirvCode);
@@ -288,19 +306,20 @@ void doAutoLayoutDesc(ShaderStage shaderStage, BinaryData spirvBin, GraphicsPipe
     func = module->getFunction(i);
     entryPoint = module->getEntryPoint(func->getId());
     if (entryPoint && entryPoint->getExecModel() == SPIRVExecutionModelKind(shaderStage) &&
-        entryPoint->getName() == shaderInfo->pEntryTarget)
+        entryPoint->getName() == entryTarget)
       break;
     func = nullptr;
   }
   if (!entryPoint)
     return;
+  autoLayout->hasEntryPoint = true;
 
   // Shader stage specific processing
   auto inOuts = entryPoint->getInOuts();
   if (shaderStage == ShaderStageVertex) {
     // Create dummy vertex info
-    auto vertexBindings = new std::vector<VkVertexInputBindingDescription>;
-    auto vertexAttribs = new std::vector<VkVertexInputAttributeDescription>;
+    auto vertexBindings = &autoLayout->vertexBindings;
+    auto vertexAttribs = &autoLayout->vertexAttribs;
 
     for (auto varId : ArrayRef<SPIRVWord>(inOuts.first, inOuts.second)) {
       auto var = static_cast<SPIRVVariable *>(module->getValue(varId));
@@ -373,22 +392,6 @@ void doAutoLayoutDesc(ShaderStage shaderStage, BinaryData spirvBin, GraphicsPipe
         }
       }
     }
-
-    auto vertexInputState = new VkPipelineVertexInputStateCreateInfo;
-    pipelineInfo->pVertexInput = vertexInputState;
-    vertexInputState->sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertexInputState->pNext = nullptr;
-    vertexInputState->vertexBindingDescriptionCount = vertexBindings->size();
-    vertexInputState->pVertexBindingDescriptions = vertexBindings->data();
-    vertexInputState->vertexAttributeDescriptionCount = vertexAttribs->size();
-    vertexInputState->pVertexAttributeDescriptions = vertexAttribs->data();
-
-    // Set primitive topology
-    pipelineInfo->iaState.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-  } else if (shaderStage == ShaderStageTessControl || shaderStage == ShaderStageTessEval) {
-    // Set primitive topology and patch control points
-    pipelineInfo->iaState.topology = VK_PRIMITIVE_TOPOLOGY_PATCH_LIST;
-    pipelineInfo->iaState.patchControlPoints = 3;
   } else if (shaderStage == ShaderStageGeometry) {
     // Set primitive topology
     auto topology = VkPrimitiveTopology(0);
@@ -404,7 +407,7 @@ void doAutoLayoutDesc(ShaderStage shaderStage, BinaryData spirvBin, GraphicsPipe
       topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST_WITH_ADJACENCY;
     else
       llvm_unreachable("Should never be called!");
-    pipelineInfo->iaState.topology = topology;
+    autoLayout->topology = topology;
   } else if (shaderStage == ShaderStageFragment) {
     // Set dummy color formats for fragment outputs
     for (auto varId : ArrayRef<SPIRVWord>(inOuts.first, inOuts.second)) {
@@ -534,9 +537,7 @@ void doAutoLayoutDesc(ShaderStage shaderStage, BinaryData spirvBin, GraphicsPipe
       assert(format != VK_FORMAT_UNDEFINED);
 
       assert(location < MaxColorTargets);
-      auto colorTarget = &pipelineInfo->cbState.target[location];
-      colorTarget->format = format;
-      colorTarget->channelWriteMask = (1U << elemCount) - 1;
+      autoLayout->colorTargets.push_back({location, format, (1U << elemCount) - 1});
     }
   }
 
@@ -545,9 +546,8 @@ void doAutoLayoutDesc(ShaderStage shaderStage, BinaryData spirvBin, GraphicsPipe
     return;
 
   // Collect ResourceMappingNode entries in sets.
-  std::map<unsigned, ResourceNodeSet> resNodeSets;
-  std::map<std::pair<unsigned, unsigned>, unsigned> bindingIndex;
-  unsigned pushConstSize = 0;
+  std::map<unsigned, ResourceNodeSet> &resNodeSets = autoLayout->resNodeSets;
+  unsigned &pushConstSize = autoLayout->pushConstSize;
   for (unsigned i = 0, varCount = module->getNumVariables(); i < varCount; ++i) {
     auto var = module->getVariable(i);
     switch (var->getStorageClass()) {
@@ -666,6 +666,95 @@ void doAutoLayoutDesc(ShaderStage shaderStage, BinaryData spirvBin, GraphicsPipe
       }
     }
   }
+}
+
+// =====================================================================================================================
+// Get the auto-layout information of one shader stage. It is scanned from the SPIR-V once, and shared by all the
+// pipelines that use the same SPIR-V for the same stage and entry-point in this run of amdllpc, across -j worker
+// threads. The information is never freed, as we are running a short-lived command-line utility.
+//
+// @param shaderStage : Shader stage
+// @param spirvBin : SPIR-V binary
+// @param entryTarget : Name of the entry-point
+// @param checkAutoLayoutCompatible : if check AutoLayout Compatiple
+static const AutoLayoutResult &getAutoLayout(ShaderStage shaderStage, BinaryData spirvBin, const char *entryTarget,
+                                             bool checkAutoLayoutCompatible) {
+  typedef std::tuple<uint64_t, unsigned, bool, std::string> AutoLayoutKey;
+  static std::mutex autoLayoutMutex;
+  static std::map<AutoLayoutKey, std::unique_ptr<AutoLayoutResult>> autoLayouts;
+
+  StringRef spirvCode(static_cast<const char *>(spirvBin.pCode), spirvBin.codeSize);
+  AutoLayoutKey key(xxHash64(spirvCode), shaderStage, checkAutoLayoutCompatible, entryTarget ? entryTarget : "");
+  {
+    std::lock_guard<std::mutex> lock(autoLayoutMutex);
+    auto it = autoLayouts.find(key);
+    if (it != autoLayouts.end())
+      return *it->second;
+  }
+
+  // Scan without the lock, so that threads do not wait for each other's SPIR-V. If another thread scanned the same
+  // SPIR-V in the meantime, its result is kept, and ours is dropped.
+  std::unique_ptr<AutoLayoutResult> autoLayout(new AutoLayoutResult);
+  scanAutoLayout(shaderStage, spirvBin, entryTarget, checkAutoLayoutCompatible, &*autoLayout);
+  std::lock_guard<std::mutex> lock(autoLayoutMutex);
+  auto inserted = autoLayouts.insert({key, std::move(autoLayout)});
+  return *inserted.first->second;
+}
+
+// =====================================================================================================================
+// Lay out dummy descriptors and other information for one shader stage. This is used when running amdllpc on a single
+// SPIR-V or GLSL shader, rather than on a .pipe file. Memory allocated here may be leaked, but that does not
+// matter because we are running a short-lived command-line utility.
+//
+// @param shaderStage : Shader stage
+// @param spirvBin : SPIR-V binary
+// @param [in/out] pipelineInfo : Graphics pipeline info, will have dummy information filled in. nullptr if not a
+// graphics pipeline.
+// @param [in/out] shaderInfo : Shader info, will have user data nodes added to it
+// @param [in/out] topLevelOffset : User data offset; ensures that multiple shader stages use disjoint offsets
+// @param checkAutoLayoutCompatible : if check AutoLayout Compatiple
+void doAutoLayoutDesc(ShaderStage shaderStage, BinaryData spirvBin, GraphicsPipelineBuildInfo *pipelineInfo,
+                      PipelineShaderInfo *shaderInfo, unsigned &topLevelOffset, bool checkAutoLayoutCompatible) {
+  const AutoLayoutResult &autoLayout =
+      getAutoLayout(shaderStage, spirvBin, shaderInfo->pEntryTarget, checkAutoLayoutCompatible);
+  if (!autoLayout.hasEntryPoint)
+    return;
+
+  // Shader stage specific processing
+  if (shaderStage == ShaderStageVertex) {
+    // The vertex info is shared with the other pipelines that use this shader, and is never changed.
+    auto vertexInputState = new VkPipelineVertexInputStateCreateInfo;
+    pipelineInfo->pVertexInput = vertexInputState;
+    vertexInputState->sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputState->pNext = nullptr;
+    vertexInputState->vertexBindingDescriptionCount = autoLayout.vertexBindings.size();
+    vertexInputState->pVertexBindingDescriptions = autoLayout.vertexBindings.data();
+    vertexInputState->vertexAttributeDescriptionCount = autoLayout.vertexAttribs.size();
+    vertexInputState->pVertexAttributeDescriptions = autoLayout.vertexAttribs.data();
+
+    // Set primitive topology
+    pipelineInfo->iaState.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+  } else if (shaderStage == ShaderStageTessControl || shaderStage == ShaderStageTessEval) {
+    // Set primitive topology and patch control points
+    pipelineInfo->iaState.topology = VK_PRIMITIVE_TOPOLOGY_PATCH_LIST;
+    pipelineInfo->iaState.patchControlPoints = 3;
+  } else if (shaderStage == ShaderStageGeometry) {
+    // Set primitive topology
+    pipelineInfo->iaState.topology = autoLayout.topology;
+  } else if (shaderStage == ShaderStageFragment) {
+    // Set dummy color formats for fragment outputs
+    for (const AutoLayoutColorTarget &colorTarget : autoLayout.colorTargets) {
+      pipelineInfo->cbState.target[colorTarget.location].format = colorTarget.format;
+      pipelineInfo->cbState.target[colorTarget.location].channelWriteMask = colorTarget.channelWriteMask;
+    }
+  }
+
+  // Only auto-layout descriptors if -auto-layout-desc is on.
+  if (!AutoLayoutDesc)
+    return;
+
+  const std::map<unsigned, ResourceNodeSet> &resNodeSets = autoLayout.resNodeSets;
+  const unsigned pushConstSize = autoLayout.pushConstSize;
 
   // Add up how much memory we need and allocate it.
   unsigned topLevelCount = resNodeSets.size();
@@ -685,7 +774,7 @@ void doAutoLayoutDesc(ShaderStage shaderStage, BinaryData spirvBin, GraphicsPipe
     topLevelOffset += resNode->sizeInDwords;
     resNode->tablePtr.nodeCount = resNodeSet.second.nodes.size();
     resNode->tablePtr.pNext = nextTable;
-    for (auto &resNode : resNodeSet.second.nodes)
+    for (const auto &resNode : resNodeSet.second.nodes)
       *nextTable++ = resNode;
     ++resNode;
   }
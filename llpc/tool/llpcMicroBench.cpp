@@ -0,0 +1,338 @@
+/*
+ ***********************************************************************************************************************
+ *
+ *  Copyright (c) 2020 Advanced Micro Devices, Inc. All Rights Reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ **********************************************************************************************************************/
+/**
+ ***********************************************************************************************************************
+ * @file  llpcMicroBench.cpp
+ * @brief LLPC source file: microbenchmarks of the runtime paths that run on every pipeline creation
+ ***********************************************************************************************************************
+ */
+#include "llpcContext.h"
+#include "llpcElfWriter.h"
+#include "llpcGraphicsContext.h"
+#include "llpcShaderCache.h"
+#include "vkgcElfReader.h"
+#include "vkgcPipelineDumper.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include "benchmark/benchmark.h"
+#include <atomic>
+#include <memory>
+#include <vector>
+
+using namespace llvm;
+using namespace Llpc;
+using namespace Vkgc;
+
+// -pipeline-elf: pipeline ELF, as written by amdllpc, that the ELF merge benchmark splits and merges again
+static cl::opt<std::string> PipelineElf("pipeline-elf",
+                                        cl::desc("Pipeline ELF to split and merge in the ELF merge benchmark (the "
+                                                 "benchmark is skipped without one)"),
+                                        cl::value_desc("filename"), cl::init(""));
+
+// -gfxip: graphics IP version of the pipeline ELF
+static cl::opt<std::string> GfxIp("gfxip", cl::desc("Graphics IP version of the pipeline ELF"),
+                                  cl::value_desc("major.minor.step"), cl::init("9.0.0"));
+
+// Number of entries in the shader cache that the lookup benchmarks hit
+static constexpr unsigned CachedShaderCount = 4096;
+
+// Size of the data of each cached shader, in the range of a typical stage ELF
+static constexpr size_t CachedShaderSize = 16 * 1024;
+
+namespace {
+
+// =====================================================================================================================
+// Shader cache populated with CachedShaderCount entries, shared by the threads of the lookup benchmarks.
+class PopulatedShaderCache {
+public:
+  PopulatedShaderCache() : m_shaderData(CachedShaderSize, 0x5A) {
+    ShaderCacheCreateInfo createInfo = {};
+    ShaderCacheAuxCreateInfo auxCreateInfo = {};
+    auxCreateInfo.shaderCacheMode = ShaderCacheEnableRuntime;
+    auxCreateInfo.gfxIp = {9, 0, 0};
+    auxCreateInfo.cacheFilePath = "";
+    auxCreateInfo.executableName = "";
+    m_cache.init(&createInfo, &auxCreateInfo);
+
+    for (unsigned i = 0; i < CachedShaderCount; ++i) {
+      CacheEntryHandle hEntry = nullptr;
+      if (m_cache.findShader(getHash(i), true, &hEntry) == ShaderEntryState::Compiling)
+        m_cache.insertShader(hEntry, m_shaderData.data(), m_shaderData.size());
+    }
+  }
+
+  // Gets the hash of the cached entry with the specified index; indices past CachedShaderCount are not cached
+  static MetroHash::Hash getHash(unsigned index) {
+    MetroHash::Hash hash = {};
+    MetroHash64::Hash(reinterpret_cast<const uint8_t *>(&index), sizeof(index), hash.bytes);
+    return hash;
+  }
+
+  ShaderCache &getCache() { return m_cache; }
+  const std::vector<uint8_t> &getShaderData() const { return m_shaderData; }
+
+private:
+  ShaderCache m_cache;
+  std::vector<uint8_t> m_shaderData;
+};
+
+// =====================================================================================================================
+// Graphics pipeline build info shaped like that of a typical game pipeline: a vertex and a fragment shader, each with
+// a descriptor set table, push constants and vertex buffer table in the user data.
+class TypicalGraphicsPipeline {
+public:
+  TypicalGraphicsPipeline() {
+    for (unsigned i = 0; i < DescriptorCount; ++i) {
+      ResourceMappingNode &node = m_descriptorNodes[i];
+      node.type = i % 2 == 0 ? ResourceMappingNodeType::DescriptorCombinedTexture
+                             : ResourceMappingNodeType::DescriptorBuffer;
+      node.sizeInDwords = i % 2 == 0 ? 12 : 4;
+      node.offsetInDwords = i * 12;
+      node.srdRange.set = 0;
+      node.srdRange.binding = i;
+    }
+
+    m_userDataNodes[0].type = ResourceMappingNodeType::DescriptorTableVaPtr;
+    m_userDataNodes[0].sizeInDwords = 1;
+    m_userDataNodes[0].offsetInDwords = 0;
+    m_userDataNodes[0].tablePtr.nodeCount = DescriptorCount;
+    m_userDataNodes[0].tablePtr.pNext = m_descriptorNodes;
+    m_userDataNodes[1].type = ResourceMappingNodeType::PushConst;
+    m_userDataNodes[1].sizeInDwords = 8;
+    m_userDataNodes[1].offsetInDwords = 1;
+    m_userDataNodes[1].srdRange.set = InternalDescriptorSetId;
+    m_userDataNodes[1].srdRange.binding = 0;
+    m_userDataNodes[2].type = ResourceMappingNodeType::IndirectUserDataVaPtr;
+    m_userDataNodes[2].sizeInDwords = 1;
+    m_userDataNodes[2].offsetInDwords = 9;
+    m_userDataNodes[2].userDataPtr.sizeInDwords = 4 * VertexAttribCount;
+
+    for (unsigned i = 0; i < VertexAttribCount; ++i) {
+      m_bindings[i] = {i, 16, VK_VERTEX_INPUT_RATE_VERTEX};
+      m_attribs[i] = {i, i, VK_FORMAT_R32G32B32A32_SFLOAT, 0};
+    }
+    m_vertexInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    m_vertexInput.vertexBindingDescriptionCount = VertexAttribCount;
+    m_vertexInput.pVertexBindingDescriptions = m_bindings;
+    m_vertexInput.vertexAttributeDescriptionCount = VertexAttribCount;
+    m_vertexInput.pVertexAttributeDescriptions = m_attribs;
+
+    initModuleData(&m_vsModuleData, 1);
+    initModuleData(&m_fsModuleData, 2);
+
+    m_pipelineInfo.vs.pModuleData = &m_vsModuleData;
+    m_pipelineInfo.vs.pEntryTarget = "main";
+    m_pipelineInfo.vs.entryStage = ShaderStageVertex;
+    m_pipelineInfo.fs.pModuleData = &m_fsModuleData;
+    m_pipelineInfo.fs.pEntryTarget = "main";
+    m_pipelineInfo.fs.entryStage = ShaderStageFragment;
+    for (PipelineShaderInfo *shaderInfo : {&m_pipelineInfo.vs, &m_pipelineInfo.fs}) {
+      shaderInfo->userDataNodeCount = UserDataNodeCount;
+      shaderInfo->pUserDataNodes = m_userDataNodes;
+    }
+    m_pipelineInfo.pVertexInput = &m_vertexInput;
+    m_pipelineInfo.iaState.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    m_pipelineInfo.rsState.numSamples = 1;
+    m_pipelineInfo.cbState.target[0].format = VK_FORMAT_R8G8B8A8_UNORM;
+    m_pipelineInfo.cbState.target[0].channelWriteMask = 0xF;
+  }
+
+  const GraphicsPipelineBuildInfo *getPipelineInfo() const { return &m_pipelineInfo; }
+
+private:
+  static constexpr unsigned DescriptorCount = 16;
+  static constexpr unsigned UserDataNodeCount = 3;
+  static constexpr unsigned VertexAttribCount = 4;
+
+  // Fills in module data that looks like that of a SPIR-V module, as far as hashing is concerned
+  static void initModuleData(ShaderModuleData *moduleData, unsigned seed) {
+    *moduleData = {};
+    for (unsigned i = 0; i < 4; ++i) {
+      moduleData->hash[i] = seed * 0x9E3779B9 + i;
+      moduleData->cacheHash[i] = seed * 0x85EBCA6B + i;
+    }
+    moduleData->binType = BinaryType::Spirv;
+  }
+
+  ResourceMappingNode m_descriptorNodes[DescriptorCount] = {};
+  ResourceMappingNode m_userDataNodes[UserDataNodeCount] = {};
+  VkVertexInputBindingDescription m_bindings[VertexAttribCount] = {};
+  VkVertexInputAttributeDescription m_attribs[VertexAttribCount] = {};
+  VkPipelineVertexInputStateCreateInfo m_vertexInput = {};
+  ShaderModuleData m_vsModuleData;
+  ShaderModuleData m_fsModuleData;
+  GraphicsPipelineBuildInfo m_pipelineInfo = {};
+};
+
+} // anonymous namespace
+
+// =====================================================================================================================
+// Gets the shader cache shared by the threads of the lookup benchmarks, populating it on first use.
+static PopulatedShaderCache &getPopulatedShaderCache() {
+  static PopulatedShaderCache cache;
+  return cache;
+}
+
+// =====================================================================================================================
+// Parses the graphics IP version of the -gfxip option.
+static GfxIpVersion getGfxIp() {
+  GfxIpVersion gfxIp = {};
+  SmallVector<StringRef, 3> fields;
+  StringRef(GfxIp).split(fields, '.');
+  unsigned *values[] = {&gfxIp.major, &gfxIp.minor, &gfxIp.stepping};
+  for (unsigned i = 0; i < fields.size() && i < 3; ++i)
+    fields[i].getAsInteger(0, *values[i]);
+  return gfxIp;
+}
+
+// =====================================================================================================================
+// Looks up shaders that are in the cache, from as many threads as the benchmark is run with.
+//
+// @param state : Benchmark state
+static void BM_ShaderCacheFindHit(benchmark::State &state) {
+  ShaderCache &cache = getPopulatedShaderCache().getCache();
+  unsigned index = 0;
+  for (auto _ : state) {
+    CacheEntryHandle hEntry = nullptr;
+    MetroHash::Hash hash = PopulatedShaderCache::getHash(index++ % CachedShaderCount);
+    if (cache.findShader(hash, false, &hEntry) == ShaderEntryState::Ready) {
+      const void *blob = nullptr;
+      size_t size = 0;
+      cache.retrieveShader(hEntry, &blob, &size);
+      benchmark::DoNotOptimize(blob);
+      cache.releaseShader(hEntry);
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ShaderCacheFindHit)->ThreadRange(1, 16)->UseRealTime();
+
+// =====================================================================================================================
+// Looks up shaders that are not in the cache and inserts them, from as many threads as the benchmark is run with. Each
+// thread inserts into its own fresh range of keys, so every lookup misses.
+//
+// @param state : Benchmark state
+static void BM_ShaderCacheFindMissInsert(benchmark::State &state) {
+  static std::atomic<unsigned> nextKey(CachedShaderCount);
+  PopulatedShaderCache &populatedCache = getPopulatedShaderCache();
+  ShaderCache &cache = populatedCache.getCache();
+  const std::vector<uint8_t> &shaderData = populatedCache.getShaderData();
+  for (auto _ : state) {
+    CacheEntryHandle hEntry = nullptr;
+    MetroHash::Hash hash = PopulatedShaderCache::getHash(nextKey++);
+    if (cache.findShader(hash, true, &hEntry) == ShaderEntryState::Compiling)
+      cache.insertShader(hEntry, shaderData.data(), shaderData.size());
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(state.iterations() * shaderData.size());
+}
+BENCHMARK(BM_ShaderCacheFindMissInsert)->ThreadRange(1, 16)->UseRealTime();
+
+// =====================================================================================================================
+// Computes the CRC of shader cache data, which is done for every insert and for every entry of a loaded cache.
+//
+// @param state : Benchmark state
+static void BM_CalculateCrc(benchmark::State &state) {
+  std::vector<uint8_t> data(state.range(0));
+  for (size_t i = 0; i < data.size(); ++i)
+    data[i] = static_cast<uint8_t>(i * 31);
+  for (auto _ : state)
+    benchmark::DoNotOptimize(ShaderCache::calculateCrc(data.data(), data.size()));
+  state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_CalculateCrc)->Range(256, 1024 * 1024);
+
+// =====================================================================================================================
+// Hashes a typical graphics pipeline, as is done for the cache lookup of every pipeline creation.
+//
+// @param state : Benchmark state
+static void BM_GraphicsPipelineHash(benchmark::State &state) {
+  TypicalGraphicsPipeline pipeline;
+  const bool isCacheHash = state.range(0) != 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        PipelineDumper::generateHashForGraphicsPipeline(pipeline.getPipelineInfo(), isCacheHash, false));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_GraphicsPipelineHash)->Arg(0)->Arg(1);
+
+// =====================================================================================================================
+// Merges the fragment half of a pipeline ELF into the non-fragment half, as is done when both halves of a graphics
+// pipeline are found in the caches. The halves both come from the pipeline ELF of the -pipeline-elf option.
+//
+// @param state : Benchmark state
+static void BM_MergeElfBinary(benchmark::State &state) {
+  if (PipelineElf.empty()) {
+    state.SkipWithError("no -pipeline-elf given");
+    return;
+  }
+  auto bufferOrErr = MemoryBuffer::getFile(PipelineElf);
+  if (!bufferOrErr) {
+    state.SkipWithError("cannot read -pipeline-elf");
+    return;
+  }
+  std::unique_ptr<MemoryBuffer> buffer = std::move(*bufferOrErr);
+  BinaryData pipelineElf = {buffer->getBufferSize(), buffer->getBufferStart()};
+
+  GfxIpVersion gfxIp = getGfxIp();
+  ElfPackage fragmentPart;
+  ElfWriter<Elf64>::splitFragmentElf(gfxIp, &pipelineElf, &fragmentPart);
+  BinaryData fragmentElf = {fragmentPart.size(), fragmentPart.data()};
+
+  TypicalGraphicsPipeline pipeline;
+  MetroHash::Hash pipelineHash = {};
+  MetroHash::Hash cacheHash = {};
+  Context context(gfxIp);
+  GraphicsContext pipelineContext(gfxIp, pipeline.getPipelineInfo(), &pipelineHash, &cacheHash);
+  context.attachPipelineContext(&pipelineContext);
+
+  for (auto _ : state) {
+    ElfWriter<Elf64> writer(gfxIp);
+    if (writer.ReadFromBuffer(pipelineElf.pCode, pipelineElf.codeSize) != Result::Success) {
+      state.SkipWithError("-pipeline-elf is not a valid ELF");
+      break;
+    }
+    ElfPackage mergedElf;
+    writer.mergeElfBinary(&context, &fragmentElf, &mergedElf);
+    benchmark::DoNotOptimize(mergedElf.data());
+  }
+  context.attachPipelineContext(nullptr);
+  state.SetBytesProcessed(state.iterations() * pipelineElf.codeSize);
+}
+BENCHMARK(BM_MergeElfBinary);
+
+// =====================================================================================================================
+// Main function of the microbenchmarks. Benchmark options are taken first; the remaining options are LLVM options.
+//
+// @param argc : Count of arguments
+// @param argv : List of arguments
+int main(int argc, char *argv[]) {
+  benchmark::Initialize(&argc, argv);
+  cl::ParseCommandLineOptions(argc, argv, "LLPC microbenchmarks\n");
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
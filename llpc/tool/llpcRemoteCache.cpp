@@ -0,0 +1,474 @@
+/*
+ ***********************************************************************************************************************
+ *
+ *  Copyright (c) 2020 Advanced Micro Devices, Inc. All Rights Reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ **********************************************************************************************************************/
+/**
+ ***********************************************************************************************************************
+ * @file  llpcRemoteCache.cpp
+ * @brief LLPC source file: ICache implementation that layers a local shader cache over a remote store
+ ***********************************************************************************************************************
+ */
+#include "llpcRemoteCache.h"
+#include "llpcDebug.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/DynamicLibrary.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <string.h>
+
+using namespace llvm;
+using namespace Llpc;
+using namespace Vkgc;
+
+// Maximum number of keys asked for in one fetch from the remote store
+static constexpr unsigned PrefetchBatchSize = 256;
+
+namespace {
+
+// Context of a fetch from the remote store, passed to the fetch callback
+struct FetchContext {
+  const HashId *keys;                                          // Keys asked for
+  std::unordered_map<uint64_t, std::vector<uint8_t>> *entries; // Entries found
+};
+
+} // anonymous namespace
+
+// =====================================================================================================================
+//
+// @param gfxIp : Graphics IP version info
+// @param remoteStore : Remote store, owned by the new object
+RemoteCache::RemoteCache(GfxIpVersion gfxIp, IRemoteStore *remoteStore)
+    : m_remoteStore(remoteStore), m_stopWorker(false) {
+  ShaderCacheCreateInfo createInfo = {};
+  ShaderCacheAuxCreateInfo auxCreateInfo = {};
+  auxCreateInfo.shaderCacheMode = ShaderCacheEnableRuntime;
+  auxCreateInfo.gfxIp = gfxIp;
+  auxCreateInfo.cacheFilePath = "";
+  auxCreateInfo.executableName = "";
+  m_localCache.init(&createInfo, &auxCreateInfo);
+
+  m_worker = std::thread([this] { runWorker(); });
+}
+
+// =====================================================================================================================
+// Drops the queued prefetches and waits for the queued uploads to finish, then destroys the remote store.
+RemoteCache::~RemoteCache() {
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_prefetchQueue.clear();
+    m_stopWorker = true;
+  }
+  m_condition.notify_all();
+  m_worker.join();
+
+  if (m_remoteStore)
+    m_remoteStore->Destroy();
+}
+
+// =====================================================================================================================
+// Loads a remote store plugin and creates a remote cache over the store it provides. Returns nullptr on failure.
+//
+// @param gfxIp : Graphics IP version info
+// @param pluginPath : Path of the shared library of the plugin
+// @param config : Configuration string passed to the plugin
+RemoteCache *RemoteCache::create(GfxIpVersion gfxIp, const char *pluginPath, const char *config) {
+  std::string errorMsg;
+  sys::DynamicLibrary plugin = sys::DynamicLibrary::getPermanentLibrary(pluginPath, &errorMsg);
+  if (!plugin.isValid()) {
+    LLPC_ERRS("Failed to load remote cache plugin " << pluginPath << ": " << errorMsg << "\n");
+    return nullptr;
+  }
+
+  auto createRemoteStore = reinterpret_cast<CreateRemoteStoreFunc>(plugin.getAddressOfSymbol("LlpcCreateRemoteStore"));
+  IRemoteStore *remoteStore = createRemoteStore ? createRemoteStore(RemoteStoreInterfaceVersion, config) : nullptr;
+  if (!remoteStore) {
+    LLPC_ERRS("Failed to create remote store with plugin " << pluginPath << "\n");
+    return nullptr;
+  }
+  return new RemoteCache(gfxIp, remoteStore);
+}
+
+// =====================================================================================================================
+// Converts an ICache hash to the hash of the local cache, returning the 64-bit key used for both.
+//
+// @param hash : ICache hash
+// @param [out] localHash : Hash of the local cache
+uint64_t RemoteCache::getKey(const HashId &hash, MetroHash::Hash *localHash) {
+  static_assert(sizeof(HashId) == sizeof(MetroHash::Hash), "Unexpected hash size");
+  memcpy(localHash, &hash, sizeof(MetroHash::Hash));
+  return MetroHash::compact64(localHash);
+}
+
+// =====================================================================================================================
+// Receives an entry found by IRemoteStore::Fetch.
+//
+// @param userData : The FetchContext
+// @param keyIndex : Index of the key of the entry
+// @param data : Contents of the entry
+// @param dataLen : Size of the contents of the entry
+void RemoteCache::receiveEntry(void *userData, unsigned keyIndex, const void *data, size_t dataLen) {
+  auto context = static_cast<FetchContext *>(userData);
+  MetroHash::Hash localHash;
+  const uint64_t key = getKey(context->keys[keyIndex], &localHash);
+  const uint8_t *bytes = static_cast<const uint8_t *>(data);
+  (*context->entries)[key].assign(bytes, bytes + dataLen);
+}
+
+// =====================================================================================================================
+// Fetches a batch of entries from the remote store. Returns false if the store could not be asked, in which case
+// nothing is known about the absence of the entries.
+//
+// @param keys : Keys of the entries
+// @param keyCount : Count of keys
+// @param [out] entries : Entries that were found
+bool RemoteCache::fetchEntries(const HashId *keys, unsigned keyCount, FetchedEntryMap &entries) {
+  std::lock_guard<std::mutex> remoteLock(m_remoteLock);
+  if (!m_remoteStore)
+    return false;
+
+  FetchContext context = {keys, &entries};
+  Result result = m_remoteStore->Fetch(keys, keyCount, &receiveEntry, &context);
+  if (result == Result::ErrorUnavailable) {
+    m_remoteStore->Destroy();
+    m_remoteStore = nullptr;
+  }
+  return result == Result::Success;
+}
+
+// =====================================================================================================================
+// Stores an entry in the remote store.
+//
+// @param key : Key of the entry
+// @param data : Contents of the entry
+// @param dataLen : Size of the contents of the entry
+void RemoteCache::storeEntry(const HashId &key, const void *data, size_t dataLen) {
+  std::lock_guard<std::mutex> remoteLock(m_remoteLock);
+  if (!m_remoteStore)
+    return;
+
+  if (m_remoteStore->Store(key, data, dataLen) == Result::ErrorUnavailable) {
+    m_remoteStore->Destroy();
+    m_remoteStore = nullptr;
+  }
+}
+
+// =====================================================================================================================
+// Queues an entry to be uploaded to the remote store by the worker thread.
+//
+// @param key : Key of the entry
+// @param data : Contents of the entry
+// @param dataLen : Size of the contents of the entry
+void RemoteCache::queueUpload(const HashId &key, const void *data, size_t dataLen) {
+  const uint8_t *bytes = static_cast<const uint8_t *>(data);
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_uploadQueue.emplace_back(key, std::vector<uint8_t>(bytes, bytes + dataLen));
+  }
+  m_condition.notify_all();
+}
+
+// =====================================================================================================================
+// Runs the worker thread, which fetches the queued prefetch batches and uploads the queued entries. Prefetches come
+// first, as a compile may be waiting for them.
+void RemoteCache::runWorker() {
+  std::unique_lock<std::mutex> lock(m_lock);
+  for (;;) {
+    m_condition.wait(lock, [this] { return m_stopWorker || !m_prefetchQueue.empty() || !m_uploadQueue.empty(); });
+
+    if (!m_prefetchQueue.empty()) {
+      std::vector<HashId> keys = std::move(m_prefetchQueue.front());
+      m_prefetchQueue.pop_front();
+      lock.unlock();
+      FetchedEntryMap entries;
+      const bool fetched = fetchEntries(keys.data(), keys.size(), entries);
+      lock.lock();
+
+      for (const HashId &hash : keys) {
+        MetroHash::Hash localHash;
+        const uint64_t key = getKey(hash, &localHash);
+        m_prefetchingKeys.erase(key);
+        auto entry = entries.find(key);
+        if (entry != entries.end())
+          m_prefetched[key] = std::move(entry->second);
+        else if (fetched)
+          m_absentKeys.insert(key);
+      }
+      m_condition.notify_all();
+    } else if (!m_uploadQueue.empty()) {
+      auto upload = std::move(m_uploadQueue.front());
+      m_uploadQueue.pop_front();
+      lock.unlock();
+      storeEntry(upload.first, upload.second.data(), upload.second.size());
+      lock.lock();
+    } else if (m_stopWorker)
+      break;
+  }
+}
+
+// =====================================================================================================================
+// Queues the entries with the given keys to be fetched from the remote store in batches, skipping the ones that are
+// known to be absent from the store, or already fetched or being fetched. The local cache is not consulted here, as a
+// lookup there waits for an entry that is being compiled.
+//
+// @param keys : Keys of the entries
+// @param keyCount : Count of keys
+void RemoteCache::prefetch(const HashId *keys, unsigned keyCount) {
+  std::vector<HashId> batch;
+  std::lock_guard<std::mutex> lock(m_lock);
+  for (unsigned i = 0; i < keyCount; ++i) {
+    MetroHash::Hash localHash;
+    const uint64_t key = getKey(keys[i], &localHash);
+    if (m_absentKeys.count(key) || m_prefetchingKeys.count(key) || m_prefetched.count(key))
+      continue;
+
+    m_prefetchingKeys.insert(key);
+    batch.push_back(keys[i]);
+    if (batch.size() == PrefetchBatchSize) {
+      m_prefetchQueue.push_back(std::move(batch));
+      batch.clear();
+    }
+  }
+  if (!batch.empty())
+    m_prefetchQueue.push_back(std::move(batch));
+  m_condition.notify_all();
+}
+
+// =====================================================================================================================
+// Prefetches the entries whose keys are listed in the given file, one key in hexadecimal per line, as written by
+// saveKeyList().
+//
+// @param fileName : Name of the key list file
+Result RemoteCache::loadKeyList(const char *fileName) {
+  auto fileOrErr = MemoryBuffer::getFile(fileName);
+  if (!fileOrErr)
+    return Result::ErrorUnavailable;
+
+  std::vector<HashId> keys;
+  SmallVector<StringRef, 0> lines;
+  (*fileOrErr)->getBuffer().split(lines, '\n', -1, false);
+  for (StringRef line : lines) {
+    std::string bytes = fromHex(line.trim());
+    if (bytes.size() != sizeof(HashId))
+      return Result::ErrorInvalidValue;
+    HashId key;
+    memcpy(&key, bytes.data(), sizeof(key));
+    keys.push_back(key);
+  }
+  prefetch(keys.data(), keys.size());
+  return Result::Success;
+}
+
+// =====================================================================================================================
+// Writes the keys of the entries looked up so far to the given file, so that a later run can prefetch them.
+//
+// @param fileName : Name of the key list file
+Result RemoteCache::saveKeyList(const char *fileName) {
+  std::error_code errCode;
+  raw_fd_ostream out(fileName, errCode, sys::fs::OF_Text);
+  if (errCode)
+    return Result::ErrorUnavailable;
+
+  std::lock_guard<std::mutex> lock(m_lock);
+  for (const HashId &key : m_usedKeys)
+    out << toHex(ArrayRef<uint8_t>(key.bytes, sizeof(key.bytes))) << "\n";
+  return Result::Success;
+}
+
+// =====================================================================================================================
+// Obtains a cache entry for the hash. A miss in the local cache is filled from the prefetched entries or the remote
+// store if possible, so NotFound is only returned when neither has the entry.
+//
+// @param hash : Hash key of the cache entry
+// @param allocateOnMiss : Whether to allocate a new entry, to be populated by the caller, on a miss
+// @param [out] pHandle : Handle of the cache entry
+Result RemoteCache::GetEntry(HashId hash, bool allocateOnMiss, EntryHandle *pHandle) {
+  MetroHash::Hash localHash;
+  const uint64_t key = getKey(hash, &localHash);
+
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+    if (m_usedKeySet.insert(key).second)
+      m_usedKeys.push_back(hash);
+  }
+
+  // Threads that look up the same entry wait inside findShader until the one that got the entry as Compiling has
+  // populated or reset it.
+  CacheEntryHandle hEntry = nullptr;
+  ShaderEntryState state = m_localCache.findShader(localHash, true, &hEntry);
+  if (state == ShaderEntryState::Compiling) {
+    std::vector<uint8_t> data;
+    bool found = false;
+    bool absent = false;
+    {
+      std::unique_lock<std::mutex> lock(m_lock);
+      m_condition.wait(lock, [&] { return m_prefetchingKeys.count(key) == 0; });
+      auto entry = m_prefetched.find(key);
+      if (entry != m_prefetched.end()) {
+        data = std::move(entry->second);
+        m_prefetched.erase(entry);
+        found = true;
+      } else
+        absent = m_absentKeys.count(key) != 0;
+    }
+
+    if (!found && !absent) {
+      FetchedEntryMap entries;
+      if (fetchEntries(&hash, 1, entries)) {
+        auto entry = entries.find(key);
+        if (entry != entries.end()) {
+          data = std::move(entry->second);
+          found = true;
+        } else {
+          std::lock_guard<std::mutex> lock(m_lock);
+          m_absentKeys.insert(key);
+        }
+      }
+    }
+
+    if (found) {
+      m_localCache.insertShader(hEntry, data.data(), data.size());
+      state = m_localCache.findShader(localHash, false, &hEntry);
+    }
+  }
+
+  if (state == ShaderEntryState::Ready) {
+    *pHandle = EntryHandle(this, new Entry{hash, hEntry, true}, false);
+    return Result::Success;
+  }
+
+  if (state == ShaderEntryState::Compiling) {
+    if (!allocateOnMiss) {
+      m_localCache.resetShader(hEntry);
+      return Result::NotFound;
+    }
+    *pHandle = EntryHandle(this, new Entry{hash, hEntry, false}, true);
+    return Result::NotFound;
+  }
+
+  return Result::ErrorUnknown;
+}
+
+// =====================================================================================================================
+// Releases a handle to a cache entry. An entry that the owner of the handle was to populate but did not is made
+// available to be populated again.
+//
+// @param rawHandle : Handle of the cache entry
+void RemoteCache::ReleaseEntry(RawEntryHandle rawHandle) {
+  Entry *entry = static_cast<Entry *>(rawHandle);
+  if (entry->ready)
+    m_localCache.releaseShader(entry->hEntry);
+  else if (entry->hEntry)
+    m_localCache.resetShader(entry->hEntry);
+  delete entry;
+}
+
+// =====================================================================================================================
+// Waits for a cache entry to become ready. Entries are only handed out once they are ready, or to the one owner that
+// populates them, so there is never anything to wait for.
+//
+// @param rawHandle : Handle of the cache entry
+Result RemoteCache::WaitForEntry(RawEntryHandle rawHandle) {
+  return static_cast<Entry *>(rawHandle)->ready ? Result::Success : Result::ErrorUnknown;
+}
+
+// =====================================================================================================================
+// Copies the contents of a cache entry.
+//
+// @param rawHandle : Handle of the cache entry
+// @param [out] pData : Buffer for the contents, or null to query the size
+// @param [in,out] pDataLen : Size of the buffer, then size of the contents
+Result RemoteCache::GetValue(RawEntryHandle rawHandle, void *pData, size_t *pDataLen) {
+  const void *data = nullptr;
+  size_t dataLen = 0;
+  Result result = GetValueZeroCopy(rawHandle, &data, &dataLen);
+  if (result == Result::Success) {
+    if (pData)
+      memcpy(pData, data, std::min(*pDataLen, dataLen));
+    *pDataLen = dataLen;
+  }
+  return result;
+}
+
+// =====================================================================================================================
+// Gets the contents of a cache entry without copying them. They stay valid until the handle is released.
+//
+// @param rawHandle : Handle of the cache entry
+// @param [out] ppData : Contents of the entry
+// @param [out] pDataLen : Size of the contents of the entry
+Result RemoteCache::GetValueZeroCopy(RawEntryHandle rawHandle, const void **ppData, size_t *pDataLen) {
+  Entry *entry = static_cast<Entry *>(rawHandle);
+  if (!entry->ready)
+    return Result::NotReady;
+  return m_localCache.retrieveShader(entry->hEntry, ppData, pDataLen);
+}
+
+// =====================================================================================================================
+// Populates a cache entry, and queues it to be uploaded to the remote store.
+//
+// @param rawHandle : Handle of the cache entry
+// @param success : Whether computing the contents was successful
+// @param pData : Contents of the entry
+// @param dataLen : Size of the contents of the entry
+Result RemoteCache::SetValue(RawEntryHandle rawHandle, bool success, const void *pData, size_t dataLen) {
+  Entry *entry = static_cast<Entry *>(rawHandle);
+  Result result = ReleaseWithValue(new Entry(*entry), success, pData, dataLen);
+  entry->hEntry = nullptr;
+  if (result == Result::Success) {
+    // Keep the populated entry through this handle, as its owner may still read it.
+    MetroHash::Hash localHash;
+    getKey(entry->key, &localHash);
+    if (m_localCache.findShader(localHash, false, &entry->hEntry) == ShaderEntryState::Ready)
+      entry->ready = true;
+    else
+      entry->hEntry = nullptr;
+  }
+  return result;
+}
+
+// =====================================================================================================================
+// Populates a cache entry and releases the handle. The upload to the remote store is left to the worker thread, so it
+// does not hold up the compile.
+//
+// @param rawHandle : Handle of the cache entry
+// @param success : Whether computing the contents was successful
+// @param pData : Contents of the entry
+// @param dataLen : Size of the contents of the entry
+Result RemoteCache::ReleaseWithValue(RawEntryHandle rawHandle, bool success, const void *pData, size_t dataLen) {
+  Entry *entry = static_cast<Entry *>(rawHandle);
+  if (!entry || entry->ready || !entry->hEntry) {
+    if (entry)
+      ReleaseEntry(entry);
+    return Result::ErrorUnknown;
+  }
+
+  Result result = Result::ErrorUnknown;
+  if (success && pData && dataLen > 0) {
+    m_localCache.insertShader(entry->hEntry, pData, dataLen);
+    queueUpload(entry->key, pData, dataLen);
+    entry->hEntry = nullptr;
+    result = Result::Success;
+  }
+  ReleaseEntry(entry);
+  return result;
+}
@@ -0,0 +1,151 @@
+/*
+ ***********************************************************************************************************************
+ *
+ *  Copyright (c) 2020 Advanced Micro Devices, Inc. All Rights Reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ **********************************************************************************************************************/
+/**
+ ***********************************************************************************************************************
+ * @file  llpcRemoteCache.h
+ * @brief LLPC header file: ICache implementation that layers a local shader cache over a remote store
+ ***********************************************************************************************************************
+ */
+#pragma once
+
+#include "llpcShaderCache.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace Llpc {
+
+// Version of the remote store plugin interface. A plugin is a shared library that exports LlpcCreateRemoteStore.
+static constexpr unsigned RemoteStoreInterfaceVersion = 1;
+
+// Callback through which IRemoteStore::Fetch returns each entry that it found.
+//
+// @param userData : User data passed to Fetch
+// @param keyIndex : Index of the key of the entry in the array of keys passed to Fetch
+// @param data : Contents of the entry, only valid for the duration of the callback
+// @param dataLen : Size of the contents of the entry
+typedef void (*RemoteStoreFetchCallback)(void *userData, unsigned keyIndex, const void *data, size_t dataLen);
+
+// =====================================================================================================================
+// Interface of a remote content-addressed store of cache entries, implemented by a plugin. The methods may be called
+// from any thread, but not concurrently.
+class IRemoteStore {
+public:
+  // Fetches a batch of entries. Entries that were not found are simply not returned.
+  //
+  // Returns Success if the lookup was done, ErrorUnavailable if the store cannot be reached and should no longer be
+  // used, or any other error code for a transient failure.
+  virtual Vkgc::Result Fetch(const Vkgc::HashId *keys, unsigned keyCount, RemoteStoreFetchCallback callback,
+                             void *userData) = 0;
+
+  // Stores an entry, with the same return codes as Fetch.
+  virtual Vkgc::Result Store(const Vkgc::HashId &key, const void *data, size_t dataLen) = 0;
+
+  // Destroys the store.
+  virtual void Destroy() = 0;
+
+protected:
+  virtual ~IRemoteStore() {}
+};
+
+// Type of the function that a remote store plugin exports as LlpcCreateRemoteStore. Returns nullptr if the plugin
+// does not support the interface version, or the configuration string is invalid.
+typedef IRemoteStore *(*CreateRemoteStoreFunc)(unsigned interfaceVersion, const char *config);
+
+// =====================================================================================================================
+// Implementation of ICache that layers a local runtime shader cache over a remote store:
+//
+// - A miss in the local cache is fetched from the store, unless it is known to be absent there. Keys that the store
+//   did not have are remembered, so they are not asked for again.
+// - Entries can be prefetched from the store in batches, on a background thread, ahead of their use.
+// - Entries that the compiler populates are uploaded to the store on a background thread.
+class RemoteCache : public Vkgc::ICache {
+public:
+  RemoteCache(Vkgc::GfxIpVersion gfxIp, IRemoteStore *remoteStore);
+  virtual ~RemoteCache();
+
+  static RemoteCache *create(Vkgc::GfxIpVersion gfxIp, const char *pluginPath, const char *config);
+
+  void prefetch(const Vkgc::HashId *keys, unsigned keyCount);
+  Vkgc::Result loadKeyList(const char *fileName);
+  Vkgc::Result saveKeyList(const char *fileName);
+
+  // Implementation of ICache
+  virtual Vkgc::Result GetEntry(Vkgc::HashId hash, bool allocateOnMiss, Vkgc::EntryHandle *pHandle);
+  virtual void ReleaseEntry(Vkgc::RawEntryHandle rawHandle);
+  virtual Vkgc::Result WaitForEntry(Vkgc::RawEntryHandle rawHandle);
+  virtual Vkgc::Result GetValue(Vkgc::RawEntryHandle rawHandle, void *pData, size_t *pDataLen);
+  virtual Vkgc::Result GetValueZeroCopy(Vkgc::RawEntryHandle rawHandle, const void **ppData, size_t *pDataLen);
+  virtual Vkgc::Result SetValue(Vkgc::RawEntryHandle rawHandle, bool success, const void *pData, size_t dataLen);
+  virtual Vkgc::Result ReleaseWithValue(Vkgc::RawEntryHandle rawHandle, bool success, const void *pData,
+                                        size_t dataLen);
+
+private:
+  RemoteCache(const RemoteCache &) = delete;
+  RemoteCache &operator=(const RemoteCache &) = delete;
+
+  // Handle of an entry of the local cache
+  struct Entry {
+    Vkgc::HashId key;        // Key of the entry
+    CacheEntryHandle hEntry; // Handle of the entry in the local cache
+    bool ready;              // Whether the entry is ready, rather than to be populated by the owner of the handle
+  };
+
+  // Map from key to contents of the entries returned by a fetch
+  typedef std::unordered_map<uint64_t, std::vector<uint8_t>> FetchedEntryMap;
+
+  // Queue of keys and contents of entries to be uploaded
+  typedef std::deque<std::pair<Vkgc::HashId, std::vector<uint8_t>>> UploadQueue;
+
+  static void receiveEntry(void *userData, unsigned keyIndex, const void *data, size_t dataLen);
+  static uint64_t getKey(const Vkgc::HashId &hash, MetroHash::Hash *localHash);
+
+  bool fetchEntries(const Vkgc::HashId *keys, unsigned keyCount, FetchedEntryMap &entries);
+  void storeEntry(const Vkgc::HashId &key, const void *data, size_t dataLen);
+  void queueUpload(const Vkgc::HashId &key, const void *data, size_t dataLen);
+  void runWorker();
+
+  ShaderCache m_localCache;    // Local runtime cache of the entries
+  IRemoteStore *m_remoteStore; // Remote store, or nullptr once it has been found to be unavailable
+
+  std::mutex m_remoteLock;                               // Lock for calls into m_remoteStore
+  std::mutex m_lock;                                     // Lock for the members below
+  std::condition_variable m_condition;                   // Signals work for and progress of the worker
+  std::unordered_set<uint64_t> m_absentKeys;             // Keys known to be absent from the store
+  std::unordered_set<uint64_t> m_prefetchingKeys;        // Keys in queued or running prefetch batches
+  FetchedEntryMap m_prefetched;                          // Prefetched entries not yet in the local cache
+  std::deque<std::vector<Vkgc::HashId>> m_prefetchQueue; // Queued prefetch batches
+  UploadQueue m_uploadQueue;                             // Queued uploads
+  std::vector<Vkgc::HashId> m_usedKeys;                  // Keys looked up, in order of first use
+  std::unordered_set<uint64_t> m_usedKeySet;             // Keys in m_usedKeys
+  bool m_stopWorker;                                     // Whether the worker is to exit when idle
+  std::thread m_worker;                                  // Thread that prefetches and uploads entries
+};
+
+} // namespace Llpc
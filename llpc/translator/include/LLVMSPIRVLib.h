@@ -86,6 +86,14 @@ struct SPIRVSpecConstEntry
 /// \brief Represents the map from SpecId to specialization constant data.
 typedef std::map<uint32_t, SPIRVSpecConstEntry> SPIRVSpecConstMap;
 
+/// \brief Level of the LLVM debug info translated from SPIR-V debug
+/// instructions.
+enum class SPIRVDebugInfoLevel : unsigned {
+  None,           // No debug info; debug instructions are skipped
+  LineTablesOnly, // Only source locations of instructions, from OpLine
+  Full,           // Also scopes, types and variables
+};
+
 /// \brief Check if a string contains SPIR-V binary.
 bool IsSPIRVBinary(std::string &Img);
 
@@ -115,7 +123,9 @@ bool readSpirv(lgc::Builder *Builder,
                const char *EntryName,
                const SPIRV::SPIRVSpecConstMap &SpecConstMap,
                llvm::Module *M,
-               std::string &ErrMsg);
+               std::string &ErrMsg,
+               SPIRV::SPIRVDebugInfoLevel DebugInfoLevel =
+                   SPIRV::SPIRVDebugInfoLevel::Full);
 
 /// \brief Regularize LLVM module by removing entities not representable by
 /// SPIRV.
@@ -96,6 +96,9 @@ cl::opt<bool> SPIRVGenFastMath("spirv-gen-fast-math", cl::init(true),
 cl::opt<bool> SPIRVWorkaroundBadSPIRV("spirv-workaround-bad-spirv", cl::init(true),
                                       cl::desc("Enable workarounds for bad SPIR-V"));
 
+cl::opt<bool> SPIRVTranslateReachableOnly("spirv-translate-reachable-only", cl::init(false),
+                                          cl::desc("Only translate functions reachable from the targeted entry-point"));
+
 // Prefix for placeholder global variable name.
 const char *KPlaceholderPrefix = "placeholder.";
 
@@ -124,13 +127,23 @@ static void dumpLLVM(Module *m, const std::string &fName) {
 }
 
 SPIRVToLLVM::SPIRVToLLVM(Module *llvmModule, SPIRVModule *theSpirvModule, const SPIRVSpecConstMap &theSpecConstMap,
-                         lgc::Builder *builder, const Vkgc::ShaderModuleUsage *moduleUsage)
+                         lgc::Builder *builder, const Vkgc::ShaderModuleUsage *moduleUsage,
+                         SPIRVDebugInfoLevel debugInfoLevel)
     : m_m(llvmModule), m_builder(builder), m_bm(theSpirvModule), m_enableXfb(false), m_entryTarget(nullptr),
-      m_specConstMap(theSpecConstMap), m_dbgTran(m_bm, m_m, this),
+      m_specConstMap(theSpecConstMap), m_dbgTran(m_bm, m_m, this, debugInfoLevel),
       m_moduleUsage(reinterpret_cast<const Vkgc::ShaderModuleUsage *>(moduleUsage)) {
   assert(m_m);
   m_context = &m_m->getContext();
   m_spirvOpMetaKindId = m_context->getMDKindID(MetaNameSpirvOp);
+  m_relaxedPrecisionMetaKindId = m_context->getMDKindID(lgc::RelaxedPrecisionMetadataName);
+}
+
+Type *SPIRVToLLVM::mapType(SPIRVType *bt, Type *t) {
+  m_typeMap[bt] = t;
+
+  if (m_typeTranslationLog)
+    m_typeTranslationLog->effects.push_back({SpirvTypeTranslation::MappedType, bt, 0, 0, t, false});
+  return t;
 }
 
 void SPIRVToLLVM::recordRemappedTypeElements(SPIRVType *bt, unsigned from, unsigned to) {
@@ -140,6 +153,149 @@ void SPIRVToLLVM::recordRemappedTypeElements(SPIRVType *bt, unsigned from, unsig
     elements.resize(from + 1, 0);
 
   elements[from] = to;
+
+  if (m_typeTranslationLog)
+    m_typeTranslationLog->effects.push_back({SpirvTypeTranslation::RemappedTypeElement, bt, from, to, nullptr, false});
+}
+
+// =====================================================================================================================
+// Record that an LLVM type contains manually inserted padding.
+//
+// @param t : The padded type
+// @param isMatrixRow : Whether the type is a row-major matrix
+Type *SPIRVToLLVM::recordTypeWithPad(Type *const t, bool isMatrixRow) {
+  m_typesWithPadMap[t] = isMatrixRow;
+
+  if (m_typeTranslationLog)
+    m_typeTranslationLog->effects.push_back({SpirvTypeTranslation::TypeWithPad, nullptr, 0, 0, t, isMatrixRow});
+  return t;
+}
+
+// =====================================================================================================================
+// Record the original type of a struct member that was replaced by a pad array because of overlapping offsets.
+//
+// @param bt : The struct type
+// @param index : The member index
+// @param memberType : The original type of the member
+void SPIRVToLLVM::recordOverlappingStructMember(SPIRVType *bt, unsigned index, Type *memberType) {
+  m_overlappingStructTypeWorkaroundMap[std::make_pair(bt, index)] = memberType;
+
+  if (m_typeTranslationLog) {
+    m_typeTranslationLog->effects.push_back(
+        {SpirvTypeTranslation::OverlappingMember, bt, index, 0, memberType, false});
+  }
+}
+
+// =====================================================================================================================
+// Build the structural key of a SPIR-V type for the context's type translation cache, and collect the nodes of the
+// type tree in preorder. Two types with the same key translate to the same LLVM type in the same context. Returns
+// false if the type is not cacheable (it contains opaque, image or forward pointer types, or is too large).
+//
+// @param bt : The SPIR-V type
+// @param [in/out] nodes : Type nodes in preorder
+// @param [in/out] key : Structural key
+bool SPIRVToLLVM::getTypeCacheKey(SPIRVType *bt, SmallVectorImpl<SPIRVType *> &nodes, std::string &key) {
+  static const unsigned MaxTypeCacheNodes = 256;
+  if (nodes.size() >= MaxTypeCacheNodes)
+    return false;
+  nodes.push_back(bt);
+
+  auto appendWord = [&key](uint32_t word) { key.append(reinterpret_cast<const char *>(&word), sizeof(word)); };
+
+  const Op opCode = bt->getOpCode();
+  appendWord(opCode);
+
+  switch (opCode) {
+  case OpTypeVoid:
+  case OpTypeBool:
+    return true;
+  case OpTypeInt:
+    appendWord(bt->getIntegerBitWidth());
+    appendWord(static_cast<SPIRVTypeInt *>(bt)->isSigned());
+    return true;
+  case OpTypeFloat:
+    appendWord(bt->getFloatBitWidth());
+    return true;
+  case OpTypeVector:
+    appendWord(bt->getVectorComponentCount());
+    return getTypeCacheKey(bt->getVectorComponentType(), nodes, key);
+  case OpTypeMatrix:
+    appendWord(bt->getMatrixColumnCount());
+    return getTypeCacheKey(bt->getMatrixColumnType(), nodes, key);
+  case OpTypeArray:
+  case OpTypeRuntimeArray: {
+    if (opCode == OpTypeArray) {
+      const uint64_t length = bt->getArrayLength();
+      appendWord(static_cast<uint32_t>(length));
+      appendWord(static_cast<uint32_t>(length >> 32));
+    }
+    SPIRVWord arrayStride = 0;
+    bt->hasDecorate(DecorationArrayStride, 0, &arrayStride);
+    appendWord(arrayStride);
+    return getTypeCacheKey(bt->getArrayElementType(), nodes, key);
+  }
+  case OpTypeStruct: {
+    SPIRVTypeStruct *const spvStructType = static_cast<SPIRVTypeStruct *>(bt);
+    const std::string &name = spvStructType->getName();
+    appendWord(spvStructType->isLiteral());
+    appendWord(name.size());
+    key.append(name);
+    appendWord(spvStructType->getMemberCount());
+    for (SPIRVWord i = 0, memberCount = spvStructType->getMemberCount(); i < memberCount; i++) {
+      SPIRVWord offset = 0;
+      SPIRVWord matrixStride = 0;
+      appendWord(spvStructType->hasMemberDecorate(i, DecorationOffset, 0, &offset));
+      appendWord(offset);
+      spvStructType->hasMemberDecorate(i, DecorationMatrixStride, 0, &matrixStride);
+      appendWord(matrixStride);
+      appendWord(spvStructType->hasMemberDecorate(i, DecorationRowMajor));
+      if (!getTypeCacheKey(spvStructType->getMemberType(i), nodes, key))
+        return false;
+    }
+    return true;
+  }
+  case OpTypePointer:
+    appendWord(bt->getPointerStorageClass());
+    return getTypeCacheKey(bt->getPointerElementType(), nodes, key);
+  default:
+    return false;
+  }
+}
+
+// =====================================================================================================================
+// Replay the effects of a cached type translation on the bookkeeping of this module. Returns false, without replaying
+// anything, if the cached translation conflicts with types already translated in this module.
+//
+// @param translation : The cached translation
+// @param nodes : Type nodes in preorder of the SPIR-V type being translated
+bool SPIRVToLLVM::replayTypeTranslation(const SpirvTypeTranslation &translation, ArrayRef<SPIRVType *> nodes) {
+  // The cached translation cannot be used if this module already translated a nested type differently, as values of
+  // that type would not match the cached aggregate.
+  for (const SpirvTypeTranslation::Effect &effect : translation.effects) {
+    if (effect.kind == SpirvTypeTranslation::MappedType) {
+      auto loc = m_typeMap.find(nodes[effect.node]);
+      if (loc != m_typeMap.end() && loc->second != effect.type)
+        return false;
+    }
+  }
+
+  for (const SpirvTypeTranslation::Effect &effect : translation.effects) {
+    switch (effect.kind) {
+    case SpirvTypeTranslation::RemappedTypeElement:
+      recordRemappedTypeElements(nodes[effect.node], effect.from, effect.to);
+      break;
+    case SpirvTypeTranslation::TypeWithPad:
+      recordTypeWithPad(effect.type, effect.isMatrixRow);
+      break;
+    case SpirvTypeTranslation::OverlappingMember:
+      recordOverlappingStructMember(nodes[effect.node], effect.from, effect.type);
+      break;
+    case SpirvTypeTranslation::MappedType:
+      mapType(nodes[effect.node], effect.type);
+      break;
+    }
+  }
+  return true;
 }
 
 uint64_t SPIRVToLLVM::getTypeStoreSize(Type *const t) {
@@ -576,7 +732,7 @@ Type *SPIRVToLLVM::transTypeWithOpcode<spv::OpTypeStruct>(SPIRVType *const spvTy
         memberTypes.push_back(getPadType(offset - (lastValidByte - bytes)));
 
         // Remember the original type of the struct member which we need later.
-        m_overlappingStructTypeWorkaroundMap[std::make_pair(spvType, lastIndex)] = lastMemberType;
+        recordOverlappingStructMember(spvType, lastIndex, lastMemberType);
 
         // And set the last valid byte to the offset since we've worked around this.
         lastValidByte = offset;
@@ -649,15 +805,106 @@ Type *SPIRVToLLVM::transTypeWithOpcode<OpTypeVector>(SPIRVType *const spvType, c
     return FixedVectorType::get(compType, spvType->getVectorComponentCount());
 }
 
+// =====================================================================================================================
+// Translate a SPIR-V type. Aggregate and pointer types are memoized in the context's type translation cache, keyed by
+// their structure and the layout parameters, so that the same block types met again in later pipelines compiled in
+// the same context are a lookup.
+//
+// @param t : The type.
+// @param matrixStride : The matrix stride (can be 0).
+// @param columnMajor : Whether the matrix is column major.
+// @param parentIsPointer : If the parent is a pointer type.
+// @param explicitlyLaidOut : If the type is one which is explicitly laid out.
 Type *SPIRVToLLVM::transType(SPIRVType *t, unsigned matrixStride, bool columnMajor, bool parentIsPointer,
                              bool explicitlyLaidOut) {
   // If the type is not a sub-part of a pointer or it is a forward pointer, we can look in the map.
   if (!parentIsPointer || t->isTypeForwardPointer()) {
     auto loc = m_typeMap.find(t);
-    if (loc != m_typeMap.end())
+    if (loc != m_typeMap.end()) {
+      // Effects of the earlier translation of a non-scalar type are not in the log being recorded.
+      if (m_typeTranslationLog && !t->isTypeVoid() && !t->isTypeBool() && !t->isTypeInt() && !t->isTypeFloat())
+        m_typeTranslationLog->complete = false;
       return loc->second;
+    }
   }
 
+  // Only the root of a translation is looked up in (and recorded into) the cache.
+  if (m_typeTranslationLog)
+    return transTypeUncached(t, matrixStride, columnMajor, parentIsPointer, explicitlyLaidOut);
+
+  switch (t->getOpCode()) {
+  case OpTypeArray:
+  case OpTypeMatrix:
+  case OpTypePointer:
+  case OpTypeRuntimeArray:
+  case OpTypeStruct:
+  case OpTypeVector:
+    break;
+  default:
+    return transTypeUncached(t, matrixStride, columnMajor, parentIsPointer, explicitlyLaidOut);
+  }
+
+  SmallVector<SPIRVType *, 16> nodes;
+  std::string key;
+  if (!getTypeCacheKey(t, nodes, key))
+    return transTypeUncached(t, matrixStride, columnMajor, parentIsPointer, explicitlyLaidOut);
+  key.append(reinterpret_cast<const char *>(&matrixStride), sizeof(matrixStride));
+  key.push_back(columnMajor);
+  key.push_back(parentIsPointer);
+  key.push_back(explicitlyLaidOut);
+
+  SpirvTypeTranslationCache &cache = static_cast<Llpc::Context *>(m_context)->getSpirvTypeTranslationCache();
+  auto it = cache.find(key);
+  if (it != cache.end()) {
+    if (replayTypeTranslation(it->second, nodes)) {
+      Type *const newTy = it->second.type;
+      return parentIsPointer ? newTy : mapType(t, newTy);
+    }
+    return transTypeUncached(t, matrixStride, columnMajor, parentIsPointer, explicitlyLaidOut);
+  }
+
+  TypeTranslationLog log;
+  m_typeTranslationLog = &log;
+  Type *const newTy = transTypeUncached(t, matrixStride, columnMajor, parentIsPointer, explicitlyLaidOut);
+  m_typeTranslationLog = nullptr;
+
+  if (!log.complete)
+    return newTy;
+
+  // Attach each effect to every node that is the SPIR-V type it was recorded for, as a structurally equal type in
+  // another module need not share nodes the same way.
+  SpirvTypeTranslation translation = {newTy, {}};
+  for (const TypeTranslationLog::Effect &effect : log.effects) {
+    auto kind = static_cast<SpirvTypeTranslation::EffectKind>(effect.kind);
+    if (kind == SpirvTypeTranslation::TypeWithPad) {
+      translation.effects.push_back({kind, 0, 0, 0, effect.type, effect.isMatrixRow});
+      continue;
+    }
+    bool found = false;
+    for (unsigned node = 0; node < nodes.size(); ++node) {
+      if (nodes[node] == effect.spvType) {
+        translation.effects.push_back({kind, node, effect.from, effect.to, effect.type, false});
+        found = true;
+      }
+    }
+    // The effect is on a type outside the structure of the key, so it could not be replayed.
+    if (!found)
+      return newTy;
+  }
+  cache.emplace(std::move(key), std::move(translation));
+  return newTy;
+}
+
+// =====================================================================================================================
+// Translate a SPIR-V type without consulting the context's type translation cache.
+//
+// @param t : The type.
+// @param matrixStride : The matrix stride (can be 0).
+// @param columnMajor : Whether the matrix is column major.
+// @param parentIsPointer : If the parent is a pointer type.
+// @param explicitlyLaidOut : If the type is one which is explicitly laid out.
+Type *SPIRVToLLVM::transTypeUncached(SPIRVType *t, unsigned matrixStride, bool columnMajor, bool parentIsPointer,
+                                     bool explicitlyLaidOut) {
   t->validate();
   switch (t->getOpCode()) {
   case OpTypeVoid:
@@ -1306,6 +1553,8 @@ DebugLoc SPIRVToLLVM::getDebugLoc(SPIRVInstruction *bi, Function *f) {
 }
 
 void SPIRVToLLVM::updateDebugLoc(SPIRVValue *bv, Function *f) {
+  if (!m_dbgTran.isEnabled())
+    return;
   if (bv->isInst()) {
     SPIRVInstruction *bi = static_cast<SPIRVInstruction *>(bv);
     getBuilder()->SetCurrentDebugLocation(getDebugLoc(bi, f));
@@ -4829,6 +5078,31 @@ template <class SourceTy, class FuncTy> bool SPIRVToLLVM::foreachFuncCtlMask(Sou
   return true;
 }
 
+// =====================================================================================================================
+// Collects the functions in the call graph rooted at the given entry-point.
+//
+// @param entry : Entry-point function to start from
+// @param [out] reachable : Set of functions reachable from the entry-point (including the entry-point itself)
+void SPIRVToLLVM::collectReachableFunctions(SPIRVFunction *entry, std::set<SPIRVFunction *> &reachable) {
+  SmallVector<SPIRVFunction *, 8> worklist;
+  reachable.insert(entry);
+  worklist.push_back(entry);
+  while (!worklist.empty()) {
+    SPIRVFunction *func = worklist.pop_back_val();
+    for (size_t bbIdx = 0, bbCount = func->getNumBasicBlock(); bbIdx != bbCount; ++bbIdx) {
+      SPIRVBasicBlock *block = func->getBasicBlock(bbIdx);
+      for (size_t instIdx = 0, instCount = block->getNumInst(); instIdx != instCount; ++instIdx) {
+        SPIRVInstruction *inst = block->getInst(instIdx);
+        if (inst->getOpCode() != OpFunctionCall)
+          continue;
+        SPIRVFunction *callee = static_cast<SPIRVFunctionCall *>(inst)->getFunction();
+        if (reachable.insert(callee).second)
+          worklist.push_back(callee);
+      }
+    }
+  }
+}
+
 Function *SPIRVToLLVM::transFunction(SPIRVFunction *bf) {
   auto loc = m_funcMap.find(bf);
   if (loc != m_funcMap.end())
@@ -5962,15 +6236,18 @@ bool SPIRVToLLVM::translate(ExecutionModel entryExecModel, const char *entryName
       m_bm->hasCapability(CapabilityImageGatherBiasLodAMD) && entryExecModel == ExecutionModelFragment;
 
   // Find the compile unit first since it might be needed during translation of
-  // debug intrinsics.
+  // debug intrinsics. Only full debug info translates the compile unit of the
+  // module; line tables use one of their own.
   MDNode *compilationUnit = nullptr;
-  for (SPIRVExtInst *EI : m_bm->getDebugInstVec()) {
-    // Translate Compile Unit first.
-    // It shouldn't be far from the beginning of the vector
-    if (EI->getExtOp() == SPIRVDebug::CompilationUnit) {
-      compilationUnit = m_dbgTran.transDebugInst(EI);
-      // Fixme: there might be more than one Compile Unit.
-      break;
+  if (m_dbgTran.isFull()) {
+    for (SPIRVExtInst *EI : m_bm->getDebugInstVec()) {
+      // Translate Compile Unit first.
+      // It shouldn't be far from the beginning of the vector
+      if (EI->getExtOp() == SPIRVDebug::CompilationUnit) {
+        compilationUnit = m_dbgTran.transDebugInst(EI);
+        // Fixme: there might be more than one Compile Unit.
+        break;
+      }
     }
   }
   if (!compilationUnit) {
@@ -6015,8 +6292,17 @@ bool SPIRVToLLVM::translate(ExecutionModel entryExecModel, const char *entryName
       transValue(bv, nullptr, nullptr);
   }
 
+  // Functions not reachable from the targeted entry-point are erased again once translation is done, so when the
+  // module holds several entry-points (or a large function library) we can skip translating them in the first place.
+  std::set<SPIRVFunction *> reachableFuncs;
+  bool translateReachableOnly = SPIRVTranslateReachableOnly && m_entryTarget && !m_moduleUsage->keepUnusedFunctions;
+  if (translateReachableOnly)
+    collectReachableFunctions(m_entryTarget, reachableFuncs);
+
   for (unsigned i = 0, e = m_bm->getNumFunctions(); i != e; ++i) {
     auto bf = m_bm->getFunction(i);
+    if (translateReachableOnly && reachableFuncs.count(bf) == 0)
+      continue;
     // Non entry-points and targeted entry-point should be translated.
     // Set DLLExport on targeted entry-point so we can find it later.
     if (!m_bm->getEntryPoint(bf->getId()) || bf == m_entryTarget) {
@@ -6580,6 +6866,12 @@ bool SPIRVToLLVM::transShaderDecoration(SPIRVValue *bv, Value *v) {
       auto f = getOrCreateFunction(m_m, voidTy, types, mangledFuncName);
       CallInst::Create(f, args, "", bb);
     }
+
+    // Preserve RelaxedPrecision on 32-bit float arithmetic, so that the middle-end may compute it in 16 bits.
+    auto inst = dyn_cast<Instruction>(v);
+    if (inst && bv->hasDecorate(DecorationRelaxedPrecision) && inst->getType()->getScalarType()->isFloatTy() &&
+        (isa<BinaryOperator>(inst) || isa<UnaryOperator>(inst)))
+      inst->setMetadata(m_relaxedPrecisionMetaKindId, MDNode::get(*m_context, {}));
   }
 
   return true;
@@ -7874,14 +8166,14 @@ llvm::GlobalValue::LinkageTypes SPIRVToLLVM::transLinkageType(const SPIRVValue *
 
 bool llvm::readSpirv(Builder *builder, const ShaderModuleUsage *shaderInfo, std::istream &is,
                      spv::ExecutionModel entryExecModel, const char *entryName, const SPIRVSpecConstMap &specConstMap,
-                     Module *m, std::string &errMsg) {
+                     Module *m, std::string &errMsg, SPIRVDebugInfoLevel debugInfoLevel) {
   assert(entryExecModel != ExecutionModelKernel && "Not support ExecutionModelKernel");
 
   std::unique_ptr<SPIRVModule> bm(SPIRVModule::createSPIRVModule());
 
   is >> *bm;
 
-  SPIRVToLLVM btl(m, bm.get(), specConstMap, builder, shaderInfo);
+  SPIRVToLLVM btl(m, bm.get(), specConstMap, builder, shaderInfo, debugInfoLevel);
   bool succeed = true;
   if (!btl.translate(entryExecModel, entryName)) {
     bm->getError(errMsg);
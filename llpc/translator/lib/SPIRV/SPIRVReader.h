@@ -62,13 +62,18 @@ class Value;
 } // namespace llvm
 using namespace llvm;
 
+namespace Llpc {
+struct SpirvTypeTranslation;
+} // namespace Llpc
+
 namespace SPIRV {
 class SPIRVLoopMerge;
 class SPIRVToLLVMDbgTran;
 class SPIRVToLLVM {
 public:
   SPIRVToLLVM(Module *llvmModule, SPIRVModule *theSpirvModule, const SPIRVSpecConstMap &theSpecConstMap,
-              lgc::Builder *builder, const Vkgc::ShaderModuleUsage *moduleUsage);
+              lgc::Builder *builder, const Vkgc::ShaderModuleUsage *moduleUsage,
+              SPIRVDebugInfoLevel debugInfoLevel = SPIRVDebugInfoLevel::Full);
 
   DebugLoc getDebugLoc(SPIRVInstruction *bi, Function *f);
 
@@ -79,6 +84,8 @@ public:
   template <spv::Op>
   Type *transTypeWithOpcode(SPIRVType *bt, unsigned matrixStride, bool columnMajor, bool parentIsPointer,
                             bool explicitlyLaidOut);
+  Type *transTypeUncached(SPIRVType *bt, unsigned matrixStride, bool columnMajor, bool parentIsPointer,
+                          bool explicitlyLaidOut);
   std::vector<Type *> transTypeVector(const std::vector<SPIRVType *> &);
   bool translate(ExecutionModel entryExecModel, const char *entryName);
   bool transAddressingModel();
@@ -106,6 +113,7 @@ public:
   Value *transGLSLBuiltinFromExtInst(SPIRVExtInst *bc, BasicBlock *bb);
   std::vector<Value *> transValue(const std::vector<SPIRVValue *> &, Function *f, BasicBlock *);
   Function *transFunction(SPIRVFunction *f);
+  void collectReachableFunctions(SPIRVFunction *entry, std::set<SPIRVFunction *> &reachable);
   bool transMetadata();
   bool transNonTemporalMetadata(Instruction *i);
   Value *transConvertInst(SPIRVValue *bv, Function *f, BasicBlock *bb);
@@ -182,6 +190,21 @@ public:
   typedef DenseMap<GlobalVariable *, SPIRVBuiltinVariableKind> BuiltinVarMap;
   typedef DenseMap<SPIRVType *, SmallVector<unsigned, 8>> RemappedTypeElementsMap;
 
+  // Effects of a type translation on the bookkeeping below, logged while the translation is recorded into the
+  // context's type translation cache.
+  struct TypeTranslationLog {
+    struct Effect {
+      unsigned kind;      // SpirvTypeTranslation::EffectKind
+      SPIRVType *spvType; // SPIR-V type the effect applies to
+      unsigned from;
+      unsigned to;
+      Type *type;
+      bool isMatrixRow;
+    };
+    SmallVector<Effect, 8> effects;
+    bool complete = true; // False if part of the translation came from m_typeMap, so the effects are not all known
+  };
+
   // A SPIRV value may be translated to a load instruction of a placeholder
   // global variable. This map records load instruction of these placeholders
   // which are supposed to be replaced by the real values later.
@@ -212,13 +235,12 @@ private:
   DenseMap<std::pair<BasicBlock *, BasicBlock *>, unsigned> m_blockPredecessorToCount;
   const Vkgc::ShaderModuleUsage *m_moduleUsage;
   unsigned m_spirvOpMetaKindId;
+  unsigned m_relaxedPrecisionMetaKindId;
+  TypeTranslationLog *m_typeTranslationLog = nullptr; // Log of the type translation being recorded, if any
 
   lgc::Builder *getBuilder() const { return m_builder; }
 
-  Type *mapType(SPIRVType *bt, Type *t) {
-    m_typeMap[bt] = t;
-    return t;
-  }
+  Type *mapType(SPIRVType *bt, Type *t);
 
   void recordRemappedTypeElements(SPIRVType *bt, unsigned from, unsigned to);
 
@@ -232,10 +254,13 @@ private:
 
   Type *getPadType(unsigned bytes) { return ArrayType::get(getBuilder()->getInt8Ty(), bytes); }
 
-  Type *recordTypeWithPad(Type *const t, bool isMatrixRow = false) {
-    m_typesWithPadMap[t] = isMatrixRow;
-    return t;
-  }
+  Type *recordTypeWithPad(Type *const t, bool isMatrixRow = false);
+
+  void recordOverlappingStructMember(SPIRVType *bt, unsigned index, Type *memberType);
+
+  bool getTypeCacheKey(SPIRVType *bt, SmallVectorImpl<SPIRVType *> &nodes, std::string &key);
+
+  bool replayTypeTranslation(const Llpc::SpirvTypeTranslation &translation, ArrayRef<SPIRVType *> nodes);
 
   bool isTypeWithPad(Type *const t) const { return m_typesWithPadMap.count(t) > 0; }
 
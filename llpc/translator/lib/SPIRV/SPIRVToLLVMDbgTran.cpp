@@ -51,9 +51,11 @@ using namespace SPIRVDebug::Operand;
 
 namespace SPIRV {
 
-SPIRVToLLVMDbgTran::SPIRVToLLVMDbgTran(SPIRVModule *TBM, Module *TM, SPIRVToLLVM *Reader)
+SPIRVToLLVMDbgTran::SPIRVToLLVMDbgTran(SPIRVModule *TBM, Module *TM, SPIRVToLLVM *Reader,
+                                       SPIRVDebugInfoLevel Level)
     : BM(TBM), M(TM), Builder(*M), SPIRVReader(Reader) {
-  Enable = BM->hasDebugInfo();
+  Enable = Level != SPIRVDebugInfoLevel::None && BM->hasDebugInfo();
+  LineTablesOnly = Level == SPIRVDebugInfoLevel::LineTablesOnly;
 }
 
 void SPIRVToLLVMDbgTran::createCompilationUnit() {
@@ -848,6 +850,9 @@ MDNode *SPIRVToLLVMDbgTran::transDebugInstImpl(const SPIRVExtInst *DebugInst) {
 }
 
 Instruction *SPIRVToLLVMDbgTran::transDebugIntrinsic(const SPIRVExtInst *DebugInst, BasicBlock *BB) {
+  // Variables are not described by line tables.
+  if (!isFull())
+    return nullptr;
   auto GetLocalVar = [&](SPIRVId Id) -> std::pair<DILocalVariable *, DebugLoc> {
     auto *LV = transDebugInst<DILocalVariable>(BM->get<SPIRVExtInst>(Id));
     DebugLoc DL = DebugLoc::get(LV->getLine(), 0, LV->getScope());
@@ -905,7 +910,10 @@ DebugLoc SPIRVToLLVMDbgTran::transDebugScope(const SPIRVInstruction *SpirvInst,
     Line = L->getLine();
     Col = L->getColumn();
   }
-  if (SPIRVEntry *S = SpirvInst->getDebugScope()) {
+  // Line tables only use the function as the scope, so that the scope
+  // instructions, and the types they refer to, are not translated.
+  SPIRVEntry *S = LineTablesOnly ? nullptr : SpirvInst->getDebugScope();
+  if (S) {
     using namespace SPIRVDebug::Operand::Scope;
     SPIRVExtInst *DbgScope = static_cast<SPIRVExtInst *>(S);
     SPIRVWordVec Ops = DbgScope->getArguments();
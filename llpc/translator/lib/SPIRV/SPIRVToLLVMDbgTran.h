@@ -39,6 +39,7 @@
 #ifndef SPIRVTOLLVMDBGTRAN_H
 #define SPIRVTOLLVMDBGTRAN_H
 
+#include "LLVMSPIRVLib.h"
 #include "SPIRVInstruction.h"
 #include "SPIRVModule.h"
 #include "llvm/IR/DIBuilder.h"
@@ -63,7 +64,12 @@ class SPIRVToLLVMDbgTran {
 public:
   typedef std::vector<SPIRVWord> SPIRVWordVec;
 
-  SPIRVToLLVMDbgTran(SPIRVModule *TBM, Module *TM, SPIRVToLLVM *Reader);
+  SPIRVToLLVMDbgTran(SPIRVModule *TBM, Module *TM, SPIRVToLLVM *Reader,
+                     SPIRVDebugInfoLevel Level = SPIRVDebugInfoLevel::Full);
+  // Whether any debug info is translated
+  bool isEnabled() const { return Enable; }
+  // Whether debug info beyond line tables is translated
+  bool isFull() const { return Enable && !LineTablesOnly; }
   void createCompilationUnit();
   void transDbgInfo(SPIRVValue *SV, Value *V);
   template <typename T = MDNode> T *transDebugInst(const SPIRVExtInst *DebugInst) {
@@ -146,6 +152,7 @@ private:
   SPIRVToLLVM *SPIRVReader;
   DICompileUnit *CU;
   bool Enable;
+  bool LineTablesOnly;
   std::unordered_map<std::string, DIFile *> FileMap;
   std::unordered_map<SPIRVId, DISubprogram *> FuncMap;
   std::unordered_map<const SPIRVExtInst *, MDNode *> DebugInstCache;
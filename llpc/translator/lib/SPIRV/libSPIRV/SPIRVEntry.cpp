@@ -47,6 +47,7 @@
 #include "SPIRVType.h"
 
 #include <algorithm>
+#include <cstddef>
 #include <map>
 #include <set>
 #include <sstream>
@@ -57,6 +58,34 @@ using namespace SPIRV;
 
 namespace SPIRV {
 
+thread_local SPIRVEntryArena *SPIRVEntryArena::Current = nullptr;
+
+namespace {
+// Prefix of every entry allocation, recording the arena (if any) that owns it.
+struct alignas(alignof(std::max_align_t)) SPIRVEntryAllocHeader {
+  SPIRVEntryArena *Arena;
+};
+} // namespace
+
+void *SPIRVEntry::operator new(size_t Size) {
+  SPIRVEntryArena *Arena = SPIRVEntryArena::getCurrent();
+  size_t AllocSize = sizeof(SPIRVEntryAllocHeader) + Size;
+  void *Mem = Arena ? Arena->allocate(AllocSize, alignof(SPIRVEntryAllocHeader))
+                    : ::operator new(AllocSize);
+  auto Header = static_cast<SPIRVEntryAllocHeader *>(Mem);
+  Header->Arena = Arena;
+  return Header + 1;
+}
+
+void SPIRVEntry::operator delete(void *Ptr) {
+  if (!Ptr)
+    return;
+  auto Header = static_cast<SPIRVEntryAllocHeader *>(Ptr) - 1;
+  // Arena storage is released together with the arena.
+  if (!Header->Arena)
+    ::operator delete(Header);
+}
+
 template <typename T> SPIRVEntry *create() { return new T(); }
 
 SPIRVEntry *SPIRVEntry::create(Op OpCode) {
@@ -218,11 +247,16 @@ void SPIRVEntry::addDecorate(Decoration Kind, SPIRVWord Literal) {
   addDecorate(new SPIRVDecorate(Kind, this, Literal));
 }
 
-void SPIRVEntry::eraseDecorate(Decoration Dec) { Decorates.erase(Dec); }
+void SPIRVEntry::eraseDecorate(Decoration Dec) {
+  Decorates.erase(Dec);
+  if (Module)
+    Module->invalidateDecorateIndex();
+}
 
 void SPIRVEntry::takeDecorates(SPIRVEntry *E) {
   assert(E);
   Decorates = std::move(E->Decorates);
+  Module->invalidateDecorateIndex();
 }
 
 void SPIRVEntry::setLine(const std::shared_ptr<const SPIRVLine> &L) {
@@ -247,11 +281,14 @@ void SPIRVEntry::addMemberDecorate(SPIRVWord MemberNumber, Decoration Kind,
 
 void SPIRVEntry::eraseMemberDecorate(SPIRVWord MemberNumber, Decoration Dec) {
   MemberDecorates.erase(std::make_pair(MemberNumber, Dec));
+  if (Module)
+    Module->invalidateDecorateIndex();
 }
 
 void SPIRVEntry::takeMemberDecorates(SPIRVEntry *E) {
   assert(E);
   MemberDecorates = std::move(E->MemberDecorates);
+  Module->invalidateDecorateIndex();
 }
 
 void SPIRVEntry::takeAnnotations(SPIRVForward *E) {
@@ -267,11 +304,16 @@ void SPIRVEntry::takeAnnotations(SPIRVForward *E) {
 // first decoration of such kind at Index.
 bool SPIRVEntry::hasDecorate(Decoration Kind, size_t Index,
                              SPIRVWord *Result) const {
-  DecorateMapType::const_iterator Loc = Decorates.find(Kind);
-  if (Loc == Decorates.end())
+  const SPIRVDecorateGeneric *Dec = nullptr;
+  if (!Module || !Module->findIndexedDecorate(this, SPIRVWORD_MAX, Kind, Dec)) {
+    DecorateMapType::const_iterator Loc = Decorates.find(Kind);
+    if (Loc != Decorates.end())
+      Dec = Loc->second;
+  }
+  if (!Dec)
     return false;
   if (Result)
-    *Result = Loc->second->getLiteral(Index);
+    *Result = Dec->getLiteral(Index);
   return true;
 }
 
@@ -279,12 +321,17 @@ bool SPIRVEntry::hasDecorate(Decoration Kind, size_t Index,
 // literal of the first decoration of such kind at Index.
 bool SPIRVEntry::hasMemberDecorate(SPIRVWord MemberIndex, Decoration Kind,
                                    size_t Index, SPIRVWord *Result) const {
-  MemberDecorateMapType::const_iterator Loc =
-    MemberDecorates.find(std::make_pair(MemberIndex, Kind));
-  if (Loc == MemberDecorates.end())
+  const SPIRVDecorateGeneric *Dec = nullptr;
+  if (!Module || !Module->findIndexedDecorate(this, MemberIndex, Kind, Dec)) {
+    MemberDecorateMapType::const_iterator Loc =
+      MemberDecorates.find(std::make_pair(MemberIndex, Kind));
+    if (Loc != MemberDecorates.end())
+      Dec = Loc->second;
+  }
+  if (!Dec)
     return false;
   if (Result)
-    *Result = Loc->second->getLiteral(Index);
+    *Result = Dec->getLiteral(Index);
   return true;
 }
 
@@ -300,6 +347,15 @@ std::set<SPIRVWord> SPIRVEntry::getDecorate(Decoration Kind,
   return Value;
 }
 
+void SPIRVEntry::forEachDecorate(
+    const std::function<void(SPIRVWord MemberIndex, Decoration Kind,
+                             const SPIRVDecorateGeneric *Dec)> &Func) const {
+  for (auto &I : Decorates)
+    Func(SPIRVWORD_MAX, I.first, I.second);
+  for (auto &I : MemberDecorates)
+    Func(I.first.first, I.first.second, I.second);
+}
+
 bool SPIRVEntry::hasLinkageType() const {
   return OpCode == OpFunction || OpCode == OpVariable;
 }
@@ -43,7 +43,9 @@
 #include "SPIRVEnum.h"
 #include "SPIRVError.h"
 #include "SPIRVIsValidEnum.h"
+#include "llvm/Support/Allocator.h"
 #include <cassert>
+#include <functional>
 #include <iostream>
 #include <map>
 #include <memory>
@@ -61,6 +63,7 @@ class SPIRVDecoder;
 class SPIRVType;
 class SPIRVValue;
 class SPIRVDecorate;
+class SPIRVDecorateGeneric;
 class SPIRVForward;
 class SPIRVMemberDecorate;
 class SPIRVLine;
@@ -182,6 +185,44 @@ class SPIRVExtInst;
 /// 7. Add the class to the Table of SPIRVEntry::create().
 /// 8. Add the class to SPIRVToLLVM.
 
+/// Bump allocator owning the storage of the entries of one SPIR-V module.
+///
+/// While an arena is made current on a thread by SPIRVEntryArenaScope, every
+/// SPIRVEntry created on that thread is carved out of it. Deleting such an
+/// entry runs its destructor but does not free its storage; all of it is
+/// released in one shot when the arena itself is destroyed.
+class SPIRVEntryArena {
+public:
+  SPIRVEntryArena() {}
+  SPIRVEntryArena(const SPIRVEntryArena &) = delete;
+  SPIRVEntryArena &operator=(const SPIRVEntryArena &) = delete;
+
+  void *allocate(size_t Size, size_t Align) {
+    return Allocator.Allocate(Size, Align);
+  }
+
+  static SPIRVEntryArena *getCurrent() { return Current; }
+
+private:
+  friend class SPIRVEntryArenaScope;
+
+  llvm::BumpPtrAllocator Allocator;
+  static thread_local SPIRVEntryArena *Current;
+};
+
+/// Makes an arena current on this thread for the lifetime of the scope.
+class SPIRVEntryArenaScope {
+public:
+  explicit SPIRVEntryArenaScope(SPIRVEntryArena &Arena)
+      : Saved(SPIRVEntryArena::Current) {
+    SPIRVEntryArena::Current = &Arena;
+  }
+  ~SPIRVEntryArenaScope() { SPIRVEntryArena::Current = Saved; }
+
+private:
+  SPIRVEntryArena *Saved;
+};
+
 class SPIRVEntry {
 public:
   enum SPIRVEntryAttrib {
@@ -215,6 +256,10 @@ public:
 
   virtual ~SPIRVEntry() {}
 
+  // Entries are allocated from the current SPIRVEntryArena, if any.
+  static void *operator new(size_t Size);
+  static void operator delete(void *Ptr);
+
   bool exist(SPIRVId) const;
   template <class T> T *get(SPIRVId TheId) const {
     return static_cast<T *>(getEntry(TheId));
@@ -244,6 +289,12 @@ public:
   bool hasMemberDecorate(SPIRVWord MemberIndex, Decoration Kind,
                          size_t Index = 0, SPIRVWord *Result = 0) const;
   std::set<SPIRVWord> getDecorate(Decoration Kind, size_t Index = 0) const;
+  // Call Func on each decoration of this entry, with MemberIndex SPIRVWORD_MAX
+  // for decorations of the entry itself, in the order hasDecorate() and
+  // hasMemberDecorate() would find them.
+  void forEachDecorate(
+      const std::function<void(SPIRVWord MemberIndex, Decoration Kind,
+                               const SPIRVDecorateGeneric *Dec)> &Func) const;
   bool hasId() const { return !(Attrib & SPIRVEA_NOID); }
   bool hasLine() const { return Line != nullptr; }
   bool hasLinkageType() const;
@@ -47,6 +47,8 @@
 #include "SPIRVType.h"
 #include "SPIRVValue.h"
 
+#include "llvm/ADT/DenseMap.h"
+
 #include <set>
 #include <unordered_map>
 #include <unordered_set>
@@ -187,6 +189,11 @@ public:
   void addCapabilityInternal(SPIRVCapabilityKind) override;
   const SPIRVDecorateGeneric *
   addDecorate(const SPIRVDecorateGeneric *) override;
+  bool findIndexedDecorate(const SPIRVEntry *E, SPIRVWord MemberIndex,
+                           Decoration Kind,
+                           const SPIRVDecorateGeneric *&Dec) const override;
+  void invalidateDecorateIndex() override { DecorateIndexBuilt = false; }
+  void buildDecorateIndex();
   SPIRVDecorationGroup *addDecorationGroup() override;
   SPIRVDecorationGroup *
   addDecorationGroup(SPIRVDecorationGroup *Group) override;
@@ -343,6 +350,9 @@ public:
   friend std::istream &operator>>(std::istream &I, SPIRVModule &M);
 
 private:
+  // Owns the storage of the entries created while decoding. Declared first so
+  // that it outlives every member that may still release an entry.
+  SPIRVEntryArena Arena;
   SPIRVErrorLog ErrLog;
   SPIRVId NextId;
   SPIRVWord SPIRVVersion;
@@ -356,7 +366,9 @@ private:
   SPIRVAddressingModelKind AddrModel;
   SPIRVMemoryModelKind MemoryModel;
 
-  typedef std::map<SPIRVId, SPIRVEntry *> SPIRVIdToEntryMap;
+  // Ids are dense and bounded by the module header, so the id to entry map is
+  // a vector indexed by id. A null element means the id is not mapped.
+  typedef std::vector<SPIRVEntry *> SPIRVIdToEntryMap;
   typedef std::vector<SPIRVEntry *> SPIRVEntryVector;
   typedef std::set<SPIRVId> SPIRVIdSet;
   typedef std::vector<SPIRVId> SPIRVIdVec;
@@ -394,17 +406,28 @@ private:
   SPIRVStringMap StrMap;
   SPIRVCapMap CapMap;
   SPIRVUnknownStructFieldMap UnknownStructFieldMap;
-  std::map<unsigned, SPIRVTypeInt *> IntTypeMap;
-  std::map<unsigned, SPIRVConstant *> LiteralMap;
+  std::unordered_map<unsigned, SPIRVTypeInt *> IntTypeMap;
+  std::unordered_map<unsigned, SPIRVConstant *> LiteralMap;
   std::vector<SPIRVExtInst *> DebugInstVec;
 
+  // Index from (id << 32 | member, decoration kind) to the first such
+  // decoration, built once the module is decoded. Member is SPIRVWORD_MAX for
+  // decorations of the id itself.
+  typedef llvm::DenseMap<std::pair<uint64_t, unsigned>,
+                         const SPIRVDecorateGeneric *>
+      SPIRVDecorateIndex;
+  SPIRVDecorateIndex DecorateIndex;
+  bool DecorateIndexBuilt = false;
+
+  void setEntry(SPIRVId Id, SPIRVEntry *Entry);
+
   void layoutEntry(SPIRVEntry *Entry);
 };
 
 SPIRVModuleImpl::~SPIRVModuleImpl() {
 
   for (auto I : IdEntryMap)
-    delete I.second;
+    delete I;
 
   for (auto I : EntryNoId) {
     if (I->getOpCode() == OpLine)
@@ -557,7 +580,7 @@ SPIRVEntry *SPIRVModuleImpl::addEntry(SPIRVEntry *Entry) {
         assert(Mapped == Entry && "Id used twice");
       }
     } else
-      IdEntryMap[Id] = Entry;
+      setEntry(Id, Entry);
   } else {
     if (EntryNoId.empty() || Entry !=  EntryNoId.back())
       EntryNoId.push_back(Entry);
@@ -584,14 +607,21 @@ bool SPIRVModuleImpl::exist(SPIRVId Id) const { return exist(Id, nullptr); }
 
 bool SPIRVModuleImpl::exist(SPIRVId Id, SPIRVEntry **Entry) const {
   assert(Id != SPIRVID_INVALID && "Invalid Id");
-  SPIRVIdToEntryMap::const_iterator Loc = IdEntryMap.find(Id);
-  if (Loc == IdEntryMap.end())
+  if (Id >= IdEntryMap.size() || !IdEntryMap[Id])
     return false;
   if (Entry)
-    *Entry = Loc->second;
+    *Entry = IdEntryMap[Id];
   return true;
 }
 
+// Map the given id to the entry, growing the id table if the id is beyond the
+// current bound (ids allocated by getId() may exceed the header bound).
+void SPIRVModuleImpl::setEntry(SPIRVId Id, SPIRVEntry *Entry) {
+  if (Id >= IdEntryMap.size())
+    IdEntryMap.resize(std::max<size_t>(Id + 1, IdEntryMap.size() * 2));
+  IdEntryMap[Id] = Entry;
+}
+
 // If Id is invalid, returns the next available id.
 // Otherwise returns the given id and adjust the next available id by increment.
 SPIRVId SPIRVModuleImpl::getId(SPIRVId Id, unsigned Increment) {
@@ -605,9 +635,8 @@ SPIRVId SPIRVModuleImpl::getId(SPIRVId Id, unsigned Increment) {
 
 SPIRVEntry *SPIRVModuleImpl::getEntry(SPIRVId Id) const {
   assert(Id != SPIRVID_INVALID && "Invalid Id");
-  SPIRVIdToEntryMap::const_iterator Loc = IdEntryMap.find(Id);
-  assert(Loc != IdEntryMap.end() && "Id is not in map");
-  return Loc->second;
+  assert(Id < IdEntryMap.size() && IdEntryMap[Id] && "Id is not in map");
+  return IdEntryMap[Id];
 }
 
 SPIRVExtInstSetKind SPIRVModuleImpl::getBuiltinSet(SPIRVId SetId) const {
@@ -815,9 +844,46 @@ SPIRVModuleImpl::addDecorate(const SPIRVDecorateGeneric *Dec) {
   if (!Dec->getOwner())
     DecorateSet.insert(Dec);
   addCapabilities(Dec->getRequiredCapability());
+  invalidateDecorateIndex();
   return Dec;
 }
 
+// Builds the decoration index of all entries that are mapped by id, so that
+// decoration queries on them are a single hash lookup.
+void SPIRVModuleImpl::buildDecorateIndex() {
+  DecorateIndex.clear();
+  for (SPIRVId Id = 0; Id < IdEntryMap.size(); ++Id) {
+    const SPIRVEntry *E = IdEntryMap[Id];
+    if (!E)
+      continue;
+    E->forEachDecorate([&](SPIRVWord MemberIndex, Decoration Kind,
+                           const SPIRVDecorateGeneric *Dec) {
+      // Keep the first decoration of each kind, as hasDecorate() does.
+      DecorateIndex.insert(std::make_pair(
+          std::make_pair((static_cast<uint64_t>(Id) << 32) | MemberIndex,
+                         static_cast<unsigned>(Kind)),
+          Dec));
+    });
+  }
+  DecorateIndexBuilt = true;
+}
+
+bool SPIRVModuleImpl::findIndexedDecorate(
+    const SPIRVEntry *E, SPIRVWord MemberIndex, Decoration Kind,
+    const SPIRVDecorateGeneric *&Dec) const {
+  if (!DecorateIndexBuilt || !E->hasId())
+    return false;
+  SPIRVId Id = E->getId();
+  // Only the entry mapped by its id is in the index.
+  if (Id >= IdEntryMap.size() || IdEntryMap[Id] != E)
+    return false;
+  auto Loc = DecorateIndex.find(std::make_pair(
+      (static_cast<uint64_t>(Id) << 32) | MemberIndex,
+      static_cast<unsigned>(Kind)));
+  Dec = Loc != DecorateIndex.end() ? Loc->second : nullptr;
+  return true;
+}
+
 void SPIRVModuleImpl::addEntryPoint(SPIRVEntryPoint *EntryPoint) {
   assert(EntryPoint != nullptr && "Invalid entry point");
   assert(isValid(EntryPoint->getExecModel()) && "Invalid execution model");
@@ -838,13 +904,12 @@ SPIRVEntry *SPIRVModuleImpl::replaceForward(SPIRVForward *Forward,
   SPIRVId Id = Entry->getId();
   SPIRVId ForwardId = Forward->getId();
   if (ForwardId == Id)
-    IdEntryMap[Id] = Entry;
+    setEntry(Id, Entry);
   else {
-    auto Loc = IdEntryMap.find(Id);
-    assert(Loc != IdEntryMap.end());
-    IdEntryMap.erase(Loc);
+    assert(Id < IdEntryMap.size() && IdEntryMap[Id]);
+    IdEntryMap[Id] = nullptr;
     Entry->setId(ForwardId);
-    IdEntryMap[ForwardId] = Entry;
+    setEntry(ForwardId, Entry);
   }
   // Annotations include name, decorations, execution modes
   Entry->takeAnnotations(Forward);
@@ -863,9 +928,8 @@ void SPIRVModuleImpl::eraseInstruction(SPIRVInstruction *I,
                                        SPIRVBasicBlock *BB) {
   SPIRVId Id = I->getId();
   BB->eraseInstruction(I);
-  auto Loc = IdEntryMap.find(Id);
-  assert(Loc != IdEntryMap.end());
-  IdEntryMap.erase(Loc);
+  assert(Id < IdEntryMap.size() && IdEntryMap[Id]);
+  IdEntryMap[Id] = nullptr;
   delete I;
 }
 
@@ -1260,6 +1324,8 @@ void SPIRVModuleImpl::addUnknownStructField(SPIRVTypeStruct *Struct, unsigned I,
 std::istream &operator>>(std::istream &I, SPIRVModule &M) {
   SPIRVDecoder Decoder(I, M);
   SPIRVModuleImpl &MI = *static_cast<SPIRVModuleImpl *>(&M);
+  // Allocate all entries of the module from its arena.
+  SPIRVEntryArenaScope ArenaScope(MI.Arena);
   // Disable automatic capability filling.
   MI.setAutoAddCapability(false);
 
@@ -1277,6 +1343,10 @@ std::istream &operator>>(std::istream &I, SPIRVModule &M) {
 
   // Bound for Id
   Decoder >> MI.NextId;
+  // Size the id table from the bound up front. A bogus bound is clamped; the
+  // table still grows on demand as entries are added.
+  static const SPIRVId MaxPresizedIdBound = 1u << 22;
+  MI.IdEntryMap.resize(std::min(MI.NextId, MaxPresizedIdBound));
 
   Decoder >> MI.InstSchema;
   assert(MI.InstSchema == SPIRVISCH_Default &&
@@ -1288,6 +1358,7 @@ std::istream &operator>>(std::istream &I, SPIRVModule &M) {
   MI.optimizeDecorates();
   MI.resolveUnknownStructFields();
   MI.createForwardPointers();
+  MI.buildDecorateIndex();
   return I;
 }
 
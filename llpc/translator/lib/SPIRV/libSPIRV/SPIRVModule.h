@@ -181,6 +181,15 @@ public:
   virtual const std::shared_ptr<const SPIRVLine> &getCurrentLine() const = 0;
   virtual void setCurrentLine(const std::shared_ptr<const SPIRVLine> &) = 0;
   virtual const SPIRVDecorateGeneric *addDecorate(const SPIRVDecorateGeneric *) = 0;
+  // Look up the first decoration of Kind on entry E (or on its member
+  // MemberIndex if that is not SPIRVWORD_MAX) in the module's decoration
+  // index. Returns false if the index does not cover E, in which case the
+  // entry's own decoration maps must be searched; otherwise sets Dec to the
+  // decoration, or to nullptr if there is none.
+  virtual bool findIndexedDecorate(const SPIRVEntry *E, SPIRVWord MemberIndex,
+                                   Decoration Kind,
+                                   const SPIRVDecorateGeneric *&Dec) const = 0;
+  virtual void invalidateDecorateIndex() = 0;
   virtual SPIRVDecorationGroup *addDecorationGroup() = 0;
   virtual SPIRVDecorationGroup *
   addDecorationGroup(SPIRVDecorationGroup *Group) = 0;
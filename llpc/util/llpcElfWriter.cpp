@@ -180,6 +180,62 @@ void ElfWriter<Elf>::mergeMapItem(msgpack::MapDocNode &destMap, msgpack::MapDocN
   }
 }
 
+// =====================================================================================================================
+// The user data registers that can hold a relocatable descriptor table offset, with their counts.
+static const unsigned MmSpiShaderUserDataVs0 = 0x2C4C;
+static const unsigned MmSpiShaderUserDataPs0 = 0x2c0c;
+static const unsigned MmComputeUserData0 = 0x2E40;
+
+// =====================================================================================================================
+// Gets the user data offset of the descriptor table that a user data register value refers to, if the value is a
+// relocatable descriptor table reference (DescRelocMagic | set).
+//
+// Returns true and sets the offset if the value is such a reference that the pipeline resolves.
+//
+// @param context : context related to ElfNote
+// @param baseRegister : First user data register of the stage
+// @param regValue : Value of the register
+// @param [out] offset : User data offset of the descriptor table
+static bool getRootDescriptorOffset(Context *context, unsigned baseRegister, unsigned regValue, unsigned *offset) {
+  if (DescRelocMagic != (regValue & DescRelocMagicMask))
+    return false;
+
+  const PipelineShaderInfo *shaderInfo = nullptr;
+  if (baseRegister == MmComputeUserData0) {
+    auto pipelineInfo = reinterpret_cast<const ComputePipelineBuildInfo *>(context->getPipelineBuildInfo());
+    shaderInfo = &pipelineInfo->cs;
+  } else {
+    auto pipelineInfo = reinterpret_cast<const GraphicsPipelineBuildInfo *>(context->getPipelineBuildInfo());
+    shaderInfo = baseRegister == MmSpiShaderUserDataVs0 ? &pipelineInfo->vs : &pipelineInfo->fs;
+  }
+  unsigned set = regValue & DescSetMask;
+  for (unsigned j = 0; j < shaderInfo->userDataNodeCount; ++j) {
+    if (shaderInfo->pUserDataNodes[j].type == ResourceMappingNodeType::DescriptorTableVaPtr &&
+        set == shaderInfo->pUserDataNodes[j].tablePtr.pNext[0].srdRange.set) {
+      *offset = shaderInfo->pUserDataNodes[j].offsetInDwords;
+      return true;
+    }
+  }
+  return false;
+}
+
+// =====================================================================================================================
+// Gets the first user data register of the stage that a register belongs to, or 0 if it is not a user data register
+// that can hold a relocatable descriptor table reference.
+//
+// @param context : context related to ElfNote
+// @param regNumber : Register number
+static unsigned getUserDataBaseRegister(Context *context, unsigned regNumber) {
+  const unsigned vsPsUserDataCount = context->getGfxIpVersion().major < 9 ? 16 : 32;
+  if (regNumber >= MmSpiShaderUserDataVs0 && regNumber < MmSpiShaderUserDataVs0 + vsPsUserDataCount)
+    return MmSpiShaderUserDataVs0;
+  if (regNumber >= MmSpiShaderUserDataPs0 && regNumber < MmSpiShaderUserDataPs0 + vsPsUserDataCount)
+    return MmSpiShaderUserDataPs0;
+  if (regNumber >= MmComputeUserData0 && regNumber < MmComputeUserData0 + 16)
+    return MmComputeUserData0;
+  return 0;
+}
+
 // =====================================================================================================================
 // Update descriptor offset to USER_DATA in metaNote, in place in the messagepack document.
 //
@@ -188,50 +244,306 @@ void ElfWriter<Elf>::mergeMapItem(msgpack::MapDocNode &destMap, msgpack::MapDocN
 static void updateRootDescriptorRegisters(Context *context, msgpack::Document &document) {
   auto pipeline = document.getRoot().getMap(true)[Util::Abi::PalCodeObjectMetadataKey::Pipelines].getArray(true)[0];
   auto registers = pipeline.getMap(true)[Util::Abi::PipelineMetadataKey::Registers].getMap(true);
-  const unsigned mmSpiShaderUserDataVs0 = 0x2C4C;
-  const unsigned mmSpiShaderUserDataPs0 = 0x2c0c;
-  const unsigned mmComputeUserData0 = 0x2E40;
-  unsigned userDataBaseRegisters[] = {mmSpiShaderUserDataVs0, mmSpiShaderUserDataPs0, mmComputeUserData0};
-  const unsigned vsPsUserDataCount = context->getGfxIpVersion().major < 9 ? 16 : 32;
-  unsigned userDataCount[] = {vsPsUserDataCount, vsPsUserDataCount, 16};
-  for (auto stage = 0; stage < sizeof(userDataBaseRegisters) / sizeof(unsigned); ++stage) {
-    unsigned baseRegister = userDataBaseRegisters[stage];
-    unsigned registerCount = userDataCount[stage];
-    for (unsigned i = 0; i < registerCount; ++i) {
-      unsigned key = baseRegister + i;
-      auto keyNode = registers.getDocument()->getNode(key);
-      auto keyIt = registers.find(keyNode);
-      if (keyIt != registers.end()) {
-        assert(keyIt->first.getUInt() == key);
-        // Reloc Descriptor user data value is consisted by DescRelocMagic | set.
-        unsigned regValue = keyIt->second.getUInt();
-        if (DescRelocMagic == (regValue & DescRelocMagicMask)) {
-          const PipelineShaderInfo *shaderInfo = nullptr;
-          if (baseRegister == mmComputeUserData0) {
-            auto pipelineInfo = reinterpret_cast<const ComputePipelineBuildInfo *>(context->getPipelineBuildInfo());
-            shaderInfo = &pipelineInfo->cs;
-          } else {
-            auto pipelineInfo = reinterpret_cast<const GraphicsPipelineBuildInfo *>(context->getPipelineBuildInfo());
-            shaderInfo = baseRegister == mmSpiShaderUserDataVs0 ? &pipelineInfo->vs : &pipelineInfo->fs;
-          }
-          unsigned set = regValue & DescSetMask;
-          for (unsigned j = 0; j < shaderInfo->userDataNodeCount; ++j) {
-            if (shaderInfo->pUserDataNodes[j].type == ResourceMappingNodeType::DescriptorTableVaPtr &&
-                set == shaderInfo->pUserDataNodes[j].tablePtr.pNext[0].srdRange.set) {
-              // If it's descriptor user data, then update its offset to it.
-              unsigned value = shaderInfo->pUserDataNodes[j].offsetInDwords;
-              keyIt->second = registers.getDocument()->getNode(value);
-              // Update userDataLimit if neccessary
-              unsigned userDataLimit = pipeline.getMap(true)[Util::Abi::PipelineMetadataKey::UserDataLimit].getUInt();
-              pipeline.getMap(true)[Util::Abi::PipelineMetadataKey::UserDataLimit] =
-                  document.getNode(std::max(userDataLimit, value + 1));
-              break;
-            }
-          }
-        }
-      }
+  for (auto &entry : registers) {
+    unsigned baseRegister = getUserDataBaseRegister(context, entry.first.getUInt());
+    unsigned value = 0;
+    if (baseRegister == 0 || !getRootDescriptorOffset(context, baseRegister, entry.second.getUInt(), &value))
+      continue;
+    // If it's descriptor user data, then update its offset to it.
+    entry.second = registers.getDocument()->getNode(value);
+    // Update userDataLimit if neccessary
+    unsigned userDataLimit = pipeline.getMap(true)[Util::Abi::PipelineMetadataKey::UserDataLimit].getUInt();
+    pipeline.getMap(true)[Util::Abi::PipelineMetadataKey::UserDataLimit] =
+        document.getNode(std::max(userDataLimit, value + 1));
+  }
+}
+
+// =====================================================================================================================
+// A minimal reader of an encoded MessagePack blob, used to patch values in place without decoding the blob into a
+// msgpack::Document and encoding it again.
+class MsgPackCursor {
+public:
+  MsgPackCursor(uint8_t *data, size_t size) : m_pos(data), m_end(data + size) {}
+
+  // Gets the current position.
+  uint8_t *getPos() const { return m_pos; }
+
+  // Reads a map or array header, returning false if the next object is not one of that kind.
+  bool readMapHeader(unsigned *count) { return readContainerHeader(0x80, 0xDE, count); }
+  bool readArrayHeader(unsigned *count) { return readContainerHeader(0x90, 0xDC, count); }
+
+  // Reads a string, returning false if the next object is not a string.
+  bool readString(StringRef *str) {
+    if (m_pos >= m_end)
+      return false;
+    uint8_t tag = *m_pos;
+    size_t headerSize = 0;
+    uint64_t length = 0;
+    if ((tag & 0xE0) == 0xA0) {
+      headerSize = 1;
+      length = tag & 0x1F;
+    } else if (tag >= 0xD9 && tag <= 0xDB) {
+      headerSize = 1 + (1 << (tag - 0xD9));
+      if (!readBigEndian(m_pos + 1, headerSize - 1, &length))
+        return false;
+    } else
+      return false;
+    if (static_cast<uint64_t>(m_end - m_pos) < headerSize + length)
+      return false;
+    *str = StringRef(reinterpret_cast<const char *>(m_pos + headerSize), length);
+    m_pos += headerSize + length;
+    return true;
+  }
+
+  // Reads an unsigned integer, returning false if the next object is not one. Also returns the position and encoded
+  // size of the integer, for writeUInt().
+  bool readUInt(uint64_t *value, uint8_t **valuePos = nullptr, size_t *valueSize = nullptr) {
+    if (m_pos >= m_end)
+      return false;
+    uint8_t tag = *m_pos;
+    size_t size = 0;
+    if (tag < 0x80) {
+      size = 1;
+      *value = tag;
+    } else if (tag >= 0xCC && tag <= 0xCF) {
+      size = 1 + (1 << (tag - 0xCC));
+      if (!readBigEndian(m_pos + 1, size - 1, value))
+        return false;
+    } else
+      return false;
+    if (valuePos)
+      *valuePos = m_pos;
+    if (valueSize)
+      *valueSize = size;
+    m_pos += size;
+    return true;
+  }
+
+  // Skips one object, including the contents of maps and arrays.
+  bool skip() {
+    if (m_pos >= m_end)
+      return false;
+    uint8_t tag = *m_pos;
+    if (tag < 0x80 || tag >= 0xE0 || tag == 0xC0 || tag == 0xC2 || tag == 0xC3)
+      return advance(1);
+    if ((tag & 0xF0) == 0x80 || tag == 0xDE || tag == 0xDF) {
+      unsigned count = 0;
+      return readMapHeader(&count) && skipObjects(uint64_t(count) * 2);
+    }
+    if ((tag & 0xF0) == 0x90 || tag == 0xDC || tag == 0xDD) {
+      unsigned count = 0;
+      return readArrayHeader(&count) && skipObjects(count);
+    }
+    StringRef str;
+    if ((tag & 0xE0) == 0xA0 || (tag >= 0xD9 && tag <= 0xDB))
+      return readString(&str);
+    uint64_t length = 0;
+    switch (tag) {
+    case 0xC4: // bin 8/16/32
+    case 0xC5:
+    case 0xC6:
+      return readBigEndian(m_pos + 1, 1 << (tag - 0xC4), &length) && advance(1 + (1 << (tag - 0xC4)) + length);
+    case 0xC7: // ext 8/16/32
+    case 0xC8:
+    case 0xC9:
+      return readBigEndian(m_pos + 1, 1 << (tag - 0xC7), &length) && advance(2 + (1 << (tag - 0xC7)) + length);
+    case 0xCA: // float 32
+    case 0xCE: // uint 32
+    case 0xD2: // int 32
+      return advance(5);
+    case 0xCB: // float 64
+    case 0xCF: // uint 64
+    case 0xD3: // int 64
+      return advance(9);
+    case 0xCC: // uint 8
+    case 0xD0: // int 8
+      return advance(2);
+    case 0xCD: // uint 16
+    case 0xD1: // int 16
+      return advance(3);
+    case 0xD4: // fixext 1/2/4/8/16
+    case 0xD5:
+    case 0xD6:
+    case 0xD7:
+    case 0xD8:
+      return advance(2 + (1 << (tag - 0xD4)));
+    default:
+      return false;
+    }
+  }
+
+  // Finds the value of the entry with the given string key in a map that has just had its header read, leaving the
+  // cursor at the value. Returns false if there is no such entry, leaving the cursor undefined.
+  bool findMapValue(unsigned count, StringRef key) {
+    for (unsigned i = 0; i < count; ++i) {
+      StringRef entryKey;
+      if (readString(&entryKey) && entryKey == key)
+        return true;
+      if (!skip())
+        return false;
+    }
+    return false;
+  }
+
+  // Rewrites an unsigned integer read by readUInt() in place, in the same encoded size. Returns false if the value
+  // does not fit in that size.
+  static bool writeUInt(uint8_t *valuePos, size_t valueSize, uint64_t value) {
+    if (valueSize == 1) {
+      if (value >= 0x80)
+        return false;
+      *valuePos = static_cast<uint8_t>(value);
+      return true;
+    }
+    unsigned byteCount = valueSize - 1;
+    if (byteCount < 8 && (value >> (byteCount * 8)) != 0)
+      return false;
+    for (unsigned i = 0; i < byteCount; ++i)
+      valuePos[valueSize - 1 - i] = static_cast<uint8_t>(value >> (i * 8));
+    return true;
+  }
+
+private:
+  bool advance(uint64_t size) {
+    if (static_cast<uint64_t>(m_end - m_pos) < size)
+      return false;
+    m_pos += size;
+    return true;
+  }
+
+  bool skipObjects(uint64_t count) {
+    for (uint64_t i = 0; i < count; ++i) {
+      if (!skip())
+        return false;
     }
+    return true;
+  }
+
+  bool readBigEndian(const uint8_t *pos, size_t size, uint64_t *value) const {
+    if (pos + size > m_end)
+      return false;
+    *value = 0;
+    for (size_t i = 0; i < size; ++i)
+      *value = (*value << 8) | pos[i];
+    return true;
+  }
+
+  bool readContainerHeader(uint8_t fixTag, uint8_t tag16, unsigned *count) {
+    if (m_pos >= m_end)
+      return false;
+    uint8_t tag = *m_pos;
+    uint64_t value = 0;
+    if ((tag & 0xF0) == fixTag) {
+      *count = tag & 0x0F;
+      return advance(1);
+    }
+    if (tag == tag16 || tag == tag16 + 1) {
+      size_t size = tag == tag16 ? 2 : 4;
+      if (!readBigEndian(m_pos + 1, size, &value))
+        return false;
+      *count = static_cast<unsigned>(value);
+      return advance(1 + size);
+    }
+    return false;
+  }
+
+  uint8_t *m_pos;       // Current position
+  uint8_t *const m_end; // End of the blob
+};
+
+// =====================================================================================================================
+// Update descriptor offset to USER_DATA in metaNote, patching the encoded messagepack blob in place. This is much
+// cheaper than the round trip through msgpack::Document, as it only rewrites the fixed-size register values.
+//
+// Returns false if the blob cannot be patched in place (a value does not fit in the encoding of the old one, or the
+// metadata does not have the expected layout), in which case the blob may have been partially patched.
+//
+// @param context : context related to ElfNote
+// @param [in,out] blob : Encoded message pack blob of the metadata note
+// @param blobSize : Byte size of the blob
+static bool updateRootDescriptorRegistersInPlace(Context *context, uint8_t *blob, size_t blobSize) {
+  MsgPackCursor cursor(blob, blobSize);
+  unsigned count = 0;
+  if (!cursor.readMapHeader(&count) || !cursor.findMapValue(count, Util::Abi::PalCodeObjectMetadataKey::Pipelines) ||
+      !cursor.readArrayHeader(&count) || count == 0 || !cursor.readMapHeader(&count))
+    return false;
+
+  // Find .registers and .user_data_limit in the pipeline map.
+  unsigned pipelineCount = count;
+  uint8_t *registersPos = nullptr;
+  uint8_t *userDataLimitPos = nullptr;
+  size_t userDataLimitSize = 0;
+  uint64_t userDataLimit = 0;
+  for (unsigned i = 0; i < pipelineCount; ++i) {
+    StringRef key;
+    if (!cursor.readString(&key))
+      return false;
+    if (key == Util::Abi::PipelineMetadataKey::Registers) {
+      registersPos = cursor.getPos();
+      if (!cursor.skip())
+        return false;
+    } else if (key == Util::Abi::PipelineMetadataKey::UserDataLimit) {
+      if (!cursor.readUInt(&userDataLimit, &userDataLimitPos, &userDataLimitSize))
+        return false;
+    } else if (!cursor.skip())
+      return false;
   }
+  if (!registersPos)
+    return false;
+
+  MsgPackCursor registers(registersPos, blob + blobSize - registersPos);
+  if (!registers.readMapHeader(&count))
+    return false;
+  uint64_t newUserDataLimit = userDataLimit;
+  for (unsigned i = 0; i < count; ++i) {
+    uint64_t regNumber = 0;
+    uint64_t regValue = 0;
+    uint8_t *valuePos = nullptr;
+    size_t valueSize = 0;
+    if (!registers.readUInt(&regNumber) || !registers.readUInt(&regValue, &valuePos, &valueSize))
+      return false;
+    unsigned baseRegister = getUserDataBaseRegister(context, regNumber);
+    unsigned value = 0;
+    if (baseRegister == 0 || !getRootDescriptorOffset(context, baseRegister, regValue, &value))
+      continue;
+    if (!MsgPackCursor::writeUInt(valuePos, valueSize, value))
+      return false;
+    newUserDataLimit = std::max<uint64_t>(newUserDataLimit, value + 1);
+  }
+
+  if (newUserDataLimit != userDataLimit &&
+      (!userDataLimitPos || !MsgPackCursor::writeUInt(userDataLimitPos, userDataLimitSize, newUserDataLimit)))
+    return false;
+  return true;
+}
+
+// =====================================================================================================================
+// Finds a register in the .registers map of an encoded PAL metadata blob, returning its value and the position and
+// encoded size of the value for MsgPackCursor::writeUInt().
+//
+// Returns false if the register is not set, or the metadata does not have the expected layout.
+//
+// @param blob : Encoded message pack blob of the metadata note
+// @param blobSize : Byte size of the blob
+// @param regNumber : Register number
+// @param [out] value : Value of the register
+// @param [out] valuePos : Position of the encoded value
+// @param [out] valueSize : Encoded size of the value
+static bool findRegisterInPlace(uint8_t *blob, size_t blobSize, unsigned regNumber, uint64_t *value,
+                                uint8_t **valuePos, size_t *valueSize) {
+  MsgPackCursor cursor(blob, blobSize);
+  unsigned count = 0;
+  if (!cursor.readMapHeader(&count) || !cursor.findMapValue(count, Util::Abi::PalCodeObjectMetadataKey::Pipelines) ||
+      !cursor.readArrayHeader(&count) || count == 0 || !cursor.readMapHeader(&count) ||
+      !cursor.findMapValue(count, Util::Abi::PipelineMetadataKey::Registers) || !cursor.readMapHeader(&count))
+    return false;
+  for (unsigned i = 0; i < count; ++i) {
+    uint64_t entryRegNumber = 0;
+    if (!cursor.readUInt(&entryRegNumber) || !cursor.readUInt(value, valuePos, valueSize))
+      return false;
+    if (entryRegNumber == regNumber)
+      return true;
+  }
+  return false;
 }
 
 // =====================================================================================================================
@@ -716,6 +1028,16 @@ Result ElfWriter<Elf>::getSectionDataBySectionIndex(unsigned secIdx, const Secti
 // @param pNote : Note section to update
 // @param [out] pNewNote : new note section
 template <class Elf> void ElfWriter<Elf>::updateMetaNote(Context *pContext, const ElfNote *pNote, ElfNote *pNewNote) {
+  // Patch a copy of the blob in place if we can; only fall back to a full document round trip if we cannot.
+  auto patchedData = new uint8_t[pNote->hdr.descSize];
+  memcpy(patchedData, pNote->data, pNote->hdr.descSize);
+  if (updateRootDescriptorRegistersInPlace(pContext, patchedData, pNote->hdr.descSize)) {
+    *pNewNote = *pNote;
+    pNewNote->data = patchedData;
+    return;
+  }
+  delete[] patchedData;
+
   msgpack::Document document;
 
   auto success =
@@ -788,13 +1110,50 @@ template <class Elf> void ElfWriter<Elf>::updateElfBinary(Context *pContext, Elf
 }
 
 // =====================================================================================================================
-// Merge ELF binary of fragment shader and ELF binary of non-fragment shaders into single ELF binary
+// Represents the header of the pre-split form of a fragment ELF part, which is followed by the symbols (value and
+// size), the null-terminated symbol names, the ISA, the disassembly, the LLVM IR and the PAL metadata, each padded to
+// a multiple of 4 bytes.
+struct FragmentElfPartHeader {
+  uint32_t magic;           // Must be FragmentElfPartMagic
+  uint32_t flags;           // FragmentElfPartHasDisassembly and FragmentElfPartHasLlvmIr
+  uint32_t symbolCount;     // Number of symbols
+  uint32_t symbolNamesSize; // Byte size of the symbol names
+  uint32_t textSize;        // Byte size of the ISA
+  uint32_t disassemblySize; // Byte size of the disassembly
+  uint32_t llvmIrSize;      // Byte size of the LLVM IR
+  uint32_t metadataSize;    // Byte size of the PAL metadata
+};
+
+// Represents a symbol in the pre-split form of a fragment ELF part.
+struct FragmentElfPartSymbol {
+  uint64_t value;      // Offset from the start of the fragment shader ISA
+  uint64_t size;       // Size of the symbol
+  uint32_t nameOffset; // Offset of the name in the symbol names
+  uint32_t reserved;   // Padding
+};
+
+static const uint32_t FragmentElfPartMagic = 0x46504C4C; // "LLPF"
+static const uint32_t FragmentElfPartHasDisassembly = 0x1;
+static const uint32_t FragmentElfPartHasLlvmIr = 0x2;
+
+// =====================================================================================================================
+// Gets the contents of a text section from the start of the given fragment shader symbol name, or the whole section
+// if the name is not found.
 //
-// @param pContext : Pipeline context
-// @param pFragmentElf : ELF binary of fragment shader
-// @param [out] pPipelineElf : Final ELF binary
-template <class Elf>
-void ElfWriter<Elf>::mergeElfBinary(Context *pContext, const BinaryData *pFragmentElf, ElfPackage *pPipelineElf) {
+// @param section : Text section
+// @param symbolName : Name of the fragment shader entry
+static StringRef getFragmentText(const ElfSectionBuffer<Elf64::SectionHeader> *section, const char *symbolName) {
+  StringRef text(reinterpret_cast<const char *>(section->data), section->secHead.sh_size);
+  size_t offset = text.find(symbolName);
+  return offset == StringRef::npos ? text : text.drop_front(offset);
+}
+
+// =====================================================================================================================
+// Extracts the fragment half from the ELF binary of a fragment shader.
+//
+// @param reader : Reader of the fragment ELF; the part refers to its contents
+// @param [out] part : Fragment half
+template <class Elf> void ElfWriter<Elf>::extractFragmentElfPart(ElfReader<Elf> &reader, FragmentElfPart *part) {
   auto fragmentIsaSymbolName =
       Util::Abi::PipelineAbiSymbolNameStrings[static_cast<unsigned>(Util::Abi::PipelineSymbolType::PsMainEntry)];
   auto fragmentIntrlTblSymbolName =
@@ -806,28 +1165,224 @@ void ElfWriter<Elf>::mergeElfBinary(Context *pContext, const BinaryData *pFragme
   auto fragmentAmdIlSymbolName =
       Util::Abi::PipelineAbiSymbolNameStrings[static_cast<unsigned>(Util::Abi::PipelineSymbolType::PsAmdIl)];
 
-  ElfReader<Elf64> reader(m_gfxIp);
+  *part = {};
+
+  // GPU ISA code and its symbols, from _amdgpu_ps_main on
+  ElfSectionBuffer<Elf64::SectionHeader> *fragmentTextSection = nullptr;
+  std::vector<ElfSymbol> fragmentSymbols;
+  auto fragmentTextSecIndex = reader.GetSectionIndex(TextName);
+  reader.getSectionDataBySectionIndex(fragmentTextSecIndex, &fragmentTextSection);
+  reader.GetSymbolsBySectionIndex(fragmentTextSecIndex, fragmentSymbols);
+
+  const ElfSymbol *fragmentIsaSymbol = nullptr;
+  for (auto &fragmentSymbol : fragmentSymbols) {
+    if (strcmp(fragmentSymbol.pSymName, fragmentIsaSymbolName) == 0) {
+      fragmentIsaSymbol = &fragmentSymbol;
+      part->text = fragmentTextSection->data + fragmentIsaSymbol->value;
+      part->textSize = fragmentTextSection->secHead.sh_size - fragmentIsaSymbol->value;
+    }
+
+    if (!fragmentIsaSymbol)
+      continue;
+
+    // Constant data of the non-fragment stages stays with the ELF it is merged into.
+    if (strncmp(fragmentSymbol.pSymName, lgc::NonFragmentConstantPrefix, strlen(lgc::NonFragmentConstantPrefix)) == 0)
+      continue;
+
+    part->symbols.push_back({fragmentSymbol.pSymName, fragmentSymbol.value - fragmentIsaSymbol->value,
+                             fragmentSymbol.size});
+  }
+
+  // LLPC doesn't use per pipeline internal table, and LLVM backend doesn't add symbols for disassembly info.
+  assert(reader.isValidSymbol(fragmentIntrlTblSymbolName) == false &&
+         reader.isValidSymbol(fragmentDisassemblySymbolName) == false &&
+         reader.isValidSymbol(fragmentIntrlDataSymbolName) == false &&
+         reader.isValidSymbol(fragmentAmdIlSymbolName) == false);
+  (void(fragmentIntrlTblSymbolName));    // unused
+  (void(fragmentDisassemblySymbolName)); // unused
+  (void(fragmentIntrlDataSymbolName));   // unused
+  (void(fragmentAmdIlSymbolName));       // unused
+
+  // ISA disassemble
+  ElfSectionBuffer<Elf64::SectionHeader> *fragmentDisassemblySection = nullptr;
+  reader.getSectionDataBySectionIndex(reader.GetSectionIndex(Util::Abi::AmdGpuDisassemblyName),
+                                      &fragmentDisassemblySection);
+  if (fragmentDisassemblySection) {
+    part->hasDisassembly = true;
+    part->disassembly = getFragmentText(fragmentDisassemblySection, fragmentIsaSymbolName);
+  }
+
+  // LLVM IR disassemble
+  ElfSectionBuffer<Elf64::SectionHeader> *fragmentLlvmIrSection = nullptr;
+  reader.getSectionDataBySectionIndex(reader.GetSectionIndex(Util::Abi::AmdGpuCommentLlvmIrName),
+                                      &fragmentLlvmIrSection);
+  if (fragmentLlvmIrSection) {
+    part->hasLlvmIr = true;
+    part->llvmIr = getFragmentText(fragmentLlvmIrSection, fragmentIsaSymbolName);
+  }
+
+  // PAL metadata
+  ElfNote fragmentMetaNote = reader.getNote(Util::Abi::PipelineAbiNoteType::PalMetadata);
+  part->metadata = fragmentMetaNote.data;
+  part->metadataSize = fragmentMetaNote.hdr.descSize;
+}
+
+// =====================================================================================================================
+// Reads the fragment half from its pre-split form, as written by splitFragmentElf().
+//
+// Returns false if the binary is not in the pre-split form, for example because it is the full ELF of a fragment
+// shader.
+//
+// @param fragmentPartBin : Pre-split fragment half; the part refers to its contents
+// @param [out] part : Fragment half
+template <class Elf>
+bool ElfWriter<Elf>::readFragmentElfPart(const BinaryData *fragmentPartBin, FragmentElfPart *part) {
+  if (fragmentPartBin->codeSize < sizeof(FragmentElfPartHeader))
+    return false;
+
+  auto header = reinterpret_cast<const FragmentElfPartHeader *>(fragmentPartBin->pCode);
+  if (header->magic != FragmentElfPartMagic)
+    return false;
+
+  auto data = reinterpret_cast<const uint8_t *>(header + 1);
+  auto symbols = reinterpret_cast<const FragmentElfPartSymbol *>(data);
+  data += sizeof(FragmentElfPartSymbol) * header->symbolCount;
+  auto symbolNames = reinterpret_cast<const char *>(data);
+  data += alignTo(header->symbolNamesSize, sizeof(unsigned));
+
+  *part = {};
+  for (unsigned i = 0; i < header->symbolCount; ++i)
+    part->symbols.push_back({symbolNames + symbols[i].nameOffset, symbols[i].value, symbols[i].size});
+
+  part->text = data;
+  part->textSize = header->textSize;
+  data += alignTo(header->textSize, sizeof(unsigned));
+  part->hasDisassembly = (header->flags & FragmentElfPartHasDisassembly) != 0;
+  part->disassembly = StringRef(reinterpret_cast<const char *>(data), header->disassemblySize);
+  data += alignTo(header->disassemblySize, sizeof(unsigned));
+  part->hasLlvmIr = (header->flags & FragmentElfPartHasLlvmIr) != 0;
+  part->llvmIr = StringRef(reinterpret_cast<const char *>(data), header->llvmIrSize);
+  data += alignTo(header->llvmIrSize, sizeof(unsigned));
+  part->metadata = data;
+  part->metadataSize = header->metadataSize;
+  data += alignTo(header->metadataSize, sizeof(unsigned));
+
+  assert(data <= reinterpret_cast<const uint8_t *>(fragmentPartBin->pCode) + fragmentPartBin->codeSize);
+  return true;
+}
+
+// =====================================================================================================================
+// Splits the fragment half out of a pipeline ELF, in the form that is stored in the shader caches for the fragment
+// shader. Merging it on a later cache hit then copies its pieces without parsing an ELF.
+//
+// @param gfxIp : Graphics IP version info
+// @param pipelineElf : Pipeline ELF containing the fragment shader
+// @param [out] fragmentPart : Pre-split fragment half
+template <class Elf>
+void ElfWriter<Elf>::splitFragmentElf(GfxIpVersion gfxIp, const BinaryData *pipelineElf, ElfPackage *fragmentPart) {
+  ElfReader<Elf> reader(gfxIp);
+  size_t codeSize = pipelineElf->codeSize;
+  auto result = reader.ReadFromBuffer(pipelineElf->pCode, &codeSize);
+  assert(result == Result::Success);
+  (void(result)); // unused
+
+  FragmentElfPart part = {};
+  extractFragmentElfPart(reader, &part);
+
+  FragmentElfPartHeader header = {};
+  header.magic = FragmentElfPartMagic;
+  header.flags = (part.hasDisassembly ? FragmentElfPartHasDisassembly : 0) |
+                 (part.hasLlvmIr ? FragmentElfPartHasLlvmIr : 0);
+  header.symbolCount = part.symbols.size();
+  std::vector<FragmentElfPartSymbol> symbols;
+  std::string symbolNames;
+  for (const auto &symbol : part.symbols) {
+    symbols.push_back({symbol.value, symbol.size, static_cast<uint32_t>(symbolNames.size()), 0});
+    symbolNames += symbol.name;
+    symbolNames += '\0';
+  }
+  header.symbolNamesSize = symbolNames.size();
+  header.textSize = part.textSize;
+  header.disassemblySize = part.disassembly.size();
+  header.llvmIrSize = part.llvmIr.size();
+  header.metadataSize = part.metadataSize;
+
+  size_t totalSize = sizeof(header) + sizeof(FragmentElfPartSymbol) * symbols.size() +
+                     alignTo(header.symbolNamesSize, sizeof(unsigned)) + alignTo(header.textSize, sizeof(unsigned)) +
+                     alignTo(header.disassemblySize, sizeof(unsigned)) + alignTo(header.llvmIrSize, sizeof(unsigned)) +
+                     alignTo(header.metadataSize, sizeof(unsigned));
+  fragmentPart->resize(totalSize);
+  memset(fragmentPart->data(), 0, totalSize);
+
+  auto data = reinterpret_cast<uint8_t *>(fragmentPart->data());
+  auto append = [&data](const void *src, size_t size) {
+    if (size > 0)
+      memcpy(data, src, size);
+    data += alignTo(size, sizeof(unsigned));
+  };
+  memcpy(data, &header, sizeof(header));
+  data += sizeof(header);
+  append(symbols.data(), sizeof(FragmentElfPartSymbol) * symbols.size());
+  append(symbolNames.data(), symbolNames.size());
+  append(part.text, part.textSize);
+  append(part.disassembly.data(), part.disassembly.size());
+  append(part.llvmIr.data(), part.llvmIr.size());
+  append(part.metadata, part.metadataSize);
+  assert(data == reinterpret_cast<uint8_t *>(fragmentPart->data()) + totalSize);
+}
+
+// =====================================================================================================================
+// Merge ELF binary of fragment shader and ELF binary of non-fragment shaders into single ELF binary
+//
+// @param pContext : Pipeline context
+// @param pFragmentElf : ELF binary of fragment shader, or its pre-split form from splitFragmentElf()
+// @param [out] pPipelineElf : Final ELF binary
+template <class Elf>
+void ElfWriter<Elf>::mergeElfBinary(Context *pContext, const BinaryData *pFragmentElf, ElfPackage *pPipelineElf) {
+  FragmentElfPart part = {};
+  if (readFragmentElfPart(pFragmentElf, &part)) {
+    mergeFragmentElfPart(pContext, part, pPipelineElf);
+    return;
+  }
 
+  ElfReader<Elf64> reader(m_gfxIp);
   auto fragmentCodesize = pFragmentElf->codeSize;
   auto result = reader.ReadFromBuffer(pFragmentElf->pCode, &fragmentCodesize);
   assert(result == Result::Success);
   (void(result)); // unused
 
+  extractFragmentElfPart(reader, &part);
+  mergeFragmentElfPart(pContext, part, pPipelineElf);
+}
+
+// =====================================================================================================================
+// Merge the fragment half of a pipeline into this ELF binary of non-fragment shaders, and write the merged ELF.
+//
+// @param pContext : Pipeline context
+// @param part : Fragment half
+// @param [out] pPipelineElf : Final ELF binary
+template <class Elf>
+void ElfWriter<Elf>::mergeFragmentElfPart(Context *pContext, const FragmentElfPart &part, ElfPackage *pPipelineElf) {
+  auto fragmentIsaSymbolName =
+      Util::Abi::PipelineAbiSymbolNameStrings[static_cast<unsigned>(Util::Abi::PipelineSymbolType::PsMainEntry)];
+
+  // Wraps a piece of the fragment half as the section to merge from.
+  auto getFragmentSection = [](const void *data, size_t size) {
+    ElfSectionBuffer<Elf64::SectionHeader> section = {};
+    section.data = reinterpret_cast<const uint8_t *>(data);
+    section.secHead.sh_size = size;
+    return section;
+  };
+
   // Merge GPU ISA code
   const ElfSectionBuffer<Elf64::SectionHeader> *nonFragmentTextSection = nullptr;
-  ElfSectionBuffer<Elf64::SectionHeader> *fragmentTextSection = nullptr;
-  std::vector<ElfSymbol> fragmentSymbols;
   std::vector<ElfSymbol *> nonFragmentSymbols;
 
-  auto fragmentTextSecIndex = reader.GetSectionIndex(TextName);
   auto nonFragmentSecIndex = GetSectionIndex(TextName);
-  reader.getSectionDataBySectionIndex(fragmentTextSecIndex, &fragmentTextSection);
-  reader.GetSymbolsBySectionIndex(fragmentTextSecIndex, fragmentSymbols);
-
   getSectionDataBySectionIndex(nonFragmentSecIndex, &nonFragmentTextSection);
   GetSymbolsBySectionIndex(nonFragmentSecIndex, nonFragmentSymbols);
-  ElfSymbol *fragmentIsaSymbol = nullptr;
   ElfSymbol *nonFragmentIsaSymbol = nullptr;
+  bool keepNonFragmentText = false;
   std::string firstIsaSymbolName;
 
   for (auto symbol : nonFragmentSymbols) {
@@ -844,113 +1399,72 @@ void ElfWriter<Elf>::mergeElfBinary(Context *pContext, const BinaryData *pFragme
     if (!nonFragmentIsaSymbol)
       continue;
 
+    // Constant data that the non-fragment stages read follows _amdgpu_ps_main and is addressed relative to their
+    // code, so the whole of the non-fragment text is kept, and the fragment half is appended after it.
+    if (strncmp(symbol->pSymName, lgc::NonFragmentConstantPrefix, strlen(lgc::NonFragmentConstantPrefix)) == 0) {
+      keepNonFragmentText = true;
+      continue;
+    }
+
     // Reset all symbols after _amdgpu_ps_main
     symbol->secIdx = InvalidValue;
   }
 
-  size_t isaOffset =
-      !nonFragmentIsaSymbol ? alignTo(nonFragmentTextSection->secHead.sh_size, 0x100) : nonFragmentIsaSymbol->value;
-  for (auto &fragmentSymbol : fragmentSymbols) {
-    if (strcmp(fragmentSymbol.pSymName, fragmentIsaSymbolName) == 0) {
-      // Modify ISA code
-      fragmentIsaSymbol = &fragmentSymbol;
-      ElfSectionBuffer<Elf64::SectionHeader> newSection = {};
-      mergeSection(nonFragmentTextSection, isaOffset, nullptr, fragmentTextSection, fragmentIsaSymbol->value, nullptr,
-                   &newSection);
-      setSection(nonFragmentSecIndex, &newSection);
-    }
-
-    if (!fragmentIsaSymbol)
-      continue;
+  size_t isaOffset = (!nonFragmentIsaSymbol || keepNonFragmentText)
+                         ? alignTo(nonFragmentTextSection->secHead.sh_size, 0x100)
+                         : nonFragmentIsaSymbol->value;
+  if (!part.symbols.empty()) {
+    auto fragmentTextSection = getFragmentSection(part.text, part.textSize);
+    ElfSectionBuffer<Elf64::SectionHeader> newSection = {};
+    mergeSection(nonFragmentTextSection, isaOffset, nullptr, &fragmentTextSection, 0, nullptr, &newSection);
+    setSection(nonFragmentSecIndex, &newSection);
+  }
 
-    // Update fragment shader related symbols
-    ElfSymbol *symbol = nullptr;
-    symbol = getSymbol(fragmentSymbol.pSymName);
+  // Update fragment shader related symbols
+  for (const auto &fragmentSymbol : part.symbols) {
+    ElfSymbol *symbol = getSymbol(fragmentSymbol.name);
     symbol->secIdx = nonFragmentSecIndex;
     symbol->secName = nullptr;
-    symbol->value = isaOffset + fragmentSymbol.value - fragmentIsaSymbol->value;
+    symbol->value = isaOffset + fragmentSymbol.value;
     symbol->size = fragmentSymbol.size;
   }
 
-  // LLPC doesn't use per pipeline internal table, and LLVM backend doesn't add symbols for disassembly info.
-  assert(reader.isValidSymbol(fragmentIntrlTblSymbolName) == false &&
-         reader.isValidSymbol(fragmentDisassemblySymbolName) == false &&
-         reader.isValidSymbol(fragmentIntrlDataSymbolName) == false &&
-         reader.isValidSymbol(fragmentAmdIlSymbolName) == false);
-  (void(fragmentIntrlTblSymbolName));    // unused
-  (void(fragmentDisassemblySymbolName)); // unused
-  (void(fragmentIntrlDataSymbolName));   // unused
-  (void(fragmentAmdIlSymbolName));       // unused
-
   // Merge ISA disassemble
-  auto fragmentDisassemblySecIndex = reader.GetSectionIndex(Util::Abi::AmdGpuDisassemblyName);
   auto nonFragmentDisassemblySecIndex = GetSectionIndex(Util::Abi::AmdGpuDisassemblyName);
-  ElfSectionBuffer<Elf64::SectionHeader> *fragmentDisassemblySection = nullptr;
   const ElfSectionBuffer<Elf64::SectionHeader> *nonFragmentDisassemblySection = nullptr;
-  reader.getSectionDataBySectionIndex(fragmentDisassemblySecIndex, &fragmentDisassemblySection);
   getSectionDataBySectionIndex(nonFragmentDisassemblySecIndex, &nonFragmentDisassemblySection);
   if (nonFragmentDisassemblySection) {
-    assert(fragmentDisassemblySection);
-    // NOTE: We have to replace last character with null terminator and restore it afterwards. Otherwise, the
-    // text search will be incorrect. It is only needed for ElfReader, ElfWriter always append a null terminator
-    // for all section data.
-    auto fragmentDisassemblySectionEnd =
-        fragmentDisassemblySection->data + fragmentDisassemblySection->secHead.sh_size - 1;
-    uint8_t lastChar = *fragmentDisassemblySectionEnd;
-    const_cast<uint8_t *>(fragmentDisassemblySectionEnd)[0] = '\0';
-    auto fragmentDisassembly =
-        strstr(reinterpret_cast<const char *>(fragmentDisassemblySection->data), fragmentIsaSymbolName);
-    const_cast<uint8_t *>(fragmentDisassemblySectionEnd)[0] = lastChar;
-
-    auto fragmentDisassemblyOffset =
-        !fragmentDisassembly ? 0
-                             : (fragmentDisassembly - reinterpret_cast<const char *>(fragmentDisassemblySection->data));
-
+    assert(part.hasDisassembly);
     auto disassemblyEnd =
         strstr(reinterpret_cast<const char *>(nonFragmentDisassemblySection->data), fragmentIsaSymbolName);
     auto disassemblySize = !disassemblyEnd
                                ? nonFragmentDisassemblySection->secHead.sh_size
                                : disassemblyEnd - reinterpret_cast<const char *>(nonFragmentDisassemblySection->data);
 
+    auto fragmentDisassemblySection = getFragmentSection(part.disassembly.data(), part.disassembly.size());
     ElfSectionBuffer<Elf64::SectionHeader> newSection = {};
-    mergeSection(nonFragmentDisassemblySection, disassemblySize, firstIsaSymbolName.c_str(), fragmentDisassemblySection,
-                 fragmentDisassemblyOffset, fragmentIsaSymbolName, &newSection);
+    mergeSection(nonFragmentDisassemblySection, disassemblySize, firstIsaSymbolName.c_str(),
+                 &fragmentDisassemblySection, 0, fragmentIsaSymbolName, &newSection);
     setSection(nonFragmentDisassemblySecIndex, &newSection);
   }
 
   // Merge LLVM IR disassemble
   const std::string llvmIrSectionName = std::string(Util::Abi::AmdGpuCommentLlvmIrName);
-  ElfSectionBuffer<Elf64::SectionHeader> *fragmentLlvmIrSection = nullptr;
   const ElfSectionBuffer<Elf64::SectionHeader> *nonFragmentLlvmIrSection = nullptr;
 
-  auto fragmentLlvmIrSecIndex = reader.GetSectionIndex(llvmIrSectionName.c_str());
   auto nonFragmentLlvmIrSecIndex = GetSectionIndex(llvmIrSectionName.c_str());
-  reader.getSectionDataBySectionIndex(fragmentLlvmIrSecIndex, &fragmentLlvmIrSection);
   getSectionDataBySectionIndex(nonFragmentLlvmIrSecIndex, &nonFragmentLlvmIrSection);
 
   if (nonFragmentLlvmIrSection) {
-    assert(fragmentLlvmIrSection);
-
-    // NOTE: We have to replace last character with null terminator and restore it afterwards. Otherwise, the
-    // text search will be incorrect. It is only needed for ElfReader, ElfWriter always append a null terminator
-    // for all section data.
-    auto fragmentLlvmIrSectionEnd = fragmentLlvmIrSection->data + fragmentLlvmIrSection->secHead.sh_size - 1;
-    uint8_t lastChar = *fragmentLlvmIrSectionEnd;
-    const_cast<uint8_t *>(fragmentLlvmIrSectionEnd)[0] = '\0';
-    auto fragmentLlvmIrStart =
-        strstr(reinterpret_cast<const char *>(fragmentLlvmIrSection->data), fragmentIsaSymbolName);
-    const_cast<uint8_t *>(fragmentLlvmIrSectionEnd)[0] = lastChar;
-
-    auto fragmentLlvmIrOffset =
-        !fragmentLlvmIrStart ? 0 : (fragmentLlvmIrStart - reinterpret_cast<const char *>(fragmentLlvmIrSection->data));
-
+    assert(part.hasLlvmIr);
     auto llvmIrEnd = strstr(reinterpret_cast<const char *>(nonFragmentLlvmIrSection->data), fragmentIsaSymbolName);
     auto llvmIrSize = !llvmIrEnd ? nonFragmentLlvmIrSection->secHead.sh_size
                                  : llvmIrEnd - reinterpret_cast<const char *>(nonFragmentLlvmIrSection->data);
 
+    auto fragmentLlvmIrSection = getFragmentSection(part.llvmIr.data(), part.llvmIr.size());
     ElfSectionBuffer<Elf64::SectionHeader> newSection = {};
-    mergeSection(nonFragmentLlvmIrSection, llvmIrSize, firstIsaSymbolName.c_str(), fragmentLlvmIrSection,
-                 fragmentLlvmIrOffset, fragmentIsaSymbolName, &newSection);
+    mergeSection(nonFragmentLlvmIrSection, llvmIrSize, firstIsaSymbolName.c_str(), &fragmentLlvmIrSection, 0,
+                 fragmentIsaSymbolName, &newSection);
     setSection(nonFragmentLlvmIrSecIndex, &newSection);
   }
 
@@ -958,10 +1472,11 @@ void ElfWriter<Elf>::mergeElfBinary(Context *pContext, const BinaryData *pFragme
   ElfNote nonFragmentMetaNote = {};
   nonFragmentMetaNote = getNote(Util::Abi::PipelineAbiNoteType::PalMetadata);
 
-  assert(nonFragmentMetaNote.data);
+  assert(nonFragmentMetaNote.data && part.metadata);
   ElfNote fragmentMetaNote = {};
   ElfNote newMetaNote = {};
-  fragmentMetaNote = reader.getNote(Util::Abi::PipelineAbiNoteType::PalMetadata);
+  fragmentMetaNote.hdr.descSize = part.metadataSize;
+  fragmentMetaNote.data = part.metadata;
   mergeMetaNote(pContext, &nonFragmentMetaNote, &fragmentMetaNote, &newMetaNote);
   setNote(&newMetaNote);
 
@@ -994,6 +1509,122 @@ template <class Elf> void ElfWriter<Elf>::reinitialize() {
   m_map[NoteName] = m_noteSecIdx;
 }
 
+// =====================================================================================================================
+// Sets the bits of a register in the PAL metadata of a pipeline ELF, writing the patched ELF to a new buffer. The
+// register value is patched in place in a copy of the ELF if the new value fits in the encoding of the old one, and
+// the metadata is only rewritten otherwise.
+//
+// Returns false, leaving patchedElf untouched, if the register already has those bits or is not set in the ELF.
+//
+// @param gfxIp : Graphics IP version info
+// @param pipelineElf : Pipeline ELF to patch
+// @param regNumber : Register number
+// @param mask : Mask of the bits to set
+// @param value : Value of the bits to set
+// @param [out] patchedElf : Patched pipeline ELF
+template <class Elf>
+bool ElfWriter<Elf>::updatePalMetadataRegister(GfxIpVersion gfxIp, const BinaryData *pipelineElf, unsigned regNumber,
+                                               unsigned mask, unsigned value, ElfPackage *patchedElf) {
+  ElfReader<Elf> reader(gfxIp);
+  size_t readSize = pipelineElf->codeSize;
+  if (reader.ReadFromBuffer(pipelineElf->pCode, &readSize) != Result::Success)
+    return false;
+  ElfNote metaNote = reader.getNote(Util::Abi::PipelineAbiNoteType::PalMetadata);
+  if (!metaNote.data)
+    return false;
+
+  // The note is only read here, so it is safe to look it up in the caller's ELF.
+  uint64_t oldValue = 0;
+  uint8_t *valuePos = nullptr;
+  size_t valueSize = 0;
+  if (!findRegisterInPlace(const_cast<uint8_t *>(metaNote.data), metaNote.hdr.descSize, regNumber, &oldValue,
+                           &valuePos, &valueSize))
+    return false;
+  uint64_t newValue = (oldValue & ~uint64_t(mask)) | (value & mask);
+  if (newValue == oldValue)
+    return false;
+
+  const char *elfData = static_cast<const char *>(pipelineElf->pCode);
+  patchedElf->assign(elfData, elfData + pipelineElf->codeSize);
+  uint8_t *patchedPos =
+      reinterpret_cast<uint8_t *>(patchedElf->data()) + (valuePos - reinterpret_cast<const uint8_t *>(elfData));
+  if (MsgPackCursor::writeUInt(patchedPos, valueSize, newValue))
+    return true;
+
+  ElfWriter<Elf> writer(gfxIp);
+  auto result = writer.ReadFromBuffer(pipelineElf->pCode, pipelineElf->codeSize);
+  assert(result == Result::Success);
+  (void(result)); // unused
+
+  msgpack::Document document;
+  auto success =
+      document.readFromBlob(StringRef(reinterpret_cast<const char *>(metaNote.data), metaNote.hdr.descSize), false);
+  assert(success);
+  (void(success)); // unused
+  auto pipeline = document.getRoot().getMap(true)[Util::Abi::PalCodeObjectMetadataKey::Pipelines].getArray(true)[0];
+  auto registers = pipeline.getMap(true)[Util::Abi::PipelineMetadataKey::Registers].getMap(true);
+  registers[document.getNode(regNumber)] = document.getNode(newValue);
+
+  std::string blob;
+  document.writeToBlob(blob);
+  ElfNote newMetaNote = metaNote;
+  auto data = new uint8_t[blob.size()];
+  memcpy(data, blob.data(), blob.size());
+  newMetaNote.hdr.descSize = blob.size();
+  newMetaNote.data = data;
+  writer.setNote(&newMetaNote);
+
+  patchedElf->clear();
+  writer.writeToBuffer(patchedElf);
+  return true;
+}
+
+// =====================================================================================================================
+// Strips the sections that are not needed at run time from a pipeline ELF, writing the stripped ELF to a new buffer.
+// These are the disassembly and the comment sections, which hold the AMDIL and LLVM IR. Each such section is kept with
+// empty contents, so that section indices do not change, and the symbols defined in it are dropped.
+//
+// Returns false, leaving strippedElf untouched, if the ELF has nothing to strip.
+//
+// @param gfxIp : Graphics IP version info
+// @param pipelineElf : Pipeline ELF to strip
+// @param [out] strippedElf : Stripped pipeline ELF
+template <class Elf>
+bool ElfWriter<Elf>::stripNonRuntimeSections(GfxIpVersion gfxIp, const BinaryData *pipelineElf,
+                                             ElfPackage *strippedElf) {
+  // Name prefix of the sections that hold the AMDIL and LLVM IR of the pipeline.
+  static const char CommentSectionPrefix[] = ".AMDGPU.comment.";
+
+  ElfWriter<Elf> writer(gfxIp);
+  if (writer.ReadFromBuffer(pipelineElf->pCode, pipelineElf->codeSize) != Result::Success)
+    return false;
+
+  bool stripped = false;
+  for (unsigned secIdx = 0; secIdx != writer.m_sections.size(); ++secIdx) {
+    SectionBuffer &section = writer.m_sections[secIdx];
+    if (!section.name || section.secHead.sh_size == 0)
+      continue;
+    StringRef sectionName(section.name);
+    if (sectionName != Util::Abi::AmdGpuDisassemblyName && !sectionName.startswith(CommentSectionPrefix))
+      continue;
+
+    delete[] section.data;
+    section.data = nullptr;
+    section.secHead.sh_size = 0;
+    for (auto &symbol : writer.m_symbols) {
+      if (symbol.secIdx == secIdx)
+        symbol.secIdx = InvalidValue;
+    }
+    stripped = true;
+  }
+  if (!stripped)
+    return false;
+
+  strippedElf->clear();
+  writer.writeToBuffer(strippedElf);
+  return true;
+}
+
 template class ElfWriter<Elf64>;
 
 } // namespace Llpc
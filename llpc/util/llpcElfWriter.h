@@ -31,6 +31,7 @@
 #pragma once
 
 #include "vkgcElfReader.h"
+#include "llvm/ADT/StringRef.h"
 
 // Forward declaration
 namespace llvm {
@@ -54,6 +55,29 @@ using Vkgc::Result;
 // Forward declaration
 class Context;
 
+// =====================================================================================================================
+// Represents the fragment half of a pipeline ELF: what ElfWriter::mergeElfBinary takes from the ELF of the fragment
+// shader. It is read either from that ELF or from the pre-split form that ElfWriter::splitFragmentElf stores in the
+// shader caches, and its pointers refer to the buffer that it was read from.
+struct FragmentElfPart {
+  // Represents a symbol of the fragment shader ISA, with its value relative to the start of the fragment shader.
+  struct Symbol {
+    const char *name; // Symbol name (null-terminated)
+    uint64_t value;   // Offset from the start of the fragment shader ISA
+    uint64_t size;    // Size of the symbol
+  };
+
+  const uint8_t *text;         // Fragment shader ISA, starting at _amdgpu_ps_main
+  size_t textSize;             // Byte size of the fragment shader ISA
+  std::vector<Symbol> symbols; // Symbols of the fragment shader ISA; empty if there is no fragment shader
+  bool hasDisassembly;         // Whether there is a disassembly section
+  llvm::StringRef disassembly; // Disassembly of the fragment shader
+  bool hasLlvmIr;              // Whether there is an LLVM IR section
+  llvm::StringRef llvmIr;      // LLVM IR of the fragment shader
+  const uint8_t *metadata;     // PAL metadata (MsgPack) of the fragment ELF
+  size_t metadataSize;         // Byte size of the PAL metadata
+};
+
 // =====================================================================================================================
 // Represents a writer for storing data to an ELF buffer.
 //
@@ -81,6 +105,13 @@ public:
 
   void mergeElfBinary(Context *context, const BinaryData *fragmentElf, ElfPackage *pipelineElf);
 
+  static void splitFragmentElf(GfxIpVersion gfxIp, const BinaryData *pipelineElf, ElfPackage *fragmentPart);
+
+  static bool updatePalMetadataRegister(GfxIpVersion gfxIp, const BinaryData *pipelineElf, unsigned regNumber,
+                                        unsigned mask, unsigned value, ElfPackage *patchedElf);
+
+  static bool stripNonRuntimeSections(GfxIpVersion gfxIp, const BinaryData *pipelineElf, ElfPackage *strippedElf);
+
   // Gets the section index for the specified section name.
   int GetSectionIndex(const char *name) const {
     auto entry = m_map.find(name);
@@ -109,6 +140,12 @@ private:
 
   static void mergeMapItem(llvm::msgpack::MapDocNode &destMap, llvm::msgpack::MapDocNode &srcMap, unsigned key);
 
+  static void extractFragmentElfPart(ElfReader<Elf> &reader, FragmentElfPart *part);
+
+  static bool readFragmentElfPart(const BinaryData *fragmentPartBin, FragmentElfPart *part);
+
+  void mergeFragmentElfPart(Context *context, const FragmentElfPart &part, ElfPackage *pipelineElf);
+
   size_t getRequiredBufferSizeBytes();
 
   void calcSectionHeaderOffset();
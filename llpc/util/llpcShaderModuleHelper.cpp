@@ -33,14 +33,154 @@
 #include "llpcUtil.h"
 #include "spirvExt.h"
 #include "vkgcUtil.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
-#include <set>
+#include <bitset>
+#include <map>
+#include <unordered_map>
 #include <unordered_set>
+#ifdef LLPC_ENABLE_SPIRV_OPT
+#include "spvgen.h"
+
+namespace llvm {
+
+namespace cl {
+
+extern opt<bool> EnableSpirvOpt;
+
+} // namespace cl
+
+} // namespace llvm
+#endif
+
 using namespace llvm;
 
 using namespace spv;
 
 namespace Llpc {
+
+// Number of words of SPIR-V code that scanSpirvBinary() processes at a time, small enough that the block is still in
+// the cache when it is hashed and copied.
+static constexpr size_t SpirvScanBlockWords = 4096;
+
+// =====================================================================================================================
+// Returns the table of the SPIR-V opcodes that are supported, indexed by opcode.
+static const std::bitset<OpCodeMask + 1> &getSupportedSpirvOps() {
+#define _SPIRV_OP(x, ...) Op##x,
+  static const Op SupportedOps[] = {
+#include "SPIRVOpCodeEnum.h"
+  };
+#undef _SPIRV_OP
+
+  static const std::bitset<OpCodeMask + 1> SupportedOpTable = [] {
+    std::bitset<OpCodeMask + 1> table;
+    for (Op op : SupportedOps)
+      table.set(op);
+    return table;
+  }();
+  return SupportedOpTable;
+}
+
+// =====================================================================================================================
+// Returns true if the SPIR-V opcode is that of a debug instruction, which is removed when trimming debug info.
+//
+// @param opCode : SPIR-V opcode
+static bool isSpirvDebugInst(unsigned opCode) {
+  switch (opCode) {
+  case OpString:
+  case OpSource:
+  case OpSourceContinued:
+  case OpSourceExtension:
+  case OpName:
+  case OpMemberName:
+  case OpLine:
+  case OpNop:
+  case OpNoLine:
+  case OpModuleProcessed:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// =====================================================================================================================
+// Collect information from one SPIR-V instruction
+//
+// @param codePos : SPIR-V instruction
+// @param [out] shaderModuleUsage : Shader module usage info
+// @param [out] shaderEntryNames : Entry names for this shader module
+// @param [out] capabilities : Capabilities declared by the shader module
+static void collectInfoFromSpirvInst(const unsigned *codePos, ShaderModuleUsage *shaderModuleUsage,
+                                     std::vector<ShaderEntryName> &shaderEntryNames,
+                                     std::unordered_set<unsigned> &capabilities) {
+  unsigned opCode = (codePos[0] & OpCodeMask);
+  unsigned wordCount = (codePos[0] >> WordCountShift);
+
+  // Parse each instruction and find those we are interested in
+  switch (opCode) {
+  case OpCapability: {
+    assert(wordCount == 2);
+    (void(wordCount)); // unused
+    auto capability = static_cast<Capability>(codePos[1]);
+    capabilities.insert(capability);
+    break;
+  }
+  case OpDPdx:
+  case OpDPdy:
+  case OpDPdxCoarse:
+  case OpDPdyCoarse:
+  case OpDPdxFine:
+  case OpDPdyFine:
+  case OpImageSampleImplicitLod:
+  case OpImageSampleDrefImplicitLod:
+  case OpImageSampleProjImplicitLod:
+  case OpImageSampleProjDrefImplicitLod:
+  case OpImageSparseSampleImplicitLod:
+  case OpImageSparseSampleProjDrefImplicitLod:
+  case OpImageSparseSampleProjImplicitLod: {
+    shaderModuleUsage->useHelpInvocation = true;
+    break;
+  }
+  case OpSpecConstantTrue:
+  case OpSpecConstantFalse:
+  case OpSpecConstant:
+  case OpSpecConstantComposite:
+  case OpSpecConstantOp: {
+    shaderModuleUsage->useSpecConstant = true;
+    break;
+  }
+  case OpIsNan: {
+    shaderModuleUsage->useIsNan = true;
+    break;
+  }
+  case OpEntryPoint: {
+    ShaderEntryName entry = {};
+    // The fourth word is start of the name string of the entry-point
+    entry.name = reinterpret_cast<const char *>(&codePos[3]);
+    entry.stage = convertToStageShage(codePos[1]);
+    shaderEntryNames.push_back(entry);
+    break;
+  }
+  default: {
+    break;
+  }
+  }
+}
+
+// =====================================================================================================================
+// Collect information from the capabilities declared by a SPIR-V binary
+//
+// @param capabilities : Capabilities declared by the shader module
+// @param [out] shaderModuleUsage : Shader module usage info
+static void collectInfoFromSpirvCapabilities(const std::unordered_set<unsigned> &capabilities,
+                                             ShaderModuleUsage *shaderModuleUsage) {
+  if (capabilities.find(CapabilityVariablePointersStorageBuffer) != capabilities.end())
+    shaderModuleUsage->enableVarPtrStorageBuf = true;
+
+  if (capabilities.find(CapabilityVariablePointers) != capabilities.end())
+    shaderModuleUsage->enableVarPtr = true;
+}
+
 // =====================================================================================================================
 // Collect information from SPIR-V binary
 //
@@ -72,75 +212,15 @@ Result ShaderModuleHelper::collectInfoFromSpirvBinary(const BinaryData *spvBinCo
       break;
     }
 
-    // Parse each instruction and find those we are interested in
-    switch (opCode) {
-    case OpCapability: {
-      assert(wordCount == 2);
-      auto capability = static_cast<Capability>(codePos[1]);
-      capabilities.insert(capability);
-      break;
-    }
-    case OpDPdx:
-    case OpDPdy:
-    case OpDPdxCoarse:
-    case OpDPdyCoarse:
-    case OpDPdxFine:
-    case OpDPdyFine:
-    case OpImageSampleImplicitLod:
-    case OpImageSampleDrefImplicitLod:
-    case OpImageSampleProjImplicitLod:
-    case OpImageSampleProjDrefImplicitLod:
-    case OpImageSparseSampleImplicitLod:
-    case OpImageSparseSampleProjDrefImplicitLod:
-    case OpImageSparseSampleProjImplicitLod: {
-      shaderModuleUsage->useHelpInvocation = true;
-      break;
-    }
-    case OpString:
-    case OpSource:
-    case OpSourceContinued:
-    case OpSourceExtension:
-    case OpName:
-    case OpMemberName:
-    case OpLine:
-    case OpNop:
-    case OpNoLine:
-    case OpModuleProcessed: {
+    if (isSpirvDebugInst(opCode))
       *debugInfoSize += wordCount * sizeof(unsigned);
-      break;
-    }
-    case OpSpecConstantTrue:
-    case OpSpecConstantFalse:
-    case OpSpecConstant:
-    case OpSpecConstantComposite:
-    case OpSpecConstantOp: {
-      shaderModuleUsage->useSpecConstant = true;
-      break;
-    }
-    case OpIsNan: {
-      shaderModuleUsage->useIsNan = true;
-      break;
-    }
-    case OpEntryPoint: {
-      ShaderEntryName entry = {};
-      // The fourth word is start of the name string of the entry-point
-      entry.name = reinterpret_cast<const char *>(&codePos[3]);
-      entry.stage = convertToStageShage(codePos[1]);
-      shaderEntryNames.push_back(entry);
-      break;
-    }
-    default: {
-      break;
-    }
-    }
+    else
+      collectInfoFromSpirvInst(codePos, shaderModuleUsage, shaderEntryNames, capabilities);
+
     codePos += wordCount;
   }
 
-  if (capabilities.find(CapabilityVariablePointersStorageBuffer) != capabilities.end())
-    shaderModuleUsage->enableVarPtrStorageBuf = true;
-
-  if (capabilities.find(CapabilityVariablePointers) != capabilities.end())
-    shaderModuleUsage->enableVarPtr = true;
+  collectInfoFromSpirvCapabilities(capabilities, shaderModuleUsage);
 
   return result;
 }
@@ -169,28 +249,12 @@ void ShaderModuleHelper::trimSpirvDebugInfo(const BinaryData *spvBin, unsigned b
   while (codePos < end) {
     unsigned opCode = (codePos[0] & OpCodeMask);
     unsigned wordCount = (codePos[0] >> WordCountShift);
-    switch (opCode) {
-    case OpString:
-    case OpSource:
-    case OpSourceContinued:
-    case OpSourceExtension:
-    case OpName:
-    case OpMemberName:
-    case OpLine:
-    case OpNop:
-    case OpNoLine:
-    case OpModuleProcessed: {
-      // Skip debug instructions
-      break;
-    }
-    default: {
-      // Copy other instructions
+    // Skip debug instructions, and copy other instructions
+    if (!isSpirvDebugInst(opCode)) {
       assert(codePos + wordCount <= end);
       assert(trimCodePos + wordCount <= trimEnd);
       memcpy(trimCodePos, codePos, wordCount * sizeof(unsigned));
       trimCodePos += wordCount;
-      break;
-    }
     }
 
     codePos += wordCount;
@@ -199,6 +263,184 @@ void ShaderModuleHelper::trimSpirvDebugInfo(const BinaryData *spvBin, unsigned b
   assert(trimCodePos == trimEnd);
 }
 
+// =====================================================================================================================
+// Scans a SPIR-V binary in a single pass: verifies that it is valid and supported, collects the shader module usage
+// and entry names, removes the debug instructions, and hashes both the original and the trimmed code. This is
+// equivalent to verifySpirvBinary(), collectInfoFromSpirvBinary(), trimSpirvDebugInfo() and hashing the original and
+// trimmed code, but the code is processed in blocks that are still in the cache when they are hashed and copied.
+//
+// The hash of the original code is made with MetroHash64, as it names the dump files. The cache key hash is made with
+// the given algorithm, from the trimmed code if the code is trimmed. With MetroHash64 and no trimming, the two are
+// the same, and the code is only hashed once.
+//
+// The hash of the original code is always returned, even if the binary is invalid.
+//
+// @param spvBin : SPIR-V binary
+// @param [out] shaderModuleUsage : Shader module usage info
+// @param [out] shaderEntryNames : Entry names for this shader module
+// @param [out] trimSpvBin : Buffer of at least spvBin->codeSize bytes for the trimmed code, or nullptr to not trim
+// @param [out] trimSpvBinSize : Size in bytes of the trimmed code (only if trimSpvBin is not nullptr)
+// @param [out] hash : Hash of the original code
+// @param keyAlgorithm : Hash algorithm of the cache key
+// @param [out] keyHash : Cache key hash of the trimmed code, or of the original code if trimSpvBin is nullptr
+Result ShaderModuleHelper::scanSpirvBinary(const BinaryData *spvBin, ShaderModuleUsage *shaderModuleUsage,
+                                           std::vector<ShaderEntryName> &shaderEntryNames, void *trimSpvBin,
+                                           size_t *trimSpvBinSize, MetroHash::Hash *hash,
+                                           MetroHash::HashAlgorithm keyAlgorithm, MetroHash::Hash *keyHash) {
+  Result result = Result::Success;
+  const std::bitset<OpCodeMask + 1> &supportedOps = getSupportedSpirvOps();
+
+  const unsigned *code = reinterpret_cast<const unsigned *>(spvBin->pCode);
+  const unsigned *end = code + spvBin->codeSize / sizeof(unsigned);
+
+  // Skip SPIR-V header
+  const unsigned *codePos = code + sizeof(SpirvHeader) / sizeof(unsigned);
+
+  MetroHash64 hasher;
+  MetroHash::CacheKeyHasher keyHasher(keyAlgorithm);
+  // Whether the cache key is the hash of the original code, with its own algorithm
+  const bool keyOriginalCode = !trimSpvBin && keyAlgorithm != MetroHash::HashAlgorithm::MetroHash64;
+  const unsigned *hashedEnd = code; // End of the original code fed to the hasher so far
+  const unsigned *keptStart = code; // Start of the run of instructions (and the header) being kept
+  unsigned *trimCodePos = static_cast<unsigned *>(trimSpvBin);
+
+  // Copies the run of kept instructions up to runEnd to the trimmed code, and hashes it.
+  auto flushKeptRun = [&](const unsigned *runEnd) {
+    if (!trimSpvBin)
+      return;
+    const size_t runSize = (runEnd - keptStart) * sizeof(unsigned);
+    memcpy(trimCodePos, keptStart, runSize);
+    keyHasher.Update(reinterpret_cast<const uint8_t *>(keptStart), runSize);
+    trimCodePos += runEnd - keptStart;
+  };
+
+  std::unordered_set<unsigned> capabilities;
+  while (codePos < end) {
+    unsigned opCode = (codePos[0] & OpCodeMask);
+    unsigned wordCount = (codePos[0] >> WordCountShift);
+
+    if (wordCount == 0 || codePos + wordCount > end || !supportedOps[opCode]) {
+      result = Result::ErrorInvalidShader;
+      break;
+    }
+
+    if (isSpirvDebugInst(opCode)) {
+      flushKeptRun(codePos);
+      keptStart = codePos + wordCount;
+    } else
+      collectInfoFromSpirvInst(codePos, shaderModuleUsage, shaderEntryNames, capabilities);
+
+    codePos += wordCount;
+
+    // Hash (and copy) the code in blocks while it is still in the cache.
+    if (codePos - hashedEnd >= SpirvScanBlockWords) {
+      const size_t blockSize = (codePos - hashedEnd) * sizeof(unsigned);
+      hasher.Update(reinterpret_cast<const uint8_t *>(hashedEnd), blockSize);
+      if (keyOriginalCode)
+        keyHasher.Update(reinterpret_cast<const uint8_t *>(hashedEnd), blockSize);
+      hashedEnd = codePos;
+    }
+    if (codePos - keptStart >= SpirvScanBlockWords) {
+      flushKeptRun(codePos);
+      keptStart = codePos;
+    }
+  }
+
+  // Hash the rest of the original code, including any trailing bytes.
+  const size_t restSize = spvBin->codeSize - (hashedEnd - code) * sizeof(unsigned);
+  hasher.Update(reinterpret_cast<const uint8_t *>(hashedEnd), restSize);
+  *hash = {};
+  hasher.Finalize(hash->bytes);
+
+  if (result == Result::Success) {
+    collectInfoFromSpirvCapabilities(capabilities, shaderModuleUsage);
+
+    if (trimSpvBin) {
+      flushKeptRun(end);
+      *trimSpvBinSize = voidPtrDiff(trimCodePos, trimSpvBin);
+    } else if (keyOriginalCode)
+      keyHasher.Update(reinterpret_cast<const uint8_t *>(hashedEnd), restSize);
+
+    *keyHash = {};
+    if (trimSpvBin || keyOriginalCode)
+      keyHasher.Finalize(keyHash);
+    else
+      *keyHash = *hash;
+  }
+
+  return result;
+}
+
+// =====================================================================================================================
+// Updates a hash with the specialization constant values that take effect when translating a SPIR-V binary. A map
+// entry whose constant ID is not a SpecId in the module, or whose value is the module's default, does not change the
+// translation, so it is left out. As in the SPIR-V reader, the last map entry for a constant ID wins.
+//
+// @param spvBin : SPIR-V binary
+// @param specializationInfo : Specialization info (may be nullptr)
+// @param [in,out] hasher : Hasher to update
+void ShaderModuleHelper::updateHashForSpecConstants(const BinaryData *spvBin,
+                                                    const VkSpecializationInfo *specializationInfo,
+                                                    MetroHash64 *hasher) {
+  // Zero-extended value of each specialized constant ID, as the SPIR-V reader applies it
+  std::map<unsigned, uint64_t> specValues;
+  if (specializationInfo) {
+    for (unsigned i = 0; i < specializationInfo->mapEntryCount; ++i) {
+      const VkSpecializationMapEntry &mapEntry = specializationInfo->pMapEntries[i];
+      uint64_t data = 0;
+      memcpy(&data, voidPtrInc(specializationInfo->pData, mapEntry.offset),
+             std::min<size_t>(mapEntry.size, sizeof(data)));
+      specValues[mapEntry.constantID] = data;
+    }
+  }
+
+  unsigned effectiveCount = 0;
+  if (!specValues.empty()) {
+    const unsigned *code = reinterpret_cast<const unsigned *>(spvBin->pCode);
+    const unsigned *end = code + spvBin->codeSize / sizeof(unsigned);
+    const unsigned *codePos = code + sizeof(SpirvHeader) / sizeof(unsigned);
+
+    // SpecId decorations precede the constants they decorate, and constants precede the functions.
+    std::unordered_map<unsigned, unsigned> specIds;
+    while (codePos < end) {
+      unsigned opCode = (codePos[0] & OpCodeMask);
+      unsigned wordCount = (codePos[0] >> WordCountShift);
+      if (wordCount == 0 || codePos + wordCount > end || opCode == OpFunction)
+        break;
+
+      if (opCode == OpDecorate && wordCount >= 4 && codePos[2] == DecorationSpecId)
+        specIds[codePos[1]] = codePos[3];
+      else if ((opCode == OpSpecConstant || opCode == OpSpecConstantTrue || opCode == OpSpecConstantFalse) &&
+               wordCount >= (opCode == OpSpecConstant ? 4u : 3u)) {
+        auto specId = specIds.find(codePos[2]);
+        auto specValue = specId != specIds.end() ? specValues.find(specId->second) : specValues.end();
+        if (specValue != specValues.end()) {
+          uint64_t value = specValue->second;
+          uint64_t defaultValue = 0;
+          if (opCode == OpSpecConstant) {
+            // Compare against the literal as the reader stores it, so that only bit-identical values are dropped.
+            defaultValue = codePos[3];
+            if (wordCount > 4)
+              defaultValue |= static_cast<uint64_t>(codePos[4]) << 32;
+          } else {
+            value = value != 0;
+            defaultValue = opCode == OpSpecConstantTrue;
+          }
+
+          if (value != defaultValue) {
+            hasher->Update(specId->second);
+            hasher->Update(value);
+            ++effectiveCount;
+          }
+        }
+      }
+
+      codePos += wordCount;
+    }
+  }
+  hasher->Update(effectiveCount);
+}
+
 // =====================================================================================================================
 // Optimizes SPIR-V binary
 //
@@ -210,14 +452,11 @@ Result ShaderModuleHelper::optimizeSpirv(const BinaryData *spirvBinIn, BinaryDat
   void *optBin = nullptr;
 
 #ifdef LLPC_ENABLE_SPIRV_OPT
-  if (cl::EnableSpirvOpt) {
+  if (cl::EnableSpirvOpt && InitSpvGen()) {
     char logBuf[4096] = {};
-    success =
-        spvOptimizeSpirv(pSpirvBinIn->codeSize, pSpirvBinIn->pCode, 0, nullptr, &optBinSize, &pOptBin, 4096, logBuf);
-    if (success == false) {
-      LLPC_ERROR("Failed to optimize SPIR-V ("
-                 << GetShaderStageName(static_cast<ShaderStage>(shaderStage) << " shader): " << logBuf));
-    }
+    success = spvOptimizeSpirv(spirvBinIn->codeSize, spirvBinIn->pCode, 0, nullptr, &optBinSize, &optBin, 4096, logBuf);
+    if (!success)
+      LLPC_ERRS("Failed to optimize SPIR-V: " << logBuf << "\n");
   }
 #endif
 
@@ -232,66 +471,104 @@ Result ShaderModuleHelper::optimizeSpirv(const BinaryData *spirvBinIn, BinaryDat
   return success ? Result::Success : Result::ErrorInvalidShader;
 }
 
+// =====================================================================================================================
+// Updates the hash code with the configuration of the SPIR-V optimizer run by optimizeSpirv(), so that a hash of its
+// output changes when the optimizer does.
+//
+// @param [in,out] hasher : Hasher to update
+void ShaderModuleHelper::updateHashForSpirvOpt(MetroHash64 *hasher) {
+#ifdef LLPC_ENABLE_SPIRV_OPT
+  if (InitSpvGen()) {
+    for (SpvGenVersion version : {SpvGenVersionSpirv, SpvGenVersionSpvGen}) {
+      unsigned spvGenVersion = 0;
+      unsigned spvGenRevision = 0;
+      spvGetVersion(version, &spvGenVersion, &spvGenRevision);
+      hasher->Update(spvGenVersion);
+      hasher->Update(spvGenRevision);
+    }
+  }
+#endif
+  // optimizeSpirv() passes no options to the optimizer.
+  hasher->Update(0u);
+}
+
 // =====================================================================================================================
 // Cleanup work for SPIR-V binary, freeing the allocated buffer by OptimizeSpirv()
 //
 // @param spirvBin : Optimized SPIR-V binary
 void ShaderModuleHelper::cleanOptimizedSpirv(BinaryData *spirvBin) {
 #ifdef LLPC_ENABLE_SPIRV_OPT
-  if (pSpirvBin->pCode) {
-    spvFreeBuffer(const_cast<void *>(pSpirvBin->pCode));
-  }
+  if (spirvBin->pCode)
+    spvFreeBuffer(const_cast<void *>(spirvBin->pCode));
 #endif
 }
 
 // =====================================================================================================================
-// Gets the shader stage mask from the SPIR-V binary according to the specified entry-point.
-//
-// Returns 0 on error, or the stage mask of the specified entry-point on success.
+// Gets all entry-points of the SPIR-V binary, in a single scan of the instructions before the first function. The
+// entry names point into the SPIR-V binary.
 //
 // @param spvBin : SPIR-V binary
-// @param entryName : Name of entry-point
-unsigned ShaderModuleHelper::getStageMaskFromSpirvBinary(const BinaryData *spvBin, const char *entryName) {
-  unsigned stageMask = 0;
+// @param [out] shaderEntryNames : Entry names and stages of the entry-points
+Result ShaderModuleHelper::getEntryPointsFromSpirvBinary(const BinaryData *spvBin,
+                                                         std::vector<ShaderEntryName> &shaderEntryNames) {
+  if (!isSpirvBinary(spvBin)) {
+    LLPC_ERRS("Invalid SPIR-V binary\n");
+    return Result::ErrorInvalidShader;
+  }
 
   const unsigned *code = reinterpret_cast<const unsigned *>(spvBin->pCode);
   const unsigned *end = code + spvBin->codeSize / sizeof(unsigned);
 
-  if (isSpirvBinary(spvBin)) {
-    // Skip SPIR-V header
-    const unsigned *codePos = code + sizeof(SpirvHeader) / sizeof(unsigned);
+  // Skip SPIR-V header
+  const unsigned *codePos = code + sizeof(SpirvHeader) / sizeof(unsigned);
 
-    while (codePos < end) {
-      unsigned opCode = (codePos[0] & OpCodeMask);
-      unsigned wordCount = (codePos[0] >> WordCountShift);
+  while (codePos < end) {
+    unsigned opCode = (codePos[0] & OpCodeMask);
+    unsigned wordCount = (codePos[0] >> WordCountShift);
 
-      if (wordCount == 0 || codePos + wordCount > end) {
-        LLPC_ERRS("Invalid SPIR-V binary\n");
-        stageMask = 0;
-        break;
-      }
+    if (wordCount == 0 || codePos + wordCount > end) {
+      LLPC_ERRS("Invalid SPIR-V binary\n");
+      shaderEntryNames.clear();
+      return Result::ErrorInvalidShader;
+    }
 
-      if (opCode == OpEntryPoint) {
-        assert(wordCount >= 4);
+    if (opCode == OpEntryPoint) {
+      assert(wordCount >= 4);
 
-        // The fourth word is start of the name string of the entry-point
-        const char *name = reinterpret_cast<const char *>(&codePos[3]);
-        if (strcmp(entryName, name) == 0) {
-          // An matching entry-point is found
-          stageMask |= shaderStageToMask(convertToStageShage(codePos[1]));
-        }
-      }
+      // The fourth word is start of the name string of the entry-point
+      ShaderEntryName entry = {};
+      entry.name = reinterpret_cast<const char *>(&codePos[3]);
+      entry.stage = convertToStageShage(codePos[1]);
+      shaderEntryNames.push_back(entry);
+    }
 
-      // All "OpEntryPoint" are before "OpFunction"
-      if (opCode == OpFunction)
-        break;
+    // All "OpEntryPoint" are before "OpFunction"
+    if (opCode == OpFunction)
+      break;
 
-      codePos += wordCount;
-    }
-  } else {
-    LLPC_ERRS("Invalid SPIR-V binary\n");
+    codePos += wordCount;
   }
 
+  return Result::Success;
+}
+
+// =====================================================================================================================
+// Gets the shader stage mask from the SPIR-V binary according to the specified entry-point.
+//
+// Returns 0 on error, or the stage mask of the specified entry-point on success.
+//
+// @param spvBin : SPIR-V binary
+// @param entryName : Name of entry-point
+unsigned ShaderModuleHelper::getStageMaskFromSpirvBinary(const BinaryData *spvBin, const char *entryName) {
+  unsigned stageMask = 0;
+  std::vector<ShaderEntryName> shaderEntryNames;
+  getEntryPointsFromSpirvBinary(spvBin, shaderEntryNames);
+  for (const ShaderEntryName &entry : shaderEntryNames) {
+    if (strcmp(entryName, entry.name) == 0) {
+      // An matching entry-point is found
+      stageMask |= shaderStageToMask(entry.stage);
+    }
+  }
   return stageMask;
 }
 
@@ -303,49 +580,14 @@ unsigned ShaderModuleHelper::getStageMaskFromSpirvBinary(const BinaryData *spvBi
 //
 // @param spvBin : SPIR-V binary
 const char *ShaderModuleHelper::getEntryPointNameFromSpirvBinary(const BinaryData *spvBin) {
-  const char *entryName = nullptr;
-
-  const unsigned *code = reinterpret_cast<const unsigned *>(spvBin->pCode);
-  const unsigned *end = code + spvBin->codeSize / sizeof(unsigned);
-
-  if (isSpirvBinary(spvBin)) {
-    // Skip SPIR-V header
-    const unsigned *codePos = code + sizeof(SpirvHeader) / sizeof(unsigned);
-
-    while (codePos < end) {
-      unsigned opCode = (codePos[0] & OpCodeMask);
-      unsigned wordCount = (codePos[0] >> WordCountShift);
-
-      if (wordCount == 0 || codePos + wordCount > end) {
-        LLPC_ERRS("Invalid SPIR-V binary\n");
-        break;
-      }
-
-      if (opCode == OpEntryPoint) {
-        assert(wordCount >= 4);
-
-        // The fourth word is start of the name string of the entry-point
-        entryName = reinterpret_cast<const char *>(&codePos[3]);
-        break;
-      }
-
-      // All "OpEntryPoint" are before "OpFunction"
-      if (opCode == OpFunction)
-        break;
-
-      codePos += wordCount;
-    }
-
-    if (!entryName) {
-      LLPC_ERRS("Entry-point not found\n");
-      entryName = "";
-    }
-  } else {
-    LLPC_ERRS("Invalid SPIR-V binary\n");
-    entryName = "";
+  std::vector<ShaderEntryName> shaderEntryNames;
+  if (getEntryPointsFromSpirvBinary(spvBin, shaderEntryNames) != Result::Success)
+    return "";
+  if (shaderEntryNames.empty()) {
+    LLPC_ERRS("Entry-point not found\n");
+    return "";
   }
-
-  return entryName;
+  return shaderEntryNames[0].name;
 }
 
 // =====================================================================================================================
@@ -355,11 +597,7 @@ const char *ShaderModuleHelper::getEntryPointNameFromSpirvBinary(const BinaryDat
 Result ShaderModuleHelper::verifySpirvBinary(const BinaryData *spvBin) {
   Result result = Result::Success;
 
-#define _SPIRV_OP(x, ...) Op##x,
-  static const std::set<Op> OpSet{{
-#include "SPIRVOpCodeEnum.h"
-  }};
-#undef _SPIRV_OP
+  const std::bitset<OpCodeMask + 1> &supportedOps = getSupportedSpirvOps();
 
   const unsigned *code = reinterpret_cast<const unsigned *>(spvBin->pCode);
   const unsigned *end = code + spvBin->codeSize / sizeof(unsigned);
@@ -368,7 +606,7 @@ Result ShaderModuleHelper::verifySpirvBinary(const BinaryData *spvBin) {
   const unsigned *codePos = code + sizeof(SpirvHeader) / sizeof(unsigned);
 
   while (codePos < end) {
-    Op opCode = static_cast<Op>(codePos[0] & OpCodeMask);
+    unsigned opCode = (codePos[0] & OpCodeMask);
     unsigned wordCount = (codePos[0] >> WordCountShift);
 
     if (wordCount == 0 || codePos + wordCount > end) {
@@ -376,7 +614,7 @@ Result ShaderModuleHelper::verifySpirvBinary(const BinaryData *spvBin) {
       break;
     }
 
-    if (OpSet.find(opCode) == OpSet.end()) {
+    if (!supportedOps[opCode]) {
       result = Result::ErrorInvalidShader;
       break;
     }
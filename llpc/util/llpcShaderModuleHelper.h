@@ -31,6 +31,7 @@
 
 #pragma once
 #include "llpc.h"
+#include "vkgcMetroHash.h"
 #include <vector>
 
 namespace Llpc {
@@ -67,10 +68,23 @@ public:
 
   static void trimSpirvDebugInfo(const BinaryData *spvBin, unsigned bufferSize, void *trimSpvBin);
 
+  static Result scanSpirvBinary(const BinaryData *spvBin, ShaderModuleUsage *shaderModuleUsage,
+                                std::vector<ShaderEntryName> &shaderEntryNames, void *trimSpvBin,
+                                size_t *trimSpvBinSize, MetroHash::Hash *hash,
+                                MetroHash::HashAlgorithm keyAlgorithm, MetroHash::Hash *keyHash);
+
+  static void updateHashForSpecConstants(const BinaryData *spvBin, const VkSpecializationInfo *specializationInfo,
+                                         MetroHash64 *hasher);
+
   static Result optimizeSpirv(const BinaryData *spirvBinIn, BinaryData *spirvBinOut);
 
+  static void updateHashForSpirvOpt(MetroHash64 *hasher);
+
   static void cleanOptimizedSpirv(BinaryData *spirvBin);
 
+  static Result getEntryPointsFromSpirvBinary(const BinaryData *spvBin,
+                                              std::vector<ShaderEntryName> &shaderEntryNames);
+
   static unsigned getStageMaskFromSpirvBinary(const BinaryData *spvBin, const char *entryName);
 
   static const char *getEntryPointNameFromSpirvBinary(const BinaryData *spvBin);
@@ -59,9 +59,14 @@ namespace Llpc {
 // @param hash64 : Hash code
 // @param descriptionPrefix : Profiler description prefix string
 // @param enableMask : Mask of enabled phase timers
-TimerProfiler::TimerProfiler(uint64_t hash64, const char *descriptionPrefix, unsigned enableMask)
-    : m_total("", "", getDummyTimeRecords()), m_phases("", "", getDummyTimeRecords()) {
-  if (TimePassesIsEnabled || cl::EnableTimerProfile) {
+// @param buildStats : Build stats to add the patch, optimization and codegen times to when the profiler is destroyed,
+//                     or nullptr. The timers are only enabled for timer reports: they stop the pass managers from
+//                     being cached and the stages from being lowered in parallel, so build stats must not enable them.
+TimerProfiler::TimerProfiler(uint64_t hash64, const char *descriptionPrefix, unsigned enableMask,
+                             PipelineBuildStats *buildStats)
+    : m_total("", "", getDummyTimeRecords()), m_phases("", "", getDummyTimeRecords()),
+      m_enabled(TimePassesIsEnabled || cl::EnableTimerProfile), m_buildStats(buildStats) {
+  if (m_enabled) {
     std::string hashString;
     raw_string_ostream ostream(hashString);
     ostream << format("0x%016" PRIX64, hash64);
@@ -107,10 +112,17 @@ TimerProfiler::TimerProfiler(uint64_t hash64, const char *descriptionPrefix, uns
 
 // =====================================================================================================================
 TimerProfiler::~TimerProfiler() {
-  if (TimePassesIsEnabled || cl::EnableTimerProfile) {
+  if (m_enabled) {
     // Stop whole timer
     m_wholeTimer.stopTimer();
   }
+
+  // The other times in the build stats are measured by BuildStatsTimeScope, whether or not the timers are enabled.
+  if (m_enabled && m_buildStats) {
+    m_buildStats->patchTime += m_phaseTimers[TimerPatch].getTotalTime().getWallTime();
+    m_buildStats->optTime += m_phaseTimers[TimerOpt].getTotalTime().getWallTime();
+    m_buildStats->codeGenTime += m_phaseTimers[TimerCodeGen].getTotalTime().getWallTime();
+  }
 }
 
 // =====================================================================================================================
@@ -120,7 +132,7 @@ TimerProfiler::~TimerProfiler() {
 // @param timerKind : Kind of phase timer
 // @param start : Start or  stop timer
 void TimerProfiler::addTimerStartStopPass(lgc::PassManager *passMgr, TimerKind timerKind, bool start) {
-  if (TimePassesIsEnabled || cl::EnableTimerProfile)
+  if (m_enabled)
     passMgr->add(lgc::LgcContext::createStartStopTimer(&m_phaseTimers[timerKind], start));
 }
 
@@ -130,7 +142,7 @@ void TimerProfiler::addTimerStartStopPass(lgc::PassManager *passMgr, TimerKind t
 // @param timerKind : Kind of phase timer
 // @param start : Start or  stop timer
 void TimerProfiler::startStopTimer(TimerKind timerKind, bool start) {
-  if (TimePassesIsEnabled || cl::EnableTimerProfile) {
+  if (m_enabled) {
     if (start)
       m_phaseTimers[timerKind].startTimer();
     else
@@ -139,11 +151,11 @@ void TimerProfiler::startStopTimer(TimerKind timerKind, bool start) {
 }
 
 // =====================================================================================================================
-// Gets a specific timer. Returns nullptr if TimePassesIsEnabled isn't enabled.
+// Gets a specific timer. Returns nullptr if the timers are not enabled.
 //
 // @param timerKind : Kind of phase timer
 Timer *TimerProfiler::getTimer(TimerKind timerKind) {
-  return TimePassesIsEnabled || cl::EnableTimerProfile ? &m_phaseTimers[timerKind] : nullptr;
+  return m_enabled ? &m_phaseTimers[timerKind] : nullptr;
 }
 
 // =====================================================================================================================
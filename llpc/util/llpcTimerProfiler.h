@@ -60,7 +60,8 @@ enum TimerKind : unsigned {
 // Represents a utility class for time profile, it wraps LLVM Timer and TimerGroup in internal.
 class TimerProfiler {
 public:
-  TimerProfiler(uint64_t hash64, const char *descriptionPrefix, unsigned enableMask);
+  TimerProfiler(uint64_t hash64, const char *descriptionPrefix, unsigned enableMask,
+                PipelineBuildStats *buildStats = nullptr);
 
   ~TimerProfiler();
 
@@ -83,6 +84,40 @@ private:
   llvm::TimerGroup m_phases;             // TimeGroup for each phase
   llvm::Timer m_wholeTimer;              // Whole timer
   llvm::Timer m_phaseTimers[TimerCount]; // Phase timer
+  bool m_enabled;                        // Whether the timers are enabled
+  PipelineBuildStats *m_buildStats;      // Build stats to add the phase times to, or nullptr
+};
+
+// =====================================================================================================================
+// Represents a scope whose wall time is added to a time in PipelineBuildStats, and whose growth of allocated memory
+// optionally counts towards the largest growth of a phase.
+class BuildStatsTimeScope {
+public:
+  // @param time : Time to add the wall time of this scope to, or nullptr if build stats are not being collected
+  // @param maxMemoryGrowth : Largest memory growth of a phase, to update with that of this scope, or nullptr
+  BuildStatsTimeScope(double *time, size_t *maxMemoryGrowth = nullptr)
+      : m_time(time), m_maxMemoryGrowth(maxMemoryGrowth) {
+    if (m_time)
+      m_start = llvm::TimeRecord::getCurrentTime(true);
+  }
+
+  ~BuildStatsTimeScope() {
+    if (!m_time)
+      return;
+    llvm::TimeRecord end = llvm::TimeRecord::getCurrentTime(false);
+    *m_time += end.getWallTime() - m_start.getWallTime();
+    ssize_t memoryGrowth = end.getMemUsed() - m_start.getMemUsed();
+    if (m_maxMemoryGrowth && memoryGrowth > 0)
+      *m_maxMemoryGrowth = std::max(*m_maxMemoryGrowth, static_cast<size_t>(memoryGrowth));
+  }
+
+private:
+  BuildStatsTimeScope(const BuildStatsTimeScope &) = delete;
+  BuildStatsTimeScope &operator=(const BuildStatsTimeScope &) = delete;
+
+  double *m_time;            // Time to add to
+  size_t *m_maxMemoryGrowth; // Largest memory growth to update, or nullptr
+  llvm::TimeRecord m_start;  // Time and memory use at the start of the scope
 };
 
 } // namespace Llpc
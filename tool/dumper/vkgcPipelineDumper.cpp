@@ -34,10 +34,14 @@
 #include "vkgcElfReader.h"
 #include "vkgcPipelineDumper.h"
 #include "vkgcUtil.h"
+#include <condition_variable>
+#include <deque>
 #include <fstream>
+#include <mutex>
 #include <sstream>
 #include <stdarg.h>
 #include <sys/stat.h>
+#include <thread>
 #include <unordered_set>
 
 #define DEBUG_TYPE "vkgc-pipeline-dumper"
@@ -61,11 +65,17 @@ std::ostream &operator<<(std::ostream &out, ResourceMappingNodeType type);
 std::ostream &operator<<(std::ostream &out, NggSubgroupSizingType subgroupSizing);
 std::ostream &operator<<(std::ostream &out, NggCompactMode compactMode);
 std::ostream &operator<<(std::ostream &out, WaveBreakSize waveBreakSize);
+std::ostream &operator<<(std::ostream &out, TranscendentalPrecision precision);
+std::ostream &operator<<(std::ostream &out, WorkgroupSwizzle workgroupSwizzle);
+std::ostream &operator<<(std::ostream &out, ImageFormatHint hint);
 std::ostream &operator<<(std::ostream &out, ShadowDescriptorTableUsage shadowDescriptorTableUsage);
 
 template std::ostream &operator<<(std::ostream &out, ElfReader<Elf64> &reader);
 template raw_ostream &operator<<(raw_ostream &out, ElfReader<Elf64> &reader);
 template raw_fd_ostream &operator<<(raw_fd_ostream &out, ElfReader<Elf64> &reader);
+template std::ostream &dumpElfMetrics(std::ostream &out, ElfReader<Elf64> &reader);
+template raw_ostream &dumpElfMetrics(raw_ostream &out, ElfReader<Elf64> &reader);
+template raw_fd_ostream &dumpElfMetrics(raw_fd_ostream &out, ElfReader<Elf64> &reader);
 constexpr size_t ShaderModuleCacheHashOffset = offsetof(ShaderModuleData, cacheHash);
 
 // =====================================================================================================================
@@ -85,16 +95,122 @@ private:
 // Mutex for pipeline dump
 static Mutex SDumpMutex;
 
+// Maximum size of the dump file data waiting to be written, beyond which a compile thread waits for the writer
+static const size_t MaxQueuedDumpBytes = 64 * 1024 * 1024;
+
 // =====================================================================================================================
-// Represents the file objects for pipeline dump
-struct PipelineDumpFile {
-  PipelineDumpFile(const char *dumpFileName, const char *binaryFileName)
-      : dumpFile(dumpFileName), binaryIndex(0), binaryFileName(binaryFileName) {}
+// Represents a dump file waiting to be written
+struct DumpFileRequest {
+  std::string dumpDir;  // Directory of pipeline dump, created if needed
+  std::string pathName; // Path name of the file
+  std::string data;     // Contents of the file
+  bool isBinary;        // Whether to write the file in binary mode
+};
+
+// =====================================================================================================================
+// Background writer of pipeline dump files. Dump files are serialized into memory on the compile thread and written
+// by this writer's thread, so that a compile does not wait for disk I/O. The data waiting to be written is bounded by
+// MaxQueuedDumpBytes; a compile thread that would go over it waits for the writer to catch up.
+class DumpFileWriter {
+public:
+  DumpFileWriter() {}
+  ~DumpFileWriter();
+
+  void queueFile(DumpFileRequest request);
+
+private:
+  void run();
+
+  std::thread m_thread;                     // Writer thread, started on first use
+  std::mutex m_mutex;                       // Mutex for m_queue, m_queuedBytes and m_stop
+  std::condition_variable m_queueCondition; // Condition variable that wakes the writer thread
+  std::condition_variable m_spaceCondition; // Condition variable that wakes threads waiting for queue space
+  std::deque<DumpFileRequest> m_queue;      // Files waiting to be written
+  size_t m_queuedBytes = 0;                 // Total size of the data of the files waiting to be written
+  bool m_stop = false;                      // Whether the writer thread is to exit once the queue is empty
+};
+
+// =====================================================================================================================
+// Stops the writer thread, if it is running, after it has written all queued files.
+DumpFileWriter::~DumpFileWriter() {
+  if (!m_thread.joinable())
+    return;
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_queueCondition.notify_one();
+  m_thread.join();
+}
+
+// =====================================================================================================================
+// Queues a file to be written by the writer thread, waiting first if too much data is already queued.
+//
+// @param request : File to write
+void DumpFileWriter::queueFile(DumpFileRequest request) {
+  const size_t size = request.data.size();
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (!m_thread.joinable())
+      m_thread = std::thread([this] { run(); });
+
+    // A file bigger than the bound is still queued once everything before it has been written.
+    while (m_queuedBytes > 0 && m_queuedBytes + size > MaxQueuedDumpBytes)
+      m_spaceCondition.wait(lock);
 
-  std::ofstream dumpFile;     // File object for .pipe file
-  std::ofstream binaryFile;   // File object for ELF binary
-  unsigned binaryIndex;       // ELF Binary index
-  std::string binaryFileName; // File name of binary file
+    m_queuedBytes += size;
+    m_queue.push_back(std::move(request));
+  }
+  m_queueCondition.notify_one();
+}
+
+// =====================================================================================================================
+// Main loop of the writer thread.
+void DumpFileWriter::run() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (true) {
+    if (!m_queue.empty()) {
+      DumpFileRequest request = std::move(m_queue.front());
+      m_queue.pop_front();
+      lock.unlock();
+
+      createDirectory(request.dumpDir.c_str());
+      std::ofstream file(request.pathName.c_str(),
+                         request.isBinary ? (std::ios_base::binary | std::ios_base::out) : std::ios_base::out);
+      if (!file.bad())
+        file.write(request.data.data(), request.data.size());
+      file.close();
+
+      lock.lock();
+      m_queuedBytes -= request.data.size();
+      m_spaceCondition.notify_all();
+    } else if (m_stop)
+      break;
+    else
+      m_queueCondition.wait(lock);
+  }
+}
+
+// =====================================================================================================================
+// Gets the writer of pipeline dump files.
+static DumpFileWriter &getDumpFileWriter() {
+  static DumpFileWriter Writer;
+  return Writer;
+}
+
+// =====================================================================================================================
+// Represents the file objects for pipeline dump. The .pipe file is built in memory and queued to be written when the
+// dump ends.
+struct PipelineDumpFile {
+  PipelineDumpFile(const char *dumpDir, const char *dumpFileName, const char *binaryFileName)
+      : dumpDir(dumpDir), dumpFileName(dumpFileName), binaryIndex(0), binaryFileName(binaryFileName) {}
+
+  std::string dumpDir;         // Directory of pipeline dump
+  std::string dumpFileName;    // File name of .pipe file
+  std::ostringstream dumpFile; // Contents of .pipe file
+  unsigned binaryIndex;        // ELF Binary index
+  std::string binaryFileName;  // File name of binary file
 };
 
 // =====================================================================================================================
@@ -171,6 +287,17 @@ uint64_t VKAPI_CALL IPipelineDumper::GetPipelineHash(const GraphicsPipelineBuild
   auto hash = PipelineDumper::generateHashForGraphicsPipeline(pipelineInfo, false, false);
   return MetroHash::compact64(&hash);
 }
+
+// =====================================================================================================================
+// Calculates the hash code of a resource mapping, for use as PipelineShaderInfo::userDataNodesHash.
+//
+// @param userDataNodes : Root-level user data nodes of the resource mapping
+// @param nodeCount : Count of user data nodes
+uint64_t VKAPI_CALL IPipelineDumper::GetResourceMappingHash(const ResourceMappingNode *userDataNodes,
+                                                            unsigned nodeCount) {
+  return PipelineDumper::generateHashForResourceMappingNodes(userDataNodes, nodeCount, false);
+}
+
 // =====================================================================================================================
 // Get graphics pipeline name.
 //
@@ -297,11 +424,11 @@ PipelineDumpFile *PipelineDumper::BeginPipelineDump(const PipelineDumpOptions *d
     bool enableDump = true;
     SDumpMutex.lock();
 
-    // Create the dump directory
-    createDirectory(dumpOptions->pDumpDir);
-
-    // Build dump file name
+    // Build dump file name. The dump directory is created by the writer, when the first file is written.
     if (dumpOptions->dumpDuplicatePipelines) {
+      // Names of dump files already taken in this process, including those that are not written yet
+      static std::unordered_set<std::string> PathNames;
+
       unsigned index = 0;
       int result = 0;
       while (result != -1) {
@@ -316,9 +443,10 @@ PipelineDumpFile *PipelineDumper::BeginPipelineDump(const PipelineDumpOptions *d
         dumpBinaryName = dumpPathName + ".elf";
         dumpPathName += ".pipe";
         struct FILE_STAT fileStatus = {};
-        result = FILE_STAT(dumpPathName.c_str(), &fileStatus);
+        result = PathNames.count(dumpPathName) > 0 ? 0 : FILE_STAT(dumpPathName.c_str(), &fileStatus);
         ++index;
       };
+      PathNames.insert(dumpPathName);
     } else {
       static std::unordered_set<std::string> FileNames;
 
@@ -333,17 +461,12 @@ PipelineDumpFile *PipelineDumper::BeginPipelineDump(const PipelineDumpOptions *d
         enableDump = false;
     }
 
-    // Open dump file
-    if (enableDump) {
-      dumpFile = new PipelineDumpFile(dumpPathName.c_str(), dumpBinaryName.c_str());
-      if (dumpFile->dumpFile.bad()) {
-        delete dumpFile;
-        dumpFile = nullptr;
-      }
-    }
-
     SDumpMutex.unlock();
 
+    // Create dump file
+    if (enableDump)
+      dumpFile = new PipelineDumpFile(dumpOptions->pDumpDir, dumpPathName.c_str(), dumpBinaryName.c_str());
+
     // Dump pipeline input info
     if (dumpFile) {
       if (pipelineInfo.pComputeInfo)
@@ -359,10 +482,14 @@ PipelineDumpFile *PipelineDumper::BeginPipelineDump(const PipelineDumpOptions *d
 }
 
 // =====================================================================================================================
-// Ends to dump graphics/compute pipeline info.
+// Ends to dump graphics/compute pipeline info, queuing the .pipe file to be written.
 //
 // @param dumpFile : Dump file
 void PipelineDumper::EndPipelineDump(PipelineDumpFile *dumpFile) {
+  if (!dumpFile)
+    return;
+
+  getDumpFileWriter().queueFile({dumpFile->dumpDir, dumpFile->dumpFileName, dumpFile->dumpFile.str(), false});
   delete dumpFile;
 }
 
@@ -407,7 +534,8 @@ void PipelineDumper::dumpResourceMappingNode(const ResourceMappingNode *userData
   case ResourceMappingNodeType::StreamOutTableVaPtr: {
     break;
   }
-  case ResourceMappingNodeType::PushConst: {
+  case ResourceMappingNodeType::PushConst:
+  case ResourceMappingNodeType::InlineBuffer: {
     dumpFile << prefix << ".set = " << userDataNode->srdRange.set << "\n";
     dumpFile << prefix << ".binding = " << userDataNode->srdRange.binding << "\n";
     break;
@@ -482,6 +610,17 @@ void PipelineDumper::dumpPipelineShaderInfo(const PipelineShaderInfo *shaderInfo
     dumpFile << "\n";
   }
 
+  // Output image descriptor format hints
+  if (shaderInfo->formatHintCount > 0) {
+    for (unsigned i = 0; i < shaderInfo->formatHintCount; ++i) {
+      auto formatHint = &shaderInfo->pFormatHints[i];
+      dumpFile << "formatHint[" << i << "].set = " << formatHint->set << "\n";
+      dumpFile << "formatHint[" << i << "].binding = " << formatHint->binding << "\n";
+      dumpFile << "formatHint[" << i << "].hint = " << formatHint->hint << "\n";
+    }
+    dumpFile << "\n";
+  }
+
   // Output resource node mapping
   if (shaderInfo->userDataNodeCount > 0) {
     char prefixBuff[64];
@@ -517,12 +656,15 @@ void PipelineDumper::dumpPipelineShaderInfo(const PipelineShaderInfo *shaderInfo
   dumpFile << "options.unrollThreshold = " << shaderInfo->options.unrollThreshold << "\n";
   dumpFile << "options.scalarThreshold = " << shaderInfo->options.scalarThreshold << "\n";
   dumpFile << "options.disableLoopUnroll = " << shaderInfo->options.disableLoopUnroll << "\n";
+  dumpFile << "options.transcendentalPrecision = " << shaderInfo->options.transcendentalPrecision << "\n";
+  dumpFile << "options.workgroupSwizzle = " << shaderInfo->options.workgroupSwizzle << "\n";
 
   dumpFile << "\n";
 }
 
 // =====================================================================================================================
-// Dumps SPIR-V shader binary to external file
+// Dumps SPIR-V shader binary to external file. The file name is derived from the hash, so each shader is written
+// only once per process.
 //
 // @param dumpDir : Directory of pipeline dump
 // @param spirvBin : SPIR-V binary
@@ -532,10 +674,15 @@ void PipelineDumper::DumpSpirvBinary(const char *dumpDir, const BinaryData *spir
   pathName += "/";
   pathName += getSpirvBinaryFileName(hash);
 
-  // Open dumpfile
-  std::ofstream dumpFile(pathName.c_str(), std::ios_base::binary | std::ios_base::out);
-  if (!dumpFile.bad())
-    dumpFile.write(reinterpret_cast<const char *>(spirvBin->pCode), spirvBin->codeSize);
+  {
+    static std::unordered_set<std::string> PathNames;
+    std::lock_guard<Mutex> lock(SDumpMutex);
+    if (!PathNames.insert(pathName).second)
+      return;
+  }
+
+  std::string data(reinterpret_cast<const char *>(spirvBin->pCode), spirvBin->codeSize);
+  getDumpFileWriter().queueFile({dumpDir, std::move(pathName), std::move(data), true});
 }
 
 // =====================================================================================================================
@@ -559,6 +706,9 @@ void PipelineDumper::DumpPipelineBinary(PipelineDumpFile *dumpFile, GfxIpVersion
 
   dumpFile->dumpFile << "\n[CompileLog]\n";
   dumpFile->dumpFile << reader;
+  dumpFile->dumpFile << "PipelineMetrics: ";
+  dumpElfMetrics(dumpFile->dumpFile, reader);
+  dumpFile->dumpFile << "\n";
 
   std::string binaryFileName = dumpFile->binaryFileName;
   if (dumpFile->binaryIndex > 0) {
@@ -568,11 +718,8 @@ void PipelineDumper::DumpPipelineBinary(PipelineDumpFile *dumpFile, GfxIpVersion
   }
 
   dumpFile->binaryIndex++;
-  dumpFile->binaryFile.open(binaryFileName.c_str(), std::ostream::out | std::ostream::binary);
-  if (!dumpFile->binaryFile.bad()) {
-    dumpFile->binaryFile.write(reinterpret_cast<const char *>(pipelineBin->pCode), pipelineBin->codeSize);
-    dumpFile->binaryFile.close();
-  }
+  std::string data(reinterpret_cast<const char *>(pipelineBin->pCode), pipelineBin->codeSize);
+  getDumpFileWriter().queueFile({dumpFile->dumpDir, std::move(binaryFileName), std::move(data), true});
 }
 
 // =====================================================================================================================
@@ -627,6 +774,7 @@ void PipelineDumper::dumpPipelineOptions(const PipelineOptions *options, std::os
   dumpFile << "options.extendedRobustness.robustImageAccess = " << options->extendedRobustness.robustImageAccess
            << "\n";
   dumpFile << "options.extendedRobustness.nullDescriptor = " << options->extendedRobustness.nullDescriptor << "\n";
+  dumpFile << "options.fastCompile = " << options->fastCompile << "\n";
 }
 
 // =====================================================================================================================
@@ -705,6 +853,7 @@ void PipelineDumper::dumpGraphicsStateInfo(const GraphicsPipelineBuildInfo *pipe
   dumpFile << "nggState.subgroupSizing = " << pipelineInfo->nggState.subgroupSizing << "\n";
   dumpFile << "nggState.primsPerSubgroup = " << pipelineInfo->nggState.primsPerSubgroup << "\n";
   dumpFile << "nggState.vertsPerSubgroup = " << pipelineInfo->nggState.vertsPerSubgroup << "\n";
+  dumpFile << "nggState.enableAutoCulling = " << pipelineInfo->nggState.enableAutoCulling << "\n";
 
   dumpPipelineOptions(&pipelineInfo->options, dumpFile);
   dumpFile << "\n\n";
@@ -773,9 +922,11 @@ void PipelineDumper::dumpGraphicsPipelineInfo(std::ostream *dumpFile, const char
 // @param isCacheHash : TRUE if the hash is used by shader cache
 // @param isRelocatableShader : TRUE if we are building relocatable shader
 // @param stage : The stage for which we are building the hash. ShaderStageInvalid if building for the entire pipeline.
+// @param optionHash : Hash of the compilation options of the compiler, folded into a cache hash so that compilers with
+//                     different options do not share cache entries (nullptr if none)
 MetroHash::Hash PipelineDumper::generateHashForGraphicsPipeline(const GraphicsPipelineBuildInfo *pipeline,
                                                                 bool isCacheHash, bool isRelocatableShader,
-                                                                unsigned stage) {
+                                                                unsigned stage, const MetroHash::Hash *optionHash) {
   MetroHash64 hasher;
 
   switch (stage) {
@@ -814,7 +965,11 @@ MetroHash::Hash PipelineDumper::generateHashForGraphicsPipeline(const GraphicsPi
   }
 
   if (stage == ShaderStageFragment || stage == ShaderStageInvalid)
-    updateHashForFragmentState(pipeline, &hasher);
+    updateHashForFragmentState(pipeline, isCacheHash, &hasher,
+                               isRelocatableShader && stage == ShaderStageFragment);
+
+  if (isCacheHash && optionHash)
+    hasher.Update(*optionHash);
 
   MetroHash::Hash hash = {};
   hasher.Finalize(hash.bytes);
@@ -827,8 +982,12 @@ MetroHash::Hash PipelineDumper::generateHashForGraphicsPipeline(const GraphicsPi
 //
 // @param pipeline : Info to build a compute pipeline
 // @param isCacheHash : TRUE if the hash is used by shader cache
+// @param isRelocatableShader : TRUE if we are building relocatable shader
+// @param optionHash : Hash of the compilation options of the compiler, folded into a cache hash so that compilers with
+//                     different options do not share cache entries (nullptr if none)
 MetroHash::Hash PipelineDumper::generateHashForComputePipeline(const ComputePipelineBuildInfo *pipeline,
-                                                               bool isCacheHash, bool isRelocatableShader) {
+                                                               bool isCacheHash, bool isRelocatableShader,
+                                                               const MetroHash::Hash *optionHash) {
   MetroHash64 hasher;
 
   updateHashForPipelineShaderInfo(ShaderStageCompute, &pipeline->cs, isCacheHash, &hasher, isRelocatableShader);
@@ -842,6 +1001,10 @@ MetroHash::Hash PipelineDumper::generateHashForComputePipeline(const ComputePipe
   hasher.Update(pipeline->options.extendedRobustness.robustBufferAccess);
   hasher.Update(pipeline->options.extendedRobustness.robustImageAccess);
   hasher.Update(pipeline->options.extendedRobustness.nullDescriptor);
+  hasher.Update(pipeline->options.fastCompile);
+
+  if (isCacheHash && optionHash)
+    hasher.Update(*optionHash);
 
   MetroHash::Hash hash = {};
   hasher.Finalize(hash.bytes);
@@ -885,6 +1048,20 @@ void PipelineDumper::updateHashForVertexInputState(const VkPipelineVertexInputSt
 // @param [in,out] hasher : Hasher to generate hash code
 void PipelineDumper::updateHashForNonFragmentState(const GraphicsPipelineBuildInfo *pipeline, bool isCacheHash,
                                                    MetroHash64 *hasher) {
+  auto nggState = &pipeline->nggState;
+  bool enableNgg = nggState->enableNgg;
+  bool passthroughMode = !nggState->enableVertexReuse && !nggState->enableBackfaceCulling &&
+                         !nggState->enableFrustumCulling && !nggState->enableBoxFilterCulling &&
+                         !nggState->enableSphereCulling && !nggState->enableSmallPrimFilter &&
+                         !nggState->enableCullDistanceCulling && !nggState->enableAutoCulling;
+
+  // The rasterizer state and the viewport depth clip state do not affect the shader code unless NGG culling reads
+  // them, so they are left out of the cache hash otherwise. Those that set PAL metadata registers are set in an ELF
+  // from the cache by setMetadataOnlyRegisters in llpcCompiler.cpp; a field that does so may only be left out of the
+  // cache hash if it is handled there.
+  bool updateHashFromRs = (!isCacheHash);
+  updateHashFromRs |= (enableNgg && !passthroughMode);
+
   auto iaState = &pipeline->iaState;
   hasher->Update(iaState->topology);
   hasher->Update(iaState->patchControlPoints);
@@ -893,20 +1070,12 @@ void PipelineDumper::updateHashForNonFragmentState(const GraphicsPipelineBuildIn
   hasher->Update(iaState->enableMultiView);
 
   auto vpState = &pipeline->vpState;
-  hasher->Update(vpState->depthClipEnable);
+  if (updateHashFromRs)
+    hasher->Update(vpState->depthClipEnable);
 
   auto rsState = &pipeline->rsState;
-  hasher->Update(rsState->rasterizerDiscardEnable);
-
-  auto nggState = &pipeline->nggState;
-  bool enableNgg = nggState->enableNgg;
-  bool passthroughMode = !nggState->enableVertexReuse && !nggState->enableBackfaceCulling &&
-                         !nggState->enableFrustumCulling && !nggState->enableBoxFilterCulling &&
-                         !nggState->enableSphereCulling && !nggState->enableSmallPrimFilter &&
-                         !nggState->enableCullDistanceCulling;
-
-  bool updateHashFromRs = (!isCacheHash);
-  updateHashFromRs |= (enableNgg && !passthroughMode);
+  if (updateHashFromRs)
+    hasher->Update(rsState->rasterizerDiscardEnable);
 
   if (updateHashFromRs) {
     hasher->Update(rsState->usrClipPlaneMask);
@@ -934,6 +1103,7 @@ void PipelineDumper::updateHashForNonFragmentState(const GraphicsPipelineBuildIn
     hasher->Update(nggState->subgroupSizing);
     hasher->Update(nggState->primsPerSubgroup);
     hasher->Update(nggState->vertsPerSubgroup);
+    hasher->Update(nggState->enableAutoCulling);
 
     hasher->Update(pipeline->options.includeDisassembly);
     hasher->Update(pipeline->options.scalarBlockLayout);
@@ -945,6 +1115,7 @@ void PipelineDumper::updateHashForNonFragmentState(const GraphicsPipelineBuildIn
     hasher->Update(pipeline->options.extendedRobustness.robustBufferAccess);
     hasher->Update(pipeline->options.extendedRobustness.robustImageAccess);
     hasher->Update(pipeline->options.extendedRobustness.nullDescriptor);
+    hasher->Update(pipeline->options.fastCompile);
   }
 }
 
@@ -952,10 +1123,16 @@ void PipelineDumper::updateHashForNonFragmentState(const GraphicsPipelineBuildIn
 // Update hash code from fragment pipeline state
 //
 // @param pipeline : Info to build a graphics pipeline
+// @param isCacheHash : TRUE if the hash is used by shader cache
 // @param [in,out] hasher : Hasher to generate hash code
-void PipelineDumper::updateHashForFragmentState(const GraphicsPipelineBuildInfo *pipeline, MetroHash64 *hasher) {
+// @param isRelocatableShader : TRUE if we are building a relocatable fragment shader, whose color exports are done by
+//                              a color export shader that depends on the color target state
+void PipelineDumper::updateHashForFragmentState(const GraphicsPipelineBuildInfo *pipeline, bool isCacheHash,
+                                                MetroHash64 *hasher, bool isRelocatableShader) {
+  // Inner coverage only sets a PAL metadata register, which the compiler sets in an ELF from the cache.
   auto rsState = &pipeline->rsState;
-  hasher->Update(rsState->innerCoverage);
+  if (!isCacheHash)
+    hasher->Update(rsState->innerCoverage);
   hasher->Update(rsState->perSampleShading);
   hasher->Update(rsState->numSamples);
   hasher->Update(rsState->samplePatternIdx);
@@ -963,7 +1140,7 @@ void PipelineDumper::updateHashForFragmentState(const GraphicsPipelineBuildInfo
   auto cbState = &pipeline->cbState;
   hasher->Update(cbState->alphaToCoverageEnable);
   hasher->Update(cbState->dualSourceBlendEnable);
-  for (unsigned i = 0; i < MaxColorTargets; ++i) {
+  for (unsigned i = 0; i < MaxColorTargets && !isRelocatableShader; ++i) {
     if (cbState->target[i].format != VK_FORMAT_UNDEFINED) {
       hasher->Update(cbState->target[i].channelWriteMask);
       hasher->Update(cbState->target[i].blendEnable);
@@ -1031,12 +1208,24 @@ void PipelineDumper::updateHashForPipelineShaderInfo(ShaderStage stage, const Pi
       }
     }
 
+    hasher->Update(shaderInfo->formatHintCount);
+    for (unsigned i = 0; i < shaderInfo->formatHintCount; ++i) {
+      auto formatHint = &shaderInfo->pFormatHints[i];
+      hasher->Update(formatHint->set);
+      hasher->Update(formatHint->binding);
+      hasher->Update(formatHint->hint);
+    }
+
+    // The user data nodes are hashed as a sub-hash, so that the client can supply it precomputed once per layout.
+    // The relocatable hash excludes node offsets, so it cannot use the client's hash.
     hasher->Update(shaderInfo->userDataNodeCount);
     if (shaderInfo->userDataNodeCount > 0) {
-      for (unsigned i = 0; i < shaderInfo->userDataNodeCount; ++i) {
-        auto userDataNode = &shaderInfo->pUserDataNodes[i];
-        updateHashForResourceMappingNode(userDataNode, true, hasher, isRelocatableShader);
+      uint64_t userDataNodesHash = shaderInfo->userDataNodesHash;
+      if (userDataNodesHash == 0 || isRelocatableShader) {
+        userDataNodesHash = generateHashForResourceMappingNodes(shaderInfo->pUserDataNodes,
+                                                                shaderInfo->userDataNodeCount, isRelocatableShader);
       }
+      hasher->Update(userDataNodesHash);
     }
 
     if (isCacheHash) {
@@ -1064,10 +1253,29 @@ void PipelineDumper::updateHashForPipelineShaderInfo(ShaderStage stage, const Pi
       hasher->Update(options.unrollThreshold);
       hasher->Update(options.scalarThreshold);
       hasher->Update(options.disableLoopUnroll);
+      hasher->Update(options.transcendentalPrecision);
+      hasher->Update(options.workgroupSwizzle);
     }
   }
 }
 
+// =====================================================================================================================
+// Builds hash code for an array of root-level resource mapping nodes.
+//
+// @param userDataNodes : Root-level resource mapping nodes
+// @param nodeCount : Count of resource mapping nodes
+// @param isRelocatableShader : TRUE if we are building relocatable shader
+uint64_t PipelineDumper::generateHashForResourceMappingNodes(const ResourceMappingNode *userDataNodes,
+                                                             unsigned nodeCount, bool isRelocatableShader) {
+  MetroHash64 hasher;
+  for (unsigned i = 0; i < nodeCount; ++i)
+    updateHashForResourceMappingNode(&userDataNodes[i], true, &hasher, isRelocatableShader);
+
+  MetroHash::Hash hash = {};
+  hasher.Finalize(hash.bytes);
+  return MetroHash::compact64(&hash);
+}
+
 // =====================================================================================================================
 // Updates hash code context for resource mapping node.
 //
@@ -1113,6 +1321,10 @@ void PipelineDumper::updateHashForResourceMappingNode(const ResourceMappingNode
       hasher->Update(userDataNode->srdRange);
     break;
   }
+  case ResourceMappingNodeType::InlineBuffer: {
+    hasher->Update(userDataNode->srdRange);
+    break;
+  }
   default: {
     llvm_unreachable("Should never be called!");
     break;
@@ -1474,6 +1686,174 @@ OStream &operator<<(OStream &out, ElfReader<Elf> &reader) {
   return out;
 }
 
+// Represents the static code metrics of one hardware stage of a pipeline ELF.
+struct StageMetrics {
+  unsigned vgprCount;    // Number of VGPRs
+  unsigned sgprCount;    // Number of SGPRs
+  unsigned waveSize;     // Wavefront size
+  unsigned ldsSize;      // LDS size in bytes
+  unsigned scratchSize;  // Scratch memory size in bytes
+  unsigned valuCount;    // Number of VALU instructions
+  unsigned saluCount;    // Number of SALU instructions (including branches)
+  unsigned vmemCount;    // Number of vector memory instructions (buffer, image, global, flat and scratch)
+  unsigned smemCount;    // Number of scalar memory instructions
+  unsigned ldsCount;     // Number of LDS instructions
+  unsigned exportCount;  // Number of export instructions
+  unsigned waitcntCount; // Number of s_waitcnt instructions
+  unsigned instCount;    // Total number of instructions
+};
+
+// =====================================================================================================================
+// Gets an unsigned integer from a MsgPack map, or 0 if it is not there.
+//
+// @param map : MsgPack map
+// @param key : Key of the entry
+static unsigned getMsgPackUInt(msgpack::MapDocNode &map, StringRef key) {
+  auto it = map.find(key);
+  if (it == map.end())
+    return 0;
+  if (it->second.getKind() == msgpack::Type::UInt)
+    return static_cast<unsigned>(it->second.getUInt());
+  if (it->second.getKind() == msgpack::Type::Int)
+    return static_cast<unsigned>(it->second.getInt());
+  return 0;
+}
+
+// =====================================================================================================================
+// Gets the number of waves per SIMD that the register usage of a hardware stage allows.
+//
+// @param gfxIp : Graphics IP version info
+// @param metrics : Metrics of the hardware stage
+static unsigned getOccupancy(GfxIpVersion gfxIp, const StageMetrics &metrics) {
+  unsigned vgprCount = std::max(metrics.vgprCount, 1U);
+  if (gfxIp.major >= 10) {
+    // A SIMD32 has 1024 VGPRs per lane, allocated in blocks of 8; a wave64 uses two lanes' worth.
+    unsigned maxWaves = metrics.waveSize == 32 ? 20 : 10;
+    unsigned vgprWaves = (metrics.waveSize == 32 ? 1024 : 512) / alignTo(vgprCount, 8);
+    return std::max(std::min(maxWaves, vgprWaves), 1U);
+  }
+
+  unsigned sgprCount = std::max(metrics.sgprCount, 1U);
+  unsigned vgprWaves = 256 / alignTo(vgprCount, 4);
+  unsigned sgprWaves = gfxIp.major >= 8 ? 800 / alignTo(sgprCount, 16) : 512 / alignTo(sgprCount, 8);
+  return std::max(std::min(10U, std::min(vgprWaves, sgprWaves)), 1U);
+}
+
+// =====================================================================================================================
+// Counts one instruction of the disassembly into the metrics of its hardware stage.
+//
+// @param mnemonic : Mnemonic of the instruction
+// @param [in,out] metrics : Metrics of the hardware stage
+static void countInstruction(StringRef mnemonic, StageMetrics &metrics) {
+  ++metrics.instCount;
+  if (mnemonic.startswith("s_waitcnt")) {
+    ++metrics.waitcntCount;
+    ++metrics.saluCount;
+  } else if (mnemonic.startswith("buffer_") || mnemonic.startswith("tbuffer_") || mnemonic.startswith("image_") ||
+             mnemonic.startswith("global_") || mnemonic.startswith("flat_") || mnemonic.startswith("scratch_"))
+    ++metrics.vmemCount;
+  else if (mnemonic.startswith("s_load_") || mnemonic.startswith("s_buffer_load_") ||
+           mnemonic.startswith("s_store_") || mnemonic.startswith("s_buffer_store_") ||
+           mnemonic.startswith("s_dcache_") || mnemonic.startswith("s_memtime") ||
+           mnemonic.startswith("s_memrealtime"))
+    ++metrics.smemCount;
+  else if (mnemonic.startswith("ds_"))
+    ++metrics.ldsCount;
+  else if (mnemonic == "exp" || mnemonic.startswith("exp_"))
+    ++metrics.exportCount;
+  else if (mnemonic.startswith("v_"))
+    ++metrics.valuCount;
+  else if (mnemonic.startswith("s_"))
+    ++metrics.saluCount;
+}
+
+// =====================================================================================================================
+// Dumps the static code metrics of ELF package to out stream, as one JSON object with an entry for each hardware
+// stage. Register counts, LDS and scratch sizes come from the PAL metadata; instruction counts come from the
+// disassembly, so they are only present if the ELF includes it (see PipelineOptions::includeDisassembly).
+//
+// @param [out] out : Output stream
+// @param reader : ELF object
+template <class OStream, class Elf> OStream &dumpElfMetrics(OStream &out, ElfReader<Elf> &reader) {
+  std::map<std::string, StageMetrics> stages;
+
+  if (reader.isSectionPresent(NoteName)) {
+    ElfNote note = reader.getNote(Util::Abi::PipelineAbiNoteType::PalMetadata);
+    msgpack::Document document;
+    if (note.data &&
+        document.readFromBlob(StringRef(reinterpret_cast<const char *>(note.data), note.hdr.descSize), false) &&
+        document.getRoot().isMap()) {
+      auto &root = document.getRoot().getMap();
+      auto pipelines = root.find("amdpal.pipelines");
+      if (pipelines != root.end() && pipelines->second.isArray() && !pipelines->second.getArray().empty() &&
+          pipelines->second.getArray()[0].isMap()) {
+        auto &pipeline = pipelines->second.getArray()[0].getMap();
+        auto hwStages = pipeline.find(".hardware_stages");
+        if (hwStages != pipeline.end() && hwStages->second.isMap()) {
+          for (auto &hwStage : hwStages->second.getMap()) {
+            if (!hwStage.first.isString() || !hwStage.second.isMap())
+              continue;
+            auto &stageMap = hwStage.second.getMap();
+            StageMetrics &metrics = stages[hwStage.first.getString().ltrim('.').str()];
+            metrics.vgprCount = getMsgPackUInt(stageMap, ".vgpr_count");
+            metrics.sgprCount = getMsgPackUInt(stageMap, ".sgpr_count");
+            metrics.waveSize = getMsgPackUInt(stageMap, ".wavefront_size");
+            metrics.ldsSize = getMsgPackUInt(stageMap, ".lds_size");
+            metrics.scratchSize = getMsgPackUInt(stageMap, ".scratch_memory_size");
+          }
+        }
+      }
+    }
+  }
+
+  const void *disasmData = nullptr;
+  size_t disasmSize = 0;
+  bool hasDisasm = reader.GetSectionData(AmdGpuDisasmName, &disasmData, &disasmSize) == Result::Success;
+  if (hasDisasm) {
+    // Instructions are counted into the stage of the last "_amdgpu_<stage>_..." label before them, so that code of
+    // subfunctions is counted into the stage that calls them.
+    StageMetrics *metrics = nullptr;
+    SmallVector<StringRef, 64> lines;
+    StringRef(reinterpret_cast<const char *>(disasmData), disasmSize).split(lines, '\n', -1, false);
+    for (StringRef line : lines) {
+      line = line.split(';').first.split("//").first.trim();
+      if (line.empty() || line.startswith("."))
+        continue;
+      if (line.endswith(":")) {
+        if (line.startswith("_amdgpu_")) {
+          StringRef stageName = line.drop_front(sizeof("_amdgpu_") - 1).split('_').first;
+          metrics = &stages[stageName.str()];
+        }
+        continue;
+      }
+      if (metrics)
+        countInstruction(line.split(' ').first.split('\t').first, *metrics);
+    }
+  }
+
+  out << "{";
+  bool first = true;
+  for (const auto &stage : stages) {
+    const StageMetrics &metrics = stage.second;
+    out << (first ? "" : ", ") << "\"" << stage.first << "\": {";
+    out << "\"vgprs\": " << metrics.vgprCount << ", \"sgprs\": " << metrics.sgprCount;
+    out << ", \"waveSize\": " << metrics.waveSize
+        << ", \"occupancy\": " << getOccupancy(reader.getGfxIpVersion(), metrics);
+    out << ", \"ldsBytes\": " << metrics.ldsSize << ", \"scratchBytes\": " << metrics.scratchSize;
+    if (hasDisasm) {
+      out << ", \"instructions\": " << metrics.instCount << ", \"valu\": " << metrics.valuCount
+          << ", \"salu\": " << metrics.saluCount << ", \"vmem\": " << metrics.vmemCount
+          << ", \"smem\": " << metrics.smemCount << ", \"lds\": " << metrics.ldsCount
+          << ", \"export\": " << metrics.exportCount << ", \"waitcnt\": " << metrics.waitcntCount;
+    }
+    out << "}";
+    first = false;
+  }
+  out << "}";
+
+  return out;
+}
+
 // =====================================================================================================================
 // Assistant macros for pipeline dump
 #define CASE_CLASSENUM_TO_STRING(TYPE, ENUM)                                                                           \
@@ -1576,6 +1956,67 @@ std::ostream &operator<<(std::ostream &out, WaveBreakSize waveBreakSize) {
   return out << string;
 }
 
+// =====================================================================================================================
+// Translates enum "TranscendentalPrecision" to string and output to ostream.
+//
+// @param [out] out : Output stream
+// @param precision : Transcendental precision tier
+std::ostream &operator<<(std::ostream &out, TranscendentalPrecision precision) {
+  const char *string = nullptr;
+  switch (precision) {
+    CASE_CLASSENUM_TO_STRING(TranscendentalPrecision, Accurate)
+    CASE_CLASSENUM_TO_STRING(TranscendentalPrecision, Relaxed)
+    CASE_CLASSENUM_TO_STRING(TranscendentalPrecision, Fast)
+    break;
+  default:
+    llvm_unreachable("Should never be called!");
+    break;
+  }
+
+  return out << string;
+}
+
+// =====================================================================================================================
+// Translates enum "WorkgroupSwizzle" to string and output to ostream.
+//
+// @param [out] out : Output stream
+// @param workgroupSwizzle : Compute shader thread swizzle setting
+std::ostream &operator<<(std::ostream &out, WorkgroupSwizzle workgroupSwizzle) {
+  const char *string = nullptr;
+  switch (workgroupSwizzle) {
+    CASE_CLASSENUM_TO_STRING(WorkgroupSwizzle, Default)
+    CASE_CLASSENUM_TO_STRING(WorkgroupSwizzle, Auto)
+    CASE_CLASSENUM_TO_STRING(WorkgroupSwizzle, Enable)
+    CASE_CLASSENUM_TO_STRING(WorkgroupSwizzle, Disable)
+    break;
+  default:
+    llvm_unreachable("Should never be called!");
+    break;
+  }
+
+  return out << string;
+}
+
+// =====================================================================================================================
+// Translates enum "ImageFormatHint" to string and output to ostream.
+//
+// @param [out] out : Output stream
+// @param hint : Image descriptor format hint
+std::ostream &operator<<(std::ostream &out, ImageFormatHint hint) {
+  const char *string = nullptr;
+  switch (hint) {
+    CASE_CLASSENUM_TO_STRING(ImageFormatHint, Unknown)
+    CASE_CLASSENUM_TO_STRING(ImageFormatHint, Channel32)
+    CASE_CLASSENUM_TO_STRING(ImageFormatHint, NonChannel32)
+    break;
+  default:
+    llvm_unreachable("Should never be called!");
+    break;
+  }
+
+  return out << string;
+}
+
 // =====================================================================================================================
 // Translates enum "ShadowDescriptorTableUsage" to string and output to ostream.
 //
@@ -77,16 +77,21 @@ public:
   static void DumpPipelineExtraInfo(PipelineDumpFile *binaryFile, const std::string *str);
 
   static MetroHash::Hash generateHashForGraphicsPipeline(const GraphicsPipelineBuildInfo *pipeline, bool isCacheHash,
-                                                         bool isRelocatableShader, unsigned stage = ShaderStageInvalid);
+                                                         bool isRelocatableShader, unsigned stage = ShaderStageInvalid,
+                                                         const MetroHash::Hash *optionHash = nullptr);
 
   static MetroHash::Hash generateHashForComputePipeline(const ComputePipelineBuildInfo *pipeline, bool isCacheHash,
-                                                        bool isRelocatableShader);
+                                                        bool isRelocatableShader,
+                                                        const MetroHash::Hash *optionHash = nullptr);
 
   static std::string getPipelineInfoFileName(PipelineBuildInfo pipelineInfo, const MetroHash::Hash *hash);
 
   static void updateHashForPipelineShaderInfo(ShaderStage stage, const PipelineShaderInfo *shaderInfo, bool isCacheHash,
                                               MetroHash64 *hasher, bool isRelocatableShader);
 
+  static uint64_t generateHashForResourceMappingNodes(const ResourceMappingNode *userDataNodes, unsigned nodeCount,
+                                                     bool isRelocatableShader);
+
   static void updateHashForVertexInputState(const VkPipelineVertexInputStateCreateInfo *vertexInput,
                                             MetroHash64 *hasher);
 
@@ -102,7 +107,8 @@ public:
   static void updateHashForNonFragmentState(const GraphicsPipelineBuildInfo *pipeline, bool isCacheHash,
                                             MetroHash64 *hasher);
 
-  static void updateHashForFragmentState(const GraphicsPipelineBuildInfo *pipeline, MetroHash64 *hasher);
+  static void updateHashForFragmentState(const GraphicsPipelineBuildInfo *pipeline, bool isCacheHash,
+                                         MetroHash64 *hasher, bool isRelocatableShader);
 
   // Get name of register, or "" if not known
   static const char *getRegisterNameString(unsigned regNumber);
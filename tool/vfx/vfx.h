@@ -598,6 +598,8 @@ void VFXAPI vfxGetRenderDoc(void *pDoc, VfxRenderStatePtr *pRenderState);
 
 #if VFX_SUPPORT_VK_PIPELINE
 void VFXAPI vfxGetPipelineDoc(void *pDoc, VfxPipelineStatePtr *pPipelineState);
+
+bool VFXAPI vfxWritePipelineBinary(void *pDoc, const char *pFilename, const char **ppErrorMsg);
 #endif
 
 void VFXAPI vfxPrintDoc(void *pDoc);
@@ -94,6 +94,9 @@ bool isArrayAccess(const char *str);
 // in the string
 char *getWordFromString(char *str, char *wordBuffer);
 
+// Splits the next token from a string, like strtok() but reentrant.
+char *splitString(char *str, const char *delimiters, char **savePtr);
+
 // =====================================================================================================================
 Document::~Document() {
   for (unsigned i = 0; i < SectionTypeNameNum; ++i) {
@@ -189,7 +192,7 @@ bool Document::parseLine(char *line) {
     if (result)
       result = beginSection(line);
   } else
-    m_currentSectionStringBuffer << line;
+    m_currentSectionStringBuffer += line;
 
   return result;
 }
@@ -211,12 +214,12 @@ bool Document::beginSection(char *line) {
 
   if (result) {
     line = line + 1;
-    char *sectionName = strtok(line, ",");
+    char *savePtr = nullptr;
+    char *sectionName = splitString(line, ",", &savePtr);
     m_currentSection = getFreeSection(sectionName);
     if (m_currentSection) {
       // Next line is the first line of section content.
       m_currentSectionLineNum = m_currentLineNum + 1;
-      m_currentSectionStringBuffer.str("");
       m_currentSectionStringBuffer.clear();
       m_currentSection->setLineNum(m_currentLineNum);
     }
@@ -251,20 +254,23 @@ bool Document::endSection() {
 }
 
 // =====================================================================================================================
-// Parses a line of a pre-defined key-value section.
+// Parses the lines of a pre-defined key-value section. The lines are split in place in the section string buffer.
 bool Document::parseSectionKeyValues() {
   bool result = true;
 
   // Set line number variable which is used in error report.
   unsigned lineNum = m_currentSectionLineNum;
-  char lineBuffer[MaxLineBufSize];
-  while (true) {
-    m_currentSectionStringBuffer.getline(lineBuffer, MaxLineBufSize);
+  char *pos = &m_currentSectionStringBuffer[0];
+  char *end = pos + m_currentSectionStringBuffer.size();
+  while (pos < end) {
+    char *lineBuffer = pos;
+    char *lineEnd = static_cast<char *>(memchr(pos, '\n', end - pos));
+    if (lineEnd) {
+      *lineEnd = '\0';
+      pos = lineEnd + 1;
+    } else
+      pos = end;
 
-    size_t readCount = static_cast<size_t>(m_currentSectionStringBuffer.gcount());
-    VFX_ASSERT(readCount < MaxLineBufSize);
-    if (readCount == 0)
-      break;
     if (lineBuffer[0] == '\0' || memcmp(lineBuffer, "\r", 2) == 0) {
       // Skip empty line
       continue;
@@ -310,7 +316,8 @@ bool Document::parseKey(const char *key, unsigned lineNum, Section *sectionObjec
   Section *tempSectionObj = sectionObjectIn;
 
   // Process member access
-  char *keyTok = strtok(keyBuffer, ".");
+  char *savePtr = nullptr;
+  char *keyTok = splitString(keyBuffer, ".", &savePtr);
   keyTok = trimStringBeginning(keyTok);
   keyTok = trimStringEnd(keyTok);
 
@@ -342,7 +349,7 @@ bool Document::parseKey(const char *key, unsigned lineNum, Section *sectionObjec
         break;
     }
 
-    keyTok = strtok(nullptr, ".");
+    keyTok = splitString(nullptr, ".", &savePtr);
   }
 
   if (arrayIndex)
@@ -503,21 +510,10 @@ bool Document::parseKeyValue(char *key, char *valueStr, unsigned lineNum, Sectio
 // =====================================================================================================================
 // Parses shader source section.
 void Document::parseSectionShaderSource() {
-  char lineBuffer[MaxLineBufSize];
-
-  while (true) {
-    m_currentSectionStringBuffer.getline(lineBuffer, MaxLineBufSize);
-
-    size_t readCount = static_cast<size_t>(m_currentSectionStringBuffer.gcount());
-    VFX_ASSERT(readCount < MaxLineBufSize);
-    if (readCount == 0)
-      break;
-
-    // Line ending is not returned by getline(), so append them manually.
-    lineBuffer[readCount - 1] = '\n';
-    lineBuffer[readCount] = '\0';
-    m_currentSection->addLine(lineBuffer);
-  }
+  // The section string buffer holds the source lines with their line endings, so it is added in one go.
+  if (!m_currentSectionStringBuffer.empty() && m_currentSectionStringBuffer.back() != '\n')
+    m_currentSectionStringBuffer += '\n';
+  m_currentSection->addLine(m_currentSectionStringBuffer.c_str());
 }
 
 // =====================================================================================================================
@@ -528,30 +524,58 @@ void Document::parseSectionShaderSource() {
 bool Document::parse(const TestCaseInfo &info) {
   bool result = true;
 
+  // Read the whole file at once. In text mode, fewer bytes than the file size may be read.
+  std::string fileContent;
   FILE *configFile = fopen(info.vfxFile.c_str(), "r");
+  bool fileRead = configFile != nullptr;
   if (configFile) {
+    if (fseek(configFile, 0, SEEK_END) == 0) {
+      long fileSize = ftell(configFile);
+      if (fileSize > 0 && fseek(configFile, 0, SEEK_SET) == 0) {
+        fileContent.resize(static_cast<size_t>(fileSize));
+        fileContent.resize(fread(&fileContent[0], 1, fileContent.size(), configFile));
+      }
+    }
+    fclose(configFile);
+  }
+
+  if (fileRead) {
     setFileName(info.vfxFile);
+
+    // Parse the lines in place, each temporarily terminated after its line ending. A line is only copied if there are
+    // macros to substitute into it. The extra null character is where the last line is terminated.
     char lineBuf[MaxLineBufSize];
-    char *linePtr = nullptr;
+    fileContent.push_back('\0');
+    char *pos = &fileContent[0];
+    char *end = pos + fileContent.size() - 1;
+    while (result && pos < end) {
+      char *lineEnd = static_cast<char *>(memchr(pos, '\n', end - pos));
+      lineEnd = lineEnd ? lineEnd + 1 : end;
+      char *line = pos;
+      const char nextChar = *lineEnd;
+      *lineEnd = '\0';
+
+      if (!info.macros.empty()) {
+        const size_t lineLen = lineEnd - pos;
+        if (lineLen >= MaxLineBufSize) {
+          PARSE_ERROR(m_errorMsg, m_currentLineNum + 1, "Line length exceeds MaxLineBufSize.");
+          result = false;
+        } else {
+          memcpy(lineBuf, pos, lineLen + 1);
+          line = lineBuf;
+          result = macroSubstituteLine(line, m_currentLineNum + 1, &info.macros, MaxLineBufSize);
+        }
+      }
 
-    while (true) {
-      linePtr = fgets(lineBuf, MaxLineBufSize, configFile);
+      if (result)
+        result = parseLine(line);
 
-      if (!linePtr) {
-        result = endSection();
-        break;
-      } else {
-        result = macroSubstituteLine(linePtr, m_currentLineNum + 1, &info.macros, MaxLineBufSize);
-        if (!result)
-          break;
-
-        result = parseLine(linePtr);
-        if (!result)
-          break;
-      }
+      *lineEnd = nextChar;
+      pos = lineEnd;
     }
 
-    fclose(configFile);
+    if (result)
+      result = endSection();
 
     if (result)
       result = validate();
@@ -760,7 +784,8 @@ bool parseIVec4(char *str, unsigned lineNum, IUFValue *output) {
   if (p0x)
     isHex = true;
 
-  char *number = strtok(str, ", ");
+  char *savePtr = nullptr;
+  char *number = splitString(str, ", ", &savePtr);
   unsigned numberId = 0;
   while (number) {
     result = true;
@@ -769,7 +794,7 @@ bool parseIVec4(char *str, unsigned lineNum, IUFValue *output) {
       output->uVec4[numberId] = strtoul(number, nullptr, 0);
     else
       output->iVec4[numberId] = strtol(number, nullptr, 0);
-    number = strtok(nullptr, ", ");
+    number = splitString(nullptr, ", ", &savePtr);
     ++numberId;
   }
 
@@ -798,7 +823,8 @@ bool parseI64Vec2(char *str, unsigned lineNum, IUFValue *output) {
   if (p0x)
     isHex = true;
 
-  char *number = strtok(str, ", ");
+  char *savePtr = nullptr;
+  char *number = splitString(str, ", ", &savePtr);
   unsigned numberId = 0;
   while (number) {
     result = true;
@@ -807,7 +833,7 @@ bool parseI64Vec2(char *str, unsigned lineNum, IUFValue *output) {
       output->i64Vec2[numberId] = strtoull(number, nullptr, 0);
     else
       output->i64Vec2[numberId] = strtoll(number, nullptr, 0);
-    number = strtok(nullptr, ", ");
+    number = splitString(nullptr, ", ", &savePtr);
     ++numberId;
   }
 
@@ -831,7 +857,8 @@ bool parseFVec4(char *str, unsigned lineNum, IUFValue *output) {
   VFX_ASSERT(output);
   bool result = false;
 
-  char *number = strtok(str, ", ");
+  char *savePtr = nullptr;
+  char *number = splitString(str, ", ", &savePtr);
   unsigned numberId = 0;
   while (number) {
     result = true;
@@ -839,7 +866,7 @@ bool parseFVec4(char *str, unsigned lineNum, IUFValue *output) {
 
     output->fVec4[numberId] = static_cast<float>(strtod(number, nullptr));
 
-    number = strtok(nullptr, ", ");
+    number = splitString(nullptr, ", ", &savePtr);
     ++numberId;
   }
 
@@ -862,7 +889,8 @@ bool parseF16Vec4(char *str, unsigned lineNum, IUFValue *output) {
   VFX_ASSERT(output);
   bool result = false;
 
-  char *number = strtok(str, ", ");
+  char *savePtr = nullptr;
+  char *number = splitString(str, ", ", &savePtr);
   unsigned numberId = 0;
   while (number) {
     result = true;
@@ -873,7 +901,7 @@ bool parseF16Vec4(char *str, unsigned lineNum, IUFValue *output) {
     v16.FromFloat32(v);
     output->f16Vec4[numberId] = v16;
 
-    number = strtok(nullptr, ", ");
+    number = splitString(nullptr, ", ", &savePtr);
     ++numberId;
   }
 
@@ -897,7 +925,8 @@ bool parseDVec2(char *str, unsigned lineNum, IUFValue *output) {
   VFX_ASSERT(output);
   bool result = false;
 
-  char *number = strtok(str, ", ");
+  char *savePtr = nullptr;
+  char *number = splitString(str, ", ", &savePtr);
   unsigned numberId = 0;
   while (number) {
     result = true;
@@ -905,7 +934,7 @@ bool parseDVec2(char *str, unsigned lineNum, IUFValue *output) {
 
     output->dVec2[numberId] = strtod(number, nullptr);
 
-    number = strtok(nullptr, ", ");
+    number = splitString(nullptr, ", ", &savePtr);
     ++numberId;
   }
 
@@ -928,7 +957,8 @@ bool parseDVec2(char *str, unsigned lineNum, IUFValue *output) {
 bool parseIArray(char *str, unsigned lineNum, bool isSign, std::vector<uint8_t> &bufMem) {
   bool result = true;
 
-  char *number = strtok(str, ", ");
+  char *savePtr = nullptr;
+  char *number = splitString(str, ", ", &savePtr);
   while (number) {
     bool isHex = false;
     char *p0x = strstr(number, "0x");
@@ -950,7 +980,7 @@ bool parseIArray(char *str, unsigned lineNum, bool isSign, std::vector<uint8_t>
     for (unsigned i = 0; i < sizeof(val); ++i)
       bufMem.push_back(val[i]);
 
-    number = strtok(nullptr, ", ");
+    number = splitString(nullptr, ", ", &savePtr);
   }
 
   return result;
@@ -967,7 +997,8 @@ bool parseIArray(char *str, unsigned lineNum, bool isSign, std::vector<uint8_t>
 bool parseI64Array(char *str, unsigned lineNum, bool isSign, std::vector<uint8_t> &bufMem) {
   bool result = true;
 
-  char *number = strtok(str, ", ");
+  char *savePtr = nullptr;
+  char *number = splitString(str, ", ", &savePtr);
   while (number) {
     bool isHex = false;
     char *p0x = strstr(number, "0x");
@@ -990,7 +1021,7 @@ bool parseI64Array(char *str, unsigned lineNum, bool isSign, std::vector<uint8_t
     for (unsigned i = 0; i < sizeof(val); ++i)
       bufMem.push_back(val[i]);
 
-    number = strtok(nullptr, ", ");
+    number = splitString(nullptr, ", ", &savePtr);
   }
 
   return result;
@@ -1006,7 +1037,8 @@ bool parseI64Array(char *str, unsigned lineNum, bool isSign, std::vector<uint8_t
 bool parseFArray(char *str, unsigned lineNum, std::vector<uint8_t> &bufMem) {
   bool result = true;
 
-  char *number = strtok(str, ", ");
+  char *savePtr = nullptr;
+  char *number = splitString(str, ", ", &savePtr);
   while (number) {
     union {
       float fVal;
@@ -1019,7 +1051,7 @@ bool parseFArray(char *str, unsigned lineNum, std::vector<uint8_t> &bufMem) {
     for (unsigned i = 0; i < sizeof(val); ++i)
       bufMem.push_back(val[i]);
 
-    number = strtok(nullptr, ", ");
+    number = splitString(nullptr, ", ", &savePtr);
   }
 
   return result;
@@ -1035,7 +1067,8 @@ bool parseFArray(char *str, unsigned lineNum, std::vector<uint8_t> &bufMem) {
 bool parseF16Array(char *str, unsigned lineNum, std::vector<uint8_t> &bufMem) {
   bool result = true;
 
-  char *number = strtok(str, ", ");
+  char *savePtr = nullptr;
+  char *number = splitString(str, ", ", &savePtr);
   while (number) {
     union {
       Float16Bits fVal;
@@ -1051,7 +1084,7 @@ bool parseF16Array(char *str, unsigned lineNum, std::vector<uint8_t> &bufMem) {
     for (unsigned i = 0; i < sizeof(val); ++i)
       bufMem.push_back(val[i]);
 
-    number = strtok(nullptr, ", ");
+    number = splitString(nullptr, ", ", &savePtr);
   }
 
   return result;
@@ -1067,7 +1100,8 @@ bool parseF16Array(char *str, unsigned lineNum, std::vector<uint8_t> &bufMem) {
 bool parseDArray(char *str, unsigned lineNum, std::vector<uint8_t> &bufMem) {
   bool result = true;
 
-  char *number = strtok(str, ", ");
+  char *savePtr = nullptr;
+  char *number = splitString(str, ", ", &savePtr);
   while (number) {
     union {
       double dVal;
@@ -1080,7 +1114,7 @@ bool parseDArray(char *str, unsigned lineNum, std::vector<uint8_t> &bufMem) {
     for (unsigned i = 0; i < sizeof(val); ++i)
       bufMem.push_back(val[i]);
 
-    number = strtok(nullptr, ", ");
+    number = splitString(nullptr, ", ", &savePtr);
   }
 
   return result;
@@ -1102,7 +1136,8 @@ bool parseBinding(char *str, unsigned lineNum, IUFValue *output) {
   if (p0x)
     isHex = true;
 
-  char *number = strtok(str, ", ");
+  char *savePtr = nullptr;
+  char *number = splitString(str, ", ", &savePtr);
   unsigned numberId = 0;
   while (number) {
     result = true;
@@ -1117,7 +1152,7 @@ bool parseBinding(char *str, unsigned lineNum, IUFValue *output) {
       else
         output->iVec4[numberId] = strtol(number, nullptr, 0);
     }
-    number = strtok(nullptr, ", ");
+    number = splitString(nullptr, ", ", &savePtr);
     ++numberId;
   }
 
@@ -1304,6 +1339,33 @@ char *getWordFromString(char *str, char *wordBuffer) {
   return strlen(wordBuffer) == 0 ? nullptr : p;
 }
 
+// =====================================================================================================================
+// Splits the next token from a string, like strtok(), but with the position kept in savePtr rather than in static
+// state, so that documents can be parsed on several threads at once. Returns nullptr if there are no more tokens.
+//
+// @param str : String to split, or nullptr to continue splitting the previous string
+// @param delimiters : Delimiter characters
+// @param [in,out] savePtr : Position in the string being split
+char *splitString(char *str, const char *delimiters, char **savePtr) {
+  char *token = str ? str : *savePtr;
+  if (!token)
+    return nullptr;
+
+  token += strspn(token, delimiters);
+  if (*token == '\0') {
+    *savePtr = nullptr;
+    return nullptr;
+  }
+
+  char *tokenEnd = token + strcspn(token, delimiters);
+  if (*tokenEnd != '\0') {
+    *tokenEnd = '\0';
+    *savePtr = tokenEnd + 1;
+  } else
+    *savePtr = nullptr;
+  return token;
+}
+
 // =====================================================================================================================
 // Substitutes marcros for 1 line.
 // Returns false if line length after substitution exceeds MaxLineBufSize
@@ -1372,7 +1434,13 @@ bool VFXAPI vfxParseFile(const char *filename, unsigned int numMacro, const char
     testCase.macros[macros[2 * i]] = macros[2 * i + 1];
 
   Document *doc = Document::createDocument(type);
-  bool ret = doc->parse(testCase);
+  bool ret = false;
+#if VFX_SUPPORT_VK_PIPELINE
+  if (type == VfxDocTypePipeline && PipelineDocument::isBinaryFile(filename))
+    ret = static_cast<PipelineDocument *>(doc)->parseBinary(filename);
+  else
+#endif
+    ret = doc->parse(testCase);
 
   *ppDoc = doc;
   *ppErrorMsg = doc->getErrorMsg()->c_str();
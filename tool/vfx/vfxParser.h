@@ -33,9 +33,9 @@
 
 #include "vfxSection.h"
 #include <map>
-#include <sstream>
 #include <stddef.h>
 #include <string.h>
+#include <string>
 #include <vector>
 
 namespace Vfx {
@@ -104,7 +104,7 @@ protected:
   bool m_isValidVfxFile;                          // If VFX file is valid
   Section *m_currentSection;                      // Current section
   unsigned m_currentLineNum;                      // Current line number
-  std::stringstream m_currentSectionStringBuffer; // Current section string buffer
+  std::string m_currentSectionStringBuffer;        // Current section string buffer
   unsigned m_currentSectionLineNum;               // Current section line number
 };
 
@@ -0,0 +1,481 @@
+/*
+ ***********************************************************************************************************************
+ *
+ *  Copyright (c) 2020 Advanced Micro Devices, Inc. All Rights Reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ **********************************************************************************************************************/
+/**
+***********************************************************************************************************************
+* @file  vfxPipelineBinary.cpp
+* @brief Contains the binary form of PipelineDocument
+*
+* A binary pipeline file holds a VfxPipelineState as it is in memory, followed by everything it points to: the
+* SPIR-V of the shader stages, the user data nodes, the vertex input state and so on. Each pointer is stored as the
+* offset of its data from the start of the file. Loading reads the file into one buffer and turns the offsets back
+* into pointers into that buffer, so nothing is parsed or copied.
+*
+* The layout of the file is that of the structures of the build that wrote it, so a binary file is only loaded by a
+* build with the same interface version and structure sizes. The text form is the portable one.
+***********************************************************************************************************************
+*/
+#include "vfx.h"
+#include "vfxError.h"
+
+#if VFX_SUPPORT_VK_PIPELINE
+#include "vfxPipelineDoc.h"
+
+using namespace Vkgc;
+
+namespace Vfx {
+
+// Magic number that starts a binary pipeline file
+static const char PipelineBinaryMagic[4] = {'V', 'F', 'X', 'B'};
+
+// Version of the binary pipeline file format
+static const unsigned PipelineBinaryVersion = 1;
+
+// =====================================================================================================================
+// Header of a binary pipeline file, which is followed by the VfxPipelineState.
+struct PipelineBinaryHeader {
+  char magic[4];             // PipelineBinaryMagic
+  unsigned formatVersion;    // PipelineBinaryVersion
+  unsigned interfaceVersion; // Vkgc::Version of the build that wrote the file
+  unsigned stateSize;        // Size of VfxPipelineState in the build that wrote the file
+  uint64_t fileSize;         // Size of the whole file
+};
+
+namespace {
+
+// =====================================================================================================================
+// Builds the contents of a binary pipeline file. Each piece of data is appended at an 8-byte aligned offset, which
+// replaces the pointer to it.
+class PipelineBinaryWriter {
+public:
+  // Appends data and returns its offset, or 0 if there is no data
+  size_t append(const void *data, size_t size) {
+    if (!data || size == 0)
+      return 0;
+    const size_t offset = (m_data.size() + 7) & ~size_t(7);
+    m_data.resize(offset + size);
+    memcpy(&m_data[offset], data, size);
+    return offset;
+  }
+
+  // Gets the object at the given offset. The pointer is only valid until the next append.
+  template <typename T> T *at(size_t offset) { return reinterpret_cast<T *>(&m_data[offset]); }
+
+  std::vector<uint8_t> &getData() { return m_data; }
+
+private:
+  std::vector<uint8_t> m_data;
+};
+
+// =====================================================================================================================
+// Stores an offset in the binary file in place of a pointer
+//
+// @param [out] ptr : Pointer field
+// @param offset : Offset of the data the field points to, or 0 for a null pointer
+template <typename T> void storeOffset(T *&ptr, size_t offset) {
+  ptr = reinterpret_cast<T *>(offset);
+}
+
+// =====================================================================================================================
+// Turns the offsets in a loaded binary file back into pointers, checking that the data they point to lies in the file.
+class PipelineBinaryReader {
+public:
+  PipelineBinaryReader(uint8_t *data, size_t size) : m_data(data), m_size(size), m_valid(true) {}
+
+  // Relocates a pointer to an array of count objects
+  template <typename T> void relocate(T *&ptr, size_t count) {
+    const size_t offset = reinterpret_cast<uintptr_t>(ptr);
+    ptr = nullptr;
+    if (offset == 0)
+      return;
+    if (offset % alignof(T) != 0 || offset >= m_size || count > (m_size - offset) / sizeof(T)) {
+      m_valid = false;
+      return;
+    }
+    ptr = reinterpret_cast<T *>(m_data + offset);
+  }
+
+  // Relocates a pointer to untyped data of the given size
+  void relocateBytes(const void *&ptr, size_t size) {
+    const uint8_t *bytes = static_cast<const uint8_t *>(ptr);
+    relocate(bytes, size);
+    ptr = bytes;
+  }
+
+  // Relocates a pointer to a null-terminated string
+  void relocateString(const char *&ptr) {
+    relocate(ptr, 1);
+    if (ptr && !memchr(ptr, '\0', m_size - (reinterpret_cast<const uint8_t *>(ptr) - m_data))) {
+      ptr = nullptr;
+      m_valid = false;
+    }
+  }
+
+  bool isValid() const { return m_valid; }
+
+private:
+  uint8_t *m_data; // Contents of the file
+  size_t m_size;   // Size of the file
+  bool m_valid;    // Whether all pointers relocated so far point into the file
+};
+
+// =====================================================================================================================
+// Gets the size in dwords of the static descriptors of a descriptor range value.
+//
+// @param rangeValue : Descriptor range value
+unsigned getDescriptorRangeValueSize(const DescriptorRangeValue &rangeValue) {
+  const unsigned descriptorSizeInDw = rangeValue.type == ResourceMappingNodeType::DescriptorYCbCrSampler ? 8 : 4;
+  return rangeValue.arraySize * descriptorSizeInDw;
+}
+
+// =====================================================================================================================
+// Writes an array of resource mapping nodes, and the nodes they point to.
+//
+// @param [in/out] writer : Binary file contents
+// @param nodes : Resource mapping nodes
+// @param nodeCount : Count of resource mapping nodes
+size_t writeResourceMappingNodes(PipelineBinaryWriter &writer, const ResourceMappingNode *nodes, unsigned nodeCount) {
+  const size_t offset = writer.append(nodes, nodeCount * sizeof(ResourceMappingNode));
+  for (unsigned i = 0; i < nodeCount; ++i) {
+    if (nodes[i].type != ResourceMappingNodeType::DescriptorTableVaPtr)
+      continue;
+    const size_t nextOffset = writeResourceMappingNodes(writer, nodes[i].tablePtr.pNext, nodes[i].tablePtr.nodeCount);
+    storeOffset(writer.at<ResourceMappingNode>(offset)[i].tablePtr.pNext, nextOffset);
+  }
+  return offset;
+}
+
+// =====================================================================================================================
+// Relocates an array of resource mapping nodes, and the nodes they point to.
+//
+// @param [in/out] reader : Binary file contents
+// @param nodes : Resource mapping nodes
+// @param nodeCount : Count of resource mapping nodes
+void relocateResourceMappingNodes(PipelineBinaryReader &reader, const ResourceMappingNode *nodes, unsigned nodeCount) {
+  for (unsigned i = 0; i < nodeCount && reader.isValid(); ++i) {
+    if (nodes[i].type != ResourceMappingNodeType::DescriptorTableVaPtr)
+      continue;
+    auto &tablePtr = const_cast<ResourceMappingNode &>(nodes[i]).tablePtr;
+    reader.relocate(tablePtr.pNext, tablePtr.nodeCount);
+    if (tablePtr.pNext)
+      relocateResourceMappingNodes(reader, tablePtr.pNext, tablePtr.nodeCount);
+  }
+}
+
+// =====================================================================================================================
+// Writes the data that a pipeline shader info points to, and stores its offsets in the copy of the shader info in the
+// file.
+//
+// @param [in/out] writer : Binary file contents
+// @param infoOffset : Offset of the shader info in the file
+void writePipelineShaderInfo(PipelineBinaryWriter &writer, size_t infoOffset) {
+  // The copy in the file still has the pointers of the source.
+  const PipelineShaderInfo info = *writer.at<PipelineShaderInfo>(infoOffset);
+
+  size_t specInfoOffset = 0;
+  if (info.pSpecializationInfo) {
+    const VkSpecializationInfo &specInfo = *info.pSpecializationInfo;
+    specInfoOffset = writer.append(&specInfo, sizeof(specInfo));
+    const size_t mapEntriesOffset =
+        writer.append(specInfo.pMapEntries, specInfo.mapEntryCount * sizeof(VkSpecializationMapEntry));
+    const size_t dataOffset = writer.append(specInfo.pData, specInfo.dataSize);
+    storeOffset(writer.at<VkSpecializationInfo>(specInfoOffset)->pMapEntries, mapEntriesOffset);
+    storeOffset(writer.at<VkSpecializationInfo>(specInfoOffset)->pData, dataOffset);
+  }
+
+  const size_t entryTargetOffset =
+      info.pEntryTarget ? writer.append(info.pEntryTarget, strlen(info.pEntryTarget) + 1) : 0;
+
+  const size_t rangeValuesOffset = writer.append(info.pDescriptorRangeValues,
+                                                 info.descriptorRangeValueCount * sizeof(DescriptorRangeValue));
+  for (unsigned i = 0; i < info.descriptorRangeValueCount; ++i) {
+    const DescriptorRangeValue &rangeValue = info.pDescriptorRangeValues[i];
+    const size_t valueOffset =
+        writer.append(rangeValue.pValue, getDescriptorRangeValueSize(rangeValue) * sizeof(unsigned));
+    storeOffset(writer.at<DescriptorRangeValue>(rangeValuesOffset)[i].pValue, valueOffset);
+  }
+
+  const size_t userDataNodesOffset = writeResourceMappingNodes(writer, info.pUserDataNodes, info.userDataNodeCount);
+  const size_t formatHintsOffset =
+      writer.append(info.pFormatHints, info.formatHintCount * sizeof(DescriptorFormatHint));
+
+  // The shader module is built from the SPIR-V of the stage when the pipeline is loaded.
+  PipelineShaderInfo *const outInfo = writer.at<PipelineShaderInfo>(infoOffset);
+  outInfo->pModuleData = nullptr;
+  storeOffset(outInfo->pSpecializationInfo, specInfoOffset);
+  storeOffset(outInfo->pEntryTarget, entryTargetOffset);
+  storeOffset(outInfo->pDescriptorRangeValues, rangeValuesOffset);
+  storeOffset(outInfo->pUserDataNodes, userDataNodesOffset);
+  storeOffset(outInfo->pFormatHints, formatHintsOffset);
+}
+
+// =====================================================================================================================
+// Relocates the data that a pipeline shader info in a loaded file points to.
+//
+// @param [in/out] reader : Binary file contents
+// @param [in/out] info : Shader info in the file
+void relocatePipelineShaderInfo(PipelineBinaryReader &reader, PipelineShaderInfo &info) {
+  info.pModuleData = nullptr;
+
+  reader.relocate(info.pSpecializationInfo, 1);
+  if (info.pSpecializationInfo) {
+    auto &specInfo = const_cast<VkSpecializationInfo &>(*info.pSpecializationInfo);
+    reader.relocate(specInfo.pMapEntries, specInfo.mapEntryCount);
+    reader.relocateBytes(specInfo.pData, specInfo.dataSize);
+  }
+
+  reader.relocateString(info.pEntryTarget);
+
+  reader.relocate(info.pDescriptorRangeValues, info.descriptorRangeValueCount);
+  for (unsigned i = 0; info.pDescriptorRangeValues && i < info.descriptorRangeValueCount; ++i) {
+    DescriptorRangeValue &rangeValue = info.pDescriptorRangeValues[i];
+    reader.relocate(rangeValue.pValue, getDescriptorRangeValueSize(rangeValue));
+  }
+
+  reader.relocate(info.pUserDataNodes, info.userDataNodeCount);
+  if (info.pUserDataNodes)
+    relocateResourceMappingNodes(reader, info.pUserDataNodes, info.userDataNodeCount);
+
+  reader.relocate(info.pFormatHints, info.formatHintCount);
+}
+
+// =====================================================================================================================
+// Gets the shader infos of a pipeline state.
+//
+// @param state : Pipeline state
+// @param [out] shaderInfos : Shader infos of all native stages
+void getPipelineShaderInfos(VfxPipelineState &state, PipelineShaderInfo *(&shaderInfos)[ShaderStageNativeStageCount]) {
+  shaderInfos[ShaderStageVertex] = &state.gfxPipelineInfo.vs;
+  shaderInfos[ShaderStageTessControl] = &state.gfxPipelineInfo.tcs;
+  shaderInfos[ShaderStageTessEval] = &state.gfxPipelineInfo.tes;
+  shaderInfos[ShaderStageGeometry] = &state.gfxPipelineInfo.gs;
+  shaderInfos[ShaderStageFragment] = &state.gfxPipelineInfo.fs;
+  shaderInfos[ShaderStageCompute] = &state.compPipelineInfo.cs;
+}
+
+} // anonymous namespace
+
+// =====================================================================================================================
+// Gets the pipeline state of the loaded binary pipeline file, which follows the file header.
+VfxPipelineState *PipelineDocument::getBinaryState() {
+  static_assert(sizeof(PipelineBinaryHeader) % 8 == 0, "Pipeline state must follow the header without padding");
+  return reinterpret_cast<VfxPipelineState *>(&m_binaryData[sizeof(PipelineBinaryHeader)]);
+}
+
+// =====================================================================================================================
+// Checks whether a file is a binary pipeline file, by its magic number.
+//
+// @param fileName : Name of the file
+bool PipelineDocument::isBinaryFile(const char *fileName) {
+  char magic[sizeof(PipelineBinaryMagic)] = {};
+  FILE *file = fopen(fileName, "rb");
+  if (!file)
+    return false;
+  const bool isBinary = fread(magic, 1, sizeof(magic), file) == sizeof(magic) &&
+                        memcmp(magic, PipelineBinaryMagic, sizeof(magic)) == 0;
+  fclose(file);
+  return isBinary;
+}
+
+// =====================================================================================================================
+// Loads the pipeline state from a binary pipeline file. The file is read into one buffer that the document keeps, and
+// the pipeline state points into it.
+//
+// @param fileName : Name of the binary pipeline file
+bool PipelineDocument::parseBinary(const std::string &fileName) {
+  setFileName(fileName);
+
+  FILE *file = fopen(fileName.c_str(), "rb");
+  if (!file) {
+    PARSE_ERROR(m_errorMsg, 0, "Fails to open binary pipeline file %s", fileName.c_str());
+    return false;
+  }
+  bool result = fseek(file, 0, SEEK_END) == 0;
+  const long fileSize = result ? ftell(file) : -1;
+  result = fileSize >= static_cast<long>(sizeof(PipelineBinaryHeader) + sizeof(VfxPipelineState)) &&
+           fseek(file, 0, SEEK_SET) == 0;
+  if (result) {
+    m_binaryData.resize(static_cast<size_t>(fileSize));
+    result = fread(&m_binaryData[0], 1, m_binaryData.size(), file) == m_binaryData.size();
+  }
+  fclose(file);
+  if (!result) {
+    PARSE_ERROR(m_errorMsg, 0, "Fails to read binary pipeline file %s", fileName.c_str());
+    m_binaryData.clear();
+    return false;
+  }
+
+  const auto *header = reinterpret_cast<const PipelineBinaryHeader *>(&m_binaryData[0]);
+  if (memcmp(header->magic, PipelineBinaryMagic, sizeof(header->magic)) != 0 ||
+      header->formatVersion != PipelineBinaryVersion || header->interfaceVersion != Version ||
+      header->stateSize != sizeof(VfxPipelineState) || header->fileSize != m_binaryData.size()) {
+    PARSE_ERROR(m_errorMsg, 0, "Binary pipeline file %s was written by an incompatible build", fileName.c_str());
+    m_binaryData.clear();
+    return false;
+  }
+
+  VfxPipelineState *state = getBinaryState();
+  PipelineBinaryReader reader(&m_binaryData[0], m_binaryData.size());
+
+  reader.relocate(state->stages, state->numStages);
+  for (unsigned stage = 0; state->stages && stage < state->numStages; ++stage)
+    reader.relocate(state->stages[stage].pData, state->stages[stage].dataSize);
+
+  GraphicsPipelineBuildInfo &gfxPipelineInfo = state->gfxPipelineInfo;
+  reader.relocate(gfxPipelineInfo.pVertexInput, 1);
+  if (gfxPipelineInfo.pVertexInput) {
+    auto &vertexInput = const_cast<VkPipelineVertexInputStateCreateInfo &>(*gfxPipelineInfo.pVertexInput);
+    reader.relocate(vertexInput.pVertexBindingDescriptions, vertexInput.vertexBindingDescriptionCount);
+    reader.relocate(vertexInput.pVertexAttributeDescriptions, vertexInput.vertexAttributeDescriptionCount);
+    const VkPipelineVertexInputDivisorStateCreateInfoEXT *divisorState =
+        static_cast<const VkPipelineVertexInputDivisorStateCreateInfoEXT *>(vertexInput.pNext);
+    reader.relocate(divisorState, 1);
+    vertexInput.pNext = divisorState;
+    if (divisorState) {
+      auto &divisors = const_cast<VkPipelineVertexInputDivisorStateCreateInfoEXT &>(*divisorState);
+      divisors.pNext = nullptr;
+      reader.relocate(divisors.pVertexBindingDivisors, divisors.vertexBindingDivisorCount);
+    }
+  }
+
+  PipelineShaderInfo *shaderInfos[ShaderStageNativeStageCount];
+  getPipelineShaderInfos(*state, shaderInfos);
+  for (PipelineShaderInfo *shaderInfo : shaderInfos)
+    relocatePipelineShaderInfo(reader, *shaderInfo);
+
+  if (!reader.isValid()) {
+    PARSE_ERROR(m_errorMsg, 0, "Binary pipeline file %s is corrupted", fileName.c_str());
+    m_binaryData.clear();
+    return false;
+  }
+
+  m_isValidVfxFile = true;
+  return true;
+}
+
+// =====================================================================================================================
+// Writes the pipeline state of this document to a binary pipeline file.
+//
+// @param fileName : Name of the binary pipeline file
+bool PipelineDocument::writeBinary(const std::string &fileName) {
+  VfxPipelineState *const state = getDocument();
+  PipelineBinaryWriter writer;
+
+  PipelineBinaryHeader header = {};
+  memcpy(header.magic, PipelineBinaryMagic, sizeof(header.magic));
+  header.formatVersion = PipelineBinaryVersion;
+  header.interfaceVersion = Version;
+  header.stateSize = sizeof(VfxPipelineState);
+  writer.append(&header, sizeof(header));
+  const size_t stateOffset = writer.append(state, sizeof(VfxPipelineState));
+
+  // Shader stages, with their SPIR-V
+  const size_t stagesOffset = writer.append(state->stages, state->numStages * sizeof(ShaderSource));
+  for (unsigned stage = 0; stage < state->numStages; ++stage) {
+    const size_t dataOffset = writer.append(state->stages[stage].pData, state->stages[stage].dataSize);
+    storeOffset(writer.at<ShaderSource>(stagesOffset)[stage].pData, dataOffset);
+  }
+
+  // Vertex input state, with the only extension structure that the text form has, the vertex divisor state
+  size_t vertexInputOffset = 0;
+  if (const VkPipelineVertexInputStateCreateInfo *vertexInput = state->gfxPipelineInfo.pVertexInput) {
+    vertexInputOffset = writer.append(vertexInput, sizeof(*vertexInput));
+    const size_t bindingsOffset =
+        writer.append(vertexInput->pVertexBindingDescriptions,
+                      vertexInput->vertexBindingDescriptionCount * sizeof(VkVertexInputBindingDescription));
+    const size_t attributesOffset =
+        writer.append(vertexInput->pVertexAttributeDescriptions,
+                      vertexInput->vertexAttributeDescriptionCount * sizeof(VkVertexInputAttributeDescription));
+    size_t divisorStateOffset = 0;
+    const auto *divisorState = static_cast<const VkPipelineVertexInputDivisorStateCreateInfoEXT *>(vertexInput->pNext);
+    if (divisorState) {
+      VFX_ASSERT(divisorState->sType == VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_DIVISOR_STATE_CREATE_INFO_EXT);
+      divisorStateOffset = writer.append(divisorState, sizeof(*divisorState));
+      const size_t divisorsOffset =
+          writer.append(divisorState->pVertexBindingDivisors,
+                        divisorState->vertexBindingDivisorCount * sizeof(VkVertexInputBindingDivisorDescriptionEXT));
+      auto *outDivisorState = writer.at<VkPipelineVertexInputDivisorStateCreateInfoEXT>(divisorStateOffset);
+      outDivisorState->pNext = nullptr;
+      storeOffset(outDivisorState->pVertexBindingDivisors, divisorsOffset);
+    }
+    auto *outVertexInput = writer.at<VkPipelineVertexInputStateCreateInfo>(vertexInputOffset);
+    storeOffset(outVertexInput->pVertexBindingDescriptions, bindingsOffset);
+    storeOffset(outVertexInput->pVertexAttributeDescriptions, attributesOffset);
+    storeOffset(outVertexInput->pNext, divisorStateOffset);
+  }
+
+  // Shader infos. Take their offsets first, as writing them moves the contents of the file.
+  PipelineShaderInfo *shaderInfos[ShaderStageNativeStageCount];
+  getPipelineShaderInfos(*writer.at<VfxPipelineState>(stateOffset), shaderInfos);
+  size_t shaderInfoOffsets[ShaderStageNativeStageCount];
+  for (unsigned stage = 0; stage < ShaderStageNativeStageCount; ++stage)
+    shaderInfoOffsets[stage] = reinterpret_cast<uint8_t *>(shaderInfos[stage]) - &writer.getData()[0];
+  for (size_t shaderInfoOffset : shaderInfoOffsets)
+    writePipelineShaderInfo(writer, shaderInfoOffset);
+
+  // The client objects of the build infos are not part of the pipeline.
+  VfxPipelineState *const outState = writer.at<VfxPipelineState>(stateOffset);
+  storeOffset(outState->stages, stagesOffset);
+  storeOffset(outState->gfxPipelineInfo.pVertexInput, vertexInputOffset);
+  outState->gfxPipelineInfo.pInstance = nullptr;
+  outState->gfxPipelineInfo.pUserData = nullptr;
+  outState->gfxPipelineInfo.pfnOutputAlloc = nullptr;
+  outState->gfxPipelineInfo.cache = nullptr;
+  outState->compPipelineInfo.pInstance = nullptr;
+  outState->compPipelineInfo.pUserData = nullptr;
+  outState->compPipelineInfo.pfnOutputAlloc = nullptr;
+  outState->compPipelineInfo.cache = nullptr;
+#if LLPC_CLIENT_INTERFACE_MAJOR_VERSION < 38 || LLPC_ENABLE_SHADER_CACHE
+  outState->gfxPipelineInfo.pShaderCache = nullptr;
+  outState->compPipelineInfo.pShaderCache = nullptr;
+#endif
+
+  std::vector<uint8_t> &data = writer.getData();
+  reinterpret_cast<PipelineBinaryHeader *>(&data[0])->fileSize = data.size();
+
+  FILE *file = fopen(fileName.c_str(), "wb");
+  bool result = file && fwrite(&data[0], 1, data.size(), file) == data.size();
+  if (file)
+    result = fclose(file) == 0 && result;
+  if (!result)
+    PARSE_ERROR(m_errorMsg, 0, "Fails to write binary pipeline file %s", fileName.c_str());
+  return result;
+}
+
+// =====================================================================================================================
+// Writes the pipeline state of a pipeline document to a binary pipeline file, which vfxParseFile loads without parsing.
+//
+// @param doc : Document handle
+// @param fileName : Name of the binary pipeline file
+// @param [out] errorMsg : Error message
+bool VFXAPI vfxWritePipelineBinary(void *doc, const char *fileName, const char **errorMsg) {
+  PipelineDocument *pipelineDoc = reinterpret_cast<PipelineDocument *>(doc);
+  bool result = pipelineDoc->writeBinary(fileName);
+  *errorMsg = pipelineDoc->getErrorMsg()->c_str();
+  return result;
+}
+
+} // namespace Vfx
+
+#endif
@@ -95,6 +95,10 @@ bool PipelineDocument::checkVersion(unsigned ver) {
 // =====================================================================================================================
 // Gets PiplineDocument content
 VfxPipelineStatePtr PipelineDocument::getDocument() {
+  // A binary pipeline file holds the pipeline state as it is.
+  if (!m_binaryData.empty())
+    return getBinaryState();
+
   // Section "Version"
   m_pipelineState.version = Version;
 
@@ -284,6 +288,7 @@ bool PipelineDocument::getPtrOfSubSection(Section *section, unsigned lineNum, co
   switch (memberType) {
     CASE_SUBSECTION(MemberTypeResourceMappingNode, SectionResourceMappingNode)
     CASE_SUBSECTION(MemberTypeDescriptorRangeValue, SectionDescriptorRangeValueItem)
+    CASE_SUBSECTION(MemberTypeFormatHint, SectionFormatHintItem)
     CASE_SUBSECTION(MemberTypePipelineOption, SectionPipelineOption)
     CASE_SUBSECTION(MemberTypeShaderOption, SectionShaderOption)
     CASE_SUBSECTION(MemberTypeNggState, SectionNggState)
@@ -57,11 +57,18 @@ public:
   bool getPtrOfSubSection(Section *section, unsigned lineNum, const char *memberName, MemberType memberType,
                           bool isWriteAccess, unsigned arrayIndex, Section **ptrOut, std::string *errorMsg);
 
+  static bool isBinaryFile(const char *fileName);
+  bool parseBinary(const std::string &fileName);
+  bool writeBinary(const std::string &fileName);
+
 private:
+  VfxPipelineState *getBinaryState();
+
   VfxPipelineState m_pipelineState; // Contants the render state
   VkPipelineVertexInputStateCreateInfo m_vertexInputState;
   std::vector<Vfx::ShaderSource> m_shaderSources;
   std::vector<Vkgc::PipelineShaderInfo> m_shaderInfos;
+  std::vector<uint8_t> m_binaryData; // Contents of the loaded binary pipeline file, if any
 };
 
 } // namespace Vfx
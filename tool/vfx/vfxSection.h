@@ -105,6 +105,7 @@ enum MemberType : unsigned {
   MemberTypeResourceMappingNode,      // VFX member type: SectionResourceMappingNode
   MemberTypeSpecInfo,                 // VFX member type: SectionSpecInfo
   MemberTypeDescriptorRangeValue,     // VFX member type: SectionDescriptorRangeValueItem
+  MemberTypeFormatHint,               // VFX member type: SectionFormatHintItem
   MemberTypePipelineOption,           // VFX member type: SectionPipelineOption
   MemberTypeShaderOption,             // VFX member type: SectionShaderOption
   MemberTypeNggState,                 // VFX member type: SectionNggState
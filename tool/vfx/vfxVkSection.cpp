@@ -9,6 +9,7 @@ using namespace Vkgc;
 namespace Vfx {
 
 StrToMemberAddr SectionDescriptorRangeValueItem::m_addrTable[SectionDescriptorRangeValueItem::MemberCount];
+StrToMemberAddr SectionFormatHintItem::m_addrTable[SectionFormatHintItem::MemberCount];
 StrToMemberAddr SectionResourceMappingNode::m_addrTable[SectionResourceMappingNode::MemberCount];
 StrToMemberAddr SectionShaderInfo::m_addrTable[SectionShaderInfo::MemberCount];
 StrToMemberAddr SectionGraphicsState::m_addrTable[SectionGraphicsState::MemberCount];
@@ -39,6 +40,7 @@ public:
     SectionGraphicsState::initialAddrTable();
     SectionComputeState::initialAddrTable();
     SectionDescriptorRangeValueItem::initialAddrTable();
+    SectionFormatHintItem::initialAddrTable();
     SectionResourceMappingNode::initialAddrTable();
     SectionShaderInfo::initialAddrTable();
     SectionPipelineOption::initialAddrTable();
@@ -60,6 +62,7 @@ public:
     ADD_CLASS_ENUM_MAP(ResourceMappingNodeType, PushConst)
     ADD_CLASS_ENUM_MAP(ResourceMappingNodeType, DescriptorBufferCompact)
     ADD_CLASS_ENUM_MAP(ResourceMappingNodeType, StreamOutTableVaPtr)
+    ADD_CLASS_ENUM_MAP(ResourceMappingNodeType, InlineBuffer)
 
     ADD_CLASS_ENUM_MAP(NggSubgroupSizingType, Auto)
     ADD_CLASS_ENUM_MAP(NggSubgroupSizingType, MaximumSize)
@@ -76,6 +79,19 @@ public:
     ADD_CLASS_ENUM_MAP(WaveBreakSize, _16x16)
     ADD_CLASS_ENUM_MAP(WaveBreakSize, _32x32)
     ADD_CLASS_ENUM_MAP(WaveBreakSize, DrawTime)
+
+    ADD_CLASS_ENUM_MAP(TranscendentalPrecision, Accurate)
+    ADD_CLASS_ENUM_MAP(TranscendentalPrecision, Relaxed)
+    ADD_CLASS_ENUM_MAP(TranscendentalPrecision, Fast)
+
+    ADD_CLASS_ENUM_MAP(WorkgroupSwizzle, Default)
+    ADD_CLASS_ENUM_MAP(WorkgroupSwizzle, Auto)
+    ADD_CLASS_ENUM_MAP(WorkgroupSwizzle, Enable)
+    ADD_CLASS_ENUM_MAP(WorkgroupSwizzle, Disable)
+
+    ADD_CLASS_ENUM_MAP(ImageFormatHint, Unknown)
+    ADD_CLASS_ENUM_MAP(ImageFormatHint, Channel32)
+    ADD_CLASS_ENUM_MAP(ImageFormatHint, NonChannel32)
   }
 };
 
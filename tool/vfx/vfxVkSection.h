@@ -40,6 +40,33 @@ private:
   std::vector<uint8_t> m_bufMem;
 };
 
+// =====================================================================================================================
+// Represents the sub section image descriptor format hint
+class SectionFormatHintItem : public Section {
+public:
+  typedef Vkgc::DescriptorFormatHint SubState;
+
+  SectionFormatHintItem() : Section(m_addrTable, MemberCount, SectionTypeUnset, "formatHint") {
+    memset(&m_state, 0, sizeof(m_state));
+  }
+
+  static void initialAddrTable() {
+    StrToMemberAddr *tableItem = m_addrTable;
+    INIT_STATE_MEMBER_NAME_TO_ADDR(SectionFormatHintItem, set, MemberTypeInt, false);
+    INIT_STATE_MEMBER_NAME_TO_ADDR(SectionFormatHintItem, binding, MemberTypeInt, false);
+    INIT_STATE_MEMBER_NAME_TO_ADDR(SectionFormatHintItem, hint, MemberTypeEnum, false);
+    VFX_ASSERT(tableItem - &m_addrTable[0] <= MemberCount);
+  }
+  void getSubState(SubState &state) { state = m_state; };
+  SubState &getSubStateRef() { return m_state; };
+
+private:
+  static const unsigned MemberCount = 3;
+  static StrToMemberAddr m_addrTable[MemberCount];
+
+  SubState m_state;
+};
+
 // =====================================================================================================================
 // Represents the sub section resource mapping node
 class SectionResourceMappingNode : public Section {
@@ -136,6 +163,8 @@ public:
 #endif
     INIT_STATE_MEMBER_NAME_TO_ADDR(SectionShaderOption, unrollThreshold, MemberTypeInt, false);
     INIT_STATE_MEMBER_NAME_TO_ADDR(SectionShaderOption, scalarThreshold, MemberTypeInt, false);
+    INIT_STATE_MEMBER_NAME_TO_ADDR(SectionShaderOption, transcendentalPrecision, MemberTypeEnum, false);
+    INIT_STATE_MEMBER_NAME_TO_ADDR(SectionShaderOption, workgroupSwizzle, MemberTypeEnum, false);
 
     VFX_ASSERT(tableItem - &m_addrTable[0] <= MemberCount);
   }
@@ -144,7 +173,7 @@ public:
   SubState &getSubStateRef() { return m_state; };
 
 private:
-  static const unsigned MemberCount = 18;
+  static const unsigned MemberCount = 20;
   static StrToMemberAddr m_addrTable[MemberCount];
 
   SubState m_state;
@@ -166,6 +195,7 @@ public:
     INIT_MEMBER_NAME_TO_ADDR(SectionShaderInfo, m_specConst, MemberTypeSpecInfo, true);
     INIT_MEMBER_NAME_TO_ADDR(SectionShaderInfo, m_options, MemberTypeShaderOption, true);
     INIT_MEMBER_DYNARRAY_NAME_TO_ADDR(SectionShaderInfo, m_descriptorRangeValue, MemberTypeDescriptorRangeValue, true);
+    INIT_MEMBER_DYNARRAY_NAME_TO_ADDR(SectionShaderInfo, m_formatHint, MemberTypeFormatHint, true);
     INIT_MEMBER_DYNARRAY_NAME_TO_ADDR(SectionShaderInfo, m_userDataNode, MemberTypeResourceMappingNode, true);
     VFX_ASSERT(tableItem - &m_addrTable[0] <= MemberCount);
   }
@@ -189,6 +219,14 @@ public:
       state.pDescriptorRangeValues = &m_descriptorRangeValues[0];
     }
 
+    if (m_formatHint.size() > 0) {
+      m_formatHints.resize(m_formatHint.size());
+      for (unsigned i = 0; i < m_formatHint.size(); ++i)
+        m_formatHint[i].getSubState(m_formatHints[i]);
+      state.formatHintCount = static_cast<unsigned>(m_formatHint.size());
+      state.pFormatHints = &m_formatHints[0];
+    }
+
     if (m_userDataNode.size() > 0) {
       state.userDataNodeCount = static_cast<unsigned>(m_userDataNode.size());
       m_userDataNodes.resize(state.userDataNodeCount);
@@ -203,17 +241,19 @@ public:
   ShaderStage getShaderStage() { return m_shaderStage; }
 
 private:
-  static const unsigned MemberCount = 5;
+  static const unsigned MemberCount = 6;
   static StrToMemberAddr m_addrTable[MemberCount];
   SubState m_state;
   SectionSpecInfo m_specConst;                                         // Specialization constant info
   SectionShaderOption m_options;                                       // Pipeline shader options
   std::string m_entryPoint;                                            // Entry point name
   std::vector<SectionDescriptorRangeValueItem> m_descriptorRangeValue; // Contains descriptor range vuale
+  std::vector<SectionFormatHintItem> m_formatHint;                     // Contains image format hints
   std::vector<SectionResourceMappingNode> m_userDataNode;              // Contains user data node
 
   VkSpecializationInfo m_specializationInfo;
   std::vector<Vkgc::DescriptorRangeValue> m_descriptorRangeValues;
+  std::vector<Vkgc::DescriptorFormatHint> m_formatHints;
   std::vector<Vkgc::ResourceMappingNode> m_userDataNodes;
   ShaderStage m_shaderStage;
 };
@@ -267,6 +307,7 @@ public:
     INIT_STATE_MEMBER_NAME_TO_ADDR(SectionPipelineOption, shadowDescriptorTableUsage, MemberTypeEnum, false);
     INIT_STATE_MEMBER_NAME_TO_ADDR(SectionPipelineOption, shadowDescriptorTablePtrHigh, MemberTypeInt, false);
     INIT_MEMBER_NAME_TO_ADDR(SectionPipelineOption, m_extendedRobustness, MemberTypeExtendedRobustness, true);
+    INIT_STATE_MEMBER_NAME_TO_ADDR(SectionPipelineOption, fastCompile, MemberTypeBool, false);
     VFX_ASSERT(tableItem - &m_addrTable[0] <= MemberCount);
   }
 
@@ -277,7 +318,7 @@ public:
   SubState &getSubStateRef() { return m_state; };
 
 private:
-  static const unsigned MemberCount = 8;
+  static const unsigned MemberCount = 9;
   static StrToMemberAddr m_addrTable[MemberCount];
 
   SubState m_state;
@@ -313,6 +354,7 @@ public:
     INIT_STATE_MEMBER_NAME_TO_ADDR(SectionNggState, subgroupSizing, MemberTypeEnum, false);
     INIT_STATE_MEMBER_NAME_TO_ADDR(SectionNggState, primsPerSubgroup, MemberTypeInt, false);
     INIT_STATE_MEMBER_NAME_TO_ADDR(SectionNggState, vertsPerSubgroup, MemberTypeInt, false);
+    INIT_STATE_MEMBER_NAME_TO_ADDR(SectionNggState, enableAutoCulling, MemberTypeBool, false);
 
     VFX_ASSERT(tableItem - &m_addrTable[0] <= MemberCount);
   }
@@ -321,7 +363,7 @@ public:
   SubState &getSubStateRef() { return m_state; };
 
 private:
-  static const unsigned MemberCount = 17;
+  static const unsigned MemberCount = 18;
   static StrToMemberAddr m_addrTable[MemberCount];
 
   SubState m_state;
@@ -30,6 +30,8 @@
  */
 #include <algorithm>
 #include "vkgcElfReader.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include <string.h>
 
 #define DEBUG_TYPE "vkgc-elf-reader"
@@ -43,8 +45,8 @@ namespace Vkgc {
 // @param gfxIp : Graphics IP version info
 template <class Elf>
 ElfReader<Elf>::ElfReader(GfxIpVersion gfxIp)
-    : m_gfxIp(gfxIp), m_header(), m_symSecIdx(InvalidValue), m_relocSecIdx(InvalidValue), m_strtabSecIdx(InvalidValue),
-      m_textSecIdx(InvalidValue) {
+    : m_gfxIp(gfxIp), m_header(), m_data(nullptr), m_mapComplete(false), m_symSecIdx(InvalidValue),
+      m_relocSecIdx(InvalidValue), m_strtabSecIdx(InvalidValue), m_textSecIdx(InvalidValue) {
 }
 
 // =====================================================================================================================
@@ -70,6 +72,9 @@ template <class Elf> ElfReader<Elf>::~ElfReader() {
 // + Section Header (h1) [.shstrtab]
 // + ...            (h#) [...]
 //
+// Only the ELF header is read here. Section buffers and the map of section names are created when they are first
+// used, and refer to the given buffer, which must stay valid for the lifetime of the reader.
+//
 // @param buffer : Input ELF data buffer
 // @param [out] bufSize : Size of the given read buffer (determined from the ELF header)
 template <class Elf> Result ElfReader<Elf>::ReadFromBuffer(const void *buffer, size_t *bufSize) {
@@ -90,45 +95,15 @@ template <class Elf> Result ElfReader<Elf>::ReadFromBuffer(const void *buffer, s
 
   if (result == Result::Success) {
     m_header = *header;
+    m_data = data;
     size_t readSize = sizeof(typename Elf::FormatHeader);
 
-    // Section header location information.
-    const unsigned sectionHeaderOffset = static_cast<unsigned>(header->e_shoff);
     const unsigned sectionHeaderNum = header->e_shnum;
-    const unsigned sectionHeaderSize = header->e_shentsize;
-
-    const unsigned sectionStrTableHeaderOffset = sectionHeaderOffset + (header->e_shstrndx * sectionHeaderSize);
-    auto sectionStrTableHeader =
-        reinterpret_cast<const typename Elf::SectionHeader *>(data + sectionStrTableHeaderOffset);
-    const unsigned sectionStrTableOffset = static_cast<unsigned>(sectionStrTableHeader->sh_offset);
-
     for (unsigned section = 0; section < sectionHeaderNum; section++) {
-      // Where the header is located for this section
-      const unsigned sectionOffset = sectionHeaderOffset + (section * sectionHeaderSize);
-      auto sectionHeader = reinterpret_cast<const typename Elf::SectionHeader *>(data + sectionOffset);
       readSize += sizeof(typename Elf::SectionHeader);
-
-      // Where the name is located for this section
-      const unsigned sectionNameOffset = sectionStrTableOffset + sectionHeader->sh_name;
-      const char *sectionName = reinterpret_cast<const char *>(data + sectionNameOffset);
-
-      // Where the data is located for this section
-      const unsigned sectionDataOffset = static_cast<unsigned>(sectionHeader->sh_offset);
-      auto buf = new SectionBuffer;
-
-      result = buf ? Result::Success : Result::ErrorOutOfMemory;
-
-      if (result == Result::Success) {
-        buf->secHead = *sectionHeader;
-        buf->name = sectionName;
-        buf->data = (data + sectionDataOffset);
-
-        readSize += static_cast<size_t>(sectionHeader->sh_size);
-
-        m_sections.push_back(buf);
-        m_map[sectionName] = section;
-      }
+      readSize += static_cast<size_t>(getSectionHeader(section)->sh_size);
     }
+    m_sections.resize(sectionHeaderNum, nullptr);
 
     *bufSize = readSize;
   }
@@ -142,6 +117,99 @@ template <class Elf> Result ElfReader<Elf>::ReadFromBuffer(const void *buffer, s
   return result;
 }
 
+// =====================================================================================================================
+// Reads ELF data in from the given file. Large files are memory mapped rather than copied, and the mapping is kept for
+// the lifetime of the reader.
+//
+// @param fileName : Name of the ELF file
+template <class Elf> Result ElfReader<Elf>::readFromFile(const char *fileName) {
+  uint64_t fileSize = 0;
+  if (sys::fs::file_size(fileName, fileSize))
+    return Result::ErrorUnavailable;
+  if (fileSize < sizeof(typename Elf::FormatHeader))
+    return Result::ErrorInvalidValue;
+
+  auto bufferOrErr = MemoryBuffer::getFileSlice(fileName, fileSize, 0);
+  if (!bufferOrErr)
+    return Result::ErrorUnavailable;
+  m_fileBuffer = std::move(*bufferOrErr);
+
+  size_t bufSize = m_fileBuffer->getBufferSize();
+  return ReadFromBuffer(m_fileBuffer->getBufferStart(), &bufSize);
+}
+
+// =====================================================================================================================
+// Gets the header of the section with the specified index.
+//
+// @param secIdx : Section index
+template <class Elf> const typename Elf::SectionHeader *ElfReader<Elf>::getSectionHeader(unsigned secIdx) const {
+  const unsigned sectionOffset = static_cast<unsigned>(m_header.e_shoff) + (secIdx * m_header.e_shentsize);
+  return reinterpret_cast<const typename Elf::SectionHeader *>(m_data + sectionOffset);
+}
+
+// =====================================================================================================================
+// Gets the name of the section with the specified index.
+//
+// @param secIdx : Section index
+template <class Elf> const char *ElfReader<Elf>::getSectionName(unsigned secIdx) const {
+  const unsigned sectionStrTableOffset = static_cast<unsigned>(getSectionHeader(m_header.e_shstrndx)->sh_offset);
+  return reinterpret_cast<const char *>(m_data + sectionStrTableOffset + getSectionHeader(secIdx)->sh_name);
+}
+
+// =====================================================================================================================
+// Gets the section buffer of the section with the specified index, creating it on first use.
+//
+// @param secIdx : Section index
+template <class Elf> typename ElfReader<Elf>::SectionBuffer *ElfReader<Elf>::getSection(unsigned secIdx) const {
+  assert(secIdx < m_sections.size());
+  if (!m_sections[secIdx]) {
+    auto sectionHeader = getSectionHeader(secIdx);
+    auto buf = new SectionBuffer;
+    buf->secHead = *sectionHeader;
+    buf->name = getSectionName(secIdx);
+    buf->data = m_data + static_cast<unsigned>(sectionHeader->sh_offset);
+    m_sections[secIdx] = buf;
+  }
+  return m_sections[secIdx];
+}
+
+// =====================================================================================================================
+// Gets the section index for the specified section name, by searching the section headers. If several sections have
+// the name, the last one is returned.
+//
+// @param name : Name of the section to look for
+template <class Elf> int32_t ElfReader<Elf>::GetSectionIndex(const char *name) const {
+  if (m_mapComplete) {
+    auto entry = m_map.find(name);
+    return (entry != m_map.end()) ? entry->second : InvalidValue;
+  }
+
+  for (unsigned secIdx = m_sections.size(); secIdx > 0; --secIdx) {
+    if (strcmp(getSectionName(secIdx - 1), name) == 0)
+      return secIdx - 1;
+  }
+  return InvalidValue;
+}
+
+// =====================================================================================================================
+// Gets the map between section name and section index, building it on first use.
+template <class Elf> const std::map<std::string, uint32_t> &ElfReader<Elf>::getMap() const {
+  if (!m_mapComplete) {
+    for (unsigned secIdx = 0; secIdx < m_sections.size(); ++secIdx)
+      m_map[getSectionName(secIdx)] = secIdx;
+    m_mapComplete = true;
+  }
+  return m_map;
+}
+
+// =====================================================================================================================
+// Gets the section buffers of all sections, creating them on first use.
+template <class Elf> const std::vector<typename ElfReader<Elf>::SectionBuffer *> &ElfReader<Elf>::getSections() const {
+  for (unsigned secIdx = 0; secIdx < m_sections.size(); ++secIdx)
+    getSection(secIdx);
+  return m_sections;
+}
+
 // =====================================================================================================================
 // Retrieves the section data for the specified section name, if it exists.
 //
@@ -152,11 +220,11 @@ template <class Elf>
 Result ElfReader<Elf>::GetSectionData(const char *name, const void **sectData, size_t *dataLength) const {
   Result result = Result::ErrorInvalidValue;
 
-  auto entry = m_map.find(name);
+  int32_t secIdx = GetSectionIndex(name);
 
-  if (entry != m_map.end()) {
-    *sectData = m_sections[entry->second]->data;
-    *dataLength = static_cast<size_t>(m_sections[entry->second]->secHead.sh_size);
+  if (secIdx != InvalidValue) {
+    *sectData = getSection(secIdx)->data;
+    *dataLength = static_cast<size_t>(getSection(secIdx)->secHead.sh_size);
     result = Result::Success;
   }
 
@@ -168,7 +236,7 @@ Result ElfReader<Elf>::GetSectionData(const char *name, const void **sectData, s
 template <class Elf> unsigned ElfReader<Elf>::getSymbolCount() const {
   unsigned symCount = 0;
   if (m_symSecIdx >= 0) {
-    auto &section = m_sections[m_symSecIdx];
+    auto section = getSection(m_symSecIdx);
     symCount = static_cast<unsigned>(section->secHead.sh_size / section->secHead.sh_entsize);
   }
   return symCount;
@@ -180,12 +248,12 @@ template <class Elf> unsigned ElfReader<Elf>::getSymbolCount() const {
 // @param idx : Symbol index
 // @param [out] symbol : Info of the symbol
 template <class Elf> void ElfReader<Elf>::getSymbol(unsigned idx, ElfSymbol *symbol) const {
-  auto &section = m_sections[m_symSecIdx];
-  const char *strTab = reinterpret_cast<const char *>(m_sections[m_strtabSecIdx]->data);
+  auto section = getSection(m_symSecIdx);
+  const char *strTab = reinterpret_cast<const char *>(getSection(m_strtabSecIdx)->data);
 
   auto symbols = reinterpret_cast<const typename Elf::Symbol *>(section->data);
   symbol->secIdx = symbols[idx].st_shndx;
-  symbol->secName = m_sections[symbol->secIdx]->name;
+  symbol->secName = getSectionName(symbol->secIdx);
   symbol->pSymName = strTab + symbols[idx].st_name;
   symbol->size = symbols[idx].st_size;
   symbol->value = symbols[idx].st_value;
@@ -197,7 +265,7 @@ template <class Elf> void ElfReader<Elf>::getSymbol(unsigned idx, ElfSymbol *sym
 template <class Elf> unsigned ElfReader<Elf>::getRelocationCount() const {
   unsigned relocCount = 0;
   if (m_relocSecIdx >= 0) {
-    auto &section = m_sections[m_relocSecIdx];
+    auto section = getSection(m_relocSecIdx);
     relocCount = static_cast<unsigned>(section->secHead.sh_size / section->secHead.sh_entsize);
   }
   return relocCount;
@@ -209,7 +277,7 @@ template <class Elf> unsigned ElfReader<Elf>::getRelocationCount() const {
 // @param idx : Relocation index
 // @param [out] reloc : Info of the relocation
 template <class Elf> void ElfReader<Elf>::getRelocation(unsigned idx, ElfReloc *reloc) const {
-  auto &section = m_sections[m_relocSecIdx];
+  auto section = getSection(m_relocSecIdx);
 
   auto relocs = reinterpret_cast<const typename Elf::Reloc *>(section->data);
   reloc->offset = relocs[idx].r_offset;
@@ -234,7 +302,7 @@ template <class Elf>
 Result ElfReader<Elf>::getSectionDataBySectionIndex(unsigned secIdx, SectionBuffer **ppSectionData) const {
   Result result = Result::ErrorInvalidValue;
   if (secIdx < m_sections.size()) {
-    *ppSectionData = m_sections[secIdx];
+    *ppSectionData = getSection(secIdx);
     result = Result::Success;
   }
   return result;
@@ -251,11 +319,11 @@ Result ElfReader<Elf>::getSectionDataBySortingIndex(unsigned sortIdx, unsigned *
                                                     SectionBuffer **ppSectionData) const {
   Result result = Result::ErrorInvalidValue;
   if (sortIdx < m_sections.size()) {
-    auto it = m_map.begin();
+    auto it = getMap().begin();
     for (unsigned i = 0; i < sortIdx; ++i)
       ++it;
     *secIdx = it->second;
-    *ppSectionData = m_sections[it->second];
+    *ppSectionData = getSection(it->second);
     result = Result::Success;
   }
   return result;
@@ -269,8 +337,8 @@ Result ElfReader<Elf>::getSectionDataBySortingIndex(unsigned sortIdx, unsigned *
 template <class Elf>
 void ElfReader<Elf>::GetSymbolsBySectionIndex(unsigned secIdx, std::vector<ElfSymbol> &secSymbols) const {
   if (secIdx < m_sections.size() && m_symSecIdx >= 0) {
-    auto &section = m_sections[m_symSecIdx];
-    const char *strTab = reinterpret_cast<const char *>(m_sections[m_strtabSecIdx]->data);
+    auto section = getSection(m_symSecIdx);
+    const char *strTab = reinterpret_cast<const char *>(getSection(m_strtabSecIdx)->data);
 
     auto symbols = reinterpret_cast<const typename Elf::Symbol *>(section->data);
     unsigned symCount = getSymbolCount();
@@ -279,7 +347,7 @@ void ElfReader<Elf>::GetSymbolsBySectionIndex(unsigned secIdx, std::vector<ElfSy
     for (unsigned idx = 0; idx < symCount; ++idx) {
       if (symbols[idx].st_shndx == secIdx) {
         symbol.secIdx = symbols[idx].st_shndx;
-        symbol.secName = m_sections[symbol.secIdx]->name;
+        symbol.secName = getSectionName(symbol.secIdx);
         symbol.pSymName = strTab + symbols[idx].st_name;
         symbol.size = symbols[idx].st_size;
         symbol.value = symbols[idx].st_value;
@@ -299,8 +367,8 @@ void ElfReader<Elf>::GetSymbolsBySectionIndex(unsigned secIdx, std::vector<ElfSy
 //
 // @param symbolName : Symbol name
 template <class Elf> bool ElfReader<Elf>::isValidSymbol(const char *symbolName) {
-  auto &section = m_sections[m_symSecIdx];
-  const char *strTab = reinterpret_cast<const char *>(m_sections[m_strtabSecIdx]->data);
+  auto section = getSection(m_symSecIdx);
+  const char *strTab = reinterpret_cast<const char *>(getSection(m_strtabSecIdx)->data);
 
   auto symbols = reinterpret_cast<const typename Elf::Symbol *>(section->data);
   unsigned symCount = getSymbolCount();
@@ -320,10 +388,10 @@ template <class Elf> bool ElfReader<Elf>::isValidSymbol(const char *symbolName)
 //
 // @param noteType : Note type
 template <class Elf> ElfNote ElfReader<Elf>::getNote(Util::Abi::PipelineAbiNoteType noteType) const {
-  unsigned noteSecIdx = m_map.at(NoteName);
+  int32_t noteSecIdx = GetSectionIndex(NoteName);
   assert(noteSecIdx > 0);
 
-  auto noteSection = m_sections[noteSecIdx];
+  auto noteSection = getSection(noteSecIdx);
   ElfNote noteNode = {};
   const unsigned noteHeaderSize = sizeof(NoteHeader) - 8;
 
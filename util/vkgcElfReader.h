@@ -40,8 +40,11 @@
 #include "palPipelineAbi.h"
 #include "vkgcUtil.h"
 
+#include <memory>
+
 namespace llvm {
 template <unsigned InternalLen> class SmallString;
+class MemoryBuffer;
 } // namespace llvm
 
 namespace Vkgc {
@@ -413,6 +416,9 @@ public:
   // maintain compatibility.
   Result ReadFromBuffer(const void *buffer, size_t *bufSize);
 
+  // Reads ELF data in from the given file, memory mapping it where possible.
+  Result readFromFile(const char *fileName);
+
   // Retrieves the section data for the specified section name, if it exists.
   // NOTE: Do not change the name or API of this method as it is used by AMD internal code and we need to
   // maintain compatibility.
@@ -426,7 +432,7 @@ public:
   }
 
   // Determine if a section with the specified name is present in this ELF.
-  bool isSectionPresent(const char *name) const { return (m_map.find(name) != m_map.end()); }
+  bool isSectionPresent(const char *name) const { return GetSectionIndex(name) != InvalidValue; }
 
   uint32_t getSymbolCount() const;
   void getSymbol(uint32_t idx, ElfSymbol *symbol) const;
@@ -446,10 +452,7 @@ public:
   // Gets the section index for the specified section name.
   // NOTE: Do not change the name or API of this method as it is used by AMD internal code and we need to
   // maintain compatibility.
-  int32_t GetSectionIndex(const char *name) const {
-    auto entry = m_map.find(name);
-    return (entry != m_map.end()) ? entry->second : InvalidValue;
-  }
+  int32_t GetSectionIndex(const char *name) const;
 
   void initMsgPackDocument(const void *buffer, uint32_t sizeInBytes);
 
@@ -463,9 +466,9 @@ public:
 
   const typename Elf::FormatHeader &getHeader() const { return m_header; }
 
-  const std::map<std::string, uint32_t> &getMap() const { return m_map; }
+  const std::map<std::string, uint32_t> &getMap() const;
 
-  const std::vector<SectionBuffer *> &getSections() const { return m_sections; }
+  const std::vector<SectionBuffer *> &getSections() const;
 
   int32_t getSymSecIdx() const { return m_symSecIdx; }
 
@@ -479,11 +482,18 @@ private:
   ElfReader(const ElfReader &) = delete;
   ElfReader &operator=(const ElfReader &) = delete;
 
+  const typename Elf::SectionHeader *getSectionHeader(unsigned secIdx) const;
+  const char *getSectionName(unsigned secIdx) const;
+  SectionBuffer *getSection(unsigned secIdx) const;
+
   GfxIpVersion m_gfxIp; // Graphics IP version info (used by ELF dump only)
 
-  typename Elf::FormatHeader m_header;     // ELF header
-  std::map<std::string, uint32_t> m_map;   // Map between section name and section index
-  std::vector<SectionBuffer *> m_sections; // List of section data and headers
+  typename Elf::FormatHeader m_header;              // ELF header
+  const uint8_t *m_data;                            // ELF data, owned by the caller or m_fileBuffer
+  std::unique_ptr<llvm::MemoryBuffer> m_fileBuffer; // Mapped ELF file (if read by readFromFile)
+  mutable std::map<std::string, uint32_t> m_map;    // Map between section name and section index (built lazily)
+  mutable bool m_mapComplete;                       // Whether m_map covers all sections
+  mutable std::vector<SectionBuffer *> m_sections;  // List of section data and headers (created lazily)
 
   int32_t m_symSecIdx;    // Index of symbol section
   int32_t m_relocSecIdx;  // Index of relocation section
@@ -498,4 +508,7 @@ private:
 // Dumps ELF package to out stream
 template <class OStream, class Elf> OStream &operator<<(OStream &out, ElfReader<Elf> &reader);
 
+// Dumps static code metrics of ELF package to out stream, as one JSON object
+template <class OStream, class Elf> OStream &dumpElfMetrics(OStream &out, ElfReader<Elf> &reader);
+
 } // namespace Vkgc
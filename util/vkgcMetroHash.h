@@ -71,6 +71,42 @@ inline unsigned compact32(uint64_t hash) {
   return static_cast<unsigned>(hash) ^ static_cast<unsigned>(hash >> 32);
 }
 
+// Hash algorithms for internal cache keys. The value is recorded in the header of a serialized shader cache, as keys
+// made with one algorithm never match keys made with another.
+enum class HashAlgorithm : unsigned {
+  MetroHash64 = 0,  // MetroHash64, widened into a 128-bit Hash. Matches the hashes used to name dump files.
+  MetroHash128 = 1, // MetroHash128, which fills the whole 128-bit Hash
+};
+
+// Hasher for internal cache keys, using the algorithm chosen when it is created. It has the same Update and Finalize
+// interface as the MetroHash hashers, so it can take the place of MetroHash64 where a cache key is made.
+class CacheKeyHasher {
+public:
+  explicit CacheKeyHasher(HashAlgorithm algorithm) : m_algorithm(algorithm) {}
+
+  // Adds data to the hash
+  void Update(const uint8_t *buffer, const uint64_t length) {
+    if (m_algorithm == HashAlgorithm::MetroHash128)
+      m_hasher128.Update(buffer, length);
+    else
+      m_hasher64.Update(buffer, length);
+  }
+
+  // Gets the hash of the data added so far. As with MetroHash64, the hash must be zero-initialized for the 64-bit
+  // algorithm, which only writes its first 64 bits.
+  void Finalize(Hash *hash) {
+    if (m_algorithm == HashAlgorithm::MetroHash128)
+      m_hasher128.Finalize(hash->bytes);
+    else
+      m_hasher64.Finalize(hash->bytes);
+  }
+
+private:
+  HashAlgorithm m_algorithm;
+  MetroHash64 m_hasher64;
+  MetroHash128 m_hasher128;
+};
+
 #if LLPC_CLIENT_INTERFACE_MAJOR_VERSION >= 36
 // Compacts a 128-bit hash into a 32-bit one by XOR'ing each 32-bit chunk together.
 //
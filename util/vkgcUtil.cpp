@@ -114,6 +114,7 @@ const char *getResourceMappingNodeTypeName(ResourceMappingNodeType type) {
     CASE_CLASSENUM_TO_STRING(ResourceMappingNodeType, PushConst)
     CASE_CLASSENUM_TO_STRING(ResourceMappingNodeType, DescriptorBufferCompact)
     CASE_CLASSENUM_TO_STRING(ResourceMappingNodeType, StreamOutTableVaPtr)
+    CASE_CLASSENUM_TO_STRING(ResourceMappingNodeType, InlineBuffer)
     break;
   default:
     llvm_unreachable("Should never be called!");